@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arducam/BufferArena.hpp>
+#include <arducam/FrameRef.hpp>
+#include <arducam/PixelKernels.hpp>
+
+// Helpers shared by the benchmark programs. Not part of the library.
+
+namespace Arducam {
+namespace bench {
+
+inline uint64_t nowUs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/**
+ * @brief A latency histogram with 8 linear buckets per power of two, i.e. a relative error below 12.5 %.
+ *
+ * Recording is a few instructions and never allocates, so it can run on the SDK callback thread.
+ */
+class Histogram {
+   public:
+    void record(uint64_t value) {
+        buckets_[bucket(value)]++;
+        count_++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < kBuckets; i++) {
+            buckets_[i] += other.buckets_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ != 0 ? static_cast<double>(sum_) / count_ : 0.0; }
+    /** Returns the upper bound of the bucket holding the `p` quantile, `p` in [0, 1]. */
+    uint64_t percentile(double p) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        const uint64_t rank = static_cast<uint64_t>(p * (count_ - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                return std::min(upperBound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+   private:
+    static constexpr int kSubBits = 3;
+    static constexpr size_t kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+    static size_t bucket(uint64_t value) {
+        if (value < (1u << kSubBits)) {
+            return static_cast<size_t>(value);
+        }
+        int msb = 63;
+        while ((value >> msb) == 0) {
+            msb--;
+        }
+        const int shift = msb - kSubBits;
+        const size_t sub = static_cast<size_t>((value >> shift) & ((1u << kSubBits) - 1));
+        return (static_cast<size_t>(shift + 1) << kSubBits) + sub;
+    }
+    static uint64_t upperBound(size_t index) {
+        if (index < (1u << kSubBits)) {
+            return index;
+        }
+        const int shift = static_cast<int>(index >> kSubBits) - 1;
+        const uint64_t base = (uint64_t(1) << kSubBits) | (index & ((1u << kSubBits) - 1));
+        return ((base + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, kBuckets> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+};
+
+/**
+ * @brief Minimal `--name value` command line parser.
+ */
+class Args {
+   public:
+    Args(int argc, char** argv) {
+        for (int i = 1; i < argc; i++) {
+            if (std::strncmp(argv[i], "--", 2) != 0) {
+                continue;
+            }
+            const char* name = argv[i] + 2;
+            // a flag without a value reads as "1"
+            const bool has_value = i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0;
+            values_.emplace_back(name, has_value ? argv[++i] : "1");
+        }
+    }
+    bool has(const char* name) const { return find(name) != nullptr; }
+    std::string get(const char* name, const std::string& fallback) const {
+        const std::string* value = find(name);
+        return value != nullptr ? *value : fallback;
+    }
+    long getInt(const char* name, long fallback) const {
+        const std::string* value = find(name);
+        return value != nullptr ? std::strtol(value->c_str(), nullptr, 0) : fallback;
+    }
+    /** Splits a comma separated option. */
+    std::vector<std::string> getList(const char* name, const std::string& fallback) const {
+        std::vector<std::string> items;
+        const std::string value = get(name, fallback);
+        size_t start = 0;
+        while (start <= value.size()) {
+            const size_t end = std::min(value.find(',', start), value.size());
+            if (end > start) {
+                items.push_back(value.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+        return items;
+    }
+
+   private:
+    const std::string* find(const char* name) const {
+        for (const auto& value : values_) {
+            if (value.first == name) {
+                return &value.second;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<std::pair<std::string, std::string>> values_;
+};
+
+/**
+ * @brief Produces frames of a given format without hardware.
+ *
+ * The frames carry a deterministic test pattern with some noise and are handed out as `FrameRef` handles on the
+ * blocks of a `BufferArena`, like a camera whose frames were copied out of the SDK, so processing stages can be
+ * benchmarked and profiled on any host.
+ */
+class SyntheticSource {
+   public:
+    /**
+     * @param format The frame format, e.g. `{4608, 2592, 10, FORMAT_MODE_RAW << 8}`.
+     * @param packing `Bits8`, `Bits16`, `Raw10Packed` or `Raw12Packed`.
+     * @param buffers The number of frames that may be alive at the same time.
+     */
+    SyntheticSource(const ArducamFrameFormat& format, PixelPacking packing, size_t buffers = 4)
+        : format_(format), size_(packedRowSize(packing, format.width) * format.height) {
+        ArenaOptions options;
+        options.block_size = std::max<size_t>(size_, 1);
+        options.block_count = buffers;
+        arena_ = BufferArena::create(options);
+        // one pattern frame, copied into every block: producing frames must be much cheaper than consuming them
+        pattern_.resize(size_);
+        uint32_t state = 0x12345678;
+        const size_t row = packedRowSize(packing, format.width);
+        for (size_t y = 0; y < format.height; y++) {
+            for (size_t x = 0; x < row; x++) {
+                state = state * 1664525u + 1013904223u;
+                pattern_[y * row + x] = static_cast<uint8_t>((x * 255 / std::max<size_t>(row, 1) + y) ^ (state >> 28));
+            }
+        }
+    }
+
+    /** Returns the size of a frame in bytes. */
+    size_t frameSize() const { return size_; }
+    /** Returns the number of frames produced. */
+    uint32_t produced() const { return seq_; }
+
+    /**
+     * @brief Produces the next frame.
+     *
+     * @param ref Receives the frame.
+     *
+     * @return `true` on success, `false` if every buffer is still in use.
+     */
+    bool next(FrameRef& ref) {
+        uint8_t* block = arena_ ? arena_->acquire() : nullptr;
+        if (block == nullptr) {
+            return false;
+        }
+        std::memcpy(block, pattern_.data(), size_);
+        // a different first byte per frame, so that consumers cannot cache results by accident
+        block[0] = static_cast<uint8_t>(seq_);
+        Frame frame{};
+        frame.seq = seq_++;
+        frame.timestamp = nowUs() * 10;
+        frame.alloc_size = static_cast<uint32_t>(size_);
+        frame.expected_size = static_cast<uint32_t>(size_);
+        frame.size = static_cast<uint32_t>(size_);
+        frame.format = format_;
+        ref = arena_->wrapBlock(block, frame);
+        return true;
+    }
+
+   private:
+    ArducamFrameFormat format_;
+    size_t size_;
+    std::shared_ptr<BufferArena> arena_;
+    std::vector<uint8_t> pattern_;
+    uint32_t seq_ = 0;
+};
+
+/** Prints the header of a latency summary column set. */
+inline void printLatencyHeader(const char* name) { std::printf(" %8s_p50 %8s_p99 %8s_max", name, name, name); }
+/** Prints a latency summary, in microseconds. */
+inline void printLatency(const Histogram& histogram) {
+    std::printf(" %12llu %12llu %12llu", static_cast<unsigned long long>(histogram.percentile(0.5)),
+                static_cast<unsigned long long>(histogram.percentile(0.99)),
+                static_cast<unsigned long long>(histogram.max()));
+}
+
+}  // namespace bench
+}  // namespace Arducam
@@ -0,0 +1,259 @@
+// Measures the capture path of a camera for every combination of mode, transfer memory type, transfer configuration
+// and capture API.
+//
+//   capture_bench --config IMX708.bin [--device 0] [--seconds 5] [--warmup 1] [--modes 0,1]
+//                 [--mem dma,ram] [--transfers auto,8x65536] [--api poll,callback]
+//
+// One line is printed per run: sustained fps (and what `captureFps()` reports), delivered MB/s (and `bandwidth()`),
+// the drop rate from gaps in the frame sequence numbers, the latency from the `FrameEnd` event to the frame reaching
+// the application, and for the polling API the time spent in `freeImage()`. Latencies are in microseconds.
+
+#include <atomic>
+#include <mutex>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/EventDispatcher.hpp>
+
+#include "BenchCommon.hpp"
+
+using namespace Arducam;
+using namespace Arducam::bench;
+
+namespace {
+
+struct RunConfig {
+    uint32_t mode_id;
+    MemType mem_type;
+    // 0 means the recommendation of `setAutoTransfer()`
+    int transfer_count;
+    int buffer_size;
+    bool callback;
+};
+
+struct RunResult {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;
+    double seconds = 0;
+    int sdk_fps = 0;
+    int sdk_bandwidth = 0;
+    Histogram latency;
+    Histogram free_time;
+};
+
+// collects the statistics of one run, from the capture thread (polling) or the SDK callback thread
+class Collector {
+   public:
+    explicit Collector(EventDispatcher& events) : events_(events) {
+        listener_ = events_.addListener([this](EventCode event) {
+            if (event == EventCode::FrameEnd) {
+                frame_end_us_.store(nowUs(), std::memory_order_relaxed);
+            }
+        });
+    }
+    ~Collector() { events_.removeListener(listener_); }
+
+    void setMeasuring(bool measuring) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        measuring_ = measuring;
+        has_last_seq_ = false;
+    }
+    void onFrame(const Frame& frame) {
+        const uint64_t now = nowUs();
+        const uint64_t frame_end = frame_end_us_.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!measuring_) {
+            return;
+        }
+        result_.frames++;
+        result_.bytes += frame.size;
+        if (has_last_seq_ && frame.seq > last_seq_ + 1) {
+            result_.dropped += frame.seq - last_seq_ - 1;
+        }
+        last_seq_ = frame.seq;
+        has_last_seq_ = true;
+        if (frame_end != 0 && now >= frame_end) {
+            result_.latency.record(now - frame_end);
+        }
+    }
+    void onFree(uint64_t us) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (measuring_) {
+            result_.free_time.record(us);
+        }
+    }
+    RunResult result() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return result_;
+    }
+
+   private:
+    EventDispatcher& events_;
+    int listener_;
+    std::atomic<uint64_t> frame_end_us_{0};
+    std::mutex mutex_;
+    bool measuring_ = false;
+    bool has_last_seq_ = false;
+    uint32_t last_seq_ = 0;
+    RunResult result_;
+};
+
+bool configure(Camera& camera, const RunConfig& run) {
+    // a camera with a single mode (or a text configuration) cannot switch
+    const bool can_switch = camera.modeSize() > 1;
+    if ((can_switch && !camera.switchMode(run.mode_id)) || !camera.setMemType(run.mem_type)) {
+        return false;
+    }
+    if (run.transfer_count == 0) {
+        return camera.setAutoTransfer(true);
+    }
+    return camera.setTransfer(run.transfer_count, run.buffer_size);
+}
+
+bool measure(Camera& camera, EventDispatcher& events, const RunConfig& run, double warmup, double seconds,
+             RunResult& result) {
+    if (!configure(camera, run)) {
+        return false;
+    }
+    Collector collector(events);
+    std::atomic<bool> stop{false};
+    std::thread poller;
+    if (run.callback) {
+        camera.setCaptureCallback([&collector](Frame frame) { collector.onFrame(frame); });
+    }
+    if (!camera.start()) {
+        camera.setCaptureCallback(nullptr);
+        return false;
+    }
+    if (!run.callback) {
+        poller = std::thread([&] {
+            Frame frame;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (!camera.capture(frame, 200)) {
+                    continue;
+                }
+                collector.onFrame(frame);
+                const uint64_t start = nowUs();
+                camera.freeImage(frame);
+                collector.onFree(nowUs() - start);
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(warmup));
+    collector.setMeasuring(true);
+    const uint64_t start = nowUs();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    collector.setMeasuring(false);
+    const uint64_t elapsed = nowUs() - start;
+    const int sdk_fps = camera.captureFps();
+    const int sdk_bandwidth = camera.bandwidth();
+
+    stop.store(true, std::memory_order_relaxed);
+    if (poller.joinable()) {
+        poller.join();
+    }
+    camera.stop();
+    camera.setCaptureCallback(nullptr);
+
+    result = collector.result();
+    result.seconds = elapsed / 1e6;
+    result.sdk_fps = sdk_fps;
+    result.sdk_bandwidth = sdk_bandwidth;
+    return true;
+}
+
+bool parseTransfer(const std::string& text, int& count, int& size) {
+    if (text == "auto") {
+        count = 0;
+        size = 0;
+        return true;
+    }
+    return std::sscanf(text.c_str(), "%dx%d", &count, &size) == 2 && count > 0 && size > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Args args(argc, argv);
+    if (!args.has("config")) {
+        std::fprintf(stderr,
+                     "usage: %s --config FILE [--device N] [--seconds S] [--warmup S] [--modes ID,..] "
+                     "[--mem dma,ram] [--transfers auto,COUNTxSIZE,..] [--api poll,callback]\n",
+                     argv[0]);
+        return 2;
+    }
+    const std::string config = args.get("config", "");
+    const double seconds = std::atof(args.get("seconds", "5").c_str());
+    const double warmup = std::atof(args.get("warmup", "1").c_str());
+
+    DeviceList devices = DeviceList::listDevices();
+    const size_t device = static_cast<size_t>(args.getInt("device", 0));
+    if (device >= devices.size()) {
+        std::fprintf(stderr, "no device %zu (%zu found)\n", device, devices.size());
+        return 1;
+    }
+    ArducamCameraOpenParam param{};
+    param.config_file_name = config.c_str();
+    param.bin_config = config.size() > 4 && config.compare(config.size() - 4, 4, ".bin") == 0;
+    param.mem_type = DMA;
+    param.device = devices[device];
+    Camera camera;
+    if (!camera.open(param) || !camera.init()) {
+        std::fprintf(stderr, "cannot open the camera with %s\n", config.c_str());
+        return 1;
+    }
+    EventDispatcher events(camera);
+
+    std::vector<uint32_t> ids(camera.modeSize());
+    std::vector<ArducamCameraConfig> modes(ids.size());
+    if (ids.empty() || !camera.listMode(ids.data(), modes.data())) {
+        ids.assign(1, 0);
+        modes.assign(1, camera.config());
+    }
+    std::vector<std::string> selected = args.getList("modes", "");
+
+    std::printf("%6s %10s %4s %14s %8s %9s %7s %9s %7s %7s", "mode", "size", "mem", "transfers", "api", "fps",
+                "sdk_fps", "MB/s", "sdk_bw", "drop%");
+    printLatencyHeader("lat");
+    printLatencyHeader("free");
+    std::printf("\n");
+    for (size_t m = 0; m < ids.size(); m++) {
+        if (!selected.empty() &&
+            std::find(selected.begin(), selected.end(), std::to_string(ids[m])) == selected.end()) {
+            continue;
+        }
+        for (const std::string& mem : args.getList("mem", "dma,ram")) {
+            for (const std::string& transfer : args.getList("transfers", "auto")) {
+                for (const std::string& api : args.getList("api", "poll,callback")) {
+                    RunConfig run;
+                    run.mode_id = ids[m];
+                    run.mem_type = mem == "ram" ? RAM : DMA;
+                    run.callback = api == "callback";
+                    if (!parseTransfer(transfer, run.transfer_count, run.buffer_size)) {
+                        std::fprintf(stderr, "bad transfer configuration %s\n", transfer.c_str());
+                        return 2;
+                    }
+                    const std::string size = std::to_string(modes[m].width) + "x" + std::to_string(modes[m].height);
+                    std::printf("%6u %10s %4s %14s %8s", ids[m], size.c_str(), mem.c_str(), transfer.c_str(),
+                                api.c_str());
+                    RunResult result;
+                    if (!measure(camera, events, run, warmup, seconds, result)) {
+                        std::printf(" failed\n");
+                        continue;
+                    }
+                    const uint64_t expected = result.frames + result.dropped;
+                    std::printf(" %9.2f %7d %9.1f %7d %7.2f", result.frames / result.seconds, result.sdk_fps,
+                                result.bytes / result.seconds / 1e6, result.sdk_bandwidth,
+                                expected != 0 ? 100.0 * result.dropped / expected : 0.0);
+                    printLatency(result.latency);
+                    printLatency(result.free_time);
+                    std::printf("\n");
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+    camera.close();
+    return 0;
+}
@@ -0,0 +1,250 @@
+// Measures the processing stages on synthetic frames, without hardware.
+//
+//   kernel_bench [--width 4608] [--height 2592] [--bits 10] [--packing raw10|raw12|16|8] [--frames 20]
+//                [--threads N] [--coefficients distortion_coefficients_dual.json --camera cam0] [--subscribers 2]
+//
+// Every stage runs on the same frames with the best kernels of the CPU and with the portable ones. The time per
+// frame of each stage is printed as a percentile summary in microseconds, with the resulting frame rate.
+
+#include <arducam/FrameDispatcher.hpp>
+#include <arducam/FrameValidator.hpp>
+#include <arducam/PixelKernels.hpp>
+#include <arducam/PixelPipeline.hpp>
+#include <arducam/RemapLut.hpp>
+#include <arducam/TileGraph.hpp>
+#include <arducam/WorkerPool.hpp>
+
+#include "BenchCommon.hpp"
+
+using namespace Arducam;
+using namespace Arducam::bench;
+
+namespace {
+
+const char* simdName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Avx2:
+            return "avx2";
+        case SimdLevel::Neon:
+            return "neon";
+        default:
+            return "scalar";
+    }
+}
+
+PixelPacking parsePacking(const std::string& text) {
+    if (text == "8") {
+        return PixelPacking::Bits8;
+    }
+    if (text == "16") {
+        return PixelPacking::Bits16;
+    }
+    return text == "raw12" ? PixelPacking::Raw12Packed : PixelPacking::Raw10Packed;
+}
+
+template <typename Fn>
+void run(const char* name, SyntheticSource& source, int frames, Fn&& fn) {
+    Histogram histogram;
+    FrameRef ref;
+    // the first frame warms the caches and the page tables of the outputs up
+    for (int i = 0; i <= frames; i++) {
+        if (!source.next(ref)) {
+            std::fprintf(stderr, "%s: no free buffer\n", name);
+            return;
+        }
+        const uint64_t start = nowUs();
+        if (!fn(ref.frame())) {
+            std::printf("%-28s failed\n", name);
+            return;
+        }
+        if (i != 0) {
+            histogram.record(nowUs() - start);
+        }
+        ref.reset();
+    }
+    std::printf("%-28s", name);
+    printLatency(histogram);
+    std::printf(" %9.2f\n", histogram.mean() > 0 ? 1e6 / histogram.mean() : 0.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Args args(argc, argv);
+    ArducamFrameFormat format{};
+    format.width = static_cast<uint32_t>(args.getInt("width", 4608));
+    format.height = static_cast<uint32_t>(args.getInt("height", 2592));
+    format.bit_width = static_cast<uint8_t>(args.getInt("bits", 10));
+    format.format = static_cast<uint16_t>(FORMAT_MODE_RAW << 8) | static_cast<uint16_t>(BayerOrder::BGGR);
+    const PixelPacking packing = parsePacking(args.get("packing", "raw10"));
+    const int frames = static_cast<int>(args.getInt("frames", 20));
+    WorkerPool pool(static_cast<size_t>(args.getInt("threads", 0)));
+
+    SyntheticSource source(format, packing);
+    const size_t pixels = static_cast<size_t>(format.width) * format.height;
+    std::printf("%ux%u %u bit, %zu byte frames, %zu workers, best kernels: %s\n", format.width, format.height,
+                format.bit_width, source.frameSize(), pool.size(), simdName(pixelKernels().level));
+    std::printf("%-28s", "stage");
+    printLatencyHeader("us");
+    std::printf(" %9s\n", "fps");
+
+    std::vector<uint16_t> raw(pixels);
+    std::vector<uint8_t> rgb(pixels * 3);
+    std::vector<uint16_t> scratch(convertScratchSize(format));
+    const PixelKernelTable& best = pixelKernels();
+    const PixelKernelTable& scalar = scalarPixelKernels();
+    const size_t row = packedRowSize(packing, format.width);
+    const uint16_t mask = static_cast<uint16_t>((1u << format.bit_width) - 1);
+
+    for (const PixelKernelTable* kernels : {&best, &scalar}) {
+        if (kernels == &scalar && best.level == SimdLevel::Scalar) {
+            break;
+        }
+        const std::string suffix = std::string(" ") + simdName(kernels->level);
+        run(("unpack" + suffix).c_str(), source, frames, [&](const Frame& frame) {
+            for (uint32_t y = 0; y < format.height; y++) {
+                const uint8_t* src = frame.data + y * row;
+                uint16_t* dst = raw.data() + static_cast<size_t>(y) * format.width;
+                switch (packing) {
+                    case PixelPacking::Bits8:
+                        kernels->unpack8(src, dst, format.width);
+                        break;
+                    case PixelPacking::Bits16:
+                        kernels->unpack16(src, dst, format.width, mask);
+                        break;
+                    case PixelPacking::Raw12Packed:
+                        kernels->unpackRaw12(src, dst, format.width);
+                        break;
+                    default:
+                        kernels->unpackRaw10(src, dst, format.width);
+                        break;
+                }
+            }
+            return true;
+        });
+    }
+
+    {
+        // the recycled synthetic buffers show up as stale stripes, which costs the same as a clean frame
+        FrameValidator validator;
+        FrameQuality quality;
+        run("validate", source, frames, [&](const Frame& frame) {
+            validator.validate(frame, quality);
+            return true;
+        });
+    }
+
+    ConvertOptions convert;
+    for (OutputFormat output : {OutputFormat::Rgb8, OutputFormat::Y8}) {
+        convert.output = output;
+        run(output == OutputFormat::Rgb8 ? "convert rgb8" : "convert y8", source, frames,
+            [&](const Frame& frame) { return convertFrame(frame, convert, rgb.data(), 0, scratch.data()); });
+    }
+
+    {
+        // the same conversion with white balance and gamma folded into the specialized pipeline
+        FrameRef first;
+        PipelineOptions options;
+        options.red_gain = 1.8f;
+        options.blue_gain = 1.5f;
+        options.gamma = 2.2f;
+        std::unique_ptr<PixelPipeline> pipeline;
+        if (source.next(first)) {
+            pipeline = PixelPipeline::build(first.frame(), options);
+        }
+        first.reset();
+        if (pipeline) {
+            std::vector<uint16_t> pipeline_scratch(pipeline->scratchSize());
+            run("pipeline rgb8 wb gamma", source, frames, [&](const Frame& frame) {
+                return pipeline->run(frame, rgb.data(), 0, pipeline_scratch.data());
+            });
+        }
+    }
+
+    CorrectionParams params;
+    if (args.has("coefficients")) {
+        if (!loadCorrectionParams(args.get("coefficients", ""), args.get("camera", "cam0"), params)) {
+            std::fprintf(stderr, "cannot read %s\n", args.get("coefficients", "").c_str());
+            return 1;
+        }
+    } else {
+        // a mild barrel distortion and a small rotation, so that every output pixel is interpolated
+        params.radial = true;
+        params.xcenter = format.width / 2.0;
+        params.ycenter = format.height / 2.0;
+        const double r = static_cast<double>(format.width);
+        params.coeffs = {1.0, 0.0, 0.05 / (r * r)};
+        params.rotation = 0.5;
+    }
+    RemapLut lut;
+    const uint64_t build_start = nowUs();
+    if (!lut.build(params, format.width, format.height, &pool)) {
+        std::fprintf(stderr, "the correction does not fit the frame size\n");
+        return 1;
+    }
+    std::printf("remap table %ux%u, built in %llu us, %zu KiB\n", lut.width(), lut.height(),
+                static_cast<unsigned long long>(nowUs() - build_start), lut.memoryUsage() >> 10);
+    std::vector<uint8_t> corrected(static_cast<size_t>(lut.width()) * lut.height() * 3);
+    convert.output = OutputFormat::Rgb8;
+    {
+        // the remap stages work on one converted image
+        FrameRef first;
+        if (!source.next(first) || !convertFrame(first.frame(), convert, rgb.data(), 0, scratch.data())) {
+            std::fprintf(stderr, "cannot convert the synthetic frame\n");
+            return 1;
+        }
+    }
+    run("remap rgb8 1 thread", source, frames, [&](const Frame&) {
+        return lut.apply(OutputFormat::Rgb8, rgb.data(), 0, corrected.data(), 0);
+    });
+    run("remap rgb8 pool", source, frames, [&](const Frame&) {
+        return lut.apply(OutputFormat::Rgb8, rgb.data(), 0, corrected.data(), 0, &pool);
+    });
+    FrameCorrector corrector(params, convert, &pool);
+    corrector.prepare(format.width, format.height);
+    run("convert + remap rgb8 pool", source, frames,
+        [&](const Frame& frame) { return corrector.process(frame, corrected.data()); });
+
+    // the same correction pulled tile by tile, then a stereo pair of the frame combined side by side
+    TileGraph graph;
+    graph.setOutput(graph.addRemap(graph.addSource(0, format, convert), lut));
+    std::vector<Frame> inputs;
+    run("tile graph rgb8 pool", source, frames, [&](const Frame& frame) {
+        inputs.assign(1, frame);
+        return graph.run(inputs, corrected.data(), 0, &pool);
+    });
+    TileGraph stereo;
+    stereo.setOutput(stereo.addSideBySide({stereo.addRemap(stereo.addSource(0, format, convert), lut),
+                                           stereo.addRemap(stereo.addSource(1, format, convert), lut)}));
+    std::vector<uint8_t> combined(static_cast<size_t>(stereo.width()) * stereo.height() * 3);
+    run("tile graph stereo rgb8 pool", source, frames, [&](const Frame& frame) {
+        inputs.assign(2, frame);
+        return stereo.run(inputs, combined.data(), 0, &pool);
+    });
+    std::printf("tile graph %ux%u tiles, %zu units, %zu KiB scratch\n", stereo.tileWidth(), stereo.tileHeight(),
+                stereo.unitCount(), stereo.scratchSize() >> 10);
+
+    // fan-out cost of the dispatcher alone: every subscriber gets a handle to the same buffer
+    const size_t subscribers = static_cast<size_t>(args.getInt("subscribers", 2));
+    FrameDispatcher dispatcher;
+    std::vector<std::shared_ptr<FrameSubscriber>> subs;
+    for (size_t i = 0; i < subscribers; i++) {
+        subs.push_back(dispatcher.subscribe("bench" + std::to_string(i), 2, DropPolicy::DropOldest));
+    }
+    Histogram dispatch;
+    FrameRef ref;
+    for (int i = 0; i < frames * 50 && source.next(ref); i++) {
+        const uint64_t start = nowUs();
+        dispatcher.dispatch(std::move(ref));
+        FrameRef popped;
+        for (auto& sub : subs) {
+            sub->tryPop(popped);
+            popped.reset();
+        }
+        dispatch.record(nowUs() - start);
+    }
+    std::printf("%-28s", ("dispatch " + std::to_string(subscribers) + " subscribers").c_str());
+    printLatency(dispatch);
+    std::printf("\n");
+    return 0;
+}
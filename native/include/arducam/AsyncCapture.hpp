@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BoundedQueue.hpp>
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/FrameRef.hpp>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+/** Defined to 1 when `AsyncCapture::nextFrame()` is available (C++20 coroutines). */
+#define ARDUCAM_HAS_COROUTINES 1
+#endif
+#endif
+#ifndef ARDUCAM_HAS_COROUTINES
+#define ARDUCAM_HAS_COROUTINES 0
+#endif
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+#if defined(_WIN32)
+/** A waitable OS handle: an event `HANDLE` on Windows, a file descriptor elsewhere. */
+using NativeHandle = void*;
+#else
+/** A waitable OS handle: an event `HANDLE` on Windows, a file descriptor elsewhere. */
+using NativeHandle = int;
+#endif
+
+/**
+ * @brief Captures the frames of a camera from an event loop, without a thread blocked in `Camera::capture()`.
+ *
+ * The `FrameEnd` events of the camera signal a handle that is readable while frames may be waiting: an `eventfd` on
+ * Linux, a non-blocking pipe on other POSIX systems and an event object on Windows. The handle is added to the event
+ * loop of the application (`epoll`, `poll`, `asio::posix::stream_descriptor`, `WaitForMultipleObjects`, ...) next to
+ * its sockets; when it is readable, the loop calls `poll()` and takes the frames with `tryCapture()`. Signalling is a
+ * single write from the SDK event thread, skipped while the handle is still signalled, and the loop thread wakes up
+ * straight from the kernel, not through a condition variable.
+ *
+ * With C++20 coroutines, `co_await capture.nextFrame()` suspends the calling coroutine until a frame is there;
+ * `poll()` resumes the waiting coroutines, in order, on the thread that calls it.
+ *
+ * Except for the event listener, the capture is not thread safe: `poll()`, `tryCapture()`, `nextFrame()` and
+ * `cancel()` must be called from one thread, normally the event loop.
+ *
+ * @note The capture uses the polling API, so it can not be used together with `Camera::setCaptureCallback()`, and
+ * nothing else should capture from the camera.
+ */
+class AsyncCapture {
+   public:
+    /**
+     * @brief Creates the handle and starts listening to the events of the camera.
+     *
+     * @param camera The camera. Must outlive the capture.
+     * @param events The event dispatcher of the camera. Must outlive the capture.
+     */
+    AsyncCapture(Camera& camera, EventDispatcher& events);
+    AsyncCapture(const AsyncCapture&) = delete;
+    AsyncCapture& operator=(const AsyncCapture&) = delete;
+    /**
+     * @brief Stops listening and closes the handle. No coroutine may be waiting, see `cancel()`.
+     */
+    ~AsyncCapture();
+
+    /** Checks if the handle could be created. */
+    bool valid() const { return valid_; }
+    /** Returns the handle to wait for readability on. */
+    NativeHandle handle() const { return handle_; }
+
+    /**
+     * @brief Handles a readable handle: clears it and resumes the coroutines waiting in `nextFrame()`, one frame each.
+     *
+     * A frame whose `FrameEnd` event came ahead of it keeps the handle signalled for a few milliseconds, so that the
+     * loop comes back for it without sleeping on a timer.
+     *
+     * @return The number of coroutines resumed.
+     */
+    size_t poll();
+    /**
+     * @brief Takes the next frame if one is ready. Never blocks.
+     *
+     * @param ref Receives the frame. Reset if there is none.
+     *
+     * @return `true` if a frame was taken.
+     */
+    bool tryCapture(FrameRef& ref);
+    /**
+     * @brief Resumes every waiting coroutine with an empty frame, e.g. before the camera is stopped.
+     */
+    void cancel();
+
+    /** Returns the number of coroutines waiting in `nextFrame()`. */
+    size_t waiting() const { return waiters_.size(); }
+
+#if ARDUCAM_HAS_COROUTINES
+    /**
+     * @brief The awaitable returned by `nextFrame()`. `co_await` yields the frame, empty if the wait was cancelled.
+     */
+    class FrameAwaiter {
+       public:
+        explicit FrameAwaiter(AsyncCapture& capture) : capture_(capture) {}
+        bool await_ready() { return capture_.tryCapture(ref_); }
+        void await_suspend(std::coroutine_handle<> handle) {
+            capture_.waiters_.push_back(Waiter{handle.address(), &resumeCoroutine, &ref_});
+        }
+        FrameRef await_resume() { return std::move(ref_); }
+
+       private:
+        AsyncCapture& capture_;
+        FrameRef ref_;
+    };
+
+    /**
+     * @brief Returns an awaitable for the next frame.
+     *
+     * If a frame is ready, `co_await` completes without suspending; otherwise the coroutine is resumed by `poll()`.
+     */
+    FrameAwaiter nextFrame() { return FrameAwaiter(*this); }
+#endif
+
+   private:
+    // type erased, so that the library itself can be built without coroutine support
+    struct Waiter {
+        void* coroutine;
+        void (*resume)(void* coroutine);
+        FrameRef* ref;
+    };
+
+#if ARDUCAM_HAS_COROUTINES
+    static void resumeCoroutine(void* coroutine) { std::coroutine_handle<>::from_address(coroutine).resume(); }
+#endif
+
+    void signal();
+    void clear();
+
+    Camera& camera_;
+    EventDispatcher& events_;
+    int listener_ = -1;
+    bool valid_ = false;
+    NativeHandle handle_;
+#if !defined(_WIN32) && !defined(__linux__)
+    // the write end of the pipe
+    int write_fd_ = -1;
+#endif
+
+    // number of `FrameEnd` events since the last `poll()`
+    alignas(kCacheLineSize) std::atomic<uint32_t> pending_{0};
+    std::atomic<bool> signalled_{false};
+
+    // owned by the loop thread
+    std::deque<Waiter> waiters_;
+    int64_t credit_ = 0;
+    uint64_t credit_since_us_ = 0;
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <arducam/PixelKernels.hpp>
+#include <arducam/RawRecorder.hpp>
+#include <arducam/RemapLut.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Enum class representing the output file formats of a `BatchProcessor`.
+ */
+enum class BatchFormat : uint8_t {
+    Jpeg = 0x00,   /**< 8-bit JPEG, needs `jpegSupported()` */
+    Tiff8 = 0x01,  /**< Uncompressed 8-bit RGB TIFF */
+    Tiff16 = 0x02, /**< Uncompressed 16-bit RGB TIFF, scaled to the full 16-bit range */
+};
+
+/**
+ * @brief Struct representing one stereo pair of a batch.
+ *
+ * The images are either two DNG files or, if `BatchOptions::recording` is set, two frames of that recording.
+ */
+struct BatchInput {
+    /** The base name of the output files. */
+    std::string name;
+    /** The DNG files of the left (cam0) and the right (cam1) camera. */
+    std::string left_path;
+    std::string right_path;
+    /** The frame indices of the left and the right camera in the recording. */
+    size_t left_frame = 0;
+    size_t right_frame = 0;
+};
+
+/**
+ * @brief Struct representing the options of a `BatchProcessor`.
+ */
+struct BatchOptions {
+    /** The corrections of the left (cam0) and the right (cam1) camera, see `loadCorrectionParams()`. */
+    CorrectionParams left;
+    CorrectionParams right;
+    DemosaicMethod method = DemosaicMethod::EdgeAware;
+    /** Black level subtracted from every sample. Negative uses the `BlackLevel` tag of DNG files, 0 for recordings. */
+    int black_level = -1;
+
+    BatchFormat format = BatchFormat::Jpeg;
+    /** The JPEG quality, 1 to 100. */
+    int quality = 95;
+    /** Writes `<name>_left` and `<name>_right`. */
+    bool save_individual = true;
+    /** Writes `<name>_combined`, both images side by side, cut to the lower of the two heights. */
+    bool save_combined = true;
+    /** The directory the files are written to. Must exist. */
+    std::string output_directory = ".";
+
+    /** The number of worker threads. 0 means `std::thread::hardware_concurrency()`. */
+    size_t threads = 0;
+    /**
+     * @brief The number of pairs held in memory at a time, which bounds the memory use: about 80 MB per pair of 12 MP
+     * DNG files, plus one converted image per thread. 0 means one more than half the threads.
+     */
+    size_t in_flight = 0;
+
+    /** The recording the `BatchInput` frame indices refer to, or null for DNG files. Not owned. */
+    const RawReader* recording = nullptr;
+};
+
+/**
+ * @brief Struct representing the outcome of `BatchProcessor::run()`.
+ */
+struct BatchResult {
+    /** Number of pairs processed successfully. */
+    size_t pairs = 0;
+    /** Number of pairs that could not be read, converted or written. */
+    size_t failed = 0;
+    /** Number of files written. */
+    size_t files = 0;
+    /** Wall clock time of the batch, in seconds. */
+    double seconds = 0;
+    /** Time spent in each stage, summed over the threads, in microseconds. */
+    uint64_t decode_us = 0;
+    uint64_t correct_us = 0;
+    uint64_t encode_us = 0;
+};
+
+/**
+ * @brief Corrects and encodes batches of stereo pairs on every core.
+ *
+ * This is the native counterpart of `process_batch_pairs()` in `image_post_processing_v1.1.py`: each pair is read,
+ * converted with `convertFrame()`, corrected with one `RemapLut` per camera, combined side by side and encoded. The
+ * stages of different pairs overlap: every worker takes the most advanced task there is (encode, then correct, then
+ * decode), and a new pair is only read when one of the `in_flight` pair slots is free, so the memory use stays
+ * bounded however long the batch is. The two images of a pair are corrected straight into the two halves of the
+ * combined image, so combining costs no copy, and the individual files are written from the same buffer.
+ *
+ * The correction tables are built once per camera and source size.
+ */
+class BatchProcessor {
+   public:
+    /**
+     * @brief Function type called after every pair, on a worker thread.
+     *
+     * @param done The number of pairs finished so far.
+     * @param total The number of pairs of the batch.
+     * @param input The pair.
+     * @param ok `true` if the pair was processed successfully.
+     */
+    using Progress = std::function<void(size_t done, size_t total, const BatchInput& input, bool ok)>;
+
+    explicit BatchProcessor(const BatchOptions& options);
+
+    /** Returns the options. */
+    const BatchOptions& options() const { return options_; }
+
+    /**
+     * @brief Processes a batch and waits until it is done.
+     *
+     * @param inputs The pairs.
+     * @param progress Called after every pair if set.
+     *
+     * @return The outcome.
+     */
+    BatchResult run(const std::vector<BatchInput>& inputs, const Progress& progress = Progress());
+
+   private:
+    BatchOptions options_;
+};
+
+/**
+ * @brief Finds the stereo pairs among the DNG files of a directory.
+ *
+ * A file of the left camera has `cam0` or `left` in its name, a file of the right camera `cam1` or `right` (ignoring
+ * case). Two files form a pair when their names are equal once that word is removed, e.g. the
+ * `cam0_<timestamp>_original_<params>.dng` and `cam1_...` files of the capture GUI; the rest of the name becomes the
+ * name of the pair.
+ *
+ * @param directory The directory.
+ * @param inputs Receives the pairs, sorted by name.
+ *
+ * @return `true` on success, `false` if the directory cannot be read.
+ */
+bool findDngPairs(const std::string& directory, std::vector<BatchInput>& inputs);
+
+/**
+ * @brief Pairs the frames of stream 0 (left) and stream 1 (right) of a recording by timestamp.
+ *
+ * Every left frame is paired with the right frame closest in time, each right frame used once.
+ *
+ * @param reader The recording.
+ * @param inputs Receives the pairs, in recording order, named `pair_<left frame index>`.
+ */
+void recordingPairs(const RawReader& reader, std::vector<BatchInput>& inputs);
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/** Size used to keep independently written atomics on separate cache lines. */
+constexpr size_t kCacheLineSize = 64;
+
+/**
+ * @brief A bounded lock-free multi-producer multi-consumer queue.
+ *
+ * The queue is an array of cells, each carrying a sequence number that tells producers and consumers whether the
+ * cell is free or holds a value (D. Vyukov's bounded MPMC queue). `tryPush()` and `tryPop()` never block and never
+ * allocate. Because any thread may pop, a producer can also discard the oldest element to make room.
+ *
+ * @tparam T The element type. Must be default constructible and move assignable.
+ */
+template <typename T>
+class BoundedQueue {
+   public:
+    /**
+     * @brief Constructs a queue.
+     *
+     * @param capacity The maximum number of elements. Rounded up to the next power of two (at least 2).
+     */
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Pushes a value if the queue is not full.
+     *
+     * @param value The value to push. Left untouched if the queue is full.
+     *
+     * @return `true` if the value was pushed, `false` if the queue is full. A queue holding fewer elements than its
+     * capacity also reports full while the `tryPop()` that freed the next cell is still running on another thread.
+     */
+    bool tryPush(T& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    /** @overload */
+    bool tryPush(T&& value) { return tryPush(value); }
+    /**
+     * @brief Pops the oldest value if the queue is not empty.
+     *
+     * @param value Receives the value.
+     *
+     * @return `true` if a value was popped, `false` if the queue is empty.
+     */
+    bool tryPop(T& value) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.value = T();
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Returns the capacity of the queue. */
+    size_t capacity() const { return mask_ + 1; }
+    /**
+     * @brief Returns the number of elements in the queue.
+     *
+     * @note Only an approximation while other threads push or pop.
+     */
+    size_t size() const {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+    /** Checks if the queue is empty. @see size() */
+    bool empty() const { return size() == 0; }
+
+   private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+};
+
+/**
+ * @brief Wakes up threads sleeping on a condition that is published without a lock.
+ *
+ * `notify()` only takes the mutex when a thread is actually sleeping, so the fast path of the notifying side is a
+ * single atomic load.
+ */
+class Notifier {
+   public:
+    /**
+     * @brief Waits until `pred()` is true or the timeout expires.
+     *
+     * @param pred The condition to wait for.
+     * @param timeout The maximum time to wait, in milliseconds. negative value means forever.
+     *
+     * @return The last value of `pred()`.
+     */
+    template <typename Pred>
+    bool wait(Pred pred, int timeout) {
+        if (pred()) {
+            return true;
+        }
+        sleepers_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ready;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (timeout < 0) {
+                cv_.wait(lock, pred);
+                ready = true;
+            } else {
+                ready = cv_.wait_for(lock, std::chrono::milliseconds(timeout), pred);
+            }
+        }
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        return ready;
+    }
+    /**
+     * @brief Wakes up all sleeping threads. Must be called after the condition was published.
+     */
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_all();
+        }
+    }
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<int> sleepers_{0};
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BoundedQueue.hpp>
+#include <arducam/FrameRef.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the options of a `BufferArena`.
+ */
+struct ArenaOptions {
+    /** The size of every block in bytes, e.g. `largestModeSize()`. Rounded up to the page size. */
+    size_t block_size = 0;
+    /** The number of blocks. */
+    size_t block_count = 8;
+    /** Backs the arena with huge pages. Falls back to normal pages if none are available. */
+    bool huge_pages = false;
+    /** Locks the arena in physical memory. Ignored if the process is not allowed to lock that much memory. */
+    bool pinned = false;
+};
+
+/**
+ * @brief A fixed set of equally sized buffers allocated once.
+ *
+ * The arena is one contiguous mapping cut into blocks, so its memory is allocated, faulted in and optionally locked up
+ * front and never again, whatever mode the cameras switch to. Sized with `largestModeSize()` it holds a frame of any
+ * mode. Blocks are taken and returned lock-free from any thread, so one arena can serve both cameras of a stereo pair.
+ *
+ * The buffers are handed out as `FrameRef` handles, either as copies of SDK frames (`copyFrame()`), which gives the
+ * SDK buffer back right away so long lived frames (recording, processing backlogs) do not starve its transfer queue,
+ * or as blank blocks for frame sources that fill them themselves (`wrapBlock()`).
+ *
+ * @note The arena must outlive every handle referring to its blocks.
+ */
+class BufferArena {
+   public:
+    /**
+     * @brief Creates an arena.
+     *
+     * @return The arena, or null if `block_size` or `block_count` is 0 or the memory cannot be allocated.
+     */
+    static std::shared_ptr<BufferArena> create(const ArenaOptions& options);
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+    ~BufferArena();
+
+    /** Returns the size of a block in bytes. */
+    size_t blockSize() const { return block_size_; }
+    /** Returns the number of blocks. */
+    size_t blockCount() const { return block_count_; }
+    /** Returns the approximate number of free blocks. */
+    size_t available() const { return free_.size(); }
+    /** Checks if the arena is backed by huge pages. */
+    bool hugePages() const { return huge_pages_; }
+    /** Checks if the arena is locked in physical memory. */
+    bool pinned() const { return pinned_; }
+    /** Checks if `p` points into the arena. */
+    bool contains(const void* p) const;
+
+    /**
+     * @brief Takes a free block.
+     *
+     * @return The block, or null if every block is in use.
+     */
+    uint8_t* acquire();
+    /**
+     * @brief Returns a block taken with `acquire()`.
+     */
+    void release(const uint8_t* block);
+
+    /**
+     * @brief Wraps a block taken with `acquire()` in a handle that returns it to the arena.
+     *
+     * @param block The block, filled by the caller.
+     * @param frame The frame header. `data` is replaced with `block`.
+     *
+     * @return The handle, or an empty handle if `block` is null.
+     */
+    FrameRef wrapBlock(uint8_t* block, Frame frame);
+    /**
+     * @brief Copies a frame into a free block.
+     *
+     * @param frame The frame. The caller still owns it and may free it right away.
+     * @param ref Receives the copy. Any frame previously held by `ref` is released.
+     *
+     * @return `true` on success, `false` if the frame is larger than a block or every block is in use.
+     */
+    bool copyFrame(const Frame& frame, FrameRef& ref);
+
+   private:
+    BufferArena(uint8_t* base, size_t block_size, size_t block_count, size_t mapped_size, bool huge_pages,
+                bool pinned);
+
+    static void releaseBlock(void* owner, const Frame& frame);
+
+    uint8_t* base_;
+    size_t block_size_;
+    size_t block_count_;
+    size_t mapped_size_;
+    bool huge_pages_;
+    bool pinned_;
+    BoundedQueue<uint32_t> free_;
+};
+
+/**
+ * @brief Returns the size in bytes of a frame of a camera mode, at its bit width rounded up to whole bytes.
+ */
+size_t modeFrameSize(const ArducamCameraConfig& config);
+/**
+ * @brief Returns the size of the largest frame of all the modes in `Camera::listMode()`.
+ *
+ * @return The size in bytes, or 0 if the modes cannot be listed.
+ */
+size_t largestModeSize(const Camera& camera);
+
+/**
+ * @brief Struct representing a fixed transfer configuration.
+ */
+struct TransferConfig {
+    /** The number of transfers, see `Camera::setTransfer()`. */
+    int transfer_count = 0;
+    /** The size of a transfer buffer in bytes, see `Camera::setTransfer()`. */
+    int buffer_size = 0;
+    /** The transfer memory type, see `Camera::setMemType()`. */
+    MemType mem_type = DMA;
+};
+
+/**
+ * @brief Fixes the transfer configuration of a camera to the one recommended for its largest mode.
+ *
+ * The camera switches to its largest mode, reads the recommended configuration (`Camera::getAutoTransfer()`),
+ * applies it with `Camera::setTransfer()`, which turns automatic adjustment off, and switches back. From then on the
+ * transfer buffers fit every mode and `switchModeKeepingTransfers()` does not need to size them again.
+ *
+ * @note Must be called while the camera is stopped.
+ *
+ * @param camera The camera.
+ * @param mem_type The transfer memory type.
+ * @param config Receives the applied configuration.
+ *
+ * @return `true` on success, `false` if a camera call failed.
+ */
+bool fixTransferConfig(Camera& camera, MemType mem_type, TransferConfig& config);
+/**
+ * @brief Switches the mode of a camera and restores a fixed transfer configuration.
+ *
+ * The camera is stopped, switched with `Camera::switchMode()`, given `config` again and restarted if `restart` is set.
+ *
+ * @return `true` on success, `false` if a camera call failed.
+ */
+bool switchModeKeepingTransfers(Camera& camera, uint32_t mode_id, const TransferConfig& config, bool restart = true);
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/RemapLut.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the options of the bulk user data functions.
+ */
+struct UserDataOptions {
+    /**
+     * The largest transfer tried, 1 to 255 bytes (the length of `Camera::readUserData()` is 8 bits). A transfer the
+     * firmware rejects with `UserdataLenError` is retried at half the size, and the smaller size is kept for the rest
+     * of the call; `UserDataStats::chunk` reports it, to pass in here next time.
+     */
+    uint32_t max_chunk = 255;
+    /** The page size of the EEPROM. Writes never cross a page boundary. 0 does not split at pages. */
+    uint32_t page_size = 0;
+    /** Reads every write back and compares it. */
+    bool verify = true;
+};
+
+/**
+ * @brief Struct representing the outcome of a bulk user data transfer.
+ */
+struct UserDataStats {
+    /** Number of `readUserData()` and `writeUserData()` calls, failed ones included. */
+    size_t transactions = 0;
+    /** Number of bytes written. 0 when `writeCalibration()` found the record already stored. */
+    size_t bytes_written = 0;
+    /** The transfer size the firmware accepted. */
+    uint32_t chunk = 0;
+};
+
+/**
+ * @brief Reads a range of the user data of a camera, in transfers as large as the firmware accepts.
+ *
+ * @param camera The camera.
+ * @param addr The first address.
+ * @param data Receives the data.
+ * @param size The number of bytes. The range must end at or below 65536.
+ * @param options The transfer options.
+ * @param stats Receives the counters if not null.
+ *
+ * @return `true` on success, `false` if a transfer failed or the range is out of the address space.
+ */
+bool readUserDataBulk(Camera& camera, uint32_t addr, uint8_t* data, size_t size,
+                      const UserDataOptions& options = UserDataOptions(), UserDataStats* stats = nullptr);
+/**
+ * @brief Writes a range of the user data of a camera, in transfers as large as the firmware accepts.
+ *
+ * @return `true` on success, `false` if a transfer failed, the range is out of the address space or, with
+ * `UserDataOptions::verify`, the data read back differs.
+ */
+bool writeUserDataBulk(Camera& camera, uint32_t addr, const uint8_t* data, size_t size,
+                       const UserDataOptions& options = UserDataOptions(), UserDataStats* stats = nullptr);
+
+/** The magic of a calibration record, `ACAL`. */
+constexpr uint32_t kCalibrationMagic = 0x4C414341;
+/** The version of the calibration record written by `encodeCalibration()`. */
+constexpr uint16_t kCalibrationVersion = 1;
+/** The size of the header of a calibration record. */
+constexpr size_t kCalibrationHeaderSize = 16;
+
+/**
+ * @brief Struct representing the calibration of one camera of a board.
+ */
+struct CameraCalibration {
+    /** The name of the camera, e.g. `"cam0"`. */
+    std::string name;
+    /** The sensor size the calibration was made at, 0 if unknown. */
+    uint32_t width = 0;
+    uint32_t height = 0;
+    /** The correction. */
+    CorrectionParams params;
+};
+
+/**
+ * @brief Encodes the calibrations of a board as a calibration record.
+ *
+ * The record is a 16 byte header (`kCalibrationMagic`, the version, the number of cameras, the payload size and a
+ * CRC-32 of the header and the payload, little-endian) followed by the cameras. Each camera is a list of tagged
+ * fields ended by tag 0: integers are varints and fields at their default value are left out, so a typical
+ * calibration with 5 radial and 8 perspective coefficients takes about 170 bytes. Readers skip unknown tags.
+ *
+ * The encoding is compact, not compressed: the coefficients are stored as whole little-endian doubles. A
+ * general-purpose compressor finds almost nothing to remove from so few of them.
+ *
+ * The remap tables are not stored: at 6 bytes per pixel they do not fit any EEPROM, and `RemapLut::build()` derives
+ * the same table from the stored correction.
+ */
+void encodeCalibration(const std::vector<CameraCalibration>& cameras, std::vector<uint8_t>& record);
+/**
+ * @brief Decodes a calibration record.
+ *
+ * @return `true` on success, `false` if the record is truncated, corrupt (CRC mismatch) or of a newer version.
+ */
+bool decodeCalibration(const uint8_t* record, size_t size, std::vector<CameraCalibration>& cameras);
+
+/**
+ * @brief Stores the calibrations of a board in the user data of a camera.
+ *
+ * The stored record at `addr` is read first: if all of it matches the new record, nothing is written, which spares
+ * the EEPROM and makes the call cheap to repeat. Only the header is read when it differs. The payload is written
+ * before the header, and a matching header over another payload (a write cut short) is rewritten.
+ *
+ * @return `true` on success, `false` if a transfer failed.
+ */
+bool writeCalibration(Camera& camera, const std::vector<CameraCalibration>& cameras, uint32_t addr = 0,
+                      const UserDataOptions& options = UserDataOptions(), UserDataStats* stats = nullptr);
+/**
+ * @brief Loads the calibrations of a board from the user data of a camera.
+ *
+ * Reads the header, then exactly the payload it announces. Build the correction of a camera from the result with
+ * `FrameCorrector::setParams()` and `FrameCorrector::prepare()`.
+ *
+ * @return `true` on success, `false` if a transfer failed or there is no valid record at `addr`.
+ */
+bool readCalibration(Camera& camera, std::vector<CameraCalibration>& cameras, uint32_t addr = 0,
+                     const UserDataOptions& options = UserDataOptions(), UserDataStats* stats = nullptr);
+
+/**
+ * @brief Finds the calibration of a camera by name.
+ *
+ * @return The calibration, or null if there is none.
+ */
+const CameraCalibration* findCalibration(const std::vector<CameraCalibration>& cameras, const std::string& name);
+
+}  // namespace Arducam
+
+/** @} */
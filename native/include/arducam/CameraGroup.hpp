@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BoundedQueue.hpp>
+#include <arducam/BufferArena.hpp>
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/FrameRef.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing one camera of a `CameraGroup`.
+ */
+struct GroupCameraSpec {
+    /** The configuration file, see `ArducamCameraOpenParam::config_file_name`. A `.bin` file is a binary config. */
+    std::string config_file_name;
+    /** The optional extra configuration file, see `ArducamCameraOpenParam::ext_config_file_name`. */
+    std::string ext_config_file_name;
+    /** The serial number of the device, as printed by `Demo.py`. Empty takes the first unused device. */
+    std::string serial;
+    /** The expected frame rate, used to share the USB bandwidth. 0 means as fast as its link allows. */
+    double fps = 0;
+};
+
+/**
+ * @brief Struct representing the options of a `CameraGroup`.
+ */
+struct CameraGroupOptions {
+    /** The transfer memory type of every camera, see `Camera::setMemType()`. */
+    MemType mem_type = DMA;
+    /** Number of threads draining the cameras. The cameras are spread round-robin over them. */
+    size_t io_threads = 1;
+    /** The CPU of every I/O thread. Empty or -1 leaves a thread unpinned. */
+    std::vector<int> io_cpus;
+    /** Number of threads running the frame handler. 0 runs the handler on the I/O threads. */
+    size_t workers = 2;
+    /** The CPU of every worker thread. Empty or -1 leaves a thread unpinned. */
+    std::vector<int> worker_cpus;
+    /**
+     * The maximum number of frames queued per worker. When every queue is full, the frame is dropped and its buffer
+     * handed back to the camera. Keep the total below the number of SDK frame buffers of a camera.
+     */
+    size_t worker_queue = 2;
+    /**
+     * The USB bandwidth shared by all cameras, in bytes per second. 0 uses the usable bandwidth of the fastest link,
+     * i.e. assumes that every camera hangs off one host controller, as on a Raspberry Pi.
+     */
+    double bandwidth_budget = 0;
+    /** The time of data the transfers of a camera keep in flight at its bandwidth share, in milliseconds. */
+    double transfer_window_ms = 20;
+};
+
+/**
+ * @brief Struct representing how the USB bandwidth of a group is shared by one camera.
+ */
+struct GroupCameraPlan {
+    /** The link speed of the device. */
+    ArducamUSBSpeed speed = USB_SPEED_UNKNOWN;
+    /** The usable bandwidth of the link, in bytes per second, see `usbBandwidth()`. */
+    double link_bandwidth = 0;
+    /** The size of a frame of the current mode. */
+    size_t frame_size = 0;
+    /** The bandwidth the camera asks for: `frame_size * fps`, or its link bandwidth. */
+    double demand = 0;
+    /** The bandwidth granted to the camera. */
+    double share = 0;
+    /** The frame rate the share allows. The sensor should not run faster, e.g. see `SensorWindow::frame_length`. */
+    double max_fps = 0;
+    /** The transfer configuration applied, sized for the share. */
+    TransferConfig transfers;
+};
+
+/**
+ * @brief Struct representing the counters of one camera of a `CameraGroup`.
+ */
+struct GroupCameraStats {
+    /** Number of frames taken from the camera. */
+    uint64_t frames = 0;
+    /** Number of frames dropped because every worker queue was full. */
+    uint64_t dropped = 0;
+    /** Number of frames handled by another worker than the one the camera is assigned to. */
+    uint64_t stolen = 0;
+};
+
+/**
+ * @brief Returns the bandwidth a bulk transfer achieves in practice at a USB speed, in bytes per second.
+ *
+ * An unknown speed is taken as high speed (USB 2).
+ */
+double usbBandwidth(ArducamUSBSpeed speed);
+
+/**
+ * @brief Opens and drives several cameras with a fixed set of threads.
+ *
+ * The SDK drives the USB transfers of every camera on threads of its own; what a group controls is everything after
+ * that. Instead of one capture thread (or a `Camera::CaptureCallback` thread) per camera, a few pinned I/O threads
+ * drain the output queues of all cameras. They sleep until a `FrameEnd` event of one of their cameras arrives and
+ * never run user code: a frame is queued to the worker the camera is assigned to, and an idle worker steals frames
+ * queued to the others, so a burst of one camera spreads over all workers while steady traffic stays on a warm core.
+ *
+ * When the group is opened, the USB bandwidth budget is shared by the cameras in proportion to their demand. The
+ * transfers of each camera are sized from the recommendation of `Camera::getAutoTransfer()` to cover its share, so a
+ * slow camera does not keep as many transfers in flight as a fast one.
+ */
+class CameraGroup {
+   public:
+    /**
+     * @brief Handles a frame.
+     *
+     * @param camera The index of the camera in the group.
+     * @param ref The frame. Dropping it hands the buffer back to the camera.
+     */
+    using FrameHandler = std::function<void(size_t camera, FrameRef ref)>;
+
+    /**
+     * @brief Opens and initializes the cameras and applies the bandwidth plan.
+     *
+     * @param cameras The cameras to open.
+     * @param options The options.
+     *
+     * @return The group, or null if a device was not found or a camera failed to open.
+     */
+    static std::unique_ptr<CameraGroup> open(const std::vector<GroupCameraSpec>& cameras,
+                                             const CameraGroupOptions& options = CameraGroupOptions());
+    CameraGroup(const CameraGroup&) = delete;
+    CameraGroup& operator=(const CameraGroup&) = delete;
+    /**
+     * @brief Stops the group and closes the cameras.
+     */
+    ~CameraGroup();
+
+    /** Returns the number of cameras. */
+    size_t size() const { return cameras_.size(); }
+    /** Returns a camera, e.g. to change its controls. Must not be captured from while the group runs. */
+    Camera& camera(size_t index) { return *cameras_[index]->camera; }
+    /** Returns the event dispatcher of a camera. */
+    EventDispatcher& events(size_t index) { return *cameras_[index]->events; }
+    /** Returns the bandwidth plan of a camera. */
+    const GroupCameraPlan& plan(size_t index) const { return cameras_[index]->plan; }
+    /** Checks if the cameras ask for more bandwidth than the budget or their links provide. */
+    bool oversubscribed() const { return oversubscribed_; }
+
+    /**
+     * @brief Starts every camera and the threads.
+     *
+     * @param handler The frame handler, called on the worker threads (concurrently for different frames).
+     *
+     * @return `true` on success, `false` if the group is running or a camera failed to start. On failure the cameras
+     * already started are stopped again.
+     */
+    bool start(FrameHandler handler);
+    /**
+     * @brief Stops the threads and the cameras. Queued frames are handled before the workers exit.
+     */
+    void stop();
+    /** Checks if the group is running. */
+    bool isRunning() const { return running_; }
+
+    /** Returns the counters of a camera. */
+    GroupCameraStats stats(size_t index) const;
+
+   private:
+    struct GroupFrame {
+        size_t camera = 0;
+        FrameRef ref;
+    };
+    struct Member {
+        std::unique_ptr<Camera> camera;
+        std::unique_ptr<EventDispatcher> events;
+        int listener = -1;
+        size_t index = 0;
+        size_t io_thread = 0;
+        GroupCameraPlan plan;
+        // events seen minus frames taken, owned by the I/O thread
+        int64_t credit = 0;
+        // number of `FrameEnd` events the I/O thread has not looked at yet
+        alignas(kCacheLineSize) std::atomic<uint32_t> pending{0};
+        alignas(kCacheLineSize) std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> stolen{0};
+    };
+    struct IoThread {
+        std::vector<Member*> cameras;
+        Notifier ready;
+        std::thread thread;
+    };
+    struct Worker {
+        explicit Worker(size_t capacity) : queue(capacity) {}
+        BoundedQueue<GroupFrame> queue;
+        std::thread thread;
+    };
+
+    CameraGroup() = default;
+
+    bool planBandwidth(const std::vector<GroupCameraSpec>& cameras);
+    void stopThreads();
+    void runIo(size_t index);
+    void runWorker(size_t index);
+    void handOff(size_t camera, FrameRef ref);
+    bool takeFrame(size_t worker, GroupFrame& frame);
+
+    CameraGroupOptions options_;
+    std::unique_ptr<DeviceList> devices_;
+    std::vector<std::unique_ptr<Member>> cameras_;
+    std::vector<std::unique_ptr<IoThread>> io_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    FrameHandler handler_;
+    Notifier work_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> workers_stopping_{false};
+    bool running_ = false;
+    bool oversubscribed_ = false;
+};
+
+}  // namespace Arducam
+
+/** @} */
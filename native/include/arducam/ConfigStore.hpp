@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/RegisterProgram.hpp>
+#include <arducam_config_parser.h>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the header of a compiled configuration, stored at offset 0.
+ *
+ * The file is laid out as the header, the `CameraParam`, the `Config` array, the `Control` array, one string offset
+ * per control and the control code strings, each section 8 byte aligned. The sections are the structs of
+ * `arducam_config_parser.h` as the writer lays them out, so that they are used in place; a file written by another
+ * ABI or byte order is rejected, never converted.
+ */
+struct CompiledConfigHeader {
+    /** `ARCC` */
+    char magic[4];
+    uint32_t version;
+    /** `0x01020304` as written by the host. */
+    uint32_t byte_order;
+    /** `sizeof` of `CameraParam`, `Config`, `Control` and of a pointer on the writer. */
+    uint16_t param_size;
+    uint16_t config_size;
+    uint16_t control_size;
+    uint16_t pointer_size;
+    /** The FNV-1a hash of the source configuration file, and its size in bytes. */
+    uint64_t source_hash;
+    uint64_t source_size;
+    /** The number of `Config` and `Control` entries. */
+    uint32_t config_count;
+    uint32_t control_count;
+    /** The offsets of the sections. */
+    uint64_t param_offset;
+    uint64_t configs_offset;
+    uint64_t controls_offset;
+    uint64_t code_offsets_offset;
+    uint64_t strings_offset;
+    /** The size of the file. */
+    uint64_t file_size;
+};
+
+/** Entry of the code offsets of a compiled configuration for a control without code. */
+constexpr uint32_t kNoControlCode = UINT32_MAX;
+
+/**
+ * @brief Returns the hash a compiled configuration is validated with: FNV-1a of the bytes of a file.
+ *
+ * @param path The configuration file.
+ * @param hash Receives the hash.
+ * @param size Receives the size of the file.
+ *
+ * @return `true` on success, `false` if the file cannot be read.
+ */
+bool hashConfigFile(const std::string& path, uint64_t& hash, uint64_t& size);
+
+/**
+ * @brief A parsed configuration file, stored in binary form and mapped in place.
+ *
+ * `arducam_parse_config()` tokenizes the text file and allocates the `Config` and `Control` arrays on every open,
+ * about 300 bytes per control with the name and function strings. `load()` parses a file once and writes the
+ * parsed arrays to a store next to it, keyed by the hash of the source. Every later `load()` hashes the source,
+ * maps the store and points into it: no text parsing, and the only allocation is the copy of the few controls whose
+ * `code` pointer is fixed up. A store whose source changed, or that was written by another build, is compiled again.
+ *
+ * The SDK's own `bin_config` format is not documented and cannot be written here, so the store does not go through
+ * `ArducamCameraOpenParam::config_file_name`. `openCompiled()` opens the camera without a configuration file and
+ * loads the mode from the store instead, as `ManagedCamera` does on a fast reopen.
+ *
+ * @note The mapping is read only. The arrays returned must not be modified or freed.
+ */
+class CompiledConfig {
+   public:
+    /**
+     * @brief Maps a compiled configuration.
+     *
+     * @param store_path The compiled configuration.
+     * @param source_hash The hash of the source, see `hashConfigFile()`.
+     * @param source_size The size of the source.
+     *
+     * @return The configuration, or null if the file cannot be mapped, is not a compiled configuration of this build
+     * or was compiled from another source.
+     */
+    static std::unique_ptr<CompiledConfig> open(const std::string& store_path, uint64_t source_hash,
+                                                uint64_t source_size);
+    /**
+     * @brief Maps the compiled form of a configuration file, compiling it first if the store is missing or stale.
+     *
+     * If the store cannot be written, e.g. in a read only directory, the configuration is compiled in memory and
+     * the next call parses again.
+     *
+     * @param cfg_path The configuration file.
+     * @param store_path The compiled configuration. An empty path means `cfg_path` with `.arcc` appended.
+     * @param compiled Receives `true` if the configuration file was parsed, `false` if the store was used.
+     *
+     * @return The configuration, or null if the configuration file cannot be read or parsed.
+     */
+    static std::unique_ptr<CompiledConfig> load(const std::string& cfg_path, const std::string& store_path = "",
+                                                bool* compiled = nullptr);
+    /**
+     * @brief Writes the compiled form of parsed configurations.
+     *
+     * The store is written to a temporary file and renamed, so that a process mapping the old store keeps its data.
+     *
+     * @return `true` on success, `false` if the file cannot be written.
+     */
+    static bool save(const std::string& store_path, const CameraConfigs& configs, uint64_t source_hash,
+                     uint64_t source_size);
+    CompiledConfig(const CompiledConfig&) = delete;
+    CompiledConfig& operator=(const CompiledConfig&) = delete;
+    ~CompiledConfig();
+
+    /** Returns the header. */
+    const CompiledConfigHeader& header() const { return *reinterpret_cast<const CompiledConfigHeader*>(base_); }
+    /** Returns the camera parameters. */
+    const CameraParam& cameraParam() const { return *param_; }
+    /** Returns the format of the mode, as `Camera::setConfig()` takes it. */
+    ArducamCameraConfig cameraConfig() const;
+    /** Returns the `Config` entries, pointing into the mapping. */
+    const Config* configs() const { return configs_; }
+    uint32_t configCount() const { return header().config_count; }
+    /** Returns the controls, as `Camera::registerControls()` takes them. Their `code` points into the mapping. */
+    const Control* controls() const { return controls_.data(); }
+    uint32_t controlCount() const { return static_cast<uint32_t>(controls_.size()); }
+    /**
+     * @brief Returns the configurations as `arducam_parse_config()` fills them, e.g. for `RegisterProgram::compile()`.
+     *
+     * The arrays are the ones of the configuration; they must not be freed.
+     */
+    CameraConfigs cameraConfigs() const;
+    /**
+     * @brief Compiles the register program of the mode for one USB type.
+     *
+     * @return `true` on success, `false` if the configuration has an invalid entry.
+     */
+    bool program(uint8_t usb_type, RegisterProgram& program) const {
+        return RegisterProgram::compile(cameraConfigs(), usb_type, program);
+    }
+
+   private:
+    CompiledConfig(const uint8_t* base, uint64_t size, intptr_t mapping);
+    // checks the layout and points the sections into `base_`
+    bool bind(uint64_t source_hash, uint64_t source_size);
+
+    const uint8_t* base_;
+    uint64_t size_;
+    // the file mapping, or 0 for a configuration compiled in memory
+    intptr_t mapping_;
+    bool mapped_;
+    std::vector<uint64_t> memory_;
+    const CameraParam* param_ = nullptr;
+    const Config* configs_ = nullptr;
+    std::vector<Control> controls_;
+};
+
+/**
+ * @brief Opens a camera with a compiled configuration, skipping the configuration file.
+ *
+ * Opens the device without a configuration file, sets the format, initializes the camera, runs the register program
+ * of the mode and registers the controls. The configuration must stay alive until the camera is closed:
+ * `Camera::registerControls()` keeps a pointer to the controls.
+ *
+ * @param camera The camera, closed.
+ * @param config The configuration.
+ * @param param The open parameters. The configuration file names and `bin_config` are ignored, the extra
+ * configuration file is loaded.
+ *
+ * @return `true` on success, `false` if any step failed. The camera is closed again then.
+ */
+bool openCompiled(Camera& camera, const CompiledConfig& config, const ArducamCameraOpenParam& param);
+
+}  // namespace Arducam
+
+/** @} */
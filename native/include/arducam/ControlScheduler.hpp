@@ -0,0 +1,217 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/FrameMetadata.hpp>
+#include <arducam/RegisterBatch.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/** Target of `ControlScheduler::schedule()` for the earliest frame the change can reach. */
+constexpr uint32_t kNextFrame = UINT32_MAX;
+
+/**
+ * @brief Struct representing a control setting, as passed to `Camera::setControl()`.
+ */
+struct ControlSetting {
+    std::string name;
+    int64_t value;
+};
+
+/**
+ * @brief Struct representing the outcome of a scheduled change.
+ */
+struct ControlResult {
+    /** The ticket returned by `ControlScheduler::schedule()`. */
+    uint64_t ticket = 0;
+    /** The requested frame, or `kNextFrame`. */
+    uint32_t target_seq = kNextFrame;
+    /** The sequence number of the first frame that reflects the change, `kNextFrame` if not `synced()` yet. */
+    uint32_t applied_seq = 0;
+    /** `true` if the change could not reach the requested frame and lands on `applied_seq` instead. */
+    bool late = false;
+    /** `false` if a control or register write failed. */
+    bool ok = false;
+    /** Time from the `FrameStart` event to the end of the commit, in microseconds. */
+    uint64_t commit_latency_us = 0;
+};
+
+/**
+ * @brief Struct representing the options of a `ControlScheduler`.
+ */
+struct ControlSchedulerOptions {
+    /** The register options. The commits are always wrapped in the group hold of `regs.group_hold_reg`. */
+    RegBatchOptions regs;
+    /**
+     * The number of frames between the `FrameStart` a change is committed on and the first frame that reflects it:
+     * a change written while frame `N` is exposed shows in frame `N + latency`. 1 for most controls of IMX708; set
+     * it to what the slowest scheduled control needs.
+     */
+    uint32_t latency = 1;
+    /** Called with the result of every change, on the worker thread. */
+    std::function<void(const ControlResult& result)> on_applied;
+    /**
+     * Receives the controls of every change with the frame they reach, for the settings the embedded data of the
+     * frames does not carry (e.g. the lens position). Must outlive the scheduler.
+     */
+    MetadataParser* metadata = nullptr;
+};
+
+/**
+ * @brief Counters of a `ControlScheduler`.
+ */
+struct ControlSchedulerStats {
+    /** Number of `FrameStart` events seen. */
+    uint64_t frames;
+    /** Number of commits, one per frame with due changes. */
+    uint64_t commits;
+    /** Number of changes applied. */
+    uint64_t changes;
+    /** Number of changes that missed their target frame. */
+    uint64_t late;
+    /** Number of commits that failed. */
+    uint64_t failures;
+    /** Time from the `FrameStart` event to the end of the last commit, in microseconds. */
+    uint64_t last_latency_us;
+};
+
+/**
+ * @brief Applies control and register changes on the frame they are meant for, and reports the frame that shows them.
+ *
+ * A change is tagged with the sequence number of the first frame it should affect. On the `FrameStart` of frame
+ * `target - latency`, every change due is committed in one group hold (controls through `Camera::setControl()`,
+ * registers merged as in `writeRegs()`), so the sensor takes them together and no frame mixes old and new settings.
+ * The result names the first frame that reflects each change: a sweep sets a step, waits for `ControlResult`, and
+ * keeps the first frame whose `seq` reaches `applied_seq`, instead of sleeping and throwing frames away.
+ *
+ * The scheduler counts `FrameStart` and `FrameEnd` events and learns the sequence numbers from the captured frames:
+ * pass every frame (or at least one after `start()`) to `observe()`. Changes for `kNextFrame` need no frames.
+ */
+class ControlScheduler {
+   public:
+    /**
+     * @brief Starts the worker and listens to the events of the camera.
+     *
+     * @param camera The camera. Must outlive the scheduler.
+     * @param events The event dispatcher of the camera. Must outlive the scheduler.
+     * @param options The options.
+     */
+    ControlScheduler(Camera& camera, EventDispatcher& events,
+                     ControlSchedulerOptions options = ControlSchedulerOptions());
+    ControlScheduler(const ControlScheduler&) = delete;
+    ControlScheduler& operator=(const ControlScheduler&) = delete;
+    ~ControlScheduler();
+
+    /**
+     * @brief Schedules a change.
+     *
+     * @param target_seq The sequence number of the first frame that should reflect the change, or `kNextFrame`.
+     * @param controls The controls to set.
+     * @param regs The registers to write, after the controls.
+     *
+     * @return The ticket of the change, never 0.
+     */
+    uint64_t schedule(uint32_t target_seq, const std::vector<ControlSetting>& controls,
+                      const std::vector<RegWrite>& regs = std::vector<RegWrite>());
+    /** @overload */
+    uint64_t schedule(uint32_t target_seq, const std::string& control, int64_t value) {
+        return schedule(target_seq, {ControlSetting{control, value}});
+    }
+    /**
+     * @brief Drops the changes not yet committed.
+     *
+     * @return The number of changes dropped. They get no result.
+     */
+    size_t cancel();
+
+    /**
+     * @brief Learns the sequence numbers from a captured frame. Cheap; call it with every frame.
+     */
+    void observe(const Frame& frame);
+    /** Checks if the sequence numbers are known, i.e. changes with a target frame can be committed. */
+    bool synced() const;
+    /**
+     * @brief Returns the sequence number of the frame that started last.
+     *
+     * @return The number, or `kNextFrame` before `synced()`.
+     */
+    uint32_t currentSeq() const;
+    /**
+     * @brief Returns the first frame a change scheduled now can reach: `currentSeq() + latency + 1`.
+     *
+     * @return The number, or `kNextFrame` before `synced()`.
+     */
+    uint32_t earliestSeq() const;
+
+    /**
+     * @brief Waits for the result of a change.
+     *
+     * @param ticket The ticket.
+     * @param result Receives the result.
+     * @param timeout The longest wait in milliseconds. Negative waits forever.
+     *
+     * @return `true` if the change was applied, `false` on timeout or if the ticket is unknown (cancelled, or one of
+     * more than the last 1024 results).
+     */
+    bool wait(uint64_t ticket, ControlResult& result, int timeout = 1500);
+    /** Returns the counters. */
+    ControlSchedulerStats stats() const;
+
+   private:
+    struct Entry {
+        uint64_t ticket;
+        uint32_t target_seq;
+        std::vector<ControlSetting> controls;
+        std::vector<RegWrite> regs;
+    };
+
+    void onEvent(EventCode event);
+    void run();
+    void commit(std::vector<Entry>& batch, uint64_t event_time_us);
+    // the sequence number of the frame that started last, mutex_ held
+    uint32_t startedSeqLocked() const;
+
+    Camera& camera_;
+    EventDispatcher& events_;
+    ControlSchedulerOptions options_;
+    int listener_ = -1;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable applied_;
+    uint64_t next_ticket_ = 1;
+    std::vector<Entry> pending_;
+    // the changes due on the last frame starts, for the worker
+    std::vector<Entry> due_;
+    // the changes the worker is writing
+    std::vector<Entry> committing_;
+    uint64_t due_time_us_ = 0;
+    uint64_t starts_ = 0;
+    uint64_t ends_ = 0;
+    // `seq - frame index`, learned by observe()
+    bool synced_ = false;
+    int64_t seq_offset_ = 0;
+    std::deque<ControlResult> results_;
+    bool stopping_ = false;
+    ControlSchedulerStats stats_{};
+    std::thread worker_;
+};
+
+}  // namespace Arducam
+
+/** @} */
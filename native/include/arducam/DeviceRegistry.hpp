@@ -0,0 +1,243 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BufferArena.hpp>
+#include <arducam/ConfigStore.hpp>
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/RegisterProgram.hpp>
+#include <arducam/Telemetry.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Returns the serial number of a device as text, as printed by `Demo.py`.
+ */
+std::string deviceSerial(const ArducamDevice& device);
+
+/**
+ * @brief Struct representing a device known to a `DeviceRegistry`.
+ */
+struct DeviceInfo {
+    std::string serial;
+    uint16_t vendor_id = 0;
+    uint16_t product_id = 0;
+    uint16_t usb_type = 0;
+    ArducamUSBSpeed speed = USB_SPEED_UNKNOWN;
+    /** The OS path of the device. */
+    std::string path;
+    /** Checks if the device was opened by another process (or a camera outside the registry) when listed. */
+    bool in_use = false;
+    /** Checks if the device is plugged in. A disconnected device keeps its entry. */
+    bool connected = false;
+};
+
+/**
+ * @brief Struct representing the options of a camera kept open by a `DeviceRegistry`.
+ */
+struct ManagedCameraOptions {
+    /** The serial number of the device. */
+    std::string serial;
+    /** The configuration file, see `ArducamCameraOpenParam::config_file_name`. A `.bin` file is a binary config. */
+    std::string config_file_name;
+    /** The optional extra configuration file, see `ArducamCameraOpenParam::ext_config_file_name`. */
+    std::string ext_config_file_name;
+    /**
+     * The compiled form of `config_file_name`, see `CompiledConfig::load()`. With it, the first open also skips the
+     * configuration parser. Empty compiles nothing; ignored for a binary config.
+     */
+    std::string config_store;
+    /** The transfer memory type. */
+    MemType mem_type = DMA;
+    /** The transfer configuration. A `transfer_count` of 0 keeps the one chosen by the SDK. */
+    TransferConfig transfers;
+};
+
+/**
+ * @brief Struct representing the counters of a `ManagedCamera`.
+ */
+struct ManagedCameraStats {
+    /** Number of times the device was unplugged. */
+    uint64_t disconnects = 0;
+    /** Number of successful reopens. */
+    uint64_t reopens = 0;
+    /** Number of reopens that went through the cached program instead of the configuration file. */
+    uint64_t fast_reopens = 0;
+    /** Number of reopens that failed. The next `DeviceConnect` retries. */
+    uint64_t failed_reopens = 0;
+    /** Duration of the last reopen, from the `DeviceConnect` event to the restarted camera, in microseconds. */
+    uint64_t last_reopen_us = 0;
+};
+
+/**
+ * @brief A camera that a `DeviceRegistry` reopens when its device comes back.
+ *
+ * The first open parses the configuration file as usual. Its sensor and board writes are kept as a
+ * `RegisterProgram`, next to the camera configuration and a copy of the controls, so a reopen skips the parser: the
+ * camera is opened without a configuration file, configured with `Camera::setConfig()`, initialized, and the program
+ * and controls are replayed. The control values set through `setControl()`, the transfer configuration and the
+ * running state are restored afterwards. Binary configurations are always reopened from the file.
+ *
+ * The `EventDispatcher` of the camera survives reopens, so listeners stay registered.
+ *
+ * @note While the device is gone and during a reopen, `camera()` is closed: captures fail or time out.
+ */
+class ManagedCamera {
+   public:
+    ManagedCamera(const ManagedCamera&) = delete;
+    ManagedCamera& operator=(const ManagedCamera&) = delete;
+    ~ManagedCamera();
+
+    /** Returns the camera. */
+    Camera& camera() { return camera_; }
+    /** Returns the event dispatcher of the camera. */
+    EventDispatcher& events() { return *events_; }
+    /** Returns the options. */
+    const ManagedCameraOptions& options() const { return options_; }
+
+    /** Starts the camera; it is started again after every reopen. */
+    bool start();
+    /** Stops the camera; it stays stopped after a reopen. */
+    bool stop();
+    /**
+     * @brief Sets a control and remembers its value for the reopens.
+     */
+    bool setControl(const std::string& name, int64_t value);
+    /** Checks if the camera is open, i.e. the device is connected and was reopened. */
+    bool isOpen() const;
+    /** Returns the counters. */
+    ManagedCameraStats stats() const;
+
+   private:
+    friend class DeviceRegistry;
+
+    explicit ManagedCamera(ManagedCameraOptions options);
+
+    bool openFull(DeviceHandle device);
+    bool openFast(DeviceHandle device);
+    // loads the mode from `config_store` for openFast()
+    bool loadCompiled();
+    bool restore();
+    void onDisconnect();
+    bool reopen(DeviceHandle device, uint64_t since_us);
+
+    ManagedCameraOptions options_;
+    Camera camera_;
+    std::unique_ptr<EventDispatcher> events_;
+
+    mutable std::mutex mutex_;
+    bool open_ = false;
+    bool running_ = false;
+    ArducamCameraConfig config_{};
+    bool has_program_ = false;
+    RegisterProgram program_;
+    std::unique_ptr<CompiledConfig> compiled_;
+    // `Camera::registerControls()` keeps a pointer to the array until the camera is closed
+    std::vector<Control> controls_;
+    std::vector<std::string> control_code_;
+    std::vector<std::pair<std::string, int64_t>> control_values_;
+    ManagedCameraStats stats_;
+};
+
+/**
+ * @brief Keeps track of the connected devices and reopens the cameras of those that were unplugged.
+ *
+ * The devices are listed once and then kept up to date from the `DeviceConnect` and `DeviceDisconnect` events of
+ * the `DeviceList`, indexed by serial number. The events are handled on a thread of the registry: a disconnect
+ * closes the camera of the device, a connect refreshes the list and reopens the cameras whose device is back.
+ */
+class DeviceRegistry {
+   public:
+    /**
+     * @brief Called on the registry thread when a device is connected or disconnected.
+     *
+     * @param serial The serial number of the device.
+     * @param connected `true` if the device was connected (and its camera reopened, if any).
+     */
+    using StateCallback = std::function<void(const std::string& serial, bool connected)>;
+
+    /**
+     * @brief Lists the devices and starts listening to hot-plug events.
+     *
+     * @param callback The state callback, or null.
+     * @param telemetry Counts the device events, or null. Must outlive the registry.
+     */
+    explicit DeviceRegistry(StateCallback callback = nullptr, DeviceTelemetry* telemetry = nullptr);
+    DeviceRegistry(const DeviceRegistry&) = delete;
+    DeviceRegistry& operator=(const DeviceRegistry&) = delete;
+    /**
+     * @brief Stops listening and closes every camera.
+     */
+    ~DeviceRegistry();
+
+    /** Returns the known devices, connected or not. */
+    std::vector<DeviceInfo> devices() const;
+    /**
+     * @brief Returns a device by serial number.
+     *
+     * @return `true` if the device is known, `false` otherwise.
+     */
+    bool device(const std::string& serial, DeviceInfo& info) const;
+
+    /**
+     * @brief Opens the camera of a connected device and keeps it open across disconnects.
+     *
+     * @return The camera, owned by the registry, or null if the device is not connected or the camera could not be
+     * opened. Opening a device twice returns the same camera.
+     */
+    ManagedCamera* open(const ManagedCameraOptions& options);
+    /**
+     * @brief Closes a camera opened with `open()`.
+     */
+    void close(const std::string& serial);
+
+   private:
+    struct Entry {
+        DeviceInfo info;
+        DeviceHandle handle = nullptr;
+    };
+    struct Event {
+        EventCode code;
+        std::string serial;
+        uint64_t time_us;
+    };
+
+    void onEvent(EventCode code, DeviceHandle device);
+    void run();
+    // updates the index from the list, refreshed first if `refresh`; must hold `mutex_`
+    void reindex(bool refresh);
+
+    StateCallback callback_;
+    DeviceTelemetry* telemetry_;
+    DeviceList list_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    std::map<std::string, std::unique_ptr<ManagedCamera>> cameras_;
+
+    std::mutex events_mutex_;
+    std::condition_variable events_cv_;
+    std::deque<Event> events_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+}  // namespace Arducam
+
+/** @} */
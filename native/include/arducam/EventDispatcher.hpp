@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Shares the single event callback of a camera between several listeners.
+ *
+ * `Camera::setEventCallback()` only accepts one function. An `EventDispatcher` registers itself as that function and
+ * forwards every event to all of its listeners, so independent stages (stereo pairing, control scheduling,
+ * telemetry, ...) can all react to `FrameStart`, `SyncTime` or transfer errors.
+ *
+ * @note Listeners run on the SDK event thread and must return quickly.
+ */
+class EventDispatcher {
+   public:
+    /**
+     * Defines a function type for an event listener.
+     *
+     * @param event The event code representing the type of event that occurred.
+     */
+    using Listener = std::function<void(EventCode event)>;
+
+   public:
+    /**
+     * @brief Constructs a dispatcher and registers it as the event callback of the camera.
+     *
+     * @param camera The camera to listen to. Must outlive the dispatcher.
+     */
+    explicit EventDispatcher(Camera& camera);
+    EventDispatcher(const EventDispatcher&) = delete;
+    EventDispatcher& operator=(const EventDispatcher&) = delete;
+    /**
+     * @brief Destructor for the EventDispatcher class. Clears the event callback of the camera.
+     */
+    ~EventDispatcher() noexcept;
+
+    /**
+     * @brief Adds a listener.
+     *
+     * @param listener The function to call for every event.
+     *
+     * @return An id to pass to `removeListener()`.
+     */
+    int addListener(Listener listener);
+    /**
+     * @brief Removes a listener. The listener may still be running on the event thread when this returns.
+     *
+     * @param id The id returned by `addListener()`.
+     */
+    void removeListener(int id);
+
+    /**
+     * @brief Forwards an event to every listener.
+     *
+     * This is what the camera event callback does. It can be called directly to inject events.
+     *
+     * @param event The event to forward.
+     */
+    void dispatch(EventCode event) const;
+
+    /** Returns the camera the dispatcher listens to. */
+    Camera& camera() const { return *camera_; }
+
+   private:
+    using ListenerList = std::vector<std::pair<int, Listener>>;
+
+    Camera* camera_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<const ListenerList> listeners_;
+    int next_id_ = 0;
+};
+
+}  // namespace Arducam
+
+/** @} */
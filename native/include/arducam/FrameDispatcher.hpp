@@ -0,0 +1,232 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arducam/BoundedQueue.hpp>
+#include <arducam/FrameRef.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Policy applied when a frame is dispatched to a subscriber whose queue is full.
+ */
+enum class DropPolicy : uint8_t {
+    DropOldest = 0x00, /**< Discard the oldest queued frame to make room for the new one */
+    DropNewest = 0x01, /**< Discard the new frame */
+    Block = 0x02,      /**< Wait until the subscriber makes room (stalls every other subscriber) */
+};
+
+/**
+ * @brief Backpressure counters of a frame subscriber.
+ */
+struct SubscriberStats {
+    /** Number of frames queued for the subscriber. */
+    uint64_t delivered;
+    /** Number of frames taken by the subscriber. */
+    uint64_t consumed;
+    /** Number of queued frames discarded because of `DropPolicy::DropOldest`. */
+    uint64_t dropped_oldest;
+    /** Number of new frames discarded because of `DropPolicy::DropNewest`. */
+    uint64_t dropped_newest;
+    /** Time the dispatcher spent waiting on the subscriber because of `DropPolicy::Block`, in microseconds. */
+    uint64_t blocked_us;
+    /** Current number of queued frames. */
+    uint32_t depth;
+    /** Highest number of queued frames observed. */
+    uint32_t max_depth;
+};
+
+/**
+ * @brief A consumer of the frames dispatched by a `FrameDispatcher`.
+ *
+ * Each subscriber owns a bounded lock-free queue of `FrameRef` handles that all share the same frame buffers, so
+ * several subscribers never copy frame data. A subscriber is consumed by a single thread of the caller's choosing.
+ */
+class FrameSubscriber {
+   public:
+    FrameSubscriber(std::string name, size_t capacity, DropPolicy policy);
+    FrameSubscriber(const FrameSubscriber&) = delete;
+    FrameSubscriber& operator=(const FrameSubscriber&) = delete;
+
+    /**
+     * @brief Takes the oldest queued frame without waiting.
+     *
+     * @param ref Receives the frame.
+     *
+     * @return `true` if a frame was available, `false` otherwise.
+     */
+    bool tryPop(FrameRef& ref);
+    /**
+     * @brief Takes the oldest queued frame, waiting for one if the queue is empty.
+     *
+     * @param ref Receives the frame.
+     * @param timeout The maximum time to wait, in milliseconds. negative value means forever.
+     *
+     * @return `true` if a frame was received, `false` on timeout or if the subscriber was closed and drained.
+     */
+    bool pop(FrameRef& ref, int timeout = 1500);
+    /**
+     * @brief Takes the newest queued frame and discards the older ones.
+     *
+     * @param ref Receives the frame. Left untouched if the queue is empty.
+     *
+     * @return `true` if a frame was available, `false` otherwise.
+     */
+    bool popLatest(FrameRef& ref);
+
+    /** Returns the name of the subscriber. */
+    const std::string& name() const { return name_; }
+    /** Returns the drop policy of the subscriber. */
+    DropPolicy policy() const { return policy_; }
+    /** Returns the capacity of the subscriber queue. */
+    size_t capacity() const { return queue_.capacity(); }
+    /** Checks if the subscriber was closed. Queued frames may still be popped. */
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+    /** Returns a snapshot of the backpressure counters. */
+    SubscriberStats stats() const;
+    /** Resets the backpressure counters. */
+    void resetStats();
+
+   private:
+    friend class FrameDispatcher;
+
+    // called by the thread running `dispatch()`
+    void offer(FrameRef ref, const std::atomic<bool>& abort);
+    // called by `unsubscribe()` from any thread, possibly while `offer()` runs
+    void close();
+    // releases the queued frames
+    void drain();
+
+    const std::string name_;
+    const DropPolicy policy_;
+    BoundedQueue<FrameRef> queue_;
+    Notifier readable_;
+    Notifier writable_;
+    std::atomic<bool> closed_{false};
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> delivered_{0};
+    std::atomic<uint64_t> dropped_oldest_{0};
+    std::atomic<uint64_t> dropped_newest_{0};
+    std::atomic<uint64_t> blocked_us_{0};
+    std::atomic<uint32_t> max_depth_{0};
+    alignas(kCacheLineSize) std::atomic<uint64_t> consumed_{0};
+};
+
+/**
+ * @brief Distributes the frames of a camera to several subscribers.
+ *
+ * The dispatcher drains the output queue of the camera with `Camera::capture()` on its own thread and hands a
+ * `FrameRef` to every subscriber queue. It never runs user code, so a slow consumer can only fill its own queue, and
+ * never stalls the SDK transfer thread the way a slow `Camera::CaptureCallback` does. `DropPolicy::Block` is the only
+ * policy that lets one subscriber hold back the others.
+ *
+ * @note The dispatcher uses the polling API, so it can not be used together with `Camera::setCaptureCallback()`.
+ */
+class FrameDispatcher {
+   public:
+    /**
+     * @brief Constructs a dispatcher for a camera.
+     *
+     * @param camera The camera to dispatch the frames of. Must outlive the dispatcher and every dispatched frame.
+     */
+    explicit FrameDispatcher(Camera& camera);
+    /**
+     * @brief Constructs a dispatcher without a camera. Frames must be fed through `dispatch()`.
+     */
+    FrameDispatcher();
+    FrameDispatcher(const FrameDispatcher&) = delete;
+    FrameDispatcher& operator=(const FrameDispatcher&) = delete;
+    /**
+     * @brief Destructor for the FrameDispatcher class. Stops the dispatcher thread.
+     */
+    ~FrameDispatcher() noexcept;
+
+    /**
+     * @brief Adds a subscriber. May be called while the dispatcher is running.
+     *
+     * @param name The name of the subscriber, used for diagnostics.
+     * @param capacity The maximum number of queued frames. Keep it below the number of SDK frame buffers, otherwise
+     * the subscriber can starve the input queue of the camera.
+     * @param policy The policy applied when the queue is full.
+     *
+     * @return The new subscriber.
+     */
+    std::shared_ptr<FrameSubscriber> subscribe(const std::string& name, size_t capacity = 4,
+                                               DropPolicy policy = DropPolicy::DropOldest);
+    /**
+     * @brief Removes a subscriber. The subscriber is closed and its queued frames are released.
+     *
+     * @param subscriber The subscriber to remove.
+     */
+    void unsubscribe(const std::shared_ptr<FrameSubscriber>& subscriber);
+    /**
+     * @brief Returns the current subscribers.
+     */
+    std::vector<std::shared_ptr<FrameSubscriber>> subscribers() const;
+
+    /**
+     * @brief Starts the dispatcher thread.
+     *
+     * The camera must be started separately with `Camera::start()`.
+     *
+     * @return `true` if the thread was started, `false` if there is no camera or it is already running.
+     */
+    bool start();
+    /**
+     * @brief Stops the dispatcher thread. Queued frames stay available to the subscribers.
+     */
+    void stop();
+    /** Checks if the dispatcher thread is running. */
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+    /**
+     * @brief Attaches the metadata of every dispatched frame before it is shared, so that every subscriber gets it
+     * with the frame. Frames that already carry metadata are left alone.
+     *
+     * @param parser The parser, or null to attach nothing. Must outlive the dispatcher; set it before `start()`.
+     */
+    void setMetadataParser(MetadataParser* parser) { metadata_ = parser; }
+
+    /**
+     * @brief Hands a frame to every subscriber.
+     *
+     * This is what the dispatcher thread does for each captured frame. It can be called directly to feed frames from
+     * another source, but must not be called concurrently with itself.
+     *
+     * @param ref The frame to dispatch.
+     */
+    void dispatch(FrameRef ref);
+
+   private:
+    using SubscriberList = std::vector<std::shared_ptr<FrameSubscriber>>;
+
+    void run();
+
+    Camera* camera_ = nullptr;
+    MetadataParser* metadata_ = nullptr;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> stopping_{false};
+
+    mutable std::mutex mutex_;
+    SubscriberList subscribers_;
+    std::atomic<uint64_t> version_{0};
+
+    // owned by the dispatching thread
+    SubscriberList snapshot_;
+    uint64_t snapshot_version_ = 0;
+};
+
+}  // namespace Arducam
+
+/** @} */
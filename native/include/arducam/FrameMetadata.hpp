@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/PixelKernels.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+class FrameRef;
+
+/** Flag of `FrameMetadata::valid`: `exposure_lines` was read from the embedded data. */
+constexpr uint32_t kMetaExposure = 0x01;
+/** Flag of `FrameMetadata::valid`: `analogue_gain_code` was read from the embedded data. */
+constexpr uint32_t kMetaAnalogueGain = 0x02;
+/** Flag of `FrameMetadata::valid`: `digital_gain_code` was read from the embedded data. */
+constexpr uint32_t kMetaDigitalGain = 0x04;
+/** Flag of `FrameMetadata::valid`: `frame_length_lines` was read from the embedded data. */
+constexpr uint32_t kMetaFrameLength = 0x08;
+/** Flag of `FrameMetadata::valid`: `line_length_pck` was read from the embedded data. */
+constexpr uint32_t kMetaLineLength = 0x10;
+/** Flag of `FrameMetadata::valid`: `temperature` was read from the embedded data. */
+constexpr uint32_t kMetaTemperature = 0x20;
+/** Flag of `FrameMetadata::valid`: `frame_count` was read from the embedded data. */
+constexpr uint32_t kMetaFrameCount = 0x40;
+/** Flag of `FrameMetadata::valid`: `lens_position` is the focus control in effect for the frame. */
+constexpr uint32_t kMetaLensPosition = 0x80;
+
+/** The number of extra registers a `FrameMetadata` holds, see `MetadataOptions::registers`. */
+constexpr size_t kMetaMaxRegisters = 8;
+
+/**
+ * @brief Struct representing the metadata of one frame: the fields of `ArducamImageFrame` and the sensor settings the
+ * frame was exposed with.
+ *
+ * The struct has a fixed size and no pointers, so that it can be copied along with a frame and stored as is.
+ */
+struct FrameMetadata {
+    /** The fields set, `kMeta*` flags. The firmware fields are always set. */
+    uint32_t valid = 0;
+
+    /** The firmware fields of the frame. @see ArducamImageFrame */
+    uint32_t seq = 0;
+    uint64_t timestamp = 0;
+    uint32_t size = 0;
+    uint32_t expected_size = 0;
+
+    /** The coarse integration time, in lines. */
+    uint32_t exposure_lines = 0;
+    /** The analogue gain register, `gain = 1024 / (1024 - code)` on IMX708. */
+    uint16_t analogue_gain_code = 0;
+    /** The digital gain register, `gain = code / 256`. */
+    uint16_t digital_gain_code = 0;
+    /** The frame length in lines and the line length in pixel clocks. */
+    uint16_t frame_length_lines = 0;
+    uint16_t line_length_pck = 0;
+    /** The sensor temperature in degrees Celsius. */
+    int8_t temperature = 0;
+    /** The frame counter of the sensor, wrapping at 255. */
+    uint8_t frame_count = 0;
+    /** The value of the focus control, see `MetadataOptions::lens_control`. */
+    int32_t lens_position = 0;
+
+    /** The extra registers of `MetadataOptions::registers`. Bit `i` of `register_valid` is set if `registers[i]` is. */
+    uint8_t register_valid = 0;
+    uint8_t registers[kMetaMaxRegisters] = {};
+
+    /** Checks if all the `kMeta*` flags of `flags` are set. */
+    bool has(uint32_t flags) const { return (valid & flags) == flags; }
+    /** Returns the analogue gain of IMX708. */
+    double analogueGain() const { return 1024.0 / (1024.0 - analogue_gain_code); }
+    /** Returns the digital gain. */
+    double digitalGain() const { return digital_gain_code / 256.0; }
+    /**
+     * @brief Returns the exposure time in microseconds.
+     *
+     * @param pixel_rate The pixel rate of the sensor mode, in pixels per second.
+     */
+    double exposureUs(double pixel_rate) const {
+        return pixel_rate > 0 ? exposure_lines * static_cast<double>(line_length_pck) * 1e6 / pixel_rate : 0;
+    }
+};
+
+/**
+ * @brief Struct representing the options of a `MetadataParser`.
+ */
+struct MetadataOptions {
+    /** The first embedded data line in the frame buffer, and the number of lines. IMX708 sends 2 lines on top. */
+    uint32_t embedded_row = 0;
+    uint32_t embedded_lines = 2;
+    /** The packing of the lines. `PixelPacking::Unknown` uses the packing of the frame, see `detectPacking()`. */
+    PixelPacking packing = PixelPacking::Unknown;
+    /** The registers of the standard fields, IMX708 (and CCS) addresses by default. */
+    uint16_t exposure_reg = 0x0202;
+    uint16_t analogue_gain_reg = 0x0204;
+    uint16_t digital_gain_reg = 0x020E;
+    uint16_t frame_length_reg = 0x0340;
+    uint16_t line_length_reg = 0x0342;
+    uint16_t temperature_reg = 0x013A;
+    uint16_t frame_count_reg = 0x0005;
+    /** More registers to read into `FrameMetadata::registers`, at most `kMetaMaxRegisters`. */
+    std::vector<uint16_t> registers;
+    /** The control whose value is reported as `lens_position`, compared without case. Empty disables it. */
+    std::string lens_control = "focus";
+};
+
+/**
+ * @brief Counters of a `MetadataParser`.
+ */
+struct MetadataStats {
+    /** Number of frames parsed. */
+    uint64_t frames = 0;
+    /** Number of frames whose embedded data lines could not be read. */
+    uint64_t missing = 0;
+};
+
+/**
+ * @brief Reads the metadata of frames from the embedded data lines the sensor sends with every frame.
+ *
+ * The embedded data lines of IMX708 (the SMIA / MIPI CCS format) dump the sensor registers as they were when the frame
+ * was exposed: the line starts with `0x0A`, followed by tag and value bytes that set the register address (`0xAA`,
+ * `0xA5`), give the value of the next register (`0x5A`) or skip it (`0x55`), up to `0x07`. In a packed line the
+ * bytes holding the low bits of 4 (RAW10) or 2 (RAW12) samples are padding. Reading the settings there, instead of
+ * reading the registers back with `readSensorReg()` after the capture, costs no I2C transfer and always gives the
+ * settings of this very frame, even while a `ControlScheduler` changes them from frame to frame.
+ *
+ * Settings that are not sensor registers, like the lens position of the VCM, come from the controls the application
+ * sets: pass them to `noteControl()` (a `ControlScheduler` with `ControlSchedulerOptions::metadata` does it for every
+ * change it commits) and they are reported from the frame they reach on.
+ *
+ * @note `parse()` and `noteControl()` may be called from different threads; `parse()` from one thread at a time.
+ */
+class MetadataParser {
+   public:
+    explicit MetadataParser(const MetadataOptions& options = MetadataOptions());
+    MetadataParser(const MetadataParser&) = delete;
+    MetadataParser& operator=(const MetadataParser&) = delete;
+
+    /**
+     * @brief Reads the metadata of a frame.
+     *
+     * @param frame The frame.
+     * @param metadata Receives the metadata. The firmware fields are always filled.
+     *
+     * @return `true` if the embedded data lines were read, `false` if the frame has none.
+     */
+    bool parse(const Frame& frame, FrameMetadata& metadata);
+    /**
+     * @brief Reads the metadata of a frame and attaches it to the handle, see `FrameRef::metadata()`.
+     *
+     * @return `true` if the embedded data lines were read, `false` if the frame has none or the handle is empty.
+     */
+    bool parse(FrameRef& frame);
+    /**
+     * @brief Records the value of a control from the frame a change reaches on.
+     *
+     * @param from_seq The first frame that reflects the value, e.g. `ControlResult::applied_seq`. `UINT32_MAX` (e.g.
+     * `kNextFrame` of a scheduler not synced yet) means the next frame parsed.
+     * @param name The control.
+     * @param value The value.
+     */
+    void noteControl(uint32_t from_seq, const std::string& name, int64_t value);
+
+    /** Returns the counters. */
+    MetadataStats stats() const;
+
+   private:
+    struct Change {
+        uint32_t from_seq;
+        int32_t value;
+    };
+
+    // reads the wanted registers of one line into `values`, returns false if it is not an embedded data line
+    bool parseLine(const uint8_t* line, size_t size, PixelPacking packing, uint8_t bit_width, uint8_t* values,
+                   uint64_t& seen) const;
+    // the index of a register in `wanted_`, or -1
+    int find(uint16_t address) const;
+    // assembles the register bytes `address` and `address + 1` if both were read
+    bool value16(const uint8_t* values, uint64_t seen, uint16_t address, uint32_t& value) const;
+    bool value8(const uint8_t* values, uint64_t seen, uint16_t address, uint8_t& value) const;
+
+    MetadataOptions options_;
+    // the register bytes read, sorted
+    std::vector<uint16_t> wanted_;
+
+    mutable std::mutex mutex_;
+    std::deque<Change> changes_;
+    bool has_lens_ = false;
+    int32_t lens_position_ = 0;
+    MetadataStats stats_;
+};
+
+}  // namespace Arducam
+
+/** @} */
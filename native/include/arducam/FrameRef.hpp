@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/FrameMetadata.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief A reference counted handle to a frame buffer owned by the Arducam SDK.
+ *
+ * A `FrameRef` wraps the `Frame` returned by `Camera::capture()` without copying its data. The buffer is returned to
+ * the input queue of the camera (`Camera::freeImage()`) when the last handle referring to it is destroyed or reset.
+ *
+ * The handle is move-only so that sharing is always explicit: call `share()` to obtain another reference to the same
+ * buffer, e.g. to hand it to a second processing stage or thread. All handles are safe to use from different threads.
+ *
+ * @note The `Camera` that produced the frame must outlive every handle referring to its buffers.
+ */
+class FrameRef {
+   public:
+    /**
+     * @brief Function pointer type for a function that returns a frame buffer to its owner.
+     *
+     * @param owner The owner passed to `FrameRef::wrap()`.
+     * @param frame The frame to return.
+     */
+    using Releaser = void (*)(void* owner, const Frame& frame);
+
+   public:
+    /**
+     * @brief Constructs an empty handle.
+     */
+    FrameRef() noexcept = default;
+    FrameRef(const FrameRef&) = delete;
+    FrameRef& operator=(const FrameRef&) = delete;
+    /**
+     * @brief Move constructor for the FrameRef class.
+     *
+     * The moved-from handle becomes empty. No reference count is touched.
+     *
+     * @param other The FrameRef object to move from.
+     */
+    FrameRef(FrameRef&& other) noexcept : block_(other.block_) { other.block_ = nullptr; }
+    /**
+     * @brief Move assignment operator for the FrameRef class.
+     *
+     * The previously referenced buffer, if any, is released first.
+     *
+     * @param other The FrameRef object to move from.
+     */
+    FrameRef& operator=(FrameRef&& other) noexcept {
+        if (this != &other) {
+            reset();
+            block_ = other.block_;
+            other.block_ = nullptr;
+        }
+        return *this;
+    }
+    ~FrameRef() noexcept { reset(); }
+
+    /**
+     * @brief Takes ownership of a frame obtained from `Camera::capture()`.
+     *
+     * @param camera The camera that produced the frame.
+     * @param frame The frame to adopt. The caller must not call `Camera::freeImage()` on it anymore.
+     *
+     * @return A handle holding the only reference to the frame, or an empty handle if `frame.data` is null.
+     */
+    static FrameRef adopt(Camera& camera, const Frame& frame);
+    /**
+     * @brief Takes ownership of a frame buffer with a custom release function.
+     *
+     * This is used by frame sources that do not come from `Camera::capture()` (replay, synthetic frames, ...).
+     *
+     * @param frame The frame to wrap.
+     * @param owner An opaque pointer passed to `releaser`.
+     * @param releaser The function called once the last reference goes away. May be `nullptr`.
+     *
+     * @return A handle holding the only reference to the frame, or an empty handle if `frame.data` is null.
+     */
+    static FrameRef wrap(const Frame& frame, void* owner, Releaser releaser);
+
+    /**
+     * @brief Returns another handle to the same frame buffer.
+     *
+     * @return A new handle, or an empty handle if this one is empty.
+     */
+    FrameRef share() const noexcept;
+    /**
+     * @brief Drops this reference. The buffer is returned to its owner if this was the last reference.
+     */
+    void reset() noexcept;
+    /**
+     * @brief Releases the frame from reference counting without returning it to its owner.
+     *
+     * Only valid if this is the last reference. The caller becomes responsible for returning the buffer.
+     *
+     * @param frame Receives the frame.
+     *
+     * @return `true` if the frame was released, `false` if the handle is empty or still shared.
+     */
+    bool release(Frame& frame) noexcept;
+
+    /** Checks if the handle refers to a frame. */
+    explicit operator bool() const noexcept { return block_ != nullptr; }
+    /**
+     * @brief Returns the number of handles referring to the same frame buffer.
+     *
+     * @note The value may be outdated as soon as it is returned if other threads hold references.
+     */
+    uint32_t useCount() const noexcept;
+
+    /**
+     * @brief Returns the wrapped frame.
+     *
+     * @note Must not be called on an empty handle.
+     */
+    const Frame& frame() const noexcept;
+    /** Pointer to the data of the frame buffer. (null if empty) */
+    const uint8_t* data() const noexcept;
+    /** Size of the real frame buffer data. (0 if empty) */
+    uint32_t size() const noexcept;
+    /** Sequence number of the frame buffer. */
+    uint32_t seq() const noexcept { return frame().seq; }
+    /** Timestamp of the frame buffer. @see ArducamImageFrame::timestamp */
+    uint64_t timestamp() const noexcept { return frame().timestamp; }
+    /** Format of the frame buffer. */
+    const ArducamFrameFormat& format() const noexcept { return frame().format; }
+    /**
+     * @brief Returns the metadata attached to the frame, see `MetadataParser::parse()`.
+     *
+     * @return The metadata, or null if the handle is empty or no metadata was attached.
+     */
+    const FrameMetadata* metadata() const noexcept;
+    /**
+     * @brief Attaches metadata to the frame. Every handle to the frame sees it.
+     *
+     * @note Not synchronized: attach the metadata before the handle is shared with other threads.
+     */
+    void setMetadata(const FrameMetadata& metadata) noexcept;
+
+   private:
+    struct Block;
+    explicit FrameRef(Block* block) noexcept : block_(block) {}
+
+    Block* block_ = nullptr;
+};
+
+/**
+ * @brief Receives a frame from the Arducam camera as a reference counted handle.
+ *
+ * Same as `Camera::capture()`, but the frame is returned to the camera automatically once the last handle is dropped.
+ *
+ * @param camera The camera to capture from.
+ * @param ref Receives the frame. Any frame previously held by `ref` is released.
+ * @param timeout The maximum time to wait for a frame to be available, in milliseconds.
+ *
+ * @return True if the frame was read successfully, false otherwise.
+ *
+ * @see Camera::capture()
+ */
+bool captureRef(Camera& camera, FrameRef& ref, int timeout = 1500);
+
+}  // namespace Arducam
+
+/** @} */
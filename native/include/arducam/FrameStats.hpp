@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/FrameRef.hpp>
+#include <arducam/PixelKernels.hpp>
+#include <arducam/WorkerPool.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the options of a `FrameStatsEngine`.
+ *
+ * The statistics work on 2x2 blocks: one R, two G and one B sample of a bayer frame, or four samples of a mono frame.
+ * The luma of a block is `(R + 2G + B) / 4`.
+ */
+struct StatsOptions {
+    /** The number of exposure zones across the frame. */
+    uint32_t zones_x = 8;
+    /** The number of exposure zones down the frame. The zone rows are the tiles processed in parallel. */
+    uint32_t zones_y = 6;
+    /** The number of histogram bins of the luma histogram, spread over the full scale. */
+    uint32_t histogram_bins = 64;
+    /** Only every n-th block in both directions enters the histogram and the zones. 1 samples every block. */
+    uint32_t subsample = 4;
+    /** Black level subtracted from every sample, in sensor units. */
+    uint16_t black_level = 0;
+    /**
+     * @brief The focus window in sensor pixels. A width or height of 0 covers the whole frame.
+     *
+     * The focus metrics use every block of the window, whatever `subsample` is.
+     */
+    uint32_t focus_x = 0;
+    uint32_t focus_y = 0;
+    uint32_t focus_width = 0;
+    uint32_t focus_height = 0;
+};
+
+/**
+ * @brief Struct representing the layout of a `FORMAT_MODE_STATS` frame, from the documentation of the sensor.
+ *
+ * All values are little endian unsigned integers at byte offsets into the frame. A count of 0 skips a part.
+ */
+struct SensorStatsLayout {
+    /** The offset of the histogram. */
+    size_t histogram_offset = 0;
+    /** The number of histogram bins. */
+    uint32_t histogram_bins = 0;
+    /** The size of a bin: 1, 2 or 4 bytes. */
+    uint8_t histogram_bytes = 4;
+    /** The offset of the zone means, row by row. */
+    size_t zone_offset = 0;
+    uint32_t zones_x = 0;
+    uint32_t zones_y = 0;
+    /** The channels of a zone: 1 (luma), 3 (R, G, B) or 4 (R, Gr, Gb, B). */
+    uint8_t zone_channels = 1;
+    /** The size of a zone channel: 1, 2 or 4 bytes. */
+    uint8_t zone_bytes = 2;
+    /** The offset of a focus value, reported as `FrameStats::tenengrad`. */
+    size_t focus_offset = 0;
+    /** The size of the focus value: 0 (none), 1, 2, 4 or 8 bytes. */
+    uint8_t focus_bytes = 0;
+    /** The white level of the zone means. */
+    uint32_t full_scale = 1023;
+};
+
+/**
+ * @brief Struct representing the statistics of one exposure zone, in sensor units after the black level.
+ */
+struct ZoneStats {
+    double r = 0;
+    double g = 0;
+    double b = 0;
+    /** The fraction of sampled blocks with a clipped sample. */
+    double saturated = 0;
+    /** The number of sampled blocks. */
+    uint32_t samples = 0;
+};
+
+/**
+ * @brief Struct representing the statistics of a frame.
+ */
+struct FrameStats {
+    uint32_t seq = 0;
+    uint64_t timestamp = 0;
+    /** `true` if the statistics were read from a `FORMAT_MODE_STATS` frame. */
+    bool from_sensor = false;
+    /** The white level after the black level, e.g. 959 for 10-bit data with a black level of 64. */
+    uint32_t full_scale = 0;
+    /** The luma histogram. */
+    std::vector<uint32_t> histogram;
+    uint32_t zones_x = 0;
+    uint32_t zones_y = 0;
+    /** The zones, row by row. */
+    std::vector<ZoneStats> zones;
+    /** The mean luma of the sampled blocks. */
+    double mean = 0;
+    /** The fraction of sampled blocks with a clipped sample. */
+    double saturated = 0;
+    /** The number of sampled blocks. */
+    uint64_t samples = 0;
+    /** The variance of the Laplacian of the block luma in the focus window. Higher is sharper. */
+    double laplacian_variance = 0;
+    /** The mean squared Sobel gradient (Tenengrad) of the block luma in the focus window. Higher is sharper. */
+    double tenengrad = 0;
+    /** The sensor settings the frame was exposed with, from its `FrameRef::metadata()`. `valid` is 0 without. */
+    FrameMetadata metadata;
+};
+
+/**
+ * @brief Computes exposure and focus statistics of raw frames at frame rate.
+ *
+ * One pass over the raw data collects the luma histogram, the R, G, B means and the clipping of each zone and the
+ * focus metrics. Frames are unpacked two rows at a time with the `PixelKernelTable` kernels; the rows that hold no
+ * sampled block and lie outside the focus window are skipped without being read. Each zone row is a tile that can
+ * run on a `WorkerPool`.
+ *
+ * One engine serves one capture thread; its scratch space is reused from frame to frame.
+ */
+class FrameStatsEngine {
+   public:
+    /**
+     * @brief Creates an engine.
+     *
+     * @param options The options.
+     * @param pool Runs the zone rows on several threads if not null. Not owned.
+     */
+    explicit FrameStatsEngine(const StatsOptions& options = StatsOptions(), WorkerPool* pool = nullptr);
+
+    /** Returns the options. */
+    const StatsOptions& options() const { return options_; }
+    /**
+     * @brief Sets the layout used to read `FORMAT_MODE_STATS` frames.
+     */
+    void setSensorLayout(const SensorStatsLayout& layout) { layout_ = layout; }
+
+    /**
+     * @brief Computes the statistics of a bayer or mono frame, or reads those of a `FORMAT_MODE_STATS` frame.
+     *
+     * @param frame The frame.
+     * @param stats Receives the statistics. Its vectors keep their capacity across calls.
+     *
+     * @return `true` on success, `false` if the format or packing of the frame is not supported, or a stats frame is
+     * smaller than its layout.
+     */
+    bool process(const Frame& frame, FrameStats& stats);
+    /**
+     * @brief Computes the statistics of a frame and copies its metadata, so that the statistics come with the exact
+     * exposure and gain of the frame even while they change from frame to frame.
+     *
+     * @return `true` on success, `false` if the handle is empty, see `process()`.
+     */
+    bool process(const FrameRef& frame, FrameStats& stats);
+
+   private:
+    struct Band {
+        std::vector<uint16_t> rows;
+        std::vector<uint32_t> luma;
+        std::vector<uint32_t> histogram;
+        double laplacian_sum = 0;
+        double laplacian_squares = 0;
+        double tenengrad_sum = 0;
+        uint64_t focus_samples = 0;
+    };
+
+    bool parseSensorStats(const Frame& frame, FrameStats& stats) const;
+    void processBand(const Frame& frame, PixelPacking packing, uint32_t zone_y, FrameStats& stats);
+
+    StatsOptions options_;
+    WorkerPool* pool_;
+    SensorStatsLayout layout_;
+    std::vector<Band> bands_;
+    // the zone column of every block column
+    std::vector<uint16_t> zone_of_block_;
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/FrameRef.hpp>
+#include <arducam/PixelKernels.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/** Flag of `FrameQuality::flags`: `size` differs from `expected_size`, e.g. a frame kept by `setForceCapture()`. */
+constexpr uint32_t kFrameSizeMismatch = 0x01;
+/** Flag of `FrameQuality::flags`: a stripe of rows is all zero, the transfers never filled it. */
+constexpr uint32_t kFrameZeroStripe = 0x02;
+/** Flag of `FrameQuality::flags`: a stripe of rows repeats the row above it. */
+constexpr uint32_t kFrameRepeatedStripe = 0x04;
+/** Flag of `FrameQuality::flags`: a stripe of rows is the same as in a recent frame, the buffer kept old data. */
+constexpr uint32_t kFrameStaleStripe = 0x08;
+/** Flag of `FrameQuality::flags`: the embedded frame counter did not change, the whole buffer is old. */
+constexpr uint32_t kFrameCounterRepeat = 0x10;
+/** Flag of `FrameQuality::flags`: the embedded frame counter advanced by another amount than `seq`. */
+constexpr uint32_t kFrameCounterMismatch = 0x20;
+/** Every check of `FrameValidator`. */
+constexpr uint32_t kFrameAllChecks = 0x3F;
+
+/**
+ * @brief Struct representing a frame counter the sensor writes into its embedded data lines.
+ */
+struct EmbeddedCounter {
+    /** The number of bytes of the counter, 1 to 4. 0 disables the counter checks. */
+    uint8_t size = 0;
+    /** The row holding the counter, usually one of the embedded data lines at the top of the frame. */
+    uint32_t row = 0;
+    /** The offset of the first byte in the row. */
+    uint32_t offset = 0;
+    /** The distance between the bytes of the counter, e.g. 2 when the embedded data interleaves tags and values. */
+    uint32_t stride = 1;
+    /** `true` if the first byte is the most significant one, as in the sensor registers. */
+    bool big_endian = true;
+};
+
+/**
+ * @brief Struct representing the options of a `FrameValidator`.
+ */
+struct ValidatorOptions {
+    /** The checks to run, a combination of the `kFrame*` flags. */
+    uint32_t checks = kFrameAllChecks;
+    /**
+     * The bytes digested in every checked row, split into `sample_chunks` spread over the row. 0 digests whole rows.
+     * Torn and stale data come in whole transfers, much larger than a row, so a sample of each row finds them.
+     */
+    uint32_t sample_bytes = 512;
+    uint32_t sample_chunks = 2;
+    /** Checks every `row_step`th row only. */
+    uint32_t row_step = 1;
+    /** The number of checked rows in a row that make a stripe. Shorter runs, e.g. a clipped highlight, are ignored. */
+    uint32_t min_stripe_rows = 8;
+    /** The number of recent frames `kFrameStaleStripe` compares with, at least the number of SDK buffers. */
+    uint32_t history = 4;
+    /** The embedded frame counter, if the sensor has one. */
+    EmbeddedCounter counter;
+    /** Stores a hash of every whole row in `FrameQuality::row_checksums`. Digests every row completely. */
+    bool row_checksums = false;
+};
+
+/**
+ * @brief Struct representing the outcome of the validation of a frame.
+ */
+struct FrameQuality {
+    /** The problems found, `kFrame*` flags. 0 for a good frame. */
+    uint32_t flags = 0;
+    /** The sequence number of the frame. */
+    uint32_t seq = 0;
+    /** The number of rows checked. */
+    uint32_t rows_checked = 0;
+    /** The first row of the first stripe found, and the number of rows in stripes. */
+    uint32_t first_bad_row = 0;
+    uint32_t bad_rows = 0;
+    /** `true` if the embedded counter was read, and its value. */
+    bool has_counter = false;
+    uint32_t counter = 0;
+    /** A hash of every row received, with `ValidatorOptions::row_checksums`. */
+    std::vector<uint64_t> row_checksums;
+
+    /** Checks if no problem was found. */
+    bool ok() const { return flags == 0; }
+};
+
+/**
+ * @brief Counters of a `FrameValidator`.
+ */
+struct ValidatorStats {
+    uint64_t frames = 0;
+    /** Number of frames with any flag. */
+    uint64_t bad = 0;
+    uint64_t size_mismatches = 0;
+    uint64_t zero_stripes = 0;
+    uint64_t repeated_stripes = 0;
+    uint64_t stale_stripes = 0;
+    uint64_t counter_errors = 0;
+};
+
+/**
+ * @brief Checks received frames for truncated, torn and stale data before they are processed.
+ *
+ * Each row is digested with the `PixelKernelTable::digestBytes` kernel, which yields a hash and the smallest and
+ * largest byte in one SIMD pass. From the digests the validator flags stripes of zeroed rows, of rows repeating the
+ * row above, and of rows identical to the same rows of one of the last `history` frames, which is what a buffer
+ * recycled by the SDK holds where a frame was not fully received. Rows of one value (clipped highlights) never count
+ * as repeated or stale. With an `EmbeddedCounter` it also checks that the counter the sensor writes into its embedded
+ * lines advanced with `seq`.
+ *
+ * With the default sampling of 512 bytes per row, a 12 MP frame costs about 1.5 MB of reads, well under a millisecond.
+ *
+ * @note A validator keeps the digests of the last frames of one stream. Use one per camera, from one thread.
+ */
+class FrameValidator {
+   public:
+    explicit FrameValidator(const ValidatorOptions& options = ValidatorOptions());
+
+    /**
+     * @brief Validates a frame.
+     *
+     * @param frame The frame.
+     * @param quality Receives the outcome. Its `row_checksums` storage is reused.
+     *
+     * @return `true` if the frame is good, `quality.ok()`.
+     */
+    bool validate(const Frame& frame, FrameQuality& quality);
+    /** Forgets the recent frames, e.g. after a mode switch. */
+    void reset();
+
+    /** Returns the counters. */
+    const ValidatorStats& stats() const { return stats_; }
+
+    /**
+     * @brief Returns a capture callback that validates every frame and runs `callback` for the good ones only.
+     */
+    Camera::CaptureCallback wrapCallback(Camera::CaptureCallback callback);
+
+   private:
+    // the digest of the sampled chunks of a row
+    ByteDigest digestRow(const uint8_t* row, size_t row_size) const;
+    void checkCounter(const Frame& frame, size_t row_size, uint32_t rows, FrameQuality& quality);
+
+    ValidatorOptions options_;
+    const PixelKernelTable& kernels_;
+    ValidatorStats stats_;
+
+    // the row hashes of the recent frames, a ring of `history` entries, and the geometry they belong to
+    std::vector<std::vector<uint64_t>> recent_;
+    size_t recent_next_ = 0;
+    size_t recent_row_size_ = 0;
+    std::vector<uint64_t> hashes_;
+
+    bool has_counter_ = false;
+    uint32_t last_counter_ = 0;
+    uint32_t last_seq_ = 0;
+    // the outcome of the frames of wrapCallback()
+    FrameQuality callback_quality_;
+};
+
+/**
+ * @brief Captures the next good frame, releasing the bad ones.
+ *
+ * @param camera The camera.
+ * @param validator The validator of the camera.
+ * @param ref Receives the frame. Any frame previously held by `ref` is released.
+ * @param quality Receives the outcome of the frame returned.
+ * @param timeout The longest wait in milliseconds, for all the frames captured.
+ *
+ * @return `true` on success, `false` if no good frame came in time.
+ */
+bool captureValid(Camera& camera, FrameValidator& validator, FrameRef& ref, FrameQuality& quality,
+                  int timeout = 1500);
+
+}  // namespace Arducam
+
+/** @} */
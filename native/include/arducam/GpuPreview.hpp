@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/PixelKernels.hpp>
+#include <arducam/RemapLut.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief An OpenGL ES 3 context without a window, for `GpuPreview::readback()` from a non-GL application.
+ */
+class GlContext {
+   public:
+    /**
+     * @brief Creates an EGL context on a 1x1 pbuffer of the default display.
+     *
+     * @return The context, or null if EGL or OpenGL ES 3 is not available.
+     */
+    static std::unique_ptr<GlContext> createHeadless();
+
+    GlContext(const GlContext&) = delete;
+    GlContext& operator=(const GlContext&) = delete;
+    ~GlContext();
+
+    /** Makes the context current on the calling thread. */
+    bool makeCurrent();
+    /** Releases the context from the calling thread. */
+    void release();
+
+   private:
+    GlContext() = default;
+
+    void* display_ = nullptr;
+    void* surface_ = nullptr;
+    void* context_ = nullptr;
+};
+
+/**
+ * @brief Struct representing the options of a `GpuPreview`.
+ */
+struct GpuPreviewOptions {
+    /** The width of the preview. 0 keeps the aspect ratio of the corrected image; both 0 keep its size. */
+    uint32_t width = 0;
+    /** The height of the preview. 0 keeps the aspect ratio of the corrected image. */
+    uint32_t height = 0;
+    /** Enables the geometric correction. */
+    bool correct = false;
+    /** The correction, see `RemapLut`. At most 8 radial coefficients. */
+    CorrectionParams correction;
+    /** Black level subtracted from every sample, in sensor units. */
+    uint16_t black_level = 0;
+    /** White balance gains. */
+    float red_gain = 1.0f;
+    float green_gain = 1.0f;
+    float blue_gain = 1.0f;
+    /** Display gamma. 1 disables the curve. */
+    float gamma = 1.0f;
+};
+
+/**
+ * @brief Demosaics, corrects and scales captured frames on the GPU for display.
+ *
+ * `upload()` copies the frame buffer as it is, still packed, into a pixel buffer object and from there into a texture,
+ * so the frame can be returned to the camera right after. `render()` runs two shader passes: the first unpacks the
+ * samples and demosaics them bilinearly (or, when the preview is at most half the size of the image, into one RGB
+ * texel per 2x2 block), with black level, white balance and gamma; the second applies the crop, undistortion,
+ * perspective and rotation of `RemapLut` per preview pixel and scales through a mipmapped texture. Only the preview
+ * leaves the GPU, drawn with `draw()` or read back with `readback()`.
+ *
+ * Bayer (`RAW`, `RAW_D`) and mono (`MON`, `MON_D`) frames in any `PixelPacking` are supported. A source row wider
+ * than the texture size limit of the GPU (4096 on a Raspberry Pi 4) is folded over several texture rows.
+ *
+ * The shaders are specialized for the packing and layout of the stream and rebuilt when they change. Every call needs
+ * the OpenGL ES 3 context the preview was created in to be current on the calling thread: the GUI thread of a
+ * `QOpenGLWidget`, or a `GlContext`.
+ */
+class GpuPreview {
+   public:
+    /**
+     * @brief Creates the preview in the current context.
+     *
+     * @return The preview, or null if no OpenGL ES 3 context is current.
+     */
+    static std::unique_ptr<GpuPreview> create(const GpuPreviewOptions& options = GpuPreviewOptions());
+
+    GpuPreview(const GpuPreview&) = delete;
+    GpuPreview& operator=(const GpuPreview&) = delete;
+    /**
+     * @brief Deletes the GL objects. The context must be current.
+     */
+    ~GpuPreview();
+
+    /**
+     * @brief Replaces the options. Takes effect with the next `upload()`.
+     */
+    void setOptions(const GpuPreviewOptions& options);
+    /** Returns the options. */
+    const GpuPreviewOptions& options() const { return options_; }
+
+    /**
+     * @brief Copies a frame to the GPU.
+     *
+     * @return `true` on success, `false` if the frame format is not supported or the correction does not fit it.
+     */
+    bool upload(const Frame& frame);
+    /**
+     * @brief Renders the last uploaded frame into the preview texture.
+     *
+     * @return `true` on success, `false` if no frame was uploaded.
+     */
+    bool render();
+    /**
+     * @brief Draws the preview into a rectangle of the bound draw framebuffer, upright for a bottom-left origin.
+     */
+    void draw(int x, int y, int width, int height);
+    /**
+     * @brief Reads the preview back as RGBA bytes (`QImage::Format_RGBA8888`), the first row on top.
+     *
+     * @param dst Receives `height()` rows of `width() * 4` bytes.
+     * @param dst_stride The size of a destination row in bytes, a multiple of 4. 0 means `width() * 4`.
+     *
+     * @return `true` on success, `false` if nothing was rendered.
+     */
+    bool readback(uint8_t* dst, size_t dst_stride = 0);
+
+    /** Returns the GL name of the preview texture (`GL_RGBA8`, the first row at `t = 0`), 0 before the first frame. */
+    uint32_t texture() const { return preview_texture_; }
+    /** Returns the width of the preview, 0 before the first frame. */
+    uint32_t width() const { return width_; }
+    /** Returns the height of the preview, 0 before the first frame. */
+    uint32_t height() const { return height_; }
+
+   private:
+    GpuPreview() = default;
+
+    // rebuilds the textures and shaders for the format of a frame
+    bool configure(const Frame& frame, PixelPacking packing);
+    void release();
+
+    GpuPreviewOptions options_;
+    bool dirty_ = true;
+    int max_texture_size_ = 0;
+
+    ArducamFrameFormat format_{};
+    PixelPacking packing_ = PixelPacking::Unknown;
+    uint32_t corrected_width_ = 0;
+    uint32_t corrected_height_ = 0;
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    bool has_frame_ = false;
+
+    // the packed frame: `row_texels_` texels per image row, folded into rows of `src_tex_width_` texels
+    uint32_t src_texture_ = 0;
+    uint32_t src_tex_width_ = 0;
+    uint32_t row_texels_ = 0;
+    size_t frame_bytes_ = 0;
+    uint32_t pbo_[2] = {0, 0};
+    uint32_t pbo_index_ = 0;
+
+    // the demosaiced image, at full or half resolution, with its mipmaps
+    bool half_ = false;
+    uint32_t rgb_texture_ = 0;
+    uint32_t rgb_fbo_ = 0;
+    uint32_t rgb_width_ = 0;
+    uint32_t rgb_height_ = 0;
+    bool mipmaps_ = false;
+
+    uint32_t preview_texture_ = 0;
+    uint32_t preview_fbo_ = 0;
+
+    uint32_t demosaic_program_ = 0;
+    uint32_t correct_program_ = 0;
+};
+
+}  // namespace Arducam
+
+/** @} */
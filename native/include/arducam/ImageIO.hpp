@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/PixelKernels.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing a raw image read from a DNG file.
+ */
+struct DngImage {
+    /** The samples, one little endian `uint16_t` per pixel, row by row. */
+    std::vector<uint8_t> data;
+    /**
+     * @brief The image as a frame that `convertFrame()` accepts: `FORMAT_MODE_RAW` with the bayer order of the CFA
+     * pattern, or `FORMAT_MODE_MON`, `PixelPacking::Bits16`, and `data` pointing into `data` above.
+     */
+    Frame frame{};
+    /** The `BlackLevel` tag, 0 if there is none. */
+    uint16_t black_level = 0;
+    /** The `WhiteLevel` tag, or the largest value of `BitsPerSample` if there is none. */
+    uint32_t white_level = 0;
+};
+
+/**
+ * @brief Reads the raw image of a DNG file, e.g. one written by `Picamera2.save_dng()`.
+ *
+ * The raw image is the main image or the first sub-image with a CFA or linear raw photometric interpretation. Only
+ * uncompressed strips with 8 to 16 bits per sample are supported; 10, 12 and 14 bit samples may be packed big endian
+ * as the specification allows.
+ *
+ * @param path The path of the file.
+ * @param image Receives the image. Its buffer keeps its capacity across calls.
+ *
+ * @return `true` on success, `false` if the file cannot be read or its raw image is not supported.
+ */
+bool readDng(const std::string& path, DngImage& image);
+
+/**
+ * @brief Lists the files of a directory whose name ends with a suffix, ignoring case, sorted by name.
+ *
+ * @return `true` on success, `false` if the directory cannot be read.
+ */
+bool listFiles(const std::string& directory, const std::string& suffix, std::vector<std::string>& names);
+
+/**
+ * @brief Writes an uncompressed baseline TIFF file.
+ *
+ * @param path The path of the file.
+ * @param format `Rgb8`, `Bgr8`, `Y8` for 8-bit samples, `Rgb16`, `Y16` for 16-bit samples.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @param data The image.
+ * @param stride The size of a row in bytes. 0 means `width * outputPixelSize(format)`.
+ * @param bit_width The bit width of 16-bit samples, which are scaled to the full 16-bit range.
+ *
+ * @return `true` on success, `false` if the format is not supported or the file cannot be written.
+ */
+bool writeTiff(const std::string& path, OutputFormat format, uint32_t width, uint32_t height, const uint8_t* data,
+               size_t stride = 0, uint8_t bit_width = 16);
+
+/**
+ * @brief Checks if `writeJpeg()` is available, i.e. the library was built with `ARDUCAM_WITH_JPEG` and libjpeg.
+ */
+bool jpegSupported();
+
+/**
+ * @brief Writes a baseline JPEG file with libjpeg.
+ *
+ * @param path The path of the file.
+ * @param format `Rgb8`, `Bgr8` or `Y8`.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @param data The image.
+ * @param stride The size of a row in bytes. 0 means `width * outputPixelSize(format)`.
+ * @param quality The quality, 1 to 100.
+ *
+ * @return `true` on success, `false` if JPEG is not supported, the format is not supported or the file cannot be
+ * written.
+ */
+bool writeJpeg(const std::string& path, OutputFormat format, uint32_t width, uint32_t height, const uint8_t* data,
+               size_t stride = 0, int quality = 95);
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/PixelKernels.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing a virtual device of the mock backend, see `addMockDevice()`.
+ */
+struct MockDeviceOptions {
+    /** The serial number, at most 16 characters. Empty gives `MOCK` followed by the index of the device. */
+    std::string serial;
+    /** The USB type (`USB_2`, `USB_3`) and speed the device reports. */
+    uint16_t usb_type = USB_3;
+    ArducamUSBSpeed speed = USB_SPEED_SUPER;
+
+    /**
+     * The modes of `Camera::listMode()`; `open()` starts in the first one. Empty gives the 10-bit RGGB IMX708 modes
+     * 4608x2592, 2304x1296 and 1536x864. Ignored when replaying, the recording has a single mode.
+     */
+    std::vector<ArducamCameraConfig> modes;
+    /** The packing of the synthetic frames of modes wider than 8 bits: `Bits16`, `Raw10Packed` or `Raw12Packed`. */
+    PixelPacking packing = PixelPacking::Bits16;
+    /**
+     * The embedded data lines written on top of the synthetic frames, 0 for none. They carry the frame counter and
+     * the exposure, gain, frame length and line length registers of the sensor as IMX708 sends them, with the values
+     * written by `writeSensorReg()` before the frame started; see `MetadataParser`.
+     */
+    uint32_t embedded_lines = 0;
+    /** The seed of the synthetic pattern and of `transfer_error_rate`. */
+    uint64_t seed = 1;
+
+    /**
+     * A `RawRecorder` file to replay instead of the synthetic pattern. Its frames are sent in order with the format
+     * they were recorded with and new sequence numbers and timestamps.
+     */
+    std::string replay_file;
+    /** Starts the recording over after its last frame; otherwise the device stops sending. */
+    bool loop = true;
+
+    /**
+     * The frame rate. 0 sends the next frame as soon as the previous one arrived and a buffer is free, nothing is
+     * dropped: the throughput of the consumer is measured.
+     */
+    double fps = 30;
+    /** The bandwidth of the link in bytes per second: a frame takes `size / bandwidth` to arrive. 0 means no limit. */
+    double bandwidth = 0;
+    /**
+     * The turnaround of one USB transfer in microseconds. When set, the bytes in flight (`setTransfer()` count times
+     * size) limit the bandwidth to `count * size / transfer_latency_us`, as too few or too small transfers do on a
+     * real link. 0 ignores the transfer configuration.
+     */
+    double transfer_latency_us = 0;
+    /** The number of frame buffers of a camera: a frame that finds none free is dropped. */
+    uint32_t buffer_count = 4;
+    /** Added to the `TimeSource::Firmware` timestamps, in 100 ns, e.g. to skew the clocks of a stereo pair. */
+    int64_t clock_offset = 0;
+
+    /** Every `transfer_error_every`th frame fails with `TransferError`. 0 disables it. */
+    uint32_t transfer_error_every = 0;
+    /** The probability of a frame failing with `TransferError`, decided from `seed` and the sequence number. */
+    double transfer_error_rate = 0;
+    /** The device disconnects after sending so many frames, 0 never. `connectMockDevice()` plugs it in again. */
+    uint64_t disconnect_after = 0;
+    /**
+     * The largest `writeUserData()` the device accepts, at most 255; a larger one fails with `UserdataLenError`, as
+     * firmware with a smaller transfer buffer does.
+     */
+    uint32_t user_data_max_transfer = 255;
+};
+
+/**
+ * @brief Counters of a virtual device, over all the cameras that opened it.
+ */
+struct MockDeviceStats {
+    /** Number of frames started, one `FrameStart` event each. */
+    uint64_t frames = 0;
+    /** Number of frames put in the output queue or passed to the capture callback. */
+    uint64_t delivered = 0;
+    /** Number of frames dropped because no buffer was free or the link was still busy with the previous frame. */
+    uint64_t dropped = 0;
+    /** Number of frames failed with a transfer error event. */
+    uint64_t transfer_errors = 0;
+    /** Number of disconnects. */
+    uint64_t disconnects = 0;
+};
+
+/**
+ * @brief Adds a virtual device to the mock backend.
+ *
+ * The mock backend (`mock/MockCamera.cpp`, linked instead of `arducam_evk_cpp_sdk`) implements `DeviceList` and
+ * `Camera` over virtual devices. The device is listed by `DeviceList::listDevices()` and `refresh()`, and lists with
+ * an event callback are sent `DeviceConnect`. Without any device added by the time a list is made, the backend adds
+ * the devices of `ARDUCAM_MOCK_DEVICES` (see `parseMockDevices()`), or two default devices.
+ *
+ * @return `true` on success, `false` if the serial number is taken or the recording cannot be read.
+ */
+bool addMockDevice(const MockDeviceOptions& options);
+/**
+ * @brief Unplugs a virtual device: its camera stops sending and is sent `DeviceDisconnect`, as are the device lists
+ * with an event callback, and the device is no longer listed. The camera must be closed and opened again.
+ *
+ * @return `true` on success, `false` if the device does not exist or is not connected.
+ */
+bool disconnectMockDevice(const std::string& serial);
+/**
+ * @brief Plugs a disconnected virtual device in again, with `DeviceConnect` to the device lists.
+ *
+ * @return `true` on success, `false` if the device does not exist or is connected.
+ */
+bool connectMockDevice(const std::string& serial);
+/**
+ * @brief Disconnects a virtual device if needed and removes it from the backend.
+ *
+ * @return `true` on success, `false` if the device does not exist.
+ */
+bool removeMockDevice(const std::string& serial);
+/**
+ * @brief Makes the next frame of a virtual device fail.
+ *
+ * @param serial The device.
+ * @param event `TransferError`, `TransferTimeout` or `TransferLengthError`, sent instead of `FrameEnd`. The frame is
+ * dropped, or delivered cut short with `setForceCapture()`.
+ *
+ * @return `true` on success, `false` if the device does not exist or `event` is not a transfer error.
+ */
+bool injectMockError(const std::string& serial, ArducamEventCode event = TransferError);
+/**
+ * @brief Returns the counters of a virtual device.
+ *
+ * @return `true` on success, `false` if the device does not exist.
+ */
+bool mockDeviceStats(const std::string& serial, MockDeviceStats& stats);
+/**
+ * @brief Parses a list of virtual devices, the format of `ARDUCAM_MOCK_DEVICES`.
+ *
+ * Devices are separated by `;`, each one a comma separated list of `key=value` options, all optional: `serial`,
+ * `size` (`WIDTHxHEIGHT`, a single mode), `bits`, `packing` (`8`, `16`, `raw10`, `raw12`), `embedded`, `seed`,
+ * `replay` (a recording), `loop` (`0`/`1`), `fps`, `bandwidth` (bytes per second), `latency` (the transfer latency
+ * in microseconds), `buffers`, `clock_offset`, `error_every`, `error_rate`, `disconnect_after` and `usb` (`2`,
+ * `3`). For example `fps=60;fps=60,error_every=100` is a pair of devices, one of them failing one frame in 100.
+ *
+ * @return `true` on success, `false` on an unknown option or a bad value.
+ */
+bool parseMockDevices(const std::string& spec, std::vector<MockDeviceOptions>& devices);
+
+}  // namespace Arducam
+
+/** @} */
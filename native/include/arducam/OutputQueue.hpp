@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BoundedQueue.hpp>
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/FrameRef.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Counters of an `OutputQueue`.
+ */
+struct OutputQueueStats {
+    /** Number of frames returned by `OutputQueue::capture()`. */
+    uint64_t captured;
+    /** Number of queued frames returned to the input queue without being delivered. */
+    uint64_t recycled;
+    /** Number of frames in the output queue of the camera at the last check. */
+    uint32_t depth;
+    /** Highest number of frames observed in the output queue of the camera. */
+    uint32_t max_depth;
+};
+
+/**
+ * @brief Bounds the output queue of a camera, or keeps only its newest frame.
+ *
+ * The SDK queues every completed frame until `Camera::capture()` takes it, and `Camera::clearBuffer()` is the only
+ * way to drop them. An output queue caps the number of frames left waiting: whenever there are more than `depth()`,
+ * the oldest ones are taken and handed straight back to the input queue with `Camera::freeImage()`, so the transfers
+ * never run out of buffers and a late consumer only ever sees the most recent frames. In latest-only mode the depth
+ * is one and `capture()` returns the newest frame, which keeps the latency of an interactive preview at one frame;
+ * a recorder on another camera keeps a deep queue.
+ *
+ * With an `EventDispatcher`, a small thread trims the queue on every `FrameEnd` event, so frames are recycled even
+ * while the consumer is busy; without one, the queue is trimmed in `capture()` and `trim()` only. The depth and the
+ * mode can be changed at any time, from any thread.
+ *
+ * @note The queue uses the polling API, so it can not be used together with `Camera::setCaptureCallback()`, and
+ * nothing else should capture from the camera.
+ */
+class OutputQueue {
+   public:
+    /**
+     * @brief Constructs an output queue.
+     *
+     * @param camera The camera. Must outlive the queue and every captured frame.
+     * @param events The event dispatcher of the camera, or null to trim only when capturing. Must outlive the queue.
+     * @param depth The maximum number of frames left in the output queue. 0 means no limit.
+     */
+    explicit OutputQueue(Camera& camera, EventDispatcher* events = nullptr, size_t depth = 0);
+    OutputQueue(const OutputQueue&) = delete;
+    OutputQueue& operator=(const OutputQueue&) = delete;
+    /**
+     * @brief Stops listening and joins the trimming thread. Queued frames stay in the output queue.
+     */
+    ~OutputQueue();
+
+    /**
+     * @brief Sets the maximum number of frames left in the output queue. 0 means no limit.
+     *
+     * Extra frames are recycled by the next trim.
+     */
+    void setDepth(size_t depth);
+    /** Returns the maximum number of frames left in the output queue. */
+    size_t depth() const { return depth_.load(std::memory_order_relaxed); }
+    /**
+     * @brief Enables or disables the latest-only mode, which overrides the depth with one.
+     */
+    void setLatestOnly(bool latest_only);
+    /** Checks if the latest-only mode is enabled. */
+    bool latestOnly() const { return latest_only_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Takes the next frame, the newest one in latest-only mode.
+     *
+     * @param ref Receives the frame. Reset if there is none.
+     * @param timeout The maximum time to wait for a frame, in milliseconds.
+     *
+     * @return `true` if a frame was taken, `false` on timeout.
+     */
+    bool capture(FrameRef& ref, int timeout = 1500);
+    /**
+     * @brief Recycles the frames beyond the depth now.
+     *
+     * @return The number of frames recycled.
+     */
+    size_t trim();
+    /**
+     * @brief Recycles every queued frame. Unlike `Camera::clearBuffer()`, the buffers go back to the input queue.
+     *
+     * @return The number of frames recycled.
+     */
+    size_t drain();
+
+    /** Returns a snapshot of the counters. */
+    OutputQueueStats stats() const;
+    /** Resets the counters. */
+    void resetStats();
+
+   private:
+    void run();
+    // the number of frames left by a trim, 0 for no limit
+    size_t limit() const;
+    // takes and frees the oldest frames until at most `keep` are left, with `mutex_` held and no capture waiting
+    size_t recycleLocked(size_t keep);
+
+    Camera& camera_;
+    EventDispatcher* events_;
+    int listener_ = -1;
+
+    std::atomic<size_t> depth_;
+    std::atomic<bool> latest_only_{false};
+
+    // serializes the trims, which are skipped while `waiting_` consumers wait for a frame outside of it, so that a
+    // trim never takes the frame a capture expects
+    std::mutex mutex_;
+    std::atomic<uint32_t> waiting_{0};
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    alignas(kCacheLineSize) std::atomic<uint32_t> pending_{0};
+    Notifier ready_;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> captured_{0};
+    std::atomic<uint64_t> recycled_{0};
+    std::atomic<uint32_t> last_depth_{0};
+    std::atomic<uint32_t> max_depth_{0};
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <arducam/ArducamCamera.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Enum class representing the bayer order stored in the low 8 bits of `ArducamFrameFormat::format`.
+ *
+ * The name lists the colors of the top-left 2x2 block, row by row.
+ */
+enum class BayerOrder : uint8_t {
+    RGGB = 0x00, /**< R G / G B */
+    GRBG = 0x01, /**< G R / B G */
+    GBRG = 0x02, /**< G B / R G */
+    BGGR = 0x03, /**< B G / G R */
+};
+
+/**
+ * @brief Enum class representing how the pixels of a frame buffer are packed.
+ */
+enum class PixelPacking : uint8_t {
+    Unknown = 0x00,     /**< The frame size does not match any supported packing */
+    Bits8 = 0x01,       /**< One byte per pixel */
+    Bits16 = 0x02,      /**< Two bytes per pixel, little endian, LSB aligned */
+    Raw10Packed = 0x03, /**< MIPI RAW10: 4 pixels in 5 bytes */
+    Raw12Packed = 0x04, /**< MIPI RAW12: 2 pixels in 3 bytes */
+};
+
+/**
+ * @brief Enum class representing the demosaic algorithms.
+ */
+enum class DemosaicMethod : uint8_t {
+    Bilinear = 0x00,  /**< Average of the nearest samples of each color */
+    EdgeAware = 0x01, /**< Green is interpolated along the direction of the smaller gradient */
+};
+
+/**
+ * @brief Enum class representing the output formats of `convertFrame()`.
+ */
+enum class OutputFormat : uint8_t {
+    Raw16 = 0x00, /**< Unpacked sensor data, one `uint16_t` per pixel */
+    Rgb16 = 0x01, /**< Interleaved RGB, one `uint16_t` per channel, at the sensor bit width */
+    Rgb8 = 0x02,  /**< Interleaved RGB, one byte per channel */
+    Bgr8 = 0x03,  /**< Interleaved BGR, one byte per channel (OpenCV / QImage order) */
+    Y16 = 0x04,   /**< Luma, one `uint16_t` per pixel, at the sensor bit width */
+    Y8 = 0x05,    /**< Luma, one byte per pixel */
+};
+
+/**
+ * @brief Enum class representing the instruction set used by the pixel kernels.
+ */
+enum class SimdLevel : uint8_t {
+    Scalar = 0x00, /**< Portable C++ */
+    Neon = 0x01,   /**< ARM NEON (Raspberry Pi) */
+    Avx2 = 0x02,   /**< x86 AVX2 */
+};
+
+/**
+ * @brief Struct representing the arguments of a demosaic row kernel.
+ *
+ * `up` and `down` are the rows above and below `cur`. At the image border the caller passes the mirrored row
+ * (row 1 for row 0, row `height - 2` for the last row), which keeps the bayer phase intact.
+ */
+struct DemosaicRowArgs {
+    const uint16_t* up;
+    const uint16_t* cur;
+    const uint16_t* down;
+    uint32_t width;
+    /** `true` if the color samples of this row are red, `false` if they are blue. */
+    bool red_row;
+    /** `true` if the first pixel of the row is a green sample. */
+    bool green_first;
+    DemosaicMethod method;
+    uint16_t* r;
+    uint16_t* g;
+    uint16_t* b;
+};
+
+/** Number of fractional bits of the bilinear remap weights, i.e. the remap resolution is 1/32 pixel. */
+constexpr int kRemapFracBits = 5;
+/** Weights value marking an output pixel whose source lies outside the image. The pixel is set to 0. */
+constexpr uint16_t kRemapOutside = 0xFFFF;
+
+/**
+ * @brief Struct representing the arguments of a remap row kernel.
+ *
+ * Output pixel `i` is the bilinear blend of the 2x2 source block whose top-left sample is `coords[i]`. The builder of
+ * the map guarantees that the whole block lies inside the source image.
+ */
+struct RemapRowArgs {
+    /** The source image, in the same format as the destination. */
+    const uint8_t* src;
+    /** The size of a source row in bytes. Must be a multiple of the sample size. */
+    size_t src_stride;
+    /** The number of readable bytes at `src`. The SIMD kernels use it to bound their wide loads. */
+    size_t src_size;
+    /**
+     * The source pixel at `src`, for a source that holds a window of the image: `coords` count from the top-left of
+     * the image and must lie inside the window. 0 for a whole image.
+     */
+    uint32_t src_x0;
+    uint32_t src_y0;
+    /** The top-left source sample of every output pixel, `x | y << 16`. */
+    const uint32_t* coords;
+    /** The weights of the right column and bottom row of every block, `fx | fy << 8` in `1 << kRemapFracBits` units. */
+    const uint16_t* weights;
+    uint8_t* dst;
+    /** The number of output pixels. */
+    uint32_t count;
+    /** The format of the source and destination, any `OutputFormat`. */
+    OutputFormat format;
+};
+
+/**
+ * @brief Struct representing the digest of a byte range, see `PixelKernelTable::digestBytes`.
+ */
+struct ByteDigest {
+    /**
+     * A hash of the bytes: Fletcher style running sums of the little endian 32-bit words, in 8 lanes (one per word
+     * of each 32 byte block), folded with the remaining bytes. Equal ranges give equal hashes on every instruction set.
+     */
+    uint64_t hash;
+    /** The smallest and largest byte, 0 for an empty range. */
+    uint8_t min;
+    uint8_t max;
+};
+
+/**
+ * @brief Struct representing a set of row kernels for one instruction set.
+ *
+ * Every kernel works on caller-provided buffers and never allocates. `count` is a number of pixels.
+ */
+struct PixelKernelTable {
+    SimdLevel level;
+    /** Widens 8-bit samples. */
+    void (*unpack8)(const uint8_t* src, uint16_t* dst, size_t count);
+    /** Copies little endian 16-bit samples, keeping the bits of `mask`. */
+    void (*unpack16)(const uint8_t* src, uint16_t* dst, size_t count, uint16_t mask);
+    /** Unpacks MIPI RAW10. `count` must be a multiple of 4. */
+    void (*unpackRaw10)(const uint8_t* src, uint16_t* dst, size_t count);
+    /** Unpacks MIPI RAW12. `count` must be a multiple of 2. */
+    void (*unpackRaw12)(const uint8_t* src, uint16_t* dst, size_t count);
+    /** Subtracts `black` from every sample in place, saturating at 0. */
+    void (*subtractBlack)(uint16_t* data, size_t count, uint16_t black);
+    /** Interpolates one bayer row into planar R, G and B rows. */
+    void (*demosaicRow)(const DemosaicRowArgs& args);
+    /** Interleaves planar rows into RGB `uint16_t` triplets. */
+    void (*packRgb16)(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* dst, size_t count);
+    /** Interleaves planar rows into RGB (or BGR if `bgr`) bytes, shifting every sample right by `shift`. */
+    void (*packRgb8)(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint8_t* dst, size_t count, int shift,
+                     bool bgr);
+    /** Computes BT.601 luma from planar rows. */
+    void (*luma16)(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* dst, size_t count);
+    /** Narrows samples to bytes, shifting right by `shift`. */
+    void (*narrow8)(const uint16_t* src, uint8_t* dst, size_t count, int shift);
+    /** Resamples one output row through a fixed-point remap table. */
+    void (*remapRow)(const RemapRowArgs& args);
+    /** Digests `size` bytes. */
+    void (*digestBytes)(const uint8_t* src, size_t size, ByteDigest& digest);
+};
+
+/**
+ * @brief Struct representing the options of `convertFrame()`.
+ */
+struct ConvertOptions {
+    OutputFormat output = OutputFormat::Rgb8;
+    DemosaicMethod method = DemosaicMethod::EdgeAware;
+    /** Black level subtracted from every sample, in sensor units (e.g. 64 for 10-bit IMX708 data). */
+    uint16_t black_level = 0;
+};
+
+/** Returns the `ArducamFormatMode` stored in the high 8 bits of `format`. */
+inline ArducamFormatMode formatMode(const ArducamFrameFormat& format) {
+    return static_cast<ArducamFormatMode>(format.format >> 8);
+}
+/** Returns the bayer order stored in the low 8 bits of `format`. */
+inline BayerOrder bayerOrder(const ArducamFrameFormat& format) {
+    return static_cast<BayerOrder>(format.format & 0x03);
+}
+/** Checks if the format mode carries a bayer mosaic (`FORMAT_MODE_RAW`, `FORMAT_MODE_RAW_D`). */
+inline bool isBayer(ArducamFormatMode mode) { return mode == FORMAT_MODE_RAW || mode == FORMAT_MODE_RAW_D; }
+/** Checks if the format mode carries single channel data (`FORMAT_MODE_MON`, `FORMAT_MODE_MON_D`). */
+inline bool isMono(ArducamFormatMode mode) { return mode == FORMAT_MODE_MON || mode == FORMAT_MODE_MON_D; }
+
+/**
+ * @brief Returns the number of bytes of one row for a packing.
+ *
+ * @return The row size, or 0 if `packing` is `PixelPacking::Unknown`.
+ */
+size_t packedRowSize(PixelPacking packing, uint32_t width);
+/**
+ * @brief Guesses the packing of a frame buffer from its size.
+ *
+ * @param frame The frame. `size` (or `expected_size` if `size` is 0) is compared with the size of each packing.
+ *
+ * @return The packing, or `PixelPacking::Unknown`.
+ */
+PixelPacking detectPacking(const Frame& frame);
+
+/**
+ * @brief Returns the kernels of the best instruction set supported by the running CPU.
+ */
+const PixelKernelTable& pixelKernels();
+/**
+ * @brief Returns the portable kernels. Mostly useful to validate the SIMD kernels.
+ */
+const PixelKernelTable& scalarPixelKernels();
+
+/**
+ * @brief Unpacks a frame buffer into one `uint16_t` per pixel.
+ *
+ * @param frame The frame to unpack.
+ * @param dst The destination, at least `width * height` samples.
+ *
+ * @return `true` on success, `false` if the packing of the frame is unknown.
+ */
+bool unpackFrame(const Frame& frame, uint16_t* dst);
+/**
+ * @brief Subtracts a black level from every sample in place, saturating at 0.
+ */
+void subtractBlackLevel(uint16_t* data, size_t count, uint16_t black);
+/**
+ * @brief Demosaics an unpacked bayer image into interleaved RGB.
+ *
+ * @param raw The bayer image, `width * height` samples. `width` must be even and `height` at least 2.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @param order The bayer order of the image.
+ * @param method The demosaic algorithm.
+ * @param rgb The destination, `width * height * 3` samples.
+ * @param scratch Scratch space of `3 * width` samples.
+ */
+void demosaic(const uint16_t* raw, uint32_t width, uint32_t height, BayerOrder order, DemosaicMethod method,
+              uint16_t* rgb, uint16_t* scratch);
+
+/**
+ * @brief Returns the number of bytes per pixel of an output format.
+ */
+size_t outputPixelSize(OutputFormat output);
+/**
+ * @brief Returns the number of `uint16_t` samples of scratch space `convertFrame()` needs for a frame format.
+ */
+size_t convertScratchSize(const ArducamFrameFormat& format);
+/**
+ * @brief Converts a frame to an output format in one streaming pass.
+ *
+ * The frame is unpacked, black level corrected, demosaiced (bayer formats) and packed row by row, so only a few rows
+ * of intermediate data are ever live. Bayer (`RAW`, `RAW_D`) and mono (`MON`, `MON_D`) frames are supported.
+ *
+ * @param frame The frame to convert.
+ * @param options The conversion options.
+ * @param dst The destination image.
+ * @param dst_stride The size of a destination row in bytes. 0 means `width * outputPixelSize(output)`.
+ * @param scratch Scratch space of `convertScratchSize(frame.format)` samples.
+ *
+ * @return `true` on success, `false` if the format or packing of the frame is not supported.
+ */
+bool convertFrame(const Frame& frame, const ConvertOptions& options, uint8_t* dst, size_t dst_stride,
+                  uint16_t* scratch);
+/**
+ * @brief Converts the pixels `[x0, x1) x [y0, y1)` of a frame, for callers that stream an image in tiles or bands.
+ *
+ * The result is the same as that part of `convertFrame()`; the demosaic reads the rows and columns around it.
+ *
+ * @param dst The destination of pixel `(x0, y0)`.
+ * @param dst_stride The size of a destination row in bytes. Must be given explicitly.
+ * @param scratch Scratch space of `convertScratchSize(frame.format)` samples.
+ *
+ * @return `true` on success, `false` if the format or packing of the frame is not supported. An empty region only
+ * checks the frame.
+ */
+bool convertFrameRegion(const Frame& frame, const ConvertOptions& options, uint32_t x0, uint32_t x1, uint32_t y0,
+                        uint32_t y1, uint8_t* dst, size_t dst_stride, uint16_t* scratch);
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/PixelKernels.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Enum class representing the pixel layouts a `PixelPipeline` reads, derived from `ArducamFormatMode`.
+ */
+enum class PixelLayout : uint8_t {
+    Unsupported = 0x00, /**< No pixel data (`JPG`, `TOF`, `STATS`) or a size that matches no layout */
+    Bayer = 0x01,       /**< `RAW`, `RAW_D`: bayer mosaic in the order of `bayerOrder()` */
+    RgbIr = 0x02,       /**< `RGB_IR`: bayer mosaic whose green on the blue rows is an IR sample */
+    Mono = 0x03,        /**< `MON`, `MON_D`: single channel */
+    Yuv422 = 0x04,      /**< `YUV`: 8-bit 4:2:2, order in the low 8 bits of the format (YUYV, YVYU, UYVY, VYUY) */
+    Rgb888 = 0x05,      /**< `RGB`: 8-bit R, G, B */
+    Rgb565 = 0x06,      /**< `RGB`: little endian 5-6-5 */
+};
+
+/**
+ * @brief Struct representing the options of a `PixelPipeline`.
+ *
+ * The black level, the white balance gains and the gamma curve are folded into lookup tables when the pipeline is
+ * built, so that each costs one table lookup per sample, or nothing when left at its default.
+ */
+struct PipelineOptions {
+    OutputFormat output = OutputFormat::Rgb8;
+    DemosaicMethod method = DemosaicMethod::EdgeAware;
+    /** Black level subtracted from every sample, in sensor units. Ignored for YUV and RGB frames. */
+    uint16_t black_level = 0;
+    /** White balance gains, applied after the black level. Ignored for mono frames. */
+    float red_gain = 1.0f;
+    float green_gain = 1.0f;
+    float blue_gain = 1.0f;
+    /** Display gamma, e.g. 2.2. 1 disables the curve. Not applied to `OutputFormat::Raw16`. */
+    float gamma = 1.0f;
+};
+
+/**
+ * @brief A conversion of one frame format to one output format, specialized once per stream.
+ *
+ * `build()` resolves the layout, packing and bit width of the stream and the options to a chain of row stages: unpack
+ * with the SIMD kernels of `PixelKernelTable`, black level and white balance, demosaic, gamma and output packing. The
+ * chain is a template instantiation per layout and output format, picked through a function pointer, so the row loop
+ * does not look at the format again and the sample loops never do.
+ *
+ * A pipeline is immutable once built, and `run()` may be called from several threads, each with its own scratch.
+ * Compared to `convertFrame()`, it also covers RGB-IR, YUV and RGB frames and adds white balance and gamma.
+ *
+ * For `RGB_IR` frames, the IR samples are replaced by the average of their four diagonal greens before the demosaic,
+ * so the image keeps the IR contribution the sensor adds to every color.
+ */
+class PixelPipeline {
+   public:
+    /**
+     * @brief Builds the pipeline for the stream of a frame.
+     *
+     * @param frame A frame of the stream. Its format and size decide the layout and packing; the data is not read.
+     * @param options The conversion options.
+     * @param kernels The row kernels, the best of the CPU by default.
+     *
+     * @return The pipeline, or null if the format can not be converted to `options.output` (see `PixelLayout`).
+     * `OutputFormat::Raw16` is only available for bayer, RGB-IR and mono frames.
+     */
+    static std::unique_ptr<PixelPipeline> build(const Frame& frame, const PipelineOptions& options,
+                                                const PixelKernelTable& kernels = pixelKernels());
+
+    PixelPipeline(const PixelPipeline&) = delete;
+    PixelPipeline& operator=(const PixelPipeline&) = delete;
+
+    /**
+     * @brief Returns the layout of a frame, as `build()` sees it.
+     */
+    static PixelLayout layoutOf(const Frame& frame);
+
+    /** Returns the layout of the stream. */
+    PixelLayout layout() const { return layout_; }
+    /** Returns the packing of the samples, for bayer, RGB-IR and mono streams. */
+    PixelPacking packing() const { return packing_; }
+    /** Returns the options. */
+    const PipelineOptions& options() const { return options_; }
+    /** Returns the number of `uint16_t` samples of scratch space `run()` needs. */
+    size_t scratchSize() const { return scratch_size_; }
+    /** Returns the size of an output row in bytes, without padding. */
+    size_t outputRowSize() const { return static_cast<size_t>(format_.width) * outputPixelSize(options_.output); }
+
+    /**
+     * @brief Checks if a frame belongs to the stream the pipeline was built for (same format and size).
+     */
+    bool matches(const Frame& frame) const;
+    /**
+     * @brief Converts a frame.
+     *
+     * @param frame The frame. Must match the pipeline, see `matches()`.
+     * @param dst The destination image.
+     * @param dst_stride The size of a destination row in bytes. 0 means `outputRowSize()`.
+     * @param scratch Scratch space of `scratchSize()` samples.
+     *
+     * @return `true` on success, `false` if the frame has no data or does not match.
+     */
+    bool run(const Frame& frame, uint8_t* dst, size_t dst_stride, uint16_t* scratch) const;
+
+   private:
+    friend struct PipelineStages;
+
+    using RunFn = void (*)(const PixelPipeline& pipeline, const uint8_t* src, uint8_t* dst, size_t dst_stride,
+                           uint16_t* scratch);
+    using UnpackFn = void (*)(const PixelKernelTable& kernels, const uint8_t* src, uint16_t* dst, size_t count,
+                              uint16_t mask);
+
+    PixelPipeline() = default;
+
+    const PixelKernelTable* kernels_ = nullptr;
+    ArducamFrameFormat format_{};
+    PixelLayout layout_ = PixelLayout::Unsupported;
+    PixelPacking packing_ = PixelPacking::Unknown;
+    PipelineOptions options_;
+    size_t src_row_ = 0;
+    size_t scratch_size_ = 0;
+    uint16_t mask_ = 0;
+    int shift_ = 0;
+    RunFn run_ = nullptr;
+    UnpackFn unpack_ = nullptr;
+
+    // sensor domain tables (black level and gains), one per bayer phase `(y & 1) * 2 + (x & 1)`, or one for mono
+    // that also holds the gamma curve
+    std::vector<uint16_t> sensor_lut_;
+    size_t sensor_lut_size_ = 0;
+    // output domain tables (gains of YUV and RGB frames, gamma) of the channels R, G and B, `output_lut_stride_`
+    // samples apart; a stride of 0 shares one table
+    std::vector<uint16_t> output_lut_;
+    size_t output_lut_stride_ = 0;
+    // RGB-IR: parity of the rows holding IR samples, and of their IR columns
+    uint32_t ir_row_ = 0;
+    uint32_t ir_column_ = 0;
+    // YUV: byte offsets of Y0, Y1, U and V in a 4 byte group
+    uint8_t yuv_offsets_[4] = {0, 2, 1, 3};
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arducam/BoundedQueue.hpp>
+#include <arducam/BufferArena.hpp>
+#include <arducam/FrameDispatcher.hpp>
+#include <arducam/FrameRef.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/** Alignment of every frame and of every write in a recording, in bytes. */
+constexpr size_t kRecordAlignment = 4096;
+
+/**
+ * @brief Struct representing the header of a recording, stored at offset 0.
+ *
+ * A recording is laid out as the header page, the frame index (`max_frames` entries) and the frame data. Every frame
+ * starts on a `kRecordAlignment` boundary. All fields are little-endian.
+ */
+struct RecordHeader {
+    /** `ARRW` */
+    char magic[4];
+    uint32_t version;
+    /** Size of a `RecordIndexEntry`. */
+    uint32_t entry_size;
+    /** Alignment of the frames. */
+    uint32_t alignment;
+    /** Number of index entries the file has room for. */
+    uint64_t max_frames;
+    /** Number of frames written. */
+    uint64_t frame_count;
+    /** Offset of the index. */
+    uint64_t index_offset;
+    /** Offset of the frame data. */
+    uint64_t data_offset;
+    /** Number of bytes of frame data written, padding included. */
+    uint64_t data_size;
+    /** `kRecordComplete` once the recorder was closed. */
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+/** Flag of `RecordHeader::flags` set when the recording was closed cleanly. */
+constexpr uint32_t kRecordComplete = 0x01;
+
+/**
+ * @brief Struct representing the index entry of one recorded frame.
+ */
+struct RecordIndexEntry {
+    /** Offset of the frame data in the file. */
+    uint64_t offset;
+    /** Timestamp of the frame. @see ArducamImageFrame::timestamp */
+    uint64_t timestamp;
+    /** Size of the frame data. */
+    uint32_t size;
+    /** Sequence number of the frame. */
+    uint32_t seq;
+    /** Format of the frame. */
+    uint32_t width;
+    uint32_t height;
+    uint16_t format;
+    uint8_t bit_width;
+    /** The stream (camera) the frame was recorded from. */
+    uint8_t stream;
+    /**
+     * The sensor settings of the frame, see `FrameMetadata` (without its extra registers). `metadata_valid` holds
+     * its `kMeta*` flags, 0 if the frame had no metadata, as in recordings made before these fields existed.
+     */
+    uint32_t metadata_valid;
+    uint32_t exposure_lines;
+    uint16_t analogue_gain_code;
+    uint16_t digital_gain_code;
+    uint16_t frame_length_lines;
+    uint16_t line_length_pck;
+    int32_t lens_position;
+    int8_t temperature;
+    uint8_t frame_count;
+    uint16_t reserved0;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(RecordHeader) == 64, "RecordHeader is part of the file format");
+static_assert(sizeof(RecordIndexEntry) == 64, "RecordIndexEntry is part of the file format");
+
+/**
+ * @brief Struct representing the options of a `RawRecorder`.
+ */
+struct RecorderOptions {
+    /** The space preallocated for frame data, in bytes. Recording stops once it is used up. */
+    uint64_t capacity = 0;
+    /** The number of index entries. 0 means `capacity` / 1 MiB. */
+    uint64_t max_frames = 0;
+    /** The size of the writes, a multiple of `kRecordAlignment`. */
+    size_t chunk_size = 16 << 20;
+    /** The number of frames that may wait for the writer. Each of them holds on to its buffer. */
+    size_t queue_depth = 8;
+    /** Bypasses the page cache (`O_DIRECT`, `FILE_FLAG_NO_BUFFERING`). Falls back to buffered writes if unsupported. */
+    bool direct_io = true;
+    /** Backs the write buffer with huge pages, see `ArenaOptions::huge_pages`. */
+    bool huge_pages = false;
+};
+
+/**
+ * @brief Counters of a `RawRecorder`.
+ */
+struct RecorderStats {
+    /** Number of frames written. */
+    uint64_t frames;
+    /** Number of frame bytes written, without padding. */
+    uint64_t bytes;
+    /** Number of frames dropped because the writer queue was full. */
+    uint64_t dropped;
+    /** Number of frames rejected because the recording is full or closed. */
+    uint64_t rejected;
+    /** Number of failed writes. The recording stops at the first one. */
+    uint64_t write_errors;
+    /** Longest time a chunk write took, in microseconds. */
+    uint64_t max_write_us;
+};
+
+/**
+ * @brief Records raw frames into an indexed container file.
+ *
+ * The file is preallocated when the recorder is created. Frames are queued by `record()` without copying, then copied
+ * by a writer thread into a page aligned buffer of `chunk_size` bytes that is written sequentially with direct I/O,
+ * so the recording neither pollutes nor waits on the page cache. The index and the header are rewritten after every
+ * chunk, so a recording cut short by a crash or power loss stays readable up to the last chunk. Closing the recorder
+ * trims the unused preallocated space.
+ *
+ * Frames of several cameras can go into one recording, tagged with a stream id.
+ *
+ * @note Queued frames hold on to their buffers. Frames straight from `Camera::capture()` should be copied into a
+ * `BufferArena` first if the queue is deeper than the spare buffers of the SDK.
+ */
+class RawRecorder {
+   public:
+    /**
+     * @brief Creates a recording and starts the writer thread.
+     *
+     * @param path The file to create. An existing file is overwritten.
+     * @param options The options. `capacity` must not be 0.
+     *
+     * @return The recorder, or null if the file cannot be created or preallocated.
+     */
+    static std::unique_ptr<RawRecorder> create(const std::string& path, const RecorderOptions& options);
+    RawRecorder(const RawRecorder&) = delete;
+    RawRecorder& operator=(const RawRecorder&) = delete;
+    /**
+     * @brief Destructor for the RawRecorder class. Closes the recording.
+     */
+    ~RawRecorder();
+
+    /**
+     * @brief Queues a frame. Never blocks.
+     *
+     * @param frame The frame. Its `metadata()`, if any, is stored in the index entry.
+     * @param stream The stream id stored with the frame.
+     *
+     * @return `true` if the frame was queued, `false` if the queue is full or the recorder was closed.
+     */
+    bool record(FrameRef frame, uint8_t stream = 0);
+    /**
+     * @brief Records every frame of a subscriber on a thread of its own until the recorder is closed.
+     *
+     * @param subscriber The subscriber, e.g. from `FrameDispatcher::subscribe()`.
+     * @param stream The stream id stored with its frames.
+     */
+    void attach(std::shared_ptr<FrameSubscriber> subscriber, uint8_t stream);
+    /**
+     * @brief Writes the queued frames and finalizes the file. Further frames are rejected.
+     *
+     * @return `true` if every write succeeded, `false` otherwise.
+     */
+    bool close();
+
+    /** Checks if the file is written with direct I/O. */
+    bool directIo() const { return direct_io_; }
+    /** Returns the counters. */
+    RecorderStats stats() const;
+
+   private:
+    struct Pending {
+        FrameRef frame;
+        uint8_t stream = 0;
+    };
+
+    RawRecorder(intptr_t file, bool direct_io, const RecorderOptions& options, std::shared_ptr<BufferArena> chunk,
+                std::shared_ptr<BufferArena> meta);
+
+    void run();
+    void pump(std::shared_ptr<FrameSubscriber> subscriber, uint8_t stream);
+    void append(const Pending& pending);
+    bool flushChunk();
+    bool writeMeta(bool complete);
+    bool writeAt(const uint8_t* data, size_t size, uint64_t offset);
+    RecordHeader& header() { return *reinterpret_cast<RecordHeader*>(meta_data_); }
+    RecordIndexEntry* index() { return reinterpret_cast<RecordIndexEntry*>(meta_data_ + kRecordAlignment); }
+
+    intptr_t file_;
+    const bool direct_io_;
+    const uint64_t capacity_;
+    const size_t chunk_size_;
+
+    std::shared_ptr<BufferArena> chunk_arena_;
+    std::shared_ptr<BufferArena> meta_arena_;
+    // the file bytes before the frame data: the header page followed by the index
+    uint8_t* meta_data_;
+    uint8_t* chunk_data_;
+    size_t chunk_fill_ = 0;
+    // offset of the chunk in the frame data
+    uint64_t chunk_start_ = 0;
+    // number of index entries already in the file
+    uint64_t committed_ = 0;
+    bool failed_ = false;
+
+    BoundedQueue<Pending> queue_;
+    Notifier readable_;
+    std::atomic<bool> closing_{false};
+    std::mutex close_mutex_;
+    bool closed_ = false;
+    bool ok_ = true;
+    std::vector<std::thread> pumps_;
+    std::thread writer_;
+
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> write_errors_{0};
+    std::atomic<uint64_t> max_write_us_{0};
+};
+
+/**
+ * @brief Reads a recording of a `RawRecorder` through a read-only memory mapping.
+ *
+ * Opening a recording only maps it and checks its header. Any frame can then be accessed in place by its index, in
+ * constant time, without reading the frames before it.
+ */
+class RawReader {
+   public:
+    /**
+     * @brief Opens a recording.
+     *
+     * @return The reader, or null if the file cannot be mapped or is not a recording.
+     */
+    static std::unique_ptr<RawReader> open(const std::string& path);
+    RawReader(const RawReader&) = delete;
+    RawReader& operator=(const RawReader&) = delete;
+    ~RawReader();
+
+    /** Returns the header. */
+    const RecordHeader& header() const { return *reinterpret_cast<const RecordHeader*>(base_); }
+    /** Checks if the recording was closed cleanly. */
+    bool complete() const { return (header().flags & kRecordComplete) != 0; }
+    /** Returns the number of frames. */
+    size_t frameCount() const { return frame_count_; }
+    /** Returns the index entry of a frame. `i` must be below `frameCount()`. */
+    const RecordIndexEntry& entry(size_t i) const { return entries_[i]; }
+
+    /**
+     * @brief Returns a frame, pointing into the mapping.
+     *
+     * @param i The index of the frame.
+     * @param frame Receives the frame. Valid as long as the reader.
+     *
+     * @return `true` on success, `false` if `i` is out of range.
+     */
+    bool frame(size_t i, Frame& frame) const;
+    /**
+     * @brief Returns a frame as a handle, e.g. to feed it to a `FrameDispatcher`. The reader must outlive the handle.
+     *
+     * The metadata of the frame, if it was recorded with it, is attached to the handle.
+     *
+     * @return The handle, or an empty handle if `i` is out of range.
+     */
+    FrameRef frameRef(size_t i) const;
+    /**
+     * @brief Returns the metadata of a frame, as recorded from `FrameRef::metadata()`.
+     *
+     * @return `true` on success, `false` if `i` is out of range or the frame was recorded without metadata.
+     */
+    bool metadata(size_t i, FrameMetadata& metadata) const;
+
+   private:
+    RawReader(const uint8_t* base, uint64_t size, intptr_t mapping);
+
+    const uint8_t* base_;
+    uint64_t size_;
+    intptr_t mapping_;
+    const RecordIndexEntry* entries_;
+    size_t frame_count_;
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/EventDispatcher.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+class ModeSwitcher;
+
+/**
+ * @brief Struct representing a register write.
+ */
+struct RegWrite {
+    uint32_t reg;
+    uint32_t value;
+};
+
+/**
+ * @brief Struct representing a register read.
+ */
+struct RegRead {
+    uint32_t reg;
+    /** Receives the value. */
+    uint32_t value;
+};
+
+/**
+ * @brief Struct representing the options of the batched register functions.
+ */
+struct RegBatchOptions {
+    /** The register layout of the sensor. Only the 8-bit data modes (`8_8`, `16_8`) merge registers. */
+    I2CMode mode = I2CMode::I2C_MODE_16_8;
+    /** The I2C address of the sensor. 0 means `Camera::i2cAddr()`. */
+    uint32_t i2c_addr = 0;
+    /**
+     * The largest number of consecutive registers merged into one transaction: 1, 2 or 4. The sensor increments the
+     * register address within a transaction, so a 16-bit write to `0x0202` sets `0x0202` and `0x0203` in one USB round
+     * trip. 4 needs an SDK with `I2C_MODE_16_32` support.
+     */
+    uint8_t max_merge = 2;
+    /**
+     * Wraps the writes in a grouped parameter hold (`group_hold_reg` = 1 ... 0), so that the sensor applies them all
+     * on the same frame.
+     */
+    bool group_hold = false;
+    /**
+     * The grouped parameter hold register (`0x0104` on IMX708 and most MIPI sensors). It is 8 bits wide and written
+     * with `groupHoldMode(mode)`, whatever the data width of `mode`.
+     */
+    uint32_t group_hold_reg = 0x0104;
+    /** Told about every register written (`ModeSwitcher::invalidate()`), so that its reduced switches rewrite them. */
+    ModeSwitcher* mode_switcher = nullptr;
+};
+
+/**
+ * @brief Returns the mode the 8-bit group hold register is written with: `I2C_MODE_8_8` for the sensors with 8-bit
+ * register addresses, `I2C_MODE_16_8` for the others.
+ */
+I2CMode groupHoldMode(I2CMode mode);
+
+/**
+ * @brief Writes several sensor registers with as few transactions as possible.
+ *
+ * Runs of consecutive registers listed in ascending order (e.g. exposure `0x0202`, `0x0203`) go out as one wider
+ * write. The writes are otherwise sent in the given order.
+ *
+ * @param camera The camera.
+ * @param regs The writes.
+ * @param count The number of writes.
+ * @param options The register layout and merging options.
+ * @param transactions Receives the number of I2C transactions used, may be null.
+ *
+ * @return `true` on success, `false` if a write failed. The remaining writes are skipped, but the group hold is
+ * released.
+ */
+bool writeRegs(Camera& camera, const RegWrite* regs, size_t count, const RegBatchOptions& options = RegBatchOptions(),
+               size_t* transactions = nullptr);
+/**
+ * @brief Reads several sensor registers with as few transactions as possible.
+ *
+ * Runs of consecutive registers listed in ascending order are read with one wider read.
+ *
+ * @return `true` on success, `false` if a read failed. The remaining reads are skipped.
+ */
+bool readRegs(Camera& camera, RegRead* regs, size_t count, const RegBatchOptions& options = RegBatchOptions(),
+              size_t* transactions = nullptr);
+
+/**
+ * @brief Counters of a `FrameStartWriter`.
+ */
+struct FrameStartWriterStats {
+    /** Number of `FrameStart` events seen. */
+    uint64_t frames;
+    /** Number of batches written. */
+    uint64_t batches;
+    /** Number of register writes submitted. */
+    uint64_t writes;
+    /** Number of register writes dropped because a later submission to the same register replaced them. */
+    uint64_t replaced;
+    /** Number of I2C transactions used. */
+    uint64_t transactions;
+    /** Number of batches that failed. */
+    uint64_t failures;
+    /** Time from the `FrameStart` event to the end of the last batch, in microseconds. */
+    uint64_t last_latency_us;
+};
+
+/**
+ * @brief Applies register writes right after the next `FrameStart` event.
+ *
+ * Writes submitted between two frames are collected (the last value of a register wins) and sent as one batch,
+ * wrapped in a group hold, by a worker thread woken by `FrameStart`. A control loop can therefore submit the
+ * exposure, gain and frame length of a frame at any time and have them land together, at the earliest frame the
+ * sensor can still take them, instead of racing individual writes against the frame boundary.
+ */
+class FrameStartWriter {
+   public:
+    /**
+     * @brief Starts the worker and listens to the events of the camera.
+     *
+     * @param camera The camera. Must outlive the writer.
+     * @param events The event dispatcher of the camera. Must outlive the writer.
+     * @param options The register options. `group_hold` is forced on.
+     */
+    FrameStartWriter(Camera& camera, EventDispatcher& events, RegBatchOptions options = RegBatchOptions());
+    FrameStartWriter(const FrameStartWriter&) = delete;
+    FrameStartWriter& operator=(const FrameStartWriter&) = delete;
+    ~FrameStartWriter();
+
+    /**
+     * @brief Queues writes for the next frame start.
+     */
+    void submit(const RegWrite* regs, size_t count);
+    /** @overload */
+    void submit(const std::vector<RegWrite>& regs) { submit(regs.data(), regs.size()); }
+    /**
+     * @brief Writes the queued writes now, without waiting for a frame start.
+     *
+     * @return `true` on success or if nothing was queued, `false` if a write failed.
+     */
+    bool flush();
+    /** Returns the counters. */
+    FrameStartWriterStats stats() const;
+
+   private:
+    void onEvent(EventCode event);
+    void run();
+    bool write(std::vector<RegWrite>& batch, uint64_t event_time_us);
+
+    Camera& camera_;
+    EventDispatcher& events_;
+    RegBatchOptions options_;
+    int listener_ = -1;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<RegWrite> pending_;
+    // set by a FrameStart event while writes are pending
+    bool frame_started_ = false;
+    uint64_t frame_start_us_ = 0;
+    bool stopping_ = false;
+    FrameStartWriterStats stats_{};
+    // serializes the batches of the worker and flush()
+    std::mutex write_mutex_;
+    std::thread worker_;
+};
+
+}  // namespace Arducam
+
+/** @} */
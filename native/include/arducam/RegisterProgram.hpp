@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam_config_parser.h>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Enum class representing the kinds of register program operations.
+ */
+enum class RegOpType : uint8_t {
+    SensorWrite = 0x01,  /**< `Camera::writeSensorReg(address, value)` */
+    Delay = 0x02,        /**< Sleep for `value` milliseconds */
+    BoardCommand = 0x03, /**< `Camera::writeBoardConfig(command, value, index, payload, length)` */
+};
+
+/**
+ * @brief Struct representing one operation of a register program.
+ */
+struct RegOp {
+    RegOpType type;
+    /** The vendor command of a `BoardCommand`. */
+    uint8_t command;
+    /** The index of a `BoardCommand`. */
+    uint16_t index;
+    /** The register of a `SensorWrite`, or the offset of the payload of a `BoardCommand` in the program payload. */
+    uint32_t address;
+    /** The value of a `SensorWrite` or `BoardCommand`, or the duration of a `Delay`. */
+    uint32_t value;
+    /** The payload size of a `BoardCommand`, in bytes. */
+    uint32_t length;
+};
+
+/**
+ * @brief Struct representing the options of `RegisterProgram::diff()`.
+ *
+ * The defaults are the CCI registers of the IMX708 (and most MIPI sensors).
+ */
+struct DiffOptions {
+    /** Registers written even if they already hold the value, e.g. `mode_select` which starts streaming. */
+    std::vector<uint32_t> always_write = {0x0100};
+    /** Registers that reset the sensor. A program writing one of them is never reduced. */
+    std::vector<uint32_t> reset_registers = {0x0103};
+};
+
+/**
+ * @brief The register sequence of one camera mode, compiled from a parsed configuration file.
+ *
+ * `arducam_parse_config()` keeps every line of a configuration as a `Config` of 16 parameters. A program only keeps
+ * the sensor writes, delays and board commands of the `[board parameter]` and `[register parameter]` sections, as
+ * 16 byte operations plus one shared payload buffer, and can be stored in a binary cache (`saveProgramCache()`) so that
+ * the text files are parsed only once.
+ */
+class RegisterProgram {
+   public:
+    RegisterProgram() = default;
+
+    /**
+     * @brief Compiles a parsed configuration.
+     *
+     * @param configs The output of `arducam_parse_config()`.
+     * @param usb_type The USB type byte of the sections to keep (see `SECTION_TYPE_REG_3_2`). Sections without a
+     * USB type are always kept. 0 keeps only those.
+     * @param program Receives the program.
+     *
+     * @return `true` on success, `false` if a configuration entry is malformed.
+     */
+    static bool compile(const CameraConfigs& configs, uint8_t usb_type, RegisterProgram& program);
+    /**
+     * @brief Parses and compiles a configuration file.
+     *
+     * @return `true` on success, `false` if the file cannot be parsed or compiled.
+     */
+    static bool compileFile(const std::string& path, uint8_t usb_type, RegisterProgram& program);
+
+    /** Returns the mode id (`cfg_mode` of the configuration). */
+    uint32_t modeId() const { return mode_id_; }
+    /** Returns the camera configuration of the mode. */
+    const ArducamCameraConfig& config() const { return config_; }
+    /** Returns the operations. */
+    const std::vector<RegOp>& ops() const { return ops_; }
+    /** Returns the payload of the board commands. */
+    const std::vector<uint8_t>& payload() const { return payload_; }
+    /** Returns the number of sensor writes. */
+    size_t writeCount() const;
+    /** Checks if the mode produces frames of the same size and format as `other`. */
+    bool sameFormat(const RegisterProgram& other) const;
+
+    /**
+     * @brief Reduces this program to the operations needed when the sensor currently runs `from`.
+     *
+     * The register state left by `from` is tracked while this program is walked; a write is dropped if the register
+     * already holds the value and a board command is dropped if `from` sent the same one. Delays are kept if a write or
+     * command since the previous delay was kept.
+     *
+     * @return The reduced program, or a copy of this program if it writes a reset register.
+     */
+    RegisterProgram diff(const RegisterProgram& from, const DiffOptions& options = DiffOptions()) const;
+    /**
+     * @brief Runs the program.
+     *
+     * Runs of sensor writes between delays and board commands go out through `writeRegs()`: consecutive registers
+     * are merged into wider transactions, in the I2C mode and at the address of the camera.
+     *
+     * @param camera The camera.
+     * @param max_merge The largest number of registers merged into one transaction, see `RegBatchOptions::max_merge`.
+     *
+     * @return `true` on success, `false` if a camera call failed. The remaining operations are skipped.
+     */
+    bool run(Camera& camera, uint8_t max_merge = 2) const;
+
+    /** Appends the binary form of the program. */
+    void serialize(std::vector<uint8_t>& out) const;
+    /**
+     * @brief Reads the binary form of a program.
+     *
+     * @param data The data.
+     * @param size The size of the data.
+     * @param consumed Receives the number of bytes read.
+     *
+     * @return `true` on success, `false` if the data is truncated or malformed.
+     */
+    bool deserialize(const uint8_t* data, size_t size, size_t& consumed);
+
+   private:
+    uint32_t mode_id_ = 0;
+    ArducamCameraConfig config_{};
+    std::vector<RegOp> ops_;
+    std::vector<uint8_t> payload_;
+};
+
+/**
+ * @brief Writes programs into a binary cache file.
+ *
+ * @return `true` on success, `false` if the file cannot be written.
+ */
+bool saveProgramCache(const std::string& path, const std::vector<RegisterProgram>& programs);
+/**
+ * @brief Reads programs from a binary cache file.
+ *
+ * @return `true` on success, `false` if the file cannot be read, is not a cache or was written by another version.
+ */
+bool loadProgramCache(const std::string& path, std::vector<RegisterProgram>& programs);
+/**
+ * @brief Releases the output of `arducam_parse_config()`, which has no release function of its own: the code string
+ * of every control, then both arrays. The struct is left empty.
+ */
+void freeParsedConfigs(CameraConfigs& configs);
+
+/**
+ * @brief Switches a camera between modes with as few register writes as possible.
+ *
+ * Between two modes of the same frame size and format (exposure presets, frame rate or test pattern variants) only the
+ * writes of `RegisterProgram::diff()` are sent and the SDK is not reloaded. Any other switch goes through
+ * `Camera::switchMode()`. The reduced programs are computed once per pair of modes.
+ *
+ * A reduced switch assumes the sensor still holds what the program of the current mode wrote. Registers written
+ * since by other paths must be reported with `invalidate()`, or the switch may skip writes it needs: `writeRegs()`
+ * and everything built on it (`ControlScheduler`, `FrameStartWriter`) do it with `RegBatchOptions::mode_switcher`,
+ * `ControlScheduler` also reports its `setControl()` commits, and `applySensorWindow()` takes the switcher too.
+ * Direct `Camera::writeSensorReg()`, `writeReg()` or `setControl()` calls need an explicit `invalidate()`.
+ *
+ * @note The camera must be stopped around a switch, like for `Camera::switchMode()`. `invalidate()` may be called
+ * from any thread.
+ */
+class ModeSwitcher {
+   public:
+    explicit ModeSwitcher(Camera& camera, DiffOptions options = DiffOptions());
+
+    /** Adds the program of a mode, replacing any program with the same mode id. */
+    void addProgram(RegisterProgram program);
+    /** Returns the program of a mode, or null. */
+    const RegisterProgram* program(uint32_t mode_id) const;
+    /** Tells the switcher which mode the camera currently runs, e.g. after opening it. */
+    void setCurrentMode(uint32_t mode_id);
+    /**
+     * @brief Returns the mode the camera currently runs.
+     *
+     * @return `true` if it is known, `false` otherwise.
+     */
+    bool currentMode(uint32_t& mode_id) const;
+    /**
+     * @brief Reports a register written outside the switcher: the next reduced switch rewrites it if the new mode's
+     * program writes it at all.
+     */
+    void invalidate(uint32_t reg);
+    /**
+     * @brief Reports that the sensor state is unknown, e.g. after a `setControl()` whose registers are not known: the
+     * next switch between modes of the same format runs the whole program of the new mode.
+     */
+    void invalidate();
+
+    /**
+     * @brief Switches the camera to a mode.
+     *
+     * @return `true` on success, `false` if the switch failed. The current mode is unknown afterwards.
+     */
+    bool switchTo(uint32_t mode_id);
+    /** Returns the number of sensor writes of the last switch, or -1 if it went through `Camera::switchMode()`. */
+    int lastWriteCount() const { return last_writes_; }
+
+   private:
+    Camera& camera_;
+    DiffOptions options_;
+    std::map<uint32_t, RegisterProgram> programs_;
+    std::map<std::pair<uint32_t, uint32_t>, RegisterProgram> diffs_;
+    bool has_current_ = false;
+    uint32_t current_ = 0;
+    int last_writes_ = 0;
+
+    // the registers written by others since the last switch, under `mutex_`
+    std::mutex mutex_;
+    std::set<uint32_t> dirty_;
+    bool dirty_all_ = false;
+};
+
+}  // namespace Arducam
+
+/** @} */
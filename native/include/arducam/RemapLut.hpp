@@ -0,0 +1,255 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <arducam/PixelKernels.hpp>
+#include <arducam/WorkerPool.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the geometric correction of one camera.
+ *
+ * The steps match `image_post_processing_v1.1.py` and `Exposure_Sweep_Script.py` and run in this order: crop, pad,
+ * radial undistortion (discorpy backward model), perspective correction (discorpy 8 coefficient model) and rotation.
+ * Every disabled step is skipped.
+ */
+struct CorrectionParams {
+    /** The left edge of the crop window, in sensor pixels. */
+    uint32_t crop_x = 0;
+    /** The top edge of the crop window, in sensor pixels. */
+    uint32_t crop_y = 0;
+    /** The width of the crop window. 0 extends the window to the right edge of the image. */
+    uint32_t crop_width = 0;
+    /** The height of the crop window. 0 extends the window to the bottom edge of the image. */
+    uint32_t crop_height = 0;
+    /** Black rows added above the crop window before undistortion. */
+    uint32_t pad_top = 0;
+    /** Black rows added below the crop window before undistortion. */
+    uint32_t pad_bottom = 0;
+
+    /** Enables the radial undistortion. */
+    bool radial = false;
+    /** The center of distortion, in crop window coordinates. */
+    double xcenter = 0;
+    double ycenter = 0;
+    /** The backward polynomial: a pixel at radius `r` from the center samples radius `r * sum(coeffs[i] * r^i)`. */
+    std::vector<double> coeffs;
+
+    /** Enables the perspective correction. */
+    bool perspective = false;
+    /** The perspective coefficients: `x' = (c0 x + c1 y + c2) / (c6 x + c7 y + 1)`, `y' = (c3 x + c4 y + c5) / (..)`. */
+    std::array<double, 8> pers_coef{};
+
+    /** The rotation about the image center in degrees, counter-clockwise like `cv2.getRotationMatrix2D`. */
+    double rotation = 0;
+};
+
+/**
+ * @brief Reads the correction of one camera from a coefficient file written by the calibration scripts.
+ *
+ * The camera object (e.g. `"cam0"` in `distortion_coefficients_dual.json`) provides `xcenter`, `ycenter`, `coeffs`,
+ * the optional `pers_coef` and the optional `crop_params`. The padding and rotation are not stored in the file and
+ * keep their values in `params`.
+ *
+ * @param path The path of the JSON file.
+ * @param camera The name of the camera object.
+ * @param params Receives the correction.
+ *
+ * @return `true` on success, `false` if the file cannot be read or parsed, or has no such camera.
+ */
+bool loadCorrectionParams(const std::string& path, const std::string& camera, CorrectionParams& params);
+
+/**
+ * @brief Computes the size of the corrected image for a source image size.
+ *
+ * @return `true` on success, `false` if the crop window leaves less than 2x2 pixels.
+ */
+bool correctedSize(const CorrectionParams& params, uint32_t src_width, uint32_t src_height, uint32_t& width,
+                   uint32_t& height);
+
+/**
+ * @brief Struct representing a rectangle of source pixels, `[x0, x1) x [y0, y1)`.
+ */
+struct SourceBox {
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t x1;
+    uint32_t y1;
+};
+
+/**
+ * @brief A precomputed fixed-point map from corrected pixels to source pixels.
+ *
+ * All correction steps are folded into one table when it is built, so applying it costs one bilinear sample per
+ * output pixel whatever the steps are. The table holds a 2x2 source block and 1/32 pixel weights per output pixel (6
+ * bytes), addresses the full source image (the crop offset is part of the table) and only depends on the source size,
+ * so it is built once per camera and sensor mode. Output pixels that sample outside the crop window are black.
+ */
+class RemapLut {
+   public:
+    /** The width of the output tiles, in pixels. */
+    static constexpr uint32_t kTileWidth = 256;
+    /** The height of the output tiles, in rows. */
+    static constexpr uint32_t kTileHeight = 16;
+
+    /**
+     * @brief Builds the table.
+     *
+     * @param params The correction.
+     * @param src_width The width of the source images.
+     * @param src_height The height of the source images.
+     * @param pool Runs the build on several threads if not null.
+     *
+     * @return `true` on success, `false` if the crop window leaves less than 2x2 pixels or the source is larger than
+     * 65536 pixels in either direction.
+     */
+    bool build(const CorrectionParams& params, uint32_t src_width, uint32_t src_height, WorkerPool* pool = nullptr);
+    /** Releases the table. */
+    void clear();
+
+    /** Checks if the table is built. */
+    bool empty() const { return coords_.empty(); }
+    /** Returns the width of the output images. */
+    uint32_t width() const { return width_; }
+    /** Returns the height of the output images. */
+    uint32_t height() const { return height_; }
+    /** Returns the width of the source images the table was built for. */
+    uint32_t srcWidth() const { return src_width_; }
+    /** Returns the height of the source images the table was built for. */
+    uint32_t srcHeight() const { return src_height_; }
+    /** Returns the size of the table in bytes. */
+    size_t memoryUsage() const {
+        return coords_.size() * sizeof(uint32_t) + weights_.size() * sizeof(uint16_t) +
+               source_boxes_.size() * sizeof(SourceBox);
+    }
+    /**
+     * @brief Returns the source pixels the output rectangle `[x0, x1) x [y0, y1)` reads.
+     *
+     * The box is the union of the boxes of the tiles the rectangle touches, so it may be a little larger than needed.
+     *
+     * @param box Receives the box.
+     *
+     * @return `true` on success, `false` if every pixel of the rectangle lies outside the crop window, reading nothing.
+     */
+    bool sourceBox(uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, SourceBox& box) const;
+
+    /**
+     * @brief Corrects an image.
+     *
+     * The output is cut into `kTileWidth` x `kTileHeight` tiles, which keeps the source rows a tile reads in cache
+     * and spreads the tiles over the pool.
+     *
+     * @param format The format of the source and output images. `Raw16` is treated like `Y16`.
+     * @param src The source image, `srcWidth()` x `srcHeight()` pixels.
+     * @param src_stride The size of a source row in bytes. 0 means `srcWidth() * outputPixelSize(format)`.
+     * @param dst The output image, `width()` x `height()` pixels.
+     * @param dst_stride The size of an output row in bytes. 0 means `width() * outputPixelSize(format)`.
+     * @param pool Runs the tiles on several threads if not null.
+     *
+     * @return `true` on success, `false` if the table is empty.
+     */
+    bool apply(OutputFormat format, const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+               WorkerPool* pool = nullptr) const;
+    /**
+     * @brief Corrects the output rows `[y0, y1)` on the calling thread, for callers that schedule the work themselves.
+     *
+     * The strides must be given explicitly. See `apply()`.
+     */
+    void applyRows(OutputFormat format, const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+                   uint32_t y0, uint32_t y1) const;
+    /**
+     * @brief Corrects the output rectangle `[x0, x1) x [y0, y1)` from a window of the source, on the calling thread.
+     *
+     * @param src The top-left pixel of the window.
+     * @param window The source pixels the window holds. Must contain `sourceBox()` of the rectangle.
+     * @param dst The output pixel `(x0, y0)`.
+     *
+     * See `apply()`; the strides must be given explicitly.
+     */
+    void applyWindow(OutputFormat format, const uint8_t* src, size_t src_stride, const SourceBox& window, uint8_t* dst,
+                     size_t dst_stride, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1) const;
+
+   private:
+    // `dst` is the output pixel `(x0, y0)`
+    void applyTile(const RemapRowArgs& base, uint8_t* dst, size_t dst_stride, uint32_t x0, uint32_t x1, uint32_t y0,
+                   uint32_t y1) const;
+
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    uint32_t src_width_ = 0;
+    uint32_t src_height_ = 0;
+    std::vector<uint32_t> coords_;
+    std::vector<uint16_t> weights_;
+    // the source pixels read by every tile, row by row
+    std::vector<SourceBox> source_boxes_;
+};
+
+/**
+ * @brief Converts and corrects the frames of one camera.
+ *
+ * Each frame from `Camera::capture()` is converted with `convertFrame()` into an internal image and then remapped into
+ * the caller's buffer. The table is rebuilt whenever the frame size changes, e.g. after `Camera::switchMode()`. One
+ * corrector serves one capture thread; the two cameras of a stereo pair use one corrector each and may share a pool.
+ */
+class FrameCorrector {
+   public:
+    /**
+     * @brief Creates a corrector.
+     *
+     * @param params The correction.
+     * @param convert The conversion options. `Raw16` output is not supported.
+     * @param pool Runs the table build and the remap on several threads if not null. Not owned.
+     */
+    explicit FrameCorrector(const CorrectionParams& params, const ConvertOptions& convert = ConvertOptions(),
+                            WorkerPool* pool = nullptr);
+
+    /**
+     * @brief Replaces the correction. The table is rebuilt with the next frame.
+     */
+    void setParams(const CorrectionParams& params);
+    /** Returns the correction. */
+    const CorrectionParams& params() const { return params_; }
+    /** Returns the conversion options. */
+    const ConvertOptions& convertOptions() const { return convert_; }
+    /** Returns the table of the last frame size. Empty before the first frame. */
+    const RemapLut& lut() const { return lut_; }
+
+    /**
+     * @brief Builds the table for a source size ahead of the first frame, so that it does not delay that frame.
+     *
+     * @return `true` on success, `false` if the correction does not fit the size.
+     */
+    bool prepare(uint32_t src_width, uint32_t src_height);
+    /**
+     * @brief Converts and corrects a frame.
+     *
+     * @param frame The frame.
+     * @param dst The output image. Its size is given by `correctedSize()` for the frame size.
+     * @param dst_stride The size of an output row in bytes. 0 means `width * outputPixelSize(output)`.
+     *
+     * @return `true` on success, `false` if the frame cannot be converted or the correction does not fit its size.
+     */
+    bool process(const Frame& frame, uint8_t* dst, size_t dst_stride = 0);
+
+   private:
+    CorrectionParams params_;
+    ConvertOptions convert_;
+    WorkerPool* pool_;
+    RemapLut lut_;
+    std::vector<uint8_t> image_;
+    std::vector<uint16_t> scratch_;
+};
+
+}  // namespace Arducam
+
+/** @} */
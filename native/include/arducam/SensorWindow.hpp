@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BufferArena.hpp>
+#include <arducam/RegisterBatch.hpp>
+#include <arducam/RemapLut.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the pixel array and window registers of a sensor.
+ *
+ * The defaults are the IMX708. The registers are the standard MIPI CCI ones, so other Sony sensors mostly only need
+ * another array size.
+ */
+struct SensorGeometry {
+    /** The size of the active pixel array. */
+    uint32_t array_width = 4608;
+    uint32_t array_height = 2592;
+    /** The horizontal start and width of a window must be multiples of this. */
+    uint32_t x_step = 16;
+    /** The vertical start and height of a window must be multiples of this (keeps the bayer phase). */
+    uint32_t y_step = 4;
+
+    /** `X_ADD_STA`, `Y_ADD_STA`, `X_ADD_END`, `Y_ADD_END`: the analog crop, 16-bit each. */
+    uint32_t x_start_reg = 0x0344;
+    uint32_t y_start_reg = 0x0346;
+    uint32_t x_end_reg = 0x0348;
+    uint32_t y_end_reg = 0x034A;
+    /** `X_OUT_SIZE`, `Y_OUT_SIZE`: the output size, 16-bit each. */
+    uint32_t x_out_reg = 0x034C;
+    uint32_t y_out_reg = 0x034E;
+    /** `DIG_CROP_IMAGE_WIDTH`, `DIG_CROP_IMAGE_HEIGHT`, preceded by the 16-bit offsets. 0 skips the digital crop. */
+    uint32_t digital_crop_reg = 0x0408;
+    /** `BINNING_MODE`, followed by `BINNING_TYPE`. */
+    uint32_t binning_reg = 0x0900;
+    /** `FRAME_LENGTH_LINES`, 16-bit. */
+    uint32_t frame_length_reg = 0x0340;
+};
+
+/**
+ * @brief Struct representing a sensor readout window.
+ */
+struct SensorWindow {
+    /** The window in pixel array coordinates. */
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    /** 1 for full resolution, 2 for 2x2 binning. The output is `width / binning` x `height / binning`. */
+    uint8_t binning = 1;
+    /**
+     * The frame length in lines. A smaller window reads out in fewer lines, so a shorter frame raises the frame rate.
+     * 0 keeps the frame length of the mode.
+     */
+    uint32_t frame_length = 0;
+
+    /** Returns the output width. */
+    uint32_t outputWidth() const { return binning != 0 ? width / binning : 0; }
+    /** Returns the output height. */
+    uint32_t outputHeight() const { return binning != 0 ? height / binning : 0; }
+};
+
+/**
+ * @brief Checks if a window fits the pixel array and the alignment of the sensor.
+ */
+bool validWindow(const SensorGeometry& geometry, const SensorWindow& window);
+/**
+ * @brief Returns the smallest valid window centered on the pixel array that holds `width` x `height` pixels.
+ *
+ * @return `true` on success, `false` if the size does not fit the pixel array.
+ */
+bool centeredWindow(const SensorGeometry& geometry, uint32_t width, uint32_t height, uint8_t binning,
+                    SensorWindow& window);
+/**
+ * @brief Returns the smallest valid window holding the crop window of a correction, and the correction to apply to
+ * frames of that window.
+ *
+ * The crop of `params` (as kept by `crop_image` in the Python scripts) is given in full resolution sensor pixels. The
+ * window is aligned around it and the remaining correction is cropped relative to the window and, with binning,
+ * scaled down, so that `FrameCorrector` produces the same image from the windowed frames.
+ *
+ * @param geometry The sensor.
+ * @param params The correction of full resolution frames.
+ * @param binning The binning of the window.
+ * @param window Receives the window.
+ * @param windowed Receives the correction of the windowed frames.
+ *
+ * @return `true` on success, `false` if the crop does not fit the pixel array.
+ */
+bool windowForCrop(const SensorGeometry& geometry, const CorrectionParams& params, uint8_t binning,
+                   SensorWindow& window, CorrectionParams& windowed);
+
+/**
+ * @brief Returns the register writes of a window, in ascending register order so that `writeRegs()` merges them.
+ */
+std::vector<RegWrite> windowWrites(const SensorGeometry& geometry, const SensorWindow& window);
+/**
+ * @brief Returns the camera configuration of a mode `base` read out through a window.
+ */
+ArducamCameraConfig windowConfig(const ArducamCameraConfig& base, const SensorWindow& window);
+
+/**
+ * @brief Reads out a window of the current mode.
+ *
+ * The camera is stopped, its configuration is resized to the window with `Camera::setConfig()`, the window registers
+ * are written and the transfers are sized for the smaller frames, so the USB bandwidth and the SDK buffers shrink
+ * with the window. Going back to the full frame is a `Camera::switchMode()` to the mode.
+ *
+ * @param camera The camera.
+ * @param geometry The sensor.
+ * @param window The window.
+ * @param transfers The transfer configuration to use, or null to use the recommendation of `setAutoTransfer()` for
+ * the window.
+ * @param restart Starts the camera again afterwards.
+ * @param mode_switcher The `ModeSwitcher` of the camera if any, told that the sensor state changed (the configuration
+ * reload rewrites the registers of the mode), so that its next switch writes the whole program.
+ *
+ * @return `true` on success, `false` if the window is invalid or a camera call failed.
+ */
+bool applySensorWindow(Camera& camera, const SensorGeometry& geometry, const SensorWindow& window,
+                       const TransferConfig* transfers = nullptr, bool restart = true,
+                       ModeSwitcher* mode_switcher = nullptr);
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arducam/BoundedQueue.hpp>
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/FrameRef.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Enum class representing the two cameras of a stereo rig.
+ */
+enum class StereoSide : uint8_t {
+    Left = 0x00,  /**< Left camera (cam0) */
+    Right = 0x01, /**< Right camera (cam1) */
+};
+
+/**
+ * @brief Struct representing two frames captured at the same time by a stereo rig.
+ */
+struct StereoPair {
+    /** Frame of the left camera. */
+    FrameRef left;
+    /** Frame of the right camera. */
+    FrameRef right;
+    /** Capture time of the right frame minus the capture time of the left one, in 100 nanoseconds. */
+    int64_t skew = 0;
+};
+
+/**
+ * @brief Struct representing the options of a `StereoPairer`.
+ */
+struct StereoPairerOptions {
+    /** Maximum capture time difference of two paired frames, in 100 nanoseconds. Default: 5 ms. */
+    int64_t tolerance = 50000;
+    /** Maximum number of frames waiting for a partner, per camera. */
+    size_t max_pending = 4;
+    /** Maximum number of pairs waiting to be popped. The oldest pair is dropped when full. */
+    size_t output_capacity = 4;
+    /** Time source both cameras were configured with (`Camera::setTimeSource()`). */
+    TimeSource time_source = TimeSource::Firmware;
+    /** Number of recent frames the clock offset of a camera is estimated from. */
+    uint32_t offset_window = 32;
+};
+
+/**
+ * @brief Struct representing the counters of a `StereoPairer`.
+ */
+struct StereoPairerStats {
+    /** Number of pairs emitted. */
+    uint64_t pairs;
+    /** Number of frames of each camera that found no partner, indexed by `StereoSide`. */
+    uint64_t unmatched[2];
+    /** Number of pairs dropped because nobody popped them in time. */
+    uint64_t dropped_pairs;
+    /** Current clock offset estimate of each camera (host time minus device time), in 100 nanoseconds. */
+    int64_t offset[2];
+    /** Largest absolute skew of an emitted pair, in 100 nanoseconds. */
+    int64_t max_skew;
+};
+
+/**
+ * @brief Estimates the offset between the clock of a device and the host clock.
+ *
+ * Each sample is the host time a frame arrived at minus its device timestamp, i.e. the true offset plus a
+ * transfer latency that is never negative. The smallest sample in a sliding window is therefore the best estimate,
+ * and the window keeps following a slowly drifting device clock.
+ */
+class ClockOffsetEstimator {
+   public:
+    /**
+     * @brief Constructs an estimator.
+     *
+     * @param window Number of recent samples to keep.
+     */
+    explicit ClockOffsetEstimator(uint32_t window = 32);
+
+    /** Forgets every sample, e.g. after the device clock was re-synchronized. */
+    void reset();
+    /**
+     * @brief Adds a sample.
+     *
+     * @param host The host time the frame arrived at.
+     * @param device The device timestamp of the frame, in the same unit.
+     */
+    void addSample(int64_t host, int64_t device);
+    /** Returns the current estimate, or 0 if there is no sample. */
+    int64_t offset() const { return offset_; }
+    /** Checks if there is at least one sample. */
+    bool valid() const { return count_ > 0; }
+
+   private:
+    std::vector<int64_t> samples_;
+    uint32_t next_ = 0;
+    uint32_t count_ = 0;
+    int64_t offset_ = 0;
+};
+
+/**
+ * @brief Pairs the frames of two cameras by their capture time.
+ *
+ * Frame timestamps of both cameras are mapped to the host clock via a per-camera `ClockOffsetEstimator`, and a frame
+ * is paired with the frame of the other camera closest in time, as long as they are within
+ * `StereoPairerOptions::tolerance`. A dropped frame on one side therefore only costs that one pair, unlike pairing by
+ * sequence number. Frames that can no longer be matched are reported and released immediately.
+ *
+ * When the `SyncTime` event of a camera is received (see `attach()`), its offset estimate is restarted.
+ */
+class StereoPairer {
+   public:
+    /**
+     * Defines a function type for the unmatched frame callback.
+     *
+     * @param side The camera the frame belongs to.
+     * @param frame The frame that found no partner.
+     */
+    using UnmatchedCallback = std::function<void(StereoSide side, const FrameRef& frame)>;
+
+   public:
+    /**
+     * @brief Constructs a pairer that captures from two cameras.
+     *
+     * Both cameras should use `TimeSource::Firmware`, which gives 100 ns timestamps.
+     *
+     * @param left The left camera. Must outlive the pairer and every emitted pair.
+     * @param right The right camera. Must outlive the pairer and every emitted pair.
+     * @param options The pairing options.
+     */
+    StereoPairer(Camera& left, Camera& right, const StereoPairerOptions& options = StereoPairerOptions());
+    /**
+     * @brief Constructs a pairer without cameras. Frames must be fed through `push()`.
+     *
+     * @param options The pairing options.
+     */
+    explicit StereoPairer(const StereoPairerOptions& options = StereoPairerOptions());
+    StereoPairer(const StereoPairer&) = delete;
+    StereoPairer& operator=(const StereoPairer&) = delete;
+    /**
+     * @brief Destructor for the StereoPairer class. Stops the capture threads and detaches from the events.
+     */
+    ~StereoPairer() noexcept;
+
+    /**
+     * @brief Restarts the clock offset estimate of a camera on its `SyncTime` event.
+     *
+     * @param left The event dispatcher of the left camera. Must outlive the pairer or `detach()` must be called.
+     * @param right The event dispatcher of the right camera. Must outlive the pairer or `detach()` must be called.
+     */
+    void attach(EventDispatcher& left, EventDispatcher& right);
+    /**
+     * @brief Stops listening to the events registered with `attach()`.
+     */
+    void detach();
+
+    /**
+     * @brief Starts one capture thread per camera.
+     *
+     * @return `true` if the threads were started, `false` if there are no cameras or they are already running.
+     */
+    bool start();
+    /**
+     * @brief Stops the capture threads. Pending frames are kept.
+     */
+    void stop();
+
+    /**
+     * @brief Feeds a frame of one camera. Safe to call from two threads, one per camera.
+     *
+     * @param side The camera the frame belongs to.
+     * @param frame The frame.
+     */
+    void push(StereoSide side, FrameRef frame);
+    /**
+     * @brief Restarts the clock offset estimate of a camera.
+     *
+     * @param side The camera whose clock was re-synchronized.
+     */
+    void resync(StereoSide side);
+    /**
+     * @brief Releases every frame waiting for a partner, without reporting them as unmatched.
+     */
+    void clear();
+
+    /**
+     * @brief Takes the oldest pair without waiting.
+     *
+     * @param pair Receives the pair.
+     *
+     * @return `true` if a pair was available, `false` otherwise.
+     */
+    bool tryPop(StereoPair& pair);
+    /**
+     * @brief Takes the oldest pair, waiting for one if there is none.
+     *
+     * @param pair Receives the pair.
+     * @param timeout The maximum time to wait, in milliseconds. negative value means forever.
+     *
+     * @return `true` if a pair was received, `false` on timeout.
+     */
+    bool pop(StereoPair& pair, int timeout = 1500);
+
+    /**
+     * @brief Sets the function called for every frame that found no partner.
+     *
+     * @param func The callback, called on the thread that fed the frame. If `nullptr`, the callback is cleared.
+     */
+    void setUnmatchedCallback(const UnmatchedCallback& func);
+    /** Returns a snapshot of the counters. */
+    StereoPairerStats stats() const;
+
+   private:
+    struct Pending {
+        FrameRef frame;
+        // device timestamp in 100 ns, the offset is applied when comparing since the estimate keeps moving
+        int64_t device_time;
+    };
+
+    int64_t hostNow() const;
+    void run(StereoSide side);
+    void emit(StereoPair&& pair);
+
+    const StereoPairerOptions options_;
+    const int64_t ts_scale_;
+    Camera* cameras_[2] = {nullptr, nullptr};
+    std::thread threads_[2];
+    std::atomic<bool> running_{false};
+
+    EventDispatcher* events_[2] = {nullptr, nullptr};
+    int listener_ids_[2] = {-1, -1};
+
+    mutable std::mutex mutex_;
+    ClockOffsetEstimator clocks_[2];
+    std::deque<Pending> pending_[2];
+    UnmatchedCallback unmatched_callback_;
+    StereoPairerStats stats_{};
+
+    BoundedQueue<StereoPair> pairs_;
+    Notifier pairs_ready_;
+};
+
+}  // namespace Arducam
+
+/** @} */
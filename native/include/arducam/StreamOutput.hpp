@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arducam/VideoEncoder.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the options of an `RtpSender`.
+ */
+struct RtpOptions {
+    /** The IPv4 address or host name of the receiver. */
+    std::string host = "127.0.0.1";
+    uint16_t port = 5004;
+    /** The RTP payload type. 0 uses 96 for H.264 and 26 for MJPEG. */
+    uint8_t payload_type = 0;
+    /** The largest RTP packet, header included, in bytes. */
+    size_t mtu = 1400;
+    /** The synchronization source. 0 picks a random one. */
+    uint32_t ssrc = 0;
+};
+
+/**
+ * @brief Sends encoded frames over RTP/UDP, H.264 as in RFC 6184 and MJPEG as in RFC 2435.
+ *
+ * H.264 NAL units that fit a packet are sent as they are, larger ones as FU-A fragments; the marker bit ends every
+ * frame. JPEG frames are sent with their quantization tables in the first packet (Q 255), so the receiver needs no
+ * table of its own. The timestamps are the frame timestamps on the 90 kHz RTP clock.
+ *
+ * A receiver needs the session description, e.g. for GStreamer
+ * `udpsrc port=5004 caps="application/x-rtp,media=video,encoding-name=H264,clock-rate=90000" ! rtph264depay ! ...`.
+ * Use one sender per camera. The sender is not thread safe.
+ */
+class RtpSender {
+   public:
+    /**
+     * @brief Opens the socket of a sender.
+     *
+     * @return The sender, or null if the host cannot be resolved or the socket cannot be opened.
+     */
+    static std::unique_ptr<RtpSender> create(const RtpOptions& options);
+
+    RtpSender(const RtpSender&) = delete;
+    RtpSender& operator=(const RtpSender&) = delete;
+    ~RtpSender();
+
+    /**
+     * @brief Packetizes and sends an encoded frame.
+     *
+     * @return `true` on success, `false` if the frame cannot be packetized (e.g. a progressive JPEG) or not sent.
+     */
+    bool send(const EncodedPacket& packet);
+
+    /** Returns the number of RTP packets sent. */
+    uint64_t packets() const { return packets_; }
+    /** Returns the number of bytes sent, RTP headers included. */
+    uint64_t bytes() const { return bytes_; }
+
+   private:
+    explicit RtpSender(const RtpOptions& options);
+
+    bool sendH264(const EncodedPacket& packet, uint32_t timestamp);
+    bool sendJpeg(const EncodedPacket& packet, uint32_t timestamp);
+    // sends `buffer_`, whose payload starts after the RTP header
+    bool sendPacket(size_t size, uint32_t timestamp, bool marker, uint8_t payload_type);
+
+    RtpOptions options_;
+    // a `SOCKET` on Windows, a file descriptor elsewhere
+    intptr_t socket_ = -1;
+    std::vector<uint8_t> address_;
+    std::vector<uint8_t> buffer_;
+    uint16_t sequence_ = 0;
+    uint64_t packets_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+/**
+ * @brief Function type receiving the bytes of a stream.
+ *
+ * @return `true` on success, `false` to report a write error.
+ */
+using StreamWriter = std::function<bool(const uint8_t* data, size_t size)>;
+
+/**
+ * @brief Muxes an H.264 stream into fragmented MP4 (ISO/IEC 14496-12), one fragment per frame.
+ *
+ * The stream starts with an initialization segment (`ftyp` and `moov`), written with the first key frame since it
+ * carries that frame's SPS and PPS; frames before it are dropped. Every frame then becomes a `moof` and `mdat` pair,
+ * so the stream can be played while it is written, e.g. served over HTTP to a browser with Media Source Extensions or
+ * piped to `ffplay -`.
+ */
+class Fmp4Muxer {
+   public:
+    /**
+     * @brief Creates a muxer.
+     *
+     * @param writer Receives the stream.
+     */
+    explicit Fmp4Muxer(StreamWriter writer);
+
+    /**
+     * @brief Muxes an encoded frame.
+     *
+     * @return `true` on success, `false` if the frame is not H.264 or the writer failed.
+     */
+    bool write(const EncodedPacket& packet);
+
+    /** Returns `true` once the initialization segment was written. */
+    bool started() const { return started_; }
+    /** Returns the number of fragments written. */
+    uint64_t fragments() const { return sequence_; }
+
+   private:
+    bool writeInit(const EncodedPacket& packet, const std::vector<uint8_t>& sps, const std::vector<uint8_t>& pps);
+
+    StreamWriter writer_;
+    bool started_ = false;
+    uint32_t sequence_ = 0;
+    uint64_t first_timestamp_us_ = 0;
+    uint64_t last_timestamp_us_ = 0;
+    uint32_t last_duration_ = 0;
+    std::vector<uint8_t> box_;
+    std::vector<uint8_t> sample_;
+};
+
+}  // namespace Arducam
+
+/** @} */
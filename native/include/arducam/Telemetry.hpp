@@ -0,0 +1,271 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BoundedQueue.hpp>
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/FrameRef.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/** Number of per-thread slots of the metrics. Threads beyond that share slots, which stays correct. */
+constexpr size_t kMetricShards = 8;
+
+namespace detail {
+/** Returns the slot of the calling thread, assigned round-robin on first use. */
+size_t metricShard();
+}  // namespace detail
+
+/**
+ * @brief A monotonic counter.
+ *
+ * Every thread increments a slot of its own, on its own cache line, so counting on the capture, callback and event
+ * threads never contends. Reading sums the slots.
+ */
+class MetricCounter {
+   public:
+    /** Adds `n`. */
+    void add(uint64_t n = 1) { shards_[detail::metricShard()].value.fetch_add(n, std::memory_order_relaxed); }
+    /** Returns the current value. */
+    uint64_t value() const;
+
+   private:
+    struct alignas(kCacheLineSize) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    Shard shards_[kMetricShards];
+};
+
+/**
+ * @brief A value that is set rather than accumulated, e.g. a queue depth. Keeps the highest value seen.
+ */
+class MetricGauge {
+   public:
+    /** Sets the value. */
+    void set(int64_t value) {
+        value_.store(value, std::memory_order_relaxed);
+        int64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+    /** Returns the last value. */
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+    /** Returns the highest value. */
+    int64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<int64_t> value_{0};
+    std::atomic<int64_t> max_{0};
+};
+
+/**
+ * @brief Struct representing a snapshot of a `MetricHistogram`.
+ */
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    /** The number of values of every bucket, see `MetricHistogram::bucketUpperBound()`. */
+    std::vector<uint64_t> buckets;
+
+    /** Returns the mean value, or 0 if empty. */
+    double mean() const { return count != 0 ? static_cast<double>(sum) / count : 0.0; }
+    /**
+     * @brief Returns an upper bound of the `p` quantile (`p` in [0, 1]), within the bucket resolution.
+     */
+    uint64_t percentile(double p) const;
+};
+
+/**
+ * @brief A histogram of non-negative values, e.g. durations in microseconds.
+ *
+ * The buckets are log-linear, 4 per power of two, so values are kept with a relative error below 25 % over the
+ * whole `uint64_t` range in a few hundred buckets. Like `MetricCounter`, every thread records into a slot of its own;
+ * recording is a handful of relaxed atomic operations and never allocates.
+ */
+class MetricHistogram {
+   public:
+    /** Number of buckets. */
+    static constexpr size_t kBuckets = (64 - 2 + 1) * 4;
+
+    MetricHistogram();
+    MetricHistogram(const MetricHistogram&) = delete;
+    MetricHistogram& operator=(const MetricHistogram&) = delete;
+
+    /** Records a value. */
+    void record(uint64_t value);
+    /** Returns the sum of all slots. */
+    HistogramSnapshot snapshot() const;
+    /** Returns the largest value counted in a bucket. */
+    static uint64_t bucketUpperBound(size_t bucket);
+
+   private:
+    struct alignas(kCacheLineSize) Shard {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+        std::atomic<uint64_t> buckets[kBuckets];
+        Shard();
+    };
+    std::unique_ptr<Shard[]> shards_;
+};
+
+/**
+ * @brief Struct representing a snapshot of the metrics of a camera.
+ */
+struct CameraMetrics {
+    /** Number of `FrameStart` events. */
+    uint64_t frame_starts = 0;
+    /** Number of `FrameEnd` events, i.e. frames completely transferred over USB. */
+    uint64_t frame_ends = 0;
+    /** Number of `TransferError` events. */
+    uint64_t transfer_errors = 0;
+    /** Number of `TransferTimeout` events. */
+    uint64_t transfer_timeouts = 0;
+    /** Number of `TransferLengthError` events. */
+    uint64_t transfer_length_errors = 0;
+    /** Number of frames delivered to the application. */
+    uint64_t frames = 0;
+    /** Number of bytes delivered to the application. */
+    uint64_t bytes = 0;
+    /** Number of `Camera::capture()` calls that timed out. */
+    uint64_t capture_timeouts = 0;
+    /**
+     * Number of frames missing from the sequence numbers of the delivered frames. The SDK skips a frame when it has
+     * no free buffer to receive it into, so this counts buffer starvation.
+     */
+    uint64_t starved_frames = 0;
+    /** Number of times the output queue was found empty right after a frame was taken. */
+    uint64_t queue_empty = 0;
+    /** The last and the highest `Camera::getAvailCount()` sampled. */
+    int64_t queue_depth = 0;
+    int64_t queue_depth_max = 0;
+    /** Time from `FrameStart` to `FrameEnd`, in microseconds. */
+    HistogramSnapshot frame_assembly_us;
+    /** Run time of the capture callback, in microseconds. */
+    HistogramSnapshot callback_us;
+    /** `Camera::getAvailCount()` sampled after every delivered frame. */
+    HistogramSnapshot queue_depths;
+};
+
+/**
+ * @brief Collects the metrics of one camera.
+ *
+ * The events come from an `EventDispatcher`. Delivered frames are counted by capturing through `capture()`, by
+ * wrapping the capture callback with `wrapCallback()`, or by calling `onFrame()` from any other capture loop. Nothing
+ * is logged or formatted on the hot path: the metrics are counters and histograms read with `snapshot()` when needed.
+ */
+class CameraTelemetry {
+   public:
+    /**
+     * @brief Starts collecting the events of a camera.
+     *
+     * @param camera The camera. Must outlive the telemetry.
+     * @param events The event dispatcher of the camera. Must outlive the telemetry.
+     */
+    CameraTelemetry(Camera& camera, EventDispatcher& events);
+    CameraTelemetry(const CameraTelemetry&) = delete;
+    CameraTelemetry& operator=(const CameraTelemetry&) = delete;
+    ~CameraTelemetry();
+
+    /**
+     * @brief Captures a frame with `captureRef()` and records it.
+     */
+    bool capture(FrameRef& ref, int timeout = 1500);
+    /**
+     * @brief Returns a capture callback that runs `callback` and records the frame and the run time.
+     */
+    Camera::CaptureCallback wrapCallback(Camera::CaptureCallback callback);
+    /**
+     * @brief Records a delivered frame and samples the output queue depth.
+     */
+    void onFrame(const Frame& frame);
+    /** Records a `Camera::capture()` that timed out. */
+    void onCaptureTimeout() { capture_timeouts_.add(); }
+
+    /** Returns the current metrics. */
+    CameraMetrics snapshot() const;
+
+   private:
+    void onEvent(EventCode event);
+
+    Camera& camera_;
+    EventDispatcher& events_;
+    int listener_ = -1;
+
+    MetricCounter frame_starts_;
+    MetricCounter frame_ends_;
+    MetricCounter transfer_errors_;
+    MetricCounter transfer_timeouts_;
+    MetricCounter transfer_length_errors_;
+    MetricCounter frames_;
+    MetricCounter bytes_;
+    MetricCounter capture_timeouts_;
+    MetricCounter starved_frames_;
+    MetricCounter queue_empty_;
+    MetricGauge queue_depth_;
+    MetricHistogram frame_assembly_us_;
+    MetricHistogram callback_us_;
+    MetricHistogram queue_depths_;
+
+    // written by the event thread only
+    uint64_t frame_start_us_ = 0;
+    // sequence number of the last delivered frame, -1 before the first one
+    std::atomic<int64_t> last_seq_{-1};
+};
+
+/**
+ * @brief Struct representing a snapshot of the device events of a `DeviceList`.
+ */
+struct DeviceMetrics {
+    uint64_t connects = 0;
+    uint64_t unknown_connects = 0;
+    uint64_t disconnects = 0;
+};
+
+/**
+ * @brief Counts the hot-plug events of a `DeviceList`.
+ *
+ * `DeviceList::setEventCallback()` only takes one function, so the owner of the callback forwards the events with
+ * `onEvent()`.
+ */
+class DeviceTelemetry {
+   public:
+    /** Records a device event. Other events are ignored. */
+    void onEvent(EventCode event);
+    /** Returns the current metrics. */
+    DeviceMetrics snapshot() const;
+
+   private:
+    MetricCounter connects_;
+    MetricCounter unknown_connects_;
+    MetricCounter disconnects_;
+};
+
+/**
+ * @brief Appends the metrics as `name_metric value` lines, e.g. for a status page or a log line per minute.
+ *
+ * Histograms are written as their count, mean, p50, p99 and max.
+ *
+ * @param prefix The prefix of every name, e.g. `"cam0"`.
+ * @param metrics The metrics.
+ * @param out Receives the text.
+ */
+void formatMetrics(const std::string& prefix, const CameraMetrics& metrics, std::string& out);
+/** @overload */
+void formatMetrics(const std::string& prefix, const DeviceMetrics& metrics, std::string& out);
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BufferArena.hpp>
+#include <arducam/PixelKernels.hpp>
+#include <arducam/RemapLut.hpp>
+#include <arducam/WorkerPool.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the options of a `TileGraph`.
+ */
+struct TileGraphOptions {
+    /**
+     * The bytes a tile should touch: its output and the source pixels it reads, on average over the tiles. About the
+     * L2 cache of one core, e.g. 256 KiB on a Raspberry Pi 4 (1 MiB shared by 4 cores) or 512 KiB on a Pi 5.
+     */
+    size_t cache_bytes = 256 * 1024;
+    /** The widths tried for the tiles, in multiples of `RemapLut::kTileWidth`. */
+    uint32_t max_tile_columns = 8;
+    /** The heights tried for the tiles, in multiples of `RemapLut::kTileHeight`. */
+    uint32_t max_tile_rows = 4;
+    /**
+     * The work units per thread. A unit is a column of tiles run top to bottom on one thread; more units balance the
+     * threads better, and convert the source rows shared by the units on both sides of a split twice.
+     */
+    uint32_t units_per_thread = 2;
+    /**
+     * The arena the scratch of the units is taken from, one block per unit, if its blocks are large enough. Otherwise
+     * the graph allocates it, once per `prepare()`.
+     */
+    std::shared_ptr<BufferArena> arena;
+};
+
+/**
+ * @brief Counters of a `TileGraph`.
+ */
+struct TileGraphStats {
+    /** Number of runs. */
+    uint64_t runs = 0;
+    /** Number of source pixels converted. More than the pixels of the frames by the overlap of the units. */
+    uint64_t converted_pixels = 0;
+    /** Number of times a window moved its rows up to make room, and times it was refilled from scratch. */
+    uint64_t window_slides = 0;
+    uint64_t window_resets = 0;
+};
+
+// the scratch of one work unit of a `TileGraph`
+struct TileUnit;
+
+/**
+ * @brief A node of a `TileGraph`: an image produced on demand, one rectangle at a time.
+ */
+class TileNode {
+   public:
+    virtual ~TileNode() = default;
+
+    /** Returns the width of the image. */
+    uint32_t width() const { return width_; }
+    /** Returns the height of the image. */
+    uint32_t height() const { return height_; }
+    /** Returns the format of the image. */
+    OutputFormat format() const { return format_; }
+
+   protected:
+    TileNode(uint32_t width, uint32_t height, OutputFormat format) : width_(width), height_(height), format_(format) {}
+
+   private:
+    friend class TileGraph;
+    friend struct TileNodes;
+
+    // records the scratch the rectangle `[x0, x1) x [y0, y1)` needs in `unit`
+    virtual void plan(TileUnit& unit, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1) const = 0;
+    // writes the rectangle to `dst`, its top-left pixel
+    virtual void pull(TileUnit& unit, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, uint8_t* dst,
+                      size_t dst_stride) const = 0;
+    // checks the frames of a run
+    virtual bool accepts(const std::vector<Frame>& frames) const {
+        (void)frames;
+        return true;
+    }
+    // adds the columns the tiles must not straddle, e.g. the seams of a side by side image
+    virtual void seams(uint32_t x0, std::vector<uint32_t>& seams) const {
+        (void)x0;
+        (void)seams;
+    }
+
+    uint32_t width_;
+    uint32_t height_;
+    OutputFormat format_;
+    size_t index_ = 0;
+};
+
+/**
+ * @brief Runs the per-frame processing chain tile by tile, so that no intermediate image is ever complete.
+ *
+ * The chain of `image_post_processing_v1.1.py` (convert, crop, undistort, perspective, rotate, combine side by side)
+ * materializes a full image at every step, and `FrameCorrector` still converts the whole frame before remapping it.
+ * The graph pulls the output instead: the output is cut into tiles sized for the cache, each tile asks its inputs for
+ * the pixels it needs, and a source converts only the rows and columns asked for. A remap keeps a window of converted
+ * source rows per work unit and slides it down as the tiles of its column advance, so every source pixel is
+ * converted once per unit, read from the cache by the remap and written once to the output. The two halves of a
+ * stereo frame are written straight into the combined image.
+ *
+ * The graph is made of sources (one per input frame), remaps (one `RemapLut`, which holds every geometric step of a
+ * `CorrectionParams`) and side by side stacks. The tile size is picked by `prepare()` from the source pixels each tile
+ * reads; the work units (columns of tiles) run on the pool and their scratch is allocated once.
+ *
+ * @note `run()` is not reentrant; use one graph per processing thread.
+ */
+class TileGraph {
+   public:
+    explicit TileGraph(const TileGraphOptions& options = TileGraphOptions());
+    TileGraph(const TileGraph&) = delete;
+    TileGraph& operator=(const TileGraph&) = delete;
+    ~TileGraph();
+
+    /**
+     * @brief Adds a source: input `input` of `run()`, converted with `convertFrameRegion()`.
+     *
+     * @param input The index of the frame in the frames of `run()`.
+     * @param format The format of the frames. A frame of another format fails the run.
+     * @param options The conversion options.
+     *
+     * @return The node, owned by the graph.
+     */
+    TileNode* addSource(size_t input, const ArducamFrameFormat& format, const ConvertOptions& options);
+    /**
+     * @brief Adds a remap of a source.
+     *
+     * @param source The source, of `lut.srcWidth()` x `lut.srcHeight()` pixels.
+     * @param lut The table. Must outlive the graph.
+     *
+     * @return The node, or null if `source` is not a source of this graph or does not match the table.
+     */
+    TileNode* addRemap(TileNode* source, const RemapLut& lut);
+    /**
+     * @brief Adds images side by side, cut to the lowest of them like `create_combined_image()`.
+     *
+     * @return The node, or null if `inputs` is empty, or not all of this graph or of the same format.
+     */
+    TileNode* addSideBySide(const std::vector<TileNode*>& inputs);
+    /**
+     * @brief Sets the node `run()` writes. Any node works, e.g. a single remap.
+     *
+     * @return `true` on success, `false` if the node is not part of this graph.
+     */
+    bool setOutput(TileNode* node);
+
+    /**
+     * @brief Picks the tile size and cuts the output into work units for a number of threads, and allocates their
+     * scratch. `run()` calls it when the graph changed or the pool has a different size.
+     *
+     * @return `true` on success, `false` if there is no output.
+     */
+    bool prepare(size_t threads);
+    /**
+     * @brief Produces the output for a set of frames.
+     *
+     * @param frames The input frames, indexed by the `input` of the sources.
+     * @param dst The output image, `width()` x `height()` pixels.
+     * @param dst_stride The size of an output row in bytes. 0 means `width() * outputPixelSize(format())`.
+     * @param pool Runs the units on several threads if not null.
+     *
+     * @return `true` on success, `false` if there is no output or a frame is missing, does not match its source or
+     * cannot be converted.
+     */
+    bool run(const std::vector<Frame>& frames, uint8_t* dst, size_t dst_stride = 0, WorkerPool* pool = nullptr);
+
+    /** Returns the width of the output. */
+    uint32_t width() const { return output_ != nullptr ? output_->width() : 0; }
+    /** Returns the height of the output. */
+    uint32_t height() const { return output_ != nullptr ? output_->height() : 0; }
+    /** Returns the format of the output. */
+    OutputFormat format() const { return output_ != nullptr ? output_->format() : OutputFormat::Rgb8; }
+    /** Returns the size of the tiles picked by `prepare()`. */
+    uint32_t tileWidth() const { return tile_width_; }
+    uint32_t tileHeight() const { return tile_height_; }
+    /** Returns the number of work units. */
+    size_t unitCount() const { return units_.size(); }
+    /** Returns the scratch of all the units, in bytes. */
+    size_t scratchSize() const { return scratch_size_; }
+    /** Returns the counters. */
+    const TileGraphStats& stats() const { return stats_; }
+
+   private:
+    // adds a node, returns it
+    TileNode* add(std::unique_ptr<TileNode> node);
+    bool owns(const TileNode* node) const;
+    void releaseScratch();
+
+    TileGraphOptions options_;
+    std::vector<std::unique_ptr<TileNode>> nodes_;
+    TileNode* output_ = nullptr;
+
+    bool prepared_ = false;
+    size_t prepared_threads_ = 0;
+    uint32_t tile_width_ = 0;
+    uint32_t tile_height_ = 0;
+    std::vector<std::unique_ptr<TileUnit>> units_;
+    size_t scratch_size_ = 0;
+    std::vector<uint64_t> scratch_;
+    std::vector<uint8_t*> blocks_;
+    TileGraphStats stats_;
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/BufferArena.hpp>
+#include <arducam/Telemetry.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Struct representing the options of a `TransferTuner`.
+ */
+struct TransferTunerOptions {
+    /** The fewest transfers tried. */
+    int min_transfers = 2;
+    /** The most transfers tried. 0 means twice the starting count. */
+    int max_transfers = 0;
+    /** The smallest and largest transfer buffers tried, in bytes. 0 means a quarter and four times the starting size. */
+    int min_buffer_size = 0;
+    int max_buffer_size = 0;
+    /**
+     * The transfer memory the SDK may allocate, `transfer_count * buffer_size` in bytes. 0 is no limit; with two
+     * cameras on one hub, give each its part of what the host can spare.
+     */
+    size_t max_bytes = 0;
+    /** The length of one measurement, in seconds. */
+    double window_s = 2.0;
+    /** The frames dropped from the measurement after a restart, while the transfers ramp up. */
+    uint32_t warmup_frames = 8;
+    /** The relative gain in delivered fps a configuration needs to be better. Within it, less memory wins. */
+    double min_gain = 0.02;
+    /**
+     * The frames lost per second (`starved_frames` and transfer errors) two configurations must differ by to count as
+     * different, so a single lost frame does not decide.
+     */
+    double loss_tolerance = 0.1;
+    /** Starts a new search when the best configuration starts losing frames, e.g. when another camera shares the hub. */
+    bool retune = true;
+};
+
+/**
+ * @brief Struct representing one measurement of a transfer configuration.
+ */
+struct TransferMeasurement {
+    /** The configuration measured. */
+    TransferConfig config;
+    /** The frames delivered per second, counted by the telemetry. */
+    double fps = 0;
+    /** `Camera::captureFps()` and `Camera::bandwidth()` at the end of the measurement. */
+    int capture_fps = 0;
+    int bandwidth = 0;
+    /** The frames lost per second: starved frames plus transfer errors, timeouts and length errors. */
+    double loss_rate = 0;
+    /** The mean `Camera::getAvailCount()`, the frames waiting to be captured. */
+    double queue_depth = 0;
+};
+
+/**
+ * @brief Searches the transfer configuration of a running camera that delivers the most frames with the least memory.
+ *
+ * `Camera::setAutoTransfer()` picks the number and the size of the transfers once, for a camera alone on its link.
+ * The tuner measures the running configuration from the telemetry of the camera (delivered fps, starved frames,
+ * transfer errors) and climbs from there: it tries half as many transfers more and fewer, follows the better side and
+ * narrows the step, then tries larger and smaller buffers the same way. A candidate is kept only if it loses fewer
+ * frames or delivers `min_gain` more fps, or if it does as well with less memory. Once settled it keeps watching the
+ * best configuration and, with `retune`, searches again when it starts losing frames.
+ *
+ * The SDK only takes a new transfer configuration while the camera is stopped, so every candidate costs a
+ * `stop()`/`start()`, in the order of a frame time, and the camera keeps its mode, controls and memory type. Save the
+ * result with `saveTransferProfile()` and apply it before the next `start()` to skip the search.
+ *
+ * @note `update()` restarts the camera. Call it from the thread that captures, with no frame held.
+ */
+class TransferTuner {
+   public:
+    /**
+     * @param camera The camera, running with `start`. Must outlive the tuner.
+     * @param telemetry The telemetry of the camera, fed with every delivered frame. Must outlive the tuner.
+     * @param start The transfer configuration the camera runs with.
+     * @param options The search options.
+     */
+    TransferTuner(Camera& camera, CameraTelemetry& telemetry, const TransferConfig& start,
+                  const TransferTunerOptions& options = TransferTunerOptions());
+
+    /**
+     * @brief Ends a measurement when its window is over and moves to the next candidate.
+     *
+     * Cheap when the window is not over; call it after every frame or from a timer on the capture thread.
+     *
+     * @return `false` if the camera could not be restarted with a candidate. The tuner then falls back to the best
+     * configuration and stops searching.
+     */
+    bool update();
+
+    /** Checks if the search is over. */
+    bool settled() const { return phase_ == Phase::Settled; }
+    /** Returns the configuration the camera runs with. */
+    const TransferConfig& current() const { return current_; }
+    /** Returns the best configuration found, the starting one until a measurement is done. */
+    const TransferConfig& best() const { return best_.config; }
+    /** Returns the measurement of `best()`. */
+    const TransferMeasurement& bestMeasurement() const { return best_; }
+    /** Returns every measurement, in order. */
+    const std::vector<TransferMeasurement>& measurements() const { return history_; }
+    /** Returns the number of restarts. */
+    size_t restarts() const { return restarts_; }
+
+   private:
+    enum class Phase { Count, Size, Settled };
+
+    bool better(const TransferMeasurement& a, const TransferMeasurement& b) const;
+    bool fits(const TransferConfig& config) const;
+    void beginWindow(uint64_t now_us);
+    bool finishWindow(uint64_t now_us);
+    // sets the step of the phase, or moves on to the next phase if it has none
+    void beginPhase(Phase phase);
+    // restarts with the next candidate of the search, or with the best configuration once it is over
+    bool nextCandidate(uint64_t now_us);
+    bool apply(const TransferConfig& config, uint64_t now_us);
+
+    Camera& camera_;
+    CameraTelemetry& telemetry_;
+    TransferTunerOptions options_;
+
+    Phase phase_ = Phase::Count;
+    TransferConfig current_;
+    TransferMeasurement best_;
+    bool measured_ = false;
+    // the step of the phase (transfers or bytes), its smallest value, the direction tried and the directions left
+    int step_ = 0;
+    int min_step_ = 1;
+    int direction_ = 1;
+    int directions_ = 2;
+    // the loss rate when the search settled, which retune compares to
+    double settled_loss_ = 0;
+
+    bool warming_ = true;
+    uint64_t next_check_us_ = 0;
+    uint64_t warmup_start_us_ = 0;
+    uint64_t warmup_start_frames_ = 0;
+    uint64_t window_start_us_ = 0;
+    CameraMetrics window_start_;
+
+    std::vector<TransferMeasurement> history_;
+    size_t restarts_ = 0;
+};
+
+/**
+ * @brief Returns the key a transfer configuration is saved under: the host name, the USB type and the mode.
+ *
+ * For instance `"lab-pc/usb3/4056x3040/10/0x0100"`.
+ */
+std::string transferProfileKey(const Camera& camera);
+/**
+ * @brief Loads a transfer configuration saved with `saveTransferProfile()`.
+ *
+ * @param path The profile file, plain text with one `key transfer_count buffer_size mem_type` line per entry.
+ * @param key The key, see `transferProfileKey()`.
+ * @param config Receives the configuration.
+ *
+ * @return `true` on success, `false` if the file cannot be read or has no valid entry for `key`.
+ */
+bool loadTransferProfile(const std::string& path, const std::string& key, TransferConfig& config);
+/**
+ * @brief Saves a transfer configuration, replacing the entry with the same key and keeping the others.
+ *
+ * @return `true` on success, `false` if the file cannot be written or the key contains white space.
+ */
+bool saveTransferProfile(const std::string& path, const std::string& key, const TransferConfig& config);
+
+}  // namespace Arducam
+
+/** @} */
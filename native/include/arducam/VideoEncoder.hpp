@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/PixelKernels.hpp>
+#include <arducam/RemapLut.hpp>
+#include <arducam/WorkerPool.hpp>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief Enum class representing the codecs of a `VideoEncoder`.
+ */
+enum class VideoCodec : uint8_t {
+    H264 = 0x00,  /**< H.264 Annex B byte stream, SPS and PPS repeated before every key frame */
+    Mjpeg = 0x01, /**< One baseline JPEG per frame */
+};
+
+/**
+ * @brief Enum class representing the implementations behind a `VideoEncoder`.
+ */
+enum class EncoderBackend : uint8_t {
+    Auto = 0x00,     /**< The first one available in the order below */
+    V4l2M2m = 0x01,  /**< A V4L2 memory-to-memory encoder, e.g. `bcm2835-codec` on a Raspberry Pi (Linux only) */
+    X264 = 0x02,     /**< libx264 for H.264, needs `ARDUCAM_WITH_X264` */
+    LibJpeg = 0x03,  /**< libjpeg(-turbo) for MJPEG, needs `ARDUCAM_WITH_JPEG` */
+};
+
+/**
+ * @brief Enum class representing the layout of the input image of an encoder.
+ */
+enum class EncoderPixelFormat : uint8_t {
+    Rgb24 = 0x00, /**< Interleaved RGB, like `OutputFormat::Rgb8` */
+    I420 = 0x01,  /**< Planar YUV 4:2:0, BT.601 limited range */
+};
+
+/**
+ * @brief Struct representing the options of a `VideoEncoder`.
+ */
+struct EncoderOptions {
+    VideoCodec codec = VideoCodec::H264;
+    EncoderBackend backend = EncoderBackend::Auto;
+    /** The size of the frames. Both must be even. */
+    uint32_t width = 0;
+    uint32_t height = 0;
+    /** The nominal frame rate, used by the rate control. */
+    uint32_t fps = 30;
+    /** The target bit rate in bits per second. For MJPEG, the quality is adjusted from frame to frame to meet it. */
+    uint32_t bitrate = 8000000;
+    /** The distance between H.264 key frames, in frames. */
+    uint32_t keyframe_interval = 30;
+    /** The JPEG quality of the first MJPEG frame, 1 to 100. */
+    int quality = 80;
+    /** The V4L2 device. Empty probes `/dev/video0` to `/dev/video63` for an encoder of the codec. */
+    std::string device;
+};
+
+/**
+ * @brief Struct representing an encoded frame.
+ */
+struct EncodedPacket {
+    const uint8_t* data;
+    size_t size;
+    /** The timestamp passed to `VideoEncoder::encode()`, in microseconds. */
+    uint64_t timestamp_us;
+    bool keyframe;
+    VideoCodec codec;
+    uint32_t width;
+    uint32_t height;
+};
+
+/**
+ * @brief Function type receiving the encoded frames. The data is only valid during the call.
+ */
+using PacketSink = std::function<void(const EncodedPacket& packet)>;
+
+/**
+ * @brief Struct representing the input image of an encoder, which the caller fills in place.
+ */
+struct EncoderInput {
+    EncoderPixelFormat format;
+    /** The planes: one for `Rgb24`, Y, U and V for `I420`. */
+    uint8_t* planes[3];
+    /** The size of a row of each plane in bytes. */
+    size_t strides[3];
+};
+
+/**
+ * @brief Encodes frames to H.264 or MJPEG, on the hardware encoder if there is one.
+ *
+ * With the V4L2 memory-to-memory backend, the input image is one of the encoder's own mapped buffers: the caller
+ * writes the frame straight into it (e.g. with `FrameCorrector::process()`) and `encode()` hands it to the hardware,
+ * so no frame is copied on the way to the encoder. Where there is no hardware encoder, libx264 (H.264) or libjpeg
+ * (MJPEG) encode on the CPU.
+ *
+ * An encoder serves one stream; use one per camera, each with its own bit rate. The encoder is not thread safe.
+ */
+class VideoEncoder {
+   public:
+    /**
+     * @brief Creates an encoder.
+     *
+     * @return The encoder, or null if no backend supports the codec and size.
+     */
+    static std::unique_ptr<VideoEncoder> create(const EncoderOptions& options);
+
+    VideoEncoder(const VideoEncoder&) = delete;
+    VideoEncoder& operator=(const VideoEncoder&) = delete;
+    ~VideoEncoder();
+
+    /** Returns the backend in use. */
+    EncoderBackend backend() const { return backend_; }
+    /** Returns the options, with the bit rate and quality in effect. */
+    const EncoderOptions& options() const { return options_; }
+
+    /**
+     * @brief Returns the input image of the next frame. Its pointers stay valid until `encode()`.
+     */
+    EncoderInput& input() { return input_; }
+    /**
+     * @brief Encodes the input image and hands the encoded frame to `sink`.
+     *
+     * @param timestamp_us The timestamp of the frame, in microseconds.
+     * @param sink Receives the encoded frame, on the calling thread.
+     *
+     * @return `true` on success, `false` if the encoder failed.
+     */
+    bool encode(uint64_t timestamp_us, const PacketSink& sink);
+    /**
+     * @brief Converts an RGB image into the input image and encodes it, for images that are not written in place.
+     *
+     * @param rgb The image, `OutputFormat::Rgb8`, at least the size of the encoder.
+     * @param stride The size of a row in bytes.
+     */
+    bool encodeRgb(const uint8_t* rgb, size_t stride, uint64_t timestamp_us, const PacketSink& sink);
+
+    /**
+     * @brief Changes the target bit rate, from the next frame on.
+     *
+     * @return `true` on success, `false` if the backend rejected it.
+     */
+    bool setBitrate(uint32_t bitrate);
+    /** Makes the next H.264 frame a key frame, e.g. when a client joins. */
+    void requestKeyframe() { keyframe_requested_ = true; }
+
+   private:
+    struct State;
+
+    explicit VideoEncoder(const EncoderOptions& options);
+
+    bool openV4l2();
+    bool openX264();
+    bool openJpeg();
+    // adjusts the MJPEG quality towards the bit rate after a frame of `size` bytes
+    void updateQuality(size_t size);
+
+    EncoderOptions options_;
+    EncoderBackend backend_ = EncoderBackend::Auto;
+    EncoderInput input_{};
+    bool keyframe_requested_ = false;
+    // the input image of the CPU backends
+    std::vector<uint8_t> image_;
+    std::unique_ptr<State> state_;
+};
+
+/**
+ * @brief Converts an RGB image to planar YUV 4:2:0 (BT.601, limited range), averaging the chroma of 2x2 blocks.
+ *
+ * @param rgb The image, `OutputFormat::Rgb8`.
+ * @param stride The size of an RGB row in bytes.
+ * @param width The width, even.
+ * @param height The height, even.
+ * @param input The destination, `EncoderPixelFormat::I420`.
+ */
+void rgbToI420(const uint8_t* rgb, size_t stride, uint32_t width, uint32_t height, const EncoderInput& input);
+
+/**
+ * @brief Struct representing the options of a `VideoStream`.
+ */
+struct VideoStreamOptions {
+    /** The encoder. The size is taken from the frames. */
+    EncoderOptions encoder;
+    /** The conversion of the frames. The output is always `OutputFormat::Rgb8`. */
+    ConvertOptions convert;
+    /** Enables the geometric correction. */
+    bool correct = false;
+    CorrectionParams correction;
+};
+
+/**
+ * @brief The streaming output stage of one camera: converts, corrects and encodes captured frames.
+ *
+ * Frames are converted and corrected straight into the input image of the encoder when it takes RGB and the
+ * corrected size is even; otherwise through one intermediate image. The encoder is created with the first frame and
+ * recreated when the corrected size changes.
+ */
+class VideoStream {
+   public:
+    /**
+     * @brief Creates a stream.
+     *
+     * @param options The options.
+     * @param sink Receives the encoded frames.
+     * @param pool Runs the correction on several threads if not null. Not owned.
+     */
+    VideoStream(const VideoStreamOptions& options, PacketSink sink, WorkerPool* pool = nullptr);
+
+    /**
+     * @brief Converts, corrects and encodes a frame.
+     *
+     * @param frame The frame.
+     * @param timestamp_us The timestamp of the frame, in microseconds. 0 takes the time of the call.
+     *
+     * @return `true` on success, `false` if the frame cannot be converted or encoded.
+     */
+    bool push(const Frame& frame, uint64_t timestamp_us = 0);
+
+    /** Changes the target bit rate of the stream. */
+    bool setBitrate(uint32_t bitrate);
+    /** Makes the next frame a key frame. */
+    void requestKeyframe();
+    /** Returns the encoder, null before the first frame. */
+    VideoEncoder* encoder() { return encoder_.get(); }
+
+   private:
+    VideoStreamOptions options_;
+    PacketSink sink_;
+    FrameCorrector corrector_;
+    std::unique_ptr<VideoEncoder> encoder_;
+    std::vector<uint8_t> image_;
+    std::vector<uint16_t> scratch_;
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \addtogroup Api_Cpp
+ * @{
+ */
+
+namespace Arducam {
+
+/**
+ * @brief A fixed set of worker threads running data parallel loops.
+ *
+ * `parallelFor()` may be called from several threads at once (e.g. one per camera); the calls share the workers and
+ * each caller also works on its own loop, so a pool with 0 workers runs everything on the calling thread.
+ */
+class WorkerPool {
+   public:
+    /**
+     * @brief Starts the workers.
+     *
+     * @param threads The number of worker threads. 0 means one less than `std::thread::hardware_concurrency()`.
+     */
+    explicit WorkerPool(size_t threads = 0);
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool();
+
+    /**
+     * @brief Calls `fn(i)` for every `i` in `[0, count)` and waits until all calls returned.
+     *
+     * The indices are handed out one at a time in increasing order, so `fn` should do a reasonable amount of work
+     * (e.g. a tile of pixels) per call.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    /** Returns the number of worker threads, not counting the callers of `parallelFor()`. */
+    size_t size() const { return workers_.size(); }
+
+   private:
+    struct Job;
+
+    void run();
+    static bool work(Job& job);
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+};
+
+}  // namespace Arducam
+
+/** @} */
@@ -0,0 +1,1873 @@
+#include <arducam/MockCamera.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <arducam/RawRecorder.hpp>
+
+// The mock backend: `DeviceList` and `Camera` over virtual devices, linked instead of `arducam_evk_cpp_sdk` so that
+// the native layer runs unchanged on any host. Each started camera has one thread that plays the device: it paces
+// the frames, fills the buffers of the input queue and sends the events and the capture callback.
+
+namespace Arducam {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// a virtual device has no USB ids
+constexpr uint16_t kMockVendorId = 0;
+constexpr uint16_t kMockProductId = 0;
+// the user data space of a board and the largest transfer, as `CalibrationStore` expects them
+constexpr size_t kUserDataSize = 65536;
+constexpr uint32_t kMaxUserDataTransfer = 255;
+// the transfer configuration `getAutoTransfer()` recommends
+constexpr int kAutoTransferCount = 8;
+constexpr int kAutoTransferSize = 1 << 20;
+// a synthetic frame is a window of a pattern `kPatternRows` rows higher, moved by 2 rows every frame
+constexpr uint32_t kPatternRows = 32;
+// the I2C address of the default modes
+constexpr uint16_t kSensorAddress = 0x34;
+
+// the registers in the embedded data lines, see `MetadataOptions`
+constexpr uint16_t kFrameCountReg = 0x0005;
+constexpr uint16_t kTemperatureReg = 0x013A;
+constexpr uint16_t kExposureReg = 0x0202;
+constexpr uint16_t kDigitalGainReg = 0x020E;
+constexpr uint16_t kFrameLengthReg = 0x0340;
+// runs of consecutive registers, each written as one address and its values
+constexpr uint16_t kEmbeddedRuns[][2] = {
+    {kFrameCountReg, 1}, {kTemperatureReg, 1}, {kExposureReg, 4}, {kDigitalGainReg, 2}, {kFrameLengthReg, 4}};
+
+uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+size_t copyString(const char* src, char* dst, size_t size) {
+    const size_t n = std::min(std::strlen(src), size - 1);
+    std::memcpy(dst, src, n);
+    dst[n] = '\0';
+    return n;
+}
+
+std::vector<ArducamCameraConfig> imx708Modes() {
+    const uint32_t sizes[][2] = {{4608, 2592}, {2304, 1296}, {1536, 864}};
+    std::vector<ArducamCameraConfig> modes;
+    for (const auto& size : sizes) {
+        ArducamCameraConfig config{};
+        copyString("IMX708", config.camera_name, sizeof(config.camera_name));
+        config.width = size[0];
+        config.height = size[1];
+        config.bit_width = 10;
+        config.format = FORMAT_MODE_RAW << 8;
+        config.i2c_mode = I2C_MODE_16_8;
+        config.i2c_addr = kSensorAddress;
+        modes.push_back(config);
+    }
+    return modes;
+}
+
+// the packing of the synthetic frames of a mode, one `detectPacking()` finds again
+PixelPacking modePacking(const ArducamCameraConfig& config, PixelPacking packing) {
+    if (config.bit_width <= 8) {
+        return PixelPacking::Bits8;
+    }
+    if (packing == PixelPacking::Raw10Packed && config.bit_width == 10 && config.width % 4 == 0) {
+        return packing;
+    }
+    if (packing == PixelPacking::Raw12Packed && config.bit_width == 12 && config.width % 2 == 0) {
+        return packing;
+    }
+    return PixelPacking::Bits16;
+}
+
+// packs samples, `count` a multiple of 4
+void packSamples(const uint16_t* src, size_t count, PixelPacking packing, uint8_t* dst) {
+    switch (packing) {
+        case PixelPacking::Bits8:
+            for (size_t i = 0; i < count; i++) {
+                dst[i] = static_cast<uint8_t>(src[i]);
+            }
+            break;
+        case PixelPacking::Raw10Packed:
+            for (size_t i = 0; i < count; i += 4, dst += 5) {
+                for (int j = 0; j < 4; j++) {
+                    dst[j] = static_cast<uint8_t>(src[i + j] >> 2);
+                }
+                dst[4] = static_cast<uint8_t>((src[i] & 0x03) | (src[i + 1] & 0x03) << 2 | (src[i + 2] & 0x03) << 4 |
+                                              (src[i + 3] & 0x03) << 6);
+            }
+            break;
+        case PixelPacking::Raw12Packed:
+            for (size_t i = 0; i < count; i += 2, dst += 3) {
+                dst[0] = static_cast<uint8_t>(src[i] >> 4);
+                dst[1] = static_cast<uint8_t>(src[i + 1] >> 4);
+                dst[2] = static_cast<uint8_t>((src[i] & 0x0F) | (src[i + 1] & 0x0F) << 4);
+            }
+            break;
+        default:
+            for (size_t i = 0; i < count; i++) {
+                dst[2 * i] = static_cast<uint8_t>(src[i]);
+                dst[2 * i + 1] = static_cast<uint8_t>(src[i] >> 8);
+            }
+            break;
+    }
+}
+
+// writes the bytes of an embedded data line in the packing of the frame, the inverse of the reader of
+// `MetadataParser`
+class LineWriter {
+   public:
+    LineWriter(uint8_t* line, size_t size, PixelPacking packing, uint8_t bit_width)
+        : line_(line), size_(size), packing_(packing), shift_(bit_width > 8 ? std::min(bit_width - 8, 8) : 0),
+          group_(packing == PixelPacking::Raw10Packed ? 5 : 3) {}
+
+    void put(uint8_t byte) {
+        switch (packing_) {
+            case PixelPacking::Raw10Packed:
+            case PixelPacking::Raw12Packed:
+                if (pos_ % group_ == group_ - 1 && pos_ < size_) {
+                    line_[pos_++] = 0;
+                }
+                if (pos_ < size_) {
+                    line_[pos_++] = byte;
+                }
+                break;
+            case PixelPacking::Bits16:
+                if (pos_ + 1 < size_) {
+                    const uint16_t sample = static_cast<uint16_t>(byte << shift_);
+                    line_[pos_++] = static_cast<uint8_t>(sample);
+                    line_[pos_++] = static_cast<uint8_t>(sample >> 8);
+                }
+                break;
+            default:
+                if (pos_ < size_) {
+                    line_[pos_++] = byte;
+                }
+                break;
+        }
+    }
+    void finish() { std::memset(line_ + pos_, 0, size_ - pos_); }
+
+   private:
+    uint8_t* line_;
+    size_t size_;
+    PixelPacking packing_;
+    int shift_;
+    size_t group_;
+    size_t pos_ = 0;
+};
+
+struct MockCameraState;
+
+struct MockDevice {
+    MockDeviceOptions options;
+    std::string path;
+    std::vector<ArducamCameraConfig> modes;
+    std::unique_ptr<RawReader> replay;
+    // the largest frame of the recording
+    size_t replay_size = 0;
+
+    // under the backend mutex
+    bool connected = true;
+    std::weak_ptr<MockCameraState> camera;
+
+    // the frames sent since the device was plugged in, for `disconnect_after`
+    std::atomic<uint64_t> sent{0};
+    // the error injected into the next frame, 0 for none
+    std::atomic<int> injected{0};
+
+    std::mutex user_data_mutex;
+    std::vector<uint8_t> user_data;
+
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> transfer_errors{0};
+    std::atomic<uint64_t> disconnects{0};
+};
+
+template <size_t... S, size_t... P>
+ArducamDevice* newDeviceEntry(const MockDevice& device, bool in_used, std::index_sequence<S...>,
+                              std::index_sequence<P...>) {
+    // the fields are const: the entry is built in one go, the strings padded with zeros
+    const std::string& serial = device.options.serial;
+    const std::string& path = device.path;
+    return new ArducamDevice{kMockVendorId,
+                             kMockProductId,
+                             in_used,
+                             {static_cast<uint8_t>(S < serial.size() ? serial[S] : 0)...},
+                             {(P < path.size() ? path[P] : '\0')...},
+                             device.options.usb_type,
+                             device.options.speed};
+}
+
+std::unique_ptr<ArducamDevice> newDeviceEntry(const MockDevice& device, bool in_used) {
+    return std::unique_ptr<ArducamDevice>(newDeviceEntry(device, in_used, std::make_index_sequence<16>(),
+                                                         std::make_index_sequence<256>()));
+}
+
+std::string entryPath(const ArducamDevice& device) {
+    return std::string(device.dev_path, strnlen(device.dev_path, sizeof(device.dev_path)));
+}
+
+struct Buffer {
+    std::unique_ptr<uint8_t[]> data;
+    // with the application, between `capture()` (or the capture callback) and `freeImage()`
+    bool held = false;
+    // left over from a previous configuration, deleted when it comes back
+    bool retired = false;
+};
+
+struct MockCameraState {
+    std::shared_ptr<MockDevice> device;
+    std::unique_ptr<ArducamDevice> entry;
+    ConfigType config_type = ConfigType::NONE;
+
+    std::mutex mutex;
+    // signalled when a frame is added to the output queue
+    std::condition_variable output_cv;
+    // signalled when a buffer is freed or the device thread must stop
+    std::condition_variable device_cv;
+
+    ArducamCameraConfig config{};
+    bool initialized = false;
+    bool running = false;
+    bool halted = false;
+    bool disconnected = false;
+    std::thread thread;
+
+    std::map<const uint8_t*, Buffer> buffers;
+    std::deque<uint8_t*> input;
+    std::deque<Frame> output;
+    uint32_t alloc_size = 0;
+
+    MemType mem_type = DMA;
+    TimeSource time_source = Firmware;
+    bool auto_transfer = true;
+    int transfer_count = 0;
+    int transfer_size = 0;
+    bool force_capture = false;
+
+    // the sensor registers, one byte each, keyed by I2C address and register
+    std::map<uint64_t, uint8_t> registers;
+    Control* controls = nullptr;
+    uint32_t control_count = 0;
+    std::map<std::string, int64_t> control_values;
+
+    // the synthetic pattern of the configuration
+    PixelPacking packing = PixelPacking::Bits16;
+    size_t row_size = 0;
+    std::vector<uint8_t> pattern;
+
+    std::mutex callback_mutex;
+    std::shared_ptr<Camera::CaptureCallback> capture_callback;
+    std::shared_ptr<Camera::EventCallback> event_callback;
+    std::shared_ptr<Camera::MessageCallback> message_callback;
+    std::atomic<bool> has_capture_callback{false};
+
+    LoggerLevel log_level = info;
+    bool console_log = false;
+    std::string log_file;
+
+    // owned by the device thread while it runs
+    uint32_t seq = 0;
+    size_t replay_index = 0;
+
+    std::atomic<int> capture_fps{0};
+    std::atomic<int> bandwidth{0};
+};
+
+using StatePtr = std::shared_ptr<MockCameraState>;
+
+MockCameraState* stateOf(ArducamCameraHandle handle) {
+    return handle != nullptr ? static_cast<StatePtr*>(handle)->get() : nullptr;
+}
+
+bool setError(std::atomic<int>& error, int code) {
+    error.store(code, std::memory_order_relaxed);
+    return code == Success;
+}
+
+uint64_t registerKey(uint32_t i2c_addr, uint32_t reg) { return static_cast<uint64_t>(i2c_addr) << 32 | reg; }
+
+// the bytes of a value in an I2C mode
+int dataBytes(I2CMode mode) {
+    switch (mode) {
+        case I2CMode::I2C_MODE_8_16:
+        case I2CMode::I2C_MODE_16_16:
+            return 2;
+        case I2CMode::I2C_MODE_16_32:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+// the registers are bytes: a wider value is written big endian to consecutive registers, as the sensor stores it
+void writeRegister(MockCameraState& s, I2CMode mode, uint32_t i2c_addr, uint32_t reg, uint32_t value) {
+    const int n = dataBytes(mode);
+    for (int i = 0; i < n; i++) {
+        s.registers[registerKey(i2c_addr, reg + i)] = static_cast<uint8_t>(value >> (8 * (n - 1 - i)));
+    }
+}
+
+uint32_t readRegister(const MockCameraState& s, I2CMode mode, uint32_t i2c_addr, uint32_t reg) {
+    const int n = dataBytes(mode);
+    uint32_t value = 0;
+    for (int i = 0; i < n; i++) {
+        auto it = s.registers.find(registerKey(i2c_addr, reg + i));
+        value = value << 8 | (it != s.registers.end() ? it->second : 0);
+    }
+    return value;
+}
+
+void log(MockCameraState& s, LoggerLevel level, const std::string& message) {
+    if (level < s.log_level || s.log_level == off) {
+        return;
+    }
+    if (s.console_log) {
+        std::fprintf(stderr, "[mock %s] %s\n", s.device->options.serial.c_str(), message.c_str());
+    }
+    if (!s.log_file.empty()) {
+        if (FILE* file = std::fopen(s.log_file.c_str(), "a")) {
+            std::fprintf(file, "[mock %s] %s\n", s.device->options.serial.c_str(), message.c_str());
+            std::fclose(file);
+        }
+    }
+    std::shared_ptr<Camera::MessageCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(s.callback_mutex);
+        callback = s.message_callback;
+    }
+    if (callback) {
+#if defined(WITH_STD_STRING_VIEW)
+        (*callback)(level, message);
+#else
+        (*callback)(level, message.c_str(), static_cast<int>(message.size()));
+#endif
+    }
+}
+
+void emit(MockCameraState& s, ArducamEventCode event) {
+    std::shared_ptr<Camera::EventCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(s.callback_mutex);
+        callback = s.event_callback;
+    }
+    if (callback) {
+        (*callback)(event);
+    }
+}
+
+class Backend {
+   public:
+    static Backend& instance() {
+        static Backend backend;
+        return backend;
+    }
+
+    Clock::time_point epoch() const { return epoch_; }
+
+    bool add(const MockDeviceOptions& options) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        added_ = true;
+        return addLocked(options) != nullptr;
+    }
+
+    std::shared_ptr<MockDevice> find(const std::string& serial) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return findLocked(serial);
+    }
+
+    bool disconnect(const std::shared_ptr<MockDevice>& device) {
+        StatePtr camera;
+        std::vector<std::pair<std::shared_ptr<DeviceList::EventCallback>, DeviceHandle>> calls;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!device->connected) {
+                return false;
+            }
+            device->connected = false;
+            device->disconnects++;
+            camera = device->camera.lock();
+            collectLocked(device.get(), calls);
+        }
+        if (camera) {
+            {
+                std::lock_guard<std::mutex> lock(camera->mutex);
+                camera->disconnected = true;
+                camera->halted = true;
+            }
+            camera->device_cv.notify_all();
+            camera->output_cv.notify_all();
+            emit(*camera, DeviceDisconnect);
+        }
+        for (auto& call : calls) {
+            (*call.first)(DeviceDisconnect, call.second);
+        }
+        return true;
+    }
+
+    bool connect(const std::shared_ptr<MockDevice>& device) {
+        std::vector<std::pair<std::shared_ptr<DeviceList::EventCallback>, DeviceHandle>> calls;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (device->connected) {
+                return false;
+            }
+            device->connected = true;
+            device->sent = 0;
+            collectLocked(nullptr, calls);
+        }
+        for (auto& call : calls) {
+            (*call.first)(DeviceConnect, nullptr);
+        }
+        return true;
+    }
+
+    bool remove(const std::string& serial) {
+        std::shared_ptr<MockDevice> device = find(serial);
+        if (!device) {
+            return false;
+        }
+        disconnect(device);
+        std::lock_guard<std::mutex> lock(mutex_);
+        devices_.erase(std::remove(devices_.begin(), devices_.end(), device), devices_.end());
+        return true;
+    }
+
+    // builds the list of the connected devices, replacing `list`
+    ArducamDeviceList* refresh(ArducamDeviceList* list) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        addDefaultsLocked();
+        std::unique_ptr<ListState> state(new ListState());
+        if (list != nullptr) {
+            auto it = lists_.find(list);
+            if (it != lists_.end()) {
+                state->callback = std::move(it->second->callback);
+                lists_.erase(it);
+            }
+            delete list;
+        }
+        for (const auto& device : devices_) {
+            if (!device->connected) {
+                continue;
+            }
+            StatePtr camera = device->camera.lock();
+            state->entries.push_back(newDeviceEntry(*device, camera && !camera->disconnected));
+            state->handles.push_back(state->entries.back().get());
+            state->devices.push_back(device.get());
+        }
+        ArducamDeviceList* fresh =
+            new ArducamDeviceList{static_cast<uint32_t>(state->handles.size()), state->handles.data()};
+        lists_[fresh] = std::move(state);
+        return fresh;
+    }
+
+    void release(ArducamDeviceList* list) {
+        if (list == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        lists_.erase(list);
+        delete list;
+    }
+
+    bool setListCallback(ArducamDeviceList* list, const DeviceList::EventCallback& func) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = lists_.find(list);
+        if (it == lists_.end()) {
+            return false;
+        }
+        it->second->callback = func ? std::make_shared<DeviceList::EventCallback>(func) : nullptr;
+        return true;
+    }
+
+    bool hasListCallback(const ArducamDeviceList* list) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = lists_.find(list);
+        return it != lists_.end() && it->second->callback != nullptr;
+    }
+
+    // claims a device for a camera: the one of `handle`, or the first free one
+    std::shared_ptr<MockDevice> claim(DeviceHandle handle, const StatePtr& camera, int& error) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        addDefaultsLocked();
+        const std::string path = handle != nullptr ? entryPath(*handle) : std::string();
+        for (const auto& device : devices_) {
+            const bool free = device->camera.expired();
+            if (handle != nullptr ? device->path != path : !device->connected || !free) {
+                continue;
+            }
+            if (!device->connected || !free) {
+                break;
+            }
+            device->camera = camera;
+            error = Success;
+            return device;
+        }
+        error = handle != nullptr ? OpenCameraFailed : Empty;
+        return nullptr;
+    }
+
+    void unclaim(MockDevice& device, const MockCameraState* camera) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (device.camera.lock().get() == camera) {
+            device.camera.reset();
+        }
+    }
+
+   private:
+    struct ListState {
+        std::vector<std::unique_ptr<ArducamDevice>> entries;
+        std::vector<DeviceHandle> handles;
+        std::vector<const MockDevice*> devices;
+        std::shared_ptr<DeviceList::EventCallback> callback;
+    };
+
+    Backend() : epoch_(Clock::now()) {}
+
+    std::shared_ptr<MockDevice> findLocked(const std::string& serial) {
+        for (const auto& device : devices_) {
+            if (device->options.serial == serial) {
+                return device;
+            }
+        }
+        return nullptr;
+    }
+
+    MockDevice* addLocked(MockDeviceOptions options) {
+        const size_t index = next_index_++;
+        if (options.serial.empty()) {
+            options.serial = "MOCK" + std::to_string(index);
+        }
+        if (options.serial.size() > 16 || findLocked(options.serial)) {
+            return nullptr;
+        }
+        std::shared_ptr<MockDevice> device = std::make_shared<MockDevice>();
+        if (!options.replay_file.empty()) {
+            device->replay = RawReader::open(options.replay_file);
+            if (!device->replay || device->replay->frameCount() == 0) {
+                return nullptr;
+            }
+            const RecordIndexEntry& first = device->replay->entry(0);
+            ArducamCameraConfig config{};
+            copyString("replay", config.camera_name, sizeof(config.camera_name));
+            config.width = first.width;
+            config.height = first.height;
+            config.bit_width = first.bit_width;
+            config.format = first.format;
+            config.i2c_mode = I2C_MODE_16_8;
+            config.i2c_addr = kSensorAddress;
+            device->modes.push_back(config);
+            for (size_t i = 0; i < device->replay->frameCount(); i++) {
+                device->replay_size = std::max<size_t>(device->replay_size, device->replay->entry(i).size);
+            }
+        } else {
+            device->modes = options.modes.empty() ? imx708Modes() : options.modes;
+        }
+        device->options = std::move(options);
+        device->path = "mock:" + std::to_string(index);
+        device->user_data.assign(kUserDataSize, 0xFF);
+        devices_.push_back(device);
+        return device.get();
+    }
+
+    void addDefaultsLocked() {
+        if (added_) {
+            return;
+        }
+        added_ = true;
+        std::vector<MockDeviceOptions> devices;
+        const char* spec = std::getenv("ARDUCAM_MOCK_DEVICES");
+        if (spec == nullptr) {
+            devices.resize(2);
+        } else if (!parseMockDevices(spec, devices)) {
+            std::fprintf(stderr, "[mock] cannot parse ARDUCAM_MOCK_DEVICES=%s\n", spec);
+        }
+        for (const MockDeviceOptions& options : devices) {
+            if (addLocked(options) == nullptr) {
+                std::fprintf(stderr, "[mock] cannot add device %s\n", options.serial.c_str());
+            }
+        }
+    }
+
+    // the lists to notify, with the handle of `device` in each (null for none)
+    void collectLocked(const MockDevice* device,
+                       std::vector<std::pair<std::shared_ptr<DeviceList::EventCallback>, DeviceHandle>>& calls) {
+        for (const auto& list : lists_) {
+            const ListState& state = *list.second;
+            if (!state.callback) {
+                continue;
+            }
+            DeviceHandle handle = nullptr;
+            for (size_t i = 0; device != nullptr && i < state.devices.size(); i++) {
+                handle = state.devices[i] == device ? state.handles[i] : handle;
+            }
+            calls.emplace_back(state.callback, handle);
+        }
+    }
+
+    const Clock::time_point epoch_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<MockDevice>> devices_;
+    std::map<const ArducamDeviceList*, std::unique_ptr<ListState>> lists_;
+    // devices were added, by the application or from the environment
+    bool added_ = false;
+    size_t next_index_ = 0;
+};
+
+// allocates the buffers and the pattern of the configuration, under the camera mutex
+void allocate(MockCameraState& s) {
+    const MockDevice& device = *s.device;
+    const ArducamCameraConfig& config = s.config;
+    s.packing = modePacking(config, device.options.packing);
+    s.row_size = packedRowSize(s.packing, config.width);
+    const size_t size = device.replay ? device.replay_size : s.row_size * config.height;
+    s.alloc_size = static_cast<uint32_t>(size);
+
+    // the buffers with the application are deleted when they come back
+    for (auto it = s.buffers.begin(); it != s.buffers.end();) {
+        if (it->second.held) {
+            it->second.retired = true;
+            ++it;
+        } else {
+            it = s.buffers.erase(it);
+        }
+    }
+    s.input.clear();
+    s.output.clear();
+    for (uint32_t i = 0; i < std::max(device.options.buffer_count, 1u); i++) {
+        Buffer buffer;
+        buffer.data.reset(new uint8_t[std::max<size_t>(size, 1)]());
+        uint8_t* data = buffer.data.get();
+        s.buffers.emplace(data, std::move(buffer));
+        s.input.push_back(data);
+    }
+
+    s.pattern.clear();
+    if (device.replay || config.width % 4 != 0 || config.height == 0) {
+        return;
+    }
+    // bars of the 8 primary and secondary colors over a vertical ramp, with some noise
+    static const uint8_t kBars[8][3] = {{255, 255, 255}, {255, 255, 0}, {0, 255, 255}, {0, 255, 0},
+                                        {255, 0, 255},   {255, 0, 0},   {0, 0, 255},   {0, 0, 0}};
+    const uint32_t rows = config.height + kPatternRows;
+    const int bits = std::max<int>(1, std::min<int>(config.bit_width, 16));
+    const uint32_t max = (1u << bits) - 1;
+    const uint32_t black = bits >= 10 ? 64u << (bits - 10) : 0;
+    const int noise_shift = std::max(bits - 10, 0);
+    const ArducamFrameFormat format{config.width, config.height, config.bit_width, config.format};
+    const bool bayer = isBayer(formatMode(format));
+    const uint32_t order = static_cast<uint32_t>(bayerOrder(format));
+    s.pattern.resize(s.row_size * rows);
+    std::vector<uint16_t> samples(config.width);
+    uint64_t state = splitmix64(device.options.seed);
+    for (uint32_t y = 0; y < rows; y++) {
+        const double ramp = 0.2 + 0.8 * (y % config.height) / config.height;
+        for (uint32_t x = 0; x < config.width; x++) {
+            // RGGB shifted by the bayer order: bit 0 moves the columns, bit 1 the rows
+            const uint32_t cx = (x + (order & 1)) & 1;
+            const uint32_t cy = (y + (order >> 1)) & 1;
+            const int channel = bayer ? static_cast<int>(cx + cy) : 1;
+            const uint32_t bar = x * 8 / config.width;
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            const int noise = (static_cast<int>(state >> 60) - 8) << noise_shift;
+            const double level = black + kBars[bar][channel] / 255.0 * ramp * (max - black);
+            samples[x] = static_cast<uint16_t>(std::max(0, std::min<int>(max, static_cast<int>(level) + noise)));
+        }
+        packSamples(samples.data(), config.width, s.packing, s.pattern.data() + y * s.row_size);
+    }
+}
+
+// writes the embedded data lines of a synthetic frame
+void writeEmbedded(const MockCameraState& s, uint8_t* data, uint32_t seq, const uint8_t (&values)[12]) {
+    const uint32_t lines = std::min(s.device->options.embedded_lines, s.config.height);
+    for (uint32_t line = 0; line < lines; line++) {
+        LineWriter writer(data + static_cast<size_t>(line) * s.row_size, s.row_size, s.packing, s.config.bit_width);
+        writer.put(0x0A);
+        if (line == 0) {
+            size_t v = 0;
+            for (const auto& run : kEmbeddedRuns) {
+                writer.put(0xAA);
+                writer.put(static_cast<uint8_t>(run[0] >> 8));
+                writer.put(0xA5);
+                writer.put(static_cast<uint8_t>(run[0]));
+                for (uint16_t i = 0; i < run[1]; i++, v++) {
+                    writer.put(0x5A);
+                    writer.put(run[0] == kFrameCountReg ? static_cast<uint8_t>(seq) : values[v]);
+                }
+            }
+        }
+        writer.put(0x07);
+        writer.put(0x07);
+        writer.finish();
+    }
+}
+
+// the values of `kEmbeddedRuns`, under the camera mutex
+void embeddedValues(const MockCameraState& s, uint8_t (&values)[12]) {
+    // the defaults of a sensor nobody configured: 40 degrees, a frame 64 lines longer than the image exposed for most
+    // of it, unity gains
+    const uint32_t frame_length = s.config.height + 64;
+    const uint32_t exposure = frame_length - 48;
+    const uint8_t defaults[12] = {0,
+                                  40,
+                                  static_cast<uint8_t>(exposure >> 8),
+                                  static_cast<uint8_t>(exposure),
+                                  0,
+                                  0,
+                                  0x01,
+                                  0x00,
+                                  static_cast<uint8_t>(frame_length >> 8),
+                                  static_cast<uint8_t>(frame_length),
+                                  0x3D,
+                                  0x20};
+    size_t v = 0;
+    for (const auto& run : kEmbeddedRuns) {
+        for (uint16_t i = 0; i < run[1]; i++, v++) {
+            auto it = s.registers.find(registerKey(s.config.i2c_addr, run[0] + i));
+            values[v] = it != s.registers.end() ? it->second : defaults[v];
+        }
+    }
+}
+
+uint64_t sinceEpochUs(Clock::time_point time) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(time - Backend::instance().epoch()).count());
+}
+
+Clock::time_point atUs(double us) {
+    return Backend::instance().epoch() + std::chrono::microseconds(static_cast<int64_t>(us));
+}
+
+// the device thread of a started camera
+void runDevice(const StatePtr& state) {
+    MockCameraState& s = *state;
+    MockDevice& device = *s.device;
+    const MockDeviceOptions& options = device.options;
+    const double period = options.fps > 0 ? 1e6 / options.fps : 0;
+
+    double bandwidth = options.bandwidth;
+    if (options.transfer_latency_us > 0) {
+        // the bytes in flight over the turnaround of a transfer
+        std::lock_guard<std::mutex> lock(s.mutex);
+        const double count = s.auto_transfer ? kAutoTransferCount : s.transfer_count;
+        const double size = s.auto_transfer ? std::min<double>(kAutoTransferSize, s.alloc_size) : s.transfer_size;
+        const double link = count * size / options.transfer_latency_us * 1e6;
+        bandwidth = bandwidth > 0 ? std::min(bandwidth, link) : link;
+    }
+
+    // frames start on a grid of the frame period from the epoch, so that devices of the same rate run in step
+    const double now = static_cast<double>(sinceEpochUs(Clock::now()));
+    double next = period > 0 ? (std::floor(now / period) + 1) * period : now;
+    uint64_t window_start = sinceEpochUs(Clock::now());
+    uint64_t window_frames = 0;
+    uint64_t window_bytes = 0;
+
+    for (;;) {
+        uint8_t* buffer = nullptr;
+        bool late = false;
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            if (period > 0) {
+                s.device_cv.wait_until(lock, atUs(next), [&] { return s.halted; });
+                // a frame whose slot already passed is lost on the device
+                late = static_cast<double>(sinceEpochUs(Clock::now())) > next + period;
+            } else {
+                s.device_cv.wait(lock, [&] { return s.halted || !s.input.empty(); });
+            }
+            if (s.halted) {
+                return;
+            }
+            if (!late && !s.input.empty()) {
+                buffer = s.input.front();
+                s.input.pop_front();
+            }
+        }
+
+        const double start = period > 0 ? next : static_cast<double>(sinceEpochUs(Clock::now()));
+        next += period;
+        // the source of the frame
+        Frame source{};
+        if (device.replay) {
+            if (s.replay_index >= device.replay->frameCount() && options.loop) {
+                s.replay_index = 0;
+            }
+            if (!device.replay->frame(s.replay_index, source)) {
+                // the recording is over: the device stays silent until stopped
+                std::unique_lock<std::mutex> lock(s.mutex);
+                if (buffer != nullptr) {
+                    s.input.push_front(buffer);
+                }
+                s.device_cv.wait(lock, [&] { return s.halted; });
+                return;
+            }
+            s.replay_index++;
+        }
+
+        const uint32_t seq = s.seq++;
+        device.frames++;
+        emit(s, FrameStart);
+        if (buffer == nullptr) {
+            device.dropped++;
+            continue;
+        }
+
+        Frame frame{};
+        frame.seq = seq;
+        frame.alloc_size = s.alloc_size;
+        frame.data = buffer;
+        uint8_t values[12];
+        bool firmware_time;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            embeddedValues(s, values);
+            firmware_time = s.time_source == Firmware;
+            frame.format = ArducamFrameFormat{s.config.width, s.config.height, s.config.bit_width, s.config.format};
+        }
+        if (device.replay) {
+            frame.format = source.format;
+            frame.size = std::min(source.size, frame.alloc_size);
+            std::memcpy(buffer, source.data, frame.size);
+        } else {
+            frame.size = static_cast<uint32_t>(s.row_size * frame.format.height);
+            if (!s.pattern.empty()) {
+                std::memcpy(buffer, s.pattern.data() + (seq % (kPatternRows / 2)) * 2 * s.row_size, frame.size);
+            }
+            writeEmbedded(s, buffer, seq, values);
+        }
+        frame.expected_size = frame.size;
+        if (firmware_time) {
+            frame.timestamp = static_cast<uint64_t>(static_cast<int64_t>(start * 10) + options.clock_offset);
+        } else {
+            const auto wall = std::chrono::system_clock::now() -
+                              std::chrono::microseconds(static_cast<int64_t>(sinceEpochUs(Clock::now()) - start));
+            frame.timestamp = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(wall.time_since_epoch()).count());
+        }
+
+        // the frame arrives when the link carried it
+        if (bandwidth > 0) {
+            const double begin = std::max(start, static_cast<double>(sinceEpochUs(Clock::now())));
+            std::unique_lock<std::mutex> lock(s.mutex);
+            s.device_cv.wait_until(lock, atUs(begin + frame.size / bandwidth * 1e6), [&] { return s.halted; });
+            if (s.halted) {
+                s.input.push_front(buffer);
+                return;
+            }
+        }
+
+        int error = device.injected.exchange(0);
+        const uint64_t sent = ++device.sent;
+        if (error == 0 && options.transfer_error_every != 0 && sent % options.transfer_error_every == 0) {
+            error = TransferError;
+        }
+        if (error == 0 && options.transfer_error_rate > 0 &&
+            (splitmix64(options.seed ^ (static_cast<uint64_t>(seq) << 20)) >> 11) * 0x1.0p-53 <
+                options.transfer_error_rate) {
+            error = TransferError;
+        }
+
+        bool deliver = true;
+        if (error != 0) {
+            device.transfer_errors++;
+            emit(s, static_cast<ArducamEventCode>(error));
+            bool force = false;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                force = s.force_capture;
+                if (!force) {
+                    s.input.push_back(buffer);
+                }
+            }
+            // a forced frame comes cut short where the transfer failed
+            frame.size = force ? frame.size / 2 : 0;
+            deliver = force;
+            log(s, warn, "transfer error in frame " + std::to_string(seq));
+        }
+
+        if (deliver) {
+            std::shared_ptr<Camera::CaptureCallback> callback;
+            {
+                std::lock_guard<std::mutex> lock(s.callback_mutex);
+                callback = s.capture_callback;
+            }
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.buffers[buffer].held = true;
+                if (!callback) {
+                    // waiters are woken after `FrameEnd`: a latency measured from the event never goes negative
+                    s.output.push_back(frame);
+                }
+            }
+            if (error == 0) {
+                emit(s, FrameEnd);
+            }
+            if (callback) {
+                (*callback)(frame);
+                // the buffer of a callback goes back when it returns, unless it was freed already
+                std::lock_guard<std::mutex> lock(s.mutex);
+                auto it = s.buffers.find(buffer);
+                if (it != s.buffers.end() && it->second.held) {
+                    it->second.held = false;
+                    if (it->second.retired) {
+                        s.buffers.erase(it);
+                    } else {
+                        s.input.push_back(buffer);
+                    }
+                }
+            } else {
+                s.output_cv.notify_all();
+            }
+            device.delivered++;
+            window_frames++;
+            window_bytes += frame.size;
+        }
+
+        const uint64_t now_us = sinceEpochUs(Clock::now());
+        if (now_us - window_start >= 1000000) {
+            const double seconds = (now_us - window_start) / 1e6;
+            s.capture_fps = static_cast<int>(std::lround(window_frames / seconds));
+            s.bandwidth = static_cast<int>(std::lround(window_bytes / seconds / 1000));
+            window_start = now_us;
+            window_frames = 0;
+            window_bytes = 0;
+        }
+        if (options.disconnect_after != 0 && sent >= options.disconnect_after) {
+            Backend::instance().disconnect(s.device);
+        }
+    }
+}
+
+bool parseNumber(const std::string& text, double& value) {
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size();
+}
+
+bool parseUnsigned(const std::string& text, uint64_t& value) {
+    char* end = nullptr;
+    value = std::strtoull(text.c_str(), &end, 0);
+    return !text.empty() && text[0] != '-' && end == text.c_str() + text.size();
+}
+
+bool parseOption(const std::string& key, const std::string& text, MockDeviceOptions& options) {
+    double number = 0;
+    uint64_t value = 0;
+    if (key == "serial") {
+        options.serial = text;
+        return true;
+    }
+    if (key == "replay") {
+        options.replay_file = text;
+        return true;
+    }
+    if (key == "packing") {
+        const std::pair<const char*, PixelPacking> packings[] = {{"8", PixelPacking::Bits8},
+                                                                 {"16", PixelPacking::Bits16},
+                                                                 {"raw10", PixelPacking::Raw10Packed},
+                                                                 {"raw12", PixelPacking::Raw12Packed}};
+        for (const auto& packing : packings) {
+            if (text == packing.first) {
+                options.packing = packing.second;
+                return true;
+            }
+        }
+        return false;
+    }
+    if (key == "size") {
+        unsigned width = 0;
+        unsigned height = 0;
+        char tail = 0;
+        if (std::sscanf(text.c_str(), "%ux%u%c", &width, &height, &tail) != 2 || width == 0 || height == 0) {
+            return false;
+        }
+        // keeps the bit width of a `bits` option before it
+        const uint8_t bits = options.modes.empty() ? 10 : options.modes[0].bit_width;
+        options.modes = imx708Modes();
+        options.modes.resize(1);
+        options.modes[0].width = width;
+        options.modes[0].height = height;
+        options.modes[0].bit_width = bits;
+        return true;
+    }
+    if (key == "bits") {
+        if (!parseUnsigned(text, value) || value == 0 || value > 16) {
+            return false;
+        }
+        if (options.modes.empty()) {
+            options.modes = imx708Modes();
+        }
+        for (ArducamCameraConfig& mode : options.modes) {
+            mode.bit_width = static_cast<uint8_t>(value);
+        }
+        return true;
+    }
+    if (key == "fps" || key == "bandwidth" || key == "latency" || key == "error_rate") {
+        if (!parseNumber(text, number) || number < 0) {
+            return false;
+        }
+        double& field = key == "fps"         ? options.fps
+                        : key == "bandwidth" ? options.bandwidth
+                        : key == "latency"   ? options.transfer_latency_us
+                                             : options.transfer_error_rate;
+        field = number;
+        return true;
+    }
+    if (key == "clock_offset") {
+        if (!parseNumber(text, number)) {
+            return false;
+        }
+        options.clock_offset = static_cast<int64_t>(number);
+        return true;
+    }
+    if (!parseUnsigned(text, value)) {
+        return false;
+    }
+    if (key == "embedded") {
+        options.embedded_lines = static_cast<uint32_t>(value);
+    } else if (key == "seed") {
+        options.seed = value;
+    } else if (key == "loop") {
+        options.loop = value != 0;
+    } else if (key == "buffers") {
+        options.buffer_count = static_cast<uint32_t>(value);
+    } else if (key == "error_every") {
+        options.transfer_error_every = static_cast<uint32_t>(value);
+    } else if (key == "disconnect_after") {
+        options.disconnect_after = value;
+    } else if (key == "usb") {
+        if (value != USB_2 && value != USB_3) {
+            return false;
+        }
+        options.usb_type = static_cast<uint16_t>(value);
+        options.speed = value == USB_3 ? USB_SPEED_SUPER : USB_SPEED_HIGH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= text.size()) {
+        const size_t end = std::min(text.find(separator, start), text.size());
+        items.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+}  // namespace
+
+bool addMockDevice(const MockDeviceOptions& options) { return Backend::instance().add(options); }
+
+bool disconnectMockDevice(const std::string& serial) {
+    std::shared_ptr<MockDevice> device = Backend::instance().find(serial);
+    return device && Backend::instance().disconnect(device);
+}
+
+bool connectMockDevice(const std::string& serial) {
+    std::shared_ptr<MockDevice> device = Backend::instance().find(serial);
+    return device && Backend::instance().connect(device);
+}
+
+bool removeMockDevice(const std::string& serial) { return Backend::instance().remove(serial); }
+
+bool injectMockError(const std::string& serial, ArducamEventCode event) {
+    if (event != TransferError && event != TransferTimeout && event != TransferLengthError) {
+        return false;
+    }
+    std::shared_ptr<MockDevice> device = Backend::instance().find(serial);
+    if (!device) {
+        return false;
+    }
+    device->injected = event;
+    return true;
+}
+
+bool mockDeviceStats(const std::string& serial, MockDeviceStats& stats) {
+    std::shared_ptr<MockDevice> device = Backend::instance().find(serial);
+    if (!device) {
+        return false;
+    }
+    stats.frames = device->frames;
+    stats.delivered = device->delivered;
+    stats.dropped = device->dropped;
+    stats.transfer_errors = device->transfer_errors;
+    stats.disconnects = device->disconnects;
+    return true;
+}
+
+bool parseMockDevices(const std::string& spec, std::vector<MockDeviceOptions>& devices) {
+    devices.clear();
+    for (const std::string& item : split(spec, ';')) {
+        if (item.empty()) {
+            continue;
+        }
+        MockDeviceOptions options;
+        for (const std::string& option : split(item, ',')) {
+            const size_t eq = option.find('=');
+            if (eq == std::string::npos || !parseOption(option.substr(0, eq), option.substr(eq + 1), options)) {
+                return false;
+            }
+        }
+        devices.push_back(std::move(options));
+    }
+    return true;
+}
+
+// ---- the SDK classes
+
+Param::Param() : ArducamCameraOpenParam() { mem_type = DMA; }
+
+DeviceList DeviceList::listDevices() {
+    DeviceList list;
+    list.refresh();
+    return list;
+}
+
+DeviceList::DeviceList(DeviceList&& other) noexcept : devices_(other.devices_) { other.devices_ = nullptr; }
+
+DeviceList::~DeviceList() noexcept { Backend::instance().release(devices_); }
+
+const DeviceHandle* DeviceList::begin() const { return devices_ != nullptr ? devices_->devices : nullptr; }
+
+const DeviceHandle* DeviceList::end() const {
+    return devices_ != nullptr ? devices_->devices + devices_->size : nullptr;
+}
+
+size_t DeviceList::size() const { return devices_ != nullptr ? devices_->size : 0; }
+
+const DeviceHandle& DeviceList::operator[](size_t index) const { return devices_->devices[index]; }
+
+const DeviceHandle& DeviceList::at(size_t index) const {
+    static const DeviceHandle kNone = nullptr;
+    return index < size() ? devices_->devices[index] : kNone;
+}
+
+bool DeviceList::refresh() {
+    devices_ = Backend::instance().refresh(devices_);
+    return true;
+}
+
+bool DeviceList::setEventCallback(const EventCallback& func) {
+    if (devices_ == nullptr) {
+        refresh();
+    }
+    return Backend::instance().setListCallback(devices_, func);
+}
+
+bool DeviceList::hasEventCallback() const { return Backend::instance().hasListCallback(devices_); }
+
+Camera::Camera(const ArducamCameraOpenParam& param) { open(param); }
+
+Camera::~Camera() noexcept { close(); }
+
+bool Camera::open(const ArducamCameraOpenParam& param) {
+    if (handle_ != nullptr) {
+        return setError(last_error, StateError);
+    }
+    StatePtr state = std::make_shared<MockCameraState>();
+    int error = Success;
+    state->device = Backend::instance().claim(param.device, state, error);
+    if (!state->device) {
+        return setError(last_error, error);
+    }
+    state->entry = newDeviceEntry(*state->device, true);
+    state->config = state->device->modes[0];
+    state->mem_type = param.mem_type;
+    state->config_type = param.bin_config                 ? ConfigType::BINARY
+                         : param.config_file_name != nullptr ? ConfigType::TEXT
+                                                             : ConfigType::NONE;
+    handle_ = new StatePtr(std::move(state));
+    return setError(last_error, Success);
+}
+
+bool Camera::isOpened() const { return handle_ != nullptr; }
+
+bool Camera::init() {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->running) {
+        return setError(last_error, StateError);
+    }
+    allocate(*s);
+    s->initialized = true;
+    return setError(last_error, Success);
+}
+
+uint32_t Camera::modeSize() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? static_cast<uint32_t>(s->device->modes.size()) : 0;
+}
+
+bool Camera::listMode(uint32_t* ids, ArducamCameraConfig* configs) const {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr || ids == nullptr || configs == nullptr) {
+        return setError(last_error, s == nullptr ? StateError : InvalidArgument);
+    }
+    for (size_t i = 0; i < s->device->modes.size(); i++) {
+        ids[i] = static_cast<uint32_t>(i);
+        configs[i] = s->device->modes[i];
+    }
+    return setError(last_error, Success);
+}
+
+bool Camera::switchMode(uint32_t mode_id) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (mode_id >= s->device->modes.size()) {
+        return setError(last_error, InvalidArgument);
+    }
+    if (s->running) {
+        return setError(last_error, StateError);
+    }
+    s->config = s->device->modes[mode_id];
+    allocate(*s);
+    s->initialized = true;
+    return setError(last_error, Success);
+}
+
+bool Camera::clearBuffer() {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        for (const Frame& frame : s->output) {
+            s->buffers[frame.data].held = false;
+            s->input.push_back(frame.data);
+        }
+        s->output.clear();
+    }
+    s->device_cv.notify_all();
+    return setError(last_error, Success);
+}
+
+bool Camera::close() {
+    if (handle_ == nullptr) {
+        return setError(last_error, StateError);
+    }
+    stop();
+    StatePtr* state = static_cast<StatePtr*>(handle_);
+    Backend::instance().unclaim(*(*state)->device, state->get());
+    delete state;
+    handle_ = nullptr;
+    return setError(last_error, Success);
+}
+
+bool Camera::start() {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->running) {
+        return setError(last_error, Success);
+    }
+    if (!s->initialized || s->disconnected) {
+        return setError(last_error, StateError);
+    }
+    // the frames nobody captured before the stop are dropped
+    for (const Frame& frame : s->output) {
+        s->buffers[frame.data].held = false;
+        s->input.push_back(frame.data);
+    }
+    s->output.clear();
+    s->halted = false;
+    s->running = true;
+    StatePtr state = *static_cast<StatePtr*>(handle_);
+    s->thread = std::thread([state] { runDevice(state); });
+    return setError(last_error, Success);
+}
+
+bool Camera::stop() {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        if (!s->running) {
+            return setError(last_error, Success);
+        }
+        s->running = false;
+        s->halted = true;
+        thread = std::move(s->thread);
+    }
+    s->device_cv.notify_all();
+    s->output_cv.notify_all();
+    if (thread.get_id() == std::this_thread::get_id()) {
+        // stopped from a callback: the thread holds the state until it returns
+        thread.detach();
+    } else if (thread.joinable()) {
+        thread.join();
+    }
+    emit(*s, Exit);
+    return setError(last_error, Success);
+}
+
+bool Camera::checkUSBType() {
+    MockCameraState* s = stateOf(handle_);
+    return setError(last_error, s != nullptr ? Success : StateError);
+}
+
+bool Camera::waitCapture(int timeout) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::unique_lock<std::mutex> lock(s->mutex);
+    auto ready = [s] { return !s->output.empty(); };
+    const bool ok = timeout < 0 ? (s->output_cv.wait(lock, ready), true)
+                                : s->output_cv.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+    return setError(last_error, ok ? Success : CaptureTimeout);
+}
+
+bool Camera::capture(Frame& frameData, int timeout) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    if (s->has_capture_callback) {
+        return setError(last_error, CaptureMethodConflict);
+    }
+    std::unique_lock<std::mutex> lock(s->mutex);
+    auto ready = [s] { return !s->output.empty(); };
+    const bool ok = timeout < 0 ? (s->output_cv.wait(lock, ready), true)
+                                : s->output_cv.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+    if (!ok) {
+        return setError(last_error, CaptureTimeout);
+    }
+    frameData = s->output.front();
+    s->output.pop_front();
+    return setError(last_error, Success);
+}
+
+bool Camera::freeImage(const Frame& frameData) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    if (frameData.data == nullptr) {
+        return setError(last_error, FreeEmptyBuffer);
+    }
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        auto it = s->buffers.find(frameData.data);
+        if (it == s->buffers.end() || !it->second.held) {
+            return setError(last_error, FreeUnknowBuffer);
+        }
+        // a frame still in the output queue is freed in place
+        auto queued = std::find_if(s->output.begin(), s->output.end(),
+                                   [&](const Frame& frame) { return frame.data == frameData.data; });
+        if (queued != s->output.end()) {
+            s->output.erase(queued);
+        }
+        it->second.held = false;
+        if (it->second.retired) {
+            s->buffers.erase(it);
+        } else {
+            s->input.push_back(frameData.data);
+        }
+    }
+    s->device_cv.notify_all();
+    return setError(last_error, Success);
+}
+
+int Camera::getAvailCount() {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    return static_cast<int>(s->output.size());
+}
+
+bool Camera::registerControls(Control* controls, uint32_t controls_length) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    s->controls = controls;
+    s->control_count = controls != nullptr ? controls_length : 0;
+    return setError(last_error, Success);
+}
+
+bool Camera::setControl(const char* name, int64_t val) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr || name == nullptr) {
+        return setError(last_error, s == nullptr ? StateError : InvalidArgument);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    // any control is accepted while none are registered; registered ones are found by name or function
+    for (uint32_t i = 0; i < s->control_count; i++) {
+        const Control& control = s->controls[i];
+        if (std::strcmp(control.name, name) == 0 || std::strcmp(control.func, name) == 0) {
+            s->control_values[control.func] = std::max(control.min, std::min(control.max, val));
+            return setError(last_error, Success);
+        }
+    }
+    if (s->control_count != 0) {
+        return setError(last_error, InvalidArgument);
+    }
+    s->control_values[name] = val;
+    return setError(last_error, Success);
+}
+
+uint32_t Camera::controlSize() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->control_count : 0;
+}
+
+const Control* Camera::controls() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->controls : nullptr;
+}
+
+bool Camera::setTimeSource(TimeSource val) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    s->time_source = val;
+    return setError(last_error, Success);
+}
+
+void Camera::enableConsoleLog(bool enable) {
+    if (MockCameraState* s = stateOf(handle_)) {
+        s->console_log = enable;
+    }
+}
+
+void Camera::setLogLevel(LoggerLevel level) {
+    if (MockCameraState* s = stateOf(handle_)) {
+        s->log_level = level;
+    }
+}
+
+LoggerLevel Camera::logLevel() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->log_level : info;
+}
+
+bool Camera::addLogFile(const char* filename) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr || filename == nullptr) {
+        return setError(last_error, s == nullptr ? StateError : InvalidArgument);
+    }
+    s->log_file = filename;
+    return setError(last_error, Success);
+}
+
+bool Camera::readBoardConfig(uint8_t command, uint16_t value, uint16_t index, uint32_t buf_size, uint8_t* data) {
+    (void)command;
+    (void)value;
+    (void)index;
+    // a board without a configuration
+    if (data != nullptr) {
+        std::memset(data, 0, buf_size);
+    }
+    return setError(last_error, stateOf(handle_) != nullptr ? Success : StateError);
+}
+
+bool Camera::readUserData(uint16_t addr, uint8_t len, uint8_t* data) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    if (len == 0 || data == nullptr) {
+        return setError(last_error, UserdataLenError);
+    }
+    if (static_cast<size_t>(addr) + len > kUserDataSize) {
+        return setError(last_error, UserdataAddrError);
+    }
+    std::lock_guard<std::mutex> lock(s->device->user_data_mutex);
+    std::memcpy(data, s->device->user_data.data() + addr, len);
+    return setError(last_error, Success);
+}
+
+#if defined(WITH_STD_OPTIONAL)
+std::optional<uint32_t> Camera::readReg(I2CMode mode, uint32_t i2cAddr, uint32_t regAddr) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        setError(last_error, StateError);
+        return std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    setError(last_error, Success);
+    return readRegister(*s, mode, i2cAddr, regAddr);
+}
+
+std::optional<uint32_t> Camera::readSensorReg(uint32_t regAddr) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        setError(last_error, StateError);
+        return std::nullopt;
+    }
+    return readReg(static_cast<I2CMode>(s->config.i2c_mode), s->config.i2c_addr, regAddr);
+}
+#else
+uint32_t Camera::readReg(I2CMode mode, uint32_t i2cAddr, uint32_t regAddr) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        setError(last_error, StateError);
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    setError(last_error, Success);
+    return readRegister(*s, mode, i2cAddr, regAddr);
+}
+
+uint32_t Camera::readSensorReg(uint32_t regAddr) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        setError(last_error, StateError);
+        return 0;
+    }
+    return readReg(static_cast<I2CMode>(s->config.i2c_mode), s->config.i2c_addr, regAddr);
+}
+#endif
+
+bool Camera::writeBoardConfig(uint8_t command, uint16_t value, uint16_t index, const uint8_t* buf,
+                              uint32_t buf_size) {
+    (void)command;
+    (void)value;
+    (void)index;
+    (void)buf;
+    (void)buf_size;
+    // accepted and ignored, the board has nothing to configure
+    return setError(last_error, stateOf(handle_) != nullptr ? Success : StateError);
+}
+
+bool Camera::writeUserData(uint16_t addr, const uint8_t* data, uint32_t data_size) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    if (data_size == 0 || data_size > std::min(s->device->options.user_data_max_transfer, kMaxUserDataTransfer) ||
+        data == nullptr) {
+        return setError(last_error, UserdataLenError);
+    }
+    if (static_cast<size_t>(addr) + data_size > kUserDataSize) {
+        return setError(last_error, UserdataAddrError);
+    }
+    std::lock_guard<std::mutex> lock(s->device->user_data_mutex);
+    std::memcpy(s->device->user_data.data() + addr, data, data_size);
+    return setError(last_error, Success);
+}
+
+bool Camera::writeReg(I2CMode mode, uint32_t i2cAddr, uint32_t regAddr, uint32_t val) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    writeRegister(*s, mode, i2cAddr, regAddr, val);
+    return setError(last_error, Success);
+}
+
+bool Camera::writeSensorReg(uint32_t regAddr, uint32_t val) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    return writeReg(static_cast<I2CMode>(s->config.i2c_mode), s->config.i2c_addr, regAddr, val);
+}
+
+bool Camera::sendVRCommand(uint8_t command, uint8_t direction, uint16_t value, uint16_t index, uint8_t* buf,
+                           uint32_t buf_size) {
+    (void)command;
+    (void)value;
+    (void)index;
+    if (direction == VR_DEVICE_TO_HOST && buf != nullptr) {
+        std::memset(buf, 0, buf_size);
+    }
+    return setError(last_error, stateOf(handle_) != nullptr ? Success : StateError);
+}
+
+void Camera::setCaptureCallback(const CaptureCallback& func) {
+    if (MockCameraState* s = stateOf(handle_)) {
+        std::lock_guard<std::mutex> lock(s->callback_mutex);
+        s->capture_callback = func ? std::make_shared<CaptureCallback>(func) : nullptr;
+        s->has_capture_callback = static_cast<bool>(func);
+    }
+}
+
+bool Camera::hasCaptureCallback() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr && s->has_capture_callback;
+}
+
+void Camera::setEventCallback(const EventCallback& func) {
+    if (MockCameraState* s = stateOf(handle_)) {
+        std::lock_guard<std::mutex> lock(s->callback_mutex);
+        s->event_callback = func ? std::make_shared<EventCallback>(func) : nullptr;
+    }
+}
+
+bool Camera::hasEventCallback() const {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(s->callback_mutex);
+    return s->event_callback != nullptr;
+}
+
+void Camera::setMessageCallback(const MessageCallback& func) {
+    if (MockCameraState* s = stateOf(handle_)) {
+        std::lock_guard<std::mutex> lock(s->callback_mutex);
+        s->message_callback = func ? std::make_shared<MessageCallback>(func) : nullptr;
+    }
+}
+
+bool Camera::hasMessageCallback() const {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(s->callback_mutex);
+    return s->message_callback != nullptr;
+}
+
+int Camera::captureFps() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->capture_fps.load() : 0;
+}
+
+// in kB/s
+int Camera::bandwidth() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->bandwidth.load() : 0;
+}
+
+#if defined(WITH_STD_STRING_VIEW)
+std::string_view Camera::usbType() const {
+    MockCameraState* s = stateOf(handle_);
+    return s == nullptr ? "" : s->device->options.usb_type == USB_3 ? "USB3" : "USB2";
+}
+#else
+const char* Camera::usbType() const {
+    MockCameraState* s = stateOf(handle_);
+    return s == nullptr ? "" : s->device->options.usb_type == USB_3 ? "USB3" : "USB2";
+}
+#endif
+
+int Camera::usbTypeNumber() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->device->options.usb_type : 0;
+}
+
+DeviceHandle Camera::device() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->entry.get() : nullptr;
+}
+
+ArducamCameraConfig Camera::config() const {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return ArducamCameraConfig{};
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    return s->config;
+}
+
+ConfigType Camera::configType() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->config_type : ConfigType::NONE;
+}
+
+bool Camera::setConfig(const ArducamCameraConfig& config) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->running) {
+        return setError(last_error, StateError);
+    }
+    if (config.width == 0 || config.height == 0 || config.bit_width == 0) {
+        return setError(last_error, InvalidArgument);
+    }
+    s->config = config;
+    if (s->initialized) {
+        allocate(*s);
+    }
+    return setError(last_error, Success);
+}
+
+bool Camera::setTransfer(int transfer_count, int buffer_size) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    if (transfer_count <= 0 || buffer_size <= 0) {
+        return setError(last_error, InvalidArgument);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->running) {
+        return setError(last_error, StateError);
+    }
+    s->transfer_count = transfer_count;
+    s->transfer_size = buffer_size;
+    s->auto_transfer = false;
+    return setError(last_error, Success);
+}
+
+bool Camera::setAutoTransfer(bool auto_transfer) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->running) {
+        return setError(last_error, StateError);
+    }
+    s->auto_transfer = auto_transfer;
+    return setError(last_error, Success);
+}
+
+bool Camera::getAutoTransfer(int& transfer_count, int& buffer_size) const {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    transfer_count = kAutoTransferCount;
+    // whole kilobytes, no larger than a frame
+    buffer_size = std::max(1024, std::min<int>(kAutoTransferSize, (s->alloc_size + 1023) / 1024 * 1024));
+    return setError(last_error, Success);
+}
+
+bool Camera::setMemType(MemType mem_type) {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return setError(last_error, StateError);
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->running) {
+        return setError(last_error, StateError);
+    }
+    s->mem_type = mem_type;
+    return setError(last_error, Success);
+}
+
+MemType Camera::memType() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->mem_type : DMA;
+}
+
+void Camera::setForceCapture(bool force_capture) {
+    if (MockCameraState* s = stateOf(handle_)) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->force_capture = force_capture;
+    }
+}
+
+bool Camera::forceCapture() const {
+    MockCameraState* s = stateOf(handle_);
+    if (s == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(s->mutex);
+    return s->force_capture;
+}
+
+int Camera::lastError() const { return last_error.load(std::memory_order_relaxed); }
+
+const char* Camera::lastErrorMessage() const {
+    switch (last_error.load(std::memory_order_relaxed)) {
+        case Success:
+            return "Success";
+        case Empty:
+            return "Empty";
+        case InvalidArgument:
+            return "Invalid argument";
+        case OpenCameraFailed:
+            return "Failed to open camera";
+        case CaptureTimeout:
+            return "Capture timeout";
+        case CaptureMethodConflict:
+            return "Capture method conflict";
+        case FreeEmptyBuffer:
+            return "Free empty buffer";
+        case FreeUnknowBuffer:
+            return "Free unknown buffer";
+        case StateError:
+            return "Camera state error";
+        case UserdataAddrError:
+            return "Userdata address error";
+        case UserdataLenError:
+            return "Userdata length error";
+        default:
+            return "Unknown error";
+    }
+}
+
+#if defined(__GNUC__)
+// the declaration returns a const pointer by value
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wignored-qualifiers"
+#endif
+const ArducamCameraHandle Camera::handle() const { return handle_; }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+const char* Camera::camera_name() const {
+    MockCameraState* s = stateOf(handle_);
+    return s != nullptr ? s->config.camera_name : "";
+}
+
+uint32_t Camera::width() const { return config().width; }
+
+uint32_t Camera::height() const { return config().height; }
+
+uint8_t Camera::bitWidth() const { return config().bit_width; }
+
+uint16_t Camera::format() const { return config().format; }
+
+uint8_t Camera::i2cMode() const { return config().i2c_mode; }
+
+uint16_t Camera::i2cAddr() const { return config().i2c_addr; }
+
+bool is_same(Device& lhs, Device& rhs) {
+    return std::memcmp(lhs.serial_number, rhs.serial_number, sizeof(lhs.serial_number)) == 0 &&
+           entryPath(lhs) == entryPath(rhs);
+}
+
+bool is_same(Arducam::DeviceHandle lhs, Arducam::DeviceHandle rhs) {
+    return lhs != nullptr && rhs != nullptr && is_same(*lhs, *rhs);
+}
+
+}  // namespace Arducam
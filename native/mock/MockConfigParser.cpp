@@ -0,0 +1,333 @@
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <arducam_config_parser.h>
+
+// The `arducam_parse_config()` of the mock backend, linked instead of `arducam_config_parser`, so that
+// `RegisterProgram::compileFile()`, `CompiledConfig::load()` and `DeviceRegistry` run without the SDK. It reads the
+// sections of the SDK configuration files:
+//
+//   [camera parameter]             CFG_MODE, TYPE, SIZE = w, h, BIT_WIDTH, FORMAT = mode, order, I2C_MODE,
+//                                  I2C_ADDR, TRANS_LVL
+//   [control parameter]            one control: MIN_VALUE, MAX_VALUE, STEP, DEF, CTRL_NAME, FUNC_NAME, CODE
+//   [board parameter][dev3][inf2]  VRCMD = command, value, index, length, payload...
+//   [register parameter][dev2]     REG = address, value and DELAY = ms
+//
+// `[devN]` and `[infN]` select the USB type of a section as the SDK parser does. Comments start with `;`, `#` or
+// `//`. Numbers are decimal or `0x` hexadecimal.
+
+namespace {
+
+struct ParsedFile {
+    CameraConfigs configs{};
+    std::vector<Config> lines;
+    std::vector<Control> controls;
+};
+
+std::string trim(const std::string& text) {
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) {
+        begin++;
+    }
+    while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) {
+        end--;
+    }
+    return text.substr(begin, end - begin);
+}
+
+std::string lower(std::string text) {
+    for (char& c : text) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return text;
+}
+
+bool parseUint(const std::string& text, uint64_t& value) {
+    const std::string t = trim(text);
+    if (t.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoull(t.c_str(), &end, 0);
+    return *end == '\0';
+}
+
+bool parseInt(const std::string& text, int64_t& value) {
+    const std::string t = trim(text);
+    if (t.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoll(t.c_str(), &end, 0);
+    return *end == '\0';
+}
+
+bool parseList(const std::string& text, std::vector<uint64_t>& values) {
+    values.clear();
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t comma = text.find(',', begin);
+        if (comma == std::string::npos) {
+            comma = text.size();
+        }
+        uint64_t value = 0;
+        if (!parseUint(text.substr(begin, comma - begin), value)) {
+            return false;
+        }
+        values.push_back(value);
+        begin = comma + 1;
+    }
+    return true;
+}
+
+// the section type of a header such as `[register parameter][dev3][inf2]`, 0 if unknown
+uint32_t sectionType(const std::string& header) {
+    std::vector<std::string> tags;
+    size_t pos = 0;
+    while ((pos = header.find('[', pos)) != std::string::npos) {
+        const size_t close = header.find(']', pos);
+        if (close == std::string::npos) {
+            return 0;
+        }
+        tags.push_back(lower(trim(header.substr(pos + 1, close - pos - 1))));
+        pos = close + 1;
+    }
+    if (tags.empty()) {
+        return 0;
+    }
+    uint32_t type = 0;
+    if (tags[0] == "camera parameter") {
+        type = SECTION_TYPE_CAMERA;
+    } else if (tags[0] == "control parameter") {
+        type = SECTION_TYPE_CONTROL;
+    } else if (tags[0] == "board parameter") {
+        type = SECTION_TYPE_BOARD;
+    } else if (tags[0] == "register parameter") {
+        type = SECTION_TYPE_REG;
+    } else {
+        return 0;
+    }
+    bool dev2 = false;
+    bool dev3 = false;
+    bool inf2 = false;
+    bool inf3 = false;
+    for (size_t i = 1; i < tags.size(); i++) {
+        dev2 = dev2 || tags[i] == "dev2";
+        dev3 = dev3 || tags[i] == "dev3";
+        inf2 = inf2 || tags[i] == "inf2";
+        inf3 = inf3 || tags[i] == "inf3";
+    }
+    if (dev2) {
+        type |= 0x02 << 16;
+    } else if (dev3) {
+        type |= (inf2 ? 0x04 : inf3 ? 0x03 : 0x00) << 16;
+    }
+    return type;
+}
+
+void copyString(const std::string& text, char* dst, size_t size) {
+    std::strncpy(dst, text.c_str(), size - 1);
+    dst[size - 1] = '\0';
+}
+
+bool parseCamera(const std::string& key, const std::string& value, CameraParam& param) {
+    uint64_t number = 0;
+    std::vector<uint64_t> list;
+    if (key == "TYPE") {
+        copyString(trim(value), param.type, sizeof(param.type));
+        return true;
+    }
+    if (key == "SIZE" || key == "FORMAT") {
+        if (!parseList(value, list) || list.size() < 1 || list.size() > 2) {
+            return false;
+        }
+        if (key == "SIZE") {
+            param.width = static_cast<uint32_t>(list[0]);
+            param.height = static_cast<uint32_t>(list.size() > 1 ? list[1] : 0);
+        } else {
+            param.format = static_cast<uint16_t>(list[0] << 8 | (list.size() > 1 ? list[1] : 0));
+        }
+        return true;
+    }
+    if (!parseUint(value, number)) {
+        return false;
+    }
+    if (key == "CFG_MODE") {
+        param.cfg_mode = static_cast<uint32_t>(number);
+    } else if (key == "BIT_WIDTH") {
+        param.bit_width = static_cast<uint8_t>(number);
+    } else if (key == "I2C_MODE") {
+        param.i2c_mode = static_cast<uint8_t>(number);
+    } else if (key == "I2C_ADDR") {
+        param.i2c_addr = static_cast<uint16_t>(number);
+    } else if (key == "TRANS_LVL") {
+        param.trans_lvl = static_cast<uint32_t>(number);
+    }
+    // other keys of the SDK files carry nothing the library reads
+    return true;
+}
+
+bool parseControl(const std::string& key, const std::string& value, Control& control) {
+    int64_t number = 0;
+    if (key == "CTRL_NAME") {
+        copyString(trim(value), control.name, sizeof(control.name));
+    } else if (key == "FUNC_NAME") {
+        copyString(trim(value), control.func, sizeof(control.func));
+    } else if (key == "CODE") {
+        std::free(control.code);
+        control.code = static_cast<char*>(std::malloc(value.size() + 1));
+        if (control.code == nullptr) {
+            return false;
+        }
+        std::memcpy(control.code, value.c_str(), value.size() + 1);
+    } else if (key == "MIN_VALUE" || key == "MAX_VALUE" || key == "STEP" || key == "DEF") {
+        if (!parseInt(value, number)) {
+            return false;
+        }
+        if (key == "MIN_VALUE") {
+            control.min = number;
+        } else if (key == "MAX_VALUE") {
+            control.max = number;
+        } else if (key == "STEP") {
+            control.step = static_cast<int32_t>(number);
+        } else {
+            control.def = number;
+        }
+    }
+    return true;
+}
+
+bool parseLine(uint32_t section, const std::string& key, const std::string& value, std::vector<Config>& lines) {
+    uint32_t config_type = 0;
+    if (key == "REG") {
+        config_type = CONFIG_TYPE_REG;
+    } else if (key == "DELAY") {
+        config_type = CONFIG_TYPE_DELAY;
+    } else if (key == "VRCMD") {
+        config_type = CONFIG_TYPE_VRCMD;
+    } else {
+        return false;
+    }
+    std::vector<uint64_t> params;
+    if (!parseList(value, params) || params.size() > 16) {
+        return false;
+    }
+    Config config{};
+    config.type = section | config_type;
+    for (size_t i = 0; i < params.size(); i++) {
+        config.params[i] = static_cast<uint32_t>(params[i]);
+    }
+    config.params_length = static_cast<uint8_t>(params.size());
+    lines.push_back(config);
+    return true;
+}
+
+void freeControls(std::vector<Control>& controls) {
+    for (Control& control : controls) {
+        std::free(control.code);
+    }
+    controls.clear();
+}
+
+bool parseFile(std::istream& in, ParsedFile& file) {
+    // text before the first section is ignored, as are unknown sections
+    uint32_t section = 0;
+    std::string text;
+    while (std::getline(in, text)) {
+        std::string line = trim(text);
+        if (line.empty() || line[0] == ';' || line[0] == '#' || line.rfind("//", 0) == 0) {
+            continue;
+        }
+        // the CODE of a control may hold any character, comments only end the other lines
+        if (line.rfind("CODE", 0) != 0) {
+            for (const char* marker : {";", "#", "//"}) {
+                line = trim(line.substr(0, line.find(marker)));
+            }
+        }
+        if (line[0] == '[') {
+            section = sectionType(line);
+            if (section == SECTION_TYPE_CONTROL) {
+                file.controls.push_back(Control{});
+            }
+            continue;
+        }
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            return false;
+        }
+        const std::string key = trim(line.substr(0, equals));
+        const std::string value = trim(line.substr(equals + 1));
+        bool ok = true;
+        switch (section & 0xFF000000) {
+            case SECTION_TYPE_CAMERA:
+                ok = parseCamera(key, value, file.configs.camera_param);
+                break;
+            case SECTION_TYPE_CONTROL:
+                ok = parseControl(key, value, file.controls.back());
+                break;
+            case SECTION_TYPE_BOARD:
+            case SECTION_TYPE_REG:
+                ok = parseLine(section, key, value, file.lines);
+                break;
+            default:
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return file.lines.size() <= MAX_CONFIGS;
+}
+
+// copies `items` into a new array from malloc, which `freeParsedConfigs()` releases
+template <typename T>
+T* mallocCopy(const std::vector<T>& items) {
+    if (items.empty()) {
+        return nullptr;
+    }
+    T* array = static_cast<T*>(std::malloc(items.size() * sizeof(T)));
+    if (array != nullptr) {
+        std::memcpy(array, items.data(), items.size() * sizeof(T));
+    }
+    return array;
+}
+
+}  // namespace
+
+extern "C" int arducam_parse_config(const char* file_name, CameraConfigs* cam_cfgs) {
+    if (file_name == nullptr || cam_cfgs == nullptr) {
+        return -1;
+    }
+    std::ifstream in(file_name);
+    if (!in) {
+        LOG("arducam_parse_config: cannot open %s", file_name);
+        return -1;
+    }
+    ParsedFile file;
+    if (!parseFile(in, file)) {
+        LOG("arducam_parse_config: cannot parse %s", file_name);
+        freeControls(file.controls);
+        return -1;
+    }
+    Config* configs = mallocCopy(file.lines);
+    Control* controls = mallocCopy(file.controls);
+    if ((!file.lines.empty() && configs == nullptr) || (!file.controls.empty() && controls == nullptr)) {
+        std::free(configs);
+        std::free(controls);
+        freeControls(file.controls);
+        return -1;
+    }
+    // the code strings now belong to the copied controls
+    *cam_cfgs = file.configs;
+    cam_cfgs->configs = configs;
+    cam_cfgs->configs_length = static_cast<uint32_t>(file.lines.size());
+    cam_cfgs->controls = controls;
+    cam_cfgs->controls_length = static_cast<uint32_t>(file.controls.size());
+    return 0;
+}
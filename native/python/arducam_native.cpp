@@ -0,0 +1,479 @@
+// The `arducam_native` Python module: `Arducam::Camera` with zero-copy frames.
+//
+// Every captured frame is a read-only buffer-protocol object backed by the SDK buffer, so `numpy.asarray(frame)` is
+// a view, not a copy: raw and mono frames have the shape (height, width), RGB (height, width, 3) and YUV
+// (height, width, 2), with uint16 samples above 8 bits; other formats are flat bytes. The buffer goes back to the
+// camera when the frame and every view of it are gone, or on `frame.release()`. Leaving a `with` block releases the
+// frame as soon as the views taken inside it are gone, so an array that outlives the block holds the buffer until it
+// is dropped; copy it (`numpy.array(frame)`) to give the buffer back at once. The GIL is released while the camera
+// waits, so other Python threads (the GUI) keep running during `capture()`.
+//
+//   import arducam_native, numpy
+//   camera = arducam_native.Camera()
+//   camera.open("IMX708.cfg") and camera.init() and camera.start()
+//   with camera.capture(1000) as frame:
+//       image = numpy.asarray(frame)
+//       total = int(image.sum())
+//   del image  # the buffer goes back to the camera here
+//
+// Built as an extension module with the sources it uses, e.g. on Linux:
+//
+//   c++ -O2 -std=c++17 -shared -fPIC $(python3-config --includes) -Iinclude -I../evk_sdk/include
+//       python/arducam_native.cpp src/FrameRef.cpp -L../evk_sdk/lib -larducam_evk_cpp_sdk
+//       -o arducam_native$(python3-config --extension-suffix)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/FrameRef.hpp>
+
+using namespace Arducam;
+
+namespace {
+
+struct CameraObject {
+    PyObject_HEAD
+    Camera* camera;
+    // frames not yet returned, and calls running without the GIL: `close()` must wait for both
+    Py_ssize_t frames;
+    Py_ssize_t active;
+};
+
+struct FrameObject {
+    PyObject_HEAD
+    CameraObject* owner;
+    FrameRef ref;
+    int ndim;
+    Py_ssize_t itemsize;
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+    // the buffer views alive: the frame cannot be released before they are
+    Py_ssize_t exports;
+    // set by `__exit__` while views are alive: the last view to go releases the frame
+    bool release_pending;
+};
+
+// filled in by `PyInit_arducam_native()`
+PyTypeObject CameraType;
+PyTypeObject FrameType;
+
+// the layout of the image of a frame, flat bytes if the format has none or the buffer is too small
+void describe(FrameObject* self) {
+    const Frame& frame = self->ref.frame();
+    const uint32_t width = frame.format.width;
+    const uint32_t height = frame.format.height;
+    Py_ssize_t channels = 0;
+    switch (frame.format.format >> 8) {
+        case FORMAT_MODE_RAW:
+        case FORMAT_MODE_MON:
+        case FORMAT_MODE_RAW_D:
+        case FORMAT_MODE_MON_D:
+        case FORMAT_MODE_RGB_IR:
+            channels = 1;
+            break;
+        case FORMAT_MODE_RGB:
+            channels = 3;
+            break;
+        case FORMAT_MODE_YUV:
+            channels = 2;
+            break;
+        default:
+            break;
+    }
+    const Py_ssize_t itemsize = frame.format.bit_width > 8 ? 2 : 1;
+    const Py_ssize_t row = static_cast<Py_ssize_t>(width) * channels * itemsize;
+    if (channels == 0 || width == 0 || height == 0 || static_cast<Py_ssize_t>(frame.size) < row * height) {
+        self->ndim = 1;
+        self->itemsize = 1;
+        self->shape[0] = frame.size;
+        self->strides[0] = 1;
+        return;
+    }
+    self->ndim = channels == 1 ? 2 : 3;
+    self->itemsize = itemsize;
+    self->shape[0] = height;
+    self->shape[1] = width;
+    self->shape[2] = channels;
+    self->strides[0] = row;
+    self->strides[1] = channels * itemsize;
+    self->strides[2] = itemsize;
+}
+
+// wraps a captured frame; takes over the reference
+PyObject* newFrame(CameraObject* owner, FrameRef&& ref) {
+    FrameObject* self = PyObject_New(FrameObject, &FrameType);
+    if (self == nullptr) {
+        return nullptr;
+    }
+    new (&self->ref) FrameRef(std::move(ref));
+    Py_INCREF(owner);
+    self->owner = owner;
+    self->exports = 0;
+    self->release_pending = false;
+    owner->frames++;
+    describe(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+void releaseFrame(FrameObject* self) {
+    if (self->ref) {
+        self->ref.reset();
+        self->owner->frames--;
+    }
+}
+
+// frame
+
+void frameDealloc(PyObject* object) {
+    FrameObject* self = reinterpret_cast<FrameObject*>(object);
+    releaseFrame(self);
+    self->ref.~FrameRef();
+    Py_DECREF(self->owner);
+    PyObject_Free(object);
+}
+
+int frameGetBuffer(PyObject* object, Py_buffer* view, int flags) {
+    FrameObject* self = reinterpret_cast<FrameObject*>(object);
+    if (!self->ref || self->release_pending) {
+        PyErr_SetString(PyExc_BufferError, "the frame was released");
+        return -1;
+    }
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "frames are read-only");
+        return -1;
+    }
+    const Frame& frame = self->ref.frame();
+    view->buf = frame.data;
+    view->obj = object;
+    Py_INCREF(object);
+    view->len = frame.size;
+    view->readonly = 1;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    if ((flags & PyBUF_FORMAT) == PyBUF_FORMAT) {
+        view->format = const_cast<char*>(self->itemsize == 2 ? "H" : "B");
+        view->itemsize = self->itemsize;
+        view->ndim = self->ndim;
+        view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : nullptr;
+        view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : nullptr;
+    } else {
+        // without a format the consumer takes unsigned bytes
+        view->format = nullptr;
+        view->itemsize = 1;
+        view->ndim = 1;
+        view->shape = (flags & PyBUF_ND) == PyBUF_ND ? &view->len : nullptr;
+        view->strides = nullptr;
+    }
+    self->exports++;
+    return 0;
+}
+
+void frameReleaseBuffer(PyObject* object, Py_buffer*) {
+    FrameObject* self = reinterpret_cast<FrameObject*>(object);
+    if (--self->exports == 0 && self->release_pending) {
+        self->release_pending = false;
+        releaseFrame(self);
+    }
+}
+
+PyObject* frameRelease(PyObject* object, PyObject*) {
+    FrameObject* self = reinterpret_cast<FrameObject*>(object);
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "the frame is still viewed, e.g. by a numpy array");
+        return nullptr;
+    }
+    releaseFrame(self);
+    Py_RETURN_NONE;
+}
+
+PyObject* frameEnter(PyObject* object, PyObject*) {
+    Py_INCREF(object);
+    return object;
+}
+
+// unlike `release()`, never fails: with views alive the release is left to the last of them
+PyObject* frameExit(PyObject* object, PyObject*) {
+    FrameObject* self = reinterpret_cast<FrameObject*>(object);
+    if (self->exports > 0) {
+        self->release_pending = true;
+    } else {
+        releaseFrame(self);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* frameField(PyObject* object, void* closure) {
+    FrameObject* self = reinterpret_cast<FrameObject*>(object);
+    const intptr_t field = reinterpret_cast<intptr_t>(closure);
+    if (field == 0) {
+        return PyBool_FromLong(!self->ref);
+    }
+    if (!self->ref || self->release_pending) {
+        PyErr_SetString(PyExc_ValueError, "the frame was released");
+        return nullptr;
+    }
+    const Frame& frame = self->ref.frame();
+    switch (field) {
+        case 1:
+            return PyLong_FromUnsignedLong(frame.seq);
+        case 2:
+            return PyLong_FromUnsignedLongLong(frame.timestamp);
+        case 3:
+            return PyLong_FromUnsignedLong(frame.format.width);
+        case 4:
+            return PyLong_FromUnsignedLong(frame.format.height);
+        case 5:
+            return PyLong_FromUnsignedLong(frame.format.bit_width);
+        case 6:
+            return PyLong_FromUnsignedLong(frame.format.format);
+        default:
+            return PyLong_FromUnsignedLong(frame.size);
+    }
+}
+
+PyMethodDef frameMethods[] = {
+    {"release", frameRelease, METH_NOARGS, "Returns the buffer to the camera now. Fails while a view is alive."},
+    {"__enter__", frameEnter, METH_NOARGS, nullptr},
+    {"__exit__", frameExit, METH_VARARGS, nullptr},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef frameFields[] = {
+    {"released", frameField, nullptr, "True once the buffer went back to the camera.", reinterpret_cast<void*>(0)},
+    {"seq", frameField, nullptr, "The sequence number.", reinterpret_cast<void*>(1)},
+    {"timestamp", frameField, nullptr, "The timestamp, see ArducamImageFrame::timestamp.", reinterpret_cast<void*>(2)},
+    {"width", frameField, nullptr, "The width in pixels.", reinterpret_cast<void*>(3)},
+    {"height", frameField, nullptr, "The height in pixels.", reinterpret_cast<void*>(4)},
+    {"bit_width", frameField, nullptr, "The bits per sample.", reinterpret_cast<void*>(5)},
+    {"format", frameField, nullptr, "The format, the mode in the high 8 bits.", reinterpret_cast<void*>(6)},
+    {"size", frameField, nullptr, "The size of the data in bytes.", reinterpret_cast<void*>(7)},
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyBufferProcs frameBuffer = {frameGetBuffer, frameReleaseBuffer};
+
+// camera
+
+PyObject* cameraNew(PyTypeObject* type, PyObject*, PyObject*) {
+    CameraObject* self = reinterpret_cast<CameraObject*>(type->tp_alloc(type, 0));
+    if (self == nullptr) {
+        return nullptr;
+    }
+    self->camera = new (std::nothrow) Camera();
+    if (self->camera == nullptr) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+void cameraDealloc(PyObject* object) {
+    CameraObject* self = reinterpret_cast<CameraObject*>(object);
+    // every frame holds a reference, so none is left here
+    if (self->camera != nullptr) {
+        Py_BEGIN_ALLOW_THREADS;
+        delete self->camera;
+        Py_END_ALLOW_THREADS;
+    }
+    Py_TYPE(object)->tp_free(object);
+}
+
+// runs `fn()` without the GIL
+template <typename Fn>
+bool unlocked(CameraObject* self, Fn&& fn) {
+    bool ok;
+    self->active++;
+    Py_BEGIN_ALLOW_THREADS;
+    ok = fn();
+    Py_END_ALLOW_THREADS;
+    self->active--;
+    return ok;
+}
+
+PyObject* cameraOpen(PyObject* object, PyObject* args, PyObject* kwargs) {
+    CameraObject* self = reinterpret_cast<CameraObject*>(object);
+    static const char* keywords[] = {"config_file", "ext_config_file", "bin_config", "mem_type", nullptr};
+    const char* config = nullptr;
+    const char* ext_config = nullptr;
+    int bin_config = 0;
+    int mem_type = DMA;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zzpi", const_cast<char**>(keywords), &config, &ext_config,
+                                     &bin_config, &mem_type)) {
+        return nullptr;
+    }
+    const std::string config_file = config != nullptr ? config : "";
+    const std::string ext_config_file = ext_config != nullptr ? ext_config : "";
+    Param param;
+    param.config_file_name = config != nullptr ? config_file.c_str() : nullptr;
+    param.ext_config_file_name = ext_config != nullptr ? ext_config_file.c_str() : nullptr;
+    param.bin_config = bin_config != 0;
+    param.mem_type = static_cast<ArducamMemType>(mem_type);
+    return PyBool_FromLong(unlocked(self, [&] { return self->camera->open(param); }));
+}
+
+// `init()`, `start()` and `stop()`
+template <bool (Camera::*Call)()>
+PyObject* cameraCall(PyObject* object, PyObject*) {
+    CameraObject* self = reinterpret_cast<CameraObject*>(object);
+    return PyBool_FromLong(unlocked(self, [&] { return (self->camera->*Call)(); }));
+}
+
+PyObject* cameraClose(PyObject* object, PyObject*) {
+    CameraObject* self = reinterpret_cast<CameraObject*>(object);
+    if (self->frames > 0 || self->active > 0) {
+        PyErr_Format(PyExc_RuntimeError, "%zd frames are still held and %zd calls running, release them first",
+                     self->frames, self->active);
+        return nullptr;
+    }
+    return PyBool_FromLong(unlocked(self, [&] { return self->camera->close(); }));
+}
+
+PyObject* cameraWaitCapture(PyObject* object, PyObject* args, PyObject* kwargs) {
+    CameraObject* self = reinterpret_cast<CameraObject*>(object);
+    static const char* keywords[] = {"timeout", nullptr};
+    int timeout = 1500;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|i", const_cast<char**>(keywords), &timeout)) {
+        return nullptr;
+    }
+    return PyBool_FromLong(unlocked(self, [&] { return self->camera->waitCapture(timeout); }));
+}
+
+PyObject* cameraCapture(PyObject* object, PyObject* args, PyObject* kwargs) {
+    CameraObject* self = reinterpret_cast<CameraObject*>(object);
+    static const char* keywords[] = {"timeout", nullptr};
+    int timeout = 1500;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|i", const_cast<char**>(keywords), &timeout)) {
+        return nullptr;
+    }
+    FrameRef ref;
+    if (!unlocked(self, [&] { return captureRef(*self->camera, ref, timeout); })) {
+        Py_RETURN_NONE;
+    }
+    return newFrame(self, std::move(ref));
+}
+
+PyObject* cameraCaptureBatch(PyObject* object, PyObject* args, PyObject* kwargs) {
+    CameraObject* self = reinterpret_cast<CameraObject*>(object);
+    static const char* keywords[] = {"count", "timeout", nullptr};
+    Py_ssize_t count = 0;
+    int timeout = 1500;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|i", const_cast<char**>(keywords), &count, &timeout)) {
+        return nullptr;
+    }
+    if (count < 0) {
+        PyErr_SetString(PyExc_ValueError, "count must not be negative");
+        return nullptr;
+    }
+    // one release of the GIL for the whole batch. The SDK does not report its buffer count, so a batch larger than
+    // the free buffers cannot be refused up front: the capture after the last free buffer times out
+    std::vector<FrameRef> refs(static_cast<size_t>(count));
+    size_t captured = 0;
+    unlocked(self, [&] {
+        while (captured < refs.size() && captureRef(*self->camera, refs[captured], timeout)) {
+            captured++;
+        }
+        return true;
+    });
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(captured));
+    if (list == nullptr) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < captured; i++) {
+        PyObject* frame = newFrame(self, std::move(refs[i]));
+        if (frame == nullptr) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), frame);
+    }
+    return list;
+}
+
+PyObject* cameraLastError(PyObject* object, PyObject*) {
+    return PyLong_FromLong(reinterpret_cast<CameraObject*>(object)->camera->lastError());
+}
+
+PyObject* cameraFrames(PyObject* object, void*) {
+    return PyLong_FromSsize_t(reinterpret_cast<CameraObject*>(object)->frames);
+}
+
+PyMethodDef cameraMethods[] = {
+    {"open", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(cameraOpen)), METH_VARARGS | METH_KEYWORDS,
+     "open(config_file=None, ext_config_file=None, bin_config=False, mem_type=DMA) -> bool"},
+    {"init", cameraCall<&Camera::init>, METH_NOARGS, "init() -> bool"},
+    {"start", cameraCall<&Camera::start>, METH_NOARGS, "start() -> bool"},
+    {"stop", cameraCall<&Camera::stop>, METH_NOARGS, "stop() -> bool"},
+    {"close", cameraClose, METH_NOARGS, "close() -> bool. Fails while frames are held."},
+    {"wait_capture", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(cameraWaitCapture)),
+     METH_VARARGS | METH_KEYWORDS, "wait_capture(timeout=1500) -> bool, without the GIL"},
+    {"capture", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(cameraCapture)),
+     METH_VARARGS | METH_KEYWORDS, "capture(timeout=1500) -> Frame or None on timeout, without the GIL"},
+    {"capture_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(cameraCaptureBatch)),
+     METH_VARARGS | METH_KEYWORDS,
+     "capture_batch(count, timeout=1500) -> list of Frame, one GIL release. Every frame of the batch holds its "
+     "SDK buffer until the call returns: count plus frames_held must not exceed the buffers of the camera, or the "
+     "call waits out the timeout and returns the frames that fit."},
+    {"last_error", cameraLastError, METH_NOARGS, "last_error() -> int, the ArducamErrorCode of the last call"},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef cameraFields[] = {
+    {"frames_held", cameraFrames, nullptr, "The number of frames not yet returned to the camera.", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyModuleDef moduleDef = {PyModuleDef_HEAD_INIT, "arducam_native",
+                         "Arducam::Camera with zero-copy, read-only buffer-protocol frames.",
+                         -1,
+                         nullptr,
+                         nullptr,
+                         nullptr,
+                         nullptr,
+                         nullptr};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_arducam_native() {
+    FrameType.ob_base = PyVarObject{PyObject_HEAD_INIT(nullptr) 0};
+    FrameType.tp_name = "arducam_native.Frame";
+    FrameType.tp_basicsize = sizeof(FrameObject);
+    FrameType.tp_dealloc = frameDealloc;
+    FrameType.tp_as_buffer = &frameBuffer;
+    FrameType.tp_flags = Py_TPFLAGS_DEFAULT;
+    FrameType.tp_doc = "A captured frame backed by the SDK buffer. Read-only, supports the buffer protocol.";
+    FrameType.tp_methods = frameMethods;
+    FrameType.tp_getset = frameFields;
+
+    CameraType.ob_base = PyVarObject{PyObject_HEAD_INIT(nullptr) 0};
+    CameraType.tp_name = "arducam_native.Camera";
+    CameraType.tp_basicsize = sizeof(CameraObject);
+    CameraType.tp_dealloc = cameraDealloc;
+    CameraType.tp_flags = Py_TPFLAGS_DEFAULT;
+    CameraType.tp_doc = "An Arducam camera.";
+    CameraType.tp_methods = cameraMethods;
+    CameraType.tp_getset = cameraFields;
+    CameraType.tp_new = cameraNew;
+
+    if (PyType_Ready(&FrameType) < 0 || PyType_Ready(&CameraType) < 0) {
+        return nullptr;
+    }
+    PyObject* module = PyModule_Create(&moduleDef);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(&CameraType);
+    Py_INCREF(&FrameType);
+    if (PyModule_AddObject(module, "Camera", reinterpret_cast<PyObject*>(&CameraType)) < 0 ||
+        PyModule_AddObject(module, "Frame", reinterpret_cast<PyObject*>(&FrameType)) < 0 ||
+        PyModule_AddIntConstant(module, "DMA", DMA) < 0 || PyModule_AddIntConstant(module, "RAM", RAM) < 0) {
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
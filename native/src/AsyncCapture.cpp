@@ -0,0 +1,169 @@
+#include <arducam/AsyncCapture.hpp>
+
+#include "Common.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#endif
+
+namespace Arducam {
+
+namespace {
+
+// how long the handle stays signalled for a frame whose `FrameEnd` event came ahead of it
+constexpr uint64_t kFrameEndWaitUs = 2000;
+
+}  // namespace
+
+AsyncCapture::AsyncCapture(Camera& camera, EventDispatcher& events) : camera_(camera), events_(events) {
+#if defined(_WIN32)
+    // manual reset, so that every wait sees the handle signalled until `poll()` clears it
+    handle_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    valid_ = handle_ != nullptr;
+#elif defined(__linux__)
+    handle_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    valid_ = handle_ >= 0;
+#else
+    int fds[2];
+    valid_ = pipe(fds) == 0;
+    handle_ = valid_ ? fds[0] : -1;
+    write_fd_ = valid_ ? fds[1] : -1;
+    for (int fd : {handle_, write_fd_}) {
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+#endif
+    if (valid_) {
+        listener_ = events_.addListener([this](EventCode event) {
+            if (event == EventCode::FrameEnd) {
+                pending_.fetch_add(1, std::memory_order_relaxed);
+                signal();
+            }
+        });
+    }
+}
+
+AsyncCapture::~AsyncCapture() {
+    if (listener_ >= 0) {
+        events_.removeListener(listener_);
+    }
+#if defined(_WIN32)
+    if (handle_ != nullptr) {
+        CloseHandle(handle_);
+    }
+#else
+    if (handle_ >= 0) {
+        close(handle_);
+    }
+#if !defined(__linux__)
+    if (write_fd_ >= 0) {
+        close(write_fd_);
+    }
+#endif
+#endif
+}
+
+void AsyncCapture::signal() {
+    // one write until the loop has seen it, however many events arrive meanwhile
+    if (signalled_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+#if defined(_WIN32)
+    SetEvent(handle_);
+#elif defined(__linux__)
+    const uint64_t one = 1;
+    ssize_t written = write(handle_, &one, sizeof(one));
+    (void)written;
+#else
+    const char one = 1;
+    ssize_t written = write(write_fd_, &one, sizeof(one));
+    (void)written;
+#endif
+}
+
+void AsyncCapture::clear() {
+    // the handle is drained before the flag is reset: an event in between finds the flag still set and skips its
+    // write, but its frame is counted in `pending_`, which is read after this
+#if defined(_WIN32)
+    ResetEvent(handle_);
+#elif defined(__linux__)
+    uint64_t count;
+    ssize_t read_bytes = read(handle_, &count, sizeof(count));
+    (void)read_bytes;
+#else
+    char buffer[64];
+    while (read(handle_, buffer, sizeof(buffer)) > 0) {
+    }
+#endif
+    signalled_.store(false, std::memory_order_release);
+}
+
+bool AsyncCapture::tryCapture(FrameRef& ref) {
+    ref.reset();
+    // the count is checked first, so that an empty queue never waits in `capture()`
+    if (camera_.getAvailCount() <= 0 || !captureRef(camera_, ref, 0)) {
+        return false;
+    }
+    credit_--;
+    return true;
+}
+
+size_t AsyncCapture::poll() {
+    if (!valid_) {
+        return 0;
+    }
+    clear();
+    credit_ += pending_.exchange(0, std::memory_order_relaxed);
+
+    size_t resumed = 0;
+    while (!waiters_.empty()) {
+        Waiter waiter = waiters_.front();
+        if (!tryCapture(*waiter.ref)) {
+            break;
+        }
+        // popped before resuming: the coroutine may wait for the next frame right away
+        waiters_.pop_front();
+        waiter.resume(waiter.coroutine);
+        resumed++;
+    }
+
+    if (credit_ > 0 && camera_.getAvailCount() <= 0) {
+        // an event came ahead of its frame, which is still on its way to the output queue
+        const uint64_t now = detail::nowUs();
+        if (credit_since_us_ == 0) {
+            credit_since_us_ = now;
+        }
+        if (now - credit_since_us_ < kFrameEndWaitUs) {
+            signal();
+        } else {
+            // the frame was dropped by the SDK
+            credit_ = 0;
+            credit_since_us_ = 0;
+        }
+    } else {
+        credit_since_us_ = 0;
+    }
+    return resumed;
+}
+
+void AsyncCapture::cancel() {
+    std::deque<Waiter> waiters;
+    waiters.swap(waiters_);
+    for (Waiter& waiter : waiters) {
+        waiter.ref->reset();
+        waiter.resume(waiter.coroutine);
+    }
+}
+
+}  // namespace Arducam
@@ -0,0 +1,445 @@
+#include <arducam/BatchProcessor.hpp>
+
+#include <arducam/ImageIO.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Common.hpp"
+
+namespace Arducam {
+
+namespace {
+
+enum class Stage : uint8_t { Decode, Correct, Encode };
+
+// the file an encode task writes
+enum Part : uint8_t { kLeft = 0, kRight = 1, kCombined = 2 };
+
+struct Task {
+    size_t slot;
+    // the camera of a decode or correct task, the file of an encode task
+    uint8_t part;
+};
+
+// one pair in flight
+struct Slot {
+    size_t input = 0;
+    DngImage dng[2];
+    Frame frames[2]{};
+    uint32_t width[2] = {0, 0};
+    uint32_t height[2] = {0, 0};
+    // both corrected images side by side
+    std::vector<uint8_t> combined;
+    size_t stride = 0;
+    // tasks of the current stage still running
+    int pending = 0;
+    bool ok = true;
+};
+
+class BatchRun {
+   public:
+    BatchRun(const BatchOptions& options, const std::vector<BatchInput>& inputs,
+             const BatchProcessor::Progress& progress)
+        : options_(options), inputs_(inputs), progress_(progress) {
+        output_ = options_.format == BatchFormat::Tiff16 ? OutputFormat::Rgb16 : OutputFormat::Rgb8;
+        pixel_size_ = outputPixelSize(output_);
+    }
+
+    BatchResult run() {
+        const uint64_t start = detail::nowUs();
+        size_t threads = options_.threads;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const size_t in_flight = options_.in_flight != 0 ? options_.in_flight : threads / 2 + 1;
+        slots_.resize(std::min(in_flight, std::max<size_t>(inputs_.size(), 1)));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < slots_.size(); i++) {
+                startPair(i);
+            }
+        }
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back(&BatchRun::work, this);
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        result_.decode_us = decode_us_.load();
+        result_.correct_us = correct_us_.load();
+        result_.encode_us = encode_us_.load();
+        result_.seconds = static_cast<double>(detail::nowUs() - start) * 1e-6;
+        return result_;
+    }
+
+   private:
+    // with `mutex_` held: assigns the next input to a slot
+    void startPair(size_t index) {
+        if (next_input_ >= inputs_.size()) {
+            return;
+        }
+        Slot& slot = slots_[index];
+        slot.input = next_input_++;
+        slot.ok = true;
+        slot.pending = 2;
+        decode_.push_back(Task{index, kLeft});
+        decode_.push_back(Task{index, kRight});
+    }
+
+    void work() {
+        std::vector<uint8_t> image;
+        std::vector<uint16_t> scratch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [&] {
+                return finished_ == inputs_.size() || !encode_.empty() || !correct_.empty() || !decode_.empty();
+            });
+            Stage stage;
+            Task task;
+            // the most advanced task first, so that pairs leave their slots as early as possible
+            if (!encode_.empty()) {
+                stage = Stage::Encode;
+                task = encode_.front();
+                encode_.pop_front();
+            } else if (!correct_.empty()) {
+                stage = Stage::Correct;
+                task = correct_.front();
+                correct_.pop_front();
+            } else if (!decode_.empty()) {
+                stage = Stage::Decode;
+                task = decode_.front();
+                decode_.pop_front();
+            } else {
+                return;
+            }
+            lock.unlock();
+
+            Slot& slot = slots_[task.slot];
+            bool ok;
+            const uint64_t begin = detail::nowUs();
+            switch (stage) {
+                case Stage::Decode:
+                    ok = decode(slot, task.part);
+                    decode_us_ += detail::nowUs() - begin;
+                    break;
+                case Stage::Correct:
+                    ok = correct(slot, task.part, image, scratch);
+                    correct_us_ += detail::nowUs() - begin;
+                    break;
+                default:
+                    ok = encode(slot, task.part);
+                    encode_us_ += detail::nowUs() - begin;
+                    break;
+            }
+
+            lock.lock();
+            slot.ok = slot.ok && ok;
+            if (--slot.pending == 0) {
+                // the last task of a stage moves the pair on; the slot is not touched by anyone else meanwhile
+                lock.unlock();
+                const bool done = advance(task.slot, stage);
+                lock.lock();
+                if (done) {
+                    finish(task.slot, lock);
+                }
+                cv_.notify_all();
+            }
+        }
+    }
+
+    bool decode(Slot& slot, uint8_t camera) {
+        const BatchInput& input = inputs_[slot.input];
+        if (options_.recording != nullptr) {
+            return options_.recording->frame(camera == kLeft ? input.left_frame : input.right_frame,
+                                             slot.frames[camera]);
+        }
+        if (!readDng(camera == kLeft ? input.left_path : input.right_path, slot.dng[camera])) {
+            return false;
+        }
+        slot.frames[camera] = slot.dng[camera].frame;
+        return true;
+    }
+
+    bool correct(Slot& slot, uint8_t camera, std::vector<uint8_t>& image, std::vector<uint16_t>& scratch) {
+        const Frame& frame = slot.frames[camera];
+        std::shared_ptr<const RemapLut> lut = lutFor(camera, frame.format.width, frame.format.height);
+        if (lut == nullptr) {
+            return false;
+        }
+        ConvertOptions convert;
+        convert.output = output_;
+        convert.method = options_.method;
+        if (options_.black_level >= 0) {
+            convert.black_level = static_cast<uint16_t>(options_.black_level);
+        } else if (options_.recording == nullptr) {
+            convert.black_level = slot.dng[camera].black_level;
+        }
+        const size_t image_stride = frame.format.width * pixel_size_;
+        image.resize(image_stride * frame.format.height);
+        scratch.resize(convertScratchSize(frame.format));
+        if (!convertFrame(frame, convert, image.data(), image_stride, scratch.data())) {
+            return false;
+        }
+        uint8_t* dst = slot.combined.data() + (camera == kLeft ? 0 : slot.width[kLeft] * pixel_size_);
+        return lut->apply(output_, image.data(), image_stride, dst, slot.stride);
+    }
+
+    bool encode(Slot& slot, uint8_t part) {
+        const BatchInput& input = inputs_[slot.input];
+        static const char* const kSuffixes[] = {"_left", "_right", "_combined"};
+        const char* extension = options_.format == BatchFormat::Jpeg ? ".jpg" : ".tiff";
+        const std::string path = options_.output_directory + "/" + input.name + kSuffixes[part] + extension;
+
+        const uint8_t* data = slot.combined.data();
+        uint32_t width = slot.width[kLeft] + slot.width[kRight];
+        uint32_t height = std::min(slot.height[kLeft], slot.height[kRight]);
+        if (part != kCombined) {
+            data += part == kLeft ? 0 : slot.width[kLeft] * pixel_size_;
+            width = slot.width[part];
+            height = slot.height[part];
+        }
+        bool ok;
+        if (options_.format == BatchFormat::Jpeg) {
+            ok = writeJpeg(path, output_, width, height, data, slot.stride, options_.quality);
+        } else {
+            ok = writeTiff(path, output_, width, height, data, slot.stride, slot.frames[kLeft].format.bit_width);
+        }
+        if (ok) {
+            files_++;
+        }
+        return ok;
+    }
+
+    // queues the next stage of a pair, returns `true` if the pair is done
+    bool advance(size_t index, Stage stage) {
+        Slot& slot = slots_[index];
+        if (!slot.ok) {
+            return true;
+        }
+        if (stage == Stage::Decode) {
+            for (int camera = 0; camera < 2; camera++) {
+                const Frame& frame = slot.frames[camera];
+                if (!correctedSize(camera == kLeft ? options_.left : options_.right, frame.format.width,
+                                   frame.format.height, slot.width[camera], slot.height[camera])) {
+                    slot.ok = false;
+                    return true;
+                }
+            }
+            slot.stride = (slot.width[kLeft] + slot.width[kRight]) * pixel_size_;
+            slot.combined.resize(slot.stride * std::max(slot.height[kLeft], slot.height[kRight]));
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.pending = 2;
+            correct_.push_back(Task{index, kLeft});
+            correct_.push_back(Task{index, kRight});
+            return false;
+        }
+        if (stage == Stage::Correct) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.pending = 0;
+            if (options_.save_individual) {
+                encode_.push_back(Task{index, kLeft});
+                encode_.push_back(Task{index, kRight});
+                slot.pending += 2;
+            }
+            if (options_.save_combined) {
+                encode_.push_back(Task{index, kCombined});
+                slot.pending++;
+            }
+            return slot.pending == 0;
+        }
+        return true;
+    }
+
+    // with `mutex_` held: reports a pair and reuses its slot
+    void finish(size_t index, std::unique_lock<std::mutex>& lock) {
+        Slot& slot = slots_[index];
+        const size_t input = slot.input;
+        const bool ok = slot.ok;
+        if (ok) {
+            result_.pairs++;
+        } else {
+            result_.failed++;
+        }
+        result_.files = files_.load();
+        const size_t done = ++finished_;
+        startPair(index);
+        if (progress_) {
+            lock.unlock();
+            progress_(done, inputs_.size(), inputs_[input], ok);
+            lock.lock();
+        }
+    }
+
+    std::shared_ptr<const RemapLut> lutFor(uint8_t camera, uint32_t width, uint32_t height) {
+        std::lock_guard<std::mutex> lock(lut_mutex_[camera]);
+        std::shared_ptr<const RemapLut>& lut = luts_[camera];
+        if (lut == nullptr || lut->srcWidth() != width || lut->srcHeight() != height) {
+            // built once per camera and size; a pair of another size gets a new table, the old one stays alive for
+            // the tasks still using it
+            auto built = std::make_shared<RemapLut>();
+            if (!built->build(camera == kLeft ? options_.left : options_.right, width, height)) {
+                return nullptr;
+            }
+            lut = std::move(built);
+        }
+        return lut;
+    }
+
+    const BatchOptions& options_;
+    const std::vector<BatchInput>& inputs_;
+    const BatchProcessor::Progress& progress_;
+    OutputFormat output_;
+    size_t pixel_size_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Slot> slots_;
+    std::deque<Task> decode_;
+    std::deque<Task> correct_;
+    std::deque<Task> encode_;
+    size_t next_input_ = 0;
+    size_t finished_ = 0;
+    BatchResult result_;
+
+    std::mutex lut_mutex_[2];
+    std::shared_ptr<const RemapLut> luts_[2];
+
+    std::atomic<size_t> files_{0};
+    std::atomic<uint64_t> decode_us_{0};
+    std::atomic<uint64_t> correct_us_{0};
+    std::atomic<uint64_t> encode_us_{0};
+};
+
+std::string lower(std::string text) {
+    for (char& c : text) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return text;
+}
+
+// removes the first of `words` from `name`, returns `false` if there is none
+bool eraseWord(const std::string& name, std::initializer_list<const char*> words, std::string& rest) {
+    const std::string folded = lower(name);
+    for (const char* word : words) {
+        const size_t at = folded.find(word);
+        if (at != std::string::npos) {
+            rest = name.substr(0, at) + name.substr(at + std::char_traits<char>::length(word));
+            return true;
+        }
+    }
+    return false;
+}
+
+// the pair name from the rest of a file name: without extension, separators at the ends and doubled separators
+std::string pairName(std::string rest) {
+    const size_t dot = rest.rfind('.');
+    if (dot != std::string::npos) {
+        rest.erase(dot);
+    }
+    std::string name;
+    for (char c : rest) {
+        const bool separator = c == '_' || c == '-' || c == ' ';
+        if (separator && (name.empty() || name.back() == '_')) {
+            continue;
+        }
+        name.push_back(separator ? '_' : c);
+    }
+    while (!name.empty() && name.back() == '_') {
+        name.pop_back();
+    }
+    return name.empty() ? "pair" : name;
+}
+
+}  // namespace
+
+BatchProcessor::BatchProcessor(const BatchOptions& options) : options_(options) {}
+
+BatchResult BatchProcessor::run(const std::vector<BatchInput>& inputs, const Progress& progress) {
+    if (options_.format == BatchFormat::Jpeg && !jpegSupported()) {
+        BatchResult result;
+        result.failed = inputs.size();
+        return result;
+    }
+    if (inputs.empty()) {
+        return BatchResult();
+    }
+    BatchRun run(options_, inputs, progress);
+    return run.run();
+}
+
+bool findDngPairs(const std::string& directory, std::vector<BatchInput>& inputs) {
+    inputs.clear();
+    std::vector<std::string> names;
+    if (!listFiles(directory, ".dng", names)) {
+        return false;
+    }
+    std::map<std::string, std::string> lefts;
+    std::map<std::string, std::string> rights;
+    std::string rest;
+    for (const std::string& name : names) {
+        if (eraseWord(name, {"cam0", "left"}, rest)) {
+            lefts.emplace(rest, name);
+        } else if (eraseWord(name, {"cam1", "right"}, rest)) {
+            rights.emplace(rest, name);
+        }
+    }
+    for (const auto& left : lefts) {
+        const auto right = rights.find(left.first);
+        if (right == rights.end()) {
+            continue;
+        }
+        BatchInput input;
+        input.name = pairName(left.first);
+        input.left_path = directory + "/" + left.second;
+        input.right_path = directory + "/" + right->second;
+        inputs.push_back(std::move(input));
+    }
+    std::sort(inputs.begin(), inputs.end(),
+              [](const BatchInput& a, const BatchInput& b) { return a.name < b.name; });
+    return true;
+}
+
+void recordingPairs(const RawReader& reader, std::vector<BatchInput>& inputs) {
+    inputs.clear();
+    std::vector<size_t> streams[2];
+    for (size_t i = 0; i < reader.frameCount(); i++) {
+        const uint8_t stream = reader.entry(i).stream;
+        if (stream < 2) {
+            streams[stream].push_back(i);
+        }
+    }
+    auto distance = [&](size_t a, size_t b) {
+        const uint64_t ta = reader.entry(a).timestamp;
+        const uint64_t tb = reader.entry(b).timestamp;
+        return ta > tb ? ta - tb : tb - ta;
+    };
+    const std::vector<size_t>& rights = streams[1];
+    size_t r = 0;
+    for (size_t left : streams[0]) {
+        while (r + 1 < rights.size() && distance(left, rights[r + 1]) <= distance(left, rights[r])) {
+            r++;
+        }
+        if (r >= rights.size()) {
+            break;
+        }
+        BatchInput input;
+        input.name = "pair_" + std::to_string(left);
+        input.left_frame = left;
+        input.right_frame = rights[r];
+        inputs.push_back(std::move(input));
+        // each right frame is used once
+        r++;
+    }
+}
+
+}  // namespace Arducam
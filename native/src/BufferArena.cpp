@@ -0,0 +1,278 @@
+#include <arducam/BufferArena.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Arducam {
+
+namespace {
+
+size_t pageSize() {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+size_t roundUp(size_t value, size_t multiple) { return (value + multiple - 1) / multiple * multiple; }
+
+// huge page mappings must be a multiple of the huge page size, 2 MiB on x86-64 and on AArch64 with 4 KiB pages
+constexpr size_t kHugePageSize = 2 << 20;
+
+uint8_t* mapMemory(size_t& size, bool& huge_pages) {
+#if defined(_WIN32)
+    if (huge_pages) {
+        // large pages need SeLockMemoryPrivilege, without it the call fails and normal pages are used
+        const size_t large = GetLargePageMinimum();
+        if (large != 0) {
+            const size_t large_size = roundUp(size, large);
+            void* p = VirtualAlloc(nullptr, large_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (p != nullptr) {
+                size = large_size;
+                return static_cast<uint8_t*>(p);
+            }
+        }
+        huge_pages = false;
+    }
+    return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+    if (huge_pages) {
+#if defined(MAP_HUGETLB)
+        const size_t huge_size = roundUp(size, kHugePageSize);
+        void* p = mmap(nullptr, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            size = huge_size;
+            return static_cast<uint8_t*>(p);
+        }
+#endif
+        huge_pages = false;
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+#if defined(MADV_HUGEPAGE)
+    // no reserved huge pages: ask for transparent ones, which is a hint the kernel may ignore
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+    return static_cast<uint8_t*>(p);
+#endif
+}
+
+void unmapMemory(uint8_t* base, size_t size) {
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    munmap(base, size);
+#endif
+}
+
+bool lockMemory(uint8_t* base, size_t size) {
+#if defined(_WIN32)
+    return VirtualLock(base, size) != 0;
+#else
+    return mlock(base, size) == 0;
+#endif
+}
+
+void unlockMemory(uint8_t* base, size_t size) {
+#if defined(_WIN32)
+    VirtualUnlock(base, size);
+#else
+    munlock(base, size);
+#endif
+}
+
+}  // namespace
+
+std::shared_ptr<BufferArena> BufferArena::create(const ArenaOptions& options) {
+    if (options.block_size == 0 || options.block_count == 0 || options.block_count > UINT32_MAX) {
+        return nullptr;
+    }
+    const size_t block_size = roundUp(options.block_size, pageSize());
+    size_t mapped_size = block_size * options.block_count;
+    bool huge_pages = options.huge_pages;
+    uint8_t* base = mapMemory(mapped_size, huge_pages);
+    if (base == nullptr) {
+        return nullptr;
+    }
+    bool pinned = options.pinned && lockMemory(base, mapped_size);
+    if (!pinned) {
+        // touch every page now so that the first frames do not pay for the page faults
+        const size_t step = huge_pages ? kHugePageSize : pageSize();
+        for (size_t offset = 0; offset < mapped_size; offset += step) {
+            base[offset] = 0;
+        }
+    }
+    return std::shared_ptr<BufferArena>(
+        new BufferArena(base, block_size, options.block_count, mapped_size, huge_pages, pinned));
+}
+
+BufferArena::BufferArena(uint8_t* base, size_t block_size, size_t block_count, size_t mapped_size, bool huge_pages,
+                         bool pinned)
+    : base_(base),
+      block_size_(block_size),
+      block_count_(block_count),
+      mapped_size_(mapped_size),
+      huge_pages_(huge_pages),
+      pinned_(pinned),
+      free_(2 * block_count) {
+    for (uint32_t i = 0; i < block_count; i++) {
+        free_.tryPush(i);
+    }
+}
+
+BufferArena::~BufferArena() {
+    if (pinned_) {
+        unlockMemory(base_, mapped_size_);
+    }
+    unmapMemory(base_, mapped_size_);
+}
+
+bool BufferArena::contains(const void* p) const {
+    const uint8_t* b = static_cast<const uint8_t*>(p);
+    return b >= base_ && b < base_ + block_size_ * block_count_;
+}
+
+uint8_t* BufferArena::acquire() {
+    uint32_t index;
+    if (!free_.tryPop(index)) {
+        return nullptr;
+    }
+    return base_ + index * block_size_;
+}
+
+void BufferArena::release(const uint8_t* block) {
+    if (block == nullptr || !contains(block)) {
+        return;
+    }
+    uint32_t index = static_cast<uint32_t>((block - base_) / block_size_);
+    // the queue has room for twice the blocks, so a push only fails while the cell it needs is still being read by a
+    // preempted tryPop() in acquire(), which is about to finish
+    while (!free_.tryPush(index)) {
+        std::this_thread::yield();
+    }
+}
+
+void BufferArena::releaseBlock(void* owner, const Frame& frame) {
+    static_cast<BufferArena*>(owner)->release(frame.data);
+}
+
+FrameRef BufferArena::wrapBlock(uint8_t* block, Frame frame) {
+    frame.data = block;
+    return FrameRef::wrap(frame, this, &BufferArena::releaseBlock);
+}
+
+bool BufferArena::copyFrame(const Frame& frame, FrameRef& ref) {
+    ref.reset();
+    if (frame.data == nullptr || frame.size > block_size_) {
+        return false;
+    }
+    uint8_t* block = acquire();
+    if (block == nullptr) {
+        return false;
+    }
+    std::memcpy(block, frame.data, frame.size);
+    ref = wrapBlock(block, frame);
+    return true;
+}
+
+size_t modeFrameSize(const ArducamCameraConfig& config) {
+    return static_cast<size_t>(config.width) * config.height * ((config.bit_width + 7) / 8);
+}
+
+namespace {
+
+bool listModes(const Camera& camera, std::vector<uint32_t>& ids, std::vector<ArducamCameraConfig>& configs) {
+    const uint32_t count = camera.modeSize();
+    ids.resize(count);
+    configs.resize(count);
+    return count != 0 && camera.listMode(ids.data(), configs.data());
+}
+
+bool sameMode(const ArducamCameraConfig& a, const ArducamCameraConfig& b) {
+    return a.width == b.width && a.height == b.height && a.bit_width == b.bit_width && a.format == b.format;
+}
+
+bool applyTransferConfig(Camera& camera, const TransferConfig& config) {
+    return camera.setTransfer(config.transfer_count, config.buffer_size) && camera.setMemType(config.mem_type);
+}
+
+}  // namespace
+
+size_t largestModeSize(const Camera& camera) {
+    std::vector<uint32_t> ids;
+    std::vector<ArducamCameraConfig> configs;
+    if (!listModes(camera, ids, configs)) {
+        return 0;
+    }
+    size_t largest = 0;
+    for (const auto& config : configs) {
+        largest = std::max(largest, modeFrameSize(config));
+    }
+    return largest;
+}
+
+bool fixTransferConfig(Camera& camera, MemType mem_type, TransferConfig& config) {
+    std::vector<uint32_t> ids;
+    std::vector<ArducamCameraConfig> configs;
+    if (!listModes(camera, ids, configs)) {
+        return false;
+    }
+    const ArducamCameraConfig current = camera.config();
+    size_t largest = 0;
+    size_t current_index = ids.size();
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (modeFrameSize(configs[i]) > modeFrameSize(configs[largest])) {
+            largest = i;
+        }
+        if (current_index == ids.size() && sameMode(configs[i], current)) {
+            current_index = i;
+        }
+    }
+
+    const bool switched = current_index != largest;
+    if (switched && !camera.switchMode(ids[largest])) {
+        return false;
+    }
+    TransferConfig result;
+    result.mem_type = mem_type;
+    if (!camera.setAutoTransfer(true) || !camera.getAutoTransfer(result.transfer_count, result.buffer_size)) {
+        return false;
+    }
+    if (switched && current_index != ids.size() && !camera.switchMode(ids[current_index])) {
+        return false;
+    }
+    if (!applyTransferConfig(camera, result)) {
+        return false;
+    }
+    config = result;
+    return true;
+}
+
+bool switchModeKeepingTransfers(Camera& camera, uint32_t mode_id, const TransferConfig& config, bool restart) {
+    // stopping an already stopped camera is harmless, its result is not needed
+    camera.stop();
+    if (!camera.switchMode(mode_id) || !applyTransferConfig(camera, config)) {
+        return false;
+    }
+    return !restart || camera.start();
+}
+
+}  // namespace Arducam
@@ -0,0 +1,450 @@
+#include <arducam/CalibrationStore.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace Arducam {
+
+namespace {
+
+// the user data address space of `Camera::readUserData()`
+constexpr size_t kUserDataSpace = 65536;
+constexpr uint32_t kMaxTransfer = 255;
+
+// the fields of a camera in a calibration record
+enum FieldTag : uint8_t {
+    kTagEnd = 0,
+    kTagName = 1,
+    kTagSize = 2,
+    kTagCrop = 3,
+    kTagPad = 4,
+    kTagRadial = 5,
+    kTagPerspective = 6,
+    kTagRotation = 7,
+};
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) != 0 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void put16(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void put32(uint8_t* p, uint32_t value) {
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+uint16_t get16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+uint32_t get32(const uint8_t* p) { return get16(p) | (static_cast<uint32_t>(get16(p + 2)) << 16); }
+
+class FieldWriter {
+   public:
+    explicit FieldWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out_.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out_.push_back(static_cast<uint8_t>(value));
+    }
+    void u8(uint8_t value) { out_.push_back(value); }
+    void f64(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            out_.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+        }
+    }
+    void bytes(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        out_.insert(out_.end(), p, p + size);
+    }
+    // writes a field: the tag, the size of the body and the body
+    void field(uint8_t tag, const std::vector<uint8_t>& body) {
+        varint(tag);
+        varint(body.size());
+        bytes(body.data(), body.size());
+    }
+
+   private:
+    std::vector<uint8_t>& out_;
+};
+
+class FieldReader {
+   public:
+    FieldReader(const uint8_t* data, size_t size) : p_(data), end_(data + size) {}
+
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p_ == end_) {
+                return false;
+            }
+            const uint8_t byte = *p_++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    bool u32(uint32_t& value) {
+        uint64_t v;
+        if (!varint(v) || v > UINT32_MAX) {
+            return false;
+        }
+        value = static_cast<uint32_t>(v);
+        return true;
+    }
+    bool u8(uint8_t& value) {
+        if (p_ == end_) {
+            return false;
+        }
+        value = *p_++;
+        return true;
+    }
+    bool f64(double& value) {
+        if (end_ - p_ < 8) {
+            return false;
+        }
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++) {
+            bits |= static_cast<uint64_t>(p_[i]) << (8 * i);
+        }
+        std::memcpy(&value, &bits, sizeof(value));
+        p_ += 8;
+        return true;
+    }
+    // splits off the next `size` bytes
+    bool take(size_t size, FieldReader& body) {
+        if (static_cast<size_t>(end_ - p_) < size) {
+            return false;
+        }
+        body = FieldReader(p_, size);
+        p_ += size;
+        return true;
+    }
+    const uint8_t* data() const { return p_; }
+    size_t left() const { return static_cast<size_t>(end_ - p_); }
+
+   private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+};
+
+void encodeCamera(const CameraCalibration& camera, std::vector<uint8_t>& out) {
+    FieldWriter w(out);
+    std::vector<uint8_t> field;
+    FieldWriter f(field);
+    const CorrectionParams& p = camera.params;
+
+    f.bytes(camera.name.data(), camera.name.size());
+    w.field(kTagName, field);
+    if (camera.width != 0 || camera.height != 0) {
+        field.clear();
+        f.varint(camera.width);
+        f.varint(camera.height);
+        w.field(kTagSize, field);
+    }
+    if (p.crop_x != 0 || p.crop_y != 0 || p.crop_width != 0 || p.crop_height != 0) {
+        field.clear();
+        f.varint(p.crop_x);
+        f.varint(p.crop_y);
+        f.varint(p.crop_width);
+        f.varint(p.crop_height);
+        w.field(kTagCrop, field);
+    }
+    if (p.pad_top != 0 || p.pad_bottom != 0) {
+        field.clear();
+        f.varint(p.pad_top);
+        f.varint(p.pad_bottom);
+        w.field(kTagPad, field);
+    }
+    if (p.radial || !p.coeffs.empty() || p.xcenter != 0 || p.ycenter != 0) {
+        field.clear();
+        f.u8(p.radial ? 1 : 0);
+        f.f64(p.xcenter);
+        f.f64(p.ycenter);
+        f.varint(p.coeffs.size());
+        for (double c : p.coeffs) {
+            f.f64(c);
+        }
+        w.field(kTagRadial, field);
+    }
+    if (p.perspective || std::any_of(p.pers_coef.begin(), p.pers_coef.end(), [](double c) { return c != 0; })) {
+        field.clear();
+        f.u8(p.perspective ? 1 : 0);
+        for (double c : p.pers_coef) {
+            f.f64(c);
+        }
+        w.field(kTagPerspective, field);
+    }
+    if (p.rotation != 0) {
+        field.clear();
+        f.f64(p.rotation);
+        w.field(kTagRotation, field);
+    }
+    w.varint(kTagEnd);
+}
+
+bool decodeCamera(FieldReader& r, CameraCalibration& camera) {
+    camera = CameraCalibration();
+    CorrectionParams& p = camera.params;
+    for (;;) {
+        uint64_t tag;
+        uint64_t size;
+        if (!r.varint(tag)) {
+            return false;
+        }
+        if (tag == kTagEnd) {
+            return true;
+        }
+        FieldReader f(nullptr, 0);
+        if (!r.varint(size) || !r.take(static_cast<size_t>(size), f)) {
+            return false;
+        }
+        bool ok = true;
+        uint8_t enabled = 0;
+        uint64_t count = 0;
+        switch (tag) {
+            case kTagName:
+                camera.name.assign(reinterpret_cast<const char*>(f.data()), f.left());
+                break;
+            case kTagSize:
+                ok = f.u32(camera.width) && f.u32(camera.height);
+                break;
+            case kTagCrop:
+                ok = f.u32(p.crop_x) && f.u32(p.crop_y) && f.u32(p.crop_width) && f.u32(p.crop_height);
+                break;
+            case kTagPad:
+                ok = f.u32(p.pad_top) && f.u32(p.pad_bottom);
+                break;
+            case kTagRadial:
+                ok = f.u8(enabled) && f.f64(p.xcenter) && f.f64(p.ycenter) && f.varint(count) && count <= f.left() / 8;
+                p.radial = enabled != 0;
+                p.coeffs.resize(ok ? static_cast<size_t>(count) : 0);
+                for (double& c : p.coeffs) {
+                    ok = ok && f.f64(c);
+                }
+                break;
+            case kTagPerspective:
+                ok = f.u8(enabled);
+                p.perspective = enabled != 0;
+                for (double& c : p.pers_coef) {
+                    ok = ok && f.f64(c);
+                }
+                break;
+            case kTagRotation:
+                ok = f.f64(p.rotation);
+                break;
+            default:
+                // a field of a later minor revision
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+}
+
+// runs `fn(addr, offset, n)` over the range in transfers the firmware accepts
+template <typename Fn>
+bool transfer(Camera& camera, uint32_t addr, size_t size, uint32_t page_size, const UserDataOptions& options,
+              UserDataStats& stats, Fn&& fn) {
+    if (addr > kUserDataSpace || size > kUserDataSpace - addr) {
+        return false;
+    }
+    uint32_t chunk = std::min(std::max(options.max_chunk, 1u), kMaxTransfer);
+    size_t done = 0;
+    bool ok = true;
+    while (done < size) {
+        const uint32_t at = static_cast<uint32_t>(addr + done);
+        uint32_t n = static_cast<uint32_t>(std::min<size_t>(chunk, size - done));
+        if (page_size != 0) {
+            n = std::min(n, page_size - at % page_size);
+        }
+        stats.transactions++;
+        if (fn(at, done, n)) {
+            done += n;
+        } else if (camera.lastError() == ArducamErrorCode::UserdataLenError && n > 1) {
+            chunk = n / 2;
+        } else {
+            ok = false;
+            break;
+        }
+    }
+    stats.chunk = chunk;
+    return ok;
+}
+
+void mergeStats(UserDataStats* stats, const UserDataStats& local) {
+    if (stats != nullptr) {
+        stats->transactions += local.transactions;
+        stats->bytes_written += local.bytes_written;
+        stats->chunk = local.chunk;
+    }
+}
+
+}  // namespace
+
+bool readUserDataBulk(Camera& camera, uint32_t addr, uint8_t* data, size_t size, const UserDataOptions& options,
+                      UserDataStats* stats) {
+    UserDataStats local;
+    const bool ok = transfer(camera, addr, size, 0, options, local, [&](uint32_t at, size_t offset, uint32_t n) {
+        return camera.readUserData(static_cast<uint16_t>(at), static_cast<uint8_t>(n), data + offset);
+    });
+    mergeStats(stats, local);
+    return ok;
+}
+
+bool writeUserDataBulk(Camera& camera, uint32_t addr, const uint8_t* data, size_t size,
+                       const UserDataOptions& options, UserDataStats* stats) {
+    UserDataStats local;
+    bool ok = transfer(camera, addr, size, options.page_size, options, local,
+                       [&](uint32_t at, size_t offset, uint32_t n) {
+                           return camera.writeUserData(static_cast<uint16_t>(at), data + offset, n);
+                       });
+    if (ok) {
+        local.bytes_written = size;
+    }
+    if (ok && options.verify) {
+        std::vector<uint8_t> back(size);
+        UserDataOptions read_options = options;
+        read_options.max_chunk = local.chunk;
+        const uint32_t chunk = local.chunk;
+        ok = readUserDataBulk(camera, addr, back.data(), size, read_options, &local) &&
+             std::equal(back.begin(), back.end(), data);
+        // the write size is the one to reuse
+        local.chunk = std::min(chunk, local.chunk);
+    }
+    mergeStats(stats, local);
+    return ok;
+}
+
+void encodeCalibration(const std::vector<CameraCalibration>& cameras, std::vector<uint8_t>& record) {
+    record.assign(kCalibrationHeaderSize, 0);
+    for (const CameraCalibration& camera : cameras) {
+        encodeCamera(camera, record);
+    }
+    uint8_t* header = record.data();
+    put32(header, kCalibrationMagic);
+    put16(header + 4, kCalibrationVersion);
+    put16(header + 6, static_cast<uint32_t>(cameras.size()));
+    put32(header + 8, static_cast<uint32_t>(record.size() - kCalibrationHeaderSize));
+    uint32_t crc = crc32(0, header, 12);
+    crc = crc32(crc, header + kCalibrationHeaderSize, record.size() - kCalibrationHeaderSize);
+    put32(header + 12, crc);
+}
+
+bool decodeCalibration(const uint8_t* record, size_t size, std::vector<CameraCalibration>& cameras) {
+    if (size < kCalibrationHeaderSize || get32(record) != kCalibrationMagic ||
+        get16(record + 4) > kCalibrationVersion) {
+        return false;
+    }
+    const size_t payload = get32(record + 8);
+    if (payload > size - kCalibrationHeaderSize) {
+        return false;
+    }
+    uint32_t crc = crc32(0, record, 12);
+    crc = crc32(crc, record + kCalibrationHeaderSize, payload);
+    if (crc != get32(record + 12)) {
+        return false;
+    }
+    const size_t count = get16(record + 6);
+    FieldReader r(record + kCalibrationHeaderSize, payload);
+    std::vector<CameraCalibration> result(count);
+    for (CameraCalibration& camera : result) {
+        if (!decodeCamera(r, camera)) {
+            return false;
+        }
+    }
+    cameras = std::move(result);
+    return true;
+}
+
+bool writeCalibration(Camera& camera, const std::vector<CameraCalibration>& cameras, uint32_t addr,
+                      const UserDataOptions& options, UserDataStats* stats) {
+    std::vector<uint8_t> record;
+    encodeCalibration(cameras, record);
+    UserDataStats local;
+    // unchanged only if the whole record is: a write cut short after the payload leaves the old header over the
+    // start of another payload, and rewriting the old record must repair it
+    std::vector<uint8_t> stored(record.size());
+    if (addr + record.size() <= kUserDataSpace &&
+        readUserDataBulk(camera, addr, stored.data(), kCalibrationHeaderSize, options, &local) &&
+        std::memcmp(stored.data(), record.data(), kCalibrationHeaderSize) == 0) {
+        UserDataOptions read_options = options;
+        read_options.max_chunk = local.chunk;
+        if (readUserDataBulk(camera, static_cast<uint32_t>(addr + kCalibrationHeaderSize),
+                             stored.data() + kCalibrationHeaderSize, record.size() - kCalibrationHeaderSize,
+                             read_options, &local) &&
+            stored == record) {
+            mergeStats(stats, local);
+            return true;
+        }
+    }
+    UserDataOptions write_options = options;
+    write_options.max_chunk = local.chunk != 0 ? local.chunk : options.max_chunk;
+    // the payload before the header: a write cut short leaves a record that fails its CRC, never a mix that passes
+    bool ok = writeUserDataBulk(camera, static_cast<uint32_t>(addr + kCalibrationHeaderSize),
+                                record.data() + kCalibrationHeaderSize, record.size() - kCalibrationHeaderSize,
+                                write_options, &local);
+    write_options.max_chunk = local.chunk;
+    ok = ok && writeUserDataBulk(camera, addr, record.data(), kCalibrationHeaderSize, write_options, &local);
+    mergeStats(stats, local);
+    return ok;
+}
+
+bool readCalibration(Camera& camera, std::vector<CameraCalibration>& cameras, uint32_t addr,
+                     const UserDataOptions& options, UserDataStats* stats) {
+    UserDataStats local;
+    std::vector<uint8_t> record(kCalibrationHeaderSize);
+    bool ok = readUserDataBulk(camera, addr, record.data(), record.size(), options, &local) &&
+              get32(record.data()) == kCalibrationMagic;
+    if (ok) {
+        const size_t payload = get32(record.data() + 8);
+        UserDataOptions read_options = options;
+        read_options.max_chunk = local.chunk;
+        ok = addr + kCalibrationHeaderSize + payload <= kUserDataSpace;
+        if (ok) {
+            record.resize(kCalibrationHeaderSize + payload);
+            ok = readUserDataBulk(camera, static_cast<uint32_t>(addr + kCalibrationHeaderSize),
+                                  record.data() + kCalibrationHeaderSize, payload, read_options, &local) &&
+                 decodeCalibration(record.data(), record.size(), cameras);
+        }
+    }
+    mergeStats(stats, local);
+    return ok;
+}
+
+const CameraCalibration* findCalibration(const std::vector<CameraCalibration>& cameras, const std::string& name) {
+    for (const CameraCalibration& camera : cameras) {
+        if (camera.name == name) {
+            return &camera;
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace Arducam
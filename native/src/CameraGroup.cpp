@@ -0,0 +1,371 @@
+#include <arducam/CameraGroup.hpp>
+
+#include <arducam/DeviceRegistry.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Common.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Arducam {
+
+namespace {
+
+bool pinThread(int cpu) {
+    if (cpu < 0) {
+        return true;
+    }
+#if defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+int cpuOf(const std::vector<int>& cpus, size_t index) { return index < cpus.size() ? cpus[index] : -1; }
+
+// the first device that is not taken and matches `serial`, or `devices.size()`
+size_t findDevice(const DeviceList& devices, const std::string& serial, const std::vector<bool>& taken) {
+    for (size_t i = 0; i < devices.size(); i++) {
+        if (taken[i] || devices[i] == nullptr) {
+            continue;
+        }
+        const ArducamDevice& device = *devices[i];
+        if (serial.empty() ? !device.in_used : deviceSerial(device) == serial) {
+            return i;
+        }
+    }
+    return devices.size();
+}
+
+bool endsWith(const std::string& text, const char* suffix) {
+    const size_t n = std::strlen(suffix);
+    return text.size() >= n && text.compare(text.size() - n, n, suffix) == 0;
+}
+
+}  // namespace
+
+double usbBandwidth(ArducamUSBSpeed speed) {
+    switch (speed) {
+        case USB_SPEED_LOW:
+            return 0.15e6;
+        case USB_SPEED_FULL:
+            return 1e6;
+        case USB_SPEED_SUPER:
+            return 380e6;
+        case USB_SPEED_SUPER_PLUS:
+            return 760e6;
+        default:
+            return 40e6;
+    }
+}
+
+std::unique_ptr<CameraGroup> CameraGroup::open(const std::vector<GroupCameraSpec>& cameras,
+                                               const CameraGroupOptions& options) {
+    if (cameras.empty()) {
+        return nullptr;
+    }
+    // the destructor closes the cameras opened before a failure
+    std::unique_ptr<CameraGroup> group(new CameraGroup());
+    group->options_ = options;
+    group->devices_.reset(new DeviceList(DeviceList::listDevices()));
+    const DeviceList& devices = *group->devices_;
+    std::vector<bool> taken(devices.size(), false);
+    const size_t io_threads = std::max<size_t>(1, std::min(options.io_threads, cameras.size()));
+
+    for (const GroupCameraSpec& spec : cameras) {
+        const size_t device = findDevice(devices, spec.serial, taken);
+        if (device == devices.size()) {
+            return nullptr;
+        }
+        taken[device] = true;
+
+        std::unique_ptr<Member> member(new Member());
+        member->camera.reset(new Camera());
+        ArducamCameraOpenParam param{};
+        param.config_file_name = spec.config_file_name.c_str();
+        param.ext_config_file_name = spec.ext_config_file_name.empty() ? nullptr : spec.ext_config_file_name.c_str();
+        param.bin_config = endsWith(spec.config_file_name, ".bin");
+        param.mem_type = options.mem_type;
+        param.device = devices[device];
+        if (!member->camera->open(param)) {
+            return nullptr;
+        }
+        member->index = group->cameras_.size();
+        member->io_thread = member->index % io_threads;
+        group->cameras_.push_back(std::move(member));
+        Member& added = *group->cameras_.back();
+        if (!added.camera->init()) {
+            return nullptr;
+        }
+        added.events.reset(new EventDispatcher(*added.camera));
+    }
+    if (!group->planBandwidth(cameras)) {
+        return nullptr;
+    }
+    return group;
+}
+
+CameraGroup::~CameraGroup() {
+    stop();
+    for (auto& member : cameras_) {
+        member->events.reset();
+        member->camera->close();
+    }
+}
+
+bool CameraGroup::planBandwidth(const std::vector<GroupCameraSpec>& cameras) {
+    double total = 0;
+    double fastest = 0;
+    for (size_t i = 0; i < cameras_.size(); i++) {
+        GroupCameraPlan& plan = cameras_[i]->plan;
+        const DeviceHandle device = cameras_[i]->camera->device();
+        plan.speed = device != nullptr ? device->speed : USB_SPEED_UNKNOWN;
+        plan.link_bandwidth = usbBandwidth(plan.speed);
+        plan.frame_size = modeFrameSize(cameras_[i]->camera->config());
+        plan.demand = cameras[i].fps > 0 ? static_cast<double>(plan.frame_size) * cameras[i].fps : plan.link_bandwidth;
+        total += plan.demand;
+        fastest = std::max(fastest, plan.link_bandwidth);
+    }
+    const double budget = options_.bandwidth_budget > 0 ? options_.bandwidth_budget : fastest;
+    const double scale = total > budget ? budget / total : 1.0;
+    oversubscribed_ = total > budget;
+
+    for (auto& member : cameras_) {
+        GroupCameraPlan& plan = member->plan;
+        Camera& camera = *member->camera;
+        oversubscribed_ = oversubscribed_ || plan.demand > plan.link_bandwidth;
+        plan.share = std::min(plan.link_bandwidth, plan.demand * scale);
+        plan.max_fps = plan.frame_size != 0 ? plan.share / static_cast<double>(plan.frame_size) : 0;
+
+        // the recommendation covers the full link; the share needs that many transfers at most
+        int count = 0;
+        int size = 0;
+        if (!camera.setAutoTransfer(true) || !camera.getAutoTransfer(count, size)) {
+            return false;
+        }
+        const double in_flight = plan.share * options_.transfer_window_ms / 1000.0;
+        const int wanted = size > 0 ? static_cast<int>(std::ceil(in_flight / size)) : count;
+        plan.transfers.transfer_count = std::max(std::min(wanted, count), std::min(2, count));
+        plan.transfers.buffer_size = size;
+        plan.transfers.mem_type = options_.mem_type;
+        if (!camera.setTransfer(plan.transfers.transfer_count, plan.transfers.buffer_size) ||
+            !camera.setMemType(plan.transfers.mem_type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CameraGroup::start(FrameHandler handler) {
+    if (running_ || !handler) {
+        return false;
+    }
+    handler_ = std::move(handler);
+    stopping_.store(false, std::memory_order_relaxed);
+    workers_stopping_.store(false, std::memory_order_relaxed);
+
+    const size_t io_threads = std::max<size_t>(1, std::min(options_.io_threads, cameras_.size()));
+    for (size_t i = 0; i < io_threads; i++) {
+        io_.emplace_back(new IoThread());
+    }
+    for (auto& member : cameras_) {
+        Member* m = member.get();
+        m->pending.store(0, std::memory_order_relaxed);
+        m->credit = 0;
+        io_[m->io_thread]->cameras.push_back(m);
+        IoThread* io = io_[m->io_thread].get();
+        m->listener = m->events->addListener([m, io](EventCode event) {
+            if (event == EventCode::FrameEnd) {
+                m->pending.fetch_add(1, std::memory_order_relaxed);
+                io->ready.notify();
+            }
+        });
+    }
+
+    running_ = true;
+    for (size_t i = 0; i < cameras_.size(); i++) {
+        if (!cameras_[i]->camera->start()) {
+            // no thread runs yet, this only removes the listeners
+            stopThreads();
+            for (size_t j = 0; j < i; j++) {
+                cameras_[j]->camera->stop();
+            }
+            return false;
+        }
+    }
+    for (size_t i = 0; i < options_.workers; i++) {
+        workers_.emplace_back(new Worker(options_.worker_queue));
+    }
+    for (size_t i = 0; i < workers_.size(); i++) {
+        workers_[i]->thread = std::thread(&CameraGroup::runWorker, this, i);
+    }
+    for (size_t i = 0; i < io_.size(); i++) {
+        io_[i]->thread = std::thread(&CameraGroup::runIo, this, i);
+    }
+    return true;
+}
+
+void CameraGroup::stop() {
+    if (!running_) {
+        return;
+    }
+    stopThreads();
+    for (auto& member : cameras_) {
+        member->camera->stop();
+    }
+}
+
+void CameraGroup::stopThreads() {
+    // the I/O threads go first, so that nothing is queued to the workers once they are told to stop
+    stopping_.store(true, std::memory_order_relaxed);
+    for (auto& io : io_) {
+        io->ready.notify();
+        if (io->thread.joinable()) {
+            io->thread.join();
+        }
+    }
+    workers_stopping_.store(true, std::memory_order_relaxed);
+    work_.notify();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    for (auto& member : cameras_) {
+        if (member->listener >= 0) {
+            member->events->removeListener(member->listener);
+            member->listener = -1;
+        }
+    }
+    io_.clear();
+    workers_.clear();
+    handler_ = nullptr;
+    running_ = false;
+}
+
+GroupCameraStats CameraGroup::stats(size_t index) const {
+    const Member& member = *cameras_[index];
+    GroupCameraStats stats;
+    stats.frames = member.frames.load(std::memory_order_relaxed);
+    stats.dropped = member.dropped.load(std::memory_order_relaxed);
+    stats.stolen = member.stolen.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void CameraGroup::runIo(size_t index) {
+    IoThread& io = *io_[index];
+    pinThread(cpuOf(options_.io_cpus, index));
+    FrameRef ref;
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        for (Member* m : io.cameras) {
+            m->credit += m->pending.exchange(0, std::memory_order_relaxed);
+            while (m->camera->getAvailCount() > 0 && captureRef(*m->camera, ref, 0)) {
+                m->credit--;
+                handOff(m->index, std::move(ref));
+            }
+            if (m->credit > 0) {
+                // the event came ahead of its frame, which is still on its way to the output queue
+                if (captureRef(*m->camera, ref, detail::kFrameEndWait)) {
+                    m->credit--;
+                    handOff(m->index, std::move(ref));
+                } else {
+                    m->credit = 0;
+                }
+            }
+        }
+        io.ready.wait(
+            [&] {
+                if (stopping_.load(std::memory_order_relaxed)) {
+                    return true;
+                }
+                for (const Member* m : io.cameras) {
+                    if (m->credit > 0 || m->pending.load(std::memory_order_relaxed) != 0) {
+                        return true;
+                    }
+                }
+                return false;
+            },
+            detail::kCapturePollTimeout);
+    }
+}
+
+void CameraGroup::handOff(size_t camera, FrameRef ref) {
+    Member& member = *cameras_[camera];
+    member.frames.fetch_add(1, std::memory_order_relaxed);
+    if (workers_.empty()) {
+        handler_(camera, std::move(ref));
+        return;
+    }
+    GroupFrame frame;
+    frame.camera = camera;
+    frame.ref = std::move(ref);
+    const size_t first = camera % workers_.size();
+    for (size_t i = 0; i < workers_.size(); i++) {
+        if (workers_[(first + i) % workers_.size()]->queue.tryPush(frame)) {
+            work_.notify();
+            return;
+        }
+    }
+    // every worker is busy: the frame goes straight back to the camera
+    member.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool CameraGroup::takeFrame(size_t worker, GroupFrame& frame) {
+    for (size_t i = 0; i < workers_.size(); i++) {
+        if (workers_[(worker + i) % workers_.size()]->queue.tryPop(frame)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CameraGroup::runWorker(size_t index) {
+    pinThread(cpuOf(options_.worker_cpus, index));
+    GroupFrame frame;
+    for (;;) {
+        if (takeFrame(index, frame)) {
+            if (frame.camera % workers_.size() != index) {
+                cameras_[frame.camera]->stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+            handler_(frame.camera, std::move(frame.ref));
+            frame.ref.reset();
+            continue;
+        }
+        // queued frames are still handled after the stop
+        if (workers_stopping_.load(std::memory_order_relaxed)) {
+            break;
+        }
+        work_.wait(
+            [&] {
+                if (workers_stopping_.load(std::memory_order_relaxed)) {
+                    return true;
+                }
+                for (const auto& worker : workers_) {
+                    if (!worker->queue.empty()) {
+                        return true;
+                    }
+                }
+                return false;
+            },
+            detail::kCapturePollTimeout);
+    }
+}
+
+}  // namespace Arducam
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Arducam {
+namespace detail {
+
+/** How long the capture threads wait for a frame at most, in milliseconds, so that they notice a stop. */
+constexpr int kCapturePollTimeout = 100;
+/** How long after a `FrameEnd` event a thread looks again for a frame whose event came ahead of it, in milliseconds. */
+constexpr int kFrameEndWait = 2;
+
+/** Returns the steady clock in microseconds. */
+inline uint64_t nowUs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/** Raises `max` to `value` if it is lower. */
+template <typename T>
+void updateMax(std::atomic<T>& max, typename std::atomic<T>::value_type value) {
+    T current = max.load(std::memory_order_relaxed);
+    while (current < value && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace detail
+}  // namespace Arducam
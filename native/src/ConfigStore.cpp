@@ -0,0 +1,283 @@
+#include <arducam/ConfigStore.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Arducam {
+
+namespace {
+
+constexpr char kMagic[4] = {'A', 'R', 'C', 'C'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kByteOrder = 0x01020304;
+constexpr uint64_t kFnvOffset = 0xCBF29CE484222325ull;
+constexpr uint64_t kFnvPrime = 0x100000001B3ull;
+
+uint64_t align8(uint64_t offset) { return (offset + 7) / 8 * 8; }
+
+// the layout of a store, in 8 byte words so that the in-memory form is aligned as the mapping
+void buildStore(const CameraConfigs& configs, uint64_t source_hash, uint64_t source_size, std::vector<uint64_t>& out) {
+    CompiledConfigHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrder;
+    header.param_size = sizeof(CameraParam);
+    header.config_size = sizeof(Config);
+    header.control_size = sizeof(Control);
+    header.pointer_size = sizeof(void*);
+    header.source_hash = source_hash;
+    header.source_size = source_size;
+    header.config_count = configs.configs != nullptr ? configs.configs_length : 0;
+    header.control_count = configs.controls != nullptr ? configs.controls_length : 0;
+
+    std::vector<uint32_t> code_offsets(header.control_count, kNoControlCode);
+    std::string strings;
+    for (uint32_t i = 0; i < header.control_count; i++) {
+        const char* code = configs.controls[i].code;
+        if (code != nullptr) {
+            code_offsets[i] = static_cast<uint32_t>(strings.size());
+            strings.append(code);
+            strings.push_back('\0');
+        }
+    }
+    header.param_offset = align8(sizeof(CompiledConfigHeader));
+    header.configs_offset = align8(header.param_offset + sizeof(CameraParam));
+    header.controls_offset = align8(header.configs_offset + uint64_t{header.config_count} * sizeof(Config));
+    header.code_offsets_offset = align8(header.controls_offset + uint64_t{header.control_count} * sizeof(Control));
+    header.strings_offset = align8(header.code_offsets_offset + code_offsets.size() * sizeof(uint32_t));
+    header.file_size = align8(header.strings_offset + strings.size());
+
+    out.assign(static_cast<size_t>(header.file_size / 8), 0);
+    uint8_t* base = reinterpret_cast<uint8_t*>(out.data());
+    std::memcpy(base, &header, sizeof(header));
+    std::memcpy(base + header.param_offset, &configs.camera_param, sizeof(CameraParam));
+    if (header.config_count != 0) {
+        std::memcpy(base + header.configs_offset, configs.configs, header.config_count * sizeof(Config));
+    }
+    Control* controls = reinterpret_cast<Control*>(base + header.controls_offset);
+    for (uint32_t i = 0; i < header.control_count; i++) {
+        controls[i] = configs.controls[i];
+        // a pointer means nothing in another process
+        controls[i].code = nullptr;
+    }
+    if (!code_offsets.empty()) {
+        std::memcpy(base + header.code_offsets_offset, code_offsets.data(), code_offsets.size() * sizeof(uint32_t));
+    }
+    std::memcpy(base + header.strings_offset, strings.data(), strings.size());
+}
+
+unsigned long processId() {
+#if defined(_WIN32)
+    return GetCurrentProcessId();
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+bool replaceFile(const std::string& from, const std::string& to) {
+#if defined(_WIN32)
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+}  // namespace
+
+bool hashConfigFile(const std::string& path, uint64_t& hash, uint64_t& size) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    hash = kFnvOffset;
+    size = 0;
+    char buffer[16384];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        const size_t n = static_cast<size_t>(file.gcount());
+        for (size_t i = 0; i < n; i++) {
+            hash = (hash ^ static_cast<uint8_t>(buffer[i])) * kFnvPrime;
+        }
+        size += n;
+    }
+    return !file.bad();
+}
+
+std::unique_ptr<CompiledConfig> CompiledConfig::open(const std::string& store_path, uint64_t source_hash,
+                                                     uint64_t source_size) {
+    detail::MappedFile file;
+    if (!detail::mapFile(store_path, sizeof(CompiledConfigHeader), file)) {
+        return nullptr;
+    }
+    std::unique_ptr<CompiledConfig> config(new CompiledConfig(file.base, file.size, file.mapping));
+    config->mapped_ = true;
+    if (!config->bind(source_hash, source_size)) {
+        return nullptr;
+    }
+    return config;
+}
+
+std::unique_ptr<CompiledConfig> CompiledConfig::load(const std::string& cfg_path, const std::string& store_path,
+                                                     bool* compiled) {
+    if (compiled != nullptr) {
+        *compiled = false;
+    }
+    uint64_t hash = 0;
+    uint64_t size = 0;
+    if (!hashConfigFile(cfg_path, hash, size)) {
+        return nullptr;
+    }
+    const std::string path = store_path.empty() ? cfg_path + ".arcc" : store_path;
+    std::unique_ptr<CompiledConfig> config = open(path, hash, size);
+    if (config) {
+        return config;
+    }
+
+    CameraConfigs configs;
+    std::memset(&configs, 0, sizeof(configs));
+    if (arducam_parse_config(cfg_path.c_str(), &configs) != 0) {
+        return nullptr;
+    }
+    if (compiled != nullptr) {
+        *compiled = true;
+    }
+    if (save(path, configs, hash, size)) {
+        config = open(path, hash, size);
+    }
+    if (!config) {
+        config.reset(new CompiledConfig(nullptr, 0, 0));
+        buildStore(configs, hash, size, config->memory_);
+        config->base_ = reinterpret_cast<const uint8_t*>(config->memory_.data());
+        config->size_ = config->memory_.size() * sizeof(uint64_t);
+        if (!config->bind(hash, size)) {
+            config.reset();
+        }
+    }
+    freeParsedConfigs(configs);
+    return config;
+}
+
+bool CompiledConfig::save(const std::string& store_path, const CameraConfigs& configs, uint64_t source_hash,
+                          uint64_t source_size) {
+    std::vector<uint64_t> out;
+    buildStore(configs, source_hash, source_size, out);
+    // truncating a mapped file in place would fault the processes reading it. The temporary file is unique to the
+    // process and the call, so that concurrent compilers never write the same one; the last rename wins
+    static std::atomic<uint32_t> counter{0};
+    const std::string temp =
+        store_path + "." + std::to_string(processId()) + "." + std::to_string(counter.fetch_add(1)) + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(out.data()),
+                   static_cast<std::streamsize>(out.size() * sizeof(uint64_t)));
+        if (!file) {
+            file.close();
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+    if (!replaceFile(temp, store_path)) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+CompiledConfig::CompiledConfig(const uint8_t* base, uint64_t size, intptr_t mapping)
+    : base_(base), size_(size), mapping_(mapping), mapped_(false) {}
+
+CompiledConfig::~CompiledConfig() {
+    if (mapped_) {
+        detail::unmapFile(detail::MappedFile{base_, size_, mapping_});
+    }
+}
+
+bool CompiledConfig::bind(uint64_t source_hash, uint64_t source_size) {
+    const CompiledConfigHeader& h = header();
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t item) {
+        return offset % 8 == 0 && offset <= size_ && count <= (size_ - offset) / item;
+    };
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion || h.byte_order != kByteOrder ||
+        h.param_size != sizeof(CameraParam) || h.config_size != sizeof(Config) || h.control_size != sizeof(Control) ||
+        h.pointer_size != sizeof(void*) || h.source_hash != source_hash || h.source_size != source_size ||
+        h.file_size != size_ || !fits(h.param_offset, 1, sizeof(CameraParam)) ||
+        !fits(h.configs_offset, h.config_count, sizeof(Config)) ||
+        !fits(h.controls_offset, h.control_count, sizeof(Control)) ||
+        !fits(h.code_offsets_offset, h.control_count, sizeof(uint32_t)) || h.strings_offset > size_) {
+        return false;
+    }
+    param_ = reinterpret_cast<const CameraParam*>(base_ + h.param_offset);
+    configs_ = reinterpret_cast<const Config*>(base_ + h.configs_offset);
+
+    const Control* controls = reinterpret_cast<const Control*>(base_ + h.controls_offset);
+    const uint32_t* code_offsets = reinterpret_cast<const uint32_t*>(base_ + h.code_offsets_offset);
+    const char* strings = reinterpret_cast<const char*>(base_ + h.strings_offset);
+    const uint64_t strings_size = size_ - h.strings_offset;
+    controls_.assign(controls, controls + h.control_count);
+    for (uint32_t i = 0; i < h.control_count; i++) {
+        const uint32_t offset = code_offsets[i];
+        // the strings must end inside the file
+        if (offset != kNoControlCode && (offset >= strings_size ||
+                                         std::memchr(strings + offset, '\0', strings_size - offset) == nullptr)) {
+            return false;
+        }
+        controls_[i].code = offset != kNoControlCode ? const_cast<char*>(strings + offset) : nullptr;
+    }
+    return true;
+}
+
+ArducamCameraConfig CompiledConfig::cameraConfig() const {
+    ArducamCameraConfig config{};
+    std::strncpy(config.camera_name, param_->type, sizeof(config.camera_name) - 1);
+    config.width = param_->width;
+    config.height = param_->height;
+    config.bit_width = param_->bit_width;
+    config.format = param_->format;
+    config.i2c_mode = param_->i2c_mode;
+    config.i2c_addr = param_->i2c_addr;
+    return config;
+}
+
+CameraConfigs CompiledConfig::cameraConfigs() const {
+    CameraConfigs configs;
+    std::memset(&configs, 0, sizeof(configs));
+    configs.camera_param = *param_;
+    configs.configs = const_cast<Config*>(configs_);
+    configs.configs_length = header().config_count;
+    configs.controls = const_cast<Control*>(controls_.data());
+    configs.controls_length = controlCount();
+    return configs;
+}
+
+bool openCompiled(Camera& camera, const CompiledConfig& config, const ArducamCameraOpenParam& param) {
+    ArducamCameraOpenParam open_param = param;
+    open_param.config_file_name = nullptr;
+    open_param.bin_config = false;
+    if (!camera.open(open_param)) {
+        return false;
+    }
+    RegisterProgram program;
+    // without a configuration file, the format must be set before `init()`
+    if (!config.program(static_cast<uint8_t>(camera.usbTypeNumber()), program) ||
+        !camera.setConfig(config.cameraConfig()) || !camera.init() || !program.run(camera) ||
+        (config.controlCount() != 0 &&
+         !camera.registerControls(const_cast<Control*>(config.controls()), config.controlCount()))) {
+        camera.close();
+        return false;
+    }
+    return true;
+}
+
+}  // namespace Arducam
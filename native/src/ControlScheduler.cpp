@@ -0,0 +1,234 @@
+#include <arducam/ControlScheduler.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+#include <arducam/RegisterProgram.hpp>
+
+#include "Common.hpp"
+
+namespace Arducam {
+
+namespace {
+
+// the number of results kept for wait()
+constexpr size_t kMaxResults = 1024;
+
+// `a - b` for sequence numbers, across the wrap-around
+int32_t seqDiff(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b); }
+
+}  // namespace
+
+ControlScheduler::ControlScheduler(Camera& camera, EventDispatcher& events, ControlSchedulerOptions options)
+    : camera_(camera), events_(events), options_(std::move(options)) {
+    worker_ = std::thread(&ControlScheduler::run, this);
+    listener_ = events_.addListener([this](EventCode event) { onEvent(event); });
+}
+
+ControlScheduler::~ControlScheduler() {
+    events_.removeListener(listener_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    applied_.notify_all();
+    worker_.join();
+}
+
+uint64_t ControlScheduler::schedule(uint32_t target_seq, const std::vector<ControlSetting>& controls,
+                                    const std::vector<RegWrite>& regs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t ticket = next_ticket_++;
+    pending_.push_back(Entry{ticket, target_seq, controls, regs});
+    return ticket;
+}
+
+size_t ControlScheduler::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t count = pending_.size();
+    pending_.clear();
+    applied_.notify_all();
+    return count;
+}
+
+void ControlScheduler::observe(const Frame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ends_ == 0) {
+        return;
+    }
+    // the frame ended at the latest with the last FrameEnd: a frame that waited in the queue gives a lower offset, so
+    // the highest one seen is the right one
+    const int64_t offset = static_cast<int64_t>(frame.seq) - static_cast<int64_t>(ends_ - 1);
+    if (!synced_ || offset > seq_offset_) {
+        seq_offset_ = offset;
+        synced_ = true;
+    }
+}
+
+bool ControlScheduler::synced() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return synced_ && starts_ != 0;
+}
+
+uint32_t ControlScheduler::currentSeq() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return synced_ && starts_ != 0 ? startedSeqLocked() : kNextFrame;
+}
+
+uint32_t ControlScheduler::earliestSeq() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return synced_ && starts_ != 0 ? startedSeqLocked() + options_.latency + 1 : kNextFrame;
+}
+
+bool ControlScheduler::wait(uint64_t ticket, ControlResult& result, int timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const ControlResult* found = nullptr;
+    auto done = [&] {
+        for (const ControlResult& r : results_) {
+            if (r.ticket == ticket) {
+                found = &r;
+                return true;
+            }
+        }
+        auto queued = [&](const std::vector<Entry>& entries) {
+            return std::any_of(entries.begin(), entries.end(), [&](const Entry& e) { return e.ticket == ticket; });
+        };
+        // a ticket in none of the queues was cancelled, or its result was dropped
+        return stopping_ || ticket == 0 || ticket >= next_ticket_ ||
+               (!queued(pending_) && !queued(due_) && !queued(committing_));
+    };
+    if (timeout < 0) {
+        applied_.wait(lock, done);
+    } else if (!applied_.wait_for(lock, std::chrono::milliseconds(timeout), done)) {
+        return false;
+    }
+    if (found == nullptr) {
+        return false;
+    }
+    result = *found;
+    return true;
+}
+
+ControlSchedulerStats ControlScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+uint32_t ControlScheduler::startedSeqLocked() const {
+    return static_cast<uint32_t>(static_cast<int64_t>(starts_ - 1) + seq_offset_);
+}
+
+void ControlScheduler::onEvent(EventCode event) {
+    if (event == EventCode::FrameEnd) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ends_++;
+        return;
+    }
+    if (event != EventCode::FrameStart) {
+        return;
+    }
+    bool due = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        starts_++;
+        stats_.frames++;
+        // a change due now shows in frame `seq + latency`
+        const uint32_t reach = startedSeqLocked() + options_.latency;
+        auto it = std::stable_partition(pending_.begin(), pending_.end(), [&](const Entry& entry) {
+            return !(entry.target_seq == kNextFrame || (synced_ && seqDiff(entry.target_seq, reach) <= 0));
+        });
+        if (it != pending_.end()) {
+            std::move(it, pending_.end(), std::back_inserter(due_));
+            pending_.erase(it, pending_.end());
+            due_time_us_ = detail::nowUs();
+            due = true;
+        }
+    }
+    // the writes go out on the worker, the SDK event thread must not block on USB transfers
+    if (due) {
+        wake_.notify_one();
+    }
+}
+
+void ControlScheduler::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [&] { return stopping_ || !due_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        committing_.swap(due_);
+        const uint64_t event_time = due_time_us_;
+        lock.unlock();
+        commit(committing_, event_time);
+        lock.lock();
+        committing_.clear();
+    }
+}
+
+void ControlScheduler::commit(std::vector<Entry>& batch, uint64_t event_time_us) {
+    RegBatchOptions regs = options_.regs;
+    regs.group_hold = false;
+    const uint32_t addr = regs.i2c_addr != 0 ? regs.i2c_addr : camera_.i2cAddr();
+    std::vector<bool> ok(batch.size(), true);
+    // one group hold for everything due, so that the sensor latches it on the same frame
+    bool all = camera_.writeReg(groupHoldMode(regs.mode), addr, regs.group_hold_reg, 1);
+    for (size_t i = 0; i < batch.size(); i++) {
+        for (const ControlSetting& control : batch[i].controls) {
+            ok[i] = camera_.setControl(control.name.c_str(), control.value) && ok[i];
+            // the registers behind a control are not known here
+            if (regs.mode_switcher != nullptr) {
+                regs.mode_switcher->invalidate();
+            }
+        }
+        ok[i] = writeRegs(camera_, batch[i].regs.data(), batch[i].regs.size(), regs) && ok[i];
+    }
+    all = camera_.writeReg(groupHoldMode(regs.mode), addr, regs.group_hold_reg, 0) && all;
+    const uint64_t latency = detail::nowUs() - event_time_us;
+
+    std::vector<ControlResult> results(batch.size());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // a commit that ran into the next frame only reaches the frame after that one
+        const bool known = synced_ && starts_ != 0;
+        const uint32_t applied = known ? startedSeqLocked() + options_.latency : kNextFrame;
+        bool failed = !all;
+        for (size_t i = 0; i < batch.size(); i++) {
+            ControlResult& r = results[i];
+            r.ticket = batch[i].ticket;
+            r.target_seq = batch[i].target_seq;
+            r.applied_seq = applied;
+            r.late = known && r.target_seq != kNextFrame && seqDiff(applied, r.target_seq) > 0;
+            r.ok = all && ok[i];
+            r.commit_latency_us = latency;
+            failed = failed || !ok[i];
+            stats_.late += r.late ? 1 : 0;
+            results_.push_back(r);
+        }
+        while (results_.size() > kMaxResults) {
+            results_.pop_front();
+        }
+        stats_.commits++;
+        stats_.changes += batch.size();
+        stats_.failures += failed ? 1 : 0;
+        stats_.last_latency_us = latency;
+    }
+    applied_.notify_all();
+    if (options_.metadata != nullptr) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            for (const ControlSetting& control : batch[i].controls) {
+                if (ok[i]) {
+                    options_.metadata->noteControl(results[i].applied_seq, control.name, control.value);
+                }
+            }
+        }
+    }
+    if (options_.on_applied) {
+        for (const ControlResult& r : results) {
+            options_.on_applied(r);
+        }
+    }
+}
+
+}  // namespace Arducam
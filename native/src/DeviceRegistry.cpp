@@ -0,0 +1,385 @@
+#include <arducam/DeviceRegistry.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#include "Common.hpp"
+
+namespace Arducam {
+
+namespace {
+
+bool endsWith(const std::string& text, const char* suffix) {
+    const size_t n = std::strlen(suffix);
+    return text.size() >= n && text.compare(text.size() - n, n, suffix) == 0;
+}
+
+const char* optionalPath(const std::string& path) { return path.empty() ? nullptr : path.c_str(); }
+
+}  // namespace
+
+std::string deviceSerial(const ArducamDevice& device) {
+    const char* serial = reinterpret_cast<const char*>(device.serial_number);
+    return std::string(serial, strnlen(serial, sizeof(device.serial_number)));
+}
+
+ManagedCamera::ManagedCamera(ManagedCameraOptions options) : options_(std::move(options)) {}
+
+ManagedCamera::~ManagedCamera() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.reset();
+    if (open_) {
+        camera_.close();
+    }
+}
+
+bool ManagedCamera::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+    return open_ && camera_.start();
+}
+
+bool ManagedCamera::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    return !open_ || camera_.stop();
+}
+
+bool ManagedCamera::setControl(const std::string& name, int64_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(control_values_.begin(), control_values_.end(),
+                           [&](const std::pair<std::string, int64_t>& control) { return control.first == name; });
+    if (it != control_values_.end()) {
+        it->second = value;
+    } else {
+        control_values_.emplace_back(name, value);
+    }
+    return open_ && camera_.setControl(name.c_str(), value);
+}
+
+bool ManagedCamera::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_;
+}
+
+ManagedCameraStats ManagedCamera::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+bool ManagedCamera::openFull(DeviceHandle device) {
+    if (!has_program_ && loadCompiled()) {
+        const bool ok = openFast(device);
+        if (ok || open_) {
+            return ok;
+        }
+        // the device did not take the compiled mode, the SDK may take the configuration file
+        compiled_.reset();
+        controls_.clear();
+        has_program_ = false;
+    }
+    const bool bin_config = endsWith(options_.config_file_name, ".bin");
+    ArducamCameraOpenParam param{};
+    param.config_file_name = optionalPath(options_.config_file_name);
+    param.ext_config_file_name = optionalPath(options_.ext_config_file_name);
+    param.bin_config = bin_config;
+    param.mem_type = options_.mem_type;
+    param.device = device;
+    if (!camera_.open(param)) {
+        return false;
+    }
+    if (!camera_.init()) {
+        camera_.close();
+        return false;
+    }
+    if (!has_program_) {
+        // parsed a second time here, once per camera: every reopen after this skips the parser
+        config_ = camera_.config();
+        has_program_ = !bin_config && !options_.config_file_name.empty() &&
+                       RegisterProgram::compileFile(options_.config_file_name,
+                                                    static_cast<uint8_t>(camera_.usbTypeNumber()), program_);
+        const Control* controls = camera_.controls();
+        const uint32_t count = controls != nullptr ? camera_.controlSize() : 0;
+        controls_.assign(controls, controls + count);
+        control_code_.clear();
+        for (const Control& control : controls_) {
+            control_code_.emplace_back(control.code != nullptr ? control.code : "");
+        }
+        for (size_t i = 0; i < controls_.size(); i++) {
+            controls_[i].code = controls_[i].code != nullptr ? &control_code_[i][0] : nullptr;
+        }
+    }
+    open_ = true;
+    return restore();
+}
+
+bool ManagedCamera::openFast(DeviceHandle device) {
+    if (!has_program_) {
+        return false;
+    }
+    ArducamCameraOpenParam param{};
+    param.ext_config_file_name = optionalPath(options_.ext_config_file_name);
+    param.mem_type = options_.mem_type;
+    param.device = device;
+    if (!camera_.open(param)) {
+        return false;
+    }
+    // the register program of a compiled configuration depends on the USB type of the device
+    if ((compiled_ && !compiled_->program(static_cast<uint8_t>(camera_.usbTypeNumber()), program_)) ||
+        // without a configuration file, the format must be set before `init()`
+        !camera_.setConfig(config_) || !camera_.init() || !program_.run(camera_) ||
+        (!controls_.empty() && !camera_.registerControls(controls_.data(), static_cast<uint32_t>(controls_.size())))) {
+        camera_.close();
+        return false;
+    }
+    open_ = true;
+    return restore();
+}
+
+bool ManagedCamera::loadCompiled() {
+    if (options_.config_store.empty() || options_.config_file_name.empty() ||
+        endsWith(options_.config_file_name, ".bin")) {
+        return false;
+    }
+    compiled_ = CompiledConfig::load(options_.config_file_name, options_.config_store);
+    if (!compiled_) {
+        return false;
+    }
+    config_ = compiled_->cameraConfig();
+    // the code strings point into the store, which lives as long as the camera
+    controls_.assign(compiled_->controls(), compiled_->controls() + compiled_->controlCount());
+    control_code_.clear();
+    has_program_ = true;
+    return true;
+}
+
+bool ManagedCamera::restore() {
+    if (!events_) {
+        events_.reset(new EventDispatcher(camera_));
+    } else {
+        // the callback went away with the old SDK handle
+        EventDispatcher* events = events_.get();
+        camera_.setEventCallback([events](EventCode event) { events->dispatch(event); });
+    }
+    bool ok = true;
+    if (options_.transfers.transfer_count > 0) {
+        ok = camera_.setTransfer(options_.transfers.transfer_count, options_.transfers.buffer_size) &&
+             camera_.setMemType(options_.transfers.mem_type);
+    }
+    for (const auto& control : control_values_) {
+        ok = camera_.setControl(control.first.c_str(), control.second) && ok;
+    }
+    return (!running_ || camera_.start()) && ok;
+}
+
+void ManagedCamera::onDisconnect() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.disconnects++;
+    if (open_) {
+        camera_.close();
+        open_ = false;
+    }
+}
+
+bool ManagedCamera::reopen(DeviceHandle device, uint64_t since_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_) {
+        return true;
+    }
+    bool ok = openFast(device);
+    if (ok) {
+        stats_.fast_reopens++;
+    } else {
+        // a fast open that failed after `Camera::open()` left the camera closed
+        open_ = false;
+        ok = openFull(device);
+    }
+    if (ok) {
+        stats_.reopens++;
+        stats_.last_reopen_us = detail::nowUs() - since_us;
+    } else {
+        stats_.failed_reopens++;
+    }
+    return ok;
+}
+
+DeviceRegistry::DeviceRegistry(StateCallback callback, DeviceTelemetry* telemetry)
+    : callback_(std::move(callback)), telemetry_(telemetry), list_(DeviceList::listDevices()) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reindex(false);
+    }
+    thread_ = std::thread(&DeviceRegistry::run, this);
+    list_.setEventCallback([this](EventCode code, DeviceHandle device) { onEvent(code, device); });
+}
+
+DeviceRegistry::~DeviceRegistry() {
+    list_.setEventCallback(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(events_mutex_);
+        stopping_ = true;
+    }
+    events_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    cameras_.clear();
+}
+
+std::vector<DeviceInfo> DeviceRegistry::devices() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<DeviceInfo> devices;
+    for (const auto& entry : entries_) {
+        devices.push_back(entry.second.info);
+    }
+    return devices;
+}
+
+bool DeviceRegistry::device(const std::string& serial, DeviceInfo& info) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(serial);
+    if (it == entries_.end()) {
+        return false;
+    }
+    info = it->second.info;
+    return true;
+}
+
+ManagedCamera* DeviceRegistry::open(const ManagedCameraOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto existing = cameras_.find(options.serial);
+    if (existing != cameras_.end()) {
+        return existing->second.get();
+    }
+    auto entry = entries_.find(options.serial);
+    if (entry == entries_.end() || !entry->second.info.connected) {
+        return nullptr;
+    }
+    std::unique_ptr<ManagedCamera> camera(new ManagedCamera(options));
+    {
+        std::lock_guard<std::mutex> camera_lock(camera->mutex_);
+        if (!camera->openFull(entry->second.handle)) {
+            return nullptr;
+        }
+    }
+    ManagedCamera* result = camera.get();
+    cameras_[options.serial] = std::move(camera);
+    return result;
+}
+
+void DeviceRegistry::close(const std::string& serial) {
+    std::unique_ptr<ManagedCamera> camera;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cameras_.find(serial);
+        if (it == cameras_.end()) {
+            return;
+        }
+        camera = std::move(it->second);
+        cameras_.erase(it);
+    }
+}
+
+void DeviceRegistry::onEvent(EventCode code, DeviceHandle device) {
+    if (telemetry_ != nullptr) {
+        telemetry_->onEvent(code);
+    }
+    if (code != EventCode::DeviceConnect && code != EventCode::DeviceDisconnect) {
+        return;
+    }
+    // the handle is only valid during the callback
+    Event event{code, device != nullptr ? deviceSerial(*device) : std::string(), detail::nowUs()};
+    {
+        std::lock_guard<std::mutex> lock(events_mutex_);
+        events_.push_back(std::move(event));
+    }
+    events_cv_.notify_one();
+}
+
+void DeviceRegistry::reindex(bool refresh) {
+    if (refresh && !list_.refresh()) {
+        return;
+    }
+    std::set<std::string> seen;
+    for (size_t i = 0; i < list_.size(); i++) {
+        const DeviceHandle handle = list_[i];
+        if (handle == nullptr) {
+            continue;
+        }
+        const std::string serial = deviceSerial(*handle);
+        seen.insert(serial);
+        Entry& entry = entries_[serial];
+        entry.handle = handle;
+        entry.info.serial = serial;
+        entry.info.vendor_id = handle->id_vendor;
+        entry.info.product_id = handle->id_product;
+        entry.info.usb_type = handle->usb_type;
+        entry.info.speed = handle->speed;
+        entry.info.path = std::string(handle->dev_path, strnlen(handle->dev_path, sizeof(handle->dev_path)));
+        entry.info.in_use = handle->in_used;
+        entry.info.connected = true;
+    }
+    for (auto& entry : entries_) {
+        if (seen.count(entry.first) == 0) {
+            entry.second.info.connected = false;
+            entry.second.handle = nullptr;
+        }
+    }
+}
+
+void DeviceRegistry::run() {
+    for (;;) {
+        Event event;
+        {
+            std::unique_lock<std::mutex> lock(events_mutex_);
+            events_cv_.wait(lock, [this] { return stopping_ || !events_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            event = std::move(events_.front());
+            events_.pop_front();
+        }
+
+        std::vector<std::pair<std::string, bool>> changes;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::map<std::string, bool> before;
+            for (const auto& entry : entries_) {
+                before[entry.first] = entry.second.info.connected;
+            }
+            reindex(true);
+            // the device may still be listed while it goes away
+            auto gone = entries_.find(event.serial);
+            if (event.code == EventCode::DeviceDisconnect && gone != entries_.end()) {
+                gone->second.info.connected = false;
+                gone->second.handle = nullptr;
+            }
+            for (auto& entry : entries_) {
+                const bool connected = entry.second.info.connected;
+                auto previous = before.find(entry.first);
+                const bool changed = previous == before.end() || previous->second != connected;
+                auto camera = cameras_.find(entry.first);
+                if (camera != cameras_.end()) {
+                    // a camera whose reopen failed is retried on every connect
+                    if (connected && (changed || !camera->second->isOpen())) {
+                        camera->second->reopen(entry.second.handle, event.time_us);
+                    } else if (!connected && changed) {
+                        camera->second->onDisconnect();
+                    }
+                }
+                if (changed) {
+                    changes.emplace_back(entry.first, connected);
+                }
+            }
+        }
+        if (callback_) {
+            for (const auto& change : changes) {
+                callback_(change.first, change.second);
+            }
+        }
+    }
+}
+
+}  // namespace Arducam
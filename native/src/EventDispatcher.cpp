@@ -0,0 +1,45 @@
+#include <arducam/EventDispatcher.hpp>
+
+namespace Arducam {
+
+EventDispatcher::EventDispatcher(Camera& camera)
+    : camera_(&camera), listeners_(std::make_shared<const ListenerList>()) {
+    camera_->setEventCallback([this](EventCode event) { dispatch(event); });
+}
+
+EventDispatcher::~EventDispatcher() noexcept { camera_->setEventCallback(nullptr); }
+
+int EventDispatcher::addListener(Listener listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto listeners = std::make_shared<ListenerList>(*listeners_);
+    int id = next_id_++;
+    listeners->emplace_back(id, std::move(listener));
+    listeners_ = std::move(listeners);
+    return id;
+}
+
+void EventDispatcher::removeListener(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto listeners = std::make_shared<ListenerList>(*listeners_);
+    for (auto it = listeners->begin(); it != listeners->end(); ++it) {
+        if (it->first == id) {
+            listeners->erase(it);
+            break;
+        }
+    }
+    listeners_ = std::move(listeners);
+}
+
+void EventDispatcher::dispatch(EventCode event) const {
+    std::shared_ptr<const ListenerList> listeners;
+    {
+        // the list is copied on write, so listeners run without holding the lock
+        std::lock_guard<std::mutex> lock(mutex_);
+        listeners = listeners_;
+    }
+    for (const auto& listener : *listeners) {
+        listener.second(event);
+    }
+}
+
+}  // namespace Arducam
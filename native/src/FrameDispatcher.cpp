@@ -0,0 +1,201 @@
+#include <arducam/FrameDispatcher.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+#include "Common.hpp"
+
+namespace Arducam {
+
+FrameSubscriber::FrameSubscriber(std::string name, size_t capacity, DropPolicy policy)
+    : name_(std::move(name)), policy_(policy), queue_(capacity) {}
+
+bool FrameSubscriber::tryPop(FrameRef& ref) {
+    if (!queue_.tryPop(ref)) {
+        return false;
+    }
+    consumed_.fetch_add(1, std::memory_order_relaxed);
+    if (policy_ == DropPolicy::Block) {
+        writable_.notify();
+    }
+    return true;
+}
+
+bool FrameSubscriber::pop(FrameRef& ref, int timeout) {
+    if (tryPop(ref)) {
+        return true;
+    }
+    readable_.wait([this] { return !queue_.empty() || closed(); }, timeout);
+    return tryPop(ref);
+}
+
+bool FrameSubscriber::popLatest(FrameRef& ref) {
+    FrameRef latest;
+    if (!tryPop(latest)) {
+        return false;
+    }
+    // dropping `latest` on each step hands the stale buffer straight back to the camera
+    while (tryPop(latest)) {
+    }
+    ref = std::move(latest);
+    return true;
+}
+
+SubscriberStats FrameSubscriber::stats() const {
+    SubscriberStats stats;
+    stats.delivered = delivered_.load(std::memory_order_relaxed);
+    stats.consumed = consumed_.load(std::memory_order_relaxed);
+    stats.dropped_oldest = dropped_oldest_.load(std::memory_order_relaxed);
+    stats.dropped_newest = dropped_newest_.load(std::memory_order_relaxed);
+    stats.blocked_us = blocked_us_.load(std::memory_order_relaxed);
+    stats.depth = static_cast<uint32_t>(queue_.size());
+    stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void FrameSubscriber::resetStats() {
+    delivered_.store(0, std::memory_order_relaxed);
+    consumed_.store(0, std::memory_order_relaxed);
+    dropped_oldest_.store(0, std::memory_order_relaxed);
+    dropped_newest_.store(0, std::memory_order_relaxed);
+    blocked_us_.store(0, std::memory_order_relaxed);
+    max_depth_.store(0, std::memory_order_relaxed);
+}
+
+void FrameSubscriber::offer(FrameRef ref, const std::atomic<bool>& abort) {
+    if (closed()) {
+        return;
+    }
+    while (!queue_.tryPush(ref)) {
+        if (policy_ == DropPolicy::DropNewest) {
+            dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (policy_ == DropPolicy::DropOldest) {
+            FrameRef oldest;
+            if (queue_.tryPop(oldest)) {
+                dropped_oldest_.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+        auto begin = std::chrono::steady_clock::now();
+        writable_.wait(
+            [&] { return queue_.size() < queue_.capacity() || closed() || abort.load(std::memory_order_relaxed); },
+            detail::kCapturePollTimeout);
+        auto waited = std::chrono::steady_clock::now() - begin;
+        blocked_us_.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(waited).count(),
+                              std::memory_order_relaxed);
+        if (closed() || abort.load(std::memory_order_relaxed)) {
+            return;
+        }
+    }
+    // a `close()` that drained before the push must not leave this frame held: either it sees the frame or this
+    // sees the flag, the fences pair with the one in `close()`
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (closed()) {
+        drain();
+        return;
+    }
+    delivered_.fetch_add(1, std::memory_order_relaxed);
+    detail::updateMax(max_depth_, static_cast<uint32_t>(queue_.size()));
+    readable_.notify();
+}
+
+void FrameSubscriber::close() {
+    closed_.store(true, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    drain();
+    readable_.notify();
+    writable_.notify();
+}
+
+void FrameSubscriber::drain() {
+    FrameRef ref;
+    while (queue_.tryPop(ref)) {
+        ref.reset();
+    }
+}
+
+FrameDispatcher::FrameDispatcher(Camera& camera) : camera_(&camera) {}
+
+FrameDispatcher::FrameDispatcher() = default;
+
+FrameDispatcher::~FrameDispatcher() noexcept { stop(); }
+
+std::shared_ptr<FrameSubscriber> FrameDispatcher::subscribe(const std::string& name, size_t capacity,
+                                                            DropPolicy policy) {
+    auto subscriber = std::make_shared<FrameSubscriber>(name, capacity, policy);
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.push_back(subscriber);
+    version_.fetch_add(1, std::memory_order_release);
+    return subscriber;
+}
+
+void FrameDispatcher::unsubscribe(const std::shared_ptr<FrameSubscriber>& subscriber) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find(subscribers_.begin(), subscribers_.end(), subscriber);
+        if (it == subscribers_.end()) {
+            return;
+        }
+        subscribers_.erase(it);
+        version_.fetch_add(1, std::memory_order_release);
+    }
+    subscriber->close();
+}
+
+std::vector<std::shared_ptr<FrameSubscriber>> FrameDispatcher::subscribers() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return subscribers_;
+}
+
+bool FrameDispatcher::start() {
+    if (camera_ == nullptr || running_.exchange(true)) {
+        return false;
+    }
+    stopping_.store(false, std::memory_order_relaxed);
+    thread_ = std::thread(&FrameDispatcher::run, this);
+    return true;
+}
+
+void FrameDispatcher::stop() {
+    stopping_.store(true, std::memory_order_relaxed);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    running_.store(false, std::memory_order_release);
+}
+
+void FrameDispatcher::dispatch(FrameRef ref) {
+    if (!ref) {
+        return;
+    }
+    // the subscriber list is only copied when it changed, so the steady state takes no lock
+    uint64_t version = version_.load(std::memory_order_acquire);
+    if (version != snapshot_version_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshot_ = subscribers_;
+        snapshot_version_ = version_.load(std::memory_order_relaxed);
+    }
+    if (snapshot_.empty()) {
+        return;
+    }
+    if (metadata_ != nullptr && ref.metadata() == nullptr) {
+        metadata_->parse(ref);
+    }
+    for (size_t i = 0; i + 1 < snapshot_.size(); i++) {
+        snapshot_[i]->offer(ref.share(), stopping_);
+    }
+    snapshot_.back()->offer(std::move(ref), stopping_);
+}
+
+void FrameDispatcher::run() {
+    FrameRef ref;
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        if (captureRef(*camera_, ref, detail::kCapturePollTimeout)) {
+            dispatch(std::move(ref));
+        }
+    }
+}
+
+}  // namespace Arducam
@@ -0,0 +1,277 @@
+#include <arducam/FrameMetadata.hpp>
+
+#include <algorithm>
+#include <cctype>
+
+#include <arducam/FrameRef.hpp>
+
+namespace Arducam {
+
+namespace {
+
+// the tags of a SMIA / CCS embedded data line
+constexpr uint8_t kLineStart = 0x0A;
+constexpr uint8_t kLineEnd = 0x07;
+constexpr uint8_t kTagAddressHigh = 0xAA;
+constexpr uint8_t kTagAddressLow = 0xA5;
+constexpr uint8_t kTagValue = 0x5A;
+constexpr uint8_t kTagSkip = 0x55;
+
+// the register bytes a parser can track, one bit each in a `uint64_t`
+constexpr size_t kMaxWanted = 64;
+// the control changes kept for frames not parsed yet
+constexpr size_t kMaxChanges = 64;
+// `from_seq` of a change for the next frame parsed, as `kNextFrame` of a `ControlScheduler`
+constexpr uint32_t kAnyFrame = UINT32_MAX;
+
+int32_t seqDiff(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b); }
+
+bool equalNoCase(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+// the bytes of an embedded data line, without the padding of the packed formats
+class LineReader {
+   public:
+    LineReader(const uint8_t* line, size_t size, PixelPacking packing, uint8_t bit_width)
+        : line_(line), size_(size), packing_(packing), shift_(bit_width > 8 ? std::min(bit_width - 8, 8) : 0),
+          // the last byte of a group holds the low bits of the 4 (RAW10) or 2 (RAW12) samples before it
+          group_(packing == PixelPacking::Raw10Packed ? 5 : 3) {}
+
+    bool next(uint8_t& byte) {
+        for (;;) {
+            const size_t i = pos_;
+            switch (packing_) {
+                case PixelPacking::Raw10Packed:
+                case PixelPacking::Raw12Packed:
+                    if (i >= size_) {
+                        return false;
+                    }
+                    pos_++;
+                    if (i % group_ == group_ - 1) {
+                        continue;
+                    }
+                    byte = line_[i];
+                    return true;
+                case PixelPacking::Bits16:
+                    if (i + 1 >= size_) {
+                        return false;
+                    }
+                    pos_ += 2;
+                    // the 8 bits of the embedded data are the high bits of the sample
+                    byte = static_cast<uint8_t>((line_[i] | line_[i + 1] << 8) >> shift_);
+                    return true;
+                default:
+                    if (i >= size_) {
+                        return false;
+                    }
+                    pos_++;
+                    byte = line_[i];
+                    return true;
+            }
+        }
+    }
+
+   private:
+    const uint8_t* line_;
+    size_t size_;
+    PixelPacking packing_;
+    int shift_;
+    size_t group_;
+    size_t pos_ = 0;
+};
+
+}  // namespace
+
+MetadataParser::MetadataParser(const MetadataOptions& options) : options_(options) {
+    if (options_.registers.size() > kMetaMaxRegisters) {
+        options_.registers.resize(kMetaMaxRegisters);
+    }
+    for (uint16_t reg : {options_.exposure_reg, options_.analogue_gain_reg, options_.digital_gain_reg,
+                         options_.frame_length_reg, options_.line_length_reg}) {
+        wanted_.push_back(reg);
+        wanted_.push_back(static_cast<uint16_t>(reg + 1));
+    }
+    wanted_.push_back(options_.temperature_reg);
+    wanted_.push_back(options_.frame_count_reg);
+    wanted_.insert(wanted_.end(), options_.registers.begin(), options_.registers.end());
+    std::sort(wanted_.begin(), wanted_.end());
+    wanted_.erase(std::unique(wanted_.begin(), wanted_.end()), wanted_.end());
+}
+
+int MetadataParser::find(uint16_t address) const {
+    const auto it = std::lower_bound(wanted_.begin(), wanted_.end(), address);
+    return it != wanted_.end() && *it == address ? static_cast<int>(it - wanted_.begin()) : -1;
+}
+
+bool MetadataParser::value8(const uint8_t* values, uint64_t seen, uint16_t address, uint8_t& value) const {
+    const int i = find(address);
+    if (i < 0 || (seen & (uint64_t(1) << i)) == 0) {
+        return false;
+    }
+    value = values[i];
+    return true;
+}
+
+bool MetadataParser::value16(const uint8_t* values, uint64_t seen, uint16_t address, uint32_t& value) const {
+    uint8_t high = 0;
+    uint8_t low = 0;
+    if (!value8(values, seen, address, high) || !value8(values, seen, static_cast<uint16_t>(address + 1), low)) {
+        return false;
+    }
+    value = static_cast<uint32_t>(high) << 8 | low;
+    return true;
+}
+
+bool MetadataParser::parseLine(const uint8_t* line, size_t size, PixelPacking packing, uint8_t bit_width,
+                               uint8_t* values, uint64_t& seen) const {
+    LineReader reader(line, size, packing, bit_width);
+    uint8_t byte = 0;
+    if (!reader.next(byte) || byte != kLineStart) {
+        return false;
+    }
+    // a line with a tag it does not know is not embedded data, it must not change the values of a good line
+    uint8_t line_values[kMaxWanted];
+    uint64_t line_seen = 0;
+    uint16_t address = 0;
+    uint8_t tag = 0;
+    uint8_t data = 0;
+    while (reader.next(tag) && reader.next(data) && tag != kLineEnd) {
+        switch (tag) {
+            case kTagAddressHigh:
+                address = static_cast<uint16_t>((address & 0x00FF) | data << 8);
+                break;
+            case kTagAddressLow:
+                address = static_cast<uint16_t>((address & 0xFF00) | data);
+                break;
+            case kTagValue: {
+                const int i = find(address);
+                if (i >= 0) {
+                    line_values[i] = data;
+                    line_seen |= uint64_t(1) << i;
+                }
+                address++;
+                break;
+            }
+            case kTagSkip:
+                address++;
+                break;
+            default:
+                return false;
+        }
+    }
+    for (size_t i = 0; i < wanted_.size(); i++) {
+        if ((line_seen & (uint64_t(1) << i)) != 0) {
+            values[i] = line_values[i];
+        }
+    }
+    seen |= line_seen;
+    return true;
+}
+
+bool MetadataParser::parse(const Frame& frame, FrameMetadata& metadata) {
+    metadata = FrameMetadata();
+    metadata.seq = frame.seq;
+    metadata.timestamp = frame.timestamp;
+    metadata.size = frame.size;
+    metadata.expected_size = frame.expected_size;
+
+    bool found = false;
+    const PixelPacking packing = options_.packing != PixelPacking::Unknown ? options_.packing : detectPacking(frame);
+    const size_t row_size = packedRowSize(packing, frame.format.width);
+    const size_t size = frame.size != 0 ? frame.size : frame.expected_size;
+    uint8_t values[kMaxWanted] = {};
+    uint64_t seen = 0;
+    for (uint32_t i = 0; frame.data != nullptr && row_size != 0 && i < options_.embedded_lines; i++) {
+        const size_t offset = static_cast<size_t>(options_.embedded_row + i) * row_size;
+        if (offset + row_size > size) {
+            break;
+        }
+        found = parseLine(frame.data + offset, row_size, packing, frame.format.bit_width, values, seen) || found;
+    }
+
+    uint32_t value = 0;
+    if (value16(values, seen, options_.exposure_reg, value)) {
+        metadata.exposure_lines = value;
+        metadata.valid |= kMetaExposure;
+    }
+    if (value16(values, seen, options_.analogue_gain_reg, value)) {
+        metadata.analogue_gain_code = static_cast<uint16_t>(value);
+        metadata.valid |= kMetaAnalogueGain;
+    }
+    if (value16(values, seen, options_.digital_gain_reg, value)) {
+        metadata.digital_gain_code = static_cast<uint16_t>(value);
+        metadata.valid |= kMetaDigitalGain;
+    }
+    if (value16(values, seen, options_.frame_length_reg, value)) {
+        metadata.frame_length_lines = static_cast<uint16_t>(value);
+        metadata.valid |= kMetaFrameLength;
+    }
+    if (value16(values, seen, options_.line_length_reg, value)) {
+        metadata.line_length_pck = static_cast<uint16_t>(value);
+        metadata.valid |= kMetaLineLength;
+    }
+    uint8_t byte = 0;
+    if (value8(values, seen, options_.temperature_reg, byte)) {
+        metadata.temperature = static_cast<int8_t>(byte);
+        metadata.valid |= kMetaTemperature;
+    }
+    if (value8(values, seen, options_.frame_count_reg, byte)) {
+        metadata.frame_count = byte;
+        metadata.valid |= kMetaFrameCount;
+    }
+    for (size_t i = 0; i < options_.registers.size(); i++) {
+        if (value8(values, seen, options_.registers[i], metadata.registers[i])) {
+            metadata.register_valid |= static_cast<uint8_t>(1u << i);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!changes_.empty() &&
+           (changes_.front().from_seq == kAnyFrame || seqDiff(frame.seq, changes_.front().from_seq) >= 0)) {
+        lens_position_ = changes_.front().value;
+        has_lens_ = true;
+        changes_.pop_front();
+    }
+    if (has_lens_) {
+        metadata.lens_position = lens_position_;
+        metadata.valid |= kMetaLensPosition;
+    }
+    stats_.frames++;
+    stats_.missing += found ? 0 : 1;
+    return found;
+}
+
+bool MetadataParser::parse(FrameRef& frame) {
+    if (!frame) {
+        return false;
+    }
+    FrameMetadata metadata;
+    const bool found = parse(frame.frame(), metadata);
+    frame.setMetadata(metadata);
+    return found;
+}
+
+void MetadataParser::noteControl(uint32_t from_seq, const std::string& name, int64_t value) {
+    if (options_.lens_control.empty() || !equalNoCase(name, options_.lens_control)) {
+        return;
+    }
+    const int32_t clamped = static_cast<int32_t>(std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, value)));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (changes_.size() == kMaxChanges) {
+        // nobody parses frames, the oldest change is in effect by now
+        lens_position_ = changes_.front().value;
+        has_lens_ = true;
+        changes_.pop_front();
+    }
+    changes_.push_back(Change{from_seq, clamped});
+}
+
+MetadataStats MetadataParser::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}  // namespace Arducam
@@ -0,0 +1,92 @@
+#include <arducam/FrameRef.hpp>
+
+namespace Arducam {
+
+struct FrameRef::Block {
+    std::atomic<uint32_t> refs;
+    Frame frame;
+    void* owner;
+    Releaser releaser;
+    bool has_metadata = false;
+    FrameMetadata metadata;
+};
+
+namespace {
+
+void releaseToCamera(void* owner, const Frame& frame) { static_cast<Camera*>(owner)->freeImage(frame); }
+
+}  // namespace
+
+FrameRef FrameRef::adopt(Camera& camera, const Frame& frame) { return wrap(frame, &camera, &releaseToCamera); }
+
+FrameRef FrameRef::wrap(const Frame& frame, void* owner, Releaser releaser) {
+    if (frame.data == nullptr) {
+        return FrameRef();
+    }
+    return FrameRef(new Block{{1}, frame, owner, releaser, false, FrameMetadata()});
+}
+
+FrameRef FrameRef::share() const noexcept {
+    if (block_ == nullptr) {
+        return FrameRef();
+    }
+    // a new reference can only be created from an existing one, so no ordering is required here
+    block_->refs.fetch_add(1, std::memory_order_relaxed);
+    return FrameRef(block_);
+}
+
+void FrameRef::reset() noexcept {
+    Block* block = std::exchange(block_, nullptr);
+    if (block == nullptr) {
+        return;
+    }
+    // acq_rel: every access to the buffer through other references happens before it is returned
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (block->releaser != nullptr) {
+            block->releaser(block->owner, block->frame);
+        }
+        delete block;
+    }
+}
+
+bool FrameRef::release(Frame& frame) noexcept {
+    if (block_ == nullptr || block_->refs.load(std::memory_order_acquire) != 1) {
+        return false;
+    }
+    frame = block_->frame;
+    delete std::exchange(block_, nullptr);
+    return true;
+}
+
+uint32_t FrameRef::useCount() const noexcept {
+    return block_ == nullptr ? 0 : block_->refs.load(std::memory_order_relaxed);
+}
+
+const Frame& FrameRef::frame() const noexcept { return block_->frame; }
+
+const uint8_t* FrameRef::data() const noexcept { return block_ == nullptr ? nullptr : block_->frame.data; }
+
+uint32_t FrameRef::size() const noexcept { return block_ == nullptr ? 0 : block_->frame.size; }
+
+const FrameMetadata* FrameRef::metadata() const noexcept {
+    return block_ != nullptr && block_->has_metadata ? &block_->metadata : nullptr;
+}
+
+void FrameRef::setMetadata(const FrameMetadata& metadata) noexcept {
+    if (block_ != nullptr) {
+        block_->metadata = metadata;
+        block_->has_metadata = true;
+    }
+}
+
+bool captureRef(Camera& camera, FrameRef& ref, int timeout) {
+    ref.reset();
+    Frame frame;
+    if (!camera.capture(frame, timeout)) {
+        return false;
+    }
+    ref = FrameRef::adopt(camera, frame);
+    return true;
+}
+
+}  // namespace Arducam
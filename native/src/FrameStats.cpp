@@ -0,0 +1,329 @@
+#include <arducam/FrameStats.hpp>
+
+#include <algorithm>
+
+namespace Arducam {
+
+namespace {
+
+// a sample within 1/64 of the white level counts as clipped
+constexpr uint32_t kClipMargin = 64;
+
+void unpackRow(const PixelKernelTable& k, PixelPacking packing, const uint8_t* src, uint16_t* dst, uint32_t width,
+               uint16_t mask) {
+    switch (packing) {
+        case PixelPacking::Bits8:
+            k.unpack8(src, dst, width);
+            break;
+        case PixelPacking::Bits16:
+            k.unpack16(src, dst, width, mask);
+            break;
+        case PixelPacking::Raw10Packed:
+            k.unpackRaw10(src, dst, width);
+            break;
+        case PixelPacking::Raw12Packed:
+            k.unpackRaw12(src, dst, width);
+            break;
+        default:
+            break;
+    }
+}
+
+uint64_t readLittleEndian(const uint8_t* p, uint8_t bytes) {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+bool validWidth(uint8_t bytes) { return bytes == 1 || bytes == 2 || bytes == 4 || bytes == 8; }
+
+}  // namespace
+
+FrameStatsEngine::FrameStatsEngine(const StatsOptions& options, WorkerPool* pool) : options_(options), pool_(pool) {
+    options_.zones_x = std::max<uint32_t>(options_.zones_x, 1);
+    options_.zones_y = std::max<uint32_t>(options_.zones_y, 1);
+    options_.histogram_bins = std::max<uint32_t>(options_.histogram_bins, 1);
+    options_.subsample = std::max<uint32_t>(options_.subsample, 1);
+}
+
+bool FrameStatsEngine::process(const FrameRef& frame, FrameStats& stats) {
+    if (!frame) {
+        return false;
+    }
+    const bool ok = process(frame.frame(), stats);
+    if (const FrameMetadata* metadata = frame.metadata()) {
+        stats.metadata = *metadata;
+    }
+    return ok;
+}
+
+bool FrameStatsEngine::process(const Frame& frame, FrameStats& stats) {
+    stats.seq = frame.seq;
+    stats.timestamp = frame.timestamp;
+    stats.metadata = FrameMetadata();
+    const ArducamFormatMode mode = formatMode(frame.format);
+    if (mode == FORMAT_MODE_STATS) {
+        return parseSensorStats(frame, stats);
+    }
+    const PixelPacking packing = detectPacking(frame);
+    const uint32_t blocks_x = frame.format.width / 2;
+    const uint32_t blocks_y = frame.format.height / 2;
+    if (frame.data == nullptr || packing == PixelPacking::Unknown || (!isBayer(mode) && !isMono(mode)) ||
+        blocks_x == 0 || blocks_y == 0) {
+        return false;
+    }
+    if (packing == PixelPacking::Raw10Packed || packing == PixelPacking::Raw12Packed) {
+        // the packed unpack kernels work on whole groups
+        if (frame.format.width % (packing == PixelPacking::Raw10Packed ? 4 : 2) != 0) {
+            return false;
+        }
+    }
+
+    const uint8_t bit_width = std::min<uint8_t>(std::max<uint8_t>(frame.format.bit_width, 1), 16);
+    const uint32_t white = (1u << bit_width) - 1;
+    stats.from_sensor = false;
+    stats.full_scale = white > options_.black_level ? white - options_.black_level : 1;
+    stats.zones_x = std::min(options_.zones_x, blocks_x);
+    stats.zones_y = std::min(options_.zones_y, blocks_y);
+    stats.zones.assign(static_cast<size_t>(stats.zones_x) * stats.zones_y, ZoneStats());
+    stats.histogram.assign(options_.histogram_bins, 0);
+
+    if (zone_of_block_.size() != blocks_x || bands_.size() != stats.zones_y ||
+        bands_[0].rows.size() != 2 * static_cast<size_t>(frame.format.width)) {
+        zone_of_block_.resize(blocks_x);
+        for (uint32_t x = 0; x < blocks_x; x++) {
+            zone_of_block_[x] = static_cast<uint16_t>(static_cast<uint64_t>(x) * stats.zones_x / blocks_x);
+        }
+        bands_.assign(stats.zones_y, Band());
+        for (Band& band : bands_) {
+            band.rows.resize(2 * static_cast<size_t>(frame.format.width));
+            band.luma.resize(3 * static_cast<size_t>(blocks_x));
+        }
+    }
+    auto band = [&](size_t zone_y) { processBand(frame, packing, static_cast<uint32_t>(zone_y), stats); };
+    if (pool_ != nullptr) {
+        pool_->parallelFor(stats.zones_y, band);
+    } else {
+        for (uint32_t zone_y = 0; zone_y < stats.zones_y; zone_y++) {
+            band(zone_y);
+        }
+    }
+
+    double luma = 0;
+    double saturated = 0;
+    uint64_t samples = 0;
+    for (ZoneStats& zone : stats.zones) {
+        luma += (zone.r + 2 * zone.g + zone.b) / 4;
+        saturated += zone.saturated;
+        samples += zone.samples;
+        // the band pass leaves sums, turned into means here
+        if (zone.samples != 0) {
+            zone.r /= zone.samples;
+            zone.g /= zone.samples;
+            zone.b /= zone.samples;
+            zone.saturated /= zone.samples;
+        }
+    }
+    stats.samples = samples;
+    stats.mean = samples != 0 ? luma / samples : 0;
+    stats.saturated = samples != 0 ? saturated / samples : 0;
+
+    double laplacian_sum = 0;
+    double laplacian_squares = 0;
+    double tenengrad_sum = 0;
+    uint64_t focus_samples = 0;
+    for (const Band& part : bands_) {
+        for (size_t i = 0; i < stats.histogram.size(); i++) {
+            stats.histogram[i] += part.histogram[i];
+        }
+        laplacian_sum += part.laplacian_sum;
+        laplacian_squares += part.laplacian_squares;
+        tenengrad_sum += part.tenengrad_sum;
+        focus_samples += part.focus_samples;
+    }
+    // the block sums are four times the luma, and the metrics are quadratic
+    if (focus_samples != 0) {
+        const double mean = laplacian_sum / focus_samples;
+        stats.laplacian_variance = std::max(0.0, laplacian_squares / focus_samples - mean * mean) / 16;
+        stats.tenengrad = tenengrad_sum / focus_samples / 16;
+    } else {
+        stats.laplacian_variance = 0;
+        stats.tenengrad = 0;
+    }
+    return true;
+}
+
+void FrameStatsEngine::processBand(const Frame& frame, PixelPacking packing, uint32_t zone_y, FrameStats& stats) {
+    Band& band = bands_[zone_y];
+    band.histogram.assign(options_.histogram_bins, 0);
+    band.laplacian_sum = band.laplacian_squares = band.tenengrad_sum = 0;
+    band.focus_samples = 0;
+
+    const PixelKernelTable& k = pixelKernels();
+    const uint32_t width = frame.format.width;
+    const uint32_t blocks_x = width / 2;
+    const uint32_t blocks_y = frame.format.height / 2;
+    const size_t src_row = packedRowSize(packing, width);
+    const uint8_t bit_width = std::min<uint8_t>(std::max<uint8_t>(frame.format.bit_width, 1), 16);
+    const uint16_t mask = static_cast<uint16_t>((1u << bit_width) - 1);
+    const uint32_t full = stats.full_scale;
+    const uint32_t clip = full - full / kClipMargin;
+    const uint32_t bins = options_.histogram_bins;
+    const uint32_t sub = options_.subsample;
+    const bool mono = isMono(formatMode(frame.format));
+    const BayerOrder order = bayerOrder(frame.format);
+    const uint32_t red_x = order == BayerOrder::GRBG || order == BayerOrder::BGGR ? 1 : 0;
+    const uint32_t red_y = order == BayerOrder::GBRG || order == BayerOrder::BGGR ? 1 : 0;
+
+    // the band, and the focus rows (centers with both neighbours inside the frame) that fall into it
+    const uint32_t b0 = static_cast<uint32_t>(static_cast<uint64_t>(zone_y) * blocks_y / stats.zones_y);
+    const uint32_t b1 = static_cast<uint32_t>(static_cast<uint64_t>(zone_y + 1) * blocks_y / stats.zones_y);
+    const uint32_t fx0 = std::min(options_.focus_x / 2, blocks_x);
+    const uint32_t fy0 = std::min(options_.focus_y / 2, blocks_y);
+    const uint32_t fx1 = options_.focus_width != 0 ? std::min(fx0 + options_.focus_width / 2, blocks_x) : blocks_x;
+    const uint32_t fy1 = options_.focus_height != 0 ? std::min(fy0 + options_.focus_height / 2, blocks_y) : blocks_y;
+    const uint32_t cx0 = std::max<uint32_t>(fx0, 1);
+    const uint32_t cx1 = std::min(fx1, blocks_x - 1);
+    const uint32_t c0 = std::max({b0, fy0, 1u});
+    const uint32_t c1 = std::min({b1, fy1, blocks_y - 1});
+    const bool focus = c0 < c1 && cx0 < cx1;
+    const uint32_t first = focus ? std::min(b0, c0 - 1) : b0;
+    const uint32_t last = focus ? std::max(b1, c1 + 1) : b1;
+
+    uint16_t* rows[2] = {band.rows.data(), band.rows.data() + width};
+    ZoneStats* zones = stats.zones.data() + static_cast<size_t>(zone_y) * stats.zones_x;
+    for (uint32_t by = first; by < last; by++) {
+        const bool sampled = by >= b0 && by < b1 && by % sub == 0;
+        const bool focus_row = focus && by + 1 >= c0 && by <= c1;
+        if (!sampled && !focus_row) {
+            continue;
+        }
+        for (uint32_t i = 0; i < 2; i++) {
+            unpackRow(k, packing, frame.data + (2 * static_cast<size_t>(by) + i) * src_row, rows[i], width, mask);
+            if (options_.black_level != 0) {
+                k.subtractBlack(rows[i], width, options_.black_level);
+            }
+        }
+        uint32_t* luma = band.luma.data() + static_cast<size_t>(by % 3) * blocks_x;
+        auto block = [&](uint32_t bx, bool sample) {
+            const uint16_t* top = rows[red_y] + 2 * bx;
+            const uint16_t* bottom = rows[1 - red_y] + 2 * bx;
+            uint32_t r, g, b;
+            if (mono) {
+                r = g = b = (top[0] + top[1] + bottom[0] + bottom[1] + 2u) >> 2;
+            } else {
+                r = top[red_x];
+                b = bottom[1 - red_x];
+                g = (top[1 - red_x] + bottom[red_x] + 1u) >> 1;
+            }
+            const uint32_t sum = r + 2 * g + b;
+            luma[bx] = sum;
+            if (!sample) {
+                return;
+            }
+            ZoneStats& zone = zones[zone_of_block_[bx]];
+            zone.r += r;
+            zone.g += g;
+            zone.b += b;
+            zone.samples++;
+            if (std::max({top[0], top[1], bottom[0], bottom[1]}) >= clip) {
+                zone.saturated += 1;
+            }
+            const uint32_t bin = static_cast<uint32_t>(static_cast<uint64_t>(sum / 4) * bins / (full + 1));
+            band.histogram[std::min(bin, bins - 1)]++;
+        };
+        // the focus window with its border, then the sampled blocks outside of it
+        const uint32_t x0 = focus_row ? cx0 - 1 : 0;
+        const uint32_t x1 = focus_row ? cx1 + 1 : 0;
+        for (uint32_t bx = x0; bx < x1; bx++) {
+            block(bx, sampled && bx % sub == 0);
+        }
+        if (sampled) {
+            for (uint32_t bx = 0; bx < blocks_x; bx += sub) {
+                if (bx < x0 || bx >= x1) {
+                    block(bx, true);
+                }
+            }
+        }
+
+        // the row above is a focus center once the row below it is there
+        const uint32_t center = by - 1;
+        if (focus && by >= 1 && center >= c0 && center < c1) {
+            const uint32_t* u = band.luma.data() + static_cast<size_t>((center - 1) % 3) * blocks_x;
+            const uint32_t* c = band.luma.data() + static_cast<size_t>(center % 3) * blocks_x;
+            const uint32_t* d = luma;
+            for (uint32_t x = cx0; x < cx1; x++) {
+                const double laplacian = 4.0 * c[x] - c[x - 1] - c[x + 1] - u[x] - d[x];
+                const double gx =
+                    (double(u[x + 1]) + 2.0 * c[x + 1] + d[x + 1]) - (double(u[x - 1]) + 2.0 * c[x - 1] + d[x - 1]);
+                const double gy =
+                    (double(d[x - 1]) + 2.0 * d[x] + d[x + 1]) - (double(u[x - 1]) + 2.0 * u[x] + u[x + 1]);
+                band.laplacian_sum += laplacian;
+                band.laplacian_squares += laplacian * laplacian;
+                band.tenengrad_sum += gx * gx + gy * gy;
+            }
+            band.focus_samples += cx1 - cx0;
+        }
+    }
+}
+
+bool FrameStatsEngine::parseSensorStats(const Frame& frame, FrameStats& stats) const {
+    const SensorStatsLayout& l = layout_;
+    const size_t size = frame.size != 0 ? frame.size : frame.expected_size;
+    const size_t zone_size = static_cast<size_t>(l.zones_x) * l.zones_y * l.zone_channels * l.zone_bytes;
+    if (frame.data == nullptr || (l.histogram_bins != 0 && !validWidth(l.histogram_bytes)) ||
+        (l.zones_x * l.zones_y != 0 && (!validWidth(l.zone_bytes) || (l.zone_channels != 1 && l.zone_channels != 3 &&
+                                                                      l.zone_channels != 4))) ||
+        (l.focus_bytes != 0 && !validWidth(l.focus_bytes)) ||
+        l.histogram_offset + static_cast<size_t>(l.histogram_bins) * l.histogram_bytes > size ||
+        l.zone_offset + zone_size > size || l.focus_offset + l.focus_bytes > size) {
+        return false;
+    }
+    stats.from_sensor = true;
+    stats.full_scale = l.full_scale;
+    stats.histogram.resize(l.histogram_bins);
+    uint64_t samples = 0;
+    for (uint32_t i = 0; i < l.histogram_bins; i++) {
+        stats.histogram[i] =
+            static_cast<uint32_t>(readLittleEndian(frame.data + l.histogram_offset + i * l.histogram_bytes,
+                                                   l.histogram_bytes));
+        samples += stats.histogram[i];
+    }
+    stats.samples = samples;
+
+    stats.zones_x = l.zones_x;
+    stats.zones_y = l.zones_y;
+    stats.zones.assign(static_cast<size_t>(l.zones_x) * l.zones_y, ZoneStats());
+    double luma = 0;
+    const uint8_t* p = frame.data + l.zone_offset;
+    for (ZoneStats& zone : stats.zones) {
+        double c[4];
+        for (uint8_t i = 0; i < l.zone_channels; i++, p += l.zone_bytes) {
+            c[i] = static_cast<double>(readLittleEndian(p, l.zone_bytes));
+        }
+        if (l.zone_channels == 1) {
+            zone.r = zone.g = zone.b = c[0];
+        } else if (l.zone_channels == 3) {
+            zone.r = c[0];
+            zone.g = c[1];
+            zone.b = c[2];
+        } else {
+            zone.r = c[0];
+            zone.g = (c[1] + c[2]) / 2;
+            zone.b = c[3];
+        }
+        luma += (zone.r + 2 * zone.g + zone.b) / 4;
+    }
+    stats.mean = stats.zones.empty() ? 0 : luma / stats.zones.size();
+    // the sensor reports no clipping, the top bin is the closest
+    stats.saturated = samples != 0 && !stats.histogram.empty() ? double(stats.histogram.back()) / samples : 0;
+    stats.laplacian_variance = 0;
+    stats.tenengrad = l.focus_bytes != 0 ? static_cast<double>(readLittleEndian(frame.data + l.focus_offset,
+                                                                                l.focus_bytes))
+                                         : 0;
+    return true;
+}
+
+}  // namespace Arducam
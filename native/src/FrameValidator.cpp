@@ -0,0 +1,217 @@
+#include <arducam/FrameValidator.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+namespace Arducam {
+
+namespace {
+
+uint64_t nowMs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// a run of consecutive checked rows with the same problem
+struct Run {
+    uint32_t start = 0;
+    uint32_t length = 0;
+};
+
+}  // namespace
+
+FrameValidator::FrameValidator(const ValidatorOptions& options) : options_(options), kernels_(pixelKernels()) {
+    options_.row_step = std::max(1u, options_.row_step);
+    options_.sample_chunks = std::max(1u, options_.sample_chunks);
+    options_.min_stripe_rows = std::max(1u, options_.min_stripe_rows);
+}
+
+void FrameValidator::reset() {
+    recent_.clear();
+    recent_next_ = 0;
+    recent_row_size_ = 0;
+    has_counter_ = false;
+}
+
+ByteDigest FrameValidator::digestRow(const uint8_t* row, size_t row_size) const {
+    const uint32_t chunks = options_.sample_chunks;
+    // whole 32 byte blocks, so that the kernels never fall back to their scalar tail
+    const size_t chunk = std::max<size_t>(32, options_.sample_bytes / chunks / 32 * 32);
+    ByteDigest digest;
+    if (options_.row_checksums || options_.sample_bytes == 0 || chunk * chunks >= row_size) {
+        kernels_.digestBytes(row, row_size, digest);
+        return digest;
+    }
+    digest.hash = 0;
+    digest.min = 0xFF;
+    digest.max = 0;
+    for (uint32_t c = 0; c < chunks; c++) {
+        // the chunks are centered in equal parts of the row
+        const size_t center = row_size * (2 * c + 1) / (2 * chunks);
+        const size_t offset = std::min(row_size - chunk, (center - chunk / 2) / 32 * 32);
+        ByteDigest part;
+        kernels_.digestBytes(row + offset, chunk, part);
+        digest.hash = (digest.hash ^ part.hash) * 0x100000001B3ull;
+        digest.min = std::min(digest.min, part.min);
+        digest.max = std::max(digest.max, part.max);
+    }
+    return digest;
+}
+
+void FrameValidator::checkCounter(const Frame& frame, size_t row_size, uint32_t rows, FrameQuality& quality) {
+    const EmbeddedCounter& counter = options_.counter;
+    if (counter.size == 0 || counter.size > 4 || counter.row >= rows ||
+        counter.offset + static_cast<size_t>(counter.size - 1) * counter.stride >= row_size) {
+        return;
+    }
+    const uint8_t* p = frame.data + counter.row * row_size + counter.offset;
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < counter.size; i++) {
+        const uint32_t byte = p[i * counter.stride];
+        value = counter.big_endian ? value << 8 | byte : value | byte << (8 * i);
+    }
+    quality.has_counter = true;
+    quality.counter = value;
+
+    // the same frame validated twice tells nothing
+    if (has_counter_ && frame.seq != last_seq_) {
+        const uint32_t mask = counter.size == 4 ? 0xFFFFFFFFu : (1u << (8 * counter.size)) - 1;
+        const uint32_t counter_step = (value - last_counter_) & mask;
+        const uint32_t seq_step = (frame.seq - last_seq_) & mask;
+        if (counter_step == 0) {
+            quality.flags |= options_.checks & kFrameCounterRepeat;
+        } else if (counter_step != seq_step) {
+            quality.flags |= options_.checks & kFrameCounterMismatch;
+        }
+    }
+    has_counter_ = true;
+    last_counter_ = value;
+    last_seq_ = frame.seq;
+}
+
+bool FrameValidator::validate(const Frame& frame, FrameQuality& quality) {
+    quality.flags = 0;
+    quality.seq = frame.seq;
+    quality.rows_checked = 0;
+    quality.first_bad_row = 0;
+    quality.bad_rows = 0;
+    quality.has_counter = false;
+    quality.counter = 0;
+    quality.row_checksums.clear();
+    const uint32_t checks = options_.checks;
+    if (frame.size != frame.expected_size) {
+        quality.flags |= checks & kFrameSizeMismatch;
+    }
+
+    const uint32_t height = frame.format.height;
+    const size_t row_size =
+        height != 0 && frame.expected_size % height == 0 ? static_cast<size_t>(frame.expected_size / height) : 0;
+    // compressed frames have no rows
+    if (frame.data != nullptr && row_size != 0 && formatMode(frame.format) != FORMAT_MODE_JPG) {
+        // the rows received completely
+        const uint32_t rows = static_cast<uint32_t>(std::min<size_t>(height, frame.size / row_size));
+        checkCounter(frame, row_size, rows, quality);
+
+        if (recent_row_size_ != row_size) {
+            recent_.clear();
+            recent_next_ = 0;
+            recent_row_size_ = row_size;
+        }
+        const uint32_t step = options_.row_step;
+        const uint32_t stripe = options_.min_stripe_rows;
+        Run zero;
+        Run repeated;
+        Run stale;
+        // the first row not yet counted in `bad_rows`
+        uint32_t uncounted = 0;
+        auto track = [&](Run& run, bool bad, uint32_t flag, uint32_t y) {
+            if (!bad || (checks & flag) == 0) {
+                run.length = 0;
+                return;
+            }
+            if (run.length++ == 0) {
+                run.start = y;
+            }
+            if (run.length < stripe) {
+                return;
+            }
+            if (quality.bad_rows == 0) {
+                quality.first_bad_row = run.start;
+            }
+            quality.flags |= flag;
+            const uint32_t from = std::max(run.start, uncounted);
+            if (from <= y) {
+                quality.bad_rows += (y - from) / step * step + step;
+                uncounted = y + step;
+            }
+        };
+        hashes_.clear();
+        for (uint32_t y = 0; y < rows; y += step) {
+            const ByteDigest digest = digestRow(frame.data + y * row_size, row_size);
+            const size_t i = hashes_.size();
+            // a row of one value may be a clipped highlight, its neighbours and predecessors look the same
+            const bool uniform = digest.min == digest.max;
+            const bool same_as_above = !uniform && i != 0 && hashes_[i - 1] == digest.hash;
+            bool same_as_before = false;
+            for (size_t f = 0; f < recent_.size() && !uniform && !same_as_before; f++) {
+                same_as_before = i < recent_[f].size() && recent_[f][i] == digest.hash;
+            }
+            track(zero, digest.max == 0, kFrameZeroStripe, y);
+            track(repeated, same_as_above, kFrameRepeatedStripe, y);
+            track(stale, same_as_before, kFrameStaleStripe, y);
+            hashes_.push_back(digest.hash);
+            if (options_.row_checksums) {
+                quality.row_checksums.push_back(digest.hash);
+            }
+        }
+        quality.rows_checked = static_cast<uint32_t>(hashes_.size());
+        quality.bad_rows = std::min(quality.bad_rows, rows - quality.first_bad_row);
+
+        if ((checks & kFrameStaleStripe) != 0 && options_.history != 0) {
+            if (recent_.size() < options_.history) {
+                recent_.push_back(hashes_);
+            } else {
+                recent_[recent_next_].swap(hashes_);
+                recent_next_ = (recent_next_ + 1) % recent_.size();
+            }
+        }
+    }
+
+    stats_.frames++;
+    stats_.bad += quality.flags != 0 ? 1 : 0;
+    stats_.size_mismatches += (quality.flags & kFrameSizeMismatch) != 0 ? 1 : 0;
+    stats_.zero_stripes += (quality.flags & kFrameZeroStripe) != 0 ? 1 : 0;
+    stats_.repeated_stripes += (quality.flags & kFrameRepeatedStripe) != 0 ? 1 : 0;
+    stats_.stale_stripes += (quality.flags & kFrameStaleStripe) != 0 ? 1 : 0;
+    stats_.counter_errors += (quality.flags & (kFrameCounterRepeat | kFrameCounterMismatch)) != 0 ? 1 : 0;
+    return quality.ok();
+}
+
+Camera::CaptureCallback FrameValidator::wrapCallback(Camera::CaptureCallback callback) {
+    return [this, callback](Frame frame) {
+        if (validate(frame, callback_quality_)) {
+            callback(frame);
+        }
+    };
+}
+
+bool captureValid(Camera& camera, FrameValidator& validator, FrameRef& ref, FrameQuality& quality, int timeout) {
+    const uint64_t deadline = nowMs() + static_cast<uint64_t>(std::max(timeout, 0));
+    for (;;) {
+        const uint64_t now = nowMs();
+        const int remaining = now < deadline ? static_cast<int>(deadline - now) : 0;
+        if (!captureRef(camera, ref, remaining)) {
+            return false;
+        }
+        if (validator.validate(ref.frame(), quality)) {
+            return true;
+        }
+        ref.reset();
+        if (remaining == 0) {
+            return false;
+        }
+    }
+}
+
+}  // namespace Arducam
@@ -0,0 +1,597 @@
+#include <arducam/GpuPreview.hpp>
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Arducam {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr int kMaxCoeffs = 8;
+
+// one triangle covering the viewport, no vertex buffer
+const char* kVertexShader = R"(#version 300 es
+void main() {
+    vec2 p = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;
+    gl_Position = vec4(p, 0.0, 1.0);
+}
+)";
+
+// unpacks the samples of the folded frame texture and demosaics them; PACKING, MONO and HALF are defined in front
+const char* kDemosaicShader = R"(
+precision highp float;
+precision highp int;
+precision highp usampler2D;
+
+uniform usampler2D u_src;
+uniform ivec2 u_size;
+uniform int u_tex_width;
+uniform int u_row_texels;
+uniform ivec2 u_red;
+uniform uint u_mask;
+uniform float u_black;
+uniform vec3 u_gain;
+uniform float u_inv_gamma;
+out vec4 o_color;
+
+uint texel(int index, int y) {
+    int linear = y * u_row_texels + index;
+    return texelFetch(u_src, ivec2(linear % u_tex_width, linear / u_tex_width), 0).r;
+}
+
+float sampleAt(ivec2 p) {
+    // mirrored without repeating the border, which keeps the bayer phase
+    p = abs(p);
+    p = min(p, 2 * u_size - 2 - p);
+#if PACKING == 0
+    uint v = texel(p.x, p.y);
+#elif PACKING == 1
+    uint v = texel(p.x, p.y) & u_mask;
+#elif PACKING == 2
+    int group = (p.x >> 2) * 5;
+    int i = p.x & 3;
+    uint v = (texel(group + i, p.y) << 2) | ((texel(group + 4, p.y) >> uint(2 * i)) & 3u);
+#else
+    int group = (p.x >> 1) * 3;
+    int i = p.x & 1;
+    uint v = (texel(group + i, p.y) << 4) | ((texel(group + 2, p.y) >> uint(4 * i)) & 15u);
+#endif
+    return max(float(v) - u_black, 0.0);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec3 rgb;
+#if HALF
+    ivec2 b = 2 * p;
+#if MONO
+    rgb = vec3((sampleAt(b) + sampleAt(b + ivec2(1, 0)) + sampleAt(b + ivec2(0, 1)) + sampleAt(b + ivec2(1, 1))) *
+               0.25);
+#else
+    ivec2 blue = 1 - u_red;
+    float g = (sampleAt(b + ivec2(blue.x, u_red.y)) + sampleAt(b + ivec2(u_red.x, blue.y))) * 0.5;
+    rgb = vec3(sampleAt(b + u_red), g, sampleAt(b + blue));
+#endif
+#else
+    float c = sampleAt(p);
+#if MONO
+    rgb = vec3(c);
+#else
+    float h = (sampleAt(p + ivec2(-1, 0)) + sampleAt(p + ivec2(1, 0))) * 0.5;
+    float v = (sampleAt(p + ivec2(0, -1)) + sampleAt(p + ivec2(0, 1))) * 0.5;
+    float d = (sampleAt(p + ivec2(-1, -1)) + sampleAt(p + ivec2(1, -1)) + sampleAt(p + ivec2(-1, 1)) +
+               sampleAt(p + ivec2(1, 1))) * 0.25;
+    float x = (h + v) * 0.5;
+    ivec2 q = (p + u_red) & 1;
+    if (q.x == 0 && q.y == 0) {
+        rgb = vec3(c, x, d);
+    } else if (q.x == 1 && q.y == 1) {
+        rgb = vec3(d, x, c);
+    } else if (q.y == 0) {
+        rgb = vec3(h, c, v);
+    } else {
+        rgb = vec3(v, c, h);
+    }
+#endif
+#endif
+    rgb = clamp(rgb * u_gain, 0.0, 1.0);
+    if (u_inv_gamma != 1.0) {
+        rgb = pow(rgb, vec3(u_inv_gamma));
+    }
+    o_color = vec4(rgb, 1.0);
+}
+)";
+
+// maps every preview pixel through the steps of `RemapLut::build()` and samples the demosaiced image
+const char* kCorrectShader = R"(
+precision highp float;
+precision highp int;
+
+uniform sampler2D u_rgb;
+uniform vec2 u_scale;
+uniform vec2 u_src_size;
+uniform vec4 u_crop;
+uniform vec4 u_rotation;
+uniform float u_pers[8];
+uniform vec2 u_center;
+uniform float u_coeffs[8];
+uniform int u_coeff_count;
+uniform float u_pad_top;
+out vec4 o_color;
+
+void main() {
+    vec2 pos = gl_FragCoord.xy * u_scale - 0.5;
+#if CORRECT
+    if (u_rotation.x != 1.0 || u_rotation.y != 0.0) {
+        vec2 d = pos - u_rotation.zw;
+        pos = vec2(u_rotation.x * d.x - u_rotation.y * d.y, u_rotation.y * d.x + u_rotation.x * d.y) + u_rotation.zw;
+    }
+#if PERSPECTIVE
+    float w = u_pers[6] * pos.x + u_pers[7] * pos.y + 1.0;
+    pos = vec2(u_pers[0] * pos.x + u_pers[1] * pos.y + u_pers[2], u_pers[3] * pos.x + u_pers[4] * pos.y + u_pers[5]) /
+          w;
+#endif
+    if (u_coeff_count > 0) {
+        vec2 d = pos - u_center;
+        float r = length(d);
+        float factor = 0.0;
+        for (int i = u_coeff_count - 1; i >= 0; i--) {
+            factor = factor * r + u_coeffs[i];
+        }
+        pos = u_center + factor * d;
+    }
+    pos.y -= u_pad_top;
+#endif
+    // sampled before the test, so that the derivatives for the mipmap level are defined everywhere
+    vec4 color = texture(u_rgb, (pos + u_crop.xy + 0.5) / u_src_size);
+    bool inside = all(greaterThanEqual(pos, vec2(0.0))) && all(lessThanEqual(pos, u_crop.zw - 1.0));
+    o_color = inside ? color : vec4(0.0, 0.0, 0.0, 1.0);
+}
+)";
+
+GLuint compileShader(GLenum type, const std::string& source) {
+    GLuint shader = glCreateShader(type);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint linkProgram(const std::string& fragment) {
+    GLuint vs = compileShader(GL_VERTEX_SHADER, kVertexShader);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fragment);
+    GLuint program = 0;
+    if (vs != 0 && fs != 0) {
+        program = glCreateProgram();
+        glAttachShader(program, vs);
+        glAttachShader(program, fs);
+        glLinkProgram(program);
+        GLint ok = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (ok != GL_TRUE) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return program;
+}
+
+std::string define(const char* name, int value) {
+    return "#define " + std::string(name) + " " + std::to_string(value) + "\n";
+}
+
+// the position of the red sample in the 2x2 block
+void redPosition(BayerOrder order, GLint& x, GLint& y) {
+    x = order == BayerOrder::GRBG || order == BayerOrder::BGGR ? 1 : 0;
+    y = order == BayerOrder::GBRG || order == BayerOrder::BGGR ? 1 : 0;
+}
+
+GLuint createTexture(GLenum internal_format, GLsizei levels, GLsizei width, GLsizei height, GLint min_filter,
+                     GLint mag_filter) {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, internal_format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+GLuint createFramebuffer(GLuint texture) {
+    GLuint fbo = 0;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        glDeleteFramebuffers(1, &fbo);
+        return 0;
+    }
+    return fbo;
+}
+
+// restores the framebuffer, viewport and program bindings of the application on scope exit
+class GlStateSaver {
+   public:
+    GlStateSaver() {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_fbo_);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_fbo_);
+        glGetIntegerv(GL_VIEWPORT, viewport_);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program_);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture_);
+        glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_);
+    }
+    ~GlStateSaver() {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(draw_fbo_));
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(read_fbo_));
+        glViewport(viewport_[0], viewport_[1], viewport_[2], viewport_[3]);
+        glUseProgram(static_cast<GLuint>(program_));
+        glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(texture_));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(unpack_));
+    }
+
+   private:
+    GLint draw_fbo_ = 0;
+    GLint read_fbo_ = 0;
+    GLint viewport_[4] = {0, 0, 0, 0};
+    GLint program_ = 0;
+    GLint texture_ = 0;
+    GLint unpack_ = 0;
+};
+
+}  // namespace
+
+std::unique_ptr<GlContext> GlContext::createHeadless() {
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || eglInitialize(display, nullptr, nullptr) != EGL_TRUE) {
+        return nullptr;
+    }
+    std::unique_ptr<GlContext> context(new GlContext());
+    context->display_ = display;
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT, EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint count = 0;
+    if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE ||
+        eglChooseConfig(display, config_attribs, &config, 1, &count) != EGL_TRUE || count < 1) {
+        return nullptr;
+    }
+    const EGLint surface_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    context->surface_ = eglCreatePbufferSurface(display, config, surface_attribs);
+    const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+    context->context_ = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (context->surface_ == EGL_NO_SURFACE || context->context_ == EGL_NO_CONTEXT) {
+        return nullptr;
+    }
+    return context;
+}
+
+GlContext::~GlContext() {
+    if (display_ == nullptr) {
+        return;
+    }
+    release();
+    if (context_ != EGL_NO_CONTEXT) {
+        eglDestroyContext(display_, context_);
+    }
+    if (surface_ != EGL_NO_SURFACE) {
+        eglDestroySurface(display_, surface_);
+    }
+    eglTerminate(display_);
+}
+
+bool GlContext::makeCurrent() { return eglMakeCurrent(display_, surface_, surface_, context_) == EGL_TRUE; }
+
+void GlContext::release() { eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT); }
+
+std::unique_ptr<GpuPreview> GpuPreview::create(const GpuPreviewOptions& options) {
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    if (version == nullptr || std::strstr(version, "OpenGL ES 3") == nullptr) {
+        return nullptr;
+    }
+    std::unique_ptr<GpuPreview> preview(new GpuPreview());
+    preview->options_ = options;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &preview->max_texture_size_);
+    return preview;
+}
+
+GpuPreview::~GpuPreview() { release(); }
+
+void GpuPreview::release() {
+    glDeleteProgram(demosaic_program_);
+    glDeleteProgram(correct_program_);
+    glDeleteFramebuffers(1, &rgb_fbo_);
+    glDeleteFramebuffers(1, &preview_fbo_);
+    glDeleteTextures(1, &src_texture_);
+    glDeleteTextures(1, &rgb_texture_);
+    glDeleteTextures(1, &preview_texture_);
+    glDeleteBuffers(2, pbo_);
+    demosaic_program_ = correct_program_ = 0;
+    rgb_fbo_ = preview_fbo_ = 0;
+    src_texture_ = rgb_texture_ = preview_texture_ = 0;
+    pbo_[0] = pbo_[1] = 0;
+    width_ = height_ = 0;
+    has_frame_ = false;
+}
+
+void GpuPreview::setOptions(const GpuPreviewOptions& options) {
+    options_ = options;
+    dirty_ = true;
+}
+
+bool GpuPreview::configure(const Frame& frame, PixelPacking packing) {
+    release();
+    const ArducamFrameFormat& format = frame.format;
+    const uint32_t width = format.width;
+    const uint32_t height = format.height;
+    const bool mono = isMono(formatMode(format));
+    const int max_size = max_texture_size_;
+    if (!mono && (width < 2 || height < 2 || width % 2 != 0 || height % 2 != 0)) {
+        return false;
+    }
+    if (options_.correct) {
+        if (options_.correction.coeffs.size() > kMaxCoeffs ||
+            !correctedSize(options_.correction, width, height, corrected_width_, corrected_height_)) {
+            return false;
+        }
+    } else {
+        corrected_width_ = width;
+        corrected_height_ = height;
+    }
+    width_ = options_.width;
+    height_ = options_.height;
+    if (width_ == 0 && height_ == 0) {
+        width_ = corrected_width_;
+        height_ = corrected_height_;
+    } else if (width_ == 0) {
+        width_ = std::max<uint32_t>(1, static_cast<uint32_t>(uint64_t(height_) * corrected_width_ / corrected_height_));
+    } else if (height_ == 0) {
+        height_ = std::max<uint32_t>(1, static_cast<uint32_t>(uint64_t(width_) * corrected_height_ / corrected_width_));
+    }
+    if (width_ > static_cast<uint32_t>(max_size) || height_ > static_cast<uint32_t>(max_size)) {
+        return false;
+    }
+
+    // the frame texture: one 8-bit texel per byte, or one 16-bit texel per sample; a row that does not fit the size
+    // limit is split into `fold` texture rows of equal length
+    const bool wide = packing == PixelPacking::Bits16;
+    row_texels_ = wide ? width : static_cast<uint32_t>(packedRowSize(packing, width));
+    uint32_t fold = 1;
+    while (row_texels_ / fold > static_cast<uint32_t>(max_size) || row_texels_ % fold != 0) {
+        if (++fold > row_texels_) {
+            return false;
+        }
+    }
+    src_tex_width_ = row_texels_ / fold;
+    const uint32_t src_tex_height = height * fold;
+    if (src_tex_height > static_cast<uint32_t>(max_size)) {
+        return false;
+    }
+    frame_bytes_ = packedRowSize(packing, width) * height;
+    src_texture_ = createTexture(wide ? GL_R16UI : GL_R8UI, 1, src_tex_width_, src_tex_height, GL_NEAREST, GL_NEAREST);
+    glGenBuffers(2, pbo_);
+    for (GLuint pbo : pbo_) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, frame_bytes_, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // a preview of at most half the image gets one demosaiced texel per 2x2 block
+    half_ = (width_ * 2 <= corrected_width_ && height_ * 2 <= corrected_height_) || width > uint32_t(max_size) ||
+            height > uint32_t(max_size);
+    half_ = half_ && width % 2 == 0 && height % 2 == 0;
+    rgb_width_ = half_ ? width / 2 : width;
+    rgb_height_ = half_ ? height / 2 : height;
+    if (rgb_width_ > static_cast<uint32_t>(max_size) || rgb_height_ > static_cast<uint32_t>(max_size)) {
+        return false;
+    }
+    const double ratio = std::max(double(corrected_width_) / width_, double(corrected_height_) / height_) *
+                         (half_ ? 0.5 : 1.0);
+    mipmaps_ = ratio >= 2.0;
+    GLsizei levels = 1;
+    if (mipmaps_) {
+        for (uint32_t size = std::max(rgb_width_, rgb_height_); size > 1; size >>= 1) {
+            levels++;
+        }
+    }
+    rgb_texture_ = createTexture(GL_RGBA8, levels, rgb_width_, rgb_height_,
+                                 mipmaps_ ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, GL_LINEAR);
+    rgb_fbo_ = createFramebuffer(rgb_texture_);
+    preview_texture_ = createTexture(GL_RGBA8, 1, width_, height_, GL_LINEAR, GL_LINEAR);
+    preview_fbo_ = createFramebuffer(preview_texture_);
+    if (rgb_fbo_ == 0 || preview_fbo_ == 0) {
+        return false;
+    }
+
+    const int packing_index = packing == PixelPacking::Bits8    ? 0
+                              : packing == PixelPacking::Bits16 ? 1
+                              : packing == PixelPacking::Raw10Packed ? 2
+                                                                     : 3;
+    demosaic_program_ = linkProgram("#version 300 es\n" + define("PACKING", packing_index) +
+                                    define("MONO", mono ? 1 : 0) + define("HALF", half_ ? 1 : 0) + kDemosaicShader);
+    const CorrectionParams& c = options_.correction;
+    correct_program_ = linkProgram("#version 300 es\n" + define("CORRECT", options_.correct ? 1 : 0) +
+                                   define("PERSPECTIVE", options_.correct && c.perspective ? 1 : 0) + kCorrectShader);
+    if (demosaic_program_ == 0 || correct_program_ == 0) {
+        return false;
+    }
+
+    const uint8_t bit_width = std::min<uint8_t>(std::max<uint8_t>(format.bit_width, 1), 16);
+    const uint32_t mask = (1u << bit_width) - 1;
+    const float full = static_cast<float>(mask);
+    GLint red_x, red_y;
+    redPosition(bayerOrder(format), red_x, red_y);
+    GLuint p = demosaic_program_;
+    glUseProgram(p);
+    glUniform1i(glGetUniformLocation(p, "u_src"), 0);
+    glUniform2i(glGetUniformLocation(p, "u_size"), GLint(width), GLint(height));
+    glUniform1i(glGetUniformLocation(p, "u_tex_width"), GLint(src_tex_width_));
+    glUniform1i(glGetUniformLocation(p, "u_row_texels"), GLint(row_texels_));
+    glUniform2i(glGetUniformLocation(p, "u_red"), red_x, red_y);
+    glUniform1ui(glGetUniformLocation(p, "u_mask"), mask);
+    glUniform1f(glGetUniformLocation(p, "u_black"), options_.black_level);
+    const float red = mono ? 1.0f : options_.red_gain;
+    const float green = mono ? 1.0f : options_.green_gain;
+    const float blue = mono ? 1.0f : options_.blue_gain;
+    glUniform3f(glGetUniformLocation(p, "u_gain"), red / full, green / full, blue / full);
+    glUniform1f(glGetUniformLocation(p, "u_inv_gamma"), options_.gamma > 0 ? 1.0f / options_.gamma : 1.0f);
+
+    p = correct_program_;
+    glUseProgram(p);
+    glUniform1i(glGetUniformLocation(p, "u_rgb"), 0);
+    glUniform2f(glGetUniformLocation(p, "u_scale"), float(corrected_width_) / width_,
+                float(corrected_height_) / height_);
+    glUniform2f(glGetUniformLocation(p, "u_src_size"), float(width), float(height));
+    if (options_.correct) {
+        uint32_t crop_width, crop_height;
+        correctedSize(c, width, height, crop_width, crop_height);
+        crop_height -= c.pad_top + c.pad_bottom;
+        glUniform4f(glGetUniformLocation(p, "u_crop"), float(c.crop_x), float(c.crop_y), float(crop_width),
+                    float(crop_height));
+        // `cv2.getRotationMatrix2D` turns about the integer center; the map needs the inverse rotation
+        const double angle = c.rotation * kPi / 180.0;
+        glUniform4f(glGetUniformLocation(p, "u_rotation"), float(std::cos(angle)), float(std::sin(angle)),
+                    float(corrected_width_ / 2), float(corrected_height_ / 2));
+        GLfloat pers[8];
+        for (int i = 0; i < 8; i++) {
+            pers[i] = static_cast<GLfloat>(c.pers_coef[i]);
+        }
+        glUniform1fv(glGetUniformLocation(p, "u_pers"), 8, pers);
+        GLfloat coeffs[kMaxCoeffs] = {};
+        for (size_t i = 0; i < c.coeffs.size(); i++) {
+            coeffs[i] = static_cast<GLfloat>(c.coeffs[i]);
+        }
+        glUniform1fv(glGetUniformLocation(p, "u_coeffs"), kMaxCoeffs, coeffs);
+        glUniform1i(glGetUniformLocation(p, "u_coeff_count"), c.radial ? GLint(c.coeffs.size()) : 0);
+        glUniform2f(glGetUniformLocation(p, "u_center"), float(c.xcenter), float(c.ycenter + c.pad_top));
+        glUniform1f(glGetUniformLocation(p, "u_pad_top"), float(c.pad_top));
+    } else {
+        glUniform4f(glGetUniformLocation(p, "u_crop"), 0.0f, 0.0f, float(width), float(height));
+    }
+
+    format_ = format;
+    packing_ = packing;
+    return true;
+}
+
+bool GpuPreview::upload(const Frame& frame) {
+    const ArducamFormatMode mode = formatMode(frame.format);
+    const PixelPacking packing = detectPacking(frame);
+    if (frame.data == nullptr || packing == PixelPacking::Unknown || (!isBayer(mode) && !isMono(mode))) {
+        return false;
+    }
+    GlStateSaver saver;
+    if (dirty_ || packing != packing_ || frame.format.width != format_.width ||
+        frame.format.height != format_.height || frame.format.bit_width != format_.bit_width ||
+        frame.format.format != format_.format) {
+        dirty_ = false;
+        if (!configure(frame, packing)) {
+            // configured again with the next frame
+            release();
+            dirty_ = true;
+            return false;
+        }
+    }
+
+    // the buffer the GPU read from two uploads ago is free again; invalidating lets the driver hand out fresh memory
+    // instead of waiting for the texture copy
+    const GLuint pbo = pbo_[pbo_index_];
+    pbo_index_ ^= 1;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    void* mapped =
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame_bytes_, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped == nullptr) {
+        return false;
+    }
+    std::memcpy(mapped, frame.data, frame_bytes_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindTexture(GL_TEXTURE_2D, src_texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    const bool wide = packing_ == PixelPacking::Bits16;
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, src_tex_width_, GLsizei(frame_bytes_ / (wide ? 2 : 1) / src_tex_width_),
+                    GL_RED_INTEGER, wide ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, nullptr);
+    has_frame_ = true;
+    return true;
+}
+
+bool GpuPreview::render() {
+    if (!has_frame_) {
+        return false;
+    }
+    GlStateSaver saver;
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, rgb_fbo_);
+    glViewport(0, 0, rgb_width_, rgb_height_);
+    glUseProgram(demosaic_program_);
+    glBindTexture(GL_TEXTURE_2D, src_texture_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindTexture(GL_TEXTURE_2D, rgb_texture_);
+    if (mipmaps_) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, preview_fbo_);
+    glViewport(0, 0, width_, height_);
+    glUseProgram(correct_program_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    return true;
+}
+
+void GpuPreview::draw(int x, int y, int width, int height) {
+    if (preview_fbo_ == 0) {
+        return;
+    }
+    GLint draw_fbo = 0;
+    GLint read_fbo = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_fbo);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_fbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, preview_fbo_);
+    // the first image row is texture row 0, i.e. at the bottom of a GL window: flipped
+    glBlitFramebuffer(0, 0, width_, height_, x, y + height, x + width, y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(read_fbo));
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(draw_fbo));
+}
+
+bool GpuPreview::readback(uint8_t* dst, size_t dst_stride) {
+    if (preview_fbo_ == 0 || !has_frame_) {
+        return false;
+    }
+    GlStateSaver saver;
+    const size_t row = static_cast<size_t>(width_) * 4;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, preview_fbo_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (dst_stride == 0 || dst_stride == row) {
+        glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, dst);
+    } else {
+        glPixelStorei(GL_PACK_ROW_LENGTH, GLint(dst_stride / 4));
+        glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, dst);
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    }
+    return glGetError() == GL_NO_ERROR;
+}
+
+}  // namespace Arducam
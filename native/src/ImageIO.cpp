@@ -0,0 +1,580 @@
+#include <arducam/ImageIO.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#if ARDUCAM_WITH_JPEG
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+#endif
+
+namespace Arducam {
+
+namespace {
+
+// TIFF / DNG tags
+constexpr uint16_t kTagNewSubfileType = 254;
+constexpr uint16_t kTagWidth = 256;
+constexpr uint16_t kTagHeight = 257;
+constexpr uint16_t kTagBitsPerSample = 258;
+constexpr uint16_t kTagCompression = 259;
+constexpr uint16_t kTagPhotometric = 262;
+constexpr uint16_t kTagStripOffsets = 273;
+constexpr uint16_t kTagSamplesPerPixel = 277;
+constexpr uint16_t kTagRowsPerStrip = 278;
+constexpr uint16_t kTagStripByteCounts = 279;
+constexpr uint16_t kTagPlanarConfig = 284;
+constexpr uint16_t kTagTileWidth = 322;
+constexpr uint16_t kTagSubIfds = 330;
+constexpr uint16_t kTagCfaRepeatPatternDim = 33421;
+constexpr uint16_t kTagCfaPattern = 33422;
+constexpr uint16_t kTagBlackLevel = 50714;
+constexpr uint16_t kTagWhiteLevel = 50717;
+
+constexpr uint32_t kPhotometricBlackIsZero = 1;
+constexpr uint32_t kPhotometricRgb = 2;
+constexpr uint32_t kPhotometricCfa = 32803;
+constexpr uint32_t kPhotometricLinearRaw = 34892;
+
+// bounds checked access to a TIFF file in memory
+class TiffFile {
+   public:
+    explicit TiffFile(const std::vector<uint8_t>& bytes) : bytes_(bytes) {}
+
+    bool parseHeader(uint32_t& first_ifd) {
+        if (bytes_.size() < 8) {
+            return false;
+        }
+        if (bytes_[0] == 'I' && bytes_[1] == 'I') {
+            big_endian_ = false;
+        } else if (bytes_[0] == 'M' && bytes_[1] == 'M') {
+            big_endian_ = true;
+        } else {
+            return false;
+        }
+        first_ifd = u32(4);
+        return u16(2) == 42;
+    }
+
+    bool bigEndian() const { return big_endian_; }
+    size_t size() const { return bytes_.size(); }
+    const uint8_t* data() const { return bytes_.data(); }
+
+    uint16_t u16(size_t offset) const {
+        if (offset + 2 > bytes_.size()) {
+            return 0;
+        }
+        const uint8_t* p = bytes_.data() + offset;
+        return big_endian_ ? uint16_t(p[0] << 8 | p[1]) : uint16_t(p[1] << 8 | p[0]);
+    }
+    uint32_t u32(size_t offset) const {
+        if (offset + 4 > bytes_.size()) {
+            return 0;
+        }
+        return big_endian_ ? uint32_t(u16(offset)) << 16 | u16(offset + 2)
+                           : uint32_t(u16(offset + 2)) << 16 | u16(offset);
+    }
+
+   private:
+    const std::vector<uint8_t>& bytes_;
+    bool big_endian_ = false;
+};
+
+struct IfdEntry {
+    uint16_t tag;
+    uint16_t type;
+    uint32_t count;
+    // the offset of the value, inline in the entry if it fits in 4 bytes
+    size_t offset;
+};
+
+size_t typeSize(uint16_t type) {
+    switch (type) {
+        case 1:   // BYTE
+        case 2:   // ASCII
+        case 6:   // SBYTE
+        case 7:   // UNDEFINED
+            return 1;
+        case 3:   // SHORT
+        case 8:   // SSHORT
+            return 2;
+        case 4:   // LONG
+        case 9:   // SLONG
+        case 13:  // IFD
+            return 4;
+        case 5:   // RATIONAL
+        case 10:  // SRATIONAL
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+class Ifd {
+   public:
+    bool parse(const TiffFile& file, uint32_t offset, uint32_t& next) {
+        entries_.clear();
+        const uint16_t count = file.u16(offset);
+        if (count == 0 || offset + 2 + size_t(count) * 12 + 4 > file.size()) {
+            return false;
+        }
+        for (uint16_t i = 0; i < count; i++) {
+            const size_t at = offset + 2 + size_t(i) * 12;
+            IfdEntry entry{file.u16(at), file.u16(at + 2), file.u32(at + 4), at + 8};
+            const size_t bytes = typeSize(entry.type) * entry.count;
+            if (bytes > 4) {
+                entry.offset = file.u32(at + 8);
+            }
+            if (typeSize(entry.type) != 0 && entry.offset + bytes <= file.size()) {
+                entries_.push_back(entry);
+            }
+        }
+        next = file.u32(offset + 2 + size_t(count) * 12);
+        return true;
+    }
+
+    const IfdEntry* find(uint16_t tag) const {
+        for (const IfdEntry& entry : entries_) {
+            if (entry.tag == tag) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // the `index`-th value of an integer or rational tag, rounded
+    uint32_t value(const TiffFile& file, uint16_t tag, uint32_t fallback = 0, uint32_t index = 0) const {
+        const IfdEntry* entry = find(tag);
+        if (entry == nullptr || index >= entry->count) {
+            return fallback;
+        }
+        const size_t at = entry->offset + index * typeSize(entry->type);
+        switch (typeSize(entry->type)) {
+            case 1:
+                return file.data()[at];
+            case 2:
+                return file.u16(at);
+            case 4:
+                return file.u32(at);
+            default: {
+                const uint32_t den = file.u32(at + 4);
+                return den != 0 ? (file.u32(at) + den / 2) / den : fallback;
+            }
+        }
+    }
+
+    uint32_t count(uint16_t tag) const {
+        const IfdEntry* entry = find(tag);
+        return entry != nullptr ? entry->count : 0;
+    }
+
+   private:
+    std::vector<IfdEntry> entries_;
+};
+
+bool isRawIfd(const TiffFile& file, const Ifd& ifd) {
+    const uint32_t photometric = ifd.value(file, kTagPhotometric);
+    return (ifd.value(file, kTagNewSubfileType) & 1) == 0 &&
+           (photometric == kPhotometricCfa ||
+            (photometric == kPhotometricLinearRaw && ifd.value(file, kTagSamplesPerPixel, 1) == 1));
+}
+
+// finds the raw image in the main IFD chain or in their SubIFDs
+bool findRawIfd(const TiffFile& file, uint32_t first, Ifd& raw) {
+    std::vector<uint32_t> pending{first};
+    // guards against IFD loops
+    for (size_t visited = 0; !pending.empty() && visited < 64; visited++) {
+        const uint32_t offset = pending.front();
+        pending.erase(pending.begin());
+        uint32_t next = 0;
+        Ifd ifd;
+        if (offset == 0 || !ifd.parse(file, offset, next)) {
+            continue;
+        }
+        if (isRawIfd(file, ifd)) {
+            raw = ifd;
+            return true;
+        }
+        for (uint32_t i = 0; i < ifd.count(kTagSubIfds); i++) {
+            pending.push_back(ifd.value(file, kTagSubIfds, 0, i));
+        }
+        pending.push_back(next);
+    }
+    return false;
+}
+
+bool bayerOrderOf(const TiffFile& file, const Ifd& ifd, BayerOrder& order) {
+    if (ifd.value(file, kTagCfaRepeatPatternDim, 2, 0) != 2 || ifd.value(file, kTagCfaRepeatPatternDim, 2, 1) != 2 ||
+        ifd.count(kTagCfaPattern) != 4) {
+        return false;
+    }
+    // 0 = red, 1 = green, 2 = blue
+    uint32_t pattern = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        pattern = pattern << 8 | ifd.value(file, kTagCfaPattern, 0, i);
+    }
+    switch (pattern) {
+        case 0x00010102:
+            order = BayerOrder::RGGB;
+            return true;
+        case 0x01000201:
+            order = BayerOrder::GRBG;
+            return true;
+        case 0x01020001:
+            order = BayerOrder::GBRG;
+            return true;
+        case 0x02010100:
+            order = BayerOrder::BGGR;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool endsWithNoCase(const std::string& name, const std::string& suffix) {
+    if (name.size() < suffix.size()) {
+        return false;
+    }
+    return std::equal(suffix.begin(), suffix.end(), name.end() - suffix.size(), [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+}
+
+void put16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(uint8_t(value));
+    out.push_back(uint8_t(value >> 8));
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t value) {
+    put16(out, uint16_t(value));
+    put16(out, uint16_t(value >> 16));
+}
+
+void putEntry(std::vector<uint8_t>& out, uint16_t tag, uint16_t type, uint32_t count, uint32_t value) {
+    put16(out, tag);
+    put16(out, type);
+    put32(out, count);
+    if (type == 3 && count == 1) {
+        put16(out, uint16_t(value));
+        put16(out, 0);
+    } else {
+        put32(out, value);
+    }
+}
+
+// the channels of a writable format, 0 if it is not supported
+uint32_t channelsOf(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::Rgb8:
+        case OutputFormat::Bgr8:
+        case OutputFormat::Rgb16:
+            return 3;
+        case OutputFormat::Y8:
+        case OutputFormat::Y16:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// copies a row to `out` as RGB or gray, widening 16-bit samples from `bit_width` to 16 bits
+void prepareRow(OutputFormat format, const uint8_t* src, uint32_t width, uint8_t bit_width, uint8_t* out) {
+    const size_t samples = size_t(width) * channelsOf(format);
+    if (format == OutputFormat::Bgr8) {
+        for (uint32_t x = 0; x < width; x++) {
+            out[3 * x] = src[3 * x + 2];
+            out[3 * x + 1] = src[3 * x + 1];
+            out[3 * x + 2] = src[3 * x];
+        }
+    } else if (outputPixelSize(format) / channelsOf(format) == 1 || bit_width >= 16) {
+        std::memcpy(out, src, samples * outputPixelSize(format) / channelsOf(format));
+    } else {
+        // shifts the samples up and repeats their top bits below, so that the white level maps to 65535
+        const int up = 16 - bit_width;
+        const int down = bit_width - up;
+        for (size_t i = 0; i < samples; i++) {
+            uint16_t v;
+            std::memcpy(&v, src + 2 * i, 2);
+            v = uint16_t(v << up | (down > 0 ? v >> down : 0));
+            std::memcpy(out + 2 * i, &v, 2);
+        }
+    }
+}
+
+}  // namespace
+
+bool readDng(const std::string& path, DngImage& image) {
+    std::vector<uint8_t> bytes;
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            return false;
+        }
+        bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+            return false;
+        }
+    }
+
+    TiffFile file(bytes);
+    uint32_t first = 0;
+    Ifd ifd;
+    if (!file.parseHeader(first) || !findRawIfd(file, first, ifd)) {
+        return false;
+    }
+    const uint32_t width = ifd.value(file, kTagWidth);
+    const uint32_t height = ifd.value(file, kTagHeight);
+    const uint32_t bits = ifd.value(file, kTagBitsPerSample, 1);
+    if (width < 2 || height < 2 || bits < 8 || bits > 16 || ifd.value(file, kTagCompression, 1) != 1 ||
+        ifd.find(kTagTileWidth) != nullptr || ifd.count(kTagStripOffsets) == 0 ||
+        ifd.count(kTagStripOffsets) != ifd.count(kTagStripByteCounts)) {
+        return false;
+    }
+    const bool mono = ifd.value(file, kTagPhotometric) == kPhotometricLinearRaw;
+    BayerOrder order = BayerOrder::RGGB;
+    if (!mono && !bayerOrderOf(file, ifd, order)) {
+        return false;
+    }
+
+    // 8 and 16 bit samples are whole bytes in file order, the others a big endian bit stream with byte aligned rows
+    const size_t row_bytes = (size_t(width) * bits + 7) / 8;
+    const uint32_t rows_per_strip = std::min(ifd.value(file, kTagRowsPerStrip, height), height);
+    image.data.resize(size_t(width) * height * 2);
+    uint8_t* dst = image.data.data();
+    uint32_t y = 0;
+    for (uint32_t strip = 0; strip < ifd.count(kTagStripOffsets) && y < height; strip++) {
+        const size_t offset = ifd.value(file, kTagStripOffsets, 0, strip);
+        const uint32_t rows = std::min(rows_per_strip, height - y);
+        if (rows_per_strip == 0 || offset + row_bytes * rows > file.size()) {
+            return false;
+        }
+        for (uint32_t r = 0; r < rows; r++, y++) {
+            const uint8_t* src = file.data() + offset + row_bytes * r;
+            uint16_t* out = reinterpret_cast<uint16_t*>(dst + size_t(y) * width * 2);
+            if (bits == 8) {
+                for (uint32_t x = 0; x < width; x++) {
+                    out[x] = src[x];
+                }
+            } else if (bits == 16) {
+                for (uint32_t x = 0; x < width; x++) {
+                    out[x] = file.bigEndian() ? uint16_t(src[2 * x] << 8 | src[2 * x + 1])
+                                              : uint16_t(src[2 * x + 1] << 8 | src[2 * x]);
+                }
+            } else {
+                uint32_t acc = 0;
+                uint32_t have = 0;
+                const uint32_t mask = (1u << bits) - 1;
+                for (uint32_t x = 0; x < width; x++) {
+                    while (have < bits) {
+                        acc = acc << 8 | *src++;
+                        have += 8;
+                    }
+                    have -= bits;
+                    out[x] = uint16_t(acc >> have & mask);
+                }
+            }
+        }
+    }
+    if (y < height) {
+        return false;
+    }
+
+    image.black_level = static_cast<uint16_t>(ifd.value(file, kTagBlackLevel));
+    image.white_level = ifd.value(file, kTagWhiteLevel, (1u << bits) - 1);
+    uint8_t bit_width = 8;
+    while (bit_width < 16 && (1u << bit_width) - 1 < image.white_level) {
+        bit_width++;
+    }
+
+    Frame& frame = image.frame;
+    frame = Frame{};
+    frame.format.width = width;
+    frame.format.height = height;
+    frame.format.bit_width = bit_width;
+    frame.format.format =
+        static_cast<uint16_t>((mono ? FORMAT_MODE_MON : FORMAT_MODE_RAW) << 8 | static_cast<uint16_t>(order));
+    frame.data = image.data.data();
+    frame.size = static_cast<uint32_t>(image.data.size());
+    frame.expected_size = frame.size;
+    frame.alloc_size = frame.size;
+    return true;
+}
+
+bool listFiles(const std::string& directory, const std::string& suffix, std::vector<std::string>& names) {
+    names.clear();
+#if defined(_WIN32)
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    do {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 && endsWithNoCase(data.cFileName, suffix)) {
+            names.push_back(data.cFileName);
+        }
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    while (const dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name != "." && name != ".." && endsWithNoCase(name, suffix)) {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+#endif
+    std::sort(names.begin(), names.end());
+    return true;
+}
+
+bool writeTiff(const std::string& path, OutputFormat format, uint32_t width, uint32_t height, const uint8_t* data,
+               size_t stride, uint8_t bit_width) {
+    const uint32_t channels = channelsOf(format);
+    if (channels == 0 || data == nullptr || width == 0 || height == 0) {
+        return false;
+    }
+    const size_t pixel_size = outputPixelSize(format);
+    const uint16_t sample_bits = static_cast<uint16_t>(pixel_size / channels * 8);
+    const size_t row_bytes = width * pixel_size;
+    const uint64_t image_bytes = uint64_t(row_bytes) * height;
+    if (stride == 0) {
+        stride = row_bytes;
+    }
+    if (image_bytes > 0xFFFFFF00ull) {
+        return false;
+    }
+
+    // header, pixel data as one strip, then the IFD and the per-channel BitsPerSample
+    constexpr uint16_t kEntries = 10;
+    const uint32_t ifd_offset = static_cast<uint32_t>((8 + image_bytes + 1) & ~uint64_t(1));
+    const uint32_t bits_offset = ifd_offset + 2 + kEntries * 12 + 4;
+    std::vector<uint8_t> header;
+    header.insert(header.end(), {'I', 'I', 42, 0});
+    put32(header, ifd_offset);
+
+    std::vector<uint8_t> ifd;
+    put16(ifd, kEntries);
+    putEntry(ifd, kTagWidth, 4, 1, width);
+    putEntry(ifd, kTagHeight, 4, 1, height);
+    putEntry(ifd, kTagBitsPerSample, 3, channels, channels == 1 ? sample_bits : bits_offset);
+    putEntry(ifd, kTagCompression, 3, 1, 1);
+    putEntry(ifd, kTagPhotometric, 3, 1, channels == 1 ? kPhotometricBlackIsZero : kPhotometricRgb);
+    putEntry(ifd, kTagStripOffsets, 4, 1, 8);
+    putEntry(ifd, kTagSamplesPerPixel, 3, 1, channels);
+    putEntry(ifd, kTagRowsPerStrip, 4, 1, height);
+    putEntry(ifd, kTagStripByteCounts, 4, 1, static_cast<uint32_t>(image_bytes));
+    putEntry(ifd, kTagPlanarConfig, 3, 1, 1);
+    put32(ifd, 0);
+    if (channels != 1) {
+        for (uint32_t c = 0; c < channels; c++) {
+            put16(ifd, sample_bits);
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    std::vector<uint8_t> row(row_bytes);
+    for (uint32_t y = 0; y < height; y++) {
+        prepareRow(format, data + stride * y, width, bit_width, row.data());
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row_bytes));
+    }
+    if ((image_bytes & 1) != 0) {
+        file.put(0);
+    }
+    file.write(reinterpret_cast<const char*>(ifd.data()), static_cast<std::streamsize>(ifd.size()));
+    return static_cast<bool>(file);
+}
+
+#if ARDUCAM_WITH_JPEG
+
+namespace {
+
+struct JpegError {
+    jpeg_error_mgr mgr;
+    std::jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) { std::longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jump, 1); }
+
+}  // namespace
+
+bool jpegSupported() { return true; }
+
+bool writeJpeg(const std::string& path, OutputFormat format, uint32_t width, uint32_t height, const uint8_t* data,
+               size_t stride, int quality) {
+    if ((format != OutputFormat::Rgb8 && format != OutputFormat::Bgr8 && format != OutputFormat::Y8) ||
+        data == nullptr || width == 0 || height == 0 || width > JPEG_MAX_DIMENSION || height > JPEG_MAX_DIMENSION) {
+        return false;
+    }
+    const size_t row_bytes = width * outputPixelSize(format);
+    if (stride == 0) {
+        stride = row_bytes;
+    }
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    // everything the error path touches lives outside of the `setjmp()` frame
+    std::vector<uint8_t> row(row_bytes);
+    jpeg_compress_struct cinfo;
+    JpegError error;
+    cinfo.err = jpeg_std_error(&error.mgr);
+    error.mgr.error_exit = jpegErrorExit;
+    if (setjmp(error.jump) != 0) {
+        jpeg_destroy_compress(&cinfo);
+        std::fclose(file);
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, file);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = format == OutputFormat::Y8 ? 1 : 3;
+    cinfo.in_color_space = format == OutputFormat::Y8 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, std::min(std::max(quality, 1), 100), TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const uint8_t* src = data + stride * cinfo.next_scanline;
+        JSAMPROW line = const_cast<JSAMPROW>(src);
+        if (format == OutputFormat::Bgr8) {
+            prepareRow(format, src, width, 8, row.data());
+            line = row.data();
+        }
+        jpeg_write_scanlines(&cinfo, &line, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return std::fclose(file) == 0;
+}
+
+#else
+
+bool jpegSupported() { return false; }
+
+bool writeJpeg(const std::string&, OutputFormat, uint32_t, uint32_t, const uint8_t*, size_t, int) { return false; }
+
+#endif
+
+}  // namespace Arducam
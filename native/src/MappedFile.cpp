@@ -0,0 +1,79 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Arducam {
+namespace detail {
+
+bool mapFile(const std::string& path, uint64_t min_size, MappedFile& file) {
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(handle, &file_size) && static_cast<uint64_t>(file_size.QuadPart) >= min_size) {
+        mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    // the mapping keeps the file open
+    CloseHandle(handle);
+    if (mapping == nullptr) {
+        return false;
+    }
+    const void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (base == nullptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    file.base = static_cast<const uint8_t*>(base);
+    file.size = static_cast<uint64_t>(file_size.QuadPart);
+    file.mapping = reinterpret_cast<intptr_t>(mapping);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void* base = MAP_FAILED;
+    // an empty file cannot be mapped, even when `min_size` allows it
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && static_cast<uint64_t>(st.st_size) >= min_size) {
+        base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // the mapping keeps the file open
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    file.base = static_cast<const uint8_t*>(base);
+    file.size = static_cast<uint64_t>(st.st_size);
+    file.mapping = 0;
+#endif
+    return true;
+}
+
+void unmapFile(const MappedFile& file) {
+    if (file.base == nullptr) {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(file.base);
+    CloseHandle(reinterpret_cast<HANDLE>(file.mapping));
+#else
+    munmap(const_cast<uint8_t*>(file.base), static_cast<size_t>(file.size));
+#endif
+}
+
+}  // namespace detail
+}  // namespace Arducam
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Arducam {
+namespace detail {
+
+/** A file mapped read-only into memory, shared by `RawReader` and `CompiledConfig`. */
+struct MappedFile {
+    const uint8_t* base = nullptr;
+    uint64_t size = 0;
+    /** The file mapping on Windows, 0 elsewhere. */
+    intptr_t mapping = 0;
+};
+
+/**
+ * Maps the whole file at `path` read-only. The file stays mapped after it is renamed, deleted or written by another
+ * process.
+ *
+ * @return `true` on success, `false` if the file cannot be opened or mapped or is shorter than `min_size` bytes.
+ */
+bool mapFile(const std::string& path, uint64_t min_size, MappedFile& file);
+
+/** Unmaps a file mapped by `mapFile()`. Does nothing if `file` is not mapped. */
+void unmapFile(const MappedFile& file);
+
+}  // namespace detail
+}  // namespace Arducam
@@ -0,0 +1,132 @@
+#include <arducam/OutputQueue.hpp>
+
+#include "Common.hpp"
+
+namespace Arducam {
+
+OutputQueue::OutputQueue(Camera& camera, EventDispatcher* events, size_t depth)
+    : camera_(camera), events_(events), depth_(depth) {
+    if (events_ != nullptr) {
+        listener_ = events_->addListener([this](EventCode event) {
+            if (event == EventCode::FrameEnd) {
+                pending_.fetch_add(1, std::memory_order_relaxed);
+                ready_.notify();
+            }
+        });
+        thread_ = std::thread(&OutputQueue::run, this);
+    }
+}
+
+OutputQueue::~OutputQueue() {
+    if (listener_ >= 0) {
+        events_->removeListener(listener_);
+    }
+    stopping_.store(true, std::memory_order_relaxed);
+    ready_.notify();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void OutputQueue::setDepth(size_t depth) {
+    depth_.store(depth, std::memory_order_relaxed);
+}
+
+void OutputQueue::setLatestOnly(bool latest_only) {
+    latest_only_.store(latest_only, std::memory_order_relaxed);
+}
+
+size_t OutputQueue::limit() const { return latestOnly() ? 1 : depth(); }
+
+size_t OutputQueue::recycleLocked(size_t keep) {
+    int avail = camera_.getAvailCount();
+    const uint32_t depth = avail > 0 ? static_cast<uint32_t>(avail) : 0;
+    last_depth_.store(depth, std::memory_order_relaxed);
+    detail::updateMax(max_depth_, depth);
+    if (keep == 0 || waiting_.load(std::memory_order_relaxed) != 0) {
+        return 0;
+    }
+    size_t recycled = 0;
+    while (avail > static_cast<int>(keep)) {
+        Frame frame;
+        if (!camera_.capture(frame, 0)) {
+            break;
+        }
+        camera_.freeImage(frame);
+        recycled++;
+        avail = camera_.getAvailCount();
+    }
+    if (recycled > 0) {
+        recycled_.fetch_add(recycled, std::memory_order_relaxed);
+    }
+    return recycled;
+}
+
+bool OutputQueue::capture(FrameRef& ref, int timeout) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recycleLocked(limit());
+        // from here to the end of the wait the trims leave the queue alone
+        waiting_.fetch_add(1, std::memory_order_relaxed);
+    }
+    const bool ok = captureRef(camera_, ref, timeout);
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+    if (!ok) {
+        return false;
+    }
+    captured_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+size_t OutputQueue::trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return recycleLocked(limit());
+}
+
+size_t OutputQueue::drain() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t recycled = 0;
+    Frame frame;
+    // not bounded by `getAvailCount()`, which may lag behind the queue
+    while (camera_.capture(frame, 0)) {
+        camera_.freeImage(frame);
+        recycled++;
+    }
+    recycled_.fetch_add(recycled, std::memory_order_relaxed);
+    last_depth_.store(0, std::memory_order_relaxed);
+    return recycled;
+}
+
+void OutputQueue::run() {
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        const bool event = pending_.exchange(0, std::memory_order_relaxed) != 0;
+        // a consumer holding the lock trims on its own
+        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+        if (lock.owns_lock()) {
+            recycleLocked(limit());
+            lock.unlock();
+        }
+        ready_.wait(
+            [&] {
+                return stopping_.load(std::memory_order_relaxed) || pending_.load(std::memory_order_relaxed) != 0;
+            },
+            event ? detail::kFrameEndWait : detail::kCapturePollTimeout);
+    }
+}
+
+OutputQueueStats OutputQueue::stats() const {
+    OutputQueueStats stats;
+    stats.captured = captured_.load(std::memory_order_relaxed);
+    stats.recycled = recycled_.load(std::memory_order_relaxed);
+    stats.depth = last_depth_.load(std::memory_order_relaxed);
+    stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void OutputQueue::resetStats() {
+    captured_.store(0, std::memory_order_relaxed);
+    recycled_.store(0, std::memory_order_relaxed);
+    max_depth_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace Arducam
@@ -0,0 +1,505 @@
+#include <arducam/PixelKernels.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include "PixelKernelsImpl.hpp"
+
+namespace Arducam {
+
+namespace {
+
+inline uint16_t avg(uint32_t a, uint32_t b) { return static_cast<uint16_t>((a + b + 1) >> 1); }
+
+inline uint32_t absDiff(uint32_t a, uint32_t b) { return a > b ? a - b : b - a; }
+
+void unpack8Scalar(const uint8_t* src, uint16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+void unpack16Scalar(const uint8_t* src, uint16_t* dst, size_t count, uint16_t mask) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = static_cast<uint16_t>((src[2 * i] | (src[2 * i + 1] << 8)) & mask);
+    }
+}
+
+void subtractBlackScalar(uint16_t* data, size_t count, uint16_t black) {
+    for (size_t i = 0; i < count; i++) {
+        data[i] = data[i] > black ? static_cast<uint16_t>(data[i] - black) : 0;
+    }
+}
+
+void demosaicRowScalar(const DemosaicRowArgs& args) { detail::demosaicRowRange(args, 0, args.width); }
+
+void packRgb16Scalar(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[3 * i + 0] = r[i];
+        dst[3 * i + 1] = g[i];
+        dst[3 * i + 2] = b[i];
+    }
+}
+
+void packRgb8Scalar(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint8_t* dst, size_t count, int shift,
+                    bool bgr) {
+    if (bgr) {
+        std::swap(r, b);
+    }
+    for (size_t i = 0; i < count; i++) {
+        dst[3 * i + 0] = static_cast<uint8_t>(std::min<uint32_t>(r[i] >> shift, 255));
+        dst[3 * i + 1] = static_cast<uint8_t>(std::min<uint32_t>(g[i] >> shift, 255));
+        dst[3 * i + 2] = static_cast<uint8_t>(std::min<uint32_t>(b[i] >> shift, 255));
+    }
+}
+
+void luma16Scalar(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = static_cast<uint16_t>((77u * r[i] + 150u * g[i] + 29u * b[i] + 128u) >> 8);
+    }
+}
+
+void narrow8Scalar(const uint16_t* src, uint8_t* dst, size_t count, int shift) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = static_cast<uint8_t>(std::min<uint32_t>(src[i] >> shift, 255));
+    }
+}
+
+void remapRowScalar(const RemapRowArgs& args) { detail::remapRowRange(args, 0, args.count); }
+
+void digestBytesScalar(const uint8_t* src, size_t size, ByteDigest& digest) {
+    uint64_t s1[8] = {};
+    uint64_t s2[8] = {};
+    uint8_t lo = 0xFF;
+    uint8_t hi = 0;
+    const size_t blocks = size / 32;
+    for (size_t i = 0; i < blocks; i++) {
+        const uint8_t* p = src + 32 * i;
+        for (int j = 0; j < 8; j++) {
+            uint32_t word;
+            std::memcpy(&word, p + 4 * j, sizeof(word));
+            s1[j] += word;
+            s2[j] += s1[j];
+        }
+        for (int j = 0; j < 32; j++) {
+            lo = std::min(lo, p[j]);
+            hi = std::max(hi, p[j]);
+        }
+    }
+    detail::digestFinish(s1, s2, src + 32 * blocks, size - 32 * blocks, lo, hi, digest);
+}
+
+// bilinear blend of `C` interleaved channels of type `T`, the weights sum to 1 << (2 * kRemapFracBits)
+template <typename T, int C>
+void remapPixels(const RemapRowArgs& args, uint32_t i0, uint32_t i1) {
+    constexpr uint32_t one = 1u << kRemapFracBits;
+    constexpr uint32_t round = 1u << (2 * kRemapFracBits - 1);
+    T* dst = reinterpret_cast<T*>(args.dst);
+    for (uint32_t i = i0; i < i1; i++) {
+        const uint16_t w = args.weights[i];
+        if (w == kRemapOutside) {
+            for (int c = 0; c < C; c++) {
+                dst[i * C + c] = 0;
+            }
+            continue;
+        }
+        const uint32_t fx = w & 0xFF;
+        const uint32_t fy = w >> 8;
+        const uint8_t* row = args.src + static_cast<size_t>((args.coords[i] >> 16) - args.src_y0) * args.src_stride;
+        const size_t x = (args.coords[i] & 0xFFFF) - args.src_x0;
+        const T* p0 = reinterpret_cast<const T*>(row) + x * C;
+        const T* p1 = reinterpret_cast<const T*>(row + args.src_stride) + x * C;
+        for (int c = 0; c < C; c++) {
+            uint32_t top = p0[c] * (one - fx) + p0[c + C] * fx;
+            uint32_t bottom = p1[c] * (one - fx) + p1[c + C] * fx;
+            dst[i * C + c] = static_cast<T>((top * (one - fy) + bottom * fy + round) >> (2 * kRemapFracBits));
+        }
+    }
+}
+
+const PixelKernelTable kScalarKernels = {
+    SimdLevel::Scalar,
+    unpack8Scalar,
+    unpack16Scalar,
+    detail::unpackRaw10Scalar,
+    detail::unpackRaw12Scalar,
+    subtractBlackScalar,
+    demosaicRowScalar,
+    packRgb16Scalar,
+    packRgb8Scalar,
+    luma16Scalar,
+    narrow8Scalar,
+    remapRowScalar,
+    digestBytesScalar,
+};
+
+// color layout of row `y`, see `DemosaicRowArgs`
+void bayerRow(BayerOrder order, uint32_t y, bool& red_row, bool& green_first) {
+    bool odd = (y & 1) != 0;
+    red_row = (order == BayerOrder::RGGB || order == BayerOrder::GRBG) != odd;
+    green_first = (order == BayerOrder::GRBG || order == BayerOrder::GBRG) != odd;
+}
+
+// mirrored row index without repeating the border row, which keeps the bayer phase
+inline uint32_t reflectRow(int64_t y, uint32_t height) {
+    if (y < 0) {
+        return 1;
+    }
+    if (y >= static_cast<int64_t>(height)) {
+        return height - 2;
+    }
+    return static_cast<uint32_t>(y);
+}
+
+void unpackRow(const PixelKernelTable& k, PixelPacking packing, const uint8_t* src, uint16_t* dst, uint32_t width,
+               uint16_t mask) {
+    switch (packing) {
+        case PixelPacking::Bits8:
+            k.unpack8(src, dst, width);
+            break;
+        case PixelPacking::Bits16:
+            k.unpack16(src, dst, width, mask);
+            break;
+        case PixelPacking::Raw10Packed:
+            k.unpackRaw10(src, dst, width);
+            break;
+        case PixelPacking::Raw12Packed:
+            k.unpackRaw12(src, dst, width);
+            break;
+        default:
+            break;
+    }
+}
+
+// writes one row of planar data in the requested output format
+void storeRow(const PixelKernelTable& k, OutputFormat output, const uint16_t* r, const uint16_t* g, const uint16_t* b,
+              uint8_t* dst, uint32_t width, int shift) {
+    switch (output) {
+        case OutputFormat::Raw16:
+            std::memcpy(dst, g, width * sizeof(uint16_t));
+            break;
+        case OutputFormat::Rgb16:
+            k.packRgb16(r, g, b, reinterpret_cast<uint16_t*>(dst), width);
+            break;
+        case OutputFormat::Rgb8:
+            k.packRgb8(r, g, b, dst, width, shift, false);
+            break;
+        case OutputFormat::Bgr8:
+            k.packRgb8(r, g, b, dst, width, shift, true);
+            break;
+        case OutputFormat::Y16:
+            k.luma16(r, g, b, reinterpret_cast<uint16_t*>(dst), width);
+            break;
+        case OutputFormat::Y8:
+            // the luma of a gray pixel is the pixel itself, so this is only reached with r == g == b
+            k.narrow8(g, dst, width, shift);
+            break;
+    }
+}
+
+}  // namespace
+
+namespace detail {
+
+void demosaicRowRange(const DemosaicRowArgs& args, uint32_t x0, uint32_t x1) {
+    const uint16_t* u = args.up;
+    const uint16_t* c = args.cur;
+    const uint16_t* d = args.down;
+    const uint32_t w = args.width;
+    uint16_t* own = args.red_row ? args.r : args.b;
+    uint16_t* other = args.red_row ? args.b : args.r;
+    uint16_t* g = args.g;
+    const bool edge_aware = args.method == DemosaicMethod::EdgeAware;
+
+    for (uint32_t x = x0; x < x1; x++) {
+        uint32_t xl = x == 0 ? 1 : x - 1;
+        uint32_t xr = x + 1 == w ? w - 2 : x + 1;
+        uint16_t h = avg(c[xl], c[xr]);
+        uint16_t v = avg(u[x], d[x]);
+        if (((x & 1) == 0) == args.green_first) {
+            g[x] = c[x];
+            own[x] = h;
+            other[x] = v;
+        } else {
+            uint16_t gi = avg(h, v);
+            if (edge_aware) {
+                uint32_t dh = absDiff(c[xl], c[xr]);
+                uint32_t dv = absDiff(u[x], d[x]);
+                gi = dh < dv ? h : (dv < dh ? v : gi);
+            }
+            own[x] = c[x];
+            g[x] = gi;
+            other[x] = avg(avg(u[xl], u[xr]), avg(d[xl], d[xr]));
+        }
+    }
+}
+
+void remapRowRange(const RemapRowArgs& args, uint32_t i0, uint32_t i1) {
+    switch (args.format) {
+        case OutputFormat::Raw16:
+        case OutputFormat::Y16:
+            remapPixels<uint16_t, 1>(args, i0, i1);
+            break;
+        case OutputFormat::Rgb16:
+            remapPixels<uint16_t, 3>(args, i0, i1);
+            break;
+        case OutputFormat::Rgb8:
+        case OutputFormat::Bgr8:
+            remapPixels<uint8_t, 3>(args, i0, i1);
+            break;
+        case OutputFormat::Y8:
+            remapPixels<uint8_t, 1>(args, i0, i1);
+            break;
+    }
+}
+
+void unpackRaw10Scalar(const uint8_t* src, uint16_t* dst, size_t count) {
+    for (size_t i = 0; i + 4 <= count; i += 4, src += 5) {
+        uint8_t low = src[4];
+        dst[i + 0] = static_cast<uint16_t>((src[0] << 2) | (low & 0x03));
+        dst[i + 1] = static_cast<uint16_t>((src[1] << 2) | ((low >> 2) & 0x03));
+        dst[i + 2] = static_cast<uint16_t>((src[2] << 2) | ((low >> 4) & 0x03));
+        dst[i + 3] = static_cast<uint16_t>((src[3] << 2) | ((low >> 6) & 0x03));
+    }
+}
+
+void digestFinish(const uint64_t s1[8], const uint64_t s2[8], const uint8_t* tail, size_t count, uint8_t lo,
+                  uint8_t hi, ByteDigest& digest) {
+    // FNV-1a over the lanes and the tail; the sums already carry the position of every block
+    constexpr uint64_t kPrime = 0x100000001B3ull;
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int j = 0; j < 8; j++) {
+        hash = (hash ^ s1[j]) * kPrime;
+        hash = (hash ^ s2[j]) * kPrime;
+    }
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ tail[i]) * kPrime;
+        lo = std::min(lo, tail[i]);
+        hi = std::max(hi, tail[i]);
+    }
+    digest.hash = hash ^ (hash >> 29);
+    digest.min = lo <= hi ? lo : 0;
+    digest.max = hi;
+}
+
+void unpackRaw12Scalar(const uint8_t* src, uint16_t* dst, size_t count) {
+    for (size_t i = 0; i + 2 <= count; i += 2, src += 3) {
+        uint8_t low = src[2];
+        dst[i + 0] = static_cast<uint16_t>((src[0] << 4) | (low & 0x0F));
+        dst[i + 1] = static_cast<uint16_t>((src[1] << 4) | (low >> 4));
+    }
+}
+
+}  // namespace detail
+
+size_t packedRowSize(PixelPacking packing, uint32_t width) {
+    switch (packing) {
+        case PixelPacking::Bits8:
+            return width;
+        case PixelPacking::Bits16:
+            return width * 2;
+        case PixelPacking::Raw10Packed:
+            return width * 5 / 4;
+        case PixelPacking::Raw12Packed:
+            return width * 3 / 2;
+        default:
+            return 0;
+    }
+}
+
+PixelPacking detectPacking(const Frame& frame) {
+    const ArducamFrameFormat& format = frame.format;
+    const size_t size = frame.size != 0 ? frame.size : frame.expected_size;
+    const size_t height = format.height;
+    if (format.width == 0 || height == 0) {
+        return PixelPacking::Unknown;
+    }
+    if (format.bit_width <= 8 && size == packedRowSize(PixelPacking::Bits8, format.width) * height) {
+        return PixelPacking::Bits8;
+    }
+    if (format.bit_width == 10 && format.width % 4 == 0 &&
+        size == packedRowSize(PixelPacking::Raw10Packed, format.width) * height) {
+        return PixelPacking::Raw10Packed;
+    }
+    if (format.bit_width == 12 && format.width % 2 == 0 &&
+        size == packedRowSize(PixelPacking::Raw12Packed, format.width) * height) {
+        return PixelPacking::Raw12Packed;
+    }
+    if (size >= packedRowSize(PixelPacking::Bits16, format.width) * height) {
+        return PixelPacking::Bits16;
+    }
+    return PixelPacking::Unknown;
+}
+
+const PixelKernelTable& scalarPixelKernels() { return kScalarKernels; }
+
+const PixelKernelTable& pixelKernels() {
+    static const PixelKernelTable* table = [] {
+        if (const PixelKernelTable* avx2 = detail::avx2PixelKernels()) {
+            return avx2;
+        }
+        if (const PixelKernelTable* neon = detail::neonPixelKernels()) {
+            return neon;
+        }
+        return &kScalarKernels;
+    }();
+    return *table;
+}
+
+bool unpackFrame(const Frame& frame, uint16_t* dst) {
+    const PixelPacking packing = detectPacking(frame);
+    if (packing == PixelPacking::Unknown || frame.data == nullptr) {
+        return false;
+    }
+    const PixelKernelTable& k = pixelKernels();
+    const uint32_t width = frame.format.width;
+    const size_t row_size = packedRowSize(packing, width);
+    const uint16_t mask = static_cast<uint16_t>((1u << std::min<uint8_t>(frame.format.bit_width, 16)) - 1);
+    for (uint32_t y = 0; y < frame.format.height; y++) {
+        unpackRow(k, packing, frame.data + y * row_size, dst + static_cast<size_t>(y) * width, width, mask);
+    }
+    return true;
+}
+
+void subtractBlackLevel(uint16_t* data, size_t count, uint16_t black) {
+    if (black != 0) {
+        pixelKernels().subtractBlack(data, count, black);
+    }
+}
+
+void demosaic(const uint16_t* raw, uint32_t width, uint32_t height, BayerOrder order, DemosaicMethod method,
+              uint16_t* rgb, uint16_t* scratch) {
+    const PixelKernelTable& k = pixelKernels();
+    DemosaicRowArgs args;
+    args.width = width;
+    args.method = method;
+    args.r = scratch;
+    args.g = scratch + width;
+    args.b = scratch + 2 * width;
+    for (uint32_t y = 0; y < height; y++) {
+        args.up = raw + static_cast<size_t>(reflectRow(int64_t(y) - 1, height)) * width;
+        args.cur = raw + static_cast<size_t>(y) * width;
+        args.down = raw + static_cast<size_t>(reflectRow(int64_t(y) + 1, height)) * width;
+        bayerRow(order, y, args.red_row, args.green_first);
+        k.demosaicRow(args);
+        k.packRgb16(args.r, args.g, args.b, rgb + static_cast<size_t>(y) * width * 3, width);
+    }
+}
+
+size_t outputPixelSize(OutputFormat output) {
+    switch (output) {
+        case OutputFormat::Raw16:
+        case OutputFormat::Y16:
+            return 2;
+        case OutputFormat::Rgb16:
+            return 6;
+        case OutputFormat::Rgb8:
+        case OutputFormat::Bgr8:
+            return 3;
+        case OutputFormat::Y8:
+            return 1;
+    }
+    return 0;
+}
+
+size_t convertScratchSize(const ArducamFrameFormat& format) { return static_cast<size_t>(format.width) * 6; }
+
+bool convertFrame(const Frame& frame, const ConvertOptions& options, uint8_t* dst, size_t dst_stride,
+                  uint16_t* scratch) {
+    if (dst_stride == 0) {
+        dst_stride = frame.format.width * outputPixelSize(options.output);
+    }
+    return convertFrameRegion(frame, options, 0, frame.format.width, 0, frame.format.height, dst, dst_stride, scratch);
+}
+
+bool convertFrameRegion(const Frame& frame, const ConvertOptions& options, uint32_t x0, uint32_t x1, uint32_t y0,
+                        uint32_t y1, uint8_t* dst, size_t dst_stride, uint16_t* scratch) {
+    const ArducamFormatMode mode = formatMode(frame.format);
+    const PixelPacking packing = detectPacking(frame);
+    const uint32_t width = frame.format.width;
+    const uint32_t height = frame.format.height;
+    if (frame.data == nullptr || packing == PixelPacking::Unknown || (!isBayer(mode) && !isMono(mode))) {
+        return false;
+    }
+    if (isBayer(mode) && (width < 2 || height < 2 || width % 2 != 0)) {
+        return false;
+    }
+    x1 = std::min(x1, width);
+    y1 = std::min(y1, height);
+    if (x0 >= x1 || y0 >= y1) {
+        return true;
+    }
+
+    const PixelKernelTable& k = pixelKernels();
+    const size_t src_row = packedRowSize(packing, width);
+    const uint8_t bit_width = std::min<uint8_t>(frame.format.bit_width, 16);
+    const uint16_t mask = static_cast<uint16_t>((1u << bit_width) - 1);
+    const int shift = bit_width > 8 ? bit_width - 8 : 0;
+
+    // the columns unpacked: whole packing groups on the bayer phase, with the neighbour columns the demosaic reads
+    const uint32_t group = packing == PixelPacking::Raw10Packed ? 4 : 2;
+    const uint32_t margin = isBayer(mode) ? 1 : 0;
+    const uint32_t ux0 = x0 > margin ? (x0 - margin) / group * group : 0;
+    const uint32_t ux1 = std::min(width, (x1 + margin + group - 1) / group * group);
+    const uint32_t count = ux1 - ux0;
+    const size_t src_offset = packedRowSize(packing, ux0);
+    const uint32_t skip = x0 - ux0;
+
+    auto loadRow = [&](uint32_t y, uint16_t* row) {
+        unpackRow(k, packing, frame.data + y * src_row + src_offset, row, count, mask);
+        if (options.black_level != 0) {
+            k.subtractBlack(row, count, options.black_level);
+        }
+    };
+
+    if (isMono(mode) || options.output == OutputFormat::Raw16) {
+        uint16_t* row = scratch;
+        for (uint32_t y = y0; y < y1; y++) {
+            loadRow(y, row);
+            storeRow(k, options.output == OutputFormat::Y16 ? OutputFormat::Raw16 : options.output, row + skip,
+                     row + skip, row + skip, dst + (y - y0) * dst_stride, x1 - x0, shift);
+        }
+        return true;
+    }
+
+    // three unpacked rows in a ring (row y lives in slot y % 3) and three planar output rows
+    uint16_t* ring[3] = {scratch, scratch + count, scratch + 2 * count};
+    DemosaicRowArgs args;
+    args.width = count;
+    args.method = options.method;
+    args.r = scratch + 3 * count;
+    args.g = scratch + 4 * count;
+    args.b = scratch + 5 * count;
+    uint16_t* y16 = args.r;
+
+    // the rows around the first one; above row 0 the ring holds row 1, its reflection
+    for (uint32_t y = y0 != 0 ? y0 - 1 : 0; y <= y0 + 1 && y < height; y++) {
+        loadRow(y, ring[y % 3]);
+    }
+    for (uint32_t y = y0; y < y1; y++) {
+        if (y + 1 < height && y > y0) {
+            loadRow(y + 1, ring[(y + 1) % 3]);
+        }
+        args.up = ring[reflectRow(int64_t(y) - 1, height) % 3];
+        args.cur = ring[y % 3];
+        args.down = ring[reflectRow(int64_t(y) + 1, height) % 3];
+        bayerRow(bayerOrder(frame.format), y, args.red_row, args.green_first);
+        k.demosaicRow(args);
+
+        uint8_t* out = dst + (y - y0) * dst_stride;
+        if (options.output == OutputFormat::Y8 || options.output == OutputFormat::Y16) {
+            // luma overwrites the red row, which is not needed afterwards
+            k.luma16(args.r + skip, args.g + skip, args.b + skip, y16 + skip, x1 - x0);
+            if (options.output == OutputFormat::Y8) {
+                k.narrow8(y16 + skip, out, x1 - x0, shift);
+            } else {
+                std::memcpy(out, y16 + skip, (x1 - x0) * sizeof(uint16_t));
+            }
+        } else {
+            storeRow(k, options.output, args.r + skip, args.g + skip, args.b + skip, out, x1 - x0, shift);
+        }
+    }
+    return true;
+}
+
+}  // namespace Arducam
@@ -0,0 +1,416 @@
+#include "PixelKernelsImpl.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include <algorithm>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ARDUCAM_AVX2
+#else
+// the kernels are compiled for AVX2 without requiring -mavx2 for the whole library, the table is only handed out
+// after checking the running CPU
+#define ARDUCAM_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Arducam {
+namespace detail {
+
+namespace {
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+ARDUCAM_AVX2 void unpack8Avx2(const uint8_t* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepu8_epi16(v));
+    }
+    for (; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+ARDUCAM_AVX2 void unpack16Avx2(const uint8_t* src, uint16_t* dst, size_t count, uint16_t mask) {
+    const __m256i m = _mm256_set1_epi16(static_cast<short>(mask));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_and_si256(v, m));
+    }
+    for (; i < count; i++) {
+        dst[i] = static_cast<uint16_t>((src[2 * i] | (src[2 * i + 1] << 8)) & mask);
+    }
+}
+
+// 16 pixels per step: each 128-bit lane takes 10 bytes (two 5 byte groups) and yields 8 pixels
+ARDUCAM_AVX2 void unpackRaw10Avx2(const uint8_t* src, uint16_t* dst, size_t count) {
+    const __m256i high = _mm256_setr_epi8(0, -1, 1, -1, 2, -1, 3, -1, 5, -1, 6, -1, 7, -1, 8, -1,  //
+                                          0, -1, 1, -1, 2, -1, 3, -1, 5, -1, 6, -1, 7, -1, 8, -1);
+    const __m256i low = _mm256_setr_epi8(4, -1, 4, -1, 4, -1, 4, -1, 9, -1, 9, -1, 9, -1, 9, -1,  //
+                                         4, -1, 4, -1, 4, -1, 4, -1, 9, -1, 9, -1, 9, -1, 9, -1);
+    // shifting left by 6 - 2i and then right by 6 extracts bits [2i, 2i + 2) without a per-lane shift instruction
+    const __m256i mul = _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1);
+    const __m256i three = _mm256_set1_epi16(3);
+    size_t i = 0;
+    // the second lane reads 16 bytes starting at byte 10, so 26 bytes must be readable
+    for (; i + 16 <= count && (count - i) * 5 / 4 >= 26; i += 16, src += 20) {
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 10)), 1);
+        __m256i h = _mm256_slli_epi16(_mm256_shuffle_epi8(v, high), 2);
+        __m256i l = _mm256_shuffle_epi8(v, low);
+        l = _mm256_and_si256(_mm256_srli_epi16(_mm256_mullo_epi16(l, mul), 6), three);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(h, l));
+    }
+    unpackRaw10Scalar(src, dst + i, count - i);
+}
+
+// 16 pixels per step: each 128-bit lane takes 12 bytes (four 3 byte groups) and yields 8 pixels
+ARDUCAM_AVX2 void unpackRaw12Avx2(const uint8_t* src, uint16_t* dst, size_t count) {
+    const __m256i high = _mm256_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1,  //
+                                          0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m256i low = _mm256_setr_epi8(2, -1, 2, -1, 5, -1, 5, -1, 8, -1, 8, -1, 11, -1, 11, -1,  //
+                                         2, -1, 2, -1, 5, -1, 5, -1, 8, -1, 8, -1, 11, -1, 11, -1);
+    const __m256i mul = _mm256_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1);
+    const __m256i nibble = _mm256_set1_epi16(0x0F);
+    size_t i = 0;
+    // the second lane reads 16 bytes starting at byte 12, so 28 bytes must be readable
+    for (; i + 16 <= count && (count - i) * 3 / 2 >= 28; i += 16, src += 24) {
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)), 1);
+        __m256i h = _mm256_slli_epi16(_mm256_shuffle_epi8(v, high), 4);
+        __m256i l = _mm256_shuffle_epi8(v, low);
+        l = _mm256_and_si256(_mm256_srli_epi16(_mm256_mullo_epi16(l, mul), 4), nibble);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(h, l));
+    }
+    unpackRaw12Scalar(src, dst + i, count - i);
+}
+
+ARDUCAM_AVX2 void subtractBlackAvx2(uint16_t* data, size_t count, uint16_t black) {
+    const __m256i b = _mm256_set1_epi16(static_cast<short>(black));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_subs_epu16(v, b));
+    }
+    for (; i < count; i++) {
+        data[i] = data[i] > black ? static_cast<uint16_t>(data[i] - black) : 0;
+    }
+}
+
+ARDUCAM_AVX2 inline __m256i load(const uint16_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+
+ARDUCAM_AVX2 inline void store(uint16_t* p, __m256i v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+
+// unsigned a < b
+ARDUCAM_AVX2 inline __m256i lessThan(__m256i a, __m256i b) {
+    return _mm256_andnot_si256(_mm256_cmpeq_epi16(a, b), _mm256_cmpeq_epi16(_mm256_min_epu16(a, b), a));
+}
+
+ARDUCAM_AVX2 inline __m256i absDiff(__m256i a, __m256i b) {
+    return _mm256_or_si256(_mm256_subs_epu16(a, b), _mm256_subs_epu16(b, a));
+}
+
+// every candidate value is computed for all 16 pixels and the bayer phase picks one with a fixed lane mask
+ARDUCAM_AVX2 void demosaicRowAvx2(const DemosaicRowArgs& args) {
+    const uint32_t w = args.width;
+    const uint16_t* u = args.up;
+    const uint16_t* c = args.cur;
+    const uint16_t* d = args.down;
+    uint16_t* own = args.red_row ? args.r : args.b;
+    uint16_t* other = args.red_row ? args.b : args.r;
+    uint16_t* g = args.g;
+    const bool edge_aware = args.method == DemosaicMethod::EdgeAware;
+
+    // the vector loop starts at x = 1, so lane 0 is a color sample if odd pixels are color samples, i.e. if the row
+    // starts with a green sample
+    const __m256i is_color = args.green_first
+                                 ? _mm256_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0)
+                                 : _mm256_setr_epi16(0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1, 0, -1);
+
+    detail::demosaicRowRange(args, 0, 1);
+    uint32_t x = 1;
+    for (; x + 17 <= w; x += 16) {
+        __m256i cl = load(c + x - 1);
+        __m256i cc = load(c + x);
+        __m256i cr = load(c + x + 1);
+        __m256i uc = load(u + x);
+        __m256i dc = load(d + x);
+        __m256i h = _mm256_avg_epu16(cl, cr);
+        __m256i v = _mm256_avg_epu16(uc, dc);
+        __m256i gi = _mm256_avg_epu16(h, v);
+        if (edge_aware) {
+            __m256i dh = absDiff(cl, cr);
+            __m256i dv = absDiff(uc, dc);
+            gi = _mm256_blendv_epi8(gi, h, lessThan(dh, dv));
+            gi = _mm256_blendv_epi8(gi, v, lessThan(dv, dh));
+        }
+        __m256i diag = _mm256_avg_epu16(_mm256_avg_epu16(load(u + x - 1), load(u + x + 1)),
+                                        _mm256_avg_epu16(load(d + x - 1), load(d + x + 1)));
+        store(own + x, _mm256_blendv_epi8(h, cc, is_color));
+        store(g + x, _mm256_blendv_epi8(cc, gi, is_color));
+        store(other + x, _mm256_blendv_epi8(v, diag, is_color));
+    }
+    detail::demosaicRowRange(args, x, w);
+}
+
+ARDUCAM_AVX2 void packRgb16Avx2(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* dst,
+                                size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[3 * i + 0] = r[i];
+        dst[3 * i + 1] = g[i];
+        dst[3 * i + 2] = b[i];
+    }
+}
+
+ARDUCAM_AVX2 void packRgb8Avx2(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint8_t* dst, size_t count,
+                               int shift, bool bgr) {
+    if (bgr) {
+        std::swap(r, b);
+    }
+    const __m128i s = _mm_cvtsi32_si128(shift);
+    alignas(32) uint8_t lanes[3][16];
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint16_t* planes[3] = {r, g, b};
+        for (int p = 0; p < 3; p++) {
+            __m256i v = _mm256_srl_epi16(load(planes[p] + i), s);
+            __m128i n = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes[p]), n);
+        }
+        uint8_t* out = dst + 3 * i;
+        for (int k = 0; k < 16; k++) {
+            out[3 * k + 0] = lanes[0][k];
+            out[3 * k + 1] = lanes[1][k];
+            out[3 * k + 2] = lanes[2][k];
+        }
+    }
+    for (; i < count; i++) {
+        dst[3 * i + 0] = static_cast<uint8_t>(std::min<uint32_t>(r[i] >> shift, 255));
+        dst[3 * i + 1] = static_cast<uint8_t>(std::min<uint32_t>(g[i] >> shift, 255));
+        dst[3 * i + 2] = static_cast<uint8_t>(std::min<uint32_t>(b[i] >> shift, 255));
+    }
+}
+
+ARDUCAM_AVX2 void luma16Avx2(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* dst, size_t count) {
+    const __m256i kr = _mm256_set1_epi32(77);
+    const __m256i kg = _mm256_set1_epi32(150);
+    const __m256i kb = _mm256_set1_epi32(29);
+    const __m256i round = _mm256_set1_epi32(128);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i vr = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i)));
+        __m256i vg = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(g + i)));
+        __m256i vb = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m256i y = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(vr, kr), _mm256_mullo_epi32(vg, kg)),
+                                     _mm256_add_epi32(_mm256_mullo_epi32(vb, kb), round));
+        y = _mm256_srli_epi32(y, 8);
+        __m128i n = _mm_packus_epi32(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), n);
+    }
+    for (; i < count; i++) {
+        dst[i] = static_cast<uint16_t>((77u * r[i] + 150u * g[i] + 29u * b[i] + 128u) >> 8);
+    }
+}
+
+ARDUCAM_AVX2 void narrow8Avx2(const uint16_t* src, uint8_t* dst, size_t count, int shift) {
+    const __m128i s = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_srl_epi16(load(src + i), s);
+        __m128i n = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), n);
+    }
+    for (; i < count; i++) {
+        dst[i] = static_cast<uint8_t>(std::min<uint32_t>(src[i] >> shift, 255));
+    }
+}
+
+ARDUCAM_AVX2 inline __m256i bilinear(__m256i p00, __m256i p01, __m256i p10, __m256i p11, __m256i fx, __m256i fy) {
+    const __m256i one = _mm256_set1_epi32(1 << kRemapFracBits);
+    const __m256i round = _mm256_set1_epi32(1 << (2 * kRemapFracBits - 1));
+    __m256i ifx = _mm256_sub_epi32(one, fx);
+    __m256i top = _mm256_add_epi32(_mm256_mullo_epi32(p00, ifx), _mm256_mullo_epi32(p01, fx));
+    __m256i bottom = _mm256_add_epi32(_mm256_mullo_epi32(p10, ifx), _mm256_mullo_epi32(p11, fx));
+    __m256i v = _mm256_add_epi32(_mm256_mullo_epi32(top, _mm256_sub_epi32(one, fy)), _mm256_mullo_epi32(bottom, fy));
+    return _mm256_srli_epi32(_mm256_add_epi32(v, round), 2 * kRemapFracBits);
+}
+
+// 8 pixels per step, one 32-bit lane each. A 32-bit gather at the top-left sample of a block fetches both columns of
+// a mono 8/16-bit block, or a whole RGB sample (a second gather 3 bytes further fetches the right column)
+ARDUCAM_AVX2 void remapRowAvx2(const RemapRowArgs& args) {
+    uint32_t pixel_size;
+    switch (args.format) {
+        case OutputFormat::Y8:
+            pixel_size = 1;
+            break;
+        case OutputFormat::Raw16:
+        case OutputFormat::Y16:
+            pixel_size = 2;
+            break;
+        case OutputFormat::Rgb8:
+        case OutputFormat::Bgr8:
+            pixel_size = 3;
+            break;
+        default:
+            remapRowRange(args, 0, args.count);
+            return;
+    }
+    // the furthest byte a step reads, relative to the top-left sample of a block
+    const size_t reach = args.src_stride + (pixel_size == 3 ? 7 : 4);
+    if (args.src_size > 0x7FFFFFFF || args.src_size < reach) {
+        remapRowRange(args, 0, args.count);
+        return;
+    }
+    const int* base = reinterpret_cast<const int*>(args.src);
+    const __m256i stride = _mm256_set1_epi32(static_cast<int>(args.src_stride));
+    const __m256i column0 = _mm256_set1_epi32(static_cast<int>(args.src_x0));
+    const __m256i row0 = _mm256_set1_epi32(static_cast<int>(args.src_y0));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i step = _mm256_set1_epi32(static_cast<int>(pixel_size));
+    const __m256i limit = _mm256_set1_epi32(static_cast<int>(args.src_size - reach));
+    const __m256i outside_value = _mm256_set1_epi32(kRemapOutside);
+    const __m256i low8 = _mm256_set1_epi32(0xFF);
+    const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+    const __m256i rgb_order = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,  //
+                                               0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    // the RGB store writes 4 bytes past the 8 pixels, which the next step (or the scalar tail) overwrites
+    const uint32_t tail = pixel_size == 3 ? 10 : 8;
+    uint32_t i = 0;
+    for (; i + tail <= args.count; i += 8) {
+        __m256i xy = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(args.coords + i));
+        __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(args.weights + i)));
+        __m256i outside = _mm256_cmpeq_epi32(w, outside_value);
+        __m256i fx = _mm256_and_si256(w, low8);
+        __m256i fy = _mm256_srli_epi32(w, 8);
+        // the outside pixels have coordinates 0, above and left of a window; they read its first pixel
+        const __m256i y = _mm256_max_epi32(_mm256_sub_epi32(_mm256_srli_epi32(xy, 16), row0), zero);
+        const __m256i x = _mm256_max_epi32(_mm256_sub_epi32(_mm256_and_si256(xy, low16), column0), zero);
+        __m256i top = _mm256_add_epi32(_mm256_mullo_epi32(y, stride), _mm256_mullo_epi32(x, step));
+        if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(top, limit))) != 0) {
+            remapRowRange(args, i, i + 8);
+            continue;
+        }
+        __m256i bottom = _mm256_add_epi32(top, stride);
+        __m256i a = _mm256_i32gather_epi32(base, top, 1);
+        __m256i b = _mm256_i32gather_epi32(base, bottom, 1);
+
+        if (pixel_size == 1) {
+            __m256i v = bilinear(_mm256_and_si256(a, low8), _mm256_and_si256(_mm256_srli_epi32(a, 8), low8),
+                                 _mm256_and_si256(b, low8), _mm256_and_si256(_mm256_srli_epi32(b, 8), low8), fx, fy);
+            v = _mm256_andnot_si256(outside, v);
+            __m128i n = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(args.dst + i), _mm_packus_epi16(n, n));
+        } else if (pixel_size == 2) {
+            __m256i v = bilinear(_mm256_and_si256(a, low16), _mm256_srli_epi32(a, 16), _mm256_and_si256(b, low16),
+                                 _mm256_srli_epi32(b, 16), fx, fy);
+            v = _mm256_andnot_si256(outside, v);
+            __m128i n = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(args.dst + 2 * i), n);
+        } else {
+            const __m256i three = _mm256_set1_epi32(3);
+            __m256i ar = _mm256_i32gather_epi32(base, _mm256_add_epi32(top, three), 1);
+            __m256i br = _mm256_i32gather_epi32(base, _mm256_add_epi32(bottom, three), 1);
+            __m256i px = _mm256_setzero_si256();
+            for (int c = 0; c < 3; c++) {
+                const __m128i shift = _mm_cvtsi32_si128(8 * c);
+                __m256i v = bilinear(_mm256_and_si256(_mm256_srl_epi32(a, shift), low8),
+                                     _mm256_and_si256(_mm256_srl_epi32(ar, shift), low8),
+                                     _mm256_and_si256(_mm256_srl_epi32(b, shift), low8),
+                                     _mm256_and_si256(_mm256_srl_epi32(br, shift), low8), fx, fy);
+                px = _mm256_or_si256(px, _mm256_sll_epi32(v, shift));
+            }
+            px = _mm256_shuffle_epi8(_mm256_andnot_si256(outside, px), rgb_order);
+            uint8_t* out = args.dst + 3 * i;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(px));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm256_extracti128_si256(px, 1));
+        }
+    }
+    remapRowRange(args, i, args.count);
+}
+
+// 32 bytes per step: the 8 words are widened into two registers of 64-bit lanes
+ARDUCAM_AVX2 void digestBytesAvx2(const uint8_t* src, size_t size, ByteDigest& digest) {
+    __m256i s1a = _mm256_setzero_si256();
+    __m256i s1b = _mm256_setzero_si256();
+    __m256i s2a = _mm256_setzero_si256();
+    __m256i s2b = _mm256_setzero_si256();
+    __m256i lo = _mm256_set1_epi8(-1);
+    __m256i hi = _mm256_setzero_si256();
+    const size_t blocks = size / 32;
+    for (size_t i = 0; i < blocks; i++) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32 * i));
+        s1a = _mm256_add_epi64(s1a, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+        s1b = _mm256_add_epi64(s1b, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1)));
+        s2a = _mm256_add_epi64(s2a, s1a);
+        s2b = _mm256_add_epi64(s2b, s1b);
+        lo = _mm256_min_epu8(lo, v);
+        hi = _mm256_max_epu8(hi, v);
+    }
+    alignas(32) uint64_t s1[8];
+    alignas(32) uint64_t s2[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(s1), s1a);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(s1 + 4), s1b);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(s2), s2a);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(s2 + 4), s2b);
+    // the 32 byte lanes of min and max down to one byte each
+    __m128i l = _mm_min_epu8(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1));
+    __m128i h = _mm_max_epu8(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1));
+    l = _mm_min_epu8(l, _mm_srli_si128(l, 8));
+    h = _mm_max_epu8(h, _mm_srli_si128(h, 8));
+    l = _mm_min_epu8(l, _mm_srli_si128(l, 4));
+    h = _mm_max_epu8(h, _mm_srli_si128(h, 4));
+    l = _mm_min_epu8(l, _mm_srli_si128(l, 2));
+    h = _mm_max_epu8(h, _mm_srli_si128(h, 2));
+    l = _mm_min_epu8(l, _mm_srli_si128(l, 1));
+    h = _mm_max_epu8(h, _mm_srli_si128(h, 1));
+    digestFinish(s1, s2, src + 32 * blocks, size - 32 * blocks, static_cast<uint8_t>(_mm_cvtsi128_si32(l)),
+                 static_cast<uint8_t>(_mm_cvtsi128_si32(h)), digest);
+}
+
+const PixelKernelTable kAvx2Kernels = {
+    SimdLevel::Avx2,
+    unpack8Avx2,
+    unpack16Avx2,
+    unpackRaw10Avx2,
+    unpackRaw12Avx2,
+    subtractBlackAvx2,
+    demosaicRowAvx2,
+    packRgb16Avx2,
+    packRgb8Avx2,
+    luma16Avx2,
+    narrow8Avx2,
+    remapRowAvx2,
+    digestBytesAvx2,
+};
+
+}  // namespace
+
+const PixelKernelTable* avx2PixelKernels() { return cpuHasAvx2() ? &kAvx2Kernels : nullptr; }
+
+}  // namespace detail
+}  // namespace Arducam
+
+#else
+
+namespace Arducam {
+namespace detail {
+
+const PixelKernelTable* avx2PixelKernels() { return nullptr; }
+
+}  // namespace detail
+}  // namespace Arducam
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <arducam/PixelKernels.hpp>
+
+namespace Arducam {
+namespace detail {
+
+/** Returns the AVX2 kernels, or null if the platform is not x86. */
+const PixelKernelTable* avx2PixelKernels();
+/** Returns the NEON kernels, or null if the platform has no NEON. */
+const PixelKernelTable* neonPixelKernels();
+
+/** Scalar demosaic of the pixels `[x0, x1)` of a row. Used by the SIMD kernels for borders and tails. */
+void demosaicRowRange(const DemosaicRowArgs& args, uint32_t x0, uint32_t x1);
+
+/** Scalar remap of the output pixels `[i0, i1)` of a row. Used by the SIMD kernels for tails. */
+void remapRowRange(const RemapRowArgs& args, uint32_t i0, uint32_t i1);
+
+/** Scalar RAW10 unpack, used by the SIMD kernels for tails. */
+void unpackRaw10Scalar(const uint8_t* src, uint16_t* dst, size_t count);
+/** Scalar RAW12 unpack, used by the SIMD kernels for tails. */
+void unpackRaw12Scalar(const uint8_t* src, uint16_t* dst, size_t count);
+
+/**
+ * Folds the lane sums of the 32 byte blocks of a digest, the `count` bytes after the last block and the smallest and
+ * largest byte of the blocks into `digest`. Shared by every `digestBytes` kernel so that their hashes agree.
+ */
+void digestFinish(const uint64_t s1[8], const uint64_t s2[8], const uint8_t* tail, size_t count, uint8_t lo,
+                  uint8_t hi, ByteDigest& digest);
+
+}  // namespace detail
+}  // namespace Arducam
@@ -0,0 +1,270 @@
+#include "PixelKernelsImpl.hpp"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <algorithm>
+#include <arm_neon.h>
+
+namespace Arducam {
+namespace detail {
+
+namespace {
+
+void unpack8Neon(const uint8_t* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(dst + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + i + 8, vmovl_u8(vget_high_u8(v)));
+    }
+    for (; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+void unpack16Neon(const uint8_t* src, uint16_t* dst, size_t count, uint16_t mask) {
+    const uint16x8_t m = vdupq_n_u16(mask);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(src + 2 * i));
+        vst1q_u16(dst + i, vandq_u16(v, m));
+    }
+    for (; i < count; i++) {
+        dst[i] = static_cast<uint16_t>((src[2 * i] | (src[2 * i + 1] << 8)) & mask);
+    }
+}
+
+#if defined(__aarch64__)
+// 8 pixels per step from 10 bytes (two 5 byte groups)
+void unpackRaw10Neon(const uint8_t* src, uint16_t* dst, size_t count) {
+    const uint8x16_t high = {0, 0xFF, 1, 0xFF, 2, 0xFF, 3, 0xFF, 5, 0xFF, 6, 0xFF, 7, 0xFF, 8, 0xFF};
+    const uint8x16_t low = {4, 0xFF, 4, 0xFF, 4, 0xFF, 4, 0xFF, 9, 0xFF, 9, 0xFF, 9, 0xFF, 9, 0xFF};
+    // negative shift counts shift right, extracting bits [2i, 2i + 2) of the low byte per lane
+    const int16x8_t shift = {0, -2, -4, -6, 0, -2, -4, -6};
+    const uint16x8_t three = vdupq_n_u16(3);
+    size_t i = 0;
+    // each step reads 16 bytes but only consumes 10
+    for (; i + 8 <= count && (count - i) * 5 / 4 >= 16; i += 8, src += 10) {
+        uint8x16_t v = vld1q_u8(src);
+        uint16x8_t h = vshlq_n_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, high)), 2);
+        uint16x8_t l = vandq_u16(vshlq_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, low)), shift), three);
+        vst1q_u16(dst + i, vorrq_u16(h, l));
+    }
+    unpackRaw10Scalar(src, dst + i, count - i);
+}
+
+// 8 pixels per step from 12 bytes (four 3 byte groups)
+void unpackRaw12Neon(const uint8_t* src, uint16_t* dst, size_t count) {
+    const uint8x16_t high = {0, 0xFF, 1, 0xFF, 3, 0xFF, 4, 0xFF, 6, 0xFF, 7, 0xFF, 9, 0xFF, 10, 0xFF};
+    const uint8x16_t low = {2, 0xFF, 2, 0xFF, 5, 0xFF, 5, 0xFF, 8, 0xFF, 8, 0xFF, 11, 0xFF, 11, 0xFF};
+    const int16x8_t shift = {0, -4, 0, -4, 0, -4, 0, -4};
+    const uint16x8_t nibble = vdupq_n_u16(0x0F);
+    size_t i = 0;
+    for (; i + 8 <= count && (count - i) * 3 / 2 >= 16; i += 8, src += 12) {
+        uint8x16_t v = vld1q_u8(src);
+        uint16x8_t h = vshlq_n_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, high)), 4);
+        uint16x8_t l = vandq_u16(vshlq_u16(vreinterpretq_u16_u8(vqtbl1q_u8(v, low)), shift), nibble);
+        vst1q_u16(dst + i, vorrq_u16(h, l));
+    }
+    unpackRaw12Scalar(src, dst + i, count - i);
+}
+#else
+// table lookups over a full q register need AArch64, 32-bit ARM uses the scalar unpack
+void unpackRaw10Neon(const uint8_t* src, uint16_t* dst, size_t count) { unpackRaw10Scalar(src, dst, count); }
+
+void unpackRaw12Neon(const uint8_t* src, uint16_t* dst, size_t count) { unpackRaw12Scalar(src, dst, count); }
+#endif
+
+void subtractBlackNeon(uint16_t* data, size_t count, uint16_t black) {
+    const uint16x8_t b = vdupq_n_u16(black);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u16(data + i, vqsubq_u16(vld1q_u16(data + i), b));
+    }
+    for (; i < count; i++) {
+        data[i] = data[i] > black ? static_cast<uint16_t>(data[i] - black) : 0;
+    }
+}
+
+// every candidate value is computed for all 8 pixels and the bayer phase picks one with a fixed lane mask
+void demosaicRowNeon(const DemosaicRowArgs& args) {
+    const uint32_t w = args.width;
+    const uint16_t* u = args.up;
+    const uint16_t* c = args.cur;
+    const uint16_t* d = args.down;
+    uint16_t* own = args.red_row ? args.r : args.b;
+    uint16_t* other = args.red_row ? args.b : args.r;
+    uint16_t* g = args.g;
+    const bool edge_aware = args.method == DemosaicMethod::EdgeAware;
+
+    // the vector loop starts at x = 1, so lane 0 is a color sample if odd pixels are color samples, i.e. if the row
+    // starts with a green sample
+    const uint16x8_t odd_lanes = {0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF};
+    const uint16x8_t is_color = args.green_first ? vmvnq_u16(odd_lanes) : odd_lanes;
+
+    detail::demosaicRowRange(args, 0, 1);
+    uint32_t x = 1;
+    for (; x + 9 <= w; x += 8) {
+        uint16x8_t cl = vld1q_u16(c + x - 1);
+        uint16x8_t cc = vld1q_u16(c + x);
+        uint16x8_t cr = vld1q_u16(c + x + 1);
+        uint16x8_t uc = vld1q_u16(u + x);
+        uint16x8_t dc = vld1q_u16(d + x);
+        uint16x8_t h = vrhaddq_u16(cl, cr);
+        uint16x8_t v = vrhaddq_u16(uc, dc);
+        uint16x8_t gi = vrhaddq_u16(h, v);
+        if (edge_aware) {
+            uint16x8_t dh = vabdq_u16(cl, cr);
+            uint16x8_t dv = vabdq_u16(uc, dc);
+            gi = vbslq_u16(vcltq_u16(dh, dv), h, gi);
+            gi = vbslq_u16(vcltq_u16(dv, dh), v, gi);
+        }
+        uint16x8_t diag = vrhaddq_u16(vrhaddq_u16(vld1q_u16(u + x - 1), vld1q_u16(u + x + 1)),
+                                      vrhaddq_u16(vld1q_u16(d + x - 1), vld1q_u16(d + x + 1)));
+        vst1q_u16(own + x, vbslq_u16(is_color, cc, h));
+        vst1q_u16(g + x, vbslq_u16(is_color, gi, cc));
+        vst1q_u16(other + x, vbslq_u16(is_color, diag, v));
+    }
+    detail::demosaicRowRange(args, x, w);
+}
+
+void packRgb16Neon(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint16x8x3_t v;
+        v.val[0] = vld1q_u16(r + i);
+        v.val[1] = vld1q_u16(g + i);
+        v.val[2] = vld1q_u16(b + i);
+        vst3q_u16(dst + 3 * i, v);
+    }
+    for (; i < count; i++) {
+        dst[3 * i + 0] = r[i];
+        dst[3 * i + 1] = g[i];
+        dst[3 * i + 2] = b[i];
+    }
+}
+
+void packRgb8Neon(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint8_t* dst, size_t count, int shift,
+                  bool bgr) {
+    if (bgr) {
+        std::swap(r, b);
+    }
+    const int16x8_t s = vdupq_n_s16(static_cast<int16_t>(-shift));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x3_t v;
+        v.val[0] = vqmovn_u16(vshlq_u16(vld1q_u16(r + i), s));
+        v.val[1] = vqmovn_u16(vshlq_u16(vld1q_u16(g + i), s));
+        v.val[2] = vqmovn_u16(vshlq_u16(vld1q_u16(b + i), s));
+        vst3_u8(dst + 3 * i, v);
+    }
+    for (; i < count; i++) {
+        dst[3 * i + 0] = static_cast<uint8_t>(std::min<uint32_t>(r[i] >> shift, 255));
+        dst[3 * i + 1] = static_cast<uint8_t>(std::min<uint32_t>(g[i] >> shift, 255));
+        dst[3 * i + 2] = static_cast<uint8_t>(std::min<uint32_t>(b[i] >> shift, 255));
+    }
+}
+
+void luma16Neon(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t vr = vld1q_u16(r + i);
+        uint16x8_t vg = vld1q_u16(g + i);
+        uint16x8_t vb = vld1q_u16(b + i);
+        uint32x4_t lo = vmull_n_u16(vget_low_u16(vr), 77);
+        uint32x4_t hi = vmull_n_u16(vget_high_u16(vr), 77);
+        lo = vmlal_n_u16(lo, vget_low_u16(vg), 150);
+        hi = vmlal_n_u16(hi, vget_high_u16(vg), 150);
+        lo = vmlal_n_u16(lo, vget_low_u16(vb), 29);
+        hi = vmlal_n_u16(hi, vget_high_u16(vb), 29);
+        vst1q_u16(dst + i, vcombine_u16(vqrshrn_n_u32(lo, 8), vqrshrn_n_u32(hi, 8)));
+    }
+    for (; i < count; i++) {
+        dst[i] = static_cast<uint16_t>((77u * r[i] + 150u * g[i] + 29u * b[i] + 128u) >> 8);
+    }
+}
+
+void narrow8Neon(const uint16_t* src, uint8_t* dst, size_t count, int shift) {
+    const int16x8_t s = vdupq_n_s16(static_cast<int16_t>(-shift));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1_u8(dst + i, vqmovn_u16(vshlq_u16(vld1q_u16(src + i), s)));
+    }
+    for (; i < count; i++) {
+        dst[i] = static_cast<uint8_t>(std::min<uint32_t>(src[i] >> shift, 255));
+    }
+}
+
+// NEON has no gather loads, so the fixed-point scalar loop is as fast as it gets for arbitrary source coordinates
+void remapRowNeon(const RemapRowArgs& args) { remapRowRange(args, 0, args.count); }
+
+// 32 bytes per step: the 8 words are widened into four registers of 64-bit lanes, two words each
+void digestBytesNeon(const uint8_t* src, size_t size, ByteDigest& digest) {
+    uint64x2_t s1[4] = {vdupq_n_u64(0), vdupq_n_u64(0), vdupq_n_u64(0), vdupq_n_u64(0)};
+    uint64x2_t s2[4] = {vdupq_n_u64(0), vdupq_n_u64(0), vdupq_n_u64(0), vdupq_n_u64(0)};
+    uint8x16_t lo = vdupq_n_u8(0xFF);
+    uint8x16_t hi = vdupq_n_u8(0);
+    const size_t blocks = size / 32;
+    for (size_t i = 0; i < blocks; i++) {
+        const uint8x16_t a = vld1q_u8(src + 32 * i);
+        const uint8x16_t b = vld1q_u8(src + 32 * i + 16);
+        const uint32x4_t wa = vreinterpretq_u32_u8(a);
+        const uint32x4_t wb = vreinterpretq_u32_u8(b);
+        s1[0] = vaddw_u32(s1[0], vget_low_u32(wa));
+        s1[1] = vaddw_u32(s1[1], vget_high_u32(wa));
+        s1[2] = vaddw_u32(s1[2], vget_low_u32(wb));
+        s1[3] = vaddw_u32(s1[3], vget_high_u32(wb));
+        for (int j = 0; j < 4; j++) {
+            s2[j] = vaddq_u64(s2[j], s1[j]);
+        }
+        lo = vminq_u8(lo, vminq_u8(a, b));
+        hi = vmaxq_u8(hi, vmaxq_u8(a, b));
+    }
+    uint64_t sums1[8];
+    uint64_t sums2[8];
+    for (int j = 0; j < 4; j++) {
+        vst1q_u64(sums1 + 2 * j, s1[j]);
+        vst1q_u64(sums2 + 2 * j, s2[j]);
+    }
+    uint8_t l[16];
+    uint8_t h[16];
+    vst1q_u8(l, lo);
+    vst1q_u8(h, hi);
+    digestFinish(sums1, sums2, src + 32 * blocks, size - 32 * blocks, *std::min_element(l, l + 16),
+                 *std::max_element(h, h + 16), digest);
+}
+
+const PixelKernelTable kNeonKernels = {
+    SimdLevel::Neon,
+    unpack8Neon,
+    unpack16Neon,
+    unpackRaw10Neon,
+    unpackRaw12Neon,
+    subtractBlackNeon,
+    demosaicRowNeon,
+    packRgb16Neon,
+    packRgb8Neon,
+    luma16Neon,
+    narrow8Neon,
+    remapRowNeon,
+    digestBytesNeon,
+};
+
+}  // namespace
+
+const PixelKernelTable* neonPixelKernels() { return &kNeonKernels; }
+
+}  // namespace detail
+}  // namespace Arducam
+
+#else
+
+namespace Arducam {
+namespace detail {
+
+const PixelKernelTable* neonPixelKernels() { return nullptr; }
+
+}  // namespace detail
+}  // namespace Arducam
+
+#endif
@@ -0,0 +1,509 @@
+#include <arducam/PixelPipeline.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Arducam {
+
+namespace {
+
+template <PixelPacking P>
+void unpackAs(const PixelKernelTable& k, const uint8_t* src, uint16_t* dst, size_t count, uint16_t mask) {
+    switch (P) {
+        case PixelPacking::Bits8:
+            k.unpack8(src, dst, count);
+            break;
+        case PixelPacking::Bits16:
+            k.unpack16(src, dst, count, mask);
+            break;
+        case PixelPacking::Raw10Packed:
+            k.unpackRaw10(src, dst, count);
+            break;
+        case PixelPacking::Raw12Packed:
+            k.unpackRaw12(src, dst, count);
+            break;
+        default:
+            break;
+    }
+}
+
+inline void applyLut(uint16_t* data, size_t count, const uint16_t* lut) {
+    for (size_t i = 0; i < count; i++) {
+        data[i] = lut[data[i]];
+    }
+}
+
+// one table for the even and one for the odd columns; `count` is even
+inline void applyLutPairs(uint16_t* data, size_t count, const uint16_t* even, const uint16_t* odd) {
+    for (size_t i = 0; i < count; i += 2) {
+        data[i] = even[data[i]];
+        data[i + 1] = odd[data[i + 1]];
+    }
+}
+
+// color layout of row `y`, see `DemosaicRowArgs`
+void bayerRow(BayerOrder order, uint32_t y, bool& red_row, bool& green_first) {
+    bool odd = (y & 1) != 0;
+    red_row = (order == BayerOrder::RGGB || order == BayerOrder::GRBG) != odd;
+    green_first = (order == BayerOrder::GRBG || order == BayerOrder::GBRG) != odd;
+}
+
+// mirrored row index without repeating the border row, which keeps the bayer phase
+inline uint32_t reflectRow(int64_t y, uint32_t height) {
+    if (y < 0) {
+        return 1;
+    }
+    if (y >= static_cast<int64_t>(height)) {
+        return height - 2;
+    }
+    return static_cast<uint32_t>(y);
+}
+
+inline uint16_t clamp8(int32_t v) { return static_cast<uint16_t>(std::min(std::max(v, 0), 255)); }
+
+inline uint16_t curve(double v, double full, float gamma) {
+    v = std::min(std::max(v, 0.0), full);
+    if (gamma != 1.0f && full > 0) {
+        v = full * std::pow(v / full, 1.0 / gamma);
+    }
+    return static_cast<uint16_t>(v + 0.5);
+}
+
+constexpr bool isSensorLayout(PixelLayout layout) {
+    return layout == PixelLayout::Bayer || layout == PixelLayout::RgbIr || layout == PixelLayout::Mono;
+}
+
+// writes one row of gray samples
+template <OutputFormat O>
+void storeGray(const PixelKernelTable& k, const uint16_t* row, uint8_t* dst, uint32_t width, int shift) {
+    switch (O) {
+        case OutputFormat::Raw16:
+        case OutputFormat::Y16:
+            std::memcpy(dst, row, width * sizeof(uint16_t));
+            break;
+        case OutputFormat::Rgb16:
+            k.packRgb16(row, row, row, reinterpret_cast<uint16_t*>(dst), width);
+            break;
+        case OutputFormat::Rgb8:
+        case OutputFormat::Bgr8:
+            k.packRgb8(row, row, row, dst, width, shift, O == OutputFormat::Bgr8);
+            break;
+        case OutputFormat::Y8:
+            k.narrow8(row, dst, width, shift);
+            break;
+    }
+}
+
+// writes one row of planar color samples; the luma outputs overwrite `r`
+template <OutputFormat O>
+void storeColor(const PixelKernelTable& k, uint16_t* r, const uint16_t* g, const uint16_t* b, uint8_t* dst,
+                uint32_t width, int shift) {
+    switch (O) {
+        case OutputFormat::Raw16:
+            std::memcpy(dst, g, width * sizeof(uint16_t));
+            break;
+        case OutputFormat::Rgb16:
+            k.packRgb16(r, g, b, reinterpret_cast<uint16_t*>(dst), width);
+            break;
+        case OutputFormat::Rgb8:
+        case OutputFormat::Bgr8:
+            k.packRgb8(r, g, b, dst, width, shift, O == OutputFormat::Bgr8);
+            break;
+        case OutputFormat::Y16:
+            k.luma16(r, g, b, reinterpret_cast<uint16_t*>(dst), width);
+            break;
+        case OutputFormat::Y8:
+            k.luma16(r, g, b, r, width);
+            k.narrow8(r, dst, width, shift);
+            break;
+    }
+}
+
+}  // namespace
+
+// the row stages, with access to the tables of the pipeline
+struct PipelineStages {
+    using RunFn = PixelPipeline::RunFn;
+
+    // unpack and sensor domain corrections of row `y`
+    static void loadRow(const PixelPipeline& p, const uint8_t* src, uint32_t y, uint16_t* row) {
+        const uint32_t width = p.format_.width;
+        p.unpack_(*p.kernels_, src + y * p.src_row_, row, width, p.mask_);
+        if (!p.sensor_lut_.empty()) {
+            const uint16_t* lut = p.sensor_lut_.data();
+            if (p.layout_ == PixelLayout::Mono) {
+                applyLut(row, width, lut);
+            } else {
+                const size_t phase = (y & 1) * 2;
+                applyLutPairs(row, width, lut + phase * p.sensor_lut_size_, lut + (phase + 1) * p.sensor_lut_size_);
+            }
+        } else if (p.options_.black_level != 0) {
+            p.kernels_->subtractBlack(row, width, p.options_.black_level);
+        }
+    }
+
+    // replaces the IR samples of an IR row by the average of their diagonal greens
+    static void fillIr(const PixelPipeline& p, const uint16_t* up, uint16_t* row, const uint16_t* down) {
+        const uint32_t width = p.format_.width;
+        for (uint32_t x = p.ir_column_; x < width; x += 2) {
+            const uint32_t xl = x == 0 ? 1 : x - 1;
+            const uint32_t xr = x + 1 == width ? width - 2 : x + 1;
+            row[x] = static_cast<uint16_t>((up[xl] + up[xr] + down[xl] + down[xr] + 2u) >> 2);
+        }
+    }
+
+    // mono frames, and the unpacked samples of bayer frames
+    template <OutputFormat O>
+    static void runGray(const PixelPipeline& p, const uint8_t* src, uint8_t* dst, size_t dst_stride,
+                        uint16_t* scratch) {
+        for (uint32_t y = 0; y < p.format_.height; y++) {
+            loadRow(p, src, y, scratch);
+            storeGray<O>(*p.kernels_, scratch, dst + y * dst_stride, p.format_.width, p.shift_);
+        }
+    }
+
+    template <PixelLayout L, OutputFormat O>
+    static void runMosaic(const PixelPipeline& p, const uint8_t* src, uint8_t* dst, size_t dst_stride,
+                          uint16_t* scratch) {
+        // unpacked rows in a ring (row y lives in slot y % kRing) and three planar output rows; RGB-IR keeps one row
+        // more, the one below the next IR row
+        constexpr uint32_t kRing = L == PixelLayout::RgbIr ? 4 : 3;
+        const PixelKernelTable& k = *p.kernels_;
+        const uint32_t width = p.format_.width;
+        const uint32_t height = p.format_.height;
+        uint16_t* ring[kRing];
+        for (uint32_t i = 0; i < kRing; i++) {
+            ring[i] = scratch + i * width;
+        }
+        DemosaicRowArgs args;
+        args.width = width;
+        args.method = p.options_.method;
+        args.r = scratch + kRing * width;
+        args.g = args.r + width;
+        args.b = args.g + width;
+        bool red_row[2];
+        bool green_first[2];
+        for (uint32_t parity = 0; parity < 2; parity++) {
+            bayerRow(bayerOrder(p.format_), parity, red_row[parity], green_first[parity]);
+        }
+        const uint16_t* lut = p.output_lut_.empty() ? nullptr : p.output_lut_.data();
+
+        uint32_t loaded = 0;
+        uint32_t filled = 0;
+        for (uint32_t y = 0; y < height; y++) {
+            const uint32_t last = std::min(y + (L == PixelLayout::RgbIr ? 2 : 1), height - 1);
+            for (; loaded <= last; loaded++) {
+                loadRow(p, src, loaded, ring[loaded % kRing]);
+            }
+            if (L == PixelLayout::RgbIr) {
+                // the neighbours of an IR row are color rows, which are never modified
+                for (; filled <= std::min(y + 1, height - 1); filled++) {
+                    if ((filled & 1) == p.ir_row_) {
+                        fillIr(p, ring[reflectRow(int64_t(filled) - 1, height) % kRing], ring[filled % kRing],
+                               ring[reflectRow(int64_t(filled) + 1, height) % kRing]);
+                    }
+                }
+            }
+            args.up = ring[reflectRow(int64_t(y) - 1, height) % kRing];
+            args.cur = ring[y % kRing];
+            args.down = ring[reflectRow(int64_t(y) + 1, height) % kRing];
+            args.red_row = red_row[y & 1];
+            args.green_first = green_first[y & 1];
+            k.demosaicRow(args);
+            if (lut != nullptr) {
+                applyLut(args.r, width, lut);
+                applyLut(args.g, width, lut);
+                applyLut(args.b, width, lut);
+            }
+            storeColor<O>(k, args.r, args.g, args.b, dst + y * dst_stride, width, p.shift_);
+        }
+    }
+
+    // splits one row of 8-bit color data into planar rows
+    template <PixelLayout L>
+    static void toPlanar(const PixelPipeline& p, const uint8_t* src, uint16_t* r, uint16_t* g, uint16_t* b) {
+        const uint32_t width = p.format_.width;
+        if (L == PixelLayout::Rgb888) {
+            for (uint32_t x = 0; x < width; x++) {
+                r[x] = src[3 * x];
+                g[x] = src[3 * x + 1];
+                b[x] = src[3 * x + 2];
+            }
+        } else if (L == PixelLayout::Rgb565) {
+            for (uint32_t x = 0; x < width; x++) {
+                const uint32_t v = src[2 * x] | (src[2 * x + 1] << 8);
+                const uint32_t r5 = v >> 11;
+                const uint32_t g6 = (v >> 5) & 0x3F;
+                const uint32_t b5 = v & 0x1F;
+                r[x] = static_cast<uint16_t>((r5 << 3) | (r5 >> 2));
+                g[x] = static_cast<uint16_t>((g6 << 2) | (g6 >> 4));
+                b[x] = static_cast<uint16_t>((b5 << 3) | (b5 >> 2));
+            }
+        } else {
+            // BT.601 limited range
+            const uint8_t* o = p.yuv_offsets_;
+            for (uint32_t x = 0; x + 2 <= width; x += 2, src += 4) {
+                const int32_t d = src[o[2]] - 128;
+                const int32_t e = src[o[3]] - 128;
+                const int32_t cr = 409 * e + 128;
+                const int32_t cg = -100 * d - 208 * e + 128;
+                const int32_t cb = 516 * d + 128;
+                for (uint32_t i = 0; i < 2; i++) {
+                    const int32_t c = 298 * (src[o[i]] - 16);
+                    r[x + i] = clamp8((c + cr) >> 8);
+                    g[x + i] = clamp8((c + cg) >> 8);
+                    b[x + i] = clamp8((c + cb) >> 8);
+                }
+            }
+        }
+    }
+
+    template <PixelLayout L, OutputFormat O>
+    static void runColor8(const PixelPipeline& p, const uint8_t* src, uint8_t* dst, size_t dst_stride,
+                          uint16_t* scratch) {
+        const PixelKernelTable& k = *p.kernels_;
+        const uint32_t width = p.format_.width;
+        uint16_t* r = scratch;
+        uint16_t* g = scratch + width;
+        uint16_t* b = scratch + 2 * width;
+        const uint16_t* lut = p.output_lut_.empty() ? nullptr : p.output_lut_.data();
+        const size_t stride = p.output_lut_stride_;
+        for (uint32_t y = 0; y < p.format_.height; y++) {
+            const uint8_t* row = src + y * p.src_row_;
+            uint8_t* out = dst + y * dst_stride;
+            if (L == PixelLayout::Yuv422 && (O == OutputFormat::Y8 || O == OutputFormat::Y16)) {
+                // the Y samples are the luma already
+                const uint8_t* o = p.yuv_offsets_;
+                for (uint32_t x = 0; x + 2 <= width; x += 2) {
+                    g[x] = row[2 * x + o[0]];
+                    g[x + 1] = row[2 * x + o[1]];
+                }
+                storeGray<O>(k, g, out, width, 0);
+                continue;
+            }
+            toPlanar<L>(p, row, r, g, b);
+            if (lut != nullptr) {
+                applyLut(r, width, lut);
+                applyLut(g, width, lut + stride);
+                applyLut(b, width, lut + 2 * stride);
+            }
+            storeColor<O>(k, r, g, b, out, width, 0);
+        }
+    }
+
+    template <PixelLayout L, OutputFormat O>
+    static void run(const PixelPipeline& p, const uint8_t* src, uint8_t* dst, size_t dst_stride, uint16_t* scratch) {
+        if (L == PixelLayout::Mono || (isSensorLayout(L) && O == OutputFormat::Raw16)) {
+            runGray<O>(p, src, dst, dst_stride, scratch);
+        } else if (L == PixelLayout::Bayer || L == PixelLayout::RgbIr) {
+            runMosaic<L, O>(p, src, dst, dst_stride, scratch);
+        } else {
+            runColor8<L, O>(p, src, dst, dst_stride, scratch);
+        }
+    }
+
+    template <PixelLayout L>
+    static RunFn select(OutputFormat output) {
+        switch (output) {
+            case OutputFormat::Raw16:
+                return isSensorLayout(L) ? &run<L, OutputFormat::Raw16> : nullptr;
+            case OutputFormat::Rgb16:
+                return &run<L, OutputFormat::Rgb16>;
+            case OutputFormat::Rgb8:
+                return &run<L, OutputFormat::Rgb8>;
+            case OutputFormat::Bgr8:
+                return &run<L, OutputFormat::Bgr8>;
+            case OutputFormat::Y16:
+                return &run<L, OutputFormat::Y16>;
+            case OutputFormat::Y8:
+                return &run<L, OutputFormat::Y8>;
+        }
+        return nullptr;
+    }
+
+    static RunFn select(PixelLayout layout, OutputFormat output) {
+        switch (layout) {
+            case PixelLayout::Bayer:
+                return select<PixelLayout::Bayer>(output);
+            case PixelLayout::RgbIr:
+                return select<PixelLayout::RgbIr>(output);
+            case PixelLayout::Mono:
+                return select<PixelLayout::Mono>(output);
+            case PixelLayout::Yuv422:
+                return select<PixelLayout::Yuv422>(output);
+            case PixelLayout::Rgb888:
+                return select<PixelLayout::Rgb888>(output);
+            case PixelLayout::Rgb565:
+                return select<PixelLayout::Rgb565>(output);
+            default:
+                return nullptr;
+        }
+    }
+
+    static PixelPipeline::UnpackFn unpack(PixelPacking packing) {
+        switch (packing) {
+            case PixelPacking::Bits8:
+                return &unpackAs<PixelPacking::Bits8>;
+            case PixelPacking::Bits16:
+                return &unpackAs<PixelPacking::Bits16>;
+            case PixelPacking::Raw10Packed:
+                return &unpackAs<PixelPacking::Raw10Packed>;
+            case PixelPacking::Raw12Packed:
+                return &unpackAs<PixelPacking::Raw12Packed>;
+            default:
+                return nullptr;
+        }
+    }
+};
+
+PixelLayout PixelPipeline::layoutOf(const Frame& frame) {
+    const ArducamFrameFormat& format = frame.format;
+    const size_t size = frame.size != 0 ? frame.size : frame.expected_size;
+    const size_t pixels = static_cast<size_t>(format.width) * format.height;
+    const bool even = format.width >= 2 && format.width % 2 == 0;
+    if (pixels == 0) {
+        return PixelLayout::Unsupported;
+    }
+    switch (formatMode(format)) {
+        case FORMAT_MODE_RAW:
+        case FORMAT_MODE_RAW_D:
+        case FORMAT_MODE_RGB_IR:
+            if (!even || format.height < 2 || detectPacking(frame) == PixelPacking::Unknown) {
+                return PixelLayout::Unsupported;
+            }
+            return formatMode(format) == FORMAT_MODE_RGB_IR ? PixelLayout::RgbIr : PixelLayout::Bayer;
+        case FORMAT_MODE_MON:
+        case FORMAT_MODE_MON_D:
+            return detectPacking(frame) != PixelPacking::Unknown ? PixelLayout::Mono : PixelLayout::Unsupported;
+        case FORMAT_MODE_YUV:
+            return even && size >= pixels * 2 ? PixelLayout::Yuv422 : PixelLayout::Unsupported;
+        case FORMAT_MODE_RGB:
+            if (size >= pixels * 3) {
+                return PixelLayout::Rgb888;
+            }
+            return size >= pixels * 2 ? PixelLayout::Rgb565 : PixelLayout::Unsupported;
+        default:
+            // JPG, TOF and STATS frames carry no pixel grid
+            return PixelLayout::Unsupported;
+    }
+}
+
+std::unique_ptr<PixelPipeline> PixelPipeline::build(const Frame& frame, const PipelineOptions& options,
+                                                    const PixelKernelTable& kernels) {
+    const PixelLayout layout = layoutOf(frame);
+    const RunFn stages = PipelineStages::select(layout, options.output);
+    if (stages == nullptr) {
+        return nullptr;
+    }
+    std::unique_ptr<PixelPipeline> p(new PixelPipeline());
+    p->kernels_ = &kernels;
+    p->format_ = frame.format;
+    p->layout_ = layout;
+    p->options_ = options;
+    p->run_ = stages;
+    const uint32_t width = frame.format.width;
+
+    if (isSensorLayout(layout)) {
+        p->packing_ = detectPacking(frame);
+        p->unpack_ = PipelineStages::unpack(p->packing_);
+        p->src_row_ = packedRowSize(p->packing_, width);
+        const uint8_t bit_width = std::min<uint8_t>(std::max<uint8_t>(frame.format.bit_width, 1), 16);
+        p->mask_ = static_cast<uint16_t>((1u << bit_width) - 1);
+        p->shift_ = bit_width > 8 ? bit_width - 8 : 0;
+    } else {
+        p->src_row_ = static_cast<size_t>(width) * (layout == PixelLayout::Rgb888 ? 3 : 2);
+        p->mask_ = 0xFF;
+    }
+    const bool raw = options.output == OutputFormat::Raw16;
+    const bool gamma = options.gamma != 1.0f && options.gamma > 0 && !raw;
+    const bool gains = options.red_gain != 1.0f || options.green_gain != 1.0f || options.blue_gain != 1.0f;
+    // 8-bit samples may exceed the mask of a narrower bit width
+    const size_t lut_size = std::max<size_t>(static_cast<size_t>(p->mask_) + 1,
+                                             p->packing_ == PixelPacking::Bits8 ? 256 : 0);
+    const double full = p->mask_;
+    const double black = isSensorLayout(layout) ? options.black_level : 0;
+
+    switch (layout) {
+        case PixelLayout::Mono:
+            if (gamma) {
+                p->sensor_lut_.resize(lut_size);
+                p->sensor_lut_size_ = lut_size;
+                for (size_t v = 0; v < lut_size; v++) {
+                    p->sensor_lut_[v] = curve(v - black, full, options.gamma);
+                }
+            }
+            p->scratch_size_ = width;
+            break;
+        case PixelLayout::Bayer:
+        case PixelLayout::RgbIr: {
+            bool red_row;
+            bool green_first;
+            bayerRow(bayerOrder(frame.format), 0, red_row, green_first);
+            // the IR samples sit where a bayer mosaic has the green of the blue rows
+            p->ir_row_ = red_row ? 1 : 0;
+            bayerRow(bayerOrder(frame.format), p->ir_row_, red_row, green_first);
+            p->ir_column_ = green_first ? 0 : 1;
+            if (gains) {
+                p->sensor_lut_.resize(4 * lut_size);
+                p->sensor_lut_size_ = lut_size;
+                for (uint32_t phase = 0; phase < 4; phase++) {
+                    bayerRow(bayerOrder(frame.format), phase >> 1, red_row, green_first);
+                    const bool green = ((phase & 1) == 0) == green_first;
+                    const float gain = green ? options.green_gain : (red_row ? options.red_gain : options.blue_gain);
+                    uint16_t* lut = p->sensor_lut_.data() + phase * lut_size;
+                    for (size_t v = 0; v < lut_size; v++) {
+                        lut[v] = curve((v - black) * gain, full, 1.0f);
+                    }
+                }
+            }
+            if (gamma) {
+                p->output_lut_.resize(lut_size);
+                for (size_t v = 0; v < lut_size; v++) {
+                    p->output_lut_[v] = curve(v, full, options.gamma);
+                }
+            }
+            p->scratch_size_ = static_cast<size_t>(width) * (layout == PixelLayout::RgbIr ? 7 : 6);
+            break;
+        }
+        default: {
+            if (layout == PixelLayout::Yuv422) {
+                // the low 8 bits of the format give the byte order: YUYV, YVYU, UYVY, VYUY
+                static const uint8_t kOffsets[4][4] = {{0, 2, 1, 3}, {0, 2, 3, 1}, {1, 3, 0, 2}, {1, 3, 2, 0}};
+                std::memcpy(p->yuv_offsets_, kOffsets[frame.format.format & 0x03], sizeof(p->yuv_offsets_));
+            }
+            if (gains || gamma) {
+                p->output_lut_.resize(3 * lut_size);
+                p->output_lut_stride_ = lut_size;
+                const float channel_gains[3] = {options.red_gain, options.green_gain, options.blue_gain};
+                for (size_t c = 0; c < 3; c++) {
+                    for (size_t v = 0; v < lut_size; v++) {
+                        p->output_lut_[c * lut_size + v] =
+                            curve(std::min(v * static_cast<double>(channel_gains[c]), full), full,
+                                  gamma ? options.gamma : 1.0f);
+                    }
+                }
+            }
+            p->scratch_size_ = static_cast<size_t>(width) * 3;
+            break;
+        }
+    }
+    return p;
+}
+
+bool PixelPipeline::matches(const Frame& frame) const {
+    const ArducamFrameFormat& format = frame.format;
+    return format.width == format_.width && format.height == format_.height &&
+           format.bit_width == format_.bit_width && format.format == format_.format && layoutOf(frame) == layout_ &&
+           (!isSensorLayout(layout_) || detectPacking(frame) == packing_);
+}
+
+bool PixelPipeline::run(const Frame& frame, uint8_t* dst, size_t dst_stride, uint16_t* scratch) const {
+    if (frame.data == nullptr || !matches(frame)) {
+        return false;
+    }
+    run_(*this, frame.data, dst, dst_stride != 0 ? dst_stride : outputRowSize(), scratch);
+    return true;
+}
+
+}  // namespace Arducam
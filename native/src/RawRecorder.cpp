@@ -0,0 +1,463 @@
+#include <arducam/RawRecorder.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include "Common.hpp"
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Arducam {
+
+namespace {
+
+constexpr char kMagic[4] = {'A', 'R', 'R', 'W'};
+constexpr uint32_t kVersion = 1;
+
+uint64_t roundUp(uint64_t value, uint64_t multiple) { return (value + multiple - 1) / multiple * multiple; }
+
+constexpr intptr_t kInvalidFile = -1;
+
+// opens and preallocates the file, with direct I/O if possible
+intptr_t createFile(const std::string& path, uint64_t size, bool& direct_io) {
+#if defined(_WIN32)
+    const DWORD flags = FILE_ATTRIBUTE_NORMAL | (direct_io ? FILE_FLAG_NO_BUFFERING : 0);
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                                flags, nullptr);
+    if (handle == INVALID_HANDLE_VALUE && direct_io) {
+        direct_io = false;
+        handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    }
+    if (handle == INVALID_HANDLE_VALUE) {
+        return kInvalidFile;
+    }
+    LARGE_INTEGER end;
+    end.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFilePointerEx(handle, end, nullptr, FILE_BEGIN) || !SetEndOfFile(handle)) {
+        CloseHandle(handle);
+        return kInvalidFile;
+    }
+    return reinterpret_cast<intptr_t>(handle);
+#else
+    int fd = -1;
+#if defined(O_DIRECT)
+    if (direct_io) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    }
+#endif
+    if (fd < 0) {
+        // tmpfs and some network file systems do not support O_DIRECT
+        direct_io = false;
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd < 0) {
+        return kInvalidFile;
+    }
+#if defined(__linux__)
+    const bool allocated = posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0;
+#else
+    const bool allocated = ftruncate(fd, static_cast<off_t>(size)) == 0;
+#endif
+    if (!allocated) {
+        ::close(fd);
+        return kInvalidFile;
+    }
+    return fd;
+#endif
+}
+
+bool writeFile(intptr_t file, const uint8_t* data, size_t size, uint64_t offset) {
+#if defined(_WIN32)
+    HANDLE handle = reinterpret_cast<HANDLE>(file);
+    while (size != 0) {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        const DWORD request = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(handle, data, request, &written, &overlapped) || written == 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+#else
+    while (size != 0) {
+        const ssize_t written = pwrite(static_cast<int>(file), data, size, static_cast<off_t>(offset));
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+#endif
+}
+
+void closeFile(intptr_t file, uint64_t size) {
+#if defined(_WIN32)
+    HANDLE handle = reinterpret_cast<HANDLE>(file);
+    LARGE_INTEGER end;
+    end.QuadPart = static_cast<LONGLONG>(size);
+    if (SetFilePointerEx(handle, end, nullptr, FILE_BEGIN)) {
+        SetEndOfFile(handle);
+    }
+    CloseHandle(handle);
+#else
+    // trimming is best effort, a failure only leaves the preallocated space behind
+    (void)ftruncate(static_cast<int>(file), static_cast<off_t>(size));
+    ::close(static_cast<int>(file));
+#endif
+}
+
+void noRelease(void*, const Frame&) {}
+
+}  // namespace
+
+std::unique_ptr<RawRecorder> RawRecorder::create(const std::string& path, const RecorderOptions& options) {
+    if (options.capacity == 0 || options.chunk_size == 0 || options.chunk_size % kRecordAlignment != 0) {
+        return nullptr;
+    }
+    const uint64_t max_frames =
+        options.max_frames != 0 ? options.max_frames : std::max<uint64_t>(options.capacity >> 20, 1);
+    const uint64_t data_offset = kRecordAlignment + roundUp(max_frames * sizeof(RecordIndexEntry), kRecordAlignment);
+    const uint64_t capacity = roundUp(options.capacity, kRecordAlignment);
+
+    ArenaOptions chunk_options;
+    chunk_options.block_size = options.chunk_size;
+    chunk_options.block_count = 1;
+    chunk_options.huge_pages = options.huge_pages;
+    auto chunk = BufferArena::create(chunk_options);
+    ArenaOptions meta_options;
+    meta_options.block_size = static_cast<size_t>(data_offset);
+    meta_options.block_count = 1;
+    auto meta = BufferArena::create(meta_options);
+    if (!chunk || !meta) {
+        return nullptr;
+    }
+
+    bool direct_io = options.direct_io;
+    const intptr_t file = createFile(path, data_offset + capacity, direct_io);
+    if (file == kInvalidFile) {
+        return nullptr;
+    }
+    std::unique_ptr<RawRecorder> recorder(new RawRecorder(file, direct_io, options, chunk, meta));
+    RecordHeader& header = recorder->header();
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.entry_size = sizeof(RecordIndexEntry);
+    header.alignment = kRecordAlignment;
+    header.max_frames = max_frames;
+    header.index_offset = kRecordAlignment;
+    header.data_offset = data_offset;
+    if (!recorder->writeMeta(false)) {
+        return nullptr;
+    }
+    recorder->writer_ = std::thread(&RawRecorder::run, recorder.get());
+    return recorder;
+}
+
+RawRecorder::RawRecorder(intptr_t file, bool direct_io, const RecorderOptions& options,
+                         std::shared_ptr<BufferArena> chunk, std::shared_ptr<BufferArena> meta)
+    : file_(file),
+      direct_io_(direct_io),
+      capacity_(roundUp(options.capacity, kRecordAlignment)),
+      chunk_size_(options.chunk_size),
+      chunk_arena_(std::move(chunk)),
+      meta_arena_(std::move(meta)),
+      meta_data_(meta_arena_->acquire()),
+      chunk_data_(chunk_arena_->acquire()),
+      queue_(std::max<size_t>(options.queue_depth, 1)) {
+    std::memset(meta_data_, 0, meta_arena_->blockSize());
+}
+
+RawRecorder::~RawRecorder() {
+    close();
+}
+
+bool RawRecorder::record(FrameRef frame, uint8_t stream) {
+    if (!frame) {
+        return false;
+    }
+    if (closing_.load(std::memory_order_acquire)) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Pending pending;
+    pending.frame = std::move(frame);
+    pending.stream = stream;
+    if (!queue_.tryPush(pending)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    readable_.notify();
+    return true;
+}
+
+void RawRecorder::attach(std::shared_ptr<FrameSubscriber> subscriber, uint8_t stream) {
+    std::lock_guard<std::mutex> lock(close_mutex_);
+    if (closed_) {
+        return;
+    }
+    pumps_.emplace_back(&RawRecorder::pump, this, std::move(subscriber), stream);
+}
+
+void RawRecorder::pump(std::shared_ptr<FrameSubscriber> subscriber, uint8_t stream) {
+    FrameRef frame;
+    while (!closing_.load(std::memory_order_acquire)) {
+        if (subscriber->pop(frame, 100)) {
+            record(std::move(frame), stream);
+        } else if (subscriber->closed()) {
+            return;
+        }
+    }
+}
+
+bool RawRecorder::close() {
+    std::lock_guard<std::mutex> lock(close_mutex_);
+    if (closed_) {
+        return ok_;
+    }
+    closed_ = true;
+    closing_.store(true, std::memory_order_release);
+    for (auto& pump : pumps_) {
+        pump.join();
+    }
+    pumps_.clear();
+    readable_.notify();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    ok_ = !failed_;
+    closeFile(file_, header().data_offset + chunk_start_);
+    return ok_;
+}
+
+RecorderStats RawRecorder::stats() const {
+    RecorderStats stats;
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    stats.write_errors = write_errors_.load(std::memory_order_relaxed);
+    stats.max_write_us = max_write_us_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void RawRecorder::run() {
+    Pending pending;
+    for (;;) {
+        readable_.wait([this] { return !queue_.empty() || closing_.load(std::memory_order_acquire); }, -1);
+        while (queue_.tryPop(pending)) {
+            append(pending);
+            // hands the buffer back as soon as it is copied
+            pending.frame.reset();
+        }
+        if (closing_.load(std::memory_order_acquire) && queue_.empty()) {
+            break;
+        }
+    }
+    if (!failed_) {
+        failed_ = !flushChunk() || !writeMeta(true);
+    }
+}
+
+void RawRecorder::append(const Pending& pending) {
+    const Frame& frame = pending.frame.frame();
+    RecordHeader& header = this->header();
+    const uint64_t padded = roundUp(frame.size, kRecordAlignment);
+    if (failed_ || header.frame_count == header.max_frames || chunk_start_ + chunk_fill_ + padded > capacity_) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    RecordIndexEntry entry{};
+    entry.offset = header.data_offset + chunk_start_ + chunk_fill_;
+    entry.timestamp = frame.timestamp;
+    entry.size = frame.size;
+    entry.seq = frame.seq;
+    entry.width = frame.format.width;
+    entry.height = frame.format.height;
+    entry.format = frame.format.format;
+    entry.bit_width = frame.format.bit_width;
+    entry.stream = pending.stream;
+    if (const FrameMetadata* metadata = pending.frame.metadata()) {
+        entry.metadata_valid = metadata->valid;
+        entry.exposure_lines = metadata->exposure_lines;
+        entry.analogue_gain_code = metadata->analogue_gain_code;
+        entry.digital_gain_code = metadata->digital_gain_code;
+        entry.frame_length_lines = metadata->frame_length_lines;
+        entry.line_length_pck = metadata->line_length_pck;
+        entry.lens_position = metadata->lens_position;
+        entry.temperature = metadata->temperature;
+        entry.frame_count = metadata->frame_count;
+    }
+
+    const uint8_t* data = frame.data;
+    size_t remaining = frame.size;
+    while (remaining != 0) {
+        const size_t n = std::min(remaining, chunk_size_ - chunk_fill_);
+        std::memcpy(chunk_data_ + chunk_fill_, data, n);
+        chunk_fill_ += n;
+        data += n;
+        remaining -= n;
+        if (chunk_fill_ == chunk_size_ && !flushChunk()) {
+            return;
+        }
+    }
+    // the chunk size is a multiple of the alignment, so the padding never crosses the end of the chunk
+    const size_t aligned = static_cast<size_t>(roundUp(chunk_fill_, kRecordAlignment));
+    std::memset(chunk_data_ + chunk_fill_, 0, aligned - chunk_fill_);
+    chunk_fill_ = aligned;
+
+    index()[header.frame_count++] = entry;
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(frame.size, std::memory_order_relaxed);
+    if (chunk_fill_ == chunk_size_) {
+        flushChunk();
+    }
+}
+
+bool RawRecorder::flushChunk() {
+    if (chunk_fill_ == 0) {
+        return true;
+    }
+    // a frame split across chunks is only indexed once its last part is written, so every indexed frame is complete
+    const uint64_t start = detail::nowUs();
+    const bool ok = writeAt(chunk_data_, chunk_fill_, header().data_offset + chunk_start_);
+    const uint64_t elapsed = detail::nowUs() - start;
+    uint64_t longest = max_write_us_.load(std::memory_order_relaxed);
+    while (elapsed > longest && !max_write_us_.compare_exchange_weak(longest, elapsed, std::memory_order_relaxed)) {
+    }
+    if (!ok) {
+        return false;
+    }
+    chunk_start_ += chunk_fill_;
+    chunk_fill_ = 0;
+    return writeMeta(false);
+}
+
+bool RawRecorder::writeMeta(bool complete) {
+    RecordHeader& header = this->header();
+    header.data_size = chunk_start_;
+    header.flags = complete ? kRecordComplete : 0;
+    if (!writeAt(meta_data_, kRecordAlignment, 0)) {
+        return false;
+    }
+    // only the index pages written to since the last call
+    const uint64_t first = committed_ * sizeof(RecordIndexEntry) / kRecordAlignment * kRecordAlignment;
+    const uint64_t last = roundUp(header.frame_count * sizeof(RecordIndexEntry), kRecordAlignment);
+    if (last > first && !writeAt(meta_data_ + kRecordAlignment + first, static_cast<size_t>(last - first),
+                                 kRecordAlignment + first)) {
+        return false;
+    }
+    committed_ = header.frame_count;
+    return true;
+}
+
+bool RawRecorder::writeAt(const uint8_t* data, size_t size, uint64_t offset) {
+    if (failed_) {
+        return false;
+    }
+    if (!writeFile(file_, data, size, offset)) {
+        write_errors_.fetch_add(1, std::memory_order_relaxed);
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<RawReader> RawReader::open(const std::string& path) {
+    detail::MappedFile file;
+    if (!detail::mapFile(path, kRecordAlignment, file)) {
+        return nullptr;
+    }
+    const uint64_t size = file.size;
+    std::unique_ptr<RawReader> reader(new RawReader(file.base, file.size, file.mapping));
+    const RecordHeader& header = reader->header();
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.entry_size != sizeof(RecordIndexEntry) || header.index_offset > size ||
+        header.max_frames > (size - header.index_offset) / sizeof(RecordIndexEntry)) {
+        return nullptr;
+    }
+    reader->entries_ = reinterpret_cast<const RecordIndexEntry*>(reader->base_ + header.index_offset);
+    reader->frame_count_ = static_cast<size_t>(std::min(header.frame_count, header.max_frames));
+    return reader;
+}
+
+RawReader::RawReader(const uint8_t* base, uint64_t size, intptr_t mapping)
+    : base_(base), size_(size), mapping_(mapping), entries_(nullptr), frame_count_(0) {}
+
+RawReader::~RawReader() { detail::unmapFile(detail::MappedFile{base_, size_, mapping_}); }
+
+bool RawReader::frame(size_t i, Frame& frame) const {
+    if (i >= frame_count_) {
+        return false;
+    }
+    const RecordIndexEntry& entry = entries_[i];
+    if (entry.offset > size_ || entry.size > size_ - entry.offset) {
+        return false;
+    }
+    std::memset(&frame, 0, sizeof(frame));
+    frame.seq = entry.seq;
+    frame.timestamp = entry.timestamp;
+    frame.alloc_size = entry.size;
+    frame.expected_size = entry.size;
+    frame.size = entry.size;
+    frame.data = const_cast<uint8_t*>(base_ + entry.offset);
+    frame.format.width = entry.width;
+    frame.format.height = entry.height;
+    frame.format.bit_width = entry.bit_width;
+    frame.format.format = entry.format;
+    return true;
+}
+
+FrameRef RawReader::frameRef(size_t i) const {
+    Frame f;
+    if (!frame(i, f)) {
+        return FrameRef();
+    }
+    FrameRef ref = FrameRef::wrap(f, nullptr, &noRelease);
+    FrameMetadata m;
+    if (metadata(i, m)) {
+        ref.setMetadata(m);
+    }
+    return ref;
+}
+
+bool RawReader::metadata(size_t i, FrameMetadata& metadata) const {
+    if (i >= frame_count_ || entries_[i].metadata_valid == 0) {
+        return false;
+    }
+    const RecordIndexEntry& entry = entries_[i];
+    metadata = FrameMetadata();
+    metadata.valid = entry.metadata_valid;
+    metadata.seq = entry.seq;
+    metadata.timestamp = entry.timestamp;
+    metadata.size = entry.size;
+    metadata.expected_size = entry.size;
+    metadata.exposure_lines = entry.exposure_lines;
+    metadata.analogue_gain_code = entry.analogue_gain_code;
+    metadata.digital_gain_code = entry.digital_gain_code;
+    metadata.frame_length_lines = entry.frame_length_lines;
+    metadata.line_length_pck = entry.line_length_pck;
+    metadata.lens_position = entry.lens_position;
+    metadata.temperature = entry.temperature;
+    metadata.frame_count = entry.frame_count;
+    return true;
+}
+
+}  // namespace Arducam
@@ -0,0 +1,227 @@
+#include <arducam/RegisterBatch.hpp>
+
+#include <algorithm>
+
+#include <arducam/RegisterProgram.hpp>
+
+#include "Common.hpp"
+
+namespace Arducam {
+
+namespace {
+
+// the widest transaction the register layout allows
+size_t mergeLimit(const RegBatchOptions& options) {
+    switch (options.mode) {
+        case I2CMode::I2C_MODE_8_8:
+            return std::min<size_t>(options.max_merge, 2);
+        case I2CMode::I2C_MODE_16_8:
+            return std::min<size_t>(options.max_merge, 4);
+        default:
+            return 1;
+    }
+}
+
+I2CMode mergedMode(I2CMode mode, size_t n) {
+    if (n == 1) {
+        return mode;
+    }
+    if (mode == I2CMode::I2C_MODE_8_8) {
+        return I2CMode::I2C_MODE_8_16;
+    }
+    return n == 2 ? I2CMode::I2C_MODE_16_16 : I2CMode::I2C_MODE_16_32;
+}
+
+// the number of registers starting at `i` that go out in one transaction: 1, 2 or 4
+template <typename T>
+size_t runLength(const T* regs, size_t i, size_t count, size_t limit) {
+    size_t n = 1;
+    while (n < limit && i + n < count && regs[i + n].reg == regs[i].reg + n) {
+        n++;
+    }
+    return n == 3 ? 2 : n;
+}
+
+uint32_t i2cAddress(const Camera& camera, const RegBatchOptions& options) {
+    return options.i2c_addr != 0 ? options.i2c_addr : camera.i2cAddr();
+}
+
+bool readOne(Camera& camera, I2CMode mode, uint32_t addr, uint32_t reg, uint32_t& value) {
+#if defined(WITH_STD_OPTIONAL)
+    auto result = camera.readReg(mode, addr, reg);
+    if (!result) {
+        return false;
+    }
+    value = *result;
+    return true;
+#else
+    value = camera.readReg(mode, addr, reg);
+    return camera.lastError() == 0;
+#endif
+}
+
+}  // namespace
+
+I2CMode groupHoldMode(I2CMode mode) {
+    const bool short_address = mode == I2CMode::I2C_MODE_8_8 || mode == I2CMode::I2C_MODE_8_16;
+    return short_address ? I2CMode::I2C_MODE_8_8 : I2CMode::I2C_MODE_16_8;
+}
+
+bool writeRegs(Camera& camera, const RegWrite* regs, size_t count, const RegBatchOptions& options,
+               size_t* transactions) {
+    const uint32_t addr = i2cAddress(camera, options);
+    const size_t limit = mergeLimit(options);
+    size_t sent = 0;
+    bool ok = true;
+    if (options.group_hold && count != 0) {
+        ok = camera.writeReg(groupHoldMode(options.mode), addr, options.group_hold_reg, 1);
+        sent++;
+    }
+    for (size_t i = 0; ok && i < count;) {
+        const size_t n = runLength(regs, i, count, limit);
+        // the sensor takes the bytes of a wide write MSB first, starting at the first register
+        uint32_t value = 0;
+        for (size_t k = 0; k < n; k++) {
+            value = n == 1 ? regs[i].value : (value << 8) | (regs[i + k].value & 0xFF);
+        }
+        ok = camera.writeReg(mergedMode(options.mode, n), addr, regs[i].reg, value);
+        sent++;
+        i += n;
+    }
+    if (options.group_hold && count != 0) {
+        ok = camera.writeReg(groupHoldMode(options.mode), addr, options.group_hold_reg, 0) && ok;
+        sent++;
+    }
+    // a failed batch may have been written in part: all of it is reported
+    for (size_t i = 0; options.mode_switcher != nullptr && i < count; i++) {
+        options.mode_switcher->invalidate(regs[i].reg);
+    }
+    if (transactions != nullptr) {
+        *transactions = sent;
+    }
+    return ok;
+}
+
+bool readRegs(Camera& camera, RegRead* regs, size_t count, const RegBatchOptions& options, size_t* transactions) {
+    const uint32_t addr = i2cAddress(camera, options);
+    const size_t limit = mergeLimit(options);
+    size_t sent = 0;
+    bool ok = true;
+    for (size_t i = 0; ok && i < count;) {
+        const size_t n = runLength(regs, i, count, limit);
+        uint32_t value = 0;
+        ok = readOne(camera, mergedMode(options.mode, n), addr, regs[i].reg, value);
+        sent++;
+        if (ok && n == 1) {
+            regs[i].value = value;
+        } else if (ok) {
+            for (size_t k = 0; k < n; k++) {
+                regs[i + k].value = (value >> (8 * (n - 1 - k))) & 0xFF;
+            }
+        }
+        i += n;
+    }
+    if (transactions != nullptr) {
+        *transactions = sent;
+    }
+    return ok;
+}
+
+FrameStartWriter::FrameStartWriter(Camera& camera, EventDispatcher& events, RegBatchOptions options)
+    : camera_(camera), events_(events), options_(options) {
+    options_.group_hold = true;
+    worker_ = std::thread(&FrameStartWriter::run, this);
+    listener_ = events_.addListener([this](EventCode event) { onEvent(event); });
+}
+
+FrameStartWriter::~FrameStartWriter() {
+    events_.removeListener(listener_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    worker_.join();
+}
+
+void FrameStartWriter::submit(const RegWrite* regs, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < count; i++) {
+        // a register keeps its first position so that runs of consecutive registers stay together
+        auto it = std::find_if(pending_.begin(), pending_.end(),
+                               [&](const RegWrite& write) { return write.reg == regs[i].reg; });
+        if (it != pending_.end()) {
+            it->value = regs[i].value;
+            stats_.replaced++;
+        } else {
+            pending_.push_back(regs[i]);
+        }
+        stats_.writes++;
+    }
+}
+
+bool FrameStartWriter::flush() {
+    std::vector<RegWrite> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch.swap(pending_);
+    }
+    return batch.empty() || write(batch, detail::nowUs());
+}
+
+FrameStartWriterStats FrameStartWriter::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void FrameStartWriter::onEvent(EventCode event) {
+    if (event != EventCode::FrameStart) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.frames++;
+        if (pending_.empty()) {
+            return;
+        }
+        frame_start_us_ = detail::nowUs();
+        frame_started_ = true;
+    }
+    // the writes go out on the worker, the SDK event thread must not block on USB transfers
+    wake_.notify_one();
+}
+
+void FrameStartWriter::run() {
+    std::vector<RegWrite> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [&] { return stopping_ || frame_started_; });
+        if (stopping_) {
+            return;
+        }
+        frame_started_ = false;
+        const uint64_t event_time = frame_start_us_;
+        batch.clear();
+        batch.swap(pending_);
+        lock.unlock();
+        write(batch, event_time);
+        lock.lock();
+    }
+}
+
+bool FrameStartWriter::write(std::vector<RegWrite>& batch, uint64_t event_time_us) {
+    size_t transactions = 0;
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        ok = writeRegs(camera_, batch.data(), batch.size(), options_, &transactions);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.batches++;
+    stats_.transactions += transactions;
+    stats_.failures += ok ? 0 : 1;
+    stats_.last_latency_us = detail::nowUs() - event_time_us;
+    return ok;
+}
+
+}  // namespace Arducam
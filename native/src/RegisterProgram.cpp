@@ -0,0 +1,462 @@
+#include <arducam/RegisterProgram.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+#include <arducam/RegisterBatch.hpp>
+
+namespace Arducam {
+
+namespace {
+
+constexpr uint32_t kSectionMask = 0xFF000000;
+constexpr char kCacheMagic[4] = {'A', 'R', 'P', 'C'};
+constexpr uint32_t kCacheVersion = 1;
+constexpr size_t kOpSize = 16;
+
+// the binary forms are little endian whatever the host is
+void put8(std::vector<uint8_t>& out, uint8_t v) { out.push_back(v); }
+
+void put16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t v) {
+    put16(out, static_cast<uint16_t>(v));
+    put16(out, static_cast<uint16_t>(v >> 16));
+}
+
+class Reader {
+   public:
+    Reader(const uint8_t* data, size_t size) : p_(data), end_(data + size) {}
+
+    bool ok() const { return ok_; }
+    size_t remaining() const { return static_cast<size_t>(end_ - p_); }
+    const uint8_t* position() const { return p_; }
+
+    bool bytes(void* dst, size_t n) {
+        if (!ok_ || remaining() < n) {
+            ok_ = false;
+            return false;
+        }
+        std::memcpy(dst, p_, n);
+        p_ += n;
+        return true;
+    }
+    uint8_t u8() {
+        uint8_t b[1] = {0};
+        bytes(b, 1);
+        return b[0];
+    }
+    uint16_t u16() {
+        uint8_t b[2] = {0, 0};
+        bytes(b, 2);
+        return static_cast<uint16_t>(b[0] | (b[1] << 8));
+    }
+    uint32_t u32() {
+        uint32_t low = u16();
+        return low | (static_cast<uint32_t>(u16()) << 16);
+    }
+
+   private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool ok_ = true;
+};
+
+using CommandKey = std::tuple<uint8_t, uint32_t, uint16_t>;
+
+}  // namespace
+
+bool RegisterProgram::compile(const CameraConfigs& configs, uint8_t usb_type, RegisterProgram& program) {
+    RegisterProgram result;
+    const CameraParam& param = configs.camera_param;
+    result.mode_id_ = param.cfg_mode;
+    std::strncpy(result.config_.camera_name, param.type, sizeof(result.config_.camera_name) - 1);
+    result.config_.width = param.width;
+    result.config_.height = param.height;
+    result.config_.bit_width = param.bit_width;
+    result.config_.format = param.format;
+    result.config_.i2c_mode = param.i2c_mode;
+    result.config_.i2c_addr = param.i2c_addr;
+
+    for (uint32_t i = 0; i < configs.configs_length; i++) {
+        const Config& c = configs.configs[i];
+        const uint32_t section = c.type & kSectionMask;
+        const uint8_t usb = static_cast<uint8_t>(c.type >> 16);
+        if ((section != SECTION_TYPE_REG && section != SECTION_TYPE_BOARD) || (usb != 0 && usb != usb_type)) {
+            continue;
+        }
+        RegOp op{};
+        switch (c.type & 0xFFFF) {
+            case CONFIG_TYPE_REG:
+                if (c.params_length < 2) {
+                    return false;
+                }
+                op.type = RegOpType::SensorWrite;
+                op.address = c.params[0];
+                op.value = c.params[1];
+                break;
+            case CONFIG_TYPE_DELAY:
+                if (c.params_length < 1) {
+                    return false;
+                }
+                op.type = RegOpType::Delay;
+                op.value = c.params[0];
+                break;
+            case CONFIG_TYPE_VRCMD:
+                // command, value, index, length, then one byte of payload per parameter
+                if (c.params_length < 4 || c.params[3] > static_cast<uint32_t>(c.params_length - 4)) {
+                    return false;
+                }
+                op.type = RegOpType::BoardCommand;
+                op.command = static_cast<uint8_t>(c.params[0]);
+                op.value = c.params[1];
+                op.index = static_cast<uint16_t>(c.params[2]);
+                op.length = c.params[3];
+                op.address = static_cast<uint32_t>(result.payload_.size());
+                for (uint32_t j = 0; j < op.length; j++) {
+                    result.payload_.push_back(static_cast<uint8_t>(c.params[4 + j]));
+                }
+                break;
+            default:
+                continue;
+        }
+        result.ops_.push_back(op);
+    }
+    program = std::move(result);
+    return true;
+}
+
+bool RegisterProgram::compileFile(const std::string& path, uint8_t usb_type, RegisterProgram& program) {
+    CameraConfigs configs;
+    std::memset(&configs, 0, sizeof(configs));
+    if (arducam_parse_config(path.c_str(), &configs) != 0) {
+        return false;
+    }
+    bool ok = compile(configs, usb_type, program);
+    freeParsedConfigs(configs);
+    return ok;
+}
+
+size_t RegisterProgram::writeCount() const {
+    return static_cast<size_t>(
+        std::count_if(ops_.begin(), ops_.end(), [](const RegOp& op) { return op.type == RegOpType::SensorWrite; }));
+}
+
+bool RegisterProgram::sameFormat(const RegisterProgram& other) const {
+    return config_.width == other.config_.width && config_.height == other.config_.height &&
+           config_.bit_width == other.config_.bit_width && config_.format == other.config_.format;
+}
+
+RegisterProgram RegisterProgram::diff(const RegisterProgram& from, const DiffOptions& options) const {
+    auto contains = [](const std::vector<uint32_t>& list, uint32_t reg) {
+        return std::find(list.begin(), list.end(), reg) != list.end();
+    };
+    for (const RegOp& op : ops_) {
+        if (op.type == RegOpType::SensorWrite && contains(options.reset_registers, op.address)) {
+            return *this;
+        }
+    }
+
+    std::unordered_map<uint32_t, uint32_t> regs;
+    std::map<CommandKey, std::vector<uint8_t>> commands;
+    auto payloadOf = [](const RegisterProgram& program, const RegOp& op) {
+        const uint8_t* p = program.payload_.data() + op.address;
+        return std::vector<uint8_t>(p, p + op.length);
+    };
+    for (const RegOp& op : from.ops_) {
+        if (op.type == RegOpType::SensorWrite) {
+            regs[op.address] = op.value;
+        } else if (op.type == RegOpType::BoardCommand) {
+            commands[CommandKey(op.command, op.value, op.index)] = payloadOf(from, op);
+        }
+    }
+
+    RegisterProgram result;
+    result.mode_id_ = mode_id_;
+    result.config_ = config_;
+    bool pending = false;
+    for (const RegOp& op : ops_) {
+        switch (op.type) {
+            case RegOpType::SensorWrite: {
+                auto it = regs.find(op.address);
+                if (it != regs.end() && it->second == op.value && !contains(options.always_write, op.address)) {
+                    continue;
+                }
+                regs[op.address] = op.value;
+                result.ops_.push_back(op);
+                pending = true;
+                break;
+            }
+            case RegOpType::BoardCommand: {
+                std::vector<uint8_t> payload = payloadOf(*this, op);
+                std::vector<uint8_t>& sent = commands[CommandKey(op.command, op.value, op.index)];
+                // commands without payload are triggers and always sent
+                if (sent == payload && op.length != 0) {
+                    continue;
+                }
+                RegOp copy = op;
+                copy.address = static_cast<uint32_t>(result.payload_.size());
+                result.payload_.insert(result.payload_.end(), payload.begin(), payload.end());
+                result.ops_.push_back(copy);
+                sent = std::move(payload);
+                pending = true;
+                break;
+            }
+            case RegOpType::Delay:
+                if (pending) {
+                    result.ops_.push_back(op);
+                    pending = false;
+                }
+                break;
+        }
+    }
+    return result;
+}
+
+bool RegisterProgram::run(Camera& camera, uint8_t max_merge) const {
+    RegBatchOptions options;
+    options.mode = static_cast<I2CMode>(camera.i2cMode());
+    options.max_merge = max_merge;
+    std::vector<RegWrite> writes;
+    // the sensor writes collected since the last delay or board command
+    auto flush = [&] {
+        const bool ok = writes.empty() || writeRegs(camera, writes.data(), writes.size(), options);
+        writes.clear();
+        return ok;
+    };
+    for (const RegOp& op : ops_) {
+        switch (op.type) {
+            case RegOpType::SensorWrite:
+                writes.push_back(RegWrite{op.address, op.value});
+                break;
+            case RegOpType::Delay:
+                if (!flush()) {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(op.value));
+                break;
+            case RegOpType::BoardCommand:
+                if (!flush() ||
+                    !camera.writeBoardConfig(op.command, static_cast<uint16_t>(op.value), op.index,
+                                             op.length != 0 ? payload_.data() + op.address : nullptr, op.length)) {
+                    return false;
+                }
+                break;
+        }
+    }
+    return flush();
+}
+
+void RegisterProgram::serialize(std::vector<uint8_t>& out) const {
+    put32(out, mode_id_);
+    out.insert(out.end(), config_.camera_name, config_.camera_name + sizeof(config_.camera_name));
+    put32(out, config_.width);
+    put32(out, config_.height);
+    put8(out, config_.bit_width);
+    put16(out, config_.format);
+    put8(out, config_.i2c_mode);
+    put16(out, config_.i2c_addr);
+    put32(out, static_cast<uint32_t>(ops_.size()));
+    put32(out, static_cast<uint32_t>(payload_.size()));
+    for (const RegOp& op : ops_) {
+        put8(out, static_cast<uint8_t>(op.type));
+        put8(out, op.command);
+        put16(out, op.index);
+        put32(out, op.address);
+        put32(out, op.value);
+        put32(out, op.length);
+    }
+    out.insert(out.end(), payload_.begin(), payload_.end());
+}
+
+bool RegisterProgram::deserialize(const uint8_t* data, size_t size, size_t& consumed) {
+    Reader in(data, size);
+    RegisterProgram result;
+    result.mode_id_ = in.u32();
+    in.bytes(result.config_.camera_name, sizeof(result.config_.camera_name));
+    result.config_.camera_name[sizeof(result.config_.camera_name) - 1] = '\0';
+    result.config_.width = in.u32();
+    result.config_.height = in.u32();
+    result.config_.bit_width = in.u8();
+    result.config_.format = in.u16();
+    result.config_.i2c_mode = in.u8();
+    result.config_.i2c_addr = in.u16();
+    const uint32_t op_count = in.u32();
+    const uint32_t payload_size = in.u32();
+    if (!in.ok() || in.remaining() / kOpSize < op_count || in.remaining() - op_count * kOpSize < payload_size) {
+        return false;
+    }
+    result.ops_.resize(op_count);
+    for (RegOp& op : result.ops_) {
+        op.type = static_cast<RegOpType>(in.u8());
+        op.command = in.u8();
+        op.index = in.u16();
+        op.address = in.u32();
+        op.value = in.u32();
+        op.length = in.u32();
+        if (op.type != RegOpType::SensorWrite && op.type != RegOpType::Delay && op.type != RegOpType::BoardCommand) {
+            return false;
+        }
+        if (op.type == RegOpType::BoardCommand &&
+            (op.address > payload_size || op.length > payload_size - op.address)) {
+            return false;
+        }
+    }
+    result.payload_.resize(payload_size);
+    in.bytes(result.payload_.data(), payload_size);
+    if (!in.ok()) {
+        return false;
+    }
+    consumed = static_cast<size_t>(in.position() - data);
+    *this = std::move(result);
+    return true;
+}
+
+bool saveProgramCache(const std::string& path, const std::vector<RegisterProgram>& programs) {
+    std::vector<uint8_t> out(kCacheMagic, kCacheMagic + sizeof(kCacheMagic));
+    put32(out, kCacheVersion);
+    put32(out, static_cast<uint32_t>(programs.size()));
+    for (const RegisterProgram& program : programs) {
+        program.serialize(out);
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    return static_cast<bool>(file);
+}
+
+bool loadProgramCache(const std::string& path, std::vector<RegisterProgram>& programs) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Reader in(data.data(), data.size());
+    char magic[sizeof(kCacheMagic)];
+    if (!in.bytes(magic, sizeof(magic)) || std::memcmp(magic, kCacheMagic, sizeof(magic)) != 0 ||
+        in.u32() != kCacheVersion) {
+        return false;
+    }
+    const uint32_t count = in.u32();
+    if (!in.ok()) {
+        return false;
+    }
+    std::vector<RegisterProgram> result(count);
+    size_t offset = static_cast<size_t>(in.position() - data.data());
+    for (RegisterProgram& program : result) {
+        size_t consumed = 0;
+        if (!program.deserialize(data.data() + offset, data.size() - offset, consumed)) {
+            return false;
+        }
+        offset += consumed;
+    }
+    programs = std::move(result);
+    return true;
+}
+
+void freeParsedConfigs(CameraConfigs& configs) {
+    // the parser allocates the arrays and the control code strings with malloc
+    for (uint32_t i = 0; configs.controls != nullptr && i < configs.controls_length; i++) {
+        std::free(configs.controls[i].code);
+    }
+    std::free(configs.configs);
+    std::free(configs.controls);
+    std::memset(&configs, 0, sizeof(configs));
+}
+
+ModeSwitcher::ModeSwitcher(Camera& camera, DiffOptions options) : camera_(camera), options_(std::move(options)) {}
+
+void ModeSwitcher::addProgram(RegisterProgram program) {
+    const uint32_t id = program.modeId();
+    programs_[id] = std::move(program);
+    for (auto it = diffs_.begin(); it != diffs_.end();) {
+        if (it->first.first == id || it->first.second == id) {
+            it = diffs_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+const RegisterProgram* ModeSwitcher::program(uint32_t mode_id) const {
+    auto it = programs_.find(mode_id);
+    return it == programs_.end() ? nullptr : &it->second;
+}
+
+void ModeSwitcher::setCurrentMode(uint32_t mode_id) {
+    has_current_ = true;
+    current_ = mode_id;
+}
+
+bool ModeSwitcher::currentMode(uint32_t& mode_id) const {
+    if (has_current_) {
+        mode_id = current_;
+    }
+    return has_current_;
+}
+
+void ModeSwitcher::invalidate(uint32_t reg) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dirty_.insert(reg);
+}
+
+void ModeSwitcher::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dirty_all_ = true;
+}
+
+bool ModeSwitcher::switchTo(uint32_t mode_id) {
+    std::set<uint32_t> dirty;
+    bool dirty_all;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dirty.swap(dirty_);
+        dirty_all = dirty_all_;
+        dirty_all_ = false;
+    }
+    if (has_current_ && current_ == mode_id && dirty.empty() && !dirty_all) {
+        last_writes_ = 0;
+        return true;
+    }
+    const RegisterProgram* from = has_current_ ? program(current_) : nullptr;
+    const RegisterProgram* to = program(mode_id);
+    bool ok;
+    if (from != nullptr && to != nullptr && to->sameFormat(*from)) {
+        if (dirty_all) {
+            ok = to->run(camera_);
+            last_writes_ = static_cast<int>(to->writeCount());
+        } else if (!dirty.empty()) {
+            // the registers changed by others are written again, this reduction is not cached
+            DiffOptions options = options_;
+            options.always_write.insert(options.always_write.end(), dirty.begin(), dirty.end());
+            const RegisterProgram reduced = to->diff(*from, options);
+            ok = reduced.run(camera_);
+            last_writes_ = static_cast<int>(reduced.writeCount());
+        } else {
+            auto key = std::make_pair(current_, mode_id);
+            auto it = diffs_.find(key);
+            if (it == diffs_.end()) {
+                it = diffs_.emplace(key, to->diff(*from, options_)).first;
+            }
+            ok = it->second.run(camera_);
+            last_writes_ = static_cast<int>(it->second.writeCount());
+        }
+    } else {
+        ok = camera_.switchMode(mode_id);
+        last_writes_ = -1;
+    }
+    has_current_ = ok;
+    current_ = mode_id;
+    return ok;
+}
+
+}  // namespace Arducam
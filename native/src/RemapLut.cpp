@@ -0,0 +1,549 @@
+#include <arducam/RemapLut.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace Arducam {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// just enough JSON for the coefficient files of the calibration scripts
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& member : members) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+   public:
+    JsonParser(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+    bool parseDocument(JsonValue& value) {
+        if (!parse(value, 0)) {
+            return false;
+        }
+        skipSpace();
+        return p_ == end_;
+    }
+
+   private:
+    static constexpr int kMaxDepth = 32;
+
+    void skipSpace() {
+        while (p_ != end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+            p_++;
+        }
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (p_ != end_ && *p_ == c) {
+            p_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool literal(const char* word) {
+        for (; *word != '\0'; word++, p_++) {
+            if (p_ == end_ || *p_ != *word) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        if (!consume('"')) {
+            return false;
+        }
+        while (p_ != end_ && *p_ != '"') {
+            char c = *p_++;
+            if (c == '\\') {
+                if (p_ == end_) {
+                    return false;
+                }
+                c = *p_++;
+                switch (c) {
+                    case 'n':
+                        c = '\n';
+                        break;
+                    case 't':
+                        c = '\t';
+                        break;
+                    case 'r':
+                        c = '\r';
+                        break;
+                    case 'b':
+                        c = '\b';
+                        break;
+                    case 'f':
+                        c = '\f';
+                        break;
+                    case 'u':
+                        // keys and values of interest are plain ASCII, the code point is dropped
+                        if (end_ - p_ < 4) {
+                            return false;
+                        }
+                        p_ += 4;
+                        continue;
+                    default:
+                        break;
+                }
+            }
+            out.push_back(c);
+        }
+        return consume('"');
+    }
+
+    bool parse(JsonValue& value, int depth) {
+        if (depth > kMaxDepth) {
+            return false;
+        }
+        skipSpace();
+        if (p_ == end_) {
+            return false;
+        }
+        switch (*p_) {
+            case '{':
+                p_++;
+                value.type = JsonValue::Type::Object;
+                if (consume('}')) {
+                    return true;
+                }
+                do {
+                    std::pair<std::string, JsonValue> member;
+                    if (!parseString(member.first) || !consume(':') || !parse(member.second, depth + 1)) {
+                        return false;
+                    }
+                    value.members.push_back(std::move(member));
+                } while (consume(','));
+                return consume('}');
+            case '[':
+                p_++;
+                value.type = JsonValue::Type::Array;
+                if (consume(']')) {
+                    return true;
+                }
+                do {
+                    value.items.emplace_back();
+                    if (!parse(value.items.back(), depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume(']');
+            case '"':
+                value.type = JsonValue::Type::String;
+                return parseString(value.string);
+            case 't':
+                value.type = JsonValue::Type::Bool;
+                value.number = 1;
+                return literal("true");
+            case 'f':
+                value.type = JsonValue::Type::Bool;
+                return literal("false");
+            case 'n':
+                value.type = JsonValue::Type::Null;
+                return literal("null");
+            default: {
+                // strtod needs a terminated string, numbers are short
+                char buffer[64];
+                size_t n = 0;
+                while (p_ + n != end_ && n + 1 < sizeof(buffer) && p_[n] != '\0' &&
+                       std::strchr("+-.0123456789eE", p_[n]) != nullptr) {
+                    buffer[n] = p_[n];
+                    n++;
+                }
+                buffer[n] = '\0';
+                char* parsed = nullptr;
+                value.type = JsonValue::Type::Number;
+                value.number = std::strtod(buffer, &parsed);
+                if (n == 0 || parsed != buffer + n) {
+                    return false;
+                }
+                p_ += n;
+                return true;
+            }
+        }
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+bool readNumber(const JsonValue& object, const char* key, double& out) {
+    const JsonValue* value = object.find(key);
+    if (value == nullptr || value->type != JsonValue::Type::Number) {
+        return false;
+    }
+    out = value->number;
+    return true;
+}
+
+bool readNumber(const JsonValue& object, const char* key, uint32_t& out) {
+    double number;
+    if (!readNumber(object, key, number) || number < 0) {
+        return false;
+    }
+    out = static_cast<uint32_t>(number);
+    return true;
+}
+
+// the crop window clipped to the image, like `crop_image()` of the scripts
+bool cropWindow(const CorrectionParams& params, uint32_t src_width, uint32_t src_height, uint32_t& width,
+                uint32_t& height) {
+    if (params.crop_x >= src_width || params.crop_y >= src_height) {
+        return false;
+    }
+    width = src_width - params.crop_x;
+    height = src_height - params.crop_y;
+    if (params.crop_width != 0) {
+        width = std::min(width, params.crop_width);
+    }
+    if (params.crop_height != 0) {
+        height = std::min(height, params.crop_height);
+    }
+    return width >= 2 && height >= 2;
+}
+
+}  // namespace
+
+bool loadCorrectionParams(const std::string& path, const std::string& camera, CorrectionParams& params) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    JsonValue root;
+    if (!JsonParser(text.data(), text.data() + text.size()).parseDocument(root)) {
+        return false;
+    }
+    const JsonValue* cam = root.find(camera);
+    if (cam == nullptr || cam->type != JsonValue::Type::Object) {
+        return false;
+    }
+
+    CorrectionParams result = params;
+    const JsonValue* coeffs = cam->find("coeffs");
+    result.radial = coeffs != nullptr && coeffs->type == JsonValue::Type::Array && !coeffs->items.empty();
+    result.coeffs.clear();
+    if (result.radial) {
+        if (!readNumber(*cam, "xcenter", result.xcenter) || !readNumber(*cam, "ycenter", result.ycenter)) {
+            return false;
+        }
+        for (const JsonValue& item : coeffs->items) {
+            if (item.type != JsonValue::Type::Number) {
+                return false;
+            }
+            result.coeffs.push_back(item.number);
+        }
+    }
+
+    const JsonValue* pers = cam->find("pers_coef");
+    result.perspective = pers != nullptr && pers->type == JsonValue::Type::Array;
+    if (result.perspective) {
+        if (pers->items.size() != result.pers_coef.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < pers->items.size(); i++) {
+            if (pers->items[i].type != JsonValue::Type::Number) {
+                return false;
+            }
+            result.pers_coef[i] = pers->items[i].number;
+        }
+    }
+
+    if (const JsonValue* crop = cam->find("crop_params")) {
+        result.crop_y = 0;
+        readNumber(*crop, "start_x", result.crop_x);
+        readNumber(*crop, "start_y", result.crop_y);
+        readNumber(*crop, "width", result.crop_width);
+        readNumber(*crop, "height", result.crop_height);
+    }
+    params = std::move(result);
+    return true;
+}
+
+bool correctedSize(const CorrectionParams& params, uint32_t src_width, uint32_t src_height, uint32_t& width,
+                   uint32_t& height) {
+    uint32_t crop_height;
+    if (!cropWindow(params, src_width, src_height, width, crop_height)) {
+        return false;
+    }
+    height = crop_height + params.pad_top + params.pad_bottom;
+    return true;
+}
+
+bool RemapLut::build(const CorrectionParams& params, uint32_t src_width, uint32_t src_height, WorkerPool* pool) {
+    clear();
+    uint32_t crop_width, crop_height;
+    if (src_width > 0x10000 || src_height > 0x10000 || !cropWindow(params, src_width, src_height, crop_width,
+                                                                    crop_height)) {
+        return false;
+    }
+    const uint32_t width = crop_width;
+    const uint32_t height = crop_height + params.pad_top + params.pad_bottom;
+    const size_t count = static_cast<size_t>(width) * height;
+    coords_.resize(count);
+    weights_.resize(count);
+    const uint32_t tile_columns = (width + kTileWidth - 1) / kTileWidth;
+    source_boxes_.resize(static_cast<size_t>(tile_columns) * ((height + kTileHeight - 1) / kTileHeight));
+
+    // `cv2.getRotationMatrix2D` turns about the integer center; the map needs the inverse rotation
+    const double angle = params.rotation * kPi / 180.0;
+    const double cos_a = std::cos(angle);
+    const double sin_a = std::sin(angle);
+    const double rot_x = width / 2;
+    const double rot_y = height / 2;
+    const bool rotate = params.rotation != 0;
+    const std::array<double, 8>& pc = params.pers_coef;
+    const bool radial = params.radial && !params.coeffs.empty();
+    const double xcenter = params.xcenter;
+    const double ycenter = params.ycenter + params.pad_top;
+    const double pad_top = params.pad_top;
+    const double one = 1 << kRemapFracBits;
+
+    auto buildRows = [&](size_t block) {
+        const uint32_t y0 = static_cast<uint32_t>(block) * kTileHeight;
+        const uint32_t y1 = std::min(height, y0 + kTileHeight);
+        // the top-left samples of the tiles of the block: the smallest and the largest
+        SourceBox* boxes = source_boxes_.data() + block * tile_columns;
+        for (uint32_t t = 0; t < tile_columns; t++) {
+            boxes[t] = SourceBox{UINT32_MAX, UINT32_MAX, 0, 0};
+        }
+        for (uint32_t yo = y0; yo < y1; yo++) {
+            uint32_t* coords = coords_.data() + static_cast<size_t>(yo) * width;
+            uint16_t* weights = weights_.data() + static_cast<size_t>(yo) * width;
+            for (uint32_t xo = 0; xo < width; xo++) {
+                // every step maps an output position to the position it samples in the previous step's image
+                double x = xo;
+                double y = yo;
+                if (rotate) {
+                    const double u = x - rot_x;
+                    const double v = y - rot_y;
+                    x = cos_a * u - sin_a * v + rot_x;
+                    y = sin_a * u + cos_a * v + rot_y;
+                }
+                if (params.perspective) {
+                    const double d = pc[6] * x + pc[7] * y + 1.0;
+                    const double px = (pc[0] * x + pc[1] * y + pc[2]) / d;
+                    const double py = (pc[3] * x + pc[4] * y + pc[5]) / d;
+                    x = px;
+                    y = py;
+                }
+                if (radial) {
+                    const double dx = x - xcenter;
+                    const double dy = y - ycenter;
+                    const double r = std::sqrt(dx * dx + dy * dy);
+                    double factor = 0;
+                    for (size_t i = params.coeffs.size(); i-- > 0;) {
+                        factor = factor * r + params.coeffs[i];
+                    }
+                    x = xcenter + factor * dx;
+                    y = ycenter + factor * dy;
+                }
+                y -= pad_top;
+
+                // the padding rows and everything outside the crop window are black
+                if (!(x >= 0 && y >= 0 && x <= crop_width - 1 && y <= crop_height - 1)) {
+                    coords[xo] = 0;
+                    weights[xo] = kRemapOutside;
+                    continue;
+                }
+                // the last column and row use the block to their left / above with full weight on themselves
+                uint32_t sx = std::min(static_cast<uint32_t>(x), crop_width - 2);
+                uint32_t sy = std::min(static_cast<uint32_t>(y), crop_height - 2);
+                uint32_t fx = static_cast<uint32_t>(std::lround((x - sx) * one));
+                uint32_t fy = static_cast<uint32_t>(std::lround((y - sy) * one));
+                coords[xo] = (sx + params.crop_x) | ((sy + params.crop_y) << 16);
+                weights[xo] = static_cast<uint16_t>(fx | (fy << 8));
+                SourceBox& box = boxes[xo / kTileWidth];
+                box.x0 = std::min(box.x0, sx + params.crop_x);
+                box.y0 = std::min(box.y0, sy + params.crop_y);
+                box.x1 = std::max(box.x1, sx + params.crop_x);
+                box.y1 = std::max(box.y1, sy + params.crop_y);
+            }
+        }
+        // the boxes end after the 2x2 blocks; a tile that is all outside reads nothing
+        for (uint32_t t = 0; t < tile_columns; t++) {
+            boxes[t] = boxes[t].x0 != UINT32_MAX ? SourceBox{boxes[t].x0, boxes[t].y0, boxes[t].x1 + 2, boxes[t].y1 + 2}
+                                                 : SourceBox{0, 0, 0, 0};
+        }
+    };
+    const size_t blocks = (height + kTileHeight - 1) / kTileHeight;
+    if (pool != nullptr) {
+        pool->parallelFor(blocks, buildRows);
+    } else {
+        for (size_t block = 0; block < blocks; block++) {
+            buildRows(block);
+        }
+    }
+
+    width_ = width;
+    height_ = height;
+    src_width_ = src_width;
+    src_height_ = src_height;
+    return true;
+}
+
+void RemapLut::clear() {
+    coords_.clear();
+    coords_.shrink_to_fit();
+    weights_.clear();
+    weights_.shrink_to_fit();
+    source_boxes_.clear();
+    source_boxes_.shrink_to_fit();
+    width_ = height_ = src_width_ = src_height_ = 0;
+}
+
+void RemapLut::applyTile(const RemapRowArgs& base, uint8_t* dst, size_t dst_stride, uint32_t x0, uint32_t x1,
+                         uint32_t y0, uint32_t y1) const {
+    const PixelKernelTable& k = pixelKernels();
+    RemapRowArgs args = base;
+    args.count = x1 - x0;
+    for (uint32_t y = y0; y < y1; y++) {
+        const size_t offset = static_cast<size_t>(y) * width_ + x0;
+        args.coords = coords_.data() + offset;
+        args.weights = weights_.data() + offset;
+        args.dst = dst + (y - y0) * dst_stride;
+        k.remapRow(args);
+    }
+}
+
+bool RemapLut::sourceBox(uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, SourceBox& box) const {
+    box = SourceBox{UINT32_MAX, UINT32_MAX, 0, 0};
+    x1 = std::min(x1, width_);
+    y1 = std::min(y1, height_);
+    const uint32_t tile_columns = (width_ + kTileWidth - 1) / kTileWidth;
+    for (uint32_t ty = y0 / kTileHeight; x0 < x1 && ty * kTileHeight < y1; ty++) {
+        for (uint32_t tx = x0 / kTileWidth; tx * kTileWidth < x1; tx++) {
+            const SourceBox& tile = source_boxes_[static_cast<size_t>(ty) * tile_columns + tx];
+            if (tile.x0 < tile.x1) {
+                box.x0 = std::min(box.x0, tile.x0);
+                box.y0 = std::min(box.y0, tile.y0);
+                box.x1 = std::max(box.x1, tile.x1);
+                box.y1 = std::max(box.y1, tile.y1);
+            }
+        }
+    }
+    if (box.x0 == UINT32_MAX) {
+        box = SourceBox{0, 0, 0, 0};
+        return false;
+    }
+    return true;
+}
+
+void RemapLut::applyRows(OutputFormat format, const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+                         uint32_t y0, uint32_t y1) const {
+    applyWindow(format, src, src_stride, SourceBox{0, 0, src_width_, src_height_},
+                dst + static_cast<size_t>(y0) * dst_stride, dst_stride, 0, width_, y0, y1);
+}
+
+void RemapLut::applyWindow(OutputFormat format, const uint8_t* src, size_t src_stride, const SourceBox& window,
+                           uint8_t* dst, size_t dst_stride, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1) const {
+    RemapRowArgs args;
+    args.src = src;
+    args.src_stride = src_stride;
+    args.src_size = src_stride * (window.y1 - window.y0);
+    args.src_x0 = window.x0;
+    args.src_y0 = window.y0;
+    args.format = format;
+    x1 = std::min(x1, width_);
+    // each tile keeps its source rows in the cache; the tiles of the window start at `x0`
+    const size_t pixel_size = outputPixelSize(format);
+    for (uint32_t tx = x0; tx < x1; tx += kTileWidth) {
+        applyTile(args, dst + (tx - x0) * pixel_size, dst_stride, tx, std::min(x1, tx + kTileWidth), y0,
+                  std::min(height_, y1));
+    }
+}
+
+bool RemapLut::apply(OutputFormat format, const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+                     WorkerPool* pool) const {
+    if (empty() || src == nullptr || dst == nullptr) {
+        return false;
+    }
+    const size_t pixel_size = outputPixelSize(format);
+    if (src_stride == 0) {
+        src_stride = src_width_ * pixel_size;
+    }
+    if (dst_stride == 0) {
+        dst_stride = width_ * pixel_size;
+    }
+    RemapRowArgs args;
+    args.src = src;
+    args.src_stride = src_stride;
+    args.src_size = src_stride * src_height_;
+    args.src_x0 = 0;
+    args.src_y0 = 0;
+    args.format = format;
+
+    const uint32_t columns = (width_ + kTileWidth - 1) / kTileWidth;
+    const uint32_t rows = (height_ + kTileHeight - 1) / kTileHeight;
+    auto tile = [&](size_t index) {
+        const uint32_t x0 = static_cast<uint32_t>(index % columns) * kTileWidth;
+        const uint32_t y0 = static_cast<uint32_t>(index / columns) * kTileHeight;
+        const uint32_t y1 = std::min(height_, y0 + kTileHeight);
+        applyTile(args, dst + static_cast<size_t>(y0) * dst_stride + x0 * pixel_size, dst_stride, x0,
+                  std::min(width_, x0 + kTileWidth), y0, y1);
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(static_cast<size_t>(columns) * rows, tile);
+    } else {
+        for (size_t index = 0; index < static_cast<size_t>(columns) * rows; index++) {
+            tile(index);
+        }
+    }
+    return true;
+}
+
+FrameCorrector::FrameCorrector(const CorrectionParams& params, const ConvertOptions& convert, WorkerPool* pool)
+    : params_(params), convert_(convert), pool_(pool) {}
+
+void FrameCorrector::setParams(const CorrectionParams& params) {
+    params_ = params;
+    lut_.clear();
+}
+
+bool FrameCorrector::prepare(uint32_t src_width, uint32_t src_height) {
+    if (!lut_.empty() && lut_.srcWidth() == src_width && lut_.srcHeight() == src_height) {
+        return true;
+    }
+    return lut_.build(params_, src_width, src_height, pool_);
+}
+
+bool FrameCorrector::process(const Frame& frame, uint8_t* dst, size_t dst_stride) {
+    if (convert_.output == OutputFormat::Raw16 || dst == nullptr ||
+        !prepare(frame.format.width, frame.format.height)) {
+        return false;
+    }
+    const size_t pixel_size = outputPixelSize(convert_.output);
+    const size_t image_stride = frame.format.width * pixel_size;
+    image_.resize(image_stride * frame.format.height);
+    scratch_.resize(convertScratchSize(frame.format));
+    if (!convertFrame(frame, convert_, image_.data(), image_stride, scratch_.data())) {
+        return false;
+    }
+    return lut_.apply(convert_.output, image_.data(), image_stride, dst, dst_stride, pool_);
+}
+
+}  // namespace Arducam
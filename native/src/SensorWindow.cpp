@@ -0,0 +1,174 @@
+#include <arducam/SensorWindow.hpp>
+
+#include <algorithm>
+
+#include <arducam/RegisterProgram.hpp>
+
+namespace Arducam {
+
+namespace {
+
+uint32_t alignDown(uint32_t value, uint32_t step) { return value / step * step; }
+uint32_t alignUp(uint32_t value, uint32_t step) { return (value + step - 1) / step * step; }
+
+void push16(std::vector<RegWrite>& writes, uint32_t reg, uint32_t value) {
+    writes.push_back({reg, (value >> 8) & 0xFF});
+    writes.push_back({reg + 1, value & 0xFF});
+}
+
+// the aligned span [start, start + size) holding [begin, end), moved inside [0, limit) if it sticks out
+bool alignSpan(uint32_t begin, uint32_t end, uint32_t step, uint32_t limit, uint32_t& start, uint32_t& size) {
+    start = alignDown(begin, step);
+    size = alignUp(end - start, step);
+    if (size > limit) {
+        return false;
+    }
+    if (start + size > limit) {
+        start = alignDown(limit - size, step);
+    }
+    return start <= begin && start + size >= end;
+}
+
+}  // namespace
+
+bool validWindow(const SensorGeometry& geometry, const SensorWindow& window) {
+    if (window.binning != 1 && window.binning != 2) {
+        return false;
+    }
+    const uint32_t x_step = geometry.x_step * window.binning;
+    const uint32_t y_step = geometry.y_step * window.binning;
+    return window.width != 0 && window.height != 0 && window.x % geometry.x_step == 0 &&
+           window.y % geometry.y_step == 0 && window.width % x_step == 0 && window.height % y_step == 0 &&
+           window.x <= geometry.array_width && window.width <= geometry.array_width - window.x &&
+           window.y <= geometry.array_height && window.height <= geometry.array_height - window.y;
+}
+
+bool centeredWindow(const SensorGeometry& geometry, uint32_t width, uint32_t height, uint8_t binning,
+                    SensorWindow& window) {
+    if (binning != 1 && binning != 2) {
+        return false;
+    }
+    SensorWindow result;
+    result.binning = binning;
+    result.width = alignUp(width, geometry.x_step * binning);
+    result.height = alignUp(height, geometry.y_step * binning);
+    if (result.width > geometry.array_width || result.height > geometry.array_height) {
+        return false;
+    }
+    result.x = alignDown((geometry.array_width - result.width) / 2, geometry.x_step);
+    result.y = alignDown((geometry.array_height - result.height) / 2, geometry.y_step);
+    if (!validWindow(geometry, result)) {
+        return false;
+    }
+    window = result;
+    return true;
+}
+
+bool windowForCrop(const SensorGeometry& geometry, const CorrectionParams& params, uint8_t binning,
+                   SensorWindow& window, CorrectionParams& windowed) {
+    if ((binning != 1 && binning != 2) || params.crop_x >= geometry.array_width ||
+        params.crop_y >= geometry.array_height) {
+        return false;
+    }
+    const uint32_t crop_width = params.crop_width != 0 ? params.crop_width : geometry.array_width - params.crop_x;
+    const uint32_t crop_height = params.crop_height != 0 ? params.crop_height : geometry.array_height - params.crop_y;
+    SensorWindow result;
+    result.binning = binning;
+    if (!alignSpan(params.crop_x, params.crop_x + crop_width, geometry.x_step * binning, geometry.array_width,
+                   result.x, result.width) ||
+        !alignSpan(params.crop_y, params.crop_y + crop_height, geometry.y_step * binning, geometry.array_height,
+                   result.y, result.height) ||
+        !validWindow(geometry, result)) {
+        return false;
+    }
+
+    CorrectionParams out = params;
+    out.crop_x = (params.crop_x - result.x) / binning;
+    out.crop_y = (params.crop_y - result.y) / binning;
+    out.crop_width = crop_width / binning;
+    out.crop_height = crop_height / binning;
+    if (binning != 1) {
+        // the correction is given in crop window pixels, which shrink by `binning`
+        const double s = binning;
+        out.pad_top = params.pad_top / binning;
+        out.pad_bottom = params.pad_bottom / binning;
+        out.xcenter = params.xcenter / s;
+        out.ycenter = params.ycenter / s;
+        // r * sum(c_i r^i) at r = s * r_b, divided by s, is r_b * sum(c_i s^i r_b^i)
+        double scale = 1.0;
+        for (auto& coeff : out.coeffs) {
+            coeff *= scale;
+            scale *= s;
+        }
+        // x = s * x_b and x' = s * x'_b in the homography
+        out.pers_coef[2] = params.pers_coef[2] / s;
+        out.pers_coef[5] = params.pers_coef[5] / s;
+        out.pers_coef[6] = params.pers_coef[6] * s;
+        out.pers_coef[7] = params.pers_coef[7] * s;
+    }
+    window = result;
+    windowed = out;
+    return true;
+}
+
+std::vector<RegWrite> windowWrites(const SensorGeometry& geometry, const SensorWindow& window) {
+    std::vector<RegWrite> writes;
+    if (window.frame_length != 0) {
+        push16(writes, geometry.frame_length_reg, window.frame_length);
+    }
+    push16(writes, geometry.x_start_reg, window.x);
+    push16(writes, geometry.y_start_reg, window.y);
+    push16(writes, geometry.x_end_reg, window.x + window.width - 1);
+    push16(writes, geometry.y_end_reg, window.y + window.height - 1);
+    push16(writes, geometry.x_out_reg, window.outputWidth());
+    push16(writes, geometry.y_out_reg, window.outputHeight());
+    if (geometry.digital_crop_reg != 0) {
+        push16(writes, geometry.digital_crop_reg, 0);
+        push16(writes, geometry.digital_crop_reg + 2, 0);
+        push16(writes, geometry.digital_crop_reg + 4, window.outputWidth());
+        push16(writes, geometry.digital_crop_reg + 6, window.outputHeight());
+    }
+    writes.push_back({geometry.binning_reg, window.binning != 1 ? 1u : 0u});
+    writes.push_back({geometry.binning_reg + 1, window.binning != 1 ? 0x22u : 0x11u});
+    std::stable_sort(writes.begin(), writes.end(), [](const RegWrite& a, const RegWrite& b) { return a.reg < b.reg; });
+    return writes;
+}
+
+ArducamCameraConfig windowConfig(const ArducamCameraConfig& base, const SensorWindow& window) {
+    ArducamCameraConfig config = base;
+    config.width = window.outputWidth();
+    config.height = window.outputHeight();
+    return config;
+}
+
+bool applySensorWindow(Camera& camera, const SensorGeometry& geometry, const SensorWindow& window,
+                       const TransferConfig* transfers, bool restart, ModeSwitcher* mode_switcher) {
+    if (!validWindow(geometry, window)) {
+        return false;
+    }
+    if (mode_switcher != nullptr) {
+        mode_switcher->invalidate();
+    }
+    // stopping an already stopped camera is harmless, its result is not needed
+    camera.stop();
+    // the configuration is set first: it reloads the camera, which rewrites the registers of the mode
+    if (!camera.setConfig(windowConfig(camera.config(), window))) {
+        return false;
+    }
+    const std::vector<RegWrite> writes = windowWrites(geometry, window);
+    RegBatchOptions options;
+    options.mode = I2CMode::I2C_MODE_16_8;
+    if (!writeRegs(camera, writes.data(), writes.size(), options)) {
+        return false;
+    }
+    const bool transfers_set = transfers != nullptr
+                                   ? camera.setTransfer(transfers->transfer_count, transfers->buffer_size) &&
+                                         camera.setMemType(transfers->mem_type)
+                                   : camera.setAutoTransfer(true);
+    if (!transfers_set) {
+        return false;
+    }
+    return !restart || camera.start();
+}
+
+}  // namespace Arducam
@@ -0,0 +1,238 @@
+#include <arducam/StereoPairer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+#include "Common.hpp"
+
+namespace Arducam {
+
+namespace {
+
+// 100 ns, the unit of `TimeSource::Firmware` timestamps
+using Ticks = std::chrono::duration<int64_t, std::ratio<1, 10000000>>;
+
+int index(StereoSide side) { return side == StereoSide::Left ? 0 : 1; }
+
+StereoSide sideOf(int index) { return index == 0 ? StereoSide::Left : StereoSide::Right; }
+
+}  // namespace
+
+ClockOffsetEstimator::ClockOffsetEstimator(uint32_t window) : samples_(std::max<uint32_t>(window, 1)) {}
+
+void ClockOffsetEstimator::reset() {
+    next_ = 0;
+    count_ = 0;
+    offset_ = 0;
+}
+
+void ClockOffsetEstimator::addSample(int64_t host, int64_t device) {
+    samples_[next_] = host - device;
+    next_ = (next_ + 1) % samples_.size();
+    count_ = std::min<uint32_t>(count_ + 1, static_cast<uint32_t>(samples_.size()));
+    // the window is small, a linear scan is cheaper than maintaining a monotonic queue
+    offset_ = *std::min_element(samples_.begin(), samples_.begin() + count_);
+}
+
+StereoPairer::StereoPairer(Camera& left, Camera& right, const StereoPairerOptions& options) : StereoPairer(options) {
+    cameras_[0] = &left;
+    cameras_[1] = &right;
+}
+
+StereoPairer::StereoPairer(const StereoPairerOptions& options)
+    : options_(options),
+      ts_scale_(options.time_source == TimeSource::System ? 10000 : 1),
+      clocks_{ClockOffsetEstimator(options.offset_window), ClockOffsetEstimator(options.offset_window)},
+      pairs_(options.output_capacity) {}
+
+StereoPairer::~StereoPairer() noexcept {
+    stop();
+    detach();
+}
+
+void StereoPairer::attach(EventDispatcher& left, EventDispatcher& right) {
+    detach();
+    EventDispatcher* events[2] = {&left, &right};
+    for (int i = 0; i < 2; i++) {
+        StereoSide side = sideOf(i);
+        events_[i] = events[i];
+        listener_ids_[i] = events[i]->addListener([this, side](EventCode event) {
+            if (event == EventCode::SyncTime) {
+                resync(side);
+            }
+        });
+    }
+}
+
+void StereoPairer::detach() {
+    for (int i = 0; i < 2; i++) {
+        if (events_[i] != nullptr) {
+            events_[i]->removeListener(listener_ids_[i]);
+            events_[i] = nullptr;
+            listener_ids_[i] = -1;
+        }
+    }
+}
+
+bool StereoPairer::start() {
+    if (cameras_[0] == nullptr || cameras_[1] == nullptr || running_.exchange(true)) {
+        return false;
+    }
+    for (int i = 0; i < 2; i++) {
+        threads_[i] = std::thread(&StereoPairer::run, this, sideOf(i));
+    }
+    return true;
+}
+
+void StereoPairer::stop() {
+    running_.store(false);
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void StereoPairer::push(StereoSide side, FrameRef frame) {
+    if (!frame) {
+        return;
+    }
+    const int self = index(side);
+    const int other = 1 - self;
+    const int64_t host = hostNow();
+    const int64_t device = static_cast<int64_t>(frame.timestamp()) * ts_scale_;
+
+    std::vector<std::pair<int, FrameRef>> unmatched;
+    UnmatchedCallback callback;
+    bool paired = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        clocks_[self].addSample(host, device);
+        const int64_t time = device + clocks_[self].offset();
+        const int64_t other_offset = clocks_[other].offset();
+        auto& candidates = pending_[other];
+
+        // frames of the other camera that are too old for this frame are too old for any later frame as well
+        while (!candidates.empty() && candidates.front().device_time + other_offset < time - options_.tolerance) {
+            unmatched.emplace_back(other, std::move(candidates.front().frame));
+            candidates.pop_front();
+        }
+
+        size_t best = candidates.size();
+        int64_t best_diff = std::numeric_limits<int64_t>::max();
+        for (size_t i = 0; i < candidates.size(); i++) {
+            int64_t diff = std::abs(candidates[i].device_time + other_offset - time);
+            if (diff <= options_.tolerance && diff < best_diff) {
+                best = i;
+                best_diff = diff;
+            }
+        }
+
+        if (best < candidates.size()) {
+            for (size_t i = 0; i < best; i++) {
+                unmatched.emplace_back(other, std::move(candidates[i].frame));
+            }
+            StereoPair pair;
+            int64_t other_time = candidates[best].device_time + other_offset;
+            FrameRef& partner = candidates[best].frame;
+            if (side == StereoSide::Left) {
+                pair.left = std::move(frame);
+                pair.right = std::move(partner);
+                pair.skew = other_time - time;
+            } else {
+                pair.left = std::move(partner);
+                pair.right = std::move(frame);
+                pair.skew = time - other_time;
+            }
+            candidates.erase(candidates.begin(), candidates.begin() + best + 1);
+            stats_.pairs++;
+            stats_.max_skew = std::max(stats_.max_skew, best_diff);
+            emit(std::move(pair));
+            paired = true;
+        } else {
+            pending_[self].push_back({std::move(frame), device});
+            if (pending_[self].size() > options_.max_pending) {
+                unmatched.emplace_back(self, std::move(pending_[self].front().frame));
+                pending_[self].pop_front();
+            }
+        }
+
+        for (const auto& entry : unmatched) {
+            stats_.unmatched[entry.first]++;
+        }
+        if (!unmatched.empty()) {
+            callback = unmatched_callback_;
+        }
+    }
+
+    if (paired) {
+        pairs_ready_.notify();
+    }
+    if (callback) {
+        for (const auto& entry : unmatched) {
+            callback(sideOf(entry.first), entry.second);
+        }
+    }
+}
+
+void StereoPairer::resync(StereoSide side) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clocks_[index(side)].reset();
+}
+
+void StereoPairer::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_[0].clear();
+    pending_[1].clear();
+}
+
+bool StereoPairer::tryPop(StereoPair& pair) { return pairs_.tryPop(pair); }
+
+bool StereoPairer::pop(StereoPair& pair, int timeout) {
+    if (pairs_.tryPop(pair)) {
+        return true;
+    }
+    pairs_ready_.wait([this] { return !pairs_.empty(); }, timeout);
+    return pairs_.tryPop(pair);
+}
+
+void StereoPairer::setUnmatchedCallback(const UnmatchedCallback& func) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unmatched_callback_ = func;
+}
+
+StereoPairerStats StereoPairer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StereoPairerStats stats = stats_;
+    stats.offset[0] = clocks_[0].offset();
+    stats.offset[1] = clocks_[1].offset();
+    return stats;
+}
+
+int64_t StereoPairer::hostNow() const {
+    return std::chrono::duration_cast<Ticks>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StereoPairer::run(StereoSide side) {
+    Camera& camera = *cameras_[index(side)];
+    FrameRef frame;
+    while (running_.load(std::memory_order_relaxed)) {
+        if (captureRef(camera, frame, detail::kCapturePollTimeout)) {
+            push(side, std::move(frame));
+        }
+    }
+}
+
+void StereoPairer::emit(StereoPair&& pair) {
+    while (!pairs_.tryPush(pair)) {
+        StereoPair oldest;
+        if (pairs_.tryPop(oldest)) {
+            stats_.dropped_pairs++;
+        }
+    }
+}
+
+}  // namespace Arducam
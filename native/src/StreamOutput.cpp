@@ -0,0 +1,588 @@
+#include <arducam/StreamOutput.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace Arducam {
+
+namespace {
+
+constexpr size_t kRtpHeaderSize = 12;
+// the RTP payload types of RFC 3551 and the first dynamic one
+constexpr uint8_t kJpegPayloadType = 26;
+constexpr uint8_t kDynamicPayloadType = 96;
+// the RTP clock of video, also the time scale of the MP4 track
+constexpr uint32_t kVideoClock = 90000;
+// the sample duration of the first MP4 fragment, before two timestamps are known
+constexpr uint32_t kDefaultDuration = kVideoClock / 30;
+
+uint32_t videoClock(uint64_t timestamp_us) { return static_cast<uint32_t>(timestamp_us * 9 / 100); }
+
+void put16(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value >> 8);
+    p[1] = static_cast<uint8_t>(value);
+}
+
+void put32(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+uint16_t get16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+
+// calls `fn(nal, size)` for every NAL unit of an H.264 Annex B byte stream
+template <typename Fn>
+bool forEachNal(const uint8_t* data, size_t size, Fn&& fn) {
+    size_t start = SIZE_MAX;
+    size_t i = 0;
+    while (i + 2 < size) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if (start != SIZE_MAX) {
+                size_t end = i;
+                // the first zero of a four byte start code, or trailing zeros
+                while (end > start && data[end - 1] == 0) {
+                    end--;
+                }
+                if (end > start && !fn(data + start, end - start)) {
+                    return false;
+                }
+            }
+            i += 3;
+            start = i;
+        } else {
+            i++;
+        }
+    }
+    if (start != SIZE_MAX && start < size) {
+        return fn(data + start, size - start);
+    }
+    return true;
+}
+
+// the parts of a baseline JPEG the RTP payload format needs
+struct JpegLayout {
+    uint8_t type = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint16_t restart_interval = 0;
+    // the luma and the chroma quantization table
+    const uint8_t* tables[2] = {nullptr, nullptr};
+    const uint8_t* scan = nullptr;
+    size_t scan_size = 0;
+};
+
+bool parseJpeg(const uint8_t* data, size_t size, JpegLayout& layout) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+    const uint8_t* tables[4] = {nullptr, nullptr, nullptr, nullptr};
+    uint8_t selectors[2] = {0, 1};
+    bool frame = false;
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+        const size_t length = get16(data + pos + 2);
+        const uint8_t* segment = data + pos + 4;
+        if (length < 2 || pos + 2 + length > size) {
+            return false;
+        }
+        const size_t body = length - 2;
+        if (marker == 0xDB) {
+            for (size_t i = 0; i + 65 <= body; i += 65) {
+                // 16-bit tables cannot be sent with a Q of 255 in one header
+                if ((segment[i] >> 4) != 0) {
+                    return false;
+                }
+                tables[segment[i] & 0x03] = segment + i + 1;
+            }
+        } else if (marker == 0xC0) {
+            if (body < 15 || segment[5] != 3 || (segment[7] != 0x21 && segment[7] != 0x22) ||
+                segment[10] != 0x11 || segment[13] != 0x11) {
+                return false;
+            }
+            layout.height = get16(segment + 1);
+            layout.width = get16(segment + 3);
+            layout.type = segment[7] == 0x22 ? 1 : 0;
+            selectors[0] = segment[8] & 0x03;
+            selectors[1] = segment[11] & 0x03;
+            frame = true;
+        } else if (marker > 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            // only baseline frames have an RTP payload type
+            return false;
+        } else if (marker == 0xDD && body >= 2) {
+            layout.restart_interval = get16(segment);
+        } else if (marker == 0xDA) {
+            size_t end = size;
+            if (end >= 2 && data[end - 2] == 0xFF && data[end - 1] == 0xD9) {
+                end -= 2;
+            }
+            layout.scan = segment + body;
+            layout.scan_size = end - (pos + 2 + length);
+            break;
+        }
+        pos += 2 + length;
+    }
+    layout.tables[0] = tables[selectors[0]];
+    layout.tables[1] = tables[selectors[1]];
+    // the size is sent in 8 pixel blocks, at most 2040 pixels
+    return frame && layout.scan != nullptr && layout.tables[0] != nullptr && layout.tables[1] != nullptr &&
+           layout.width % 8 == 0 && layout.height % 8 == 0 && layout.width <= 2040 && layout.height <= 2040;
+}
+
+// appends ISO base media file format boxes, big-endian
+class BoxWriter {
+   public:
+    explicit BoxWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    // starts a box and returns its offset, for `end()`
+    size_t begin(const char* type) {
+        const size_t offset = out_.size();
+        u32(0);
+        out_.insert(out_.end(), type, type + 4);
+        return offset;
+    }
+    size_t beginFull(const char* type, uint8_t version, uint32_t flags) {
+        const size_t offset = begin(type);
+        u32((static_cast<uint32_t>(version) << 24) | flags);
+        return offset;
+    }
+    void end(size_t offset) { put32(out_.data() + offset, static_cast<uint32_t>(out_.size() - offset)); }
+
+    void u8(uint8_t value) { out_.push_back(value); }
+    void u16(uint32_t value) {
+        u8(static_cast<uint8_t>(value >> 8));
+        u8(static_cast<uint8_t>(value));
+    }
+    void u32(uint32_t value) {
+        u16(value >> 16);
+        u16(value);
+    }
+    void u64(uint64_t value) {
+        u32(static_cast<uint32_t>(value >> 32));
+        u32(static_cast<uint32_t>(value));
+    }
+    void zeros(size_t count) { out_.insert(out_.end(), count, 0); }
+    void bytes(const uint8_t* data, size_t size) { out_.insert(out_.end(), data, data + size); }
+    void matrix() {
+        const uint32_t unity[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+        for (uint32_t value : unity) {
+            u32(value);
+        }
+    }
+
+   private:
+    std::vector<uint8_t>& out_;
+};
+
+}  // namespace
+
+std::unique_ptr<RtpSender> RtpSender::create(const RtpOptions& options) {
+    // room for the JPEG headers and the quantization tables
+    if (options.mtu < kRtpHeaderSize + 256) {
+        return nullptr;
+    }
+    std::unique_ptr<RtpSender> sender(new RtpSender(options));
+#if defined(_WIN32)
+    static const bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    if (!started) {
+        return nullptr;
+    }
+#endif
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    const std::string port = std::to_string(options.port);
+    if (getaddrinfo(options.host.c_str(), port.c_str(), &hints, &result) != 0 || result == nullptr) {
+        return nullptr;
+    }
+    const uint8_t* address = reinterpret_cast<const uint8_t*>(result->ai_addr);
+    sender->address_.assign(address, address + result->ai_addrlen);
+    freeaddrinfo(result);
+#if defined(_WIN32)
+    const SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) {
+        return nullptr;
+    }
+#else
+    const int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0) {
+        return nullptr;
+    }
+#endif
+    sender->socket_ = static_cast<intptr_t>(s);
+    return sender;
+}
+
+RtpSender::RtpSender(const RtpOptions& options) : options_(options), buffer_(options.mtu) {
+    std::random_device random;
+    if (options_.ssrc == 0) {
+        options_.ssrc = static_cast<uint32_t>(random()) | 1;
+    }
+    sequence_ = static_cast<uint16_t>(random());
+}
+
+RtpSender::~RtpSender() {
+    if (socket_ != -1) {
+#if defined(_WIN32)
+        closesocket(static_cast<SOCKET>(socket_));
+#else
+        close(static_cast<int>(socket_));
+#endif
+    }
+}
+
+bool RtpSender::send(const EncodedPacket& packet) {
+    const uint32_t timestamp = videoClock(packet.timestamp_us);
+    return packet.codec == VideoCodec::H264 ? sendH264(packet, timestamp) : sendJpeg(packet, timestamp);
+}
+
+bool RtpSender::sendH264(const EncodedPacket& packet, uint32_t timestamp) {
+    const uint8_t payload_type = options_.payload_type != 0 ? options_.payload_type : kDynamicPayloadType;
+    const size_t room = options_.mtu - kRtpHeaderSize;
+    // the NAL units are sent one behind, so that the last one of the frame gets the marker
+    const uint8_t* pending = nullptr;
+    size_t pending_size = 0;
+    auto flush = [&](bool last) {
+        uint8_t* payload = buffer_.data() + kRtpHeaderSize;
+        if (pending_size <= room) {
+            std::memcpy(payload, pending, pending_size);
+            return sendPacket(pending_size, timestamp, last, payload_type);
+        }
+        // FU-A: the NAL header is split into the indicator and the fragment header
+        const uint8_t indicator = static_cast<uint8_t>((pending[0] & 0xE0) | 28);
+        const uint8_t type = pending[0] & 0x1F;
+        const uint8_t* data = pending + 1;
+        size_t left = pending_size - 1;
+        bool first = true;
+        while (left > 0) {
+            const size_t chunk = std::min(left, room - 2);
+            const bool end = chunk == left;
+            payload[0] = indicator;
+            payload[1] = static_cast<uint8_t>((first ? 0x80 : 0) | (end ? 0x40 : 0) | type);
+            std::memcpy(payload + 2, data, chunk);
+            if (!sendPacket(chunk + 2, timestamp, last && end, payload_type)) {
+                return false;
+            }
+            data += chunk;
+            left -= chunk;
+            first = false;
+        }
+        return true;
+    };
+    const bool ok = forEachNal(packet.data, packet.size, [&](const uint8_t* nal, size_t size) {
+        if (pending != nullptr && !flush(false)) {
+            return false;
+        }
+        pending = nal;
+        pending_size = size;
+        return true;
+    });
+    return ok && pending != nullptr && flush(true);
+}
+
+bool RtpSender::sendJpeg(const EncodedPacket& packet, uint32_t timestamp) {
+    JpegLayout layout;
+    if (!parseJpeg(packet.data, packet.size, layout)) {
+        return false;
+    }
+    const uint8_t payload_type = options_.payload_type != 0 ? options_.payload_type : kJpegPayloadType;
+    const bool restart = layout.restart_interval != 0;
+    const size_t room = options_.mtu - kRtpHeaderSize;
+    size_t offset = 0;
+    do {
+        uint8_t* payload = buffer_.data() + kRtpHeaderSize;
+        // the main JPEG header: type specific, fragment offset, type, Q, width and height
+        payload[0] = 0;
+        payload[1] = static_cast<uint8_t>(offset >> 16);
+        payload[2] = static_cast<uint8_t>(offset >> 8);
+        payload[3] = static_cast<uint8_t>(offset);
+        payload[4] = static_cast<uint8_t>(layout.type + (restart ? 64 : 0));
+        payload[5] = 255;
+        payload[6] = static_cast<uint8_t>(layout.width / 8);
+        payload[7] = static_cast<uint8_t>(layout.height / 8);
+        size_t header = 8;
+        if (restart) {
+            // whole frames only, so the restart intervals need not be aligned to the packets
+            put16(payload + header, layout.restart_interval);
+            put16(payload + header + 2, 0xFFFF);
+            header += 4;
+        }
+        if (offset == 0) {
+            payload[header] = 0;
+            payload[header + 1] = 0;
+            put16(payload + header + 2, 128);
+            std::memcpy(payload + header + 4, layout.tables[0], 64);
+            std::memcpy(payload + header + 68, layout.tables[1], 64);
+            header += 132;
+        }
+        const size_t chunk = std::min(layout.scan_size - offset, room - header);
+        std::memcpy(payload + header, layout.scan + offset, chunk);
+        offset += chunk;
+        if (!sendPacket(header + chunk, timestamp, offset == layout.scan_size, payload_type)) {
+            return false;
+        }
+    } while (offset < layout.scan_size);
+    return true;
+}
+
+bool RtpSender::sendPacket(size_t size, uint32_t timestamp, bool marker, uint8_t payload_type) {
+    uint8_t* header = buffer_.data();
+    header[0] = 0x80;
+    header[1] = static_cast<uint8_t>((marker ? 0x80 : 0) | (payload_type & 0x7F));
+    put16(header + 2, sequence_++);
+    put32(header + 4, timestamp);
+    put32(header + 8, options_.ssrc);
+    const size_t length = kRtpHeaderSize + size;
+#if defined(_WIN32)
+    const int sent = sendto(static_cast<SOCKET>(socket_), reinterpret_cast<const char*>(header),
+                            static_cast<int>(length), 0, reinterpret_cast<const sockaddr*>(address_.data()),
+                            static_cast<int>(address_.size()));
+#else
+    const ssize_t sent = sendto(static_cast<int>(socket_), header, length, 0,
+                                reinterpret_cast<const sockaddr*>(address_.data()),
+                                static_cast<socklen_t>(address_.size()));
+#endif
+    if (sent < 0 || static_cast<size_t>(sent) != length) {
+        return false;
+    }
+    packets_++;
+    bytes_ += length;
+    return true;
+}
+
+Fmp4Muxer::Fmp4Muxer(StreamWriter writer) : writer_(std::move(writer)), last_duration_(kDefaultDuration) {}
+
+bool Fmp4Muxer::write(const EncodedPacket& packet) {
+    if (packet.codec != VideoCodec::H264) {
+        return false;
+    }
+    // the sample: the NAL units with length prefixes, without the parameter sets and delimiters
+    std::vector<uint8_t> sps;
+    std::vector<uint8_t> pps;
+    sample_.clear();
+    forEachNal(packet.data, packet.size, [&](const uint8_t* nal, size_t size) {
+        const uint8_t type = nal[0] & 0x1F;
+        if (type == 7) {
+            sps.assign(nal, nal + size);
+        } else if (type == 8) {
+            pps.assign(nal, nal + size);
+        } else if (type != 9) {
+            const size_t offset = sample_.size();
+            sample_.resize(offset + 4);
+            put32(sample_.data() + offset, static_cast<uint32_t>(size));
+            sample_.insert(sample_.end(), nal, nal + size);
+        }
+        return true;
+    });
+    if (!started_) {
+        if (!packet.keyframe || sps.size() < 4 || pps.empty()) {
+            // a decoder cannot start before a key frame: not an error
+            return true;
+        }
+        if (!writeInit(packet, sps, pps)) {
+            return false;
+        }
+        first_timestamp_us_ = packet.timestamp_us;
+        last_timestamp_us_ = packet.timestamp_us;
+        started_ = true;
+    }
+    if (sample_.empty()) {
+        return true;
+    }
+    // the duration of a frame is only known with the next one: the last interval stands in for it
+    if (packet.timestamp_us > last_timestamp_us_) {
+        last_duration_ = std::max<uint32_t>(videoClock(packet.timestamp_us - last_timestamp_us_), 1);
+    }
+    last_timestamp_us_ = std::max(last_timestamp_us_, packet.timestamp_us);
+    const uint64_t decode_time =
+        packet.timestamp_us > first_timestamp_us_ ? (packet.timestamp_us - first_timestamp_us_) * 9 / 100 : 0;
+
+    box_.clear();
+    BoxWriter w(box_);
+    const size_t moof = w.begin("moof");
+    const size_t mfhd = w.beginFull("mfhd", 0, 0);
+    w.u32(++sequence_);
+    w.end(mfhd);
+    const size_t traf = w.begin("traf");
+    // default-base-is-moof
+    const size_t tfhd = w.beginFull("tfhd", 0, 0x020000);
+    w.u32(1);
+    w.end(tfhd);
+    const size_t tfdt = w.beginFull("tfdt", 1, 0);
+    w.u64(decode_time);
+    w.end(tfdt);
+    // data offset, sample duration, size and flags present
+    const size_t trun = w.beginFull("trun", 0, 0x000701);
+    w.u32(1);
+    const size_t data_offset = box_.size();
+    w.u32(0);
+    w.u32(last_duration_);
+    w.u32(static_cast<uint32_t>(sample_.size()));
+    // a sync sample, or one that depends on others and is not a sync sample
+    w.u32(packet.keyframe ? 0x02000000 : 0x01010000);
+    w.end(trun);
+    w.end(traf);
+    w.end(moof);
+    put32(box_.data() + data_offset, static_cast<uint32_t>(box_.size() - moof + 8));
+    w.u32(static_cast<uint32_t>(sample_.size() + 8));
+    w.bytes(reinterpret_cast<const uint8_t*>("mdat"), 4);
+    return writer_(box_.data(), box_.size()) && writer_(sample_.data(), sample_.size());
+}
+
+bool Fmp4Muxer::writeInit(const EncodedPacket& packet, const std::vector<uint8_t>& sps,
+                          const std::vector<uint8_t>& pps) {
+    box_.clear();
+    BoxWriter w(box_);
+    const size_t ftyp = w.begin("ftyp");
+    w.bytes(reinterpret_cast<const uint8_t*>("isom"), 4);
+    w.u32(0x200);
+    w.bytes(reinterpret_cast<const uint8_t*>("isomiso6avc1mp41"), 16);
+    w.end(ftyp);
+
+    const size_t moov = w.begin("moov");
+    const size_t mvhd = w.beginFull("mvhd", 0, 0);
+    w.u32(0);
+    w.u32(0);
+    w.u32(kVideoClock);
+    w.u32(0);
+    w.u32(0x00010000);
+    w.u16(0x0100);
+    w.zeros(10);
+    w.matrix();
+    w.zeros(24);
+    w.u32(2);
+    w.end(mvhd);
+
+    const size_t trak = w.begin("trak");
+    // enabled and in the movie
+    const size_t tkhd = w.beginFull("tkhd", 0, 0x000003);
+    w.u32(0);
+    w.u32(0);
+    w.u32(1);
+    w.u32(0);
+    w.u32(0);
+    w.zeros(8);
+    w.u16(0);
+    w.u16(0);
+    w.u16(0);
+    w.u16(0);
+    w.matrix();
+    w.u32(packet.width << 16);
+    w.u32(packet.height << 16);
+    w.end(tkhd);
+
+    const size_t mdia = w.begin("mdia");
+    const size_t mdhd = w.beginFull("mdhd", 0, 0);
+    w.u32(0);
+    w.u32(0);
+    w.u32(kVideoClock);
+    w.u32(0);
+    // "und"
+    w.u16(0x55C4);
+    w.u16(0);
+    w.end(mdhd);
+    const size_t hdlr = w.beginFull("hdlr", 0, 0);
+    w.u32(0);
+    w.bytes(reinterpret_cast<const uint8_t*>("vide"), 4);
+    w.zeros(12);
+    w.bytes(reinterpret_cast<const uint8_t*>("VideoHandler"), 13);
+    w.end(hdlr);
+
+    const size_t minf = w.begin("minf");
+    const size_t vmhd = w.beginFull("vmhd", 0, 1);
+    w.zeros(8);
+    w.end(vmhd);
+    const size_t dinf = w.begin("dinf");
+    const size_t dref = w.beginFull("dref", 0, 0);
+    w.u32(1);
+    // the media data is in this file
+    const size_t url = w.beginFull("url ", 0, 1);
+    w.end(url);
+    w.end(dref);
+    w.end(dinf);
+
+    const size_t stbl = w.begin("stbl");
+    const size_t stsd = w.beginFull("stsd", 0, 0);
+    w.u32(1);
+    const size_t avc1 = w.begin("avc1");
+    w.zeros(6);
+    w.u16(1);
+    w.zeros(16);
+    w.u16(packet.width);
+    w.u16(packet.height);
+    w.u32(0x00480000);
+    w.u32(0x00480000);
+    w.u32(0);
+    w.u16(1);
+    w.zeros(32);
+    w.u16(0x0018);
+    w.u16(0xFFFF);
+    const size_t avcc = w.begin("avcC");
+    // version, profile, constraints and level from the SPS, 4 byte lengths, one SPS and one PPS
+    w.u8(1);
+    w.u8(sps[1]);
+    w.u8(sps[2]);
+    w.u8(sps[3]);
+    w.u8(0xFF);
+    w.u8(0xE1);
+    w.u16(static_cast<uint32_t>(sps.size()));
+    w.bytes(sps.data(), sps.size());
+    w.u8(1);
+    w.u16(static_cast<uint32_t>(pps.size()));
+    w.bytes(pps.data(), pps.size());
+    w.end(avcc);
+    w.end(avc1);
+    w.end(stsd);
+    // the samples are all in the fragments
+    for (const char* type : {"stts", "stsc", "stco"}) {
+        const size_t box = w.beginFull(type, 0, 0);
+        w.u32(0);
+        w.end(box);
+    }
+    const size_t stsz = w.beginFull("stsz", 0, 0);
+    w.u32(0);
+    w.u32(0);
+    w.end(stsz);
+    w.end(stbl);
+    w.end(minf);
+    w.end(mdia);
+    w.end(trak);
+
+    const size_t mvex = w.begin("mvex");
+    const size_t trex = w.beginFull("trex", 0, 0);
+    w.u32(1);
+    w.u32(1);
+    w.u32(0);
+    w.u32(0);
+    w.u32(0);
+    w.end(trex);
+    w.end(mvex);
+    w.end(moov);
+    return writer_(box_.data(), box_.size());
+}
+
+}  // namespace Arducam
@@ -0,0 +1,255 @@
+#include <arducam/Telemetry.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "Common.hpp"
+
+namespace Arducam {
+
+namespace {
+
+constexpr int kSubBits = 2;
+
+size_t bucketOf(uint64_t value) {
+    if (value < (1u << kSubBits)) {
+        return static_cast<size_t>(value);
+    }
+    int msb = 63;
+    while ((value >> msb) == 0) {
+        msb--;
+    }
+    const int shift = msb - kSubBits;
+    const size_t sub = static_cast<size_t>((value >> shift) & ((1u << kSubBits) - 1));
+    return (static_cast<size_t>(shift + 1) << kSubBits) + sub;
+}
+
+void appendLine(std::string& out, const std::string& prefix, const char* name, double value) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%s_%s %.17g\n", prefix.c_str(), name, value);
+    out += line;
+}
+
+void appendHistogram(std::string& out, const std::string& prefix, const char* name,
+                     const HistogramSnapshot& histogram) {
+    const std::string base = prefix + "_" + name;
+    appendLine(out, base, "count", static_cast<double>(histogram.count));
+    appendLine(out, base, "mean", histogram.mean());
+    appendLine(out, base, "p50", static_cast<double>(histogram.percentile(0.5)));
+    appendLine(out, base, "p99", static_cast<double>(histogram.percentile(0.99)));
+    appendLine(out, base, "max", static_cast<double>(histogram.max));
+}
+
+}  // namespace
+
+namespace detail {
+
+size_t metricShard() {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t shard = next.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+    return shard;
+}
+
+}  // namespace detail
+
+uint64_t MetricCounter::value() const {
+    uint64_t sum = 0;
+    for (const auto& shard : shards_) {
+        sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(MetricHistogram::bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+MetricHistogram::Shard::Shard() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+MetricHistogram::MetricHistogram() : shards_(new Shard[kMetricShards]) {}
+
+void MetricHistogram::record(uint64_t value) {
+    Shard& shard = shards_[detail::metricShard()];
+    shard.buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    detail::updateMax(shard.max, value);
+    // counted last, so that a concurrent snapshot never sees more values than bucket entries
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+HistogramSnapshot MetricHistogram::snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.buckets.assign(kBuckets, 0);
+    for (size_t s = 0; s < kMetricShards; s++) {
+        const Shard& shard = shards_[s];
+        snapshot.count += shard.count.load(std::memory_order_relaxed);
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < kBuckets; i++) {
+            snapshot.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+uint64_t MetricHistogram::bucketUpperBound(size_t bucket) {
+    if (bucket < (1u << kSubBits)) {
+        return bucket;
+    }
+    const int shift = static_cast<int>(bucket >> kSubBits) - 1;
+    const uint64_t base = (uint64_t(1) << kSubBits) | (bucket & ((1u << kSubBits) - 1));
+    // the last bucket wraps around to UINT64_MAX
+    return ((base + 1) << shift) - 1;
+}
+
+CameraTelemetry::CameraTelemetry(Camera& camera, EventDispatcher& events) : camera_(camera), events_(events) {
+    listener_ = events_.addListener([this](EventCode event) { onEvent(event); });
+}
+
+CameraTelemetry::~CameraTelemetry() { events_.removeListener(listener_); }
+
+bool CameraTelemetry::capture(FrameRef& ref, int timeout) {
+    if (!captureRef(camera_, ref, timeout)) {
+        capture_timeouts_.add();
+        return false;
+    }
+    onFrame(ref.frame());
+    return true;
+}
+
+Camera::CaptureCallback CameraTelemetry::wrapCallback(Camera::CaptureCallback callback) {
+    return [this, callback](Frame frame) {
+        onFrame(frame);
+        const uint64_t start = detail::nowUs();
+        callback(frame);
+        callback_us_.record(detail::nowUs() - start);
+    };
+}
+
+void CameraTelemetry::onFrame(const Frame& frame) {
+    frames_.add();
+    bytes_.add(frame.size);
+    const int64_t last = last_seq_.exchange(frame.seq, std::memory_order_relaxed);
+    // a lower sequence number means the camera was restarted
+    if (last >= 0 && frame.seq > last + 1) {
+        starved_frames_.add(static_cast<uint64_t>(frame.seq - last - 1));
+    }
+    const int depth = camera_.getAvailCount();
+    queue_depth_.set(depth);
+    queue_depths_.record(depth > 0 ? static_cast<uint64_t>(depth) : 0);
+    if (depth <= 0) {
+        queue_empty_.add();
+    }
+}
+
+void CameraTelemetry::onEvent(EventCode event) {
+    switch (event) {
+        case EventCode::FrameStart:
+            frame_starts_.add();
+            frame_start_us_ = detail::nowUs();
+            break;
+        case EventCode::FrameEnd:
+            frame_ends_.add();
+            if (frame_start_us_ != 0) {
+                frame_assembly_us_.record(detail::nowUs() - frame_start_us_);
+                frame_start_us_ = 0;
+            }
+            break;
+        case EventCode::TransferError:
+            transfer_errors_.add();
+            break;
+        case EventCode::TransferTimeout:
+            transfer_timeouts_.add();
+            break;
+        case EventCode::TransferLengthError:
+            transfer_length_errors_.add();
+            break;
+        default:
+            break;
+    }
+}
+
+CameraMetrics CameraTelemetry::snapshot() const {
+    CameraMetrics metrics;
+    metrics.frame_starts = frame_starts_.value();
+    metrics.frame_ends = frame_ends_.value();
+    metrics.transfer_errors = transfer_errors_.value();
+    metrics.transfer_timeouts = transfer_timeouts_.value();
+    metrics.transfer_length_errors = transfer_length_errors_.value();
+    metrics.frames = frames_.value();
+    metrics.bytes = bytes_.value();
+    metrics.capture_timeouts = capture_timeouts_.value();
+    metrics.starved_frames = starved_frames_.value();
+    metrics.queue_empty = queue_empty_.value();
+    metrics.queue_depth = queue_depth_.value();
+    metrics.queue_depth_max = queue_depth_.max();
+    metrics.frame_assembly_us = frame_assembly_us_.snapshot();
+    metrics.callback_us = callback_us_.snapshot();
+    metrics.queue_depths = queue_depths_.snapshot();
+    return metrics;
+}
+
+void DeviceTelemetry::onEvent(EventCode event) {
+    switch (event) {
+        case EventCode::DeviceConnect:
+            connects_.add();
+            break;
+        case EventCode::UnknownDeviceConnect:
+            unknown_connects_.add();
+            break;
+        case EventCode::DeviceDisconnect:
+            disconnects_.add();
+            break;
+        default:
+            break;
+    }
+}
+
+DeviceMetrics DeviceTelemetry::snapshot() const {
+    DeviceMetrics metrics;
+    metrics.connects = connects_.value();
+    metrics.unknown_connects = unknown_connects_.value();
+    metrics.disconnects = disconnects_.value();
+    return metrics;
+}
+
+void formatMetrics(const std::string& prefix, const CameraMetrics& metrics, std::string& out) {
+    appendLine(out, prefix, "frame_starts", static_cast<double>(metrics.frame_starts));
+    appendLine(out, prefix, "frame_ends", static_cast<double>(metrics.frame_ends));
+    appendLine(out, prefix, "transfer_errors", static_cast<double>(metrics.transfer_errors));
+    appendLine(out, prefix, "transfer_timeouts", static_cast<double>(metrics.transfer_timeouts));
+    appendLine(out, prefix, "transfer_length_errors", static_cast<double>(metrics.transfer_length_errors));
+    appendLine(out, prefix, "frames", static_cast<double>(metrics.frames));
+    appendLine(out, prefix, "bytes", static_cast<double>(metrics.bytes));
+    appendLine(out, prefix, "capture_timeouts", static_cast<double>(metrics.capture_timeouts));
+    appendLine(out, prefix, "starved_frames", static_cast<double>(metrics.starved_frames));
+    appendLine(out, prefix, "queue_empty", static_cast<double>(metrics.queue_empty));
+    appendLine(out, prefix, "queue_depth", static_cast<double>(metrics.queue_depth));
+    appendLine(out, prefix, "queue_depth_max", static_cast<double>(metrics.queue_depth_max));
+    appendHistogram(out, prefix, "frame_assembly_us", metrics.frame_assembly_us);
+    appendHistogram(out, prefix, "callback_us", metrics.callback_us);
+    appendHistogram(out, prefix, "queue_depths", metrics.queue_depths);
+}
+
+void formatMetrics(const std::string& prefix, const DeviceMetrics& metrics, std::string& out) {
+    appendLine(out, prefix, "device_connects", static_cast<double>(metrics.connects));
+    appendLine(out, prefix, "device_unknown_connects", static_cast<double>(metrics.unknown_connects));
+    appendLine(out, prefix, "device_disconnects", static_cast<double>(metrics.disconnects));
+}
+
+}  // namespace Arducam
@@ -0,0 +1,440 @@
+#include <arducam/TileGraph.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Arducam {
+
+namespace {
+
+constexpr size_t kScratchAlign = 64;
+
+size_t alignScratch(size_t size) { return (size + kScratchAlign - 1) / kScratchAlign * kScratchAlign; }
+
+}  // namespace
+
+// the window of converted source pixels of one remap in one unit: the columns are fixed by the plan, the rows slide
+struct TileWindow {
+    bool planned = false;
+    uint32_t x0 = 0;
+    uint32_t x1 = 0;
+    // the most rows one tile reads, the rows of the source, and the rows the window has room for
+    uint32_t max_rows = 0;
+    uint32_t source_rows = 0;
+    uint32_t capacity = 0;
+    uint8_t* data = nullptr;
+    size_t stride = 0;
+    // the rows held
+    uint32_t y0 = 0;
+    uint32_t y1 = 0;
+};
+
+struct TileUnit {
+    explicit TileUnit(size_t nodes) : windows(nodes) {}
+
+    // the output rectangle of the unit
+    uint32_t x0 = 0;
+    uint32_t x1 = 0;
+    uint32_t y0 = 0;
+    uint32_t y1 = 0;
+    std::vector<TileWindow> windows;
+    uint16_t* convert_scratch = nullptr;
+    size_t convert_samples = 0;
+    // the source bytes the tiles planned so far read
+    uint64_t read_bytes = 0;
+    const std::vector<Frame>* frames = nullptr;
+    TileGraphStats stats;
+};
+
+struct TileNodes {
+    class Source : public TileNode {
+       public:
+        Source(size_t input, const ArducamFrameFormat& format, const ConvertOptions& options)
+            : TileNode(format.width, format.height, options.output), input_(input), frame_format_(format),
+              options_(options) {}
+
+       private:
+        void plan(TileUnit& unit, uint32_t, uint32_t, uint32_t, uint32_t) const override {
+            unit.convert_samples = std::max(unit.convert_samples, convertScratchSize(frame_format_));
+        }
+
+        void pull(TileUnit& unit, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, uint8_t* dst,
+                  size_t dst_stride) const override {
+            // checked by accepts() before the run
+            convertFrameRegion((*unit.frames)[input_], options_, x0, x1, y0, y1, dst, dst_stride,
+                               unit.convert_scratch);
+            unit.stats.converted_pixels += static_cast<uint64_t>(x1 - x0) * (y1 - y0);
+        }
+
+        bool accepts(const std::vector<Frame>& frames) const override {
+            if (input_ >= frames.size()) {
+                return false;
+            }
+            const Frame& frame = frames[input_];
+            return frame.format.width == frame_format_.width && frame.format.height == frame_format_.height &&
+                   frame.format.format == frame_format_.format &&
+                   frame.format.bit_width == frame_format_.bit_width &&
+                   convertFrameRegion(frame, options_, 0, 0, 0, 0, nullptr, 0, nullptr);
+        }
+
+        size_t input_;
+        ArducamFrameFormat frame_format_;
+        ConvertOptions options_;
+    };
+
+    class Remap : public TileNode {
+       public:
+        Remap(const TileNode* source, const RemapLut& lut)
+            : TileNode(lut.width(), lut.height(), source->format()), source_(source), lut_(lut) {}
+
+       private:
+        void plan(TileUnit& unit, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1) const override {
+            SourceBox box;
+            if (!lut_.sourceBox(x0, x1, y0, y1, box)) {
+                return;
+            }
+            unit.read_bytes += static_cast<uint64_t>(box.x1 - box.x0) * (box.y1 - box.y0) * outputPixelSize(format());
+            TileWindow& window = unit.windows[index_];
+            if (!window.planned) {
+                window.planned = true;
+                window.x0 = box.x0;
+                window.x1 = box.x1;
+                window.source_rows = source_->height();
+            }
+            window.x0 = std::min(window.x0, box.x0);
+            window.x1 = std::max(window.x1, box.x1);
+            window.max_rows = std::max(window.max_rows, box.y1 - box.y0);
+            source_->plan(unit, box.x0, box.x1, box.y0, box.y1);
+        }
+
+        void pull(TileUnit& unit, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, uint8_t* dst,
+                  size_t dst_stride) const override {
+            TileWindow& w = unit.windows[index_];
+            SourceBox box;
+            if (!lut_.sourceBox(x0, x1, y0, y1, box)) {
+                // every pixel is black, nothing is read
+                lut_.applyWindow(format(), w.data, w.stride, SourceBox{0, 0, 0, 0}, dst, dst_stride, x0, x1, y0, y1);
+                return;
+            }
+            if (box.y0 < w.y0 || box.y0 > w.y1) {
+                // above the window (the tiles of a strong rotation move up) or below it
+                unit.stats.window_resets += w.y1 > w.y0 ? 1 : 0;
+                w.y0 = w.y1 = box.y0;
+            } else if (box.y1 > w.y0 + w.capacity) {
+                // the rows above this tile are done with
+                std::memmove(w.data, w.data + (box.y0 - w.y0) * w.stride, (w.y1 - box.y0) * w.stride);
+                w.y0 = box.y0;
+                unit.stats.window_slides++;
+            }
+            if (box.y1 > w.y1) {
+                source_->pull(unit, w.x0, w.x1, w.y1, box.y1, w.data + (w.y1 - w.y0) * w.stride, w.stride);
+                w.y1 = box.y1;
+            }
+            lut_.applyWindow(format(), w.data, w.stride, SourceBox{w.x0, w.y0, w.x1, w.y1}, dst, dst_stride, x0, x1,
+                             y0, y1);
+        }
+
+        const TileNode* source_;
+        const RemapLut& lut_;
+    };
+
+    class SideBySide : public TileNode {
+       public:
+        SideBySide(std::vector<const TileNode*> inputs, uint32_t width, uint32_t height)
+            : TileNode(width, height, inputs[0]->format()), inputs_(std::move(inputs)) {
+            uint32_t offset = 0;
+            for (const TileNode* input : inputs_) {
+                offsets_.push_back(offset);
+                offset += input->width();
+            }
+        }
+
+       private:
+        // calls `fn(input, x0, x1, offset into the rectangle)` for the inputs the columns `[x0, x1)` cover
+        template <typename Fn>
+        void split(uint32_t x0, uint32_t x1, Fn&& fn) const {
+            for (size_t i = 0; i < inputs_.size(); i++) {
+                const uint32_t begin = std::max(x0, offsets_[i]);
+                const uint32_t end = std::min(x1, offsets_[i] + inputs_[i]->width());
+                if (begin < end) {
+                    fn(*inputs_[i], begin - offsets_[i], end - offsets_[i], begin - x0);
+                }
+            }
+        }
+
+        void plan(TileUnit& unit, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1) const override {
+            split(x0, x1, [&](const TileNode& input, uint32_t ix0, uint32_t ix1, uint32_t) {
+                input.plan(unit, ix0, ix1, y0, y1);
+            });
+        }
+
+        void pull(TileUnit& unit, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1, uint8_t* dst,
+                  size_t dst_stride) const override {
+            const size_t pixel_size = outputPixelSize(format());
+            split(x0, x1, [&](const TileNode& input, uint32_t ix0, uint32_t ix1, uint32_t offset) {
+                input.pull(unit, ix0, ix1, y0, y1, dst + offset * pixel_size, dst_stride);
+            });
+        }
+
+        void seams(uint32_t x0, std::vector<uint32_t>& seams) const override {
+            for (size_t i = 0; i < inputs_.size(); i++) {
+                seams.push_back(x0 + offsets_[i]);
+                inputs_[i]->seams(x0 + offsets_[i], seams);
+            }
+        }
+
+        std::vector<const TileNode*> inputs_;
+        std::vector<uint32_t> offsets_;
+    };
+};
+
+TileGraph::TileGraph(const TileGraphOptions& options) : options_(options) {
+    options_.max_tile_columns = std::max(1u, options_.max_tile_columns);
+    options_.max_tile_rows = std::max(1u, options_.max_tile_rows);
+    options_.units_per_thread = std::max(1u, options_.units_per_thread);
+}
+
+TileGraph::~TileGraph() { releaseScratch(); }
+
+TileNode* TileGraph::add(std::unique_ptr<TileNode> node) {
+    node->index_ = nodes_.size();
+    nodes_.push_back(std::move(node));
+    prepared_ = false;
+    return nodes_.back().get();
+}
+
+bool TileGraph::owns(const TileNode* node) const {
+    return std::any_of(nodes_.begin(), nodes_.end(),
+                       [node](const std::unique_ptr<TileNode>& owned) { return owned.get() == node; });
+}
+
+TileNode* TileGraph::addSource(size_t input, const ArducamFrameFormat& format, const ConvertOptions& options) {
+    return add(std::unique_ptr<TileNode>(new TileNodes::Source(input, format, options)));
+}
+
+TileNode* TileGraph::addRemap(TileNode* source, const RemapLut& lut) {
+    const TileNodes::Source* s = dynamic_cast<const TileNodes::Source*>(source);
+    if (s == nullptr || !owns(source) || lut.empty() || s->width() != lut.srcWidth() ||
+        s->height() != lut.srcHeight()) {
+        return nullptr;
+    }
+    return add(std::unique_ptr<TileNode>(new TileNodes::Remap(s, lut)));
+}
+
+TileNode* TileGraph::addSideBySide(const std::vector<TileNode*>& inputs) {
+    if (inputs.empty()) {
+        return nullptr;
+    }
+    uint32_t width = 0;
+    uint32_t height = UINT32_MAX;
+    for (const TileNode* input : inputs) {
+        if (input == nullptr || !owns(input) || input->format() != inputs[0]->format()) {
+            return nullptr;
+        }
+        width += input->width();
+        height = std::min(height, input->height());
+    }
+    return add(std::unique_ptr<TileNode>(
+        new TileNodes::SideBySide(std::vector<const TileNode*>(inputs.begin(), inputs.end()), width, height)));
+}
+
+bool TileGraph::setOutput(TileNode* node) {
+    if (node == nullptr || !owns(node)) {
+        return false;
+    }
+    output_ = node;
+    prepared_ = false;
+    return true;
+}
+
+void TileGraph::releaseScratch() {
+    if (options_.arena) {
+        for (uint8_t* block : blocks_) {
+            options_.arena->release(block);
+        }
+    }
+    blocks_.clear();
+    scratch_.clear();
+    scratch_.shrink_to_fit();
+}
+
+bool TileGraph::prepare(size_t threads) {
+    releaseScratch();
+    units_.clear();
+    scratch_size_ = 0;
+    prepared_ = false;
+    if (output_ == nullptr || width() == 0 || height() == 0) {
+        return false;
+    }
+    const uint32_t width = this->width();
+    const uint32_t height = this->height();
+    const size_t pixel_size = outputPixelSize(format());
+
+    // the tiles never straddle the seam of two images, so that each unit reads one source
+    std::vector<uint32_t> cuts = {0, width};
+    output_->seams(0, cuts);
+    std::sort(cuts.begin(), cuts.end());
+    cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+    cuts.erase(std::remove_if(cuts.begin(), cuts.end(), [width](uint32_t x) { return x > width; }), cuts.end());
+
+    // the largest tile whose output and source pixels fit the cache on average
+    tile_width_ = RemapLut::kTileWidth;
+    tile_height_ = RemapLut::kTileHeight;
+    uint64_t best_area = 0;
+    for (uint32_t columns = 1; columns <= options_.max_tile_columns; columns *= 2) {
+        for (uint32_t rows = 1; rows <= options_.max_tile_rows; rows *= 2) {
+            const uint32_t tw = columns * RemapLut::kTileWidth;
+            const uint32_t th = rows * RemapLut::kTileHeight;
+            TileUnit probe(nodes_.size());
+            uint64_t bytes = 0;
+            uint64_t tiles = 0;
+            for (size_t c = 0; c + 1 < cuts.size(); c++) {
+                for (uint32_t x = cuts[c]; x < cuts[c + 1]; x += tw) {
+                    const uint32_t x1 = std::min(cuts[c + 1], x + tw);
+                    for (uint32_t y = 0; y < height; y += th) {
+                        const uint32_t y1 = std::min(height, y + th);
+                        probe.read_bytes = 0;
+                        output_->plan(probe, x, x1, y, y1);
+                        bytes += probe.read_bytes + static_cast<uint64_t>(x1 - x) * (y1 - y) * pixel_size;
+                        tiles++;
+                    }
+                }
+            }
+            const uint64_t area = static_cast<uint64_t>(tw) * th;
+            if (tiles != 0 && bytes / tiles <= options_.cache_bytes && area > best_area) {
+                best_area = area;
+                tile_width_ = tw;
+                tile_height_ = th;
+            }
+        }
+    }
+
+    // one unit per column of tiles, the columns cut into runs of rows if there are too few for the threads
+    std::vector<std::pair<uint32_t, uint32_t>> strips;
+    for (size_t c = 0; c + 1 < cuts.size(); c++) {
+        for (uint32_t x = cuts[c]; x < cuts[c + 1]; x += tile_width_) {
+            strips.emplace_back(x, std::min(cuts[c + 1], x + tile_width_));
+        }
+    }
+    const size_t target = std::max<size_t>(1, threads) * options_.units_per_thread;
+    const uint32_t tile_rows = (height + tile_height_ - 1) / tile_height_;
+    const uint32_t runs = static_cast<uint32_t>(
+        std::min<size_t>(tile_rows, std::max<size_t>(1, (target + strips.size() - 1) / strips.size())));
+    const uint32_t run_rows = (tile_rows + runs - 1) / runs * tile_height_;
+
+    std::vector<size_t> unit_sizes;
+    for (const auto& strip : strips) {
+        for (uint32_t y = 0; y < height; y += run_rows) {
+            std::unique_ptr<TileUnit> unit(new TileUnit(nodes_.size()));
+            unit->x0 = strip.first;
+            unit->x1 = strip.second;
+            unit->y0 = y;
+            unit->y1 = std::min(height, y + run_rows);
+            for (uint32_t ty = unit->y0; ty < unit->y1; ty += tile_height_) {
+                output_->plan(*unit, unit->x0, unit->x1, ty, std::min(unit->y1, ty + tile_height_));
+            }
+            size_t size = alignScratch(unit->convert_samples * sizeof(uint16_t));
+            for (size_t n = 0; n < nodes_.size(); n++) {
+                TileWindow& window = unit->windows[n];
+                if (!window.planned) {
+                    continue;
+                }
+                // twice the rows of a tile, so that the window slides once every few tiles
+                window.capacity = std::max(window.max_rows, std::min(2 * window.max_rows, window.source_rows));
+                window.stride = alignScratch((window.x1 - window.x0) * outputPixelSize(nodes_[n]->format()));
+                size += window.stride * window.capacity;
+            }
+            unit_sizes.push_back(size);
+            scratch_size_ += size;
+            units_.push_back(std::move(unit));
+        }
+    }
+
+    // the scratch of every unit in one piece, from the arena if its blocks are large enough
+    std::vector<uint8_t*> bases;
+    const size_t largest = *std::max_element(unit_sizes.begin(), unit_sizes.end());
+    if (options_.arena && options_.arena->blockSize() >= largest) {
+        for (size_t i = 0; i < units_.size(); i++) {
+            uint8_t* block = options_.arena->acquire();
+            if (block == nullptr) {
+                break;
+            }
+            blocks_.push_back(block);
+        }
+        if (blocks_.size() == units_.size()) {
+            bases = blocks_;
+        } else {
+            releaseScratch();
+        }
+    }
+    if (bases.empty()) {
+        scratch_.assign(scratch_size_ / sizeof(uint64_t), 0);
+        uint8_t* p = reinterpret_cast<uint8_t*>(scratch_.data());
+        for (size_t size : unit_sizes) {
+            bases.push_back(p);
+            p += size;
+        }
+    }
+    for (size_t i = 0; i < units_.size(); i++) {
+        TileUnit& unit = *units_[i];
+        uint8_t* p = bases[i];
+        unit.convert_scratch = reinterpret_cast<uint16_t*>(p);
+        p += alignScratch(unit.convert_samples * sizeof(uint16_t));
+        for (TileWindow& window : unit.windows) {
+            if (window.planned) {
+                window.data = p;
+                p += window.stride * window.capacity;
+            }
+        }
+    }
+    prepared_threads_ = threads;
+    prepared_ = true;
+    return true;
+}
+
+bool TileGraph::run(const std::vector<Frame>& frames, uint8_t* dst, size_t dst_stride, WorkerPool* pool) {
+    const size_t threads = pool != nullptr ? pool->size() + 1 : 1;
+    if (dst == nullptr || ((!prepared_ || prepared_threads_ != threads) && !prepare(threads))) {
+        return false;
+    }
+    for (const std::unique_ptr<TileNode>& node : nodes_) {
+        if (!node->accepts(frames)) {
+            return false;
+        }
+    }
+    const size_t pixel_size = outputPixelSize(format());
+    if (dst_stride == 0) {
+        dst_stride = width() * pixel_size;
+    }
+
+    auto runUnit = [&](size_t index) {
+        TileUnit& unit = *units_[index];
+        unit.frames = &frames;
+        for (TileWindow& window : unit.windows) {
+            window.y0 = window.y1 = 0;
+        }
+        for (uint32_t y = unit.y0; y < unit.y1; y += tile_height_) {
+            output_->pull(unit, unit.x0, unit.x1, y, std::min(unit.y1, y + tile_height_),
+                          dst + y * dst_stride + unit.x0 * pixel_size, dst_stride);
+        }
+        unit.frames = nullptr;
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(units_.size(), runUnit);
+    } else {
+        for (size_t i = 0; i < units_.size(); i++) {
+            runUnit(i);
+        }
+    }
+
+    stats_.runs++;
+    for (const std::unique_ptr<TileUnit>& unit : units_) {
+        stats_.converted_pixels += unit->stats.converted_pixels;
+        stats_.window_slides += unit->stats.window_slides;
+        stats_.window_resets += unit->stats.window_resets;
+        unit->stats = TileGraphStats();
+    }
+    return true;
+}
+
+}  // namespace Arducam
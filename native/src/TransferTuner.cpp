@@ -0,0 +1,306 @@
+#include <arducam/TransferTuner.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "Common.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Arducam {
+
+namespace {
+
+// how often update() looks at the telemetry
+constexpr uint64_t kCheckIntervalUs = 20000;
+// transfer buffers stay a multiple of the USB 3 bulk packet size
+constexpr int kBufferAlign = 1024;
+
+size_t transferBytes(const TransferConfig& config) {
+    return static_cast<size_t>(config.transfer_count) * static_cast<size_t>(config.buffer_size);
+}
+
+bool sameConfig(const TransferConfig& a, const TransferConfig& b) {
+    return a.transfer_count == b.transfer_count && a.buffer_size == b.buffer_size && a.mem_type == b.mem_type;
+}
+
+uint64_t lostFrames(const CameraMetrics& m) {
+    return m.starved_frames + m.transfer_errors + m.transfer_timeouts + m.transfer_length_errors;
+}
+
+std::string hostName() {
+#if defined(_WIN32)
+    char name[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD size = sizeof(name);
+    if (!GetComputerNameA(name, &size)) {
+        return "localhost";
+    }
+    std::string host(name, size);
+#else
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0 || name[0] == '\0') {
+        return "localhost";
+    }
+    std::string host(name);
+#endif
+    // the key is one word of the profile file
+    std::replace_if(
+        host.begin(), host.end(), [](char c) { return c == ' ' || c == '\t' || c == '/'; }, '_');
+    return host;
+}
+
+}  // namespace
+
+TransferTuner::TransferTuner(Camera& camera, CameraTelemetry& telemetry, const TransferConfig& start,
+                             const TransferTunerOptions& options)
+    : camera_(camera), telemetry_(telemetry), options_(options), current_(start) {
+    if (options_.max_transfers <= 0) {
+        options_.max_transfers = std::max(options_.min_transfers, 2 * start.transfer_count);
+    }
+    if (options_.min_buffer_size <= 0) {
+        options_.min_buffer_size = std::max(kBufferAlign, start.buffer_size / 4);
+    }
+    if (options_.max_buffer_size <= 0) {
+        options_.max_buffer_size = std::max(options_.min_buffer_size, start.buffer_size * 4);
+    }
+    best_.config = start;
+    beginPhase(Phase::Count);
+    beginWindow(detail::nowUs());
+}
+
+bool TransferTuner::update() {
+    const uint64_t now = detail::nowUs();
+    if (now < next_check_us_) {
+        return true;
+    }
+    next_check_us_ = now + kCheckIntervalUs;
+    const uint64_t window_us = static_cast<uint64_t>(options_.window_s * 1e6);
+    if (warming_) {
+        const CameraMetrics metrics = telemetry_.snapshot();
+        // a configuration that delivers nothing is measured as such after one window
+        if (metrics.frames - warmup_start_frames_ < options_.warmup_frames && now - warmup_start_us_ < window_us) {
+            return true;
+        }
+        warming_ = false;
+        window_start_ = metrics;
+        window_start_us_ = now;
+        return true;
+    }
+    if (now - window_start_us_ < window_us) {
+        return true;
+    }
+    return finishWindow(now);
+}
+
+bool TransferTuner::better(const TransferMeasurement& a, const TransferMeasurement& b) const {
+    if (a.loss_rate + options_.loss_tolerance < b.loss_rate) {
+        return true;
+    }
+    if (b.loss_rate + options_.loss_tolerance < a.loss_rate) {
+        return false;
+    }
+    if (a.fps > b.fps * (1 + options_.min_gain)) {
+        return true;
+    }
+    if (b.fps > a.fps * (1 + options_.min_gain)) {
+        return false;
+    }
+    return transferBytes(a.config) < transferBytes(b.config);
+}
+
+bool TransferTuner::fits(const TransferConfig& config) const {
+    return config.transfer_count >= options_.min_transfers && config.transfer_count <= options_.max_transfers &&
+           config.buffer_size >= options_.min_buffer_size && config.buffer_size <= options_.max_buffer_size &&
+           (options_.max_bytes == 0 || transferBytes(config) <= options_.max_bytes);
+}
+
+void TransferTuner::beginWindow(uint64_t now_us) {
+    warming_ = true;
+    warmup_start_us_ = now_us;
+    warmup_start_frames_ = telemetry_.snapshot().frames;
+    next_check_us_ = now_us + kCheckIntervalUs;
+}
+
+bool TransferTuner::finishWindow(uint64_t now_us) {
+    const CameraMetrics end = telemetry_.snapshot();
+    const double seconds = static_cast<double>(now_us - window_start_us_) / 1e6;
+    TransferMeasurement m;
+    m.config = current_;
+    m.fps = static_cast<double>(end.frames - window_start_.frames) / seconds;
+    m.capture_fps = camera_.captureFps();
+    m.bandwidth = camera_.bandwidth();
+    m.loss_rate = static_cast<double>(lostFrames(end) - lostFrames(window_start_)) / seconds;
+    const uint64_t samples = end.queue_depths.count - window_start_.queue_depths.count;
+    m.queue_depth =
+        samples != 0 ? static_cast<double>(end.queue_depths.sum - window_start_.queue_depths.sum) / samples : 0.0;
+    history_.push_back(m);
+
+    if (phase_ == Phase::Settled) {
+        // the camera runs with the best configuration: follow its measurement, and search again when it degrades
+        best_ = m;
+        if (options_.retune && m.loss_rate > settled_loss_ + options_.loss_tolerance) {
+            beginPhase(Phase::Count);
+            return nextCandidate(now_us);
+        }
+        beginWindow(now_us);
+        return true;
+    }
+
+    if (!measured_) {
+        // the starting configuration
+        measured_ = true;
+        best_ = m;
+    } else if (better(m, best_)) {
+        // keep going the same way
+        best_ = m;
+        directions_ = 1;
+    } else if (--directions_ > 0) {
+        direction_ = -direction_;
+    } else {
+        step_ /= 2;
+        direction_ = 1;
+        directions_ = 2;
+    }
+    return nextCandidate(now_us);
+}
+
+void TransferTuner::beginPhase(Phase phase) {
+    phase_ = phase;
+    direction_ = 1;
+    directions_ = 2;
+    if (phase_ == Phase::Count) {
+        step_ = std::max(1, best_.config.transfer_count / 2);
+        min_step_ = 1;
+    } else if (phase_ == Phase::Size) {
+        // a few buffer sizes around the best one; each size is a restart
+        step_ = best_.config.buffer_size / 2 / kBufferAlign * kBufferAlign;
+        min_step_ = std::max(kBufferAlign, best_.config.buffer_size / 8 / kBufferAlign * kBufferAlign);
+    } else {
+        settled_loss_ = best_.loss_rate;
+    }
+}
+
+bool TransferTuner::nextCandidate(uint64_t now_us) {
+    while (phase_ != Phase::Settled) {
+        if (step_ < min_step_) {
+            beginPhase(phase_ == Phase::Count ? Phase::Size : Phase::Settled);
+            continue;
+        }
+        TransferConfig candidate = best_.config;
+        if (phase_ == Phase::Count) {
+            candidate.transfer_count += direction_ * step_;
+        } else {
+            candidate.buffer_size += direction_ * step_;
+        }
+        if (fits(candidate)) {
+            return apply(candidate, now_us);
+        }
+        // out of bounds counts as a worse candidate
+        if (--directions_ > 0) {
+            direction_ = -direction_;
+        } else {
+            step_ /= 2;
+            direction_ = 1;
+            directions_ = 2;
+        }
+    }
+    if (!sameConfig(current_, best_.config)) {
+        return apply(best_.config, now_us);
+    }
+    beginWindow(now_us);
+    return true;
+}
+
+bool TransferTuner::apply(const TransferConfig& config, uint64_t now_us) {
+    restarts_++;
+    // stopping an already stopped camera is harmless, its result is not needed
+    camera_.stop();
+    if (camera_.setTransfer(config.transfer_count, config.buffer_size) && camera_.setMemType(config.mem_type) &&
+        camera_.start()) {
+        current_ = config;
+        beginWindow(now_us);
+        return true;
+    }
+    camera_.stop();
+    phase_ = Phase::Settled;
+    settled_loss_ = best_.loss_rate;
+    if (!sameConfig(config, best_.config) && camera_.setTransfer(best_.config.transfer_count, best_.config.buffer_size) &&
+        camera_.setMemType(best_.config.mem_type) && camera_.start()) {
+        current_ = best_.config;
+    }
+    beginWindow(now_us);
+    return false;
+}
+
+std::string transferProfileKey(const Camera& camera) {
+    const ArducamCameraConfig config = camera.config();
+    char mode[64];
+    std::snprintf(mode, sizeof(mode), "/usb%d/%ux%u/%u/0x%04x", camera.usbTypeNumber(), config.width, config.height,
+                  static_cast<unsigned>(config.bit_width), static_cast<unsigned>(config.format));
+    return hostName() + mode;
+}
+
+bool loadTransferProfile(const std::string& path, const std::string& key, TransferConfig& config) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string name;
+        int count = 0;
+        int size = 0;
+        int mem_type = 0;
+        if (!(in >> name >> count >> size >> mem_type) || name != key) {
+            continue;
+        }
+        if (count <= 0 || size <= 0 || (mem_type != DMA && mem_type != RAM)) {
+            return false;
+        }
+        config.transfer_count = count;
+        config.buffer_size = size;
+        config.mem_type = static_cast<MemType>(mem_type);
+        return true;
+    }
+    return false;
+}
+
+bool saveTransferProfile(const std::string& path, const std::string& key, const TransferConfig& config) {
+    if (key.empty() || key.find_first_of(" \t\r\n") != std::string::npos) {
+        return false;
+    }
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream in(line);
+            std::string name;
+            if (in >> name && name != key) {
+                lines.push_back(line);
+            }
+        }
+    }
+    std::ostringstream entry;
+    entry << key << ' ' << config.transfer_count << ' ' << config.buffer_size << ' '
+          << static_cast<int>(config.mem_type);
+    lines.push_back(entry.str());
+
+    std::ofstream file(path, std::ios::trunc);
+    for (const std::string& line : lines) {
+        file << line << '\n';
+    }
+    return static_cast<bool>(file);
+}
+
+}  // namespace Arducam
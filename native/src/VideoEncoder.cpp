@@ -0,0 +1,741 @@
+#include <arducam/VideoEncoder.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include "Common.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#if ARDUCAM_WITH_X264
+#include <x264.h>
+#endif
+
+#if ARDUCAM_WITH_JPEG
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+
+#include <jpeglib.h>
+#endif
+
+namespace Arducam {
+
+namespace {
+
+// the longest wait for the hardware encoder, in milliseconds
+constexpr int kEncodeTimeout = 1000;
+// the MJPEG quality range of the rate control
+constexpr int kMinQuality = 10;
+constexpr int kMaxQuality = 95;
+
+#if defined(__linux__)
+
+int xioctl(int fd, unsigned long request, void* arg) {
+    int ret;
+    do {
+        ret = ioctl(fd, request, arg);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+bool hasFormat(int fd, uint32_t type, uint32_t fourcc) {
+    v4l2_fmtdesc desc{};
+    desc.type = type;
+    for (desc.index = 0; xioctl(fd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++) {
+        if (desc.pixelformat == fourcc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool setControl(int fd, uint32_t id, int32_t value) {
+    v4l2_control control{};
+    control.id = id;
+    control.value = value;
+    return xioctl(fd, VIDIOC_S_CTRL, &control) == 0;
+}
+
+// waits for `events` on the device
+bool waitFor(int fd, short events) {
+    pollfd p{};
+    p.fd = fd;
+    p.events = events;
+    int ret;
+    do {
+        ret = poll(&p, 1, kEncodeTimeout);
+    } while (ret < 0 && errno == EINTR);
+    return ret > 0 && (p.revents & events) != 0;
+}
+
+#endif
+
+#if ARDUCAM_WITH_JPEG
+
+struct JpegError {
+    jpeg_error_mgr mgr;
+    std::jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) { std::longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jump, 1); }
+
+#endif
+
+// the H.264 NAL unit types of the parameter sets and the access unit delimiter
+bool onlyParameterSets(const uint8_t* data, size_t size) {
+    bool any = false;
+    for (size_t i = 0; i + 3 < size; i++) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            const uint8_t type = data[i + 3] & 0x1F;
+            if (type != 7 && type != 8 && type != 9) {
+                return false;
+            }
+            any = true;
+            i += 3;
+        }
+    }
+    return any;
+}
+
+}  // namespace
+
+struct VideoEncoder::State {
+#if defined(__linux__)
+    struct Buffer {
+        void* data = MAP_FAILED;
+        size_t length = 0;
+        bool queued = false;
+    };
+    int fd = -1;
+    Buffer inputs[2];
+    Buffer outputs[4];
+    // the capture buffers mapped and queued, the only ones the encoder can hand back
+    uint32_t output_count = 0;
+    uint32_t input_index = 0;
+    size_t input_size = 0;
+    size_t luma_size = 0;
+    // parameter sets the encoder returned in a buffer of their own, for the next frame
+    std::vector<uint8_t> header;
+    std::vector<uint8_t> packet;
+#endif
+#if ARDUCAM_WITH_X264
+    x264_param_t x264_param;
+    x264_t* x264 = nullptr;
+    x264_picture_t x264_picture;
+    bool x264_picture_allocated = false;
+    int64_t pts = 0;
+#endif
+#if ARDUCAM_WITH_JPEG
+    jpeg_compress_struct jpeg;
+    JpegError jpeg_error;
+    bool jpeg_created = false;
+    // the output of `jpeg_mem_dest()`, outside the `setjmp()` frame
+    unsigned char* jpeg_buffer = nullptr;
+    unsigned long jpeg_size = 0;
+#endif
+    // the quality the V4L2 MJPEG encoder was last set to
+    int device_quality = 0;
+
+    ~State() {
+#if defined(__linux__)
+        if (fd >= 0) {
+            int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+            xioctl(fd, VIDIOC_STREAMOFF, &type);
+            type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+            xioctl(fd, VIDIOC_STREAMOFF, &type);
+        }
+        for (Buffer& buffer : inputs) {
+            if (buffer.data != MAP_FAILED) {
+                munmap(buffer.data, buffer.length);
+            }
+        }
+        for (Buffer& buffer : outputs) {
+            if (buffer.data != MAP_FAILED) {
+                munmap(buffer.data, buffer.length);
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+#if ARDUCAM_WITH_X264
+        if (x264_picture_allocated) {
+            x264_picture_clean(&x264_picture);
+        }
+        if (x264 != nullptr) {
+            x264_encoder_close(x264);
+        }
+#endif
+#if ARDUCAM_WITH_JPEG
+        if (jpeg_created) {
+            jpeg_destroy_compress(&jpeg);
+        }
+#endif
+    }
+
+#if defined(__linux__)
+    // dequeues the buffers the encoder is done with, waiting for `index` if it is still queued
+    bool reclaimInput(uint32_t index) {
+        while (inputs[index].queued) {
+            v4l2_buffer buf{};
+            v4l2_plane plane{};
+            buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.m.planes = &plane;
+            buf.length = 1;
+            if (xioctl(fd, VIDIOC_DQBUF, &buf) == 0) {
+                // only the 2 mapped buffers are ever queued: another index is a driver fault
+                if (buf.index >= 2) {
+                    return false;
+                }
+                inputs[buf.index].queued = false;
+            } else if (errno != EAGAIN || !waitFor(fd, POLLOUT)) {
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+};
+
+std::unique_ptr<VideoEncoder> VideoEncoder::create(const EncoderOptions& options) {
+    if (options.width < 2 || options.height < 2 || options.width % 2 != 0 || options.height % 2 != 0) {
+        return nullptr;
+    }
+    std::unique_ptr<VideoEncoder> encoder(new VideoEncoder(options));
+    const EncoderBackend backend = options.backend;
+    if ((backend == EncoderBackend::Auto || backend == EncoderBackend::V4l2M2m) && encoder->openV4l2()) {
+        encoder->backend_ = EncoderBackend::V4l2M2m;
+    } else if ((backend == EncoderBackend::Auto || backend == EncoderBackend::X264) &&
+               options.codec == VideoCodec::H264 && encoder->openX264()) {
+        encoder->backend_ = EncoderBackend::X264;
+    } else if ((backend == EncoderBackend::Auto || backend == EncoderBackend::LibJpeg) &&
+               options.codec == VideoCodec::Mjpeg && encoder->openJpeg()) {
+        encoder->backend_ = EncoderBackend::LibJpeg;
+    } else {
+        return nullptr;
+    }
+    return encoder;
+}
+
+VideoEncoder::VideoEncoder(const EncoderOptions& options) : options_(options), state_(new State) {
+    options_.quality = std::min(std::max(options_.quality, kMinQuality), kMaxQuality);
+}
+
+VideoEncoder::~VideoEncoder() = default;
+
+bool VideoEncoder::openV4l2() {
+#if defined(__linux__)
+    const uint32_t codec = options_.codec == VideoCodec::H264 ? V4L2_PIX_FMT_H264 : V4L2_PIX_FMT_JPEG;
+    std::vector<std::string> devices;
+    if (!options_.device.empty()) {
+        devices.push_back(options_.device);
+    } else {
+        for (int i = 0; i < 64; i++) {
+            devices.push_back("/dev/video" + std::to_string(i));
+        }
+    }
+    for (const std::string& device : devices) {
+        // a fresh state per device, which closes the last one
+        state_.reset(new State);
+        State& s = *state_;
+        s.fd = open(device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (s.fd < 0) {
+            continue;
+        }
+        v4l2_capability cap{};
+        if (xioctl(s.fd, VIDIOC_QUERYCAP, &cap) != 0) {
+            continue;
+        }
+        const uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) != 0 ? cap.device_caps : cap.capabilities;
+        if ((caps & V4L2_CAP_VIDEO_M2M_MPLANE) == 0 || (caps & V4L2_CAP_STREAMING) == 0 ||
+            !hasFormat(s.fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, codec)) {
+            continue;
+        }
+        // RGB lets the frames be corrected straight into the encoder buffers
+        EncoderPixelFormat pixel;
+        uint32_t fourcc;
+        if (hasFormat(s.fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_PIX_FMT_RGB24)) {
+            pixel = EncoderPixelFormat::Rgb24;
+            fourcc = V4L2_PIX_FMT_RGB24;
+        } else if (hasFormat(s.fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_PIX_FMT_YUV420)) {
+            pixel = EncoderPixelFormat::I420;
+            fourcc = V4L2_PIX_FMT_YUV420;
+        } else {
+            continue;
+        }
+
+        v4l2_format in{};
+        in.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        in.fmt.pix_mp.width = options_.width;
+        in.fmt.pix_mp.height = options_.height;
+        in.fmt.pix_mp.pixelformat = fourcc;
+        in.fmt.pix_mp.field = V4L2_FIELD_NONE;
+        in.fmt.pix_mp.colorspace = pixel == EncoderPixelFormat::I420 ? V4L2_COLORSPACE_SMPTE170M : V4L2_COLORSPACE_SRGB;
+        in.fmt.pix_mp.num_planes = 1;
+        if (xioctl(s.fd, VIDIOC_S_FMT, &in) != 0 || in.fmt.pix_mp.pixelformat != fourcc ||
+            in.fmt.pix_mp.width != options_.width || in.fmt.pix_mp.height < options_.height) {
+            continue;
+        }
+        v4l2_format out{};
+        out.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        out.fmt.pix_mp.width = options_.width;
+        out.fmt.pix_mp.height = options_.height;
+        out.fmt.pix_mp.pixelformat = codec;
+        out.fmt.pix_mp.field = V4L2_FIELD_NONE;
+        out.fmt.pix_mp.num_planes = 1;
+        out.fmt.pix_mp.plane_fmt[0].sizeimage = std::max<uint32_t>(options_.width * options_.height, 512 * 1024);
+        if (xioctl(s.fd, VIDIOC_S_FMT, &out) != 0) {
+            continue;
+        }
+        v4l2_streamparm parm{};
+        parm.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        parm.parm.output.timeperframe.numerator = 1;
+        parm.parm.output.timeperframe.denominator = std::max(options_.fps, 1u);
+        xioctl(s.fd, VIDIOC_S_PARM, &parm);
+        if (options_.codec == VideoCodec::H264) {
+            setControl(s.fd, V4L2_CID_MPEG_VIDEO_BITRATE, static_cast<int32_t>(options_.bitrate));
+            setControl(s.fd, V4L2_CID_MPEG_VIDEO_H264_I_PERIOD, static_cast<int32_t>(options_.keyframe_interval));
+            setControl(s.fd, V4L2_CID_MPEG_VIDEO_REPEAT_SEQ_HEADER, 1);
+            setControl(s.fd, V4L2_CID_MPEG_VIDEO_H264_PROFILE, V4L2_MPEG_VIDEO_H264_PROFILE_HIGH);
+        } else {
+            setControl(s.fd, V4L2_CID_JPEG_COMPRESSION_QUALITY, options_.quality);
+            s.device_quality = options_.quality;
+        }
+
+        v4l2_requestbuffers req{};
+        req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        req.memory = V4L2_MEMORY_MMAP;
+        req.count = 2;
+        if (xioctl(s.fd, VIDIOC_REQBUFS, &req) != 0 || req.count < 2) {
+            continue;
+        }
+        v4l2_requestbuffers creq{};
+        creq.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        creq.memory = V4L2_MEMORY_MMAP;
+        creq.count = 4;
+        if (xioctl(s.fd, VIDIOC_REQBUFS, &creq) != 0 || creq.count < 1) {
+            continue;
+        }
+        bool mapped = true;
+        auto map = [&](uint32_t type, uint32_t index, State::Buffer& buffer) {
+            v4l2_buffer buf{};
+            v4l2_plane plane{};
+            buf.type = type;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = index;
+            buf.m.planes = &plane;
+            buf.length = 1;
+            if (xioctl(s.fd, VIDIOC_QUERYBUF, &buf) != 0) {
+                return false;
+            }
+            buffer.length = plane.length;
+            buffer.data = mmap(nullptr, plane.length, PROT_READ | PROT_WRITE, MAP_SHARED, s.fd, plane.m.mem_offset);
+            if (buffer.data == MAP_FAILED || type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+                return buffer.data != MAP_FAILED;
+            }
+            buffer.queued = xioctl(s.fd, VIDIOC_QBUF, &buf) == 0;
+            return buffer.queued;
+        };
+        for (uint32_t i = 0; i < 2 && mapped; i++) {
+            mapped = map(V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, i, s.inputs[i]);
+        }
+        // the driver may allocate more buffers than asked: only the first 4 are mapped and queued
+        s.output_count = std::min<uint32_t>(creq.count, 4);
+        for (uint32_t i = 0; i < s.output_count && mapped; i++) {
+            mapped = map(V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, i, s.outputs[i]);
+        }
+        int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        int ctype = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        if (!mapped || xioctl(s.fd, VIDIOC_STREAMON, &type) != 0 || xioctl(s.fd, VIDIOC_STREAMON, &ctype) != 0) {
+            continue;
+        }
+
+        const size_t stride = in.fmt.pix_mp.plane_fmt[0].bytesperline;
+        s.input_size = in.fmt.pix_mp.plane_fmt[0].sizeimage;
+        input_.format = pixel;
+        input_.strides[0] = stride;
+        uint8_t* base = static_cast<uint8_t*>(s.inputs[0].data);
+        input_.planes[0] = base;
+        if (pixel == EncoderPixelFormat::I420) {
+            // the chroma planes follow the luma plane of the (possibly aligned) buffer height
+            const size_t rows = std::max<size_t>(options_.height, s.input_size * 2 / 3 / std::max<size_t>(stride, 1));
+            s.luma_size = stride * rows;
+            s.input_size = std::max(s.input_size, s.luma_size * 3 / 2);
+            if (s.input_size > s.inputs[0].length || s.input_size > s.inputs[1].length) {
+                continue;
+            }
+            input_.strides[1] = stride / 2;
+            input_.strides[2] = stride / 2;
+            input_.planes[1] = base + s.luma_size;
+            input_.planes[2] = base + s.luma_size + s.luma_size / 4;
+        }
+        s.input_index = 0;
+        return true;
+    }
+    state_.reset(new State);
+#endif
+    return false;
+}
+
+bool VideoEncoder::openX264() {
+#if ARDUCAM_WITH_X264
+    State& s = *state_;
+    x264_param_t& param = s.x264_param;
+    if (x264_param_default_preset(&param, "ultrafast", "zerolatency") != 0) {
+        return false;
+    }
+    param.i_width = static_cast<int>(options_.width);
+    param.i_height = static_cast<int>(options_.height);
+    param.i_csp = X264_CSP_I420;
+    param.i_fps_num = std::max(options_.fps, 1u);
+    param.i_fps_den = 1;
+    param.i_keyint_max = static_cast<int>(std::max(options_.keyframe_interval, 1u));
+    param.b_repeat_headers = 1;
+    param.b_annexb = 1;
+    param.rc.i_rc_method = X264_RC_ABR;
+    param.rc.i_bitrate = static_cast<int>(options_.bitrate / 1000);
+    param.rc.i_vbv_max_bitrate = param.rc.i_bitrate;
+    param.rc.i_vbv_buffer_size = param.rc.i_bitrate;
+    if (x264_param_apply_profile(&param, "high") != 0) {
+        return false;
+    }
+    s.x264 = x264_encoder_open(&param);
+    if (s.x264 == nullptr ||
+        x264_picture_alloc(&s.x264_picture, X264_CSP_I420, param.i_width, param.i_height) != 0) {
+        return false;
+    }
+    s.x264_picture_allocated = true;
+    input_.format = EncoderPixelFormat::I420;
+    for (int i = 0; i < 3; i++) {
+        input_.planes[i] = s.x264_picture.img.plane[i];
+        input_.strides[i] = static_cast<size_t>(s.x264_picture.img.i_stride[i]);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool VideoEncoder::openJpeg() {
+#if ARDUCAM_WITH_JPEG
+    State& s = *state_;
+    s.jpeg.err = jpeg_std_error(&s.jpeg_error.mgr);
+    s.jpeg_error.mgr.error_exit = jpegErrorExit;
+    if (setjmp(s.jpeg_error.jump) != 0) {
+        return false;
+    }
+    jpeg_create_compress(&s.jpeg);
+    s.jpeg_created = true;
+    image_.resize(size_t(options_.width) * options_.height * 3);
+    input_.format = EncoderPixelFormat::Rgb24;
+    input_.planes[0] = image_.data();
+    input_.strides[0] = size_t(options_.width) * 3;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool VideoEncoder::encode(uint64_t timestamp_us, const PacketSink& sink) {
+    State& s = *state_;
+    EncodedPacket packet{nullptr, 0, timestamp_us, false, options_.codec, options_.width, options_.height};
+    switch (backend_) {
+#if defined(__linux__)
+        case EncoderBackend::V4l2M2m: {
+            if (keyframe_requested_ && options_.codec == VideoCodec::H264) {
+                setControl(s.fd, V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME, 1);
+            }
+            keyframe_requested_ = false;
+            v4l2_buffer buf{};
+            v4l2_plane plane{};
+            buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = s.input_index;
+            buf.m.planes = &plane;
+            buf.length = 1;
+            buf.timestamp.tv_sec = static_cast<time_t>(timestamp_us / 1000000);
+            buf.timestamp.tv_usec = static_cast<suseconds_t>(timestamp_us % 1000000);
+            plane.bytesused = static_cast<uint32_t>(s.input_size);
+            plane.length = static_cast<uint32_t>(s.inputs[s.input_index].length);
+            if (xioctl(s.fd, VIDIOC_QBUF, &buf) != 0) {
+                return false;
+            }
+            s.inputs[s.input_index].queued = true;
+
+            // a buffer with only the parameter sets is kept for the frame that follows it
+            bool done = false;
+            while (!done) {
+                v4l2_buffer cbuf{};
+                v4l2_plane cplane{};
+                cbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+                cbuf.memory = V4L2_MEMORY_MMAP;
+                cbuf.m.planes = &cplane;
+                cbuf.length = 1;
+                if (xioctl(s.fd, VIDIOC_DQBUF, &cbuf) != 0) {
+                    if (errno != EAGAIN || !waitFor(s.fd, POLLIN)) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (cbuf.index >= s.output_count || cplane.data_offset > cplane.bytesused ||
+                    cplane.bytesused > s.outputs[cbuf.index].length) {
+                    return false;
+                }
+                const uint8_t* data = static_cast<const uint8_t*>(s.outputs[cbuf.index].data) + cplane.data_offset;
+                const size_t size = cplane.bytesused - cplane.data_offset;
+                if (options_.codec == VideoCodec::H264 && onlyParameterSets(data, size)) {
+                    s.header.insert(s.header.end(), data, data + size);
+                } else {
+                    packet.keyframe = (cbuf.flags & V4L2_BUF_FLAG_KEYFRAME) != 0 || options_.codec == VideoCodec::Mjpeg;
+                    packet.timestamp_us = uint64_t(cbuf.timestamp.tv_sec) * 1000000 + cbuf.timestamp.tv_usec;
+                    if (s.header.empty()) {
+                        packet.data = data;
+                        packet.size = size;
+                    } else {
+                        s.packet.assign(s.header.begin(), s.header.end());
+                        s.packet.insert(s.packet.end(), data, data + size);
+                        s.header.clear();
+                        packet.data = s.packet.data();
+                        packet.size = s.packet.size();
+                    }
+                    if (sink) {
+                        sink(packet);
+                    }
+                    done = true;
+                }
+                xioctl(s.fd, VIDIOC_QBUF, &cbuf);
+            }
+            if (options_.codec == VideoCodec::Mjpeg) {
+                updateQuality(packet.size);
+                if (options_.quality != s.device_quality) {
+                    setControl(s.fd, V4L2_CID_JPEG_COMPRESSION_QUALITY, options_.quality);
+                    s.device_quality = options_.quality;
+                }
+            }
+            // the next frame goes into the other buffer once the encoder has let go of it
+            s.input_index ^= 1;
+            if (!s.reclaimInput(s.input_index)) {
+                return false;
+            }
+            uint8_t* base = static_cast<uint8_t*>(s.inputs[s.input_index].data);
+            const ptrdiff_t shift = base - input_.planes[0];
+            for (int i = 0; i < (input_.format == EncoderPixelFormat::I420 ? 3 : 1); i++) {
+                input_.planes[i] += shift;
+            }
+            return true;
+        }
+#endif
+#if ARDUCAM_WITH_X264
+        case EncoderBackend::X264: {
+            s.x264_picture.i_pts = s.pts++;
+            s.x264_picture.i_type = keyframe_requested_ ? X264_TYPE_IDR : X264_TYPE_AUTO;
+            keyframe_requested_ = false;
+            x264_nal_t* nals = nullptr;
+            int count = 0;
+            x264_picture_t out;
+            const int size = x264_encoder_encode(s.x264, &nals, &count, &s.x264_picture, &out);
+            if (size < 0) {
+                return false;
+            }
+            if (size > 0 && sink) {
+                // the payloads of one call are contiguous
+                packet.data = nals[0].p_payload;
+                packet.size = static_cast<size_t>(size);
+                packet.keyframe = out.b_keyframe != 0;
+                sink(packet);
+            }
+            return true;
+        }
+#endif
+#if ARDUCAM_WITH_JPEG
+        case EncoderBackend::LibJpeg: {
+            s.jpeg_buffer = nullptr;
+            s.jpeg_size = 0;
+            if (setjmp(s.jpeg_error.jump) != 0) {
+                jpeg_abort_compress(&s.jpeg);
+                std::free(s.jpeg_buffer);
+                return false;
+            }
+            jpeg_mem_dest(&s.jpeg, &s.jpeg_buffer, &s.jpeg_size);
+            s.jpeg.image_width = options_.width;
+            s.jpeg.image_height = options_.height;
+            s.jpeg.input_components = 3;
+            s.jpeg.in_color_space = JCS_RGB;
+            jpeg_set_defaults(&s.jpeg);
+            jpeg_set_quality(&s.jpeg, options_.quality, TRUE);
+            jpeg_start_compress(&s.jpeg, TRUE);
+            while (s.jpeg.next_scanline < s.jpeg.image_height) {
+                JSAMPROW row = input_.planes[0] + input_.strides[0] * s.jpeg.next_scanline;
+                jpeg_write_scanlines(&s.jpeg, &row, 1);
+            }
+            jpeg_finish_compress(&s.jpeg);
+            packet.data = s.jpeg_buffer;
+            packet.size = s.jpeg_size;
+            packet.keyframe = true;
+            if (sink) {
+                sink(packet);
+            }
+            std::free(s.jpeg_buffer);
+            s.jpeg_buffer = nullptr;
+            updateQuality(packet.size);
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+bool VideoEncoder::encodeRgb(const uint8_t* rgb, size_t stride, uint64_t timestamp_us, const PacketSink& sink) {
+    if (input_.format == EncoderPixelFormat::Rgb24) {
+        for (uint32_t y = 0; y < options_.height; y++) {
+            std::memcpy(input_.planes[0] + input_.strides[0] * y, rgb + stride * y, size_t(options_.width) * 3);
+        }
+    } else {
+        rgbToI420(rgb, stride, options_.width, options_.height, input_);
+    }
+    return encode(timestamp_us, sink);
+}
+
+bool VideoEncoder::setBitrate(uint32_t bitrate) {
+    options_.bitrate = bitrate;
+    switch (backend_) {
+#if defined(__linux__)
+        case EncoderBackend::V4l2M2m:
+            // MJPEG follows through the quality
+            return options_.codec == VideoCodec::Mjpeg ||
+                   setControl(state_->fd, V4L2_CID_MPEG_VIDEO_BITRATE, static_cast<int32_t>(bitrate));
+#endif
+#if ARDUCAM_WITH_X264
+        case EncoderBackend::X264:
+            state_->x264_param.rc.i_bitrate = static_cast<int>(bitrate / 1000);
+            state_->x264_param.rc.i_vbv_max_bitrate = state_->x264_param.rc.i_bitrate;
+            state_->x264_param.rc.i_vbv_buffer_size = state_->x264_param.rc.i_bitrate;
+            return x264_encoder_reconfig(state_->x264, &state_->x264_param) == 0;
+#endif
+        default:
+            return true;
+    }
+}
+
+void VideoEncoder::updateQuality(size_t size) {
+    // a step per frame, smaller upwards, so that the quality settles instead of oscillating
+    const double target = static_cast<double>(options_.bitrate) / 8.0 / std::max(options_.fps, 1u);
+    if (size > target * 1.1) {
+        options_.quality -= size > target * 1.5 ? 5 : 2;
+    } else if (size < target * 0.9) {
+        options_.quality += 1;
+    }
+    options_.quality = std::min(std::max(options_.quality, kMinQuality), kMaxQuality);
+}
+
+void rgbToI420(const uint8_t* rgb, size_t stride, uint32_t width, uint32_t height, const EncoderInput& input) {
+    for (uint32_t y = 0; y < height; y += 2) {
+        const uint8_t* row0 = rgb + stride * y;
+        const uint8_t* row1 = row0 + stride;
+        uint8_t* y0 = input.planes[0] + input.strides[0] * y;
+        uint8_t* y1 = y0 + input.strides[0];
+        uint8_t* u = input.planes[1] + input.strides[1] * (y / 2);
+        uint8_t* v = input.planes[2] + input.strides[2] * (y / 2);
+        for (uint32_t x = 0; x < width; x += 2) {
+            int r = 0;
+            int g = 0;
+            int b = 0;
+            const uint8_t* px[4] = {row0 + 3 * x, row0 + 3 * x + 3, row1 + 3 * x, row1 + 3 * x + 3};
+            uint8_t* luma[4] = {y0 + x, y0 + x + 1, y1 + x, y1 + x + 1};
+            for (int i = 0; i < 4; i++) {
+                const int pr = px[i][0];
+                const int pg = px[i][1];
+                const int pb = px[i][2];
+                *luma[i] = static_cast<uint8_t>(((66 * pr + 129 * pg + 25 * pb + 128) >> 8) + 16);
+                r += pr;
+                g += pg;
+                b += pb;
+            }
+            r = (r + 2) >> 2;
+            g = (g + 2) >> 2;
+            b = (b + 2) >> 2;
+            u[x / 2] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[x / 2] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+VideoStream::VideoStream(const VideoStreamOptions& options, PacketSink sink, WorkerPool* pool)
+    : options_(options), sink_(std::move(sink)), corrector_(options.correction, [&] {
+          ConvertOptions convert = options.convert;
+          convert.output = OutputFormat::Rgb8;
+          return convert;
+      }(), pool) {
+    options_.convert.output = OutputFormat::Rgb8;
+}
+
+bool VideoStream::push(const Frame& frame, uint64_t timestamp_us) {
+    uint32_t width = frame.format.width;
+    uint32_t height = frame.format.height;
+    if (options_.correct && !correctedSize(options_.correction, frame.format.width, frame.format.height, width,
+                                           height)) {
+        return false;
+    }
+    const uint32_t encoded_width = width & ~1u;
+    const uint32_t encoded_height = height & ~1u;
+    if (encoder_ == nullptr || encoder_->options().width != encoded_width ||
+        encoder_->options().height != encoded_height) {
+        EncoderOptions encoder = options_.encoder;
+        encoder.width = encoded_width;
+        encoder.height = encoded_height;
+        encoder_ = VideoEncoder::create(encoder);
+        if (encoder_ == nullptr) {
+            return false;
+        }
+    }
+    if (timestamp_us == 0) {
+        timestamp_us = detail::nowUs();
+    }
+
+    EncoderInput& input = encoder_->input();
+    // an odd corrected size does not fit the encoder buffer and is cut through the intermediate image
+    const bool direct = input.format == EncoderPixelFormat::Rgb24 && encoded_width == width && encoded_height == height;
+    uint8_t* dst = input.planes[0];
+    size_t stride = input.strides[0];
+    if (!direct) {
+        stride = size_t(width) * 3;
+        image_.resize(stride * height);
+        dst = image_.data();
+    }
+    bool ok;
+    if (options_.correct) {
+        ok = corrector_.process(frame, dst, stride);
+    } else {
+        scratch_.resize(convertScratchSize(frame.format));
+        ok = convertFrame(frame, options_.convert, dst, stride, scratch_.data());
+    }
+    if (!ok) {
+        return false;
+    }
+    return direct ? encoder_->encode(timestamp_us, sink_) : encoder_->encodeRgb(dst, stride, timestamp_us, sink_);
+}
+
+bool VideoStream::setBitrate(uint32_t bitrate) {
+    options_.encoder.bitrate = bitrate;
+    return encoder_ == nullptr || encoder_->setBitrate(bitrate);
+}
+
+void VideoStream::requestKeyframe() {
+    if (encoder_ != nullptr) {
+        encoder_->requestKeyframe();
+    }
+}
+
+}  // namespace Arducam
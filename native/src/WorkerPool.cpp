@@ -0,0 +1,106 @@
+#include <arducam/WorkerPool.hpp>
+
+#include <atomic>
+
+namespace Arducam {
+
+struct WorkerPool::Job {
+    const std::function<void(size_t)>* fn;
+    size_t count;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+WorkerPool::WorkerPool(size_t threads) {
+    if (threads == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        threads = hw > 1 ? hw - 1 : 0;
+    }
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+        workers_.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+// runs indices of `job` until none are left, returns `true` if this call finished the last one
+bool WorkerPool::work(Job& job) {
+    size_t finished = 0;
+    for (size_t i = job.next.fetch_add(1, std::memory_order_relaxed); i < job.count;
+         i = job.next.fetch_add(1, std::memory_order_relaxed)) {
+        (*job.fn)(i);
+        finished++;
+    }
+    return finished != 0 && job.done.fetch_add(finished, std::memory_order_acq_rel) + finished == job.count;
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1 || workers_.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->fn = &fn;
+    job->count = count;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+    }
+    wake_.notify_all();
+
+    if (!work(*job)) {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&] { return job->done.load(std::memory_order_acquire) == count; });
+    }
+    // the workers drop the job once its indices run out, but it may still be queued if they never got to it
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = jobs_.begin(); it != jobs_.end(); ++it) {
+        if (*it == job) {
+            jobs_.erase(it);
+            break;
+        }
+    }
+}
+
+void WorkerPool::run() {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || !jobs_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            job = jobs_.front();
+            if (job->next.load(std::memory_order_relaxed) >= job->count) {
+                // every index is taken, the remaining calls are running on other threads
+                jobs_.pop_front();
+                continue;
+            }
+        }
+        if (work(*job)) {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->finished.notify_all();
+        }
+    }
+}
+
+}  // namespace Arducam
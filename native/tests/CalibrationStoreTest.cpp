@@ -0,0 +1,224 @@
+// Checks the calibration record format and its storage in the user data of a mock camera, including a write cut
+// short between the payload and the header, and the bulk transfers that fall back to a smaller size when the device
+// refuses one.
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <arducam/CalibrationStore.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+std::vector<CameraCalibration> sampleCalibrations() {
+    std::vector<CameraCalibration> cameras(2);
+    cameras[0].name = "left";
+    cameras[0].width = 4608;
+    cameras[0].height = 2592;
+    CorrectionParams& params = cameras[0].params;
+    params.crop_x = 16;
+    params.crop_y = 8;
+    params.crop_width = 4576;
+    params.crop_height = 2576;
+    params.pad_top = 2;
+    params.pad_bottom = 3;
+    params.radial = true;
+    params.xcenter = 2304.5;
+    params.ycenter = 1296.25;
+    params.coeffs = {1.0, -0.12345678901234, 0.0042, -1e-9, 3.5e-12};
+    params.perspective = true;
+    params.pers_coef = {1.01, 0.002, -3.0, -0.001, 0.99, 4.5, 1e-6, -2e-7};
+    params.rotation = -0.75;
+    // a camera left at the defaults, whose fields are all left out of the record
+    cameras[1].name = "right";
+    return cameras;
+}
+
+bool sameParams(const CorrectionParams& a, const CorrectionParams& b) {
+    return a.crop_x == b.crop_x && a.crop_y == b.crop_y && a.crop_width == b.crop_width &&
+           a.crop_height == b.crop_height && a.pad_top == b.pad_top && a.pad_bottom == b.pad_bottom &&
+           a.radial == b.radial && a.xcenter == b.xcenter && a.ycenter == b.ycenter && a.coeffs == b.coeffs &&
+           a.perspective == b.perspective && a.pers_coef == b.pers_coef && a.rotation == b.rotation;
+}
+
+bool sameCalibrations(const std::vector<CameraCalibration>& a, const std::vector<CameraCalibration>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].name != b[i].name || a[i].width != b[i].width || a[i].height != b[i].height ||
+            !sameParams(a[i].params, b[i].params)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void testEncodeDecode() {
+    const auto cameras = sampleCalibrations();
+    std::vector<uint8_t> record;
+    encodeCalibration(cameras, record);
+    REQUIRE(record.size() > kCalibrationHeaderSize);
+    CHECK(record[0] == 'A' && record[1] == 'C' && record[2] == 'A' && record[3] == 'L');
+    // the format promises about 170 bytes for a full camera
+    CHECK(record.size() < 256);
+
+    std::vector<CameraCalibration> decoded;
+    REQUIRE(decodeCalibration(record.data(), record.size(), decoded));
+    CHECK(sameCalibrations(cameras, decoded));
+    CHECK(findCalibration(decoded, "right") == &decoded[1]);
+    CHECK(findCalibration(decoded, "middle") == nullptr);
+
+    std::vector<uint8_t> empty;
+    encodeCalibration({}, empty);
+    CHECK(empty.size() == kCalibrationHeaderSize);
+    CHECK(decodeCalibration(empty.data(), empty.size(), decoded) && decoded.empty());
+
+    // every truncation and every flipped byte is refused
+    for (size_t size = 0; size < record.size(); size++) {
+        CHECK(!decodeCalibration(record.data(), size, decoded));
+    }
+    for (size_t i = 0; i < record.size(); i++) {
+        auto corrupt = record;
+        corrupt[i] ^= 0x01;
+        CHECK(!decodeCalibration(corrupt.data(), corrupt.size(), decoded));
+    }
+}
+
+void testStore() {
+    MockDeviceOptions options;
+    options.serial = "CALIB";
+    options.modes = {ArducamTest::mockMode(640, 480)};
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+
+    std::vector<CameraCalibration> loaded;
+    CHECK(!readCalibration(camera, loaded));
+
+    const auto cameras = sampleCalibrations();
+    std::vector<uint8_t> record;
+    encodeCalibration(cameras, record);
+    UserDataStats stats;
+    REQUIRE(writeCalibration(camera, cameras, 0, UserDataOptions(), &stats));
+    CHECK(stats.bytes_written == record.size());
+    REQUIRE(readCalibration(camera, loaded));
+    CHECK(sameCalibrations(cameras, loaded));
+
+    // writing the stored record again writes nothing
+    stats = UserDataStats();
+    CHECK(writeCalibration(camera, cameras, 0, UserDataOptions(), &stats));
+    CHECK(stats.bytes_written == 0);
+
+    // the record at another address, with small transfers split at EEPROM pages
+    UserDataOptions paged;
+    paged.max_chunk = 16;
+    paged.page_size = 32;
+    stats = UserDataStats();
+    CHECK(writeCalibration(camera, cameras, 1000, paged, &stats));
+    CHECK(stats.bytes_written == record.size() && stats.transactions >= record.size() / 16);
+    CHECK(readCalibration(camera, loaded, 1000, paged) && sameCalibrations(cameras, loaded));
+
+    uint8_t byte = 0;
+    CHECK(!readUserDataBulk(camera, 65535, &byte, 2));
+}
+
+void testInterruptedWrite() {
+    MockDeviceOptions options;
+    options.serial = "INTERRUPT";
+    options.modes = {ArducamTest::mockMode(640, 480)};
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+
+    auto a = sampleCalibrations();
+    auto b = a;
+    b[0].params.rotation = 0.5;
+    b[1].width = 1536;
+    std::vector<uint8_t> record_a, record_b;
+    encodeCalibration(a, record_a);
+    encodeCalibration(b, record_b);
+    REQUIRE(writeCalibration(camera, a));
+
+    // a write of `b` cut short after the payload: the header of `a` now covers another payload
+    REQUIRE(writeUserDataBulk(camera, kCalibrationHeaderSize, record_b.data() + kCalibrationHeaderSize,
+                              record_b.size() - kCalibrationHeaderSize));
+    std::vector<CameraCalibration> loaded;
+    CHECK(!readCalibration(camera, loaded));
+
+    // the header still matches `a`, the whole record does not: `a` is written again
+    UserDataStats stats;
+    REQUIRE(writeCalibration(camera, a, 0, UserDataOptions(), &stats));
+    CHECK(stats.bytes_written == record_a.size());
+    CHECK(readCalibration(camera, loaded) && sameCalibrations(a, loaded));
+
+    // the same with the payload of `a` intact but its tail clobbered
+    const uint8_t zeros[4] = {};
+    REQUIRE(writeUserDataBulk(camera, static_cast<uint32_t>(record_a.size() - 4), zeros, 4));
+    stats = UserDataStats();
+    REQUIRE(writeCalibration(camera, a, 0, UserDataOptions(), &stats));
+    CHECK(stats.bytes_written == record_a.size());
+
+    stats = UserDataStats();
+    REQUIRE(writeCalibration(camera, b, 0, UserDataOptions(), &stats));
+    CHECK(stats.bytes_written == record_b.size());
+    CHECK(readCalibration(camera, loaded) && sameCalibrations(b, loaded));
+}
+
+void testBulk() {
+    // firmware taking at most 100 bytes a transfer
+    MockDeviceOptions options;
+    options.serial = "BULK";
+    options.modes = {ArducamTest::mockMode(640, 480)};
+    options.user_data_max_transfer = 100;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+    // 255 and 127 bytes are refused, 63 is kept: 16 writes after the 2 refused and 16 reads to verify them
+    UserDataStats stats;
+    REQUIRE(writeUserDataBulk(camera, 2000, data.data(), data.size(), UserDataOptions(), &stats));
+    CHECK(stats.chunk == 63 && stats.transactions == 34 && stats.bytes_written == data.size());
+    // the reads are not limited: 4 of them
+    std::vector<uint8_t> back(data.size());
+    stats = UserDataStats();
+    REQUIRE(readUserDataBulk(camera, 2000, back.data(), back.size(), UserDataOptions(), &stats));
+    CHECK(back == data && stats.chunk == 255 && stats.transactions == 4);
+
+    // the kept size is a good start for the next transfer
+    UserDataOptions kept;
+    kept.max_chunk = 63;
+    stats = UserDataStats();
+    REQUIRE(writeUserDataBulk(camera, 2000, data.data(), data.size(), kept, &stats));
+    CHECK(stats.chunk == 63 && stats.transactions == 32);
+
+    // split at the 64 byte pages, without a read back: 24 bytes to the end of the first page, then 64, 64 and 48
+    UserDataOptions paged;
+    paged.page_size = 64;
+    paged.verify = false;
+    stats = UserDataStats();
+    REQUIRE(writeUserDataBulk(camera, 64 * 48 + 40, data.data(), 200, paged, &stats));
+    CHECK(stats.transactions == 4 && stats.bytes_written == 200 && stats.chunk == 255);
+    REQUIRE(readUserDataBulk(camera, 64 * 48 + 40, back.data(), 200));
+    CHECK(std::equal(back.begin(), back.begin() + 200, data.begin()));
+
+    // past the end of the user data nothing is written
+    stats = UserDataStats();
+    CHECK(!writeUserDataBulk(camera, 65500, data.data(), 100, UserDataOptions(), &stats));
+    CHECK(stats.transactions == 0 && stats.bytes_written == 0);
+}
+
+}  // namespace
+
+int main() {
+    testEncodeDecode();
+    testStore();
+    testInterruptedWrite();
+    testBulk();
+    return ArducamTest::result();
+}
@@ -0,0 +1,163 @@
+// Checks the compiled configuration store (through the parser of the mock backend): a configuration file is
+// compiled once and mapped afterwards, the control code pointers are relocated into the mapping with their strings
+// intact, a store of another source is rejected and compiled again, and openCompiled() opens a mock camera with it.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include <arducam/ConfigStore.hpp>
+#include <arducam/RegisterBatch.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+const char* const kCfgPath = "ConfigStoreTest.cfg";
+const char* const kStorePath = "ConfigStoreTest.cfg.arcc";
+const char* const kExposureCode = "REG = 0x0202, (val >> 8); REG = 0x0203, (val & 0xFF)";
+
+void writeConfig(uint32_t frame_length) {
+    std::ofstream file(kCfgPath);
+    file << "[camera parameter]\n"
+         << "CFG_MODE = 0\n"
+         << "TYPE = IMX708\n"
+         << "SIZE = 640, 480\n"
+         << "BIT_WIDTH = 10\n"
+         << "FORMAT = 0, 0\n"
+         << "I2C_MODE = 2\n"
+         << "I2C_ADDR = 0x34\n"
+         << "[control parameter]\n"
+         << "MIN_VALUE = 1\n"
+         << "MAX_VALUE = 4000\n"
+         << "STEP = 1\n"
+         << "DEF = 500\n"
+         << "CTRL_NAME = Exposure\n"
+         << "FUNC_NAME = setExposure\n"
+         << "CODE = " << kExposureCode << "\n"
+         << "[control parameter]\n"
+         << "MIN_VALUE = 0\n"
+         << "MAX_VALUE = 1\n"
+         << "STEP = 1\n"
+         << "DEF = 0\n"
+         << "CTRL_NAME = Flip\n"
+         << "FUNC_NAME = setFlip\n"
+         << "[register parameter]\n"
+         << "REG = 0x0100, 0x00\n"
+         << "REG = 0x0340, " << (frame_length >> 8) << "\n"
+         << "REG = 0x0341, " << (frame_length & 0xFF) << "\n"
+         << "REG = 0x0100, 0x01\n";
+}
+
+bool insideMapping(const CompiledConfig& config, const void* pointer) {
+    const auto* base = reinterpret_cast<const uint8_t*>(&config.header());
+    const auto* p = static_cast<const uint8_t*>(pointer);
+    return p >= base && p < base + config.header().file_size;
+}
+
+bool checkControls(const CompiledConfig& config) {
+    if (config.controlCount() != 2) {
+        return false;
+    }
+    const Control& exposure = config.controls()[0];
+    const Control& flip = config.controls()[1];
+    return std::strcmp(exposure.name, "Exposure") == 0 && std::strcmp(exposure.func, "setExposure") == 0 &&
+           exposure.min == 1 && exposure.max == 4000 && exposure.def == 500 && exposure.code != nullptr &&
+           insideMapping(config, exposure.code) && std::strcmp(exposure.code, kExposureCode) == 0 &&
+           std::strcmp(flip.name, "Flip") == 0 && flip.code == nullptr;
+}
+
+void testStore() {
+    std::remove(kStorePath);
+    writeConfig(0x0800);
+    bool compiled = false;
+    std::unique_ptr<CompiledConfig> config = CompiledConfig::load(kCfgPath, "", &compiled);
+    REQUIRE(config != nullptr);
+    CHECK(compiled);
+    CHECK(checkControls(*config));
+    CHECK(config->configCount() == 4 && insideMapping(*config, config->configs()));
+    CHECK(config->cameraParam().width == 640 && config->cameraParam().i2c_addr == 0x34);
+    const ArducamCameraConfig mode = config->cameraConfig();
+    CHECK(mode.width == 640 && mode.height == 480 && mode.bit_width == 10);
+    RegisterProgram program;
+    CHECK(config->program(USB_3, program) && program.writeCount() == 4);
+    config.reset();
+
+    // the second load maps the store
+    config = CompiledConfig::load(kCfgPath, "", &compiled);
+    REQUIRE(config != nullptr);
+    CHECK(!compiled);
+    CHECK(checkControls(*config));
+    config.reset();
+
+    // open() checks the source
+    uint64_t hash = 0, size = 0;
+    REQUIRE(hashConfigFile(kCfgPath, hash, size));
+    config = CompiledConfig::open(kStorePath, hash, size);
+    CHECK(config != nullptr && config->header().source_hash == hash && config->header().source_size == size);
+    config.reset();
+    CHECK(CompiledConfig::open(kStorePath, hash + 1, size) == nullptr);
+    CHECK(CompiledConfig::open(kStorePath, hash, size + 1) == nullptr);
+
+    // an edited source is compiled again, and the store replaced
+    writeConfig(0x0900);
+    config = CompiledConfig::load(kCfgPath, "", &compiled);
+    REQUIRE(config != nullptr);
+    CHECK(compiled);
+    CHECK(config->configs()[2].params[1] == 0x00 && config->configs()[1].params[1] == 0x09);
+    config.reset();
+    CHECK(CompiledConfig::load(kCfgPath, "", &compiled) != nullptr && !compiled);
+
+    // a store that is not one is compiled again too
+    {
+        std::ofstream file(kStorePath, std::ios::binary | std::ios::trunc);
+        file << "not a compiled configuration";
+    }
+    CHECK(CompiledConfig::load(kCfgPath, "", &compiled) != nullptr && compiled);
+}
+
+uint32_t readSensor(Camera& camera, uint32_t reg) {
+    RegRead read{reg, 0};
+    RegBatchOptions options;
+    options.max_merge = 1;
+    return readRegs(camera, &read, 1, options) ? read.value : 0xFFFFFFFF;
+}
+
+void testOpenCompiled() {
+    std::unique_ptr<CompiledConfig> config = CompiledConfig::load(kCfgPath);
+    REQUIRE(config != nullptr);
+    MockDeviceOptions options;
+    options.serial = "COMPILED";
+    options.modes = {ArducamTest::mockMode(1280, 720), ArducamTest::mockMode(640, 480)};
+    REQUIRE(addMockDevice(options));
+    DeviceList list = DeviceList::listDevices();
+    Param param;
+    for (DeviceHandle device : list) {
+        const auto* serial = reinterpret_cast<const char*>(device->serial_number);
+        if (std::string(serial, strnlen(serial, sizeof(device->serial_number))) == options.serial) {
+            param.device = device;
+        }
+    }
+    REQUIRE(param.device != nullptr);
+    Camera camera;
+    REQUIRE(openCompiled(camera, *config, param));
+    CHECK(camera.width() == 640 && camera.height() == 480);
+    CHECK(readSensor(camera, 0x0340) == 0x09 && readSensor(camera, 0x0100) == 0x01);
+    // with controls registered, the mock refuses the others
+    CHECK(camera.setControl("setExposure", 1000));
+    CHECK(!camera.setControl("Gain", 1));
+    camera.close();
+}
+
+}  // namespace
+
+int main() {
+    testStore();
+    testOpenCompiled();
+    std::remove(kCfgPath);
+    std::remove(kStorePath);
+    return ArducamTest::result();
+}
@@ -0,0 +1,106 @@
+// Checks ControlScheduler on a mock camera whose frame events are injected: a change is committed on the FrameStart
+// `latency` frames before its target, in a group hold, and reports the frame that reflects it; a change that can no
+// longer reach its target is marked late, and a cancelled one gets no result.
+
+#include <memory>
+#include <vector>
+
+#include <arducam/ControlScheduler.hpp>
+#include <arducam/EventDispatcher.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+// the sequence number of the frame the scheduler is synchronized on
+constexpr uint32_t kFirstSeq = 100;
+
+uint32_t readSensor(Camera& camera, uint32_t reg) {
+    RegRead read{reg, 0};
+    RegBatchOptions options;
+    options.max_merge = 1;
+    return readRegs(camera, &read, 1, options) ? read.value : 0xFFFFFFFF;
+}
+
+void testSchedule() {
+    // the camera is never started: only the injected events count
+    MockDeviceOptions options;
+    options.serial = "SCHEDULE";
+    options.modes = {ArducamTest::mockMode(320, 240)};
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    EventDispatcher events(camera);
+    std::vector<ControlResult> reported;
+    ControlSchedulerOptions scheduler_options;
+    scheduler_options.on_applied = [&](const ControlResult& result) { reported.push_back(result); };
+    auto owned = std::make_unique<ControlScheduler>(camera, events, scheduler_options);
+    ControlScheduler& scheduler = *owned;
+    CHECK(!scheduler.synced() && scheduler.currentSeq() == kNextFrame && scheduler.earliestSeq() == kNextFrame);
+
+    // a change for the next frame needs no sequence numbers
+    const uint64_t next = scheduler.schedule(kNextFrame, {}, {RegWrite{0x0202, 0x12}});
+    ControlResult result;
+    CHECK(!scheduler.wait(next, result, 0));
+    events.dispatch(EventCode::FrameStart);
+    REQUIRE(scheduler.wait(next, result));
+    CHECK(result.ok && !result.late && result.applied_seq == kNextFrame);
+    CHECK(readSensor(camera, 0x0202) == 0x12);
+    // the group hold is released
+    CHECK(readSensor(camera, 0x0104) == 0);
+
+    // the first frame ends and is captured as `kFirstSeq`
+    events.dispatch(EventCode::FrameEnd);
+    Frame frame{};
+    frame.seq = kFirstSeq;
+    scheduler.observe(frame);
+    REQUIRE(scheduler.synced());
+    CHECK(scheduler.currentSeq() == kFirstSeq && scheduler.earliestSeq() == kFirstSeq + 2);
+
+    // committed on the start of `target - latency`, and no earlier
+    const uint32_t target = kFirstSeq + 5;
+    const uint64_t ticket = scheduler.schedule(target, {ControlSetting{"Exposure", 500}}, {RegWrite{0x0203, 0x34}});
+    for (uint32_t seq = kFirstSeq + 1; seq < target - 1; seq++) {
+        events.dispatch(EventCode::FrameStart);
+        events.dispatch(EventCode::FrameEnd);
+    }
+    CHECK(!scheduler.wait(ticket, result, 50));
+    CHECK(readSensor(camera, 0x0203) != 0x34);
+    events.dispatch(EventCode::FrameStart);
+    REQUIRE(scheduler.wait(ticket, result));
+    CHECK(result.ok && !result.late && result.target_seq == target && result.applied_seq == target);
+    CHECK(readSensor(camera, 0x0203) == 0x34);
+    events.dispatch(EventCode::FrameEnd);
+
+    // too late for its target: it lands on the earliest frame instead
+    const uint64_t late = scheduler.schedule(scheduler.currentSeq(), {}, {RegWrite{0x0202, 0x22}});
+    events.dispatch(EventCode::FrameStart);
+    REQUIRE(scheduler.wait(late, result));
+    CHECK(result.late && result.applied_seq == target + 1);
+
+    // a cancelled change is never written
+    const uint64_t cancelled = scheduler.schedule(target + 10, {}, {RegWrite{0x0202, 0x33}});
+    CHECK(scheduler.cancel() == 1);
+    CHECK(!scheduler.wait(cancelled, result, 1000));
+    for (int i = 0; i < 12; i++) {
+        events.dispatch(EventCode::FrameStart);
+    }
+    CHECK(readSensor(camera, 0x0202) == 0x22);
+    CHECK(!scheduler.wait(12345, result, 0));
+
+    const ControlSchedulerStats stats = scheduler.stats();
+    CHECK(stats.frames == 18 && stats.commits == 3 && stats.changes == 3);
+    CHECK(stats.late == 1 && stats.failures == 0);
+    // the callback runs on the worker after wait() is woken: its results are complete once the worker is joined
+    owned.reset();
+    REQUIRE(reported.size() == 3);
+    CHECK(reported[0].ticket == next && reported[1].ticket == ticket && reported[2].ticket == late);
+}
+
+}  // namespace
+
+int main() {
+    testSchedule();
+    return ArducamTest::result();
+}
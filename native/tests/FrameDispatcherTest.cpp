@@ -0,0 +1,296 @@
+// Checks the drop policies, the backpressure counters and the buffer accounting of FrameDispatcher, the wake-up of a
+// consumer by unsubscribe(), and a restart of the dispatcher thread, on wrapped frames and on a mock camera.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <arducam/FrameDispatcher.hpp>
+#include <arducam/FrameRef.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+// the capacity of the subscribers, a power of two like the queues allocate
+constexpr size_t kCapacity = 4;
+
+std::atomic<int> live{0};
+
+// a frame with sequence number `seq` that counts itself in `live` until it is released
+FrameRef makeFrame(uint32_t seq) {
+    static uint8_t byte = 0;
+    Frame frame{};
+    frame.data = &byte;
+    frame.size = 1;
+    frame.seq = seq;
+    live++;
+    return FrameRef::wrap(frame, nullptr, [](void*, const Frame&) { live--; });
+}
+
+std::vector<uint32_t> drainSeqs(FrameSubscriber& subscriber) {
+    std::vector<uint32_t> seqs;
+    FrameRef ref;
+    while (subscriber.tryPop(ref)) {
+        seqs.push_back(ref.frame().seq);
+        ref.reset();
+    }
+    return seqs;
+}
+
+void testDropNewest() {
+    FrameDispatcher dispatcher;
+    auto subscriber = dispatcher.subscribe("newest", kCapacity, DropPolicy::DropNewest);
+    for (uint32_t seq = 0; seq < 10; seq++) {
+        dispatcher.dispatch(makeFrame(seq));
+    }
+    SubscriberStats stats = subscriber->stats();
+    CHECK(stats.delivered == kCapacity);
+    CHECK(stats.dropped_newest == 10 - kCapacity);
+    CHECK(stats.dropped_oldest == 0);
+    CHECK(stats.depth == kCapacity && stats.max_depth == kCapacity);
+    CHECK(live == static_cast<int>(kCapacity));
+    CHECK((drainSeqs(*subscriber) == std::vector<uint32_t>{0, 1, 2, 3}));
+    CHECK(subscriber->stats().consumed == kCapacity);
+    CHECK(live == 0);
+}
+
+void testDropOldest() {
+    FrameDispatcher dispatcher;
+    auto subscriber = dispatcher.subscribe("oldest", kCapacity, DropPolicy::DropOldest);
+    for (uint32_t seq = 0; seq < 10; seq++) {
+        dispatcher.dispatch(makeFrame(seq));
+    }
+    SubscriberStats stats = subscriber->stats();
+    CHECK(stats.delivered == 10);
+    CHECK(stats.dropped_oldest == 10 - kCapacity);
+    CHECK(stats.dropped_newest == 0);
+    CHECK(live == static_cast<int>(kCapacity));
+    CHECK((drainSeqs(*subscriber) == std::vector<uint32_t>{6, 7, 8, 9}));
+
+    // popLatest() keeps the newest frame and releases the others
+    for (uint32_t seq = 10; seq < 13; seq++) {
+        dispatcher.dispatch(makeFrame(seq));
+    }
+    FrameRef ref;
+    CHECK(subscriber->popLatest(ref) && ref.frame().seq == 12);
+    CHECK(live == 1);
+    ref.reset();
+    CHECK(live == 0);
+}
+
+void testBlock() {
+    FrameDispatcher dispatcher;
+    auto subscriber = dispatcher.subscribe("block", kCapacity, DropPolicy::Block);
+    std::thread producer([&] {
+        for (uint32_t seq = 0; seq < 20; seq++) {
+            dispatcher.dispatch(makeFrame(seq));
+        }
+    });
+    std::vector<uint32_t> seqs;
+    FrameRef ref;
+    while (seqs.size() < 20 && subscriber->pop(ref, 1000)) {
+        seqs.push_back(ref.frame().seq);
+        ref.reset();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    producer.join();
+    REQUIRE(seqs.size() == 20);
+    for (uint32_t i = 0; i < 20; i++) {
+        CHECK(seqs[i] == i);
+    }
+    SubscriberStats stats = subscriber->stats();
+    CHECK(stats.delivered == 20 && stats.consumed == 20);
+    CHECK(stats.dropped_newest == 0 && stats.dropped_oldest == 0);
+    CHECK(stats.blocked_us > 0);
+    CHECK(live == 0);
+
+    // a dispatch blocked on a full subscriber returns when it is unsubscribed
+    for (uint32_t seq = 0; seq < kCapacity; seq++) {
+        dispatcher.dispatch(makeFrame(seq));
+    }
+    std::atomic<bool> returned{false};
+    std::thread blocked([&] {
+        dispatcher.dispatch(makeFrame(kCapacity));
+        returned = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!returned);
+    dispatcher.unsubscribe(subscriber);
+    blocked.join();
+    CHECK(live == 0);
+}
+
+void testShared() {
+    FrameDispatcher dispatcher;
+    auto a = dispatcher.subscribe("a", kCapacity, DropPolicy::DropNewest);
+    auto b = dispatcher.subscribe("b", kCapacity, DropPolicy::DropOldest);
+    dispatcher.dispatch(makeFrame(7));
+    CHECK(live == 1);
+    FrameRef ref_a, ref_b;
+    REQUIRE(a->tryPop(ref_a) && b->tryPop(ref_b));
+    CHECK(ref_a.frame().data == ref_b.frame().data);
+    ref_a.reset();
+    CHECK(live == 1);
+    ref_b.reset();
+    CHECK(live == 0);
+
+    CHECK(dispatcher.subscribers().size() == 2);
+    dispatcher.unsubscribe(a);
+    CHECK(dispatcher.subscribers().size() == 1);
+    dispatcher.dispatch(makeFrame(8));
+    CHECK(a->stats().delivered == 1 && b->stats().delivered == 2);
+    dispatcher.unsubscribe(b);
+    CHECK(live == 0);
+}
+
+void testUnsubscribeRace() {
+    // a frame pushed while another thread unsubscribes must not stay in the closed queue
+    FrameDispatcher dispatcher;
+    for (int round = 0; round < 500; round++) {
+        auto subscriber = dispatcher.subscribe("race", kCapacity, DropPolicy::DropNewest);
+        std::atomic<bool> running{true};
+        std::thread producer([&] {
+            uint32_t seq = 0;
+            while (running) {
+                dispatcher.dispatch(makeFrame(seq++));
+            }
+        });
+        std::this_thread::yield();
+        dispatcher.unsubscribe(subscriber);
+        running = false;
+        producer.join();
+        if (!CHECK(live == 0)) {
+            std::fprintf(stderr, "round %d: %d frames held\n", round, live.load());
+            return;
+        }
+    }
+}
+
+void testClose() {
+    FrameDispatcher dispatcher;
+    auto subscriber = dispatcher.subscribe("close", kCapacity, DropPolicy::DropOldest);
+    CHECK(subscriber->name() == "close" && subscriber->policy() == DropPolicy::DropOldest);
+    CHECK(subscriber->capacity() == kCapacity && !subscriber->closed());
+    // without a camera there is no thread to start
+    CHECK(!dispatcher.start() && !dispatcher.isRunning());
+
+    // a consumer waiting for a frame is woken by the unsubscribe, long before its timeout
+    std::atomic<bool> popped{true};
+    std::thread consumer([&] {
+        FrameRef ref;
+        popped = subscriber->pop(ref, 5000);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto begin = std::chrono::steady_clock::now();
+    dispatcher.unsubscribe(subscriber);
+    consumer.join();
+    CHECK(!popped && subscriber->closed());
+    CHECK(std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(1000));
+
+    // a closed subscriber gets nothing more
+    dispatcher.dispatch(makeFrame(0));
+    FrameRef ref;
+    CHECK(!subscriber->pop(ref, 0) && subscriber->stats().delivered == 0);
+    CHECK(live == 0);
+}
+
+void testResetStats() {
+    FrameDispatcher dispatcher;
+    auto subscriber = dispatcher.subscribe("reset", kCapacity, DropPolicy::DropNewest);
+    for (uint32_t seq = 0; seq < 6; seq++) {
+        dispatcher.dispatch(makeFrame(seq));
+    }
+    subscriber->resetStats();
+    SubscriberStats stats = subscriber->stats();
+    CHECK(stats.delivered == 0 && stats.consumed == 0 && stats.dropped_newest == 0 && stats.max_depth == 0);
+    // the queued frames stay and so does their depth
+    CHECK(stats.depth == kCapacity);
+    CHECK(drainSeqs(*subscriber).size() == kCapacity);
+    stats = subscriber->stats();
+    CHECK(stats.consumed == kCapacity && stats.depth == 0);
+    CHECK(live == 0);
+}
+
+void testMockCamera() {
+    MockDeviceOptions options;
+    options.serial = "DISPATCH";
+    options.modes = {ArducamTest::mockMode(320, 240)};
+    options.fps = 0;
+    // the queued frames hold on to their buffers: leave the camera some beyond what the subscribers can hold
+    options.buffer_count = 12;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    REQUIRE(camera.start());
+
+    FrameDispatcher dispatcher(camera);
+    // the blocking subscriber paces the dispatcher: it sees every frame, the others drop what they do not take
+    auto all = dispatcher.subscribe("all", kCapacity, DropPolicy::Block);
+    auto latest = dispatcher.subscribe("latest", 1, DropPolicy::DropOldest);
+    auto first = dispatcher.subscribe("first", 2, DropPolicy::DropNewest);
+    REQUIRE(dispatcher.start());
+    CHECK(!dispatcher.start() && dispatcher.isRunning());
+    std::vector<uint32_t> seqs;
+    FrameRef ref;
+    while (seqs.size() < 100 && all->pop(ref, 1000)) {
+        seqs.push_back(ref.frame().seq);
+        ref.reset();
+    }
+    // a stopped dispatcher starts again where it left off, but for the frame a blocked dispatch gave up on
+    dispatcher.stop();
+    CHECK(!dispatcher.isRunning());
+    REQUIRE(dispatcher.start());
+    while (seqs.size() < 150 && all->pop(ref, 1000)) {
+        seqs.push_back(ref.frame().seq);
+        ref.reset();
+    }
+    dispatcher.stop();
+    REQUIRE(seqs.size() == 150);
+    uint32_t lost = 0;
+    for (size_t i = 1; i < seqs.size(); i++) {
+        if (i < 100) {
+            CHECK(seqs[i] == seqs[i - 1] + 1);
+        } else {
+            CHECK(seqs[i] > seqs[i - 1]);
+            lost += seqs[i] - seqs[i - 1] - 1;
+        }
+    }
+    CHECK(lost <= 1);
+
+    SubscriberStats stats = latest->stats();
+    CHECK(stats.delivered == stats.dropped_oldest + stats.depth);
+    CHECK(stats.depth <= 2);
+    stats = first->stats();
+    CHECK(stats.delivered == 2 && stats.dropped_newest > 0);
+
+    // the subscribers hold on to a few buffers; once they are released every buffer is back with the camera
+    dispatcher.unsubscribe(all);
+    dispatcher.unsubscribe(latest);
+    dispatcher.unsubscribe(first);
+    for (uint32_t i = 0; i < options.buffer_count * 2; i++) {
+        Frame frame;
+        REQUIRE(camera.capture(frame, 1000));
+        camera.freeImage(frame);
+    }
+    MockDeviceStats device_stats;
+    CHECK(mockDeviceStats(options.serial, device_stats) && device_stats.dropped == 0);
+    camera.stop();
+}
+
+}  // namespace
+
+int main() {
+    testDropNewest();
+    testDropOldest();
+    testBlock();
+    testShared();
+    testUnsubscribeRace();
+    testClose();
+    testResetStats();
+    testMockCamera();
+    return ArducamTest::result();
+}
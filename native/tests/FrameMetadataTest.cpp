@@ -0,0 +1,178 @@
+// Parses the embedded data lines the mock camera writes in every packing, before and after the sensor registers
+// change, and reports the lens position noted by hand or by a ControlScheduler from the frame it reaches on.
+
+#include <cstdio>
+#include <memory>
+
+#include <arducam/ControlScheduler.hpp>
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/FrameMetadata.hpp>
+#include <arducam/FrameRef.hpp>
+#include <arducam/PixelKernels.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+constexpr uint32_t kWidth = 640;
+constexpr uint32_t kHeight = 480;
+// the sensor defaults of the mock, see `embeddedValues()` in mock/MockCamera.cpp
+constexpr uint32_t kFrameLength = kHeight + 64;
+constexpr uint32_t kExposure = kFrameLength - 48;
+constexpr uint32_t kLineLength = 0x3D20;
+constexpr uint32_t kAllFields =
+    kMetaExposure | kMetaAnalogueGain | kMetaDigitalGain | kMetaFrameLength | kMetaLineLength | kMetaTemperature |
+    kMetaFrameCount;
+
+void testPacking(const char* serial, uint8_t bit_width, PixelPacking packing) {
+    MockDeviceOptions options;
+    options.serial = serial;
+    options.modes = {ArducamTest::mockMode(kWidth, kHeight, bit_width)};
+    options.packing = packing;
+    options.embedded_lines = 2;
+    options.fps = 0;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    REQUIRE(camera.start());
+
+    // the packing is found from the frame size when it is not given
+    MetadataParser parser;
+    for (int i = 0; i < 8; i++) {
+        Frame frame;
+        REQUIRE(camera.capture(frame, 1000));
+        CHECK(detectPacking(frame) == packing);
+        FrameMetadata metadata;
+        if (CHECK(parser.parse(frame, metadata))) {
+            CHECK(metadata.has(kAllFields));
+            CHECK(metadata.seq == frame.seq);
+            CHECK(metadata.frame_count == (frame.seq & 0xFF));
+            CHECK(metadata.exposure_lines == kExposure);
+            CHECK(metadata.frame_length_lines == kFrameLength);
+            CHECK(metadata.line_length_pck == kLineLength);
+            CHECK(metadata.analogue_gain_code == 0 && metadata.digitalGain() == 1.0);
+            CHECK(metadata.temperature == 40);
+        }
+        camera.freeImage(frame);
+    }
+
+    // a register write shows in the frames started after it: the ones already queued keep the old values
+    REQUIRE(camera.writeSensorReg(0x0202, 0x12));
+    REQUIRE(camera.writeSensorReg(0x0203, 0x34));
+    REQUIRE(camera.writeSensorReg(0x0204, 0x02));
+    REQUIRE(camera.writeSensorReg(0x0205, 0x00));
+    bool seen = false;
+    for (uint32_t i = 0; i < options.buffer_count + 4; i++) {
+        Frame frame;
+        REQUIRE(camera.capture(frame, 1000));
+        FrameRef ref = FrameRef::adopt(camera, frame);
+        REQUIRE(parser.parse(ref));
+        const FrameMetadata* metadata = ref.metadata();
+        REQUIRE(metadata != nullptr);
+        if (metadata->exposure_lines == 0x1234) {
+            seen = true;
+            CHECK(metadata->analogue_gain_code == 0x0200 && metadata->analogueGain() == 2.0);
+        } else {
+            CHECK(!seen && metadata->exposure_lines == kExposure);
+        }
+    }
+    CHECK(seen);
+    camera.stop();
+
+    MetadataStats stats = parser.stats();
+    CHECK(stats.frames == 8 + options.buffer_count + 4);
+    CHECK(stats.missing == 0);
+}
+
+void testMissing() {
+    MockDeviceOptions options;
+    options.serial = "PLAIN";
+    options.modes = {ArducamTest::mockMode(kWidth, kHeight)};
+    options.fps = 0;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    REQUIRE(camera.start());
+    MetadataParser parser;
+    Frame frame;
+    REQUIRE(camera.capture(frame, 1000));
+    FrameMetadata metadata;
+    CHECK(!parser.parse(frame, metadata));
+    CHECK(parser.stats().missing == 1);
+    camera.freeImage(frame);
+    camera.stop();
+}
+
+// the lens position a parser reports for a frame without embedded data lines, -1 for none
+int64_t lensAt(MetadataParser& parser, uint32_t seq) {
+    Frame frame{};
+    frame.seq = seq;
+    FrameMetadata metadata;
+    parser.parse(frame, metadata);
+    return metadata.has(kMetaLensPosition) ? metadata.lens_position : -1;
+}
+
+void testNoteControl() {
+    MetadataParser parser;
+    CHECK(lensAt(parser, 10) == -1);
+    // only the lens control counts, whatever its case, from the frame it reaches on
+    parser.noteControl(12, "Focus", 300);
+    parser.noteControl(12, "Exposure", 5);
+    CHECK(lensAt(parser, 11) == -1);
+    CHECK(lensAt(parser, 12) == 300 && lensAt(parser, 13) == 300);
+    parser.noteControl(UINT32_MAX, "focus", 400);
+    CHECK(lensAt(parser, 14) == 400);
+    // across the wrap of the sequence numbers, and clamped to 32 bits
+    parser.noteControl(3, "FOCUS", int64_t(1) << 40);
+    CHECK(lensAt(parser, 0xFFFFFFF0) == 400);
+    CHECK(lensAt(parser, 3) == INT32_MAX);
+
+    // with nobody parsing, the oldest changes are taken as in effect
+    MetadataParser idle;
+    for (uint32_t i = 0; i <= 64; i++) {
+        idle.noteControl(1000 + i, "focus", i);
+    }
+    CHECK(lensAt(idle, 30) == 0);
+    CHECK(lensAt(idle, 1063) == 63 && lensAt(idle, 1064) == 64);
+
+    MetadataOptions none;
+    none.lens_control.clear();
+    MetadataParser disabled(none);
+    disabled.noteControl(UINT32_MAX, "focus", 1);
+    CHECK(lensAt(disabled, 1) == -1);
+}
+
+void testScheduler() {
+    MockDeviceOptions options;
+    options.serial = "METALENS";
+    options.modes = {ArducamTest::mockMode(kWidth, kHeight)};
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    EventDispatcher events(camera);
+    MetadataParser parser;
+    ControlSchedulerOptions scheduler_options;
+    scheduler_options.metadata = &parser;
+    auto scheduler = std::make_unique<ControlScheduler>(camera, events, scheduler_options);
+    // not synced yet: the change is noted for the next frame parsed
+    const uint64_t ticket = scheduler->schedule(kNextFrame, {ControlSetting{"Focus", 250}}, {});
+    events.dispatch(EventCode::FrameStart);
+    ControlResult result;
+    REQUIRE(scheduler->wait(ticket, result));
+    CHECK(result.ok);
+    // the parser is told after wait() is woken: it is done once the worker is joined
+    scheduler.reset();
+    CHECK(lensAt(parser, 7) == 250);
+}
+
+}  // namespace
+
+int main() {
+    testPacking("META8", 8, PixelPacking::Bits8);
+    testPacking("META16", 10, PixelPacking::Bits16);
+    testPacking("META10", 10, PixelPacking::Raw10Packed);
+    testPacking("META12", 12, PixelPacking::Raw12Packed);
+    testMissing();
+    testNoteControl();
+    testScheduler();
+    return ArducamTest::result();
+}
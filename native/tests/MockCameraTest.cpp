@@ -0,0 +1,169 @@
+// Checks the behaviour of the mock backend the other tests rely on: listing, capture and buffer accounting, the
+// capture callback, injected errors, disconnects and the device specification parser.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+void testListing() {
+    MockDeviceOptions a;
+    a.serial = "LIST_A";
+    CHECK(addMockDevice(a));
+    CHECK(!addMockDevice(a));
+    MockDeviceOptions b;
+    b.serial = "LIST_B";
+    CHECK(addMockDevice(b));
+
+    DeviceList list = DeviceList::listDevices();
+    CHECK(list.size() == 2);
+    std::atomic<int> connects{0}, disconnects{0};
+    list.setEventCallback([&](ArducamEventCode event, DeviceHandle) {
+        connects += event == DeviceConnect ? 1 : 0;
+        disconnects += event == DeviceDisconnect ? 1 : 0;
+    });
+    CHECK(disconnectMockDevice("LIST_B"));
+    CHECK(!disconnectMockDevice("LIST_B"));
+    CHECK(disconnects == 1);
+    list.refresh();
+    CHECK(list.size() == 1);
+    CHECK(connectMockDevice("LIST_B"));
+    CHECK(connects == 1);
+    list.refresh();
+    CHECK(list.size() == 2);
+    CHECK(removeMockDevice("LIST_A") && removeMockDevice("LIST_B"));
+    list.refresh();
+    CHECK(list.size() == 0);
+}
+
+void testCapture() {
+    MockDeviceOptions options;
+    options.serial = "CAPTURE";
+    options.modes = {ArducamTest::mockMode(640, 480), ArducamTest::mockMode(320, 240)};
+    options.fps = 0;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    CHECK(camera.width() == 640 && camera.height() == 480);
+    REQUIRE(camera.switchMode(1));
+    CHECK(camera.width() == 320 && camera.height() == 240);
+    REQUIRE(camera.start());
+
+    // every buffer can be held at once, and the frames come in order
+    std::vector<Frame> held(options.buffer_count);
+    for (uint32_t i = 0; i < options.buffer_count; i++) {
+        REQUIRE(camera.capture(held[i], 1000));
+        CHECK(held[i].size == 320 * 240 * 2);
+        CHECK(i == 0 || held[i].seq == held[i - 1].seq + 1);
+    }
+    Frame frame;
+    CHECK(!camera.capture(frame, 50));
+    // a buffer freed twice may already hold the next frame, only a foreign one is always refused
+    Frame foreign = held[0];
+    uint8_t byte = 0;
+    foreign.data = &byte;
+    CHECK(!camera.freeImage(foreign));
+    CHECK(camera.lastError() == FreeUnknowBuffer);
+    for (Frame& f : held) {
+        CHECK(camera.freeImage(f));
+    }
+
+    // an injected error fails the next transfer only
+    REQUIRE(injectMockError(options.serial, TransferTimeout));
+    REQUIRE(camera.capture(frame, 1000));
+    camera.freeImage(frame);
+    CHECK(camera.stop());
+
+    uint8_t written[4] = {1, 2, 3, 4}, read[4] = {};
+    CHECK(camera.writeUserData(100, written, 4));
+    CHECK(camera.readUserData(100, 4, read));
+    CHECK(std::memcmp(written, read, 4) == 0);
+    CHECK(!camera.writeUserData(65534, written, 4));
+    CHECK(camera.lastError() == UserdataAddrError);
+}
+
+void testCallbackAndErrors() {
+    MockDeviceOptions options;
+    options.serial = "CALLBACK";
+    options.modes = {ArducamTest::mockMode(320, 240)};
+    options.fps = 0;
+    options.transfer_error_every = 10;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    std::atomic<int> frames{0}, errors{0};
+    camera.setEventCallback([&](ArducamEventCode event) { errors += event == TransferError ? 1 : 0; });
+    camera.setCaptureCallback([&](Frame) { frames++; });
+    REQUIRE(camera.start());
+    Frame frame;
+    CHECK(!camera.capture(frame, 10));
+    CHECK(camera.lastError() == CaptureMethodConflict);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (frames < 100 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(frames >= 100);
+    CHECK(camera.stop());
+
+    MockDeviceStats stats;
+    REQUIRE(mockDeviceStats(options.serial, stats));
+    CHECK(stats.delivered == static_cast<uint64_t>(frames.load()));
+    CHECK(stats.transfer_errors == static_cast<uint64_t>(errors.load()));
+    CHECK(stats.transfer_errors > 0 && stats.transfer_errors == stats.frames / 10);
+}
+
+void testDisconnect() {
+    MockDeviceOptions options;
+    options.serial = "UNPLUG";
+    options.modes = {ArducamTest::mockMode(320, 240)};
+    options.fps = 0;
+    options.disconnect_after = 5;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    std::atomic<int> disconnects{0};
+    camera.setEventCallback([&](ArducamEventCode event) { disconnects += event == DeviceDisconnect ? 1 : 0; });
+    REQUIRE(camera.start());
+    int captured = 0;
+    Frame frame;
+    while (camera.capture(frame, 200)) {
+        captured++;
+        camera.freeImage(frame);
+    }
+    CHECK(captured == 5);
+    CHECK(disconnects == 1);
+    MockDeviceStats stats;
+    CHECK(mockDeviceStats(options.serial, stats) && stats.disconnects == 1);
+    camera.close();
+    CHECK(connectMockDevice(options.serial));
+}
+
+void testParse() {
+    std::vector<MockDeviceOptions> devices;
+    CHECK(parseMockDevices("fps=60;fps=60,error_every=100,size=320x240,bits=12,packing=raw12", devices));
+    REQUIRE(devices.size() == 2);
+    CHECK(devices[0].fps == 60);
+    CHECK(devices[1].transfer_error_every == 100);
+    REQUIRE(devices[1].modes.size() == 1);
+    CHECK(devices[1].modes[0].width == 320 && devices[1].modes[0].height == 240);
+    CHECK(devices[1].modes[0].bit_width == 12);
+    CHECK(devices[1].packing == PixelPacking::Raw12Packed);
+    CHECK(!parseMockDevices("fps=x", devices));
+    CHECK(!parseMockDevices("unknown=1", devices));
+}
+
+}  // namespace
+
+int main() {
+    testListing();
+    testCapture();
+    testCallbackAndErrors();
+    testDisconnect();
+    testParse();
+    return ArducamTest::result();
+}
@@ -0,0 +1,118 @@
+// Checks OutputQueue on mock cameras: the depth and the latest-only mode recycle the oldest frames to the input
+// queue, the trimming thread does so on FrameEnd events, drain() empties the queue, and a capture waiting for a
+// frame does not hold up trim() on another thread.
+
+#include <chrono>
+#include <thread>
+
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/OutputQueue.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+constexpr uint32_t kBuffers = 6;
+
+MockDeviceOptions queueOptions(const char* serial, double fps) {
+    MockDeviceOptions options;
+    options.serial = serial;
+    options.modes = {ArducamTest::mockMode(320, 240)};
+    options.fps = fps;
+    options.buffer_count = kBuffers;
+    return options;
+}
+
+// long enough for every buffer to fill at 50 fps, after which the frames are dropped
+void waitFull() { std::this_thread::sleep_for(std::chrono::milliseconds(250)); }
+
+void testDepth() {
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, queueOptions("OUTQ_DEPTH", 50)));
+    REQUIRE(camera.start());
+    waitFull();
+
+    OutputQueue queue(camera, nullptr, 2);
+    CHECK(queue.trim() == kBuffers - 2);
+    OutputQueueStats stats = queue.stats();
+    CHECK(stats.recycled == kBuffers - 2 && stats.depth == kBuffers && stats.max_depth == kBuffers);
+    FrameRef first, second;
+    REQUIRE(queue.capture(first, 1000));
+    REQUIRE(queue.capture(second, 1000));
+    CHECK(second.frame().seq > first.frame().seq);
+    CHECK(queue.stats().captured == 2);
+    const uint32_t last_seq = second.frame().seq;
+    first.reset();
+    second.reset();
+
+    // the newest frame only: the frames queued before it are skipped
+    queue.drain();
+    waitFull();
+    queue.setLatestOnly(true);
+    CHECK(queue.latestOnly() && queue.depth() == 2);
+    const uint64_t recycled = queue.stats().recycled;
+    FrameRef latest;
+    REQUIRE(queue.capture(latest, 1000));
+    CHECK(queue.stats().recycled - recycled == kBuffers - 1);
+    CHECK(latest.frame().seq >= last_seq + kBuffers);
+    latest.reset();
+
+    // drain() hands every buffer back, unlike Camera::clearBuffer()
+    waitFull();
+    CHECK(queue.drain() == kBuffers);
+    CHECK(queue.stats().depth == 0);
+    queue.resetStats();
+    stats = queue.stats();
+    CHECK(stats.captured == 0 && stats.recycled == 0 && stats.max_depth == 0);
+    camera.stop();
+}
+
+void testEvents() {
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, queueOptions("OUTQ_EVENTS", 100)));
+    EventDispatcher events(camera);
+    OutputQueue queue(camera, &events, 2);
+    REQUIRE(camera.start());
+    // nobody captures: the thread keeps the queue at its depth, give or take the frame that just arrived
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    CHECK(queue.stats().recycled > 0);
+    CHECK(camera.getAvailCount() <= 3);
+    CHECK(queue.stats().max_depth <= 3);
+    camera.stop();
+}
+
+void testUnlockedCapture() {
+    // a frame every 500 ms: the consumer waits long for each one
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, queueOptions("OUTQ_WAIT", 2)));
+    REQUIRE(camera.start());
+    OutputQueue queue(camera, nullptr, 1);
+    queue.drain();
+
+    bool captured = false;
+    std::thread consumer([&] {
+        FrameRef ref;
+        captured = queue.capture(ref, 2000);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    // the trim does not wait for the frame the capture waits for, and does not take it
+    const auto begin = std::chrono::steady_clock::now();
+    queue.trim();
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    CHECK(elapsed < std::chrono::milliseconds(100));
+    consumer.join();
+    CHECK(captured);
+    CHECK(queue.stats().captured == 1);
+    camera.stop();
+}
+
+}  // namespace
+
+int main() {
+    testDepth();
+    testEvents();
+    testUnlockedCapture();
+    return ArducamTest::result();
+}
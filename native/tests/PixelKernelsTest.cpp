@@ -0,0 +1,347 @@
+// Checks that the kernels of the best instruction set of the CPU (AVX2, NEON) give the same results as the portable
+// ones, on random rows of many lengths so that every vector body and tail runs. On a CPU that only has the portable
+// kernels the comparisons are trivial. convertFrame() and convertFrameRegion() are checked against the whole-frame
+// unpack, black level and demosaic steps for every packing, bayer order, method and output.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <arducam/PixelKernels.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+const PixelKernelTable& best = pixelKernels();
+const PixelKernelTable& scalar = scalarPixelKernels();
+std::mt19937 rng(20240607);
+
+// the lengths tried, around the vector widths of the kernels
+const size_t kCounts[] = {0,  1,  2,  3,  4,  7,  8,   12,  15,  16,  17,  24,
+                          31, 32, 33, 48, 63, 64, 65, 100, 128, 130, 257, 1536};
+
+std::vector<uint8_t> randomBytes(size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (auto& b : bytes) {
+        b = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+std::vector<uint16_t> randomSamples(size_t count, int bits) {
+    std::vector<uint16_t> samples(count);
+    for (auto& s : samples) {
+        s = static_cast<uint16_t>(rng() & ((1u << bits) - 1));
+    }
+    return samples;
+}
+
+template <typename T>
+bool same(const std::vector<T>& a, const std::vector<T>& b) {
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+void testUnpack() {
+    for (size_t count : kCounts) {
+        auto bytes = randomBytes(count * 2);
+        std::vector<uint16_t> a(count), b(count);
+        best.unpack8(bytes.data(), a.data(), count);
+        scalar.unpack8(bytes.data(), b.data(), count);
+        CHECK(same(a, b));
+        for (uint16_t mask : {0x03FF, 0x0FFF, 0xFFFF}) {
+            best.unpack16(bytes.data(), a.data(), count, mask);
+            scalar.unpack16(bytes.data(), b.data(), count, mask);
+            CHECK(same(a, b));
+        }
+        if (count % 4 == 0) {
+            auto raw10 = randomBytes(count / 4 * 5);
+            best.unpackRaw10(raw10.data(), a.data(), count);
+            scalar.unpackRaw10(raw10.data(), b.data(), count);
+            CHECK(same(a, b));
+        }
+        if (count % 2 == 0) {
+            auto raw12 = randomBytes(count / 2 * 3);
+            best.unpackRaw12(raw12.data(), a.data(), count);
+            scalar.unpackRaw12(raw12.data(), b.data(), count);
+            CHECK(same(a, b));
+        }
+    }
+    // the portable unpackers against the MIPI layout: 4 high bytes, then the low 2 bits of each pixel
+    const uint8_t raw10[5] = {0x12, 0x34, 0x56, 0x78, 0xE4};
+    uint16_t out[4];
+    scalar.unpackRaw10(raw10, out, 4);
+    CHECK(out[0] == (0x12 << 2 | 0) && out[1] == (0x34 << 2 | 1) && out[2] == (0x56 << 2 | 2) &&
+          out[3] == (0x78 << 2 | 3));
+    const uint8_t raw12[3] = {0x12, 0x34, 0xBA};
+    scalar.unpackRaw12(raw12, out, 2);
+    CHECK(out[0] == (0x12 << 4 | 0xA) && out[1] == (0x34 << 4 | 0xB));
+}
+
+void testSampleKernels() {
+    for (size_t count : kCounts) {
+        auto samples = randomSamples(count, 16);
+        auto a = samples, b = samples;
+        best.subtractBlack(a.data(), count, 4096);
+        scalar.subtractBlack(b.data(), count, 4096);
+        CHECK(same(a, b));
+
+        auto r = randomSamples(count, 10), g = randomSamples(count, 10), bl = randomSamples(count, 10);
+        std::vector<uint16_t> rgb_a(count * 3), rgb_b(count * 3);
+        best.packRgb16(r.data(), g.data(), bl.data(), rgb_a.data(), count);
+        scalar.packRgb16(r.data(), g.data(), bl.data(), rgb_b.data(), count);
+        CHECK(same(rgb_a, rgb_b));
+
+        std::vector<uint8_t> rgb8_a(count * 3), rgb8_b(count * 3);
+        for (bool bgr : {false, true}) {
+            best.packRgb8(r.data(), g.data(), bl.data(), rgb8_a.data(), count, 2, bgr);
+            scalar.packRgb8(r.data(), g.data(), bl.data(), rgb8_b.data(), count, 2, bgr);
+            CHECK(same(rgb8_a, rgb8_b));
+        }
+
+        std::vector<uint16_t> y_a(count), y_b(count);
+        best.luma16(r.data(), g.data(), bl.data(), y_a.data(), count);
+        scalar.luma16(r.data(), g.data(), bl.data(), y_b.data(), count);
+        CHECK(same(y_a, y_b));
+
+        // the shift brings the samples of each bit width to 8 bits
+        for (int bits : {8, 10, 12, 16}) {
+            auto wide = randomSamples(count, bits);
+            std::vector<uint8_t> n_a(count), n_b(count);
+            best.narrow8(wide.data(), n_a.data(), count, bits - 8);
+            scalar.narrow8(wide.data(), n_b.data(), count, bits - 8);
+            CHECK(same(n_a, n_b));
+        }
+    }
+}
+
+void testDemosaicRow() {
+    for (uint32_t width : {2u, 4u, 6u, 16u, 30u, 32u, 34u, 64u, 66u, 130u, 1536u}) {
+        auto up = randomSamples(width, 10), cur = randomSamples(width, 10), down = randomSamples(width, 10);
+        for (DemosaicMethod method : {DemosaicMethod::Bilinear, DemosaicMethod::EdgeAware}) {
+            for (int phase = 0; phase < 4; phase++) {
+                std::vector<uint16_t> r_a(width), g_a(width), b_a(width), r_b(width), g_b(width), b_b(width);
+                DemosaicRowArgs args{up.data(), cur.data(), down.data(), width, (phase & 1) != 0, (phase & 2) != 0,
+                                     method, r_a.data(), g_a.data(), b_a.data()};
+                best.demosaicRow(args);
+                args.r = r_b.data();
+                args.g = g_b.data();
+                args.b = b_b.data();
+                scalar.demosaicRow(args);
+                CHECK(same(r_a, r_b) && same(g_a, g_b) && same(b_a, b_b));
+            }
+        }
+    }
+}
+
+void testRemapRow() {
+    const uint32_t width = 97;
+    const uint32_t height = 9;
+    const uint32_t scale = 1u << kRemapFracBits;
+    for (OutputFormat format : {OutputFormat::Raw16, OutputFormat::Rgb16, OutputFormat::Rgb8, OutputFormat::Bgr8,
+                                OutputFormat::Y16, OutputFormat::Y8}) {
+        const size_t pixel = outputPixelSize(format);
+        auto src = randomBytes(width * height * pixel);
+        for (size_t count : kCounts) {
+            std::vector<uint32_t> coords(count);
+            std::vector<uint16_t> weights(count);
+            for (size_t i = 0; i < count; i++) {
+                const uint32_t x = rng() % (width - 1);
+                const uint32_t y = rng() % (height - 1);
+                coords[i] = x | y << 16;
+                weights[i] = rng() % 8 == 0 ? kRemapOutside
+                                            : static_cast<uint16_t>(rng() % scale | (rng() % scale) << 8);
+            }
+            // the blocks at the last row and column: the SIMD loads must stay inside `src_size`
+            if (count > 1) {
+                coords[count - 1] = (width - 2) | (height - 2) << 16;
+                weights[count - 1] = static_cast<uint16_t>((scale - 1) | (scale - 1) << 8);
+            }
+            std::vector<uint8_t> a(count * pixel), b(count * pixel);
+            RemapRowArgs args{};
+            args.src = src.data();
+            args.src_stride = width * pixel;
+            args.src_size = src.size();
+            args.coords = coords.data();
+            args.weights = weights.data();
+            args.dst = a.data();
+            args.count = static_cast<uint32_t>(count);
+            args.format = format;
+            best.remapRow(args);
+            args.dst = b.data();
+            scalar.remapRow(args);
+            CHECK(same(a, b));
+        }
+    }
+}
+
+void testDigestBytes() {
+    auto bytes = randomBytes(4096 + 64);
+    for (size_t offset : {0, 1, 3, 31}) {
+        for (size_t size : {0, 1, 7, 31, 32, 33, 63, 64, 65, 255, 256, 1000, 4096}) {
+            const uint8_t* src = bytes.data() + offset;
+            ByteDigest a{}, b{};
+            best.digestBytes(src, size, a);
+            scalar.digestBytes(src, size, b);
+            CHECK(a.hash == b.hash && a.min == b.min && a.max == b.max);
+            if (size > 0) {
+                auto minmax = std::minmax_element(src, src + size);
+                CHECK(b.min == *minmax.first && b.max == *minmax.second);
+            } else {
+                CHECK(b.min == 0 && b.max == 0);
+            }
+        }
+    }
+    // equal ranges at different addresses give equal digests, different ranges (almost always) differ
+    std::vector<uint8_t> copy(bytes.begin() + 5, bytes.begin() + 5 + 1000);
+    ByteDigest a{}, b{}, c{};
+    best.digestBytes(bytes.data() + 5, 1000, a);
+    best.digestBytes(copy.data(), copy.size(), b);
+    CHECK(a.hash == b.hash);
+    copy[517] ^= 0x10;
+    best.digestBytes(copy.data(), copy.size(), c);
+    CHECK(c.hash != b.hash);
+}
+
+// a random frame of `width` x `height` in a packing, with the bit width the packing implies
+std::vector<uint8_t> randomFrame(PixelPacking packing, uint32_t width, uint32_t height, uint16_t mode, BayerOrder order,
+                                 Frame& frame) {
+    const uint8_t bits = packing == PixelPacking::Bits8 ? 8 : packing == PixelPacking::Raw12Packed ? 12 : 10;
+    std::vector<uint8_t> bytes = randomBytes(packedRowSize(packing, width) * height);
+    if (packing == PixelPacking::Bits16) {
+        // inside the bit width, so that the black level and the shifts see the values a sensor sends
+        for (size_t i = 1; i < bytes.size(); i += 2) {
+            bytes[i] &= 0x03;
+        }
+    }
+    frame = Frame{};
+    frame.data = bytes.data();
+    frame.size = static_cast<uint32_t>(bytes.size());
+    frame.format.width = width;
+    frame.format.height = height;
+    frame.format.bit_width = bits;
+    frame.format.format = static_cast<uint16_t>(mode << 8 | static_cast<uint8_t>(order));
+    return bytes;
+}
+
+void testConvertFrame() {
+    constexpr uint32_t kWidth = 64;
+    constexpr uint32_t kHeight = 10;
+    constexpr size_t kPixels = kWidth * kHeight;
+    ConvertOptions options;
+    options.black_level = 16;
+    for (PixelPacking packing : {PixelPacking::Bits8, PixelPacking::Bits16, PixelPacking::Raw10Packed,
+                                 PixelPacking::Raw12Packed}) {
+        for (BayerOrder order : {BayerOrder::RGGB, BayerOrder::GRBG, BayerOrder::GBRG, BayerOrder::BGGR}) {
+            Frame frame;
+            const std::vector<uint8_t> bytes = randomFrame(packing, kWidth, kHeight, FORMAT_MODE_RAW, order, frame);
+            REQUIRE(detectPacking(frame) == packing);
+            std::vector<uint16_t> scratch(convertScratchSize(frame.format));
+            const int shift = frame.format.bit_width - 8;
+
+            // the reference: the whole frame unpacked, black level corrected and demosaiced in separate steps
+            std::vector<uint16_t> raw(kPixels), rgb(kPixels * 3), demosaic_scratch(kWidth * 3);
+            REQUIRE(unpackFrame(frame, raw.data()));
+            subtractBlackLevel(raw.data(), raw.size(), options.black_level);
+            for (DemosaicMethod method : {DemosaicMethod::Bilinear, DemosaicMethod::EdgeAware}) {
+                options.method = method;
+                demosaic(raw.data(), kWidth, kHeight, order, method, rgb.data(), demosaic_scratch.data());
+                for (OutputFormat output : {OutputFormat::Raw16, OutputFormat::Rgb16, OutputFormat::Rgb8,
+                                            OutputFormat::Bgr8, OutputFormat::Y16, OutputFormat::Y8}) {
+                    options.output = output;
+                    const size_t pixel = outputPixelSize(output);
+                    std::vector<uint8_t> whole(kPixels * pixel);
+                    REQUIRE(convertFrame(frame, options, whole.data(), 0, scratch.data()));
+                    const auto* whole16 = reinterpret_cast<const uint16_t*>(whole.data());
+                    bool ok = true;
+                    for (size_t i = 0; i < kPixels; i++) {
+                        const uint16_t* px = &rgb[i * 3];
+                        const auto luma = static_cast<uint16_t>((77u * px[0] + 150u * px[1] + 29u * px[2] + 128u) >> 8);
+                        switch (output) {
+                            case OutputFormat::Raw16:
+                                ok = ok && whole16[i] == raw[i];
+                                break;
+                            case OutputFormat::Rgb16:
+                                ok = ok && std::memcmp(&whole16[i * 3], px, 6) == 0;
+                                break;
+                            case OutputFormat::Rgb8:
+                            case OutputFormat::Bgr8:
+                                for (int c = 0; c < 3; c++) {
+                                    const int channel = output == OutputFormat::Bgr8 ? 2 - c : c;
+                                    ok = ok && whole[i * 3 + c] == std::min(px[channel] >> shift, 255);
+                                }
+                                break;
+                            case OutputFormat::Y16:
+                                ok = ok && whole16[i] == luma;
+                                break;
+                            case OutputFormat::Y8:
+                                ok = ok && whole[i] == std::min(luma >> shift, 255);
+                                break;
+                        }
+                    }
+                    if (!CHECK(ok)) {
+                        std::fprintf(stderr, "packing %d, order %d, method %d, output %d\n", int(packing), int(order),
+                                     int(method), int(output));
+                    }
+
+                    // odd tiles, so that the packing groups and the bayer phase of a region do not line up
+                    std::vector<uint8_t> tiled(whole.size());
+                    for (uint32_t y0 = 0; y0 < kHeight; y0 += 3) {
+                        for (uint32_t x0 = 0; x0 < kWidth; x0 += 13) {
+                            REQUIRE(convertFrameRegion(frame, options, x0, x0 + 13, y0, y0 + 3,
+                                                       &tiled[(y0 * kWidth + x0) * pixel], kWidth * pixel,
+                                                       scratch.data()));
+                        }
+                    }
+                    CHECK(tiled == whole);
+                }
+            }
+        }
+    }
+
+    // a mono frame is not demosaiced, and a format that is neither bayer nor mono is refused
+    Frame frame;
+    const std::vector<uint8_t> bytes = randomFrame(PixelPacking::Bits16, kWidth, kHeight, FORMAT_MODE_MON,
+                                                   BayerOrder::RGGB, frame);
+    std::vector<uint16_t> raw(kPixels), y16(kPixels);
+    std::vector<uint16_t> scratch(convertScratchSize(frame.format));
+    REQUIRE(unpackFrame(frame, raw.data()));
+    subtractBlackLevel(raw.data(), raw.size(), options.black_level);
+    options.output = OutputFormat::Y16;
+    REQUIRE(convertFrame(frame, options, reinterpret_cast<uint8_t*>(y16.data()), 0, scratch.data()));
+    CHECK(y16 == raw);
+    frame.format.format = FORMAT_MODE_YUV << 8;
+    CHECK(!convertFrame(frame, options, reinterpret_cast<uint8_t*>(y16.data()), 0, scratch.data()));
+    frame.format.format = FORMAT_MODE_MON << 8;
+    frame.size--;
+    CHECK(!convertFrame(frame, options, reinterpret_cast<uint8_t*>(y16.data()), 0, scratch.data()));
+}
+
+const char* levelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Avx2:
+            return "AVX2";
+        case SimdLevel::Neon:
+            return "NEON";
+        default:
+            return "scalar";
+    }
+}
+
+}  // namespace
+
+int main() {
+    std::printf("best kernels: %s\n", levelName(best.level));
+    CHECK(scalar.level == SimdLevel::Scalar);
+    testUnpack();
+    testSampleKernels();
+    testDemosaicRow();
+    testRemapRow();
+    testDigestBytes();
+    testConvertFrame();
+    return ArducamTest::result();
+}
@@ -0,0 +1,68 @@
+# Checks the release of frames of the arducam_native module on the mock backend: the `with` pattern of the module
+# documentation, views that outlive the block, and `release()` while a view is alive. `memoryview` takes the same
+# buffer export as `numpy.asarray`.
+
+import os
+import sys
+
+os.environ["ARDUCAM_MOCK_DEVICES"] = "fps=0,size=320x240,bits=10,buffers=4"
+
+import arducam_native  # noqa: E402
+
+failures = 0
+
+
+def check(cond, what):
+    global failures
+    if not cond:
+        print("check failed: " + what, file=sys.stderr)
+        failures += 1
+
+
+camera = arducam_native.Camera()
+check(camera.open() and camera.init() and camera.start(), "open, init and start")
+
+# a view that ends inside the block: the frame is released on exit
+with camera.capture(1000) as frame:
+    with memoryview(frame) as view:
+        check(view.nbytes == frame.size, "the view covers the frame")
+check(frame.released, "released on exit")
+check(camera.frames_held == 0, "no frame held after the block")
+
+# the documented pattern: the view outlives the block and keeps the buffer until it goes
+with camera.capture(1000) as frame:
+    image = memoryview(frame)
+    first = image[0, 0]
+check(not frame.released, "a live view keeps the frame")
+check(camera.frames_held == 1, "the frame is held while viewed")
+check(image[0, 0] == first, "the view stays readable")
+try:
+    memoryview(frame)
+    check(False, "no new view after the block")
+except BufferError:
+    pass
+image.release()
+check(frame.released, "released with the last view")
+check(camera.frames_held == 0, "no frame held after the view")
+
+# again and again: a leak would run out of the 4 buffers
+for _ in range(12):
+    with camera.capture(1000) as frame:
+        image = memoryview(frame)
+    del image
+check(camera.frames_held == 0, "no frame held after the loop")
+
+# release() still refuses while a view is alive
+frame = camera.capture(1000)
+view = memoryview(frame)
+try:
+    frame.release()
+    check(False, "release() with a view alive")
+except BufferError:
+    pass
+view.release()
+frame.release()
+check(frame.released and camera.frames_held == 0, "release() after the view")
+
+check(camera.stop() and camera.close(), "stop and close")
+sys.exit(1 if failures else 0)
@@ -0,0 +1,234 @@
+// Records frames of a mock camera, reads them back with RawReader and replays the file through a mock device. A
+// recording read before it is closed, as after a crash, and a file cut short give the frames that were written.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <arducam/FrameMetadata.hpp>
+#include <arducam/FrameRef.hpp>
+#include <arducam/RawRecorder.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+constexpr const char* kRecording = "RawRecorderTest.raw";
+constexpr int kFrames = 6;
+
+struct Captured {
+    std::vector<uint8_t> data;
+    uint32_t seq;
+    uint64_t timestamp;
+    FrameMetadata metadata;
+};
+
+std::vector<Captured> captured;
+
+void testRecord() {
+    MockDeviceOptions options;
+    options.serial = "REC";
+    options.modes = {ArducamTest::mockMode(640, 480)};
+    options.packing = PixelPacking::Raw10Packed;
+    options.embedded_lines = 2;
+    options.fps = 0;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+
+    RecorderOptions rec_options;
+    rec_options.capacity = 16 << 20;
+    rec_options.chunk_size = 1 << 20;
+    auto recorder = RawRecorder::create(kRecording, rec_options);
+    REQUIRE(recorder != nullptr);
+
+    MetadataOptions md_options;
+    md_options.packing = PixelPacking::Raw10Packed;
+    MetadataParser parser(md_options);
+    REQUIRE(camera.start());
+    for (int i = 0; i < kFrames; i++) {
+        Frame frame;
+        REQUIRE(camera.capture(frame, 1000));
+        FrameRef ref = FrameRef::adopt(camera, frame);
+        CHECK(parser.parse(ref));
+        REQUIRE(ref.metadata() != nullptr);
+        captured.push_back({std::vector<uint8_t>(frame.data, frame.data + frame.size), frame.seq, frame.timestamp,
+                            *ref.metadata()});
+        CHECK(recorder->record(std::move(ref), static_cast<uint8_t>(i % 2)));
+    }
+    CHECK(recorder->close());
+    CHECK(!recorder->record(FrameRef()));
+    camera.stop();
+
+    RecorderStats stats = recorder->stats();
+    CHECK(stats.frames == kFrames);
+    CHECK(stats.dropped == 0);
+    CHECK(stats.write_errors == 0);
+}
+
+void testRead() {
+    auto reader = RawReader::open(kRecording);
+    REQUIRE(reader != nullptr);
+    CHECK(reader->complete());
+    REQUIRE(reader->frameCount() == captured.size());
+    for (size_t i = 0; i < captured.size(); i++) {
+        const RecordIndexEntry& entry = reader->entry(i);
+        CHECK(entry.seq == captured[i].seq);
+        CHECK(entry.timestamp == captured[i].timestamp);
+        CHECK(entry.stream == i % 2);
+        CHECK(entry.width == 640 && entry.height == 480 && entry.bit_width == 10);
+
+        Frame frame;
+        REQUIRE(reader->frame(i, frame));
+        REQUIRE(frame.size == captured[i].data.size());
+        CHECK(std::memcmp(frame.data, captured[i].data.data(), frame.size) == 0);
+        CHECK(detectPacking(frame) == PixelPacking::Raw10Packed);
+
+        FrameMetadata metadata;
+        REQUIRE(reader->metadata(i, metadata));
+        const FrameMetadata& expected = captured[i].metadata;
+        CHECK(metadata.valid == expected.valid);
+        CHECK(metadata.exposure_lines == expected.exposure_lines);
+        CHECK(metadata.frame_length_lines == expected.frame_length_lines);
+        CHECK(metadata.frame_count == expected.frame_count);
+
+        FrameRef ref = reader->frameRef(i);
+        REQUIRE(ref);
+        CHECK(ref.metadata() != nullptr && ref.metadata()->exposure_lines == expected.exposure_lines);
+    }
+    Frame frame;
+    CHECK(!reader->frame(captured.size(), frame));
+    CHECK(!reader->frameRef(captured.size()));
+}
+
+// a captured frame as a handle that releases nothing
+FrameRef wrapCaptured(Captured& c) {
+    Frame frame{};
+    frame.data = c.data.data();
+    frame.size = static_cast<uint32_t>(c.data.size());
+    frame.seq = c.seq;
+    frame.timestamp = c.timestamp;
+    frame.format.width = 640;
+    frame.format.height = 480;
+    frame.format.bit_width = 10;
+    frame.format.format = FORMAT_MODE_RAW << 8;
+    return FrameRef::wrap(frame, nullptr, [](void*, const Frame&) {});
+}
+
+bool sameFrame(const RawReader& reader, size_t i) {
+    Frame frame;
+    return reader.frame(i, frame) && frame.seq == captured[i].seq && frame.size == captured[i].data.size() &&
+           std::memcmp(frame.data, captured[i].data.data(), frame.size) == 0;
+}
+
+void testInterrupted() {
+    REQUIRE(captured.size() == kFrames);
+    // about 2.7 frames per chunk: the index on disk only ever names frames whose data is all written
+    const char* path = "RawRecorderTest_open.raw";
+    RecorderOptions rec_options;
+    rec_options.capacity = 16 << 20;
+    rec_options.chunk_size = 1 << 20;
+    auto recorder = RawRecorder::create(path, rec_options);
+    REQUIRE(recorder != nullptr);
+    for (Captured& c : captured) {
+        CHECK(recorder->record(wrapCaptured(c)));
+    }
+    for (int i = 0; i < 1000 && recorder->stats().frames < kFrames; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(recorder->stats().frames == kFrames);
+
+    // read while the recorder is still open, as after a crash: the last flush was the 2 MiB chunk, within frame 5
+    {
+        auto reader = RawReader::open(path);
+        REQUIRE(reader != nullptr);
+        CHECK(!reader->complete());
+        REQUIRE(reader->frameCount() == kFrames - 1);
+        for (size_t i = 0; i < reader->frameCount(); i++) {
+            CHECK(sameFrame(*reader, i));
+        }
+    }
+    CHECK(recorder->close());
+    auto reader = RawReader::open(path);
+    REQUIRE(reader != nullptr);
+    CHECK(reader->complete() && reader->frameCount() == kFrames && sameFrame(*reader, kFrames - 1));
+    reader.reset();
+    std::remove(path);
+}
+
+// copies the first `size` bytes of the recording
+bool copyPrefix(const char* path, uint64_t size) {
+    std::ifstream in(kRecording, std::ios::binary);
+    std::vector<char> bytes(size);
+    if (!in.read(bytes.data(), static_cast<std::streamsize>(size))) {
+        return false;
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    return static_cast<bool>(out.write(bytes.data(), static_cast<std::streamsize>(size)));
+}
+
+void testTruncated() {
+    uint64_t end = 0;
+    uint64_t data_offset = 0;
+    {
+        auto reader = RawReader::open(kRecording);
+        REQUIRE(reader != nullptr && reader->frameCount() == kFrames);
+        end = reader->entry(2).offset + reader->entry(2).size;
+        data_offset = reader->header().data_offset;
+    }
+    // a file cut within frame 3: the frames before it are read, the ones past the end are refused
+    const char* path = "RawRecorderTest_cut.raw";
+    REQUIRE(copyPrefix(path, end + 1000));
+    {
+        auto reader = RawReader::open(path);
+        REQUIRE(reader != nullptr);
+        CHECK(reader->frameCount() == kFrames);
+        for (size_t i = 0; i < kFrames; i++) {
+            CHECK(sameFrame(*reader, i) == (i < 3));
+        }
+        CHECK(!reader->frameRef(3));
+    }
+    // without the whole index, or without even the header, it is not a recording
+    REQUIRE(copyPrefix(path, data_offset / 2));
+    CHECK(RawReader::open(path) == nullptr);
+    REQUIRE(copyPrefix(path, 100));
+    CHECK(RawReader::open(path) == nullptr);
+    std::remove(path);
+}
+
+void testReplay() {
+    MockDeviceOptions options;
+    options.serial = "REPLAY";
+    options.replay_file = kRecording;
+    options.loop = false;
+    options.fps = 0;
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    CHECK(camera.width() == 640 && camera.height() == 480);
+    REQUIRE(camera.start());
+    for (const Captured& expected : captured) {
+        Frame frame;
+        REQUIRE(camera.capture(frame, 1000));
+        CHECK(frame.size == expected.data.size() && std::memcmp(frame.data, expected.data.data(), frame.size) == 0);
+        camera.freeImage(frame);
+    }
+    Frame frame;
+    CHECK(!camera.capture(frame, 100));
+    camera.stop();
+}
+
+}  // namespace
+
+int main() {
+    testRecord();
+    testRead();
+    testInterrupted();
+    testTruncated();
+    testReplay();
+    std::remove(kRecording);
+    return ArducamTest::result();
+}
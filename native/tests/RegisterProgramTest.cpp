@@ -0,0 +1,169 @@
+// Checks the register programs compiled from configuration files (through the parser of the mock backend): their
+// reduction by RegisterProgram::diff(), the binary cache, and the switches of ModeSwitcher on a mock camera, including
+// registers written behind its back and reported through RegBatchOptions::mode_switcher.
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <arducam/RegisterBatch.hpp>
+#include <arducam/RegisterProgram.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+// a configuration file of one mode: a board command, then the sensor registers with a delay after the exposure
+std::string writeConfig(const char* name, uint32_t mode, uint32_t width, uint32_t height, uint32_t exposure,
+                        bool reset = false) {
+    const std::string path = std::string("RegisterProgramTest_") + name + ".cfg";
+    std::ofstream file(path);
+    file << "[camera parameter]\n"
+         << "CFG_MODE = " << mode << "\n"
+         << "TYPE = IMX708\n"
+         << "SIZE = " << width << ", " << height << "\n"
+         << "BIT_WIDTH = 10\n"
+         << "FORMAT = 0, 0\n"
+         << "I2C_MODE = 2\n"
+         << "I2C_ADDR = 0x34\n"
+         << "[board parameter]\n"
+         << "VRCMD = 0xD7, 0x4600, 0x0100, 2, 0x05, 0x06\n"
+         << "[register parameter]\n";
+    if (reset) {
+        file << "REG = 0x0103, 0x01\n";
+    }
+    file << "REG = 0x0100, 0x00\n"
+         << "REG = 0x0202, " << (exposure >> 8) << "\n"
+         << "REG = 0x0203, " << (exposure & 0xFF) << "\n"
+         << "DELAY = 1\n"
+         << "REG = 0x0340, 0x08\n"
+         << "REG = 0x0341, 0x00\n"
+         << "DELAY = 1\n"
+         << "REG = 0x0100, 0x01\n";
+    return path;
+}
+
+size_t countOps(const RegisterProgram& program, RegOpType type) {
+    size_t n = 0;
+    for (const RegOp& op : program.ops()) {
+        n += op.type == type ? 1 : 0;
+    }
+    return n;
+}
+
+bool compileConfig(const std::string& path, RegisterProgram& program) {
+    const bool ok = RegisterProgram::compileFile(path, 0, program);
+    std::remove(path.c_str());
+    return ok;
+}
+
+void testCompileAndDiff() {
+    RegisterProgram a, b, small, reset;
+    REQUIRE(compileConfig(writeConfig("a", 0, 640, 480, 0x0400), a));
+    REQUIRE(compileConfig(writeConfig("b", 1, 640, 480, 0x0800), b));
+    REQUIRE(compileConfig(writeConfig("small", 2, 320, 240, 0x0400), small));
+    REQUIRE(compileConfig(writeConfig("reset", 3, 640, 480, 0x0400, true), reset));
+    CHECK(a.modeId() == 0 && b.modeId() == 1);
+    CHECK(a.config().width == 640 && a.config().height == 480 && a.config().bit_width == 10);
+    CHECK(a.writeCount() == 6);
+    CHECK(countOps(a, RegOpType::Delay) == 2 && countOps(a, RegOpType::BoardCommand) == 1);
+    CHECK((a.payload() == std::vector<uint8_t>{0x05, 0x06}));
+    CHECK(a.sameFormat(b) && !a.sameFormat(small));
+
+    // from a to b: the exposure and the always written mode_select, the delay after the exposure, the same board
+    // command is dropped and so is the delay with nothing new before it
+    const RegisterProgram reduced = b.diff(a);
+    CHECK(reduced.writeCount() == 3);
+    CHECK(countOps(reduced, RegOpType::Delay) == 1 && countOps(reduced, RegOpType::BoardCommand) == 0);
+    REQUIRE(reduced.ops().size() == 4);
+    CHECK(reduced.ops()[0].address == 0x0100 && reduced.ops()[1].address == 0x0202 &&
+          reduced.ops()[1].value == 0x08 && reduced.ops()[2].type == RegOpType::Delay &&
+          reduced.ops()[3].address == 0x0100 && reduced.ops()[3].value == 0x01);
+    // without always written registers the same mode reduces to the stream toggle: mode_select is left at 1 by `a`
+    // and its first write of 0 differs, and so does the 1 after it
+    DiffOptions none;
+    none.always_write.clear();
+    const RegisterProgram same = a.diff(a, none);
+    CHECK(same.writeCount() == 2 && same.ops().size() == 3 && same.ops()[1].type == RegOpType::Delay);
+    // a program resetting the sensor is never reduced
+    CHECK(reset.diff(a).writeCount() == reset.writeCount());
+
+    // the binary cache gives back the same programs
+    const char* cache = "RegisterProgramTest.cache";
+    REQUIRE(saveProgramCache(cache, {a, b}));
+    std::vector<RegisterProgram> loaded;
+    REQUIRE(loadProgramCache(cache, loaded));
+    std::remove(cache);
+    REQUIRE(loaded.size() == 2);
+    std::vector<uint8_t> expected, actual;
+    b.serialize(expected);
+    loaded[1].serialize(actual);
+    CHECK(loaded[0].modeId() == 0 && actual == expected);
+}
+
+uint32_t readSensor(Camera& camera, uint32_t reg) {
+    RegRead read{reg, 0};
+    RegBatchOptions options;
+    options.max_merge = 1;
+    return readRegs(camera, &read, 1, options) ? read.value : 0xFFFFFFFF;
+}
+
+void testModeSwitcher() {
+    MockDeviceOptions options;
+    options.serial = "SWITCH";
+    options.modes = {ArducamTest::mockMode(640, 480), ArducamTest::mockMode(640, 480),
+                     ArducamTest::mockMode(320, 240)};
+    Camera camera;
+    REQUIRE(ArducamTest::openMockCamera(camera, options));
+    RegisterProgram programs[3];
+    REQUIRE(compileConfig(writeConfig("a", 0, 640, 480, 0x0400), programs[0]));
+    REQUIRE(compileConfig(writeConfig("b", 1, 640, 480, 0x0800), programs[1]));
+    REQUIRE(compileConfig(writeConfig("small", 2, 320, 240, 0x0400), programs[2]));
+    ModeSwitcher switcher(camera);
+    for (const RegisterProgram& program : programs) {
+        switcher.addProgram(program);
+    }
+    uint32_t current = 0;
+    CHECK(!switcher.currentMode(current));
+    REQUIRE(programs[0].run(camera));
+    switcher.setCurrentMode(0);
+
+    REQUIRE(switcher.switchTo(1));
+    CHECK(switcher.lastWriteCount() == 3);
+    CHECK(readSensor(camera, 0x0202) == 0x08);
+    CHECK(switcher.switchTo(1) && switcher.lastWriteCount() == 0);
+
+    // a register written through writeRegs() is rewritten by the next switch, even to the current mode
+    RegWrite write{0x0341, 0x55};
+    RegBatchOptions regs;
+    regs.mode_switcher = &switcher;
+    REQUIRE(writeRegs(camera, &write, 1, regs));
+    CHECK(readSensor(camera, 0x0341) == 0x55);
+    REQUIRE(switcher.switchTo(1));
+    CHECK(switcher.lastWriteCount() == 3);
+    CHECK(readSensor(camera, 0x0341) == 0x00);
+
+    REQUIRE(switcher.switchTo(0));
+    CHECK(switcher.lastWriteCount() == 3);
+    CHECK(readSensor(camera, 0x0202) == 0x04);
+    // an unknown sensor state runs the whole program
+    switcher.invalidate();
+    REQUIRE(switcher.switchTo(1));
+    CHECK(switcher.lastWriteCount() == static_cast<int>(programs[1].writeCount()));
+    // another frame size goes through Camera::switchMode()
+    REQUIRE(switcher.switchTo(2));
+    CHECK(switcher.lastWriteCount() == -1);
+    CHECK(camera.width() == 320 && camera.height() == 240);
+    CHECK(switcher.currentMode(current) && current == 2);
+}
+
+}  // namespace
+
+int main() {
+    testCompileAndDiff();
+    testModeSwitcher();
+    return ArducamTest::result();
+}
@@ -0,0 +1,248 @@
+// Checks RemapLut against a full-frame reference: every output pixel of the fused fixed-point table is compared with
+// the correction evaluated in double precision and sampled bilinearly, one pixel at a time. The tiled, pooled and
+// windowed ways of applying the table must agree exactly, and a plain crop and pad must copy the source.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <arducam/RemapLut.hpp>
+#include <arducam/WorkerPool.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+// two tile columns, the second one partial
+constexpr uint32_t kWidth = 300;
+constexpr uint32_t kHeight = 72;
+
+// a smooth Y16 image, on which the 1/32 pixel weights of the table cost at most a count or two
+std::vector<uint16_t> sourceImage() {
+    std::vector<uint16_t> image(kWidth * kHeight);
+    for (uint32_t y = 0; y < kHeight; y++) {
+        for (uint32_t x = 0; x < kWidth; x++) {
+            image[y * kWidth + x] = static_cast<uint16_t>(1000 + 30 * x + 20 * y + 50 * std::sin(x * 0.05));
+        }
+    }
+    return image;
+}
+
+CorrectionParams fullParams() {
+    CorrectionParams params;
+    params.crop_x = 10;
+    params.crop_y = 4;
+    params.crop_width = 280;
+    params.crop_height = 60;
+    params.pad_top = 3;
+    params.pad_bottom = 2;
+    params.radial = true;
+    params.xcenter = 140.5;
+    params.ycenter = 30.25;
+    params.coeffs = {1.0, 0.0, 2e-6};
+    params.perspective = true;
+    params.pers_coef = {1.01, 0.02, -1.5, -0.01, 0.99, 2.0, 1e-5, -2e-5};
+    params.rotation = 3.0;
+    return params;
+}
+
+// the source position output pixel (xo, yo) samples, in crop window coordinates, following the documented order of
+// the steps backwards; false if it lies outside the window or within `margin` of its edge
+bool referencePosition(const CorrectionParams& p, uint32_t width, uint32_t height, uint32_t crop_width,
+                       uint32_t crop_height, uint32_t xo, uint32_t yo, double margin, double& x, double& y) {
+    x = xo;
+    y = yo;
+    if (p.rotation != 0) {
+        // the inverse of `cv2.getRotationMatrix2D` about the integer center
+        const double a = p.rotation * 3.14159265358979323846 / 180.0;
+        const double cx = width / 2;
+        const double cy = height / 2;
+        const double u = x - cx;
+        const double v = y - cy;
+        x = std::cos(a) * u - std::sin(a) * v + cx;
+        y = std::sin(a) * u + std::cos(a) * v + cy;
+    }
+    if (p.perspective) {
+        const auto& c = p.pers_coef;
+        const double d = c[6] * x + c[7] * y + 1.0;
+        const double px = (c[0] * x + c[1] * y + c[2]) / d;
+        y = (c[3] * x + c[4] * y + c[5]) / d;
+        x = px;
+    }
+    if (p.radial) {
+        const double cx = p.xcenter;
+        const double cy = p.ycenter + p.pad_top;
+        const double r = std::hypot(x - cx, y - cy);
+        double factor = 0;
+        for (size_t i = p.coeffs.size(); i-- > 0;) {
+            factor = factor * r + p.coeffs[i];
+        }
+        x = cx + factor * (x - cx);
+        y = cy + factor * (y - cy);
+    }
+    y -= p.pad_top;
+    return x >= margin && y >= margin && x <= crop_width - 1 - margin && y <= crop_height - 1 - margin;
+}
+
+double bilinear(const std::vector<uint16_t>& image, double x, double y) {
+    const uint32_t x0 = std::min(static_cast<uint32_t>(x), kWidth - 2);
+    const uint32_t y0 = std::min(static_cast<uint32_t>(y), kHeight - 2);
+    const double fx = x - x0;
+    const double fy = y - y0;
+    auto at = [&](uint32_t xi, uint32_t yi) { return static_cast<double>(image[yi * kWidth + xi]); };
+    return (at(x0, y0) * (1 - fx) + at(x0 + 1, y0) * fx) * (1 - fy) +
+           (at(x0, y0 + 1) * (1 - fx) + at(x0 + 1, y0 + 1) * fx) * fy;
+}
+
+void testCropPad() {
+    CorrectionParams params;
+    params.crop_x = 7;
+    params.crop_y = 5;
+    params.crop_width = 263;
+    params.crop_height = 50;
+    params.pad_top = 4;
+    params.pad_bottom = 6;
+    RemapLut lut;
+    REQUIRE(lut.build(params, kWidth, kHeight));
+    REQUIRE(lut.width() == 263 && lut.height() == 60);
+    uint32_t width = 0, height = 0;
+    CHECK(correctedSize(params, kWidth, kHeight, width, height) && width == 263 && height == 60);
+    const std::vector<uint16_t> src = sourceImage();
+    std::vector<uint16_t> dst(lut.width() * lut.height(), 0xFFFF);
+    REQUIRE(lut.apply(OutputFormat::Y16, reinterpret_cast<const uint8_t*>(src.data()), 0,
+                      reinterpret_cast<uint8_t*>(dst.data()), 0));
+    bool same = true;
+    for (uint32_t y = 0; y < lut.height(); y++) {
+        for (uint32_t x = 0; x < lut.width(); x++) {
+            const bool pad = y < params.pad_top || y >= params.pad_top + params.crop_height;
+            const uint16_t expected = pad ? 0 : src[(y - params.pad_top + params.crop_y) * kWidth + x + params.crop_x];
+            same = same && dst[y * lut.width() + x] == expected;
+        }
+    }
+    CHECK(same);
+    // a crop window that leaves less than 2x2 pixels is refused
+    params.crop_x = kWidth - 1;
+    CHECK(!lut.build(params, kWidth, kHeight) && lut.empty());
+}
+
+void testReference() {
+    const CorrectionParams params = fullParams();
+    WorkerPool pool(3);
+    RemapLut lut;
+    REQUIRE(lut.build(params, kWidth, kHeight, &pool));
+    REQUIRE(lut.width() == params.crop_width && lut.height() == params.crop_height + 5);
+    const std::vector<uint16_t> src = sourceImage();
+    std::vector<uint16_t> dst(lut.width() * lut.height());
+    REQUIRE(lut.apply(OutputFormat::Y16, reinterpret_cast<const uint8_t*>(src.data()), 0,
+                      reinterpret_cast<uint8_t*>(dst.data()), 0, &pool));
+
+    // the crop window in the source image, so that the reference samples the same pixels
+    std::vector<uint16_t> window(kWidth * kHeight, 0);
+    for (uint32_t y = 0; y < params.crop_height; y++) {
+        std::memcpy(&window[y * kWidth], &src[(y + params.crop_y) * kWidth + params.crop_x],
+                    params.crop_width * sizeof(uint16_t));
+    }
+    double max_error = 0;
+    size_t inside = 0, outside = 0, black = 0;
+    for (uint32_t yo = 0; yo < lut.height(); yo++) {
+        for (uint32_t xo = 0; xo < lut.width(); xo++) {
+            const uint16_t value = dst[yo * lut.width() + xo];
+            double x, y;
+            if (referencePosition(params, lut.width(), lut.height(), params.crop_width, params.crop_height, xo, yo,
+                                  0.01, x, y)) {
+                max_error = std::max(max_error, std::abs(value - bilinear(window, x, y)));
+                inside++;
+            } else if (!referencePosition(params, lut.width(), lut.height(), params.crop_width, params.crop_height,
+                                          xo, yo, -0.01, x, y)) {
+                black += value == 0 ? 1 : 0;
+                outside++;
+            }
+        }
+    }
+    std::printf("reference: %zu pixels inside, %zu outside, max error %.2f\n", inside, outside, max_error);
+    CHECK(inside > lut.width() * lut.height() * 3 / 4 && outside > 0);
+    CHECK(black == outside);
+    CHECK(max_error <= 2.0);
+}
+
+void testTiling() {
+    const CorrectionParams params = fullParams();
+    RemapLut lut;
+    REQUIRE(lut.build(params, kWidth, kHeight));
+    WorkerPool pool(3);
+    const std::vector<uint16_t> src = sourceImage();
+    const auto* src_bytes = reinterpret_cast<const uint8_t*>(src.data());
+    const size_t count = lut.width() * lut.height();
+    const size_t stride = lut.width() * sizeof(uint16_t);
+    std::vector<uint16_t> serial(count), pooled(count), rows(count), windowed(count);
+    REQUIRE(lut.apply(OutputFormat::Y16, src_bytes, 0, reinterpret_cast<uint8_t*>(serial.data()), 0));
+    REQUIRE(lut.apply(OutputFormat::Y16, src_bytes, 0, reinterpret_cast<uint8_t*>(pooled.data()), 0, &pool));
+    CHECK(pooled == serial);
+    // rows in bands that do not line up with the tiles
+    for (uint32_t y0 = 0; y0 < lut.height(); y0 += 11) {
+        lut.applyRows(OutputFormat::Y16, src_bytes, kWidth * sizeof(uint16_t), reinterpret_cast<uint8_t*>(rows.data()),
+                      stride, y0, std::min(lut.height(), y0 + 11));
+    }
+    CHECK(rows == serial);
+    // rectangles from a copy of just the source box they read, so that a read outside the box shows
+    for (uint32_t y0 = 0; y0 < lut.height(); y0 += 20) {
+        for (uint32_t x0 = 0; x0 < lut.width(); x0 += 100) {
+            const uint32_t x1 = std::min(lut.width(), x0 + 100);
+            const uint32_t y1 = std::min(lut.height(), y0 + 20);
+            SourceBox box;
+            if (!lut.sourceBox(x0, x1, y0, y1, box)) {
+                continue;
+            }
+            REQUIRE(box.x1 <= kWidth && box.y1 <= kHeight);
+            const uint32_t box_width = box.x1 - box.x0;
+            std::vector<uint16_t> part(box_width * (box.y1 - box.y0));
+            for (uint32_t y = box.y0; y < box.y1; y++) {
+                std::memcpy(&part[(y - box.y0) * box_width], &src[y * kWidth + box.x0], box_width * sizeof(uint16_t));
+            }
+            auto* dst = reinterpret_cast<uint8_t*>(&windowed[y0 * lut.width() + x0]);
+            lut.applyWindow(OutputFormat::Y16, reinterpret_cast<const uint8_t*>(part.data()),
+                            box_width * sizeof(uint16_t), box, dst, stride, x0, x1, y0, y1);
+        }
+    }
+    CHECK(windowed == serial);
+}
+
+void testLoadParams() {
+    const char* path = "RemapLutTest.json";
+    {
+        std::ofstream file(path);
+        file << R"({"cam0": {"xcenter": 140.5, "ycenter": 30.25, "coeffs": [1.0, 0.0, 2e-6],
+                    "pers_coef": [1.01, 0.02, -1.5, -0.01, 0.99, 2.0, 1e-5, -2e-5],
+                    "crop_params": {"start_x": 10, "start_y": 4, "width": 280, "height": 60}},
+                   "cam1": {"coeffs": []}})";
+    }
+    CorrectionParams params;
+    params.pad_top = 3;
+    params.rotation = 3.0;
+    REQUIRE(loadCorrectionParams(path, "cam0", params));
+    const CorrectionParams expected = fullParams();
+    CHECK(params.radial && params.xcenter == expected.xcenter && params.ycenter == expected.ycenter);
+    CHECK(params.coeffs == expected.coeffs);
+    CHECK(params.perspective && params.pers_coef == expected.pers_coef);
+    CHECK(params.crop_x == 10 && params.crop_y == 4 && params.crop_width == 280 && params.crop_height == 60);
+    // the padding and the rotation are not in the file
+    CHECK(params.pad_top == 3 && params.rotation == 3.0);
+    CHECK(loadCorrectionParams(path, "cam1", params) && !params.radial && !params.perspective);
+    CHECK(!loadCorrectionParams(path, "cam2", params));
+    std::remove(path);
+}
+
+}  // namespace
+
+int main() {
+    testCropPad();
+    testReference();
+    testTiling();
+    testLoadParams();
+    return ArducamTest::result();
+}
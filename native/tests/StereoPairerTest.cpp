@@ -0,0 +1,137 @@
+// Checks the clock offset window of ClockOffsetEstimator and the pairing of StereoPairer on frames fed through
+// push(), with two device clocks far apart from each other and from the host clock, a dropped frame and a
+// re-synchronized clock.
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include <arducam/EventDispatcher.hpp>
+#include <arducam/StereoPairer.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+// the device clocks of the two cameras, behind the host clock by these offsets, in 100 ns
+constexpr int64_t kLeftOffset = 1000000000;
+constexpr int64_t kRightOffset = 2000000000;
+// the capture time of a right frame minus the one of its left partner
+constexpr int64_t kSkew = 100;
+// the frame period, longer than the default tolerance of 5 ms
+constexpr auto kPeriod = std::chrono::milliseconds(10);
+
+// the host clock of StereoPairer, in 100 ns
+int64_t hostTicks() {
+    using Ticks = std::chrono::duration<int64_t, std::ratio<1, 10000000>>;
+    return std::chrono::duration_cast<Ticks>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameRef makeFrame(uint32_t seq, int64_t timestamp) {
+    static uint8_t byte = 0;
+    Frame frame{};
+    frame.data = &byte;
+    frame.size = 1;
+    frame.seq = seq;
+    frame.timestamp = static_cast<uint64_t>(timestamp);
+    return FrameRef::wrap(frame, nullptr, [](void*, const Frame&) {});
+}
+
+void testOffsetWindow() {
+    ClockOffsetEstimator clock(4);
+    CHECK(!clock.valid() && clock.offset() == 0);
+    // the samples are the offset plus a latency: the smallest of the last 4 wins
+    for (int64_t latency : {10, 0, 30, 40}) {
+        clock.addSample(1000 + latency, 500);
+    }
+    CHECK(clock.valid() && clock.offset() == 500);
+    clock.addSample(1050, 500);
+    CHECK(clock.offset() == 500);
+    // the sample with no latency has left the window
+    clock.addSample(1060, 500);
+    CHECK(clock.offset() == 530);
+    clock.reset();
+    CHECK(!clock.valid() && clock.offset() == 0);
+    clock.addSample(2000, 500);
+    CHECK(clock.offset() == 1500);
+}
+
+void testPairing() {
+    StereoPairerOptions options;
+    options.output_capacity = 32;
+    StereoPairer pairer(options);
+    int unmatched[2] = {0, 0};
+    pairer.setUnmatchedCallback(
+        [&](StereoSide side, const FrameRef&) { unmatched[side == StereoSide::Left ? 0 : 1]++; });
+    // the right frame 5 is lost: only its left partner goes unmatched
+    for (uint32_t seq = 0; seq < 10; seq++) {
+        const int64_t now = hostTicks();
+        pairer.push(StereoSide::Left, makeFrame(seq, now - kLeftOffset));
+        if (seq != 5) {
+            pairer.push(StereoSide::Right, makeFrame(seq, now + kSkew - kRightOffset));
+        }
+        std::this_thread::sleep_for(kPeriod);
+    }
+    StereoPair pair;
+    uint32_t pairs = 0;
+    while (pairer.tryPop(pair)) {
+        CHECK(pair.left.frame().seq == pair.right.frame().seq);
+        CHECK(pair.left.frame().seq != 5);
+        CHECK(std::abs(pair.skew) <= options.tolerance);
+        pairs++;
+    }
+    CHECK(pairs == 9);
+    StereoPairerStats stats = pairer.stats();
+    CHECK(stats.pairs == 9);
+    CHECK(stats.unmatched[0] == 1 && stats.unmatched[1] == 0);
+    CHECK(unmatched[0] == 1 && unmatched[1] == 0);
+    // the estimates carry the latency of push(), at most a frame period here
+    const int64_t period = std::chrono::duration_cast<std::chrono::microseconds>(kPeriod).count() * 10;
+    CHECK(stats.offset[0] >= kLeftOffset && stats.offset[0] < kLeftOffset + period);
+    CHECK(stats.offset[1] >= kRightOffset - kSkew && stats.offset[1] < kRightOffset + period);
+}
+
+void testSyncTime() {
+    // the dispatchers only need a camera to listen to, the events are injected
+    MockDeviceOptions options;
+    options.serial = "STEREO";
+    options.modes = {ArducamTest::mockMode(320, 240)};
+    Camera left, right;
+    REQUIRE(ArducamTest::openMockCamera(left, options));
+    options.serial = "STEREO_R";
+    REQUIRE(ArducamTest::openMockCamera(right, options));
+    EventDispatcher left_events(left), right_events(right);
+
+    StereoPairer pairer;
+    pairer.attach(left_events, right_events);
+    int64_t now = hostTicks();
+    pairer.push(StereoSide::Right, makeFrame(0, now - kRightOffset));
+    CHECK(pairer.stats().offset[1] >= kRightOffset);
+
+    // the right clock is set to another time: without the reset the old, smaller offset would stay the minimum
+    right_events.dispatch(EventCode::SyncTime);
+    CHECK(pairer.stats().offset[1] == 0);
+    now = hostTicks();
+    pairer.push(StereoSide::Right, makeFrame(1, now - 3 * kRightOffset));
+    CHECK(pairer.stats().offset[1] >= 3 * kRightOffset);
+    // the left estimate is left alone
+    pairer.push(StereoSide::Left, makeFrame(0, now - kLeftOffset));
+    left_events.dispatch(EventCode::FrameStart);
+    CHECK(pairer.stats().offset[0] >= kLeftOffset && pairer.stats().offset[0] < kRightOffset);
+
+    // after detach() the events no longer reach the pairer
+    pairer.detach();
+    right_events.dispatch(EventCode::SyncTime);
+    CHECK(pairer.stats().offset[1] >= 3 * kRightOffset);
+}
+
+}  // namespace
+
+int main() {
+    testOffsetWindow();
+    testPairing();
+    testSyncTime();
+    return ArducamTest::result();
+}
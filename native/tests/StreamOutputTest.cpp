@@ -0,0 +1,311 @@
+// Checks the packetization of RtpSender on a UDP socket of the loopback interface: H.264 NAL units sent whole or as
+// FU-A fragments (RFC 6184) and baseline JPEG frames with their quantization tables and restart markers (RFC 2435),
+// reassembled from the packets received. Also checks the box layout of the Fmp4Muxer stream.
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <arducam/StreamOutput.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+constexpr size_t kMtu = 600;
+constexpr uint32_t kSsrc = 0x12345678;
+constexpr uint64_t kTimestampUs = 1000000;
+
+uint16_t get16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+
+uint32_t get32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+// a UDP socket on an ephemeral port of 127.0.0.1
+class Receiver {
+   public:
+    Receiver() {
+#if defined(_WIN32)
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+        socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (bind(socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            getsockname(socket_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            return;
+        }
+        port_ = ntohs(address.sin_port);
+        // a lost packet fails the test instead of hanging it
+#if defined(_WIN32)
+        const DWORD timeout = 1000;
+#else
+        const timeval timeout{1, 0};
+#endif
+        setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+    ~Receiver() {
+#if defined(_WIN32)
+        closesocket(socket_);
+#else
+        close(socket_);
+#endif
+    }
+
+    uint16_t port() const { return port_; }
+
+    // receives `count` packets
+    std::vector<std::vector<uint8_t>> receive(size_t count) {
+        std::vector<std::vector<uint8_t>> packets;
+        std::vector<uint8_t> buffer(65536);
+        while (packets.size() < count) {
+            const auto size = recv(socket_, reinterpret_cast<char*>(buffer.data()), static_cast<int>(buffer.size()), 0);
+            if (size <= 0) {
+                break;
+            }
+            packets.emplace_back(buffer.begin(), buffer.begin() + size);
+        }
+        return packets;
+    }
+
+   private:
+#if defined(_WIN32)
+    SOCKET socket_ = INVALID_SOCKET;
+#else
+    int socket_ = -1;
+#endif
+    uint16_t port_ = 0;
+};
+
+std::unique_ptr<RtpSender> makeSender(const Receiver& receiver) {
+    RtpOptions options;
+    options.port = receiver.port();
+    options.mtu = kMtu;
+    options.ssrc = kSsrc;
+    return RtpSender::create(options);
+}
+
+// the RTP header fields every packet of a frame shares, and consecutive sequence numbers
+bool checkHeaders(const std::vector<std::vector<uint8_t>>& packets, uint8_t payload_type) {
+    bool ok = !packets.empty();
+    for (size_t i = 0; i < packets.size(); i++) {
+        const uint8_t* header = packets[i].data();
+        const bool marker = (header[1] & 0x80) != 0;
+        ok = ok && packets[i].size() <= kMtu && header[0] == 0x80 && (header[1] & 0x7F) == payload_type;
+        ok = ok && marker == (i + 1 == packets.size());
+        ok = ok && get16(header + 2) == static_cast<uint16_t>(get16(packets[0].data() + 2) + i);
+        ok = ok && get32(header + 4) == kTimestampUs * 9 / 100 && get32(header + 8) == kSsrc;
+    }
+    return ok;
+}
+
+void appendNal(std::vector<uint8_t>& stream, std::vector<uint8_t> nal) {
+    stream.insert(stream.end(), {0, 0, 0, 1});
+    stream.insert(stream.end(), nal.begin(), nal.end());
+}
+
+// an SPS, a PPS and an IDR slice that needs four fragments; no start code can appear in the slice
+std::vector<uint8_t> h264Frame(std::vector<uint8_t>& slice, uint8_t type) {
+    slice.assign(2000, 0);
+    slice[0] = static_cast<uint8_t>(0x60 | type);
+    for (size_t i = 1; i < slice.size(); i++) {
+        slice[i] = static_cast<uint8_t>(i % 251 + 1);
+    }
+    std::vector<uint8_t> stream;
+    if (type == 5) {
+        appendNal(stream, {0x67, 0x42, 0x00, 0x1F, 0xAA, 0xBB});
+        appendNal(stream, {0x68, 0xCE, 0x3C, 0x80});
+    }
+    appendNal(stream, slice);
+    return stream;
+}
+
+void testH264() {
+    Receiver receiver;
+    REQUIRE(receiver.port() != 0);
+    std::unique_ptr<RtpSender> sender = makeSender(receiver);
+    REQUIRE(sender != nullptr);
+    std::vector<uint8_t> slice;
+    const std::vector<uint8_t> stream = h264Frame(slice, 5);
+    const EncodedPacket packet{stream.data(), stream.size(), kTimestampUs, true, VideoCodec::H264, 640, 480};
+    REQUIRE(sender->send(packet));
+    // the SPS, the PPS and ceil(1999 / (588 - 2)) fragments
+    CHECK(sender->packets() == 6);
+    const std::vector<std::vector<uint8_t>> packets = receiver.receive(6);
+    REQUIRE(packets.size() == 6);
+    CHECK(checkHeaders(packets, 96));
+    uint64_t bytes = 0;
+    for (const std::vector<uint8_t>& p : packets) {
+        bytes += p.size();
+    }
+    CHECK(sender->bytes() == bytes);
+
+    // single NAL unit packets
+    CHECK((std::vector<uint8_t>(packets[0].begin() + 12, packets[0].end()) ==
+           std::vector<uint8_t>{0x67, 0x42, 0x00, 0x1F, 0xAA, 0xBB}));
+    CHECK(packets[1].size() == 12 + 4 && packets[1][12] == 0x68);
+    // FU-A: the indicator keeps NRI, the header the type, with the start and end bits
+    std::vector<uint8_t> rebuilt{slice[0]};
+    for (size_t i = 2; i < packets.size(); i++) {
+        const uint8_t* payload = packets[i].data() + 12;
+        const uint8_t start = i == 2 ? 0x80 : 0;
+        const uint8_t end = i + 1 == packets.size() ? 0x40 : 0;
+        CHECK(payload[0] == ((slice[0] & 0xE0) | 28));
+        CHECK(payload[1] == (start | end | 5));
+        rebuilt.insert(rebuilt.end(), payload + 2, packets[i].data() + packets[i].size());
+    }
+    CHECK(rebuilt == slice);
+}
+
+std::vector<uint8_t> jpegFrame(std::vector<uint8_t>& scan, uint8_t sof, uint16_t restart_interval) {
+    std::vector<uint8_t> jpeg{0xFF, 0xD8};
+    // two 8-bit quantization tables
+    jpeg.insert(jpeg.end(), {0xFF, 0xDB, 0x00, 132});
+    for (uint8_t table = 0; table < 2; table++) {
+        jpeg.push_back(table);
+        for (int i = 0; i < 64; i++) {
+            jpeg.push_back(static_cast<uint8_t>(table * 100 + i + 1));
+        }
+    }
+    // 32x16, 4:2:0: Y with table 0, Cb and Cr with table 1
+    jpeg.insert(jpeg.end(), {0xFF, sof, 0x00, 17, 8, 0, 16, 0, 32, 3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1});
+    if (restart_interval != 0) {
+        jpeg.insert(jpeg.end(), {0xFF, 0xDD, 0x00, 4, static_cast<uint8_t>(restart_interval >> 8),
+                                 static_cast<uint8_t>(restart_interval)});
+    }
+    jpeg.insert(jpeg.end(), {0xFF, 0xDA, 0x00, 12, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0});
+    scan.resize(1500);
+    for (size_t i = 0; i < scan.size(); i++) {
+        scan[i] = static_cast<uint8_t>(i % 200);
+    }
+    jpeg.insert(jpeg.end(), scan.begin(), scan.end());
+    jpeg.insert(jpeg.end(), {0xFF, 0xD9});
+    return jpeg;
+}
+
+void testJpeg() {
+    Receiver receiver;
+    REQUIRE(receiver.port() != 0);
+    std::unique_ptr<RtpSender> sender = makeSender(receiver);
+    REQUIRE(sender != nullptr);
+
+    for (uint16_t restart_interval : {0, 4}) {
+        std::vector<uint8_t> scan;
+        const std::vector<uint8_t> jpeg = jpegFrame(scan, 0xC0, restart_interval);
+        const EncodedPacket packet{jpeg.data(), jpeg.size(), kTimestampUs, true, VideoCodec::Mjpeg, 32, 16};
+        const uint64_t sent = sender->packets();
+        REQUIRE(sender->send(packet));
+        const size_t count = static_cast<size_t>(sender->packets() - sent);
+        const std::vector<std::vector<uint8_t>> packets = receiver.receive(count);
+        REQUIRE(count > 1 && packets.size() == count);
+        CHECK(checkHeaders(packets, 26));
+
+        std::vector<uint8_t> rebuilt;
+        for (size_t i = 0; i < packets.size(); i++) {
+            const uint8_t* payload = packets[i].data() + 12;
+            const uint32_t offset = (static_cast<uint32_t>(payload[1]) << 16) | get16(payload + 2);
+            CHECK(offset == rebuilt.size());
+            // type 1 (4:2:0), plus 64 with restart markers; Q 255; the size in blocks
+            CHECK(payload[4] == (restart_interval != 0 ? 65 : 1) && payload[5] == 255);
+            CHECK(payload[6] == 4 && payload[7] == 2);
+            size_t header = 8;
+            if (restart_interval != 0) {
+                CHECK(get16(payload + 8) == restart_interval && get16(payload + 10) == 0xFFFF);
+                header += 4;
+            }
+            if (i == 0) {
+                // the quantization table header: 8-bit tables, 128 bytes, luma then chroma
+                CHECK(payload[header] == 0 && payload[header + 1] == 0 && get16(payload + header + 2) == 128);
+                CHECK(payload[header + 4] == 1 && payload[header + 67] == 64);
+                CHECK(payload[header + 68] == 101 && payload[header + 131] == 164);
+                header += 132;
+            }
+            rebuilt.insert(rebuilt.end(), payload + header, packets[i].data() + packets[i].size());
+        }
+        CHECK(rebuilt == scan);
+    }
+
+    // a progressive JPEG has no RTP payload type
+    std::vector<uint8_t> scan;
+    const std::vector<uint8_t> progressive = jpegFrame(scan, 0xC2, 0);
+    const EncodedPacket packet{progressive.data(), progressive.size(), kTimestampUs, true, VideoCodec::Mjpeg, 32, 16};
+    const uint64_t sent = sender->packets();
+    CHECK(!sender->send(packet));
+    CHECK(sender->packets() == sent);
+
+    // too small a packet for the tables
+    RtpOptions options;
+    options.mtu = 200;
+    CHECK(RtpSender::create(options) == nullptr);
+}
+
+// the type of each top-level box of an MP4 stream, empty if a size runs past the end
+std::vector<std::string> boxTypes(const std::vector<uint8_t>& stream) {
+    std::vector<std::string> types;
+    size_t pos = 0;
+    while (pos + 8 <= stream.size()) {
+        const uint32_t size = get32(stream.data() + pos);
+        if (size < 8 || pos + size > stream.size()) {
+            return {};
+        }
+        types.emplace_back(reinterpret_cast<const char*>(stream.data() + pos + 4), 4);
+        pos += size;
+    }
+    return pos == stream.size() ? types : std::vector<std::string>{};
+}
+
+void testFmp4() {
+    std::vector<uint8_t> stream;
+    Fmp4Muxer muxer([&](const uint8_t* data, size_t size) {
+        stream.insert(stream.end(), data, data + size);
+        return true;
+    });
+    std::vector<uint8_t> slice;
+    // a frame before the first key frame is dropped
+    const std::vector<uint8_t> inter = h264Frame(slice, 1);
+    CHECK(muxer.write({inter.data(), inter.size(), kTimestampUs - 33333, false, VideoCodec::H264, 640, 480}));
+    CHECK(!muxer.started() && stream.empty());
+
+    const std::vector<uint8_t> key = h264Frame(slice, 5);
+    REQUIRE(muxer.write({key.data(), key.size(), kTimestampUs, true, VideoCodec::H264, 640, 480}));
+    CHECK(muxer.started() && muxer.fragments() == 1);
+    CHECK((boxTypes(stream) == std::vector<std::string>{"ftyp", "moov", "moof", "mdat"}));
+    // the sample holds the slice alone, with a length prefix
+    const std::vector<uint8_t> sample(stream.end() - slice.size() - 4, stream.end());
+    CHECK(get32(sample.data()) == slice.size() && std::memcmp(sample.data() + 4, slice.data(), slice.size()) == 0);
+
+    const size_t init = stream.size();
+    const std::vector<uint8_t> next = h264Frame(slice, 1);
+    REQUIRE(muxer.write({next.data(), next.size(), kTimestampUs + 33333, false, VideoCodec::H264, 640, 480}));
+    CHECK(muxer.fragments() == 2);
+    CHECK((boxTypes(std::vector<uint8_t>(stream.begin() + init, stream.end())) ==
+           std::vector<std::string>{"moof", "mdat"}));
+    CHECK(!muxer.write({next.data(), next.size(), kTimestampUs, false, VideoCodec::Mjpeg, 640, 480}));
+}
+
+}  // namespace
+
+int main() {
+    testH264();
+    testJpeg();
+    testFmp4();
+    return ArducamTest::result();
+}
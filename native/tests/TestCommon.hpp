@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <arducam/ArducamCamera.hpp>
+#include <arducam/MockCamera.hpp>
+
+// The tests run on the mock backend: every program adds the devices it needs, so `ARDUCAM_MOCK_DEVICES` and the
+// default devices play no part. A failed `CHECK` is reported and the test goes on, a failed `REQUIRE` also leaves the
+// current test function. `main()` returns `ArducamTest::result()`.
+
+namespace ArducamTest {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline bool report(bool ok, const char* file, int line, const char* expr) {
+    if (!ok) {
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+        failures()++;
+    }
+    return ok;
+}
+
+inline int result() {
+    if (failures() != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures());
+        return 1;
+    }
+    return 0;
+}
+
+/** Adds a mock device and opens and initializes a camera on it. */
+inline bool openMockCamera(Arducam::Camera& camera, const Arducam::MockDeviceOptions& options) {
+    if (!Arducam::addMockDevice(options)) {
+        return false;
+    }
+    Arducam::DeviceList list = Arducam::DeviceList::listDevices();
+    for (Arducam::DeviceHandle device : list) {
+        const auto* serial = reinterpret_cast<const char*>(device->serial_number);
+        if (std::string(serial, strnlen(serial, sizeof(device->serial_number))) == options.serial) {
+            Arducam::Param param;
+            param.device = device;
+            return camera.open(param) && camera.init();
+        }
+    }
+    return false;
+}
+
+/** A mode of `width` x `height`, RGGB, like the default mock modes. */
+inline ArducamCameraConfig mockMode(uint32_t width, uint32_t height, uint8_t bit_width = 10) {
+    ArducamCameraConfig config{};
+    config.width = width;
+    config.height = height;
+    config.bit_width = bit_width;
+    config.format = FORMAT_MODE_RAW << 8;
+    config.i2c_mode = I2C_MODE_16_8;
+    config.i2c_addr = 0x34;
+    return config;
+}
+
+}  // namespace ArducamTest
+
+#define CHECK(cond) ArducamTest::report(static_cast<bool>(cond), __FILE__, __LINE__, #cond)
+#define REQUIRE(cond)                                                                \
+    do {                                                                             \
+        if (!ArducamTest::report(static_cast<bool>(cond), __FILE__, __LINE__, #cond)) { \
+            return;                                                                  \
+        }                                                                            \
+    } while (0)
@@ -0,0 +1,129 @@
+// Checks TileGraph against a full-frame reference: the frames of two mock cameras are converted whole with
+// convertFrame(), corrected whole with RemapLut::apply() and put side by side by hand, which the tiled graph must
+// reproduce bit for bit with small tiles, on one thread and on a pool.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <arducam/PixelKernels.hpp>
+#include <arducam/RemapLut.hpp>
+#include <arducam/TileGraph.hpp>
+#include <arducam/WorkerPool.hpp>
+
+#include "TestCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+constexpr uint32_t kWidth = 640;
+constexpr uint32_t kHeight = 360;
+
+CorrectionParams cameraParams(bool left) {
+    CorrectionParams params;
+    params.crop_x = left ? 12 : 4;
+    params.crop_y = left ? 6 : 2;
+    // different heights: the combined image is cut to the lower one
+    params.crop_width = 600;
+    params.crop_height = left ? 340 : 330;
+    params.pad_top = 2;
+    params.radial = true;
+    params.xcenter = 300.5;
+    params.ycenter = 170.0;
+    params.coeffs = {1.0, 0.0, 4e-7};
+    params.perspective = true;
+    params.pers_coef = {1.005, 0.01, -2.0, -0.004, 0.995, 1.0, 2e-6, -1e-6};
+    params.rotation = left ? 1.5 : 0;
+    return params;
+}
+
+// converts and corrects a whole frame, the way FrameCorrector does
+std::vector<uint8_t> referenceImage(const Frame& frame, const ConvertOptions& convert, const RemapLut& lut) {
+    const size_t pixel = outputPixelSize(convert.output);
+    std::vector<uint8_t> converted(static_cast<size_t>(kWidth) * kHeight * pixel);
+    std::vector<uint16_t> scratch(convertScratchSize(frame.format));
+    if (!convertFrame(frame, convert, converted.data(), 0, scratch.data())) {
+        return {};
+    }
+    std::vector<uint8_t> corrected(static_cast<size_t>(lut.width()) * lut.height() * pixel);
+    lut.apply(convert.output, converted.data(), 0, corrected.data(), 0);
+    return corrected;
+}
+
+void testAgainstReference() {
+    MockDeviceOptions options;
+    options.modes = {ArducamTest::mockMode(kWidth, kHeight)};
+    options.fps = 0;
+    Camera cameras[2];
+    options.serial = "TILE_L";
+    REQUIRE(ArducamTest::openMockCamera(cameras[0], options));
+    options.serial = "TILE_R";
+    REQUIRE(ArducamTest::openMockCamera(cameras[1], options));
+    std::vector<Frame> frames(2);
+    for (int i = 0; i < 2; i++) {
+        REQUIRE(cameras[i].start());
+        REQUIRE(cameras[i].capture(frames[i], 1000));
+    }
+
+    ConvertOptions convert;
+    convert.output = OutputFormat::Rgb8;
+    convert.black_level = 64;
+    RemapLut luts[2];
+    REQUIRE(luts[0].build(cameraParams(true), kWidth, kHeight));
+    REQUIRE(luts[1].build(cameraParams(false), kWidth, kHeight));
+
+    // the reference: two full corrected images, side by side, cut to the lower one
+    const size_t pixel = outputPixelSize(convert.output);
+    const uint32_t width = luts[0].width() + luts[1].width();
+    const uint32_t height = std::min(luts[0].height(), luts[1].height());
+    std::vector<uint8_t> reference(static_cast<size_t>(width) * height * pixel);
+    uint32_t x0 = 0;
+    for (int i = 0; i < 2; i++) {
+        const std::vector<uint8_t> image = referenceImage(frames[i], convert, luts[i]);
+        REQUIRE(!image.empty());
+        const size_t row = luts[i].width() * pixel;
+        for (uint32_t y = 0; y < height; y++) {
+            std::memcpy(&reference[(y * width + x0) * pixel], &image[y * row], row);
+        }
+        x0 += luts[i].width();
+    }
+
+    // tiles far smaller than the frame, so that the windows of the remaps slide and the units split the columns
+    TileGraphOptions graph_options;
+    graph_options.cache_bytes = 48 * 1024;
+    TileGraph graph(graph_options);
+    TileNode* left = graph.addRemap(graph.addSource(0, frames[0].format, convert), luts[0]);
+    TileNode* right = graph.addRemap(graph.addSource(1, frames[1].format, convert), luts[1]);
+    REQUIRE(left != nullptr && right != nullptr);
+    REQUIRE(graph.setOutput(graph.addSideBySide({left, right})));
+    CHECK(graph.width() == width && graph.height() == height && graph.format() == convert.output);
+
+    std::vector<uint8_t> serial(reference.size());
+    REQUIRE(graph.run(frames, serial.data()));
+    CHECK(serial == reference);
+    CHECK(graph.tileWidth() < width && graph.tileHeight() < height);
+    CHECK(graph.stats().window_slides > 0);
+
+    WorkerPool pool(3);
+    std::vector<uint8_t> pooled(reference.size());
+    REQUIRE(graph.run(frames, pooled.data(), 0, &pool));
+    CHECK(pooled == reference);
+    CHECK(graph.unitCount() > 1);
+    CHECK(graph.stats().runs == 2);
+
+    // a missing frame fails the run
+    CHECK(!graph.run({frames[0]}, pooled.data()));
+
+    for (int i = 0; i < 2; i++) {
+        cameras[i].freeImage(frames[i]);
+        cameras[i].stop();
+    }
+}
+
+}  // namespace
+
+int main() {
+    testAgainstReference();
+    return ArducamTest::result();
+}
@@ -0,0 +1,105 @@
+// Corrects and encodes all stereo pairs of a DNG directory or a raw recording, like `process_batch_pairs()` in
+// `image_post_processing_v1.1.py`, on every core.
+//
+//   batch_process --input DIR|FILE --output DIR [--coefficients FILE] [--rotation DEG] [--format jpeg|tiff8|tiff16]
+//                 [--quality Q] [--black N] [--bilinear] [--threads N] [--in-flight N] [--no-individual]
+//                 [--no-combined]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <arducam/BatchProcessor.hpp>
+#include <arducam/ImageIO.hpp>
+#include <arducam/RawRecorder.hpp>
+
+#include "../bench/BenchCommon.hpp"
+
+using namespace Arducam;
+
+namespace {
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    bench::Args args(argc, argv);
+    if (!args.has("input") || !args.has("output")) {
+        std::fprintf(stderr,
+                     "usage: %s --input DIR|FILE --output DIR [--coefficients FILE] [--rotation DEG] "
+                     "[--format jpeg|tiff8|tiff16] [--quality Q] [--black N] [--bilinear] [--threads N] "
+                     "[--in-flight N] [--no-individual] [--no-combined]\n",
+                     argv[0]);
+        return 2;
+    }
+    const std::string input = args.get("input", "");
+
+    BatchOptions options;
+    const std::string coefficients = args.get("coefficients", "distortion_coefficients_dual.json");
+    if (!loadCorrectionParams(coefficients, "cam0", options.left) ||
+        !loadCorrectionParams(coefficients, "cam1", options.right)) {
+        std::fprintf(stderr, "cannot read the corrections of cam0 and cam1 from %s\n", coefficients.c_str());
+        return 1;
+    }
+    // the left image is rotated by the same default angle as in the Python tool
+    options.left.rotation = std::atof(args.get("rotation", "-1.5").c_str());
+    options.method = args.has("bilinear") ? DemosaicMethod::Bilinear : DemosaicMethod::EdgeAware;
+    options.black_level = static_cast<int>(args.getInt("black", -1));
+    const std::string format = args.get("format", jpegSupported() ? "jpeg" : "tiff8");
+    if (format == "jpeg") {
+        options.format = BatchFormat::Jpeg;
+    } else if (format == "tiff8") {
+        options.format = BatchFormat::Tiff8;
+    } else if (format == "tiff16") {
+        options.format = BatchFormat::Tiff16;
+    } else {
+        std::fprintf(stderr, "unknown format %s\n", format.c_str());
+        return 2;
+    }
+    if (options.format == BatchFormat::Jpeg && !jpegSupported()) {
+        std::fprintf(stderr, "built without ARDUCAM_WITH_JPEG, use --format tiff8 or tiff16\n");
+        return 2;
+    }
+    options.quality = static_cast<int>(args.getInt("quality", 95));
+    options.save_individual = !args.has("no-individual");
+    options.save_combined = !args.has("no-combined");
+    options.output_directory = args.get("output", ".");
+    options.threads = static_cast<size_t>(args.getInt("threads", 0));
+    options.in_flight = static_cast<size_t>(args.getInt("in-flight", 0));
+
+    std::vector<BatchInput> inputs;
+    std::unique_ptr<RawReader> recording;
+    if (endsWith(input, ".dng") || endsWith(input, ".DNG")) {
+        std::fprintf(stderr, "%s is a file, pass the directory of the pairs\n", input.c_str());
+        return 2;
+    }
+    if (findDngPairs(input, inputs)) {
+        std::printf("%zu DNG pairs in %s\n", inputs.size(), input.c_str());
+    } else if ((recording = RawReader::open(input)) != nullptr) {
+        options.recording = recording.get();
+        recordingPairs(*recording, inputs);
+        std::printf("%zu pairs in the recording %s\n", inputs.size(), input.c_str());
+    } else {
+        std::fprintf(stderr, "%s is neither a directory nor a recording\n", input.c_str());
+        return 1;
+    }
+    if (inputs.empty()) {
+        return 0;
+    }
+
+    BatchProcessor processor(options);
+    const BatchResult result = processor.run(inputs, [](size_t done, size_t total, const BatchInput& pair, bool ok) {
+        std::printf("[%zu/%zu] %s %s\n", done, total, pair.name.c_str(), ok ? "ok" : "FAILED");
+        std::fflush(stdout);
+    });
+    std::printf("%zu pairs, %zu failed, %zu files in %.1f s (%.2f pairs/s); decode %.1f s, correct %.1f s, "
+                "encode %.1f s of thread time\n",
+                result.pairs, result.failed, result.files, result.seconds,
+                result.seconds > 0 ? result.pairs / result.seconds : 0.0, result.decode_us * 1e-6,
+                result.correct_us * 1e-6, result.encode_us * 1e-6);
+    return result.failed == 0 ? 0 : 1;
+}